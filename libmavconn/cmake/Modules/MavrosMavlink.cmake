@@ -6,4 +6,17 @@ find_package(mavlink REQUIRED)
 # Nothing to do since MAVLink v2.0
 #
 
+# mavlink_dialect_enabled(<dialect> <output variable>)
+#
+# Check that dialect is built in libmavconn, see MAVCONN_DIALECTS.
+# Same as MAVCONN_DIALECT_<DIALECT> define of mavconn/mavlink_dialect.h.
+function(mavlink_dialect_enabled dialect output)
+  list(FIND MAVCONN_DIALECTS ${dialect} idx)
+  if (NOT MAVCONN_DIALECTS OR dialect STREQUAL "common" OR idx GREATER -1)
+    set(${output} TRUE PARENT_SCOPE)
+  else ()
+    set(${output} FALSE PARENT_SCOPE)
+  endif ()
+endfunction ()
+
 # vim: set ts=2 sw=2 et:
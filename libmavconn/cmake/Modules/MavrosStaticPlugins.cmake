@@ -0,0 +1,65 @@
+# This module adds MAVROS_STATIC_PLUGINS option:
+# plugins linked into the node and found by compile-time registry,
+# instead of pluginlib manifest parsing and dlopen() at start.
+#
+# Option should be same for mavros and mavros_extras.
+
+option(MAVROS_STATIC_PLUGINS "Link plugins into mavros node instead of pluginlib loading" OFF)
+if (MAVROS_STATIC_PLUGINS)
+  add_definitions(-DMAVROS_STATIC_PLUGINS)
+endif ()
+
+# mavros_static_plugin_names(<output.cpp> <mavros_plugins.xml>)
+#
+# Generate plugin name table of pluginlib manifest,
+# compile it into the plugin library.
+function(mavros_static_plugin_names output manifest)
+  file(READ "${manifest}" xml)
+  # commented out classes are not exported
+  string(REGEX REPLACE "<!--([^-]|-[^-])*-->" "" xml "${xml}")
+  string(REGEX MATCHALL "<class[ \t\r\n]+name=\"[^\"]+\"[ \t\r\n]+type=\"[^\"]+\"" classes "${xml}")
+
+  set(entries "")
+  set(idx 0)
+  foreach (cls ${classes})
+    string(REGEX REPLACE ".*name=\"([^\"]+)\".*type=\"([^\"]+)\".*" "\\1;\\2" pair "${cls}")
+    list(GET pair 0 name)
+    list(GET pair 1 type)
+    set(entries "${entries}static const PluginRegistry::NameEntry name_${idx}(\"${name}\", \"${type}\");\n")
+    math(EXPR idx "${idx} + 1")
+  endforeach ()
+
+  # rewrite only on change, so plugin library isn't rebuilt on each configure
+  file(WRITE "${output}.tmp"
+    "// Generated from ${manifest}, do not edit\n\n"
+    "#include <mavros/plugin_registry.h>\n\n"
+    "using mavros::plugin::PluginRegistry;\n\n"
+    "${entries}")
+  configure_file("${output}.tmp" "${output}" COPYONLY)
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${manifest}")
+endfunction ()
+
+# mavros_prune_plugin_manifest(<output.xml> <mavros_plugins.xml> <name>...)
+#
+# Copy pluginlib manifest without classes <name>...,
+# e.g. plugins of dialect not built in.
+function(mavros_prune_plugin_manifest output manifest)
+  file(READ "${manifest}" xml)
+  foreach (name ${ARGN})
+    string(REGEX REPLACE "[ \t]*<class[ \t\r\n]+name=\"${name}\"[^>]*>([^<]|<[^/]|</[^c])*</class>[ \t]*\r?\n?" "" xml "${xml}")
+  endforeach ()
+
+  file(WRITE "${output}.tmp" "${xml}")
+  configure_file("${output}.tmp" "${output}" COPYONLY)
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${manifest}")
+endfunction ()
+
+# mavros_link_static_plugins(<target> <plugin library>...)
+#
+# Link whole plugin archives: nothing references plugin registrations,
+# so linker would drop them otherwise.
+function(mavros_link_static_plugins target)
+  target_link_libraries(${target} -Wl,--whole-archive ${ARGN} -Wl,--no-whole-archive)
+endfunction ()
+
+# vim: set ts=2 sw=2 et:
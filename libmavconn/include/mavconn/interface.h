@@ -22,7 +22,9 @@
 #pragma once
 
 #include <boost/system/system_error.hpp>
+#include <boost/asio/io_service.hpp>
 
+#include <array>
 #include <deque>
 #include <mutex>
 #include <vector>
@@ -35,9 +37,14 @@
 #include <stdexcept>
 #include <unordered_map>
 #include <mavconn/mavlink_dialect.h>
+#include <mavconn/seq_tracker.h>
+#include <mavconn/io_counters.h>
+#include <mavconn/signing.h>
 
 
 namespace mavconn {
+class TlogWriter;
+
 using steady_clock = std::chrono::steady_clock;
 using lock_guard = std::lock_guard<std::recursive_mutex>;
 
@@ -58,6 +65,16 @@ enum class Protocol : uint8_t {
 	V20 = 2		//!< MAVLink v2.0
 };
 
+//! Tx queue priority class, lower value sent first and evicted last
+enum class TxPriority : uint8_t {
+	command = 0,	//!< commands, setpoints, heartbeat, RTK corrections, HIL sensors
+	param = 1,	//!< parameter, mission and ftp transfers
+	telemetry = 2,	//!< everything else
+};
+
+//! Number of @a TxPriority classes
+static constexpr size_t TX_PRIORITY_COUNT = 3;
+
 /**
  * @brief Common exception for communication error
  */
@@ -108,8 +125,32 @@ public:
 	struct IOStat {
 		size_t tx_total_bytes;	//!< total bytes transferred
 		size_t rx_total_bytes;	//!< total bytes received
-		float tx_speed;		//!< current transfer speed [B/s]
-		float rx_speed;		//!< current receive speed [B/s]
+		float tx_speed;		//!< transfer speed of last second [B/s]
+		float rx_speed;		//!< receive speed of last second [B/s]
+		float tx_speed_avg;	//!< average transfer speed of last 10 seconds [B/s]
+		float rx_speed_avg;	//!< average receive speed of last 10 seconds [B/s]
+		float tx_speed_peak;	//!< max transfer speed of one second [B/s]
+		float rx_speed_peak;	//!< max receive speed of one second [B/s]
+		float tx_packets_per_syscall;	//!< average datagrams per send syscall (datagram links only)
+		float rx_packets_per_syscall;	//!< average datagrams per receive syscall (datagram links only)
+		float rx_read_interval_avg_us;	//!< average time between reads returning data (serial only)
+		float rx_read_interval_max_us;	//!< longest such interval of last second (serial only)
+		size_t rx_kernel_drops;		//!< datagrams dropped by kernel on full receive buffer (UDP on Linux)
+	};
+
+	//! Tx queue state per @a TxPriority class
+	struct TxStat {
+		std::array<size_t, TX_PRIORITY_COUNT> depth;	//!< buffers waiting in queue
+		std::array<size_t, TX_PRIORITY_COUNT> dropped;	//!< buffers evicted or rejected on full queue
+		size_t coalesced;	//!< pending setpoints replaced by newer ones
+	};
+
+	//! I/O thread scheduling options
+	struct ThreadOptions {
+		int cpu = -1;			//!< pin I/O thread to that CPU, -1 - leave as is
+		int sched_policy = -1;		//!< SCHED_OTHER, SCHED_FIFO or SCHED_RR, -1 - leave as is
+		int sched_priority = 0;		//!< priority for realtime policies
+		uint32_t busy_poll_us = 0;	//!< spin that long before blocking wait, 0 - disabled
 	};
 
 	/**
@@ -194,10 +235,72 @@ public:
 	//! Port closed notification callback
 	ClosedCb port_closed_cb;
 
+	/**
+	 * @brief Receive time of data containing message passed to message_received_cb
+	 *
+	 * Kernel timestamp for UDP (SO_TIMESTAMPNS), read completion time for other links.
+	 * Valid only inside message_received_cb.
+	 *
+	 * @return CLOCK_REALTIME nanoseconds, 0 - unknown
+	 */
+	inline uint64_t get_rx_stamp_ns() const {
+		return rx_stamp_ns;
+	}
+
 	virtual mavlink::mavlink_status_t get_status();
 	virtual IOStat get_iostat();
+	virtual TxStat get_tx_stat();
 	virtual bool is_open() = 0;
 
+	/**
+	 * @brief Sequence accounting per (sysid, compid) of received frames
+	 *
+	 * Unlike mavlink_status_t drop counter it is not confused by
+	 * several sources sharing one link.
+	 */
+	inline std::vector<SeqTracker::Stat> get_source_stats() const {
+		return seq_tracker.get_stats();
+	}
+
+	/**
+	 * @brief Frames and bytes of each msgid, received and queued for send
+	 */
+	virtual std::vector<MsgidCounters::Stat> get_msgid_stats();
+
+	/**
+	 * @brief Apply scheduling options to link I/O thread
+	 *
+	 * CPU affinity is Linux only, realtime policies require privileges.
+	 * Busy poll keeps I/O thread spinning for some time after last event,
+	 * that trades CPU for lower receive latency.
+	 *
+	 * @return false if some option not applied
+	 */
+	virtual bool set_thread_options(const ThreadOptions &opts) = 0;
+
+	/**
+	 * @brief Enable MAVLink 2 signing on link
+	 *
+	 * Sent v2 frames get signed, received frames checked:
+	 * failed ones passed to message_received_cb with Framing::bad_signature.
+	 *
+	 * @param signing  nullptr disables
+	 */
+	virtual void set_signing(std::shared_ptr<Signing> signing);
+
+	//! Signing counters, zero if signing disabled
+	Signing::Stat get_signing_stat();
+
+	inline bool is_signing() {
+		return get_signing_p() != nullptr;
+	}
+
+	/**
+	 * @brief Record received frames (any framing) with receive time to tlog
+	 * @param tlog  nullptr stops recording
+	 */
+	virtual void set_tlog(std::shared_ptr<TlogWriter> tlog);
+
 	inline uint8_t get_system_id() {
 		return sys_id;
 	}
@@ -225,6 +328,8 @@ public:
 	 * - udp://
 	 * - tcp://
 	 * - tcp-l://
+	 * - tlog:// (replay)
+	 * - shm://
 	 *
 	 * Please see user's documentation for details.
 	 *
@@ -239,6 +344,21 @@ public:
 
 	static std::vector<std::string> get_known_dialects();
 
+	/**
+	 * @brief Tx queue class of message
+	 *
+	 * On full queue message evicts oldest queued one of the lowest
+	 * class which is not higher than its own, otherwise it is dropped.
+	 */
+	static TxPriority get_tx_priority(mavlink::msgid_t msgid);
+
+	/**
+	 * @brief Message is latest-wins in Tx queue
+	 *
+	 * True for setpoints and manual control, where only last value matters.
+	 */
+	static bool is_tx_coalesced(mavlink::msgid_t msgid);
+
 protected:
 	uint8_t sys_id;		//!< Connection System Id
 	uint8_t comp_id;	//!< Connection Component Id
@@ -248,12 +368,27 @@ protected:
 	//! Maximum count of transmission buffers.
 	static constexpr size_t MAX_TXQ_SIZE = 1000;
 
-	//! This map merge all dialect mavlink_msg_entry_t structs. Needed for packet parser.
-	static std::unordered_map<mavlink::msgid_t, const mavlink::mavlink_msg_entry_t*> message_entries;
+	//! Message ids below that value are looked up by direct index.
+	static constexpr size_t MSG_ENTRY_DIRECT_SIZE = 1024;
+	/**
+	 * Merged mavlink_msg_entry_t structs of all dialects. Needed for packet parser.
+	 * Low ids (all of common) indexed by msgid, others in a sorted array.
+	 */
+	static std::array<const mavlink::mavlink_msg_entry_t*, MSG_ENTRY_DIRECT_SIZE> message_entries_direct;
+	static std::vector<const mavlink::mavlink_msg_entry_t*> message_entries_sparse;
 
 	//! Channel number used for logging.
 	size_t conn_id;
 
+	//! Receive time of data passed to next parse_buffer()
+	uint64_t rx_stamp_ns;
+
+	//! Set receive time to now, used when transport has no own timestamp
+	inline void stamp_rx_now() {
+		rx_stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
 	inline mavlink::mavlink_status_t *get_status_p() {
 		return &m_parse_status;
 	}
@@ -262,13 +397,38 @@ protected:
 		return &m_buffer;
 	}
 
+	//! Signing of sent frames, nullptr if disabled
+	inline Signing *get_signing_p() {
+		return signing_p.load(std::memory_order_acquire);
+	}
+
 	/**
 	 * Parse buffer and emit massage_received.
 	 */
 	void parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received);
 
+	//! busy poll option for links with own wait loop
+	inline uint32_t get_busy_poll_us() const {
+		return busy_poll_us;
+	}
+
+	//! Same as io_service.run(), but honors busy poll option
+	void io_service_run(boost::asio::io_service &io_service);
+	//! Apply @a opts to @a thd, which runs io_service_run()
+	bool apply_thread_options(const char *pfx, std::thread &thd, const ThreadOptions &opts);
+
 	void iostat_tx_add(size_t bytes);
 	void iostat_rx_add(size_t bytes);
+	//! account message queued for send, call with Tx queue locked
+	void iostat_tx_msg(mavlink::msgid_t msgid, size_t bytes);
+	//! account one send syscall which transferred @a packets datagrams
+	void iostat_tx_syscall(size_t packets);
+	//! account one receive syscall which transferred @a packets datagrams
+	void iostat_rx_syscall(size_t packets);
+	//! account read completed at @a stamp_ns, for inter-read interval, called by I/O thread
+	void iostat_rx_read(uint64_t stamp_ns);
+	//! set socket drop counter, which kernel reports as total
+	void iostat_rx_kernel_drops(size_t total);
 
 	void log_recv(const char *pfx, mavlink::mavlink_message_t &msg, Framing framing);
 	void log_send(const char *pfx, const mavlink::mavlink_message_t *msg);
@@ -281,10 +441,30 @@ private:
 	mavlink::mavlink_message_t m_buffer;
 	mavlink::mavlink_status_t m_mavlink_status;
 
+	std::atomic<uint32_t> busy_poll_us;
+
+	std::atomic<Signing*> signing_p;
+	std::mutex signing_mutex;
+	//! every signing ever set: I/O thread may still use previous one
+	std::vector<std::shared_ptr<Signing>> signing_keep;
+
+	std::atomic<TlogWriter*> tlog_p;
+	std::mutex tlog_mutex;
+	std::vector<std::shared_ptr<TlogWriter>> tlog_keep;
+
+	//! seq of received frames per source, updated by parse_buffer()
+	SeqTracker seq_tracker;
+
 	std::atomic<size_t> tx_total_bytes, rx_total_bytes;
-	std::recursive_mutex iostat_mutex;
-	size_t last_tx_total_bytes, last_rx_total_bytes;
-	std::chrono::time_point<steady_clock> last_iostat;
+	std::atomic<size_t> tx_total_packets, rx_total_packets;
+	std::atomic<size_t> tx_total_syscalls, rx_total_syscalls;
+	//! inter-read interval state, written by I/O thread
+	uint64_t rx_read_last_ns, rx_read_window_start_ns;
+	uint32_t rx_read_window_max_us;
+	std::atomic<uint32_t> rx_read_interval_avg_us, rx_read_interval_max_us;
+	std::atomic<size_t> rx_kernel_drops;
+	RollingRate tx_rate, rx_rate;
+	MsgidCounters msgid_counters;
 
 	//! monotonic counter (increment only)
 	static std::atomic<size_t> conn_id_counter;
@@ -293,7 +473,7 @@ private:
 	static std::once_flag init_flag;
 
 	/**
-	 * Initialize message_entries map
+	 * Initialize message entry tables
 	 *
 	 * autogenerated. placed in mavlink_helpers.cpp
 	 */
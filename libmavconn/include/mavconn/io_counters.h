@@ -0,0 +1,262 @@
+/**
+ * @brief MAVConn lock-free I/O counters
+ * @file io_counters.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace mavconn {
+/**
+ * @brief Byte rate over fixed time windows
+ *
+ * Ring of one second buckets, each is single atomic word:
+ * second tag in high bits, byte count in low ones. Writer adds by CAS,
+ * first add in new second restarts bucket. So rate does not depend
+ * on how often it is read, and neither side locks.
+ *
+ * Peak taken by writer when second completes, and by reader from
+ * buckets still in ring (for traffic which stopped).
+ */
+class RollingRate {
+public:
+	using clock = std::chrono::steady_clock;
+
+	//! Seconds kept, longest window + current one + spare
+	static constexpr size_t BUCKETS = 16;
+	//! Long window, seconds
+	static constexpr size_t LONG_WINDOW = 10;
+
+	struct Rates {
+		float last;	//!< last complete second [B/s]
+		float average;	//!< average of last LONG_WINDOW complete seconds [B/s]
+		float peak;	//!< max of complete seconds since start [B/s]
+	};
+
+	RollingRate() :
+		peak(0)
+	{
+		for (auto &b : buckets)
+			b.store(0, std::memory_order_relaxed);
+	}
+
+	RollingRate(const RollingRate&) = delete;
+	RollingRate &operator=(const RollingRate&) = delete;
+
+	void add(uint64_t bytes, clock::time_point now = clock::now())
+	{
+		const uint64_t sec = to_sec(now);
+		auto &b = buckets[sec % BUCKETS];
+
+		uint64_t old = b.load(std::memory_order_relaxed);
+		for (;;) {
+			const bool same = tag(old) == tag_of(sec);
+			const uint64_t word = same ? old + bytes : pack(sec, bytes);
+
+			if (b.compare_exchange_weak(old, word, std::memory_order_relaxed)) {
+				// previous second is complete now
+				if (!same && sec > 0)
+					update_peak(value_at(sec - 1));
+				return;
+			}
+		}
+	}
+
+	Rates get(clock::time_point now = clock::now()) const
+	{
+		const uint64_t sec = to_sec(now);
+		Rates r{};
+
+		uint64_t sum = 0, max = 0;
+		for (size_t k = 1; k < BUCKETS && k <= sec; k++) {
+			const uint64_t v = value_at(sec - k);
+			if (k == 1)
+				r.last = v;
+			if (k <= LONG_WINDOW)
+				sum += v;
+
+			max = std::max(max, v);
+		}
+
+		update_peak(max);
+		r.average = float(sum) / LONG_WINDOW;
+		r.peak = peak.load(std::memory_order_relaxed);
+		return r;
+	}
+
+private:
+	static constexpr int TAG_SHIFT = 40;
+	static constexpr uint64_t VALUE_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+	mutable std::atomic<uint64_t> peak;
+
+	static inline uint64_t to_sec(clock::time_point tp) {
+		return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+	}
+
+	static inline uint64_t tag_of(uint64_t sec) {
+		return sec & (~uint64_t(0) >> TAG_SHIFT);
+	}
+
+	static inline uint64_t tag(uint64_t word) {
+		return word >> TAG_SHIFT;
+	}
+
+	static inline uint64_t pack(uint64_t sec, uint64_t bytes) {
+		return (tag_of(sec) << TAG_SHIFT) | (bytes & VALUE_MASK);
+	}
+
+	inline uint64_t value_at(uint64_t sec) const {
+		const uint64_t word = buckets[sec % BUCKETS].load(std::memory_order_relaxed);
+		return (tag(word) == tag_of(sec)) ? word & VALUE_MASK : 0;
+	}
+
+	void update_peak(uint64_t v) const
+	{
+		uint64_t cur = peak.load(std::memory_order_relaxed);
+		while (v > cur && !peak.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+			;
+	}
+};
+
+/**
+ * @brief Frame and byte counters of each msgid
+ *
+ * Fixed open addressing table. Rx and Tx counters have one writer each
+ * (I/O thread and sender holding Tx queue lock), both may claim slots.
+ * Readers do not lock.
+ */
+class MsgidCounters {
+public:
+	//! Max tracked msgids
+	static constexpr size_t TABLE_SIZE = 256;
+
+	struct Stat {
+		uint32_t msgid;
+		size_t rx_frames;
+		size_t rx_bytes;
+		size_t tx_frames;
+		size_t tx_bytes;
+	};
+
+	MsgidCounters() :
+		overflow_(0)
+	{
+		for (auto &slot : slots) {
+			slot.msgid.store(EMPTY, std::memory_order_relaxed);
+			for (auto &c : slot.counters)
+				c.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	MsgidCounters(const MsgidCounters&) = delete;
+	MsgidCounters &operator=(const MsgidCounters&) = delete;
+
+	inline void add_rx(uint32_t msgid, size_t bytes) {
+		add(msgid, RX_FRAMES, bytes);
+	}
+
+	inline void add_tx(uint32_t msgid, size_t bytes) {
+		add(msgid, TX_FRAMES, bytes);
+	}
+
+	//! Counters of seen msgids, ordered by msgid
+	std::vector<Stat> get_stats() const
+	{
+		std::vector<Stat> ret;
+
+		for (auto &slot : slots) {
+			const uint32_t msgid = slot.msgid.load(std::memory_order_acquire);
+			if (msgid == EMPTY)
+				continue;
+
+			ret.push_back(Stat {
+				msgid,
+				slot.counters[RX_FRAMES].load(std::memory_order_relaxed),
+				slot.counters[RX_FRAMES + 1].load(std::memory_order_relaxed),
+				slot.counters[TX_FRAMES].load(std::memory_order_relaxed),
+				slot.counters[TX_FRAMES + 1].load(std::memory_order_relaxed),
+			});
+		}
+
+		std::sort(ret.begin(), ret.end(), [](const Stat &a, const Stat &b) {
+				return a.msgid < b.msgid;
+			});
+		return ret;
+	}
+
+	//! Frames not counted because table is full
+	inline size_t overflow() const {
+		return overflow_.load(std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+	//! counters index: frames, then bytes
+	static constexpr size_t RX_FRAMES = 0;
+	static constexpr size_t TX_FRAMES = 2;
+
+	struct Slot {
+		std::atomic<uint32_t> msgid;
+		std::array<std::atomic<size_t>, 4> counters;
+	};
+
+	std::array<Slot, TABLE_SIZE> slots;
+	std::atomic<size_t> overflow_;
+
+	void add(uint32_t msgid, size_t idx, size_t bytes)
+	{
+		auto slot = find_slot(msgid);
+		if (!slot) {
+			overflow_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// single writer per counter
+		auto &frames = slot->counters[idx];
+		auto &nbytes = slot->counters[idx + 1];
+		frames.store(frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		nbytes.store(nbytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+	}
+
+	Slot *find_slot(uint32_t msgid)
+	{
+		const size_t start = (msgid * 2654435769U) >> 24;
+
+		for (size_t i = 0; i < TABLE_SIZE; i++) {
+			auto &slot = slots[(start + i) % TABLE_SIZE];
+			uint32_t id = slot.msgid.load(std::memory_order_acquire);
+
+			if (id == msgid)
+				return &slot;
+
+			// Rx and Tx sides may claim same slot at once
+			if (id == EMPTY &&
+					(slot.msgid.compare_exchange_strong(id, msgid, std::memory_order_acq_rel) || id == msgid))
+				return &slot;
+		}
+
+		return nullptr;
+	}
+};
+}	// namespace mavconn
@@ -0,0 +1,73 @@
+/**
+ * @brief MAVConn shared I/O thread pool
+ * @file io_pool.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <boost/asio.hpp>
+
+namespace mavconn {
+/**
+ * @brief io_service run by fixed number of threads
+ *
+ * Links attached to pool do not start own I/O thread,
+ * their handlers serialized by per-link strand.
+ */
+class IOPool {
+private:
+	IOPool(const IOPool&) = delete;
+
+public:
+	using Ptr = std::shared_ptr<IOPool>;
+
+	//! Upper limit of default shared pool size
+	static constexpr size_t DEFAULT_MAX_THREADS = 4;
+
+	/**
+	 * @param[in] nthreads  number of threads, 0 - hardware concurrency clamped to DEFAULT_MAX_THREADS
+	 */
+	explicit IOPool(size_t nthreads = 0);
+	~IOPool();
+
+	/**
+	 * @brief Process-wide pool
+	 *
+	 * Created on first call, @a nthreads used only at that time.
+	 */
+	static Ptr get_shared(size_t nthreads = 0);
+
+	inline boost::asio::io_service &get_io_service() {
+		return *io_service;
+	}
+
+	inline size_t size() const {
+		return threads.size();
+	}
+
+private:
+	//! shared with threads: last link may be released by handler in pool thread
+	std::shared_ptr<boost::asio::io_service> io_service;
+	std::unique_ptr<boost::asio::io_service::work> io_work;
+	std::vector<std::thread> threads;
+
+	static std::mutex shared_mutex;
+	static Ptr shared_pool;
+};
+}	// namespace mavconn
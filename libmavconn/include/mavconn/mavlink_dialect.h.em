@@ -28,3 +28,6 @@
 
 @[for dialect in MAVLINK_V20_DIALECTS]#include <mavlink/v2.0/@(dialect)/@(dialect).hpp>
 @[end for]
+// dialects built in, see MAVCONN_DIALECTS build option
+@[for dialect in MAVLINK_V20_DIALECTS]#define MAVCONN_DIALECT_@(dialect.upper())
+@[end for]
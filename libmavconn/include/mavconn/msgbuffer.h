@@ -19,10 +19,13 @@
 
 #include <cassert>
 #include <mavconn/mavlink_dialect.h>
+#include <mavconn/signing.h>
 
 namespace mavconn {
 /**
  * @brief Message buffer for internal use in libmavconn
+ *
+ * @note Kept trivially destructible, @a TxQueue reuses slots in place.
  */
 struct MsgBuffer {
 	//! Maximum buffer size with padding for CRC bytes (280 + padding)
@@ -38,19 +41,31 @@ struct MsgBuffer {
 
 	/**
 	 * @brief Buffer constructor from mavlink_message_t
+	 *
+	 * Unsigned v2 frame of known message is signed if @a signing set,
+	 * already signed (forwarded) frame kept as is.
 	 */
-	explicit MsgBuffer(const mavlink::mavlink_message_t *msg) :
+	explicit MsgBuffer(const mavlink::mavlink_message_t *msg, Signing *signing = nullptr) :
 		pos(0)
 	{
 		len = mavlink::mavlink_msg_to_send_buffer(data, msg);
 		// paranoic check, it must be less than MAVLINK_MAX_PACKET_LEN
 		assert(len < MAX_SIZE);
+
+		if (signing && msg->magic == MAVLINK_STX && !(msg->incompat_flags & MAVLINK_IFLAG_SIGNED)) {
+			auto e = mavlink::mavlink_get_msg_entry(msg->msgid);
+			if (e)
+				len = signing->sign_frame(data, len, e->crc_extra);
+		}
 	}
 
 	/**
 	 * @brief Buffer constructor for mavlink::Message derived object.
+	 *
+	 * v2 frame signed if @a signing set.
 	 */
-	MsgBuffer(const mavlink::Message &obj, mavlink::mavlink_status_t *status, uint8_t sysid, uint8_t compid) :
+	MsgBuffer(const mavlink::Message &obj, mavlink::mavlink_status_t *status, uint8_t sysid, uint8_t compid,
+			Signing *signing = nullptr) :
 		pos(0)
 	{
 		mavlink::mavlink_message_t msg;
@@ -64,6 +79,9 @@ struct MsgBuffer {
 		len = mavlink::mavlink_msg_to_send_buffer(data, &msg);
 		// paranoic check, it must be less than MAVLINK_MAX_PACKET_LEN
 		assert(len < MAX_SIZE);
+
+		if (signing && msg.magic == MAVLINK_STX)
+			len = signing->sign_frame(data, len, mi.crc_extra);
 	}
 
 	/**
@@ -78,11 +96,6 @@ struct MsgBuffer {
 		memcpy(data, bytes, nbytes);
 	}
 
-	virtual ~MsgBuffer() {
-		pos = 0;
-		len = 0;
-	}
-
 	uint8_t *dpos() {
 		return data + pos;
 	}
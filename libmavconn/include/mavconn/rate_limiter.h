@@ -0,0 +1,116 @@
+/**
+ * @brief MAVConn Tx rate limiter
+ * @file rate_limiter.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <mavconn/mavlink_dialect.h>
+
+namespace mavconn {
+/**
+ * @brief Decides which forwarded messages fit to slow link
+ *
+ * Checks in order:
+ * 1. allow list (if not empty) and deny list;
+ * 2. per msgid rate cap, extra messages decimated;
+ * 3. link byte budget (token bucket), messages from priority list
+ *    always pass, but consume budget.
+ *
+ * Byte budget scaled down when radio reports low free Tx buffer
+ * (RADIO_STATUS.txbuf) and restored when buffer recovers.
+ *
+ * @note Thread safe.
+ */
+class TxRateLimiter {
+private:
+	TxRateLimiter(const TxRateLimiter&) = delete;
+
+public:
+	using Ptr = std::shared_ptr<TxRateLimiter>;
+	using clock = std::chrono::steady_clock;
+
+	struct Stat {
+		size_t passed;		//!< accepted messages
+		size_t denied;		//!< rejected by allow/deny lists
+		size_t decimated;	//!< rejected by msgid rate cap
+		size_t dropped;		//!< rejected by byte budget
+		float budget_scale;	//!< current part of byte rate allowed by radio
+	};
+
+	TxRateLimiter();
+
+	/**
+	 * @brief Set link byte budget
+	 *
+	 * @param[in] bytes_per_sec  0 - unlimited
+	 * @param[in] burst_sec      bucket size in seconds of full rate
+	 */
+	void set_byte_rate(float bytes_per_sec, float burst_sec = 0.5);
+
+	//! Limit rate of @a msgid, 0 - remove limit
+	void set_msg_rate(mavlink::msgid_t msgid, float rate_hz);
+
+	//! Only these msgids forwarded, empty - all
+	void set_allow(std::vector<mavlink::msgid_t> msgids);
+	//! Never forward these msgids
+	void set_deny(std::vector<mavlink::msgid_t> msgids);
+	//! Not dropped by byte budget
+	void set_priority(std::vector<mavlink::msgid_t> msgids);
+
+	/**
+	 * @brief Adjust byte budget by radio free Tx buffer report
+	 *
+	 * @param[in] txbuf  free buffer, percent
+	 */
+	void update_link_budget(uint8_t txbuf);
+
+	//! Check message and account it if accepted
+	bool accept(const mavlink::mavlink_message_t *message, clock::time_point now = clock::now());
+
+	Stat get_stat();
+
+	//! Frame size on wire
+	static size_t frame_size(const mavlink::mavlink_message_t *message);
+
+private:
+	struct MsgRate {
+		clock::duration period;
+		clock::time_point next;
+	};
+
+	std::mutex mutex;
+
+	float byte_rate;
+	float burst_bytes;
+	float budget_scale;
+	float tokens;
+	clock::time_point last_refill;
+
+	std::vector<mavlink::msgid_t> allow;	// sorted
+	std::vector<mavlink::msgid_t> deny;	// sorted
+	std::vector<mavlink::msgid_t> priority;	// sorted
+	std::unordered_map<mavlink::msgid_t, MsgRate> msg_rates;
+
+	Stat stat;
+
+	bool check_budget(const mavlink::mavlink_message_t *message, clock::time_point now);
+};
+}	// namespace mavconn
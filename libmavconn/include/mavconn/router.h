@@ -0,0 +1,138 @@
+/**
+ * @brief MAVConn message router
+ * @file router.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <mavconn/interface.h>
+
+namespace mavconn {
+/**
+ * @brief Forwards messages between several links
+ *
+ * Messages received on one endpoint sent to other endpoints
+ * directly from link I/O thread.
+ *
+ * Router learns on which endpoint each system/component lives
+ * from source ids of received messages, then (as mavlink-router does):
+ * - broadcast messages (no target field or target_system == 0) sent to all other endpoints;
+ * - targeted messages sent to endpoints where target component (or system) was seen;
+ * - messages for unknown target sent to all other endpoints.
+ *
+ * Endpoints should be added before start(), set is not changed after that.
+ */
+class Router {
+private:
+	Router(const Router&) = delete;
+
+public:
+	using Ptr = std::shared_ptr<Router>;
+
+	//! Endpoint set, one bit per endpoint
+	using EndpointMask = uint32_t;
+
+	//! Limited by @a EndpointMask width
+	static constexpr size_t MAX_ENDPOINTS = 32;
+
+	//! Return false to not send message to endpoint
+	using FilterCb = std::function<bool (const mavlink::mavlink_message_t *message)>;
+
+	struct Stat {
+		size_t rx;		//!< messages received from endpoint
+		size_t tx;		//!< messages sent to endpoint
+		size_t filtered;	//!< messages rejected by endpoint filter
+		size_t overflow;	//!< messages dropped on full Tx queue
+	};
+
+	Router();
+	~Router();
+
+	/**
+	 * @brief Add link to router
+	 *
+	 * @param[in] link       connection
+	 * @param[in] own_rx     install message_received_cb on start(),
+	 *                       otherwise owner should call route() from its callback
+	 * @return endpoint index
+	 * @throws std::length_error  when @a MAX_ENDPOINTS reached
+	 */
+	size_t add_endpoint(MAVConnInterface::Ptr link, bool own_rx = true);
+
+	//! Set filter applied to messages sent to endpoint, call before start()
+	void set_tx_filter(size_t ep, FilterCb cb);
+
+	//! Install callbacks of own_rx endpoints
+	void start();
+
+	/**
+	 * @brief Forward message received on endpoint @a src
+	 *
+	 * Thread safe, called from I/O threads of links.
+	 */
+	void route(size_t src, const mavlink::mavlink_message_t *message, const Framing framing);
+
+	inline size_t size() const {
+		return endpoints.size();
+	}
+
+	inline MAVConnInterface::Ptr get_link(size_t ep) const {
+		return endpoints.at(ep)->link;
+	}
+
+	Stat get_stat(size_t ep) const;
+
+	//! Endpoints where system (and component, if not 0) was seen
+	EndpointMask find_target(uint8_t sysid, uint8_t compid);
+
+	/**
+	 * @brief Get target ids of message
+	 *
+	 * Uses target offsets of message entry, 0 - no such field (broadcast).
+	 */
+	static void get_targets(const mavlink::mavlink_message_t *message, uint8_t &sysid, uint8_t &compid);
+
+private:
+	struct Endpoint {
+		MAVConnInterface::Ptr link;
+		bool own_rx;
+		FilterCb filter;
+
+		std::atomic<size_t> rx;
+		std::atomic<size_t> tx;
+		std::atomic<size_t> filtered;
+		std::atomic<size_t> overflow;
+
+		Endpoint(MAVConnInterface::Ptr link_, bool own_rx_);
+	};
+
+	std::vector<std::unique_ptr<Endpoint>> endpoints;
+	bool started;
+
+	std::mutex mutex;
+	std::array<EndpointMask, 256> systems;			//!< sysid -> endpoints
+	std::unordered_map<uint16_t, EndpointMask> components;	//!< (sysid << 8 | compid) -> endpoints
+
+	void learn(size_t src, const mavlink::mavlink_message_t *message);
+	void send_to(Endpoint &ep, const mavlink::mavlink_message_t *message);
+};
+}	// namespace mavconn
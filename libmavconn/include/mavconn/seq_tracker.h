@@ -0,0 +1,196 @@
+/**
+ * @brief MAVConn per source sequence accounting
+ * @file seq_tracker.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace mavconn {
+/**
+ * @brief Loss, duplicates and reordering of each (sysid, compid) on link
+ *
+ * Every source numbers its frames by 8-bit seq, so link-wide drop
+ * counter of mavlink_status_t mixes all of them. Here each source
+ * gets slot of small fixed table (linear probing, never freed).
+ *
+ * Frame with seq:
+ * - next after last one: in order;
+ * - same as last one: duplicate;
+ * - ahead by less than half of seq space: gap counted as lost;
+ * - behind by at most @a REORDER_WINDOW: late frame, counted
+ *   as reordered and taken back from lost;
+ * - otherwise: source restarted, counting resynced.
+ *
+ * @note tick() called by link I/O thread only, get_stats() may be called from any thread.
+ */
+class SeqTracker {
+public:
+	//! Max tracked sources per link
+	static constexpr size_t TABLE_SIZE = 64;
+	//! Frames late by that many seq numbers still counted as reordered
+	static constexpr uint8_t REORDER_WINDOW = 32;
+
+	struct Stat {
+		uint8_t sysid;
+		uint8_t compid;
+		size_t received;	//!< frames
+		size_t lost;		//!< seq numbers not seen
+		size_t duplicates;	//!< repeated seq
+		size_t reordered;	//!< late frames
+		size_t resyncs;		//!< seq jumps treated as source restart
+	};
+
+	SeqTracker() :
+		overflow_(0)
+	{
+		for (auto &slot : slots) {
+			slot.key.store(EMPTY, std::memory_order_relaxed);
+			slot.received.store(0, std::memory_order_relaxed);
+			slot.lost.store(0, std::memory_order_relaxed);
+			slot.duplicates.store(0, std::memory_order_relaxed);
+			slot.reordered.store(0, std::memory_order_relaxed);
+			slot.resyncs.store(0, std::memory_order_relaxed);
+			slot.last_seq = 0;
+		}
+	}
+
+	SeqTracker(const SeqTracker&) = delete;
+	SeqTracker &operator=(const SeqTracker&) = delete;
+
+	//! Account frame of source
+	void tick(uint8_t sysid, uint8_t compid, uint8_t seq)
+	{
+		auto slot = find_slot(make_key(sysid, compid));
+		if (!slot) {
+			overflow_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		const size_t n = slot->received.load(std::memory_order_relaxed);
+		slot->received.store(n + 1, std::memory_order_relaxed);
+
+		if (n == 0) {
+			slot->last_seq = seq;
+			return;
+		}
+
+		const uint8_t ahead = seq - uint8_t(slot->last_seq + 1);
+		const uint8_t behind = slot->last_seq - seq;
+
+		if (ahead == 0) {
+			slot->last_seq = seq;
+		}
+		else if (behind == 0) {
+			add(slot->duplicates, 1);
+		}
+		else if (ahead < 128) {
+			add(slot->lost, ahead);
+			slot->last_seq = seq;
+		}
+		else if (behind <= REORDER_WINDOW) {
+			add(slot->reordered, 1);
+			const size_t lost = slot->lost.load(std::memory_order_relaxed);
+			if (lost > 0)
+				slot->lost.store(lost - 1, std::memory_order_relaxed);
+		}
+		else {
+			add(slot->resyncs, 1);
+			slot->last_seq = seq;
+		}
+	}
+
+	//! Counters of all seen sources, in table order
+	std::vector<Stat> get_stats() const
+	{
+		std::vector<Stat> ret;
+
+		for (auto &slot : slots) {
+			const uint32_t key = slot.key.load(std::memory_order_acquire);
+			if (key == EMPTY)
+				continue;
+
+			Stat st{};
+			st.sysid = key >> 8;
+			st.compid = key & 0xff;
+			st.received = slot.received.load(std::memory_order_relaxed);
+			st.lost = slot.lost.load(std::memory_order_relaxed);
+			st.duplicates = slot.duplicates.load(std::memory_order_relaxed);
+			st.reordered = slot.reordered.load(std::memory_order_relaxed);
+			st.resyncs = slot.resyncs.load(std::memory_order_relaxed);
+			ret.push_back(st);
+		}
+
+		return ret;
+	}
+
+	//! Frames of sources not fitting to table
+	inline size_t overflow() const {
+		return overflow_.load(std::memory_order_relaxed);
+	}
+
+private:
+	//! out of (sysid << 8 | compid) range
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	struct Slot {
+		std::atomic<uint32_t> key;
+		std::atomic<size_t> received;
+		std::atomic<size_t> lost;
+		std::atomic<size_t> duplicates;
+		std::atomic<size_t> reordered;
+		std::atomic<size_t> resyncs;
+		uint8_t last_seq;	//!< I/O thread only
+	};
+
+	std::array<Slot, TABLE_SIZE> slots;
+	std::atomic<size_t> overflow_;
+
+	static inline uint32_t make_key(uint8_t sysid, uint8_t compid) {
+		return (uint32_t(sysid) << 8) | compid;
+	}
+
+	static inline void add(std::atomic<size_t> &counter, size_t value) {
+		// single writer: no need in atomic RMW
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	Slot *find_slot(uint32_t key)
+	{
+		// sysid mostly differs between sources
+		const size_t start = (key >> 8) ^ (key * 31);
+
+		for (size_t i = 0; i < TABLE_SIZE; i++) {
+			auto &slot = slots[(start + i) % TABLE_SIZE];
+			const uint32_t k = slot.key.load(std::memory_order_relaxed);
+
+			if (k == key)
+				return &slot;
+
+			if (k == EMPTY) {
+				slot.key.store(key, std::memory_order_release);
+				return &slot;
+			}
+		}
+
+		return nullptr;
+	}
+};
+}	// namespace mavconn
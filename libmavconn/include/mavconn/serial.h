@@ -18,9 +18,12 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/txqueue.h>
+#include <mavconn/io_pool.h>
 
 namespace mavconn {
 /**
@@ -31,38 +34,82 @@ class MAVConnSerial : public MAVConnInterface,
 public:
 	static constexpr auto DEFAULT_DEVICE = "/dev/ttyACM0";
 	static constexpr auto DEFAULT_BAUDRATE = 57600;
+	//! Upper limit of read size
+	static constexpr size_t MAX_RX_BUFFER = 65536;
+
+	//! TTY options, applied to open device
+	struct SerialOptions {
+		bool low_latency = true;	//!< ASYNC_LOW_LATENCY, FTDI drops latency timer to 1 ms (Linux)
+		int vmin = -1;			//!< termios VMIN: async read wakes after that many bytes, -1 - leave as is
+		int vtime = -1;			//!< termios VTIME [0.1 s], -1 - leave as is
+		size_t rx_buffer = 0;		//!< bytes per read, 0 - leave as is
+	};
 
 	/**
 	 * Open and run serial link.
 	 *
 	 * @param[in] device    TTY device path
 	 * @param[in] baudrate  serial baudrate
+	 * @param[in] hwflow    use hardware flow control
+	 * @param[in] io_pool   run on shared pool instead of own thread (optional)
 	 */
 	MAVConnSerial(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
-			std::string device = DEFAULT_DEVICE, unsigned baudrate = DEFAULT_BAUDRATE, bool hwflow = false);
+			std::string device = DEFAULT_DEVICE, unsigned baudrate = DEFAULT_BAUDRATE, bool hwflow = false,
+			IOPool::Ptr io_pool = nullptr);
 	~MAVConnSerial();
 
 	void close() override;
 
+	/**
+	 * @brief Start receiving on link attached to IOPool
+	 *
+	 * Link with own thread starts in constructor, this is no-op for it.
+	 * Call after make_shared(), open_url() does that.
+	 */
+	void start();
+
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
+	TxStat get_tx_stat() override;
 
 	inline bool is_open() override {
 		return serial_dev.is_open();
 	}
 
+	/**
+	 * @brief Apply TTY options
+	 *
+	 * Low latency mode is enabled by the constructor.
+	 * Bigger VMIN batches bytes per wakeup at price of latency.
+	 *
+	 * @return false if some option failed
+	 */
+	bool set_serial_options(const SerialOptions &opts);
+
 private:
-	boost::asio::io_service io_service;
+	IOPool::Ptr io_pool;
+	std::unique_ptr<boost::asio::io_service> own_io_service;	//!< null if link runs on pool
+	boost::asio::io_service &io_service;
+	boost::asio::io_service::strand strand;
 	std::thread io_thread;
 	boost::asio::serial_port serial_dev;
 
+	std::once_flag start_flag;
 	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
-	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
+	TxQueue tx_q;
+	std::vector<boost::asio::const_buffer> tx_iov;
+	std::vector<uint8_t> rx_buf;
+	//! read size requested by set_serial_options(), applied by next do_read()
+	std::atomic<size_t> rx_buf_size;
 	std::recursive_mutex mutex;
+	std::string device_path;
 
+	void do_start();
 	void do_read();
 	void do_write(bool check_tx_state);
+
+	bool set_low_latency(bool enable);
 };
 }	// namespace mavconn
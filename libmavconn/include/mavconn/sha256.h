@@ -0,0 +1,70 @@
+/**
+ * @brief MAVConn SHA-256 for MAVLink 2 signing
+ * @file sha256.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace mavconn {
+/**
+ * @brief SHA-256 block compression
+ *
+ * Implementation selected once at startup: x86 SHA extensions (SHA-NI),
+ * ARMv8 Cryptography Extensions, otherwise portable C++.
+ * Callers pad message themselves, see sha256::digest().
+ */
+namespace sha256 {
+static constexpr size_t BLOCK_LEN = 64;
+
+using State = std::array<uint32_t, 8>;
+using Digest = std::array<uint8_t, 32>;
+
+//! Initial hash value H(0)
+static constexpr State INIT {{
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+}};
+
+//! Process @a nblocks 64 byte blocks
+void compress(State &state, const uint8_t *blocks, size_t nblocks);
+
+//! Portable version of compress()
+void compress_generic(State &state, const uint8_t *blocks, size_t nblocks);
+
+//! Name of compress() implementation: "sha-ni", "armv8-ce" or "generic"
+const char *implementation();
+
+/**
+ * @brief Pad message tail in @a buf, which has room for padding
+ *
+ * @param len      tail length (bytes in @a buf)
+ * @param msg_len  whole message length, encoded to padding
+ * @return number of blocks to compress
+ */
+size_t pad(uint8_t *buf, size_t len, uint64_t msg_len);
+
+//! Pad message, which is all in @a buf
+inline size_t pad(uint8_t *buf, size_t len) {
+	return pad(buf, len, len);
+}
+
+//! Hash of whole message (key derivation, tests)
+Digest digest(const uint8_t *data, size_t len);
+}	// namespace sha256
+}	// namespace mavconn
@@ -0,0 +1,96 @@
+/**
+ * @brief MAVConn shared memory link
+ * @file shm.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <mavconn/interface.h>
+#include <mavconn/msgbuffer.h>
+
+namespace mavconn {
+/**
+ * @brief Shared memory interface for processes on same host
+ *
+ * All links opened with same name share one broadcast ring in POSIX
+ * shared memory (/dev/shm/mavconn.NAME), every frame sent by one peer
+ * is received by all others. Senders claim slots by atomic increment
+ * of ring head and never wait for readers; each slot is a seqlock,
+ * so reader that fell behind by whole ring detects overwritten slots,
+ * skips to head and counts lost frames. Idle readers sleep on futex.
+ *
+ * Segment outlives peers (peers may restart in any order);
+ * remove the file to change ring size.
+ *
+ * @note Linux only.
+ */
+class MAVConnSHM : public MAVConnInterface {
+public:
+	static constexpr size_t DEFAULT_SLOTS = 1024;
+
+	/**
+	 * @param[in] name   segment name, [A-Za-z0-9_.-]
+	 * @param[in] slots  ring size if segment created, power of two
+	 */
+	MAVConnSHM(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
+			std::string name = "mavros", size_t slots = DEFAULT_SLOTS);
+	~MAVConnSHM();
+
+	void close() override;
+
+	void send_message(const mavlink::mavlink_message_t *message) override;
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
+	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
+
+	inline bool is_open() override {
+		return is_open_;
+	}
+
+	//! frames overwritten before this peer read them
+	inline size_t get_rx_overruns() const {
+		return rx_overruns;
+	}
+
+private:
+	struct Header;
+	struct Slot;
+
+	int fd;
+	void *map;
+	size_t map_len;
+	Header *hdr;
+	Slot *slots;
+	size_t slot_mask;
+	uint32_t peer_id;
+
+	std::thread io_thread;
+	std::mutex mutex;		//!< tx seq and close
+	std::atomic<bool> is_open_;
+	std::atomic<size_t> rx_overruns;
+
+	//! header + slots, slots start at cache line
+	static size_t segment_size(size_t nslots);
+	static size_t slots_offset();
+
+	//! copy frame to ring and wake readers
+	void push(const uint8_t *frame, size_t len);
+	void do_read();
+};
+}	// namespace mavconn
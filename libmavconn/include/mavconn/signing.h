@@ -0,0 +1,143 @@
+/**
+ * @brief MAVConn MAVLink 2 message signing
+ * @file signing.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <mavconn/mavlink_dialect.h>
+#include <mavconn/sha256.h>
+
+namespace mavconn {
+/**
+ * @brief Signs sent frames and checks received ones with one secret key
+ *
+ * Signature is first 48 bits of SHA-256(key + header + payload + CRC + link id + timestamp),
+ * timestamp in 10 us units since 2015-01-01 00:00 UTC.
+ *
+ * Whole frame is hashed by one sha256::compress() call over buffer which
+ * already holds the key, so no streaming update state is kept and
+ * short frames (up to 4 payload bytes) take one block, setpoints two.
+ * Key is only 32 bytes of 64 byte block, so no compressed prefix state possible.
+ *
+ * Reception keeps last timestamp of STREAM_TABLE_SIZE (sysid, compid, link id)
+ * streams; frame not newer than last one of its stream is a replay.
+ * New stream is accepted if its timestamp is not older than a minute of ours.
+ *
+ * @note sign_frame() is thread safe, check() called by link I/O thread only.
+ */
+class Signing {
+public:
+	static constexpr size_t KEY_LEN = 32;
+	static constexpr size_t SIGNATURE_LEN = MAVLINK_SIGNATURE_BLOCK_LEN;
+	static constexpr size_t STREAM_TABLE_SIZE = 32;
+	//! new stream timestamp tolerance, 1 min
+	static constexpr uint64_t NEW_STREAM_WINDOW = 6000000;
+
+	using Key = std::array<uint8_t, KEY_LEN>;
+
+	struct Stat {
+		size_t tx_signed;		//!< frames signed
+		size_t rx_signed;		//!< accepted signed frames
+		size_t rx_unsigned;		//!< accepted unsigned frames
+		size_t bad_signature;		//!< wrong key or corrupted
+		size_t replayed;		//!< old timestamp or stream table full
+		size_t unsigned_rejected;
+	};
+
+	/**
+	 * @param key              secret key
+	 * @param link_id          our link id in signature
+	 * @param accept_unsigned  pass unsigned frames (RADIO_STATUS always passes)
+	 */
+	Signing(const Key &key, uint8_t link_id, bool accept_unsigned = false);
+
+	Signing(const Signing&) = delete;
+	Signing &operator=(const Signing&) = delete;
+
+	/**
+	 * @brief Key from 64 hex digits, other strings are passphrase hashed by SHA-256
+	 *
+	 * Passphrase is same as MAVProxy "signing setup" uses.
+	 */
+	static Key parse_key(const std::string &str);
+
+	/**
+	 * @brief Sign serialized v2 frame in place
+	 *
+	 * Frame should be unsigned and have room for signature.
+	 * Incompat flag set and CRC recomputed with @a crc_extra.
+	 *
+	 * @return new frame length
+	 */
+	size_t sign_frame(uint8_t *frame, size_t len, uint8_t crc_extra);
+
+	/**
+	 * @brief Check received message
+	 * @return false if frame should be treated as bad signature
+	 */
+	bool check(const mavlink::mavlink_message_t &msg);
+
+	inline void set_accept_unsigned(bool accept) {
+		accept_unsigned = accept;
+	}
+
+	//! our current timestamp, 10 us units
+	inline uint64_t get_timestamp() const {
+		return timestamp.load(std::memory_order_relaxed);
+	}
+
+	Stat get_stat() const;
+
+private:
+	//! key at start of every hashed buffer
+	Key key;
+	const uint8_t link_id;
+	std::atomic<bool> accept_unsigned;
+
+	std::atomic<uint64_t> timestamp;
+
+	struct Stream {
+		uint32_t key;		//!< sysid << 16 | compid << 8 | link id
+		uint64_t timestamp;
+	};
+	std::array<Stream, STREAM_TABLE_SIZE> streams;
+	size_t nstreams;
+
+	std::atomic<size_t> tx_signed, rx_signed, rx_unsigned;
+	std::atomic<size_t> bad_signature, replayed, unsigned_rejected;
+
+	//! now, 10 us since 2015-01-01
+	static uint64_t clock_timestamp();
+
+	//! next unique timestamp of sent frame
+	uint64_t next_timestamp();
+
+	/**
+	 * @brief 48 bit signature of frame
+	 *
+	 * @param header   10 header bytes, STX to msgid
+	 * @param tail     link id and 6 timestamp bytes
+	 * @param[out] out  6 bytes
+	 */
+	void signature(const uint8_t *header, const uint8_t *payload, size_t payload_len,
+			const uint8_t *crc, const uint8_t *tail, uint8_t *out) const;
+};
+}	// namespace mavconn
@@ -19,10 +19,13 @@
 
 #include <list>
 #include <atomic>
+#include <vector>
 #include <cstring>
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/txqueue.h>
+#include <mavconn/io_pool.h>
 
 
 namespace mavconn {
@@ -41,9 +44,11 @@ public:
 	 * Create generic TCP client (connect to the server)
 	 * @param[id] server_addr    remote host
 	 * @param[id] server_port    remote port
+	 * @param[id] io_pool        run on shared pool instead of own thread (optional)
 	 */
 	MAVConnTCPClient(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
-			std::string server_host = DEFAULT_SERVER_HOST, unsigned short server_port = DEFAULT_SERVER_PORT);
+			std::string server_host = DEFAULT_SERVER_HOST, unsigned short server_port = DEFAULT_SERVER_PORT,
+			IOPool::Ptr io_pool = nullptr);
 	/**
 	 * Special client variation for use in MAVConnTCPServer
 	 */
@@ -53,9 +58,19 @@ public:
 
 	void close() override;
 
+	/**
+	 * @brief Start receiving on link attached to IOPool
+	 *
+	 * Link with own thread starts in constructor, this is no-op for it.
+	 * Call after make_shared(), open_url() does that.
+	 */
+	void start();
+
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
+	TxStat get_tx_stat() override;
 
 	inline bool is_open() override {
 		return socket.is_open();
@@ -63,7 +78,10 @@ public:
 
 private:
 	friend class MAVConnTCPServer;
-	boost::asio::io_service io_service;
+	IOPool::Ptr io_pool;
+	std::unique_ptr<boost::asio::io_service> own_io_service;	//!< null if link runs on pool or server
+	boost::asio::io_service &io_service;
+	boost::asio::io_service::strand strand;
 	std::unique_ptr<boost::asio::io_service::work> io_work;
 	std::thread io_thread;
 
@@ -72,8 +90,10 @@ private:
 
 	std::atomic<bool> is_destroying;
 
+	std::once_flag start_flag;
 	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
+	TxQueue tx_q;
+	std::vector<boost::asio::const_buffer> tx_iov;
 	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
 	std::recursive_mutex mutex;
 
@@ -82,6 +102,15 @@ private:
 	 */
 	void client_connected(size_t server_channel);
 
+	/**
+	 * @brief Queue frame already serialized by TCP server
+	 *
+	 * @param msgid  counted in msgid stats, unless frame is not MAVLink (@a counted false)
+	 * @return false if frame is dropped or queue is full (client does not read)
+	 */
+	bool push_frame(const MsgBuffer &frame, mavlink::msgid_t msgid, bool counted);
+
+	void do_start();
 	void do_recv();
 	void do_send(bool check_tx_state);
 };
@@ -89,6 +118,10 @@ private:
 /**
  * @brief TCP server interface
  *
+ * Sent frame is serialized once and copied to Tx queues of all clients.
+ * Client which does not read (full Tx queue) loses frames, or is disconnected
+ * with @a SlowClient::disconnect policy (URL ?slow_client=disconnect).
+ *
  * @note IPv4 only
  */
 class MAVConnTCPServer : public MAVConnInterface,
@@ -97,6 +130,12 @@ public:
 	static constexpr auto DEFAULT_BIND_HOST = "localhost";
 	static constexpr auto DEFAULT_BIND_PORT = 5760;
 
+	//! What to do with client whose Tx queue overflows
+	enum class SlowClient {
+		drop,		//!< drop frames of that client only
+		disconnect,	//!< close its connection
+	};
+
 	/**
 	 * @param[id] server_addr    bind host
 	 * @param[id] server_port    bind port
@@ -110,13 +149,27 @@ public:
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
 
 	mavlink::mavlink_status_t get_status() override;
 	IOStat get_iostat() override;
+	TxStat get_tx_stat() override;
+	std::vector<MsgidCounters::Stat> get_msgid_stats() override;
 	inline bool is_open() override {
 		return acceptor.is_open();
 	}
 
+	void set_signing(std::shared_ptr<Signing> signing) override;
+	void set_tlog(std::shared_ptr<TlogWriter> tlog) override;
+
+	inline void set_slow_client_policy(SlowClient policy) {
+		slow_client = policy;
+	}
+
+	inline SlowClient get_slow_client_policy() {
+		return slow_client;
+	}
+
 private:
 	boost::asio::io_service io_service;
 	std::unique_ptr<boost::asio::io_service::work> io_work;
@@ -130,10 +183,17 @@ private:
 	std::list<std::shared_ptr<MAVConnTCPClient> > client_list;
 	std::recursive_mutex mutex;
 
+	std::atomic<SlowClient> slow_client;
+	std::shared_ptr<Signing> clients_signing;
+	std::shared_ptr<TlogWriter> clients_tlog;
+
 	void do_accept();
 
+	//! Copy @a frame to all clients, apply slow client policy
+	void fan_out(const MsgBuffer &frame, mavlink::msgid_t msgid, bool counted);
+
 	// client slots
 	void client_closed(std::weak_ptr<MAVConnTCPClient> weak_instp);
-	void recv_message(const mavlink::mavlink_message_t *message, const Framing framing);
+	void recv_message(MAVConnTCPClient *client, const mavlink::mavlink_message_t *message, const Framing framing);
 };
 }	// namespace mavconn
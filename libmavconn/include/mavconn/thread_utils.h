@@ -22,6 +22,7 @@
 #include <string>
 #include <cstdio>
 #include <sstream>
+#include <sched.h>
 #include <pthread.h>
 
 namespace mavconn {
@@ -64,6 +65,40 @@ bool set_this_thread_name(const std::string &name, Args&& ... args)
 #endif
 }
 
+/**
+ * @brief Pin thread to one CPU
+ * @param[in] thd  running thread
+ * @param[in] cpu  CPU number
+ * @return true if success
+ *
+ * @note Only for Linux target
+ */
+inline bool set_thread_affinity(std::thread &thd, int cpu)
+{
+#ifdef __linux__
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	return pthread_setaffinity_np(thd.native_handle(), sizeof(cpuset), &cpuset) == 0;
+#else
+	return false;
+#endif
+}
+
+/**
+ * @brief Set scheduling policy and priority of thread
+ * @param[in] thd       running thread
+ * @param[in] policy    SCHED_OTHER, SCHED_FIFO, SCHED_RR
+ * @param[in] priority  static priority, see sched(7)
+ * @return true if success
+ */
+inline bool set_thread_sched(std::thread &thd, int policy, int priority)
+{
+	sched_param param {};
+	param.sched_priority = priority;
+	return pthread_setschedparam(thd.native_handle(), policy, &param) == 0;
+}
+
 /**
  * @brief Convert to string objects with operator <<
  */
@@ -0,0 +1,135 @@
+/**
+ * @brief MAVConn telemetry log recording and replay
+ * @file tlog.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <condition_variable>
+#include <mavconn/interface.h>
+
+namespace mavconn {
+/**
+ * @brief Appends frames to tlog file
+ *
+ * Tlog record is 8 byte big endian timestamp [us since epoch] followed by raw frame,
+ * same as QGroundControl and MAVProxy write.
+ *
+ * File is preallocated and memory mapped, write() is a copy under uncontended lock.
+ * Mapping doubles when full. On close file is truncated to data length;
+ * after crash zero tail is left, which readers (and reopening writer) treat as end.
+ */
+class TlogWriter {
+public:
+	using Ptr = std::shared_ptr<TlogWriter>;
+
+	static constexpr size_t DEFAULT_PREALLOC = 64 << 20;
+
+	/**
+	 * @brief Open file for append
+	 * @throws DeviceError
+	 */
+	explicit TlogWriter(const std::string &path, size_t prealloc = DEFAULT_PREALLOC);
+	~TlogWriter();
+
+	TlogWriter(const TlogWriter&) = delete;
+	TlogWriter &operator=(const TlogWriter&) = delete;
+
+	void write(uint64_t stamp_us, const uint8_t *frame, size_t len);
+
+	//! frames written by this object
+	inline size_t frames() const {
+		return frames_;
+	}
+
+	//! data length
+	size_t size();
+
+private:
+	std::mutex mutex;
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	size_t length;
+	std::atomic<size_t> frames_;
+
+	//! extend file and mapping to hold @a need bytes, called locked
+	void grow(size_t need);
+};
+
+/**
+ * @brief Length of tlog record at @a p
+ * @return 0 at end of data (zero tail, truncated or corrupted record)
+ */
+size_t tlog_record_len(const uint8_t *p, size_t avail);
+
+/**
+ * @brief Tlog replay interface
+ *
+ * Frames of file passed to message_received_cb with recorded receive time
+ * (get_rx_stamp_ns()), at recorded rate scaled by @a speed, or as fast as
+ * possible if @a speed is 0. Replay starts when first message sent
+ * (user is ready, like FCU starting streams when it sees GCS heartbeat),
+ * or at once if @a wait_tx is false. At end of file link closes.
+ * Sent messages are discarded.
+ */
+class MAVConnTlog : public MAVConnInterface {
+public:
+	/**
+	 * @param[in] path     tlog file
+	 * @param[in] speed    replay speed, 1 - recorded rate, 0 - no pacing
+	 * @param[in] wait_tx  start on first sent message
+	 */
+	MAVConnTlog(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
+			std::string path = "", double speed = 1.0, bool wait_tx = true);
+	~MAVConnTlog();
+
+	void close() override;
+
+	void send_message(const mavlink::mavlink_message_t *message) override;
+	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
+	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
+
+	inline bool is_open() override {
+		return is_open_;
+	}
+
+	//! frames replayed so far
+	inline size_t replayed() const {
+		return replayed_;
+	}
+
+private:
+	int fd;
+	const uint8_t *map;
+	size_t map_len;
+	const double speed;
+
+	std::thread io_thread;
+	std::mutex mutex;
+	std::condition_variable start_cond;
+	std::atomic<bool> started;
+	std::atomic<bool> is_open_;
+	std::atomic<size_t> replayed_;
+
+	void start();
+	void replay();
+};
+}	// namespace mavconn
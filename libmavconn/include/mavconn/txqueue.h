@@ -0,0 +1,416 @@
+/**
+ * @brief MAVConn Tx queue class (internal)
+ * @file txqueue.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <new>
+#include <array>
+#include <memory>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include <mavconn/interface.h>
+#include <mavconn/msgbuffer.h>
+
+namespace mavconn {
+/**
+ * @brief Fixed capacity priority queue of preallocated @a MsgBuffer slots
+ *
+ * Replaces std::deque<MsgBuffer> used as transmission queue.
+ * All slots allocated once in constructor, so steady-state
+ * send path do not touch heap.
+ *
+ * Buffers are kept in FIFO per @a TxPriority class. Writer takes
+ * buffers from the highest non-empty class, buffers once returned by
+ * front() or at() are scheduled and keep their order until popped.
+ *
+ * On full queue new buffer evicts the oldest not scheduled buffer
+ * of the lowest class which is not higher than its own one,
+ * so streamed telemetry never pushes out pending commands.
+ *
+ * Setpoint-like messages (see @a MAVConnInterface::is_tx_coalesced())
+ * are latest-wins: new frame replaces pending one with the same msgid,
+ * source and target ids and takes its place in queue, so only one
+ * stale setpoint may wait behind the writer.
+ *
+ * @note Not thread safe, guarded by link mutex.
+ */
+class TxQueue {
+	static_assert(std::is_trivially_destructible<MsgBuffer>::value,
+			"MsgBuffer slots are reused in place and never destroyed");
+
+public:
+	//! Max buffers gathered into one vectored write
+	static constexpr size_t MAX_GATHER = 64;
+
+	explicit TxQueue(size_t capacity) :
+		slots(new MsgBuffer[capacity + 1]),	// one spare slot for incoming buffer
+		slot_prio(new uint8_t[capacity + 1]),
+		free_slots(new size_t[capacity + 1]),
+		n_free(0),
+		scheduled(capacity),
+		pending{{IndexRing(capacity), IndexRing(capacity), IndexRing(capacity)}},
+		capacity_(capacity),
+		count(0),
+		high_water_mark_(0),
+		depth_{},
+		dropped_{},
+		coalesced_(0)
+	{
+		static_assert(TX_PRIORITY_COUNT == 3, "update pending initializer");
+		assert(capacity > 0);
+		clear();
+	}
+
+	TxQueue(const TxQueue&) = delete;
+	TxQueue &operator=(const TxQueue&) = delete;
+
+	inline size_t size() const {
+		return count;
+	}
+
+	inline size_t capacity() const {
+		return capacity_;
+	}
+
+	inline bool empty() const {
+		return count == 0;
+	}
+
+	inline bool full() const {
+		return count == capacity_;
+	}
+
+	/**
+	 * @brief Next buffer to send
+	 *
+	 * Reference stays valid until pop_front().
+	 */
+	inline MsgBuffer &front() {
+		return at(0);
+	}
+
+	/**
+	 * @brief Buffer at position @a idx in send order
+	 *
+	 * Schedules buffers up to @a idx, so they can not be evicted.
+	 */
+	inline MsgBuffer &at(size_t idx) {
+		assert(idx < count);
+		while (scheduled.size() <= idx)
+			schedule_next();
+
+		return slots[scheduled.at(idx)];
+	}
+
+	/**
+	 * @brief Construct new buffer, evict queued one if full
+	 *
+	 * @return queued buffer, nullptr if it is dropped
+	 */
+	template<typename ... Args>
+	const MsgBuffer *push(Args&& ... args) {
+		return emplace(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Construct new buffer in place of free slot
+	 *
+	 * Caller should check full() before.
+	 */
+	template<typename ... Args>
+	MsgBuffer &emplace_back(Args&& ... args) {
+		assert(!full());
+
+		auto buf = emplace(std::forward<Args>(args)...);
+		assert(buf != nullptr);
+		return *buf;
+	}
+
+	inline void pop_front() {
+		assert(!empty());
+		if (scheduled.empty())
+			schedule_next();
+
+		release(scheduled.pop_front());
+	}
+
+	/**
+	 * @brief Account @a bytes written from the front of queue
+	 *
+	 * Pops fully written buffers, last partially written one
+	 * keeps its position in @a MsgBuffer::pos.
+	 */
+	void consume(size_t bytes) {
+		while (bytes > 0) {
+			auto &buf = front();
+			auto n = std::min<size_t>(bytes, buf.nbytes());
+
+			buf.pos += n;
+			bytes -= n;
+			if (buf.nbytes() == 0)
+				pop_front();
+		}
+	}
+
+	inline void clear() {
+		scheduled.clear();
+		for (auto &r : pending)
+			r.clear();
+
+		// lowest index on top
+		for (n_free = 0; n_free <= capacity_; n_free++)
+			free_slots[n_free] = capacity_ - n_free;
+
+		count = 0;
+		depth_.fill(0);
+	}
+
+	//! Maximum queue depth since creation
+	inline size_t high_water_mark() const {
+		return high_water_mark_;
+	}
+
+	//! Queued buffers of class @a prio
+	inline size_t depth(TxPriority prio) const {
+		return depth_[size_t(prio)];
+	}
+
+	//! Buffers of class @a prio evicted or rejected since creation
+	inline size_t dropped(TxPriority prio) const {
+		return dropped_[size_t(prio)];
+	}
+
+	//! Buffers replaced by newer ones since creation
+	inline size_t coalesced() const {
+		return coalesced_;
+	}
+
+	//! Depth and drops of all classes
+	MAVConnInterface::TxStat get_stat() const {
+		return MAVConnInterface::TxStat { depth_, dropped_, coalesced_ };
+	}
+
+	/**
+	 * @brief Get message id from frame header
+	 *
+	 * @return false if buffer does not start with MAVLink header
+	 */
+	static bool get_msgid(const MsgBuffer &buf, mavlink::msgid_t &msgid) {
+		if (buf.len >= 10 && buf.data[0] == MAVLINK_STX)
+			msgid = buf.data[7] | buf.data[8] << 8 | buf.data[9] << 16;
+		else if (buf.len >= 6 && buf.data[0] == MAVLINK_STX_MAVLINK1)
+			msgid = buf.data[5];
+		else
+			return false;
+
+		return true;
+	}
+
+	//! Class of buffer by its MAVLink header, unknown content is telemetry
+	static TxPriority get_priority(const MsgBuffer &buf) {
+		mavlink::msgid_t msgid;
+		if (get_msgid(buf, msgid))
+			return MAVConnInterface::get_tx_priority(msgid);
+
+		return TxPriority::telemetry;
+	}
+
+	/**
+	 * @brief Source and target ids of MAVLink frame
+	 *
+	 * @return (sysid << 24 | compid << 16 | target_system << 8 | target_component),
+	 *         absent target fields are 0
+	 */
+	static uint32_t get_address(const MsgBuffer &buf, mavlink::msgid_t msgid) {
+		const bool v2 = buf.data[0] == MAVLINK_STX;
+		const ssize_t header_len = v2 ? 10 : 6;
+		const uint8_t *payload = buf.data + header_len;
+		const ssize_t payload_len = std::min<ssize_t>(buf.data[1], buf.len - header_len);
+
+		uint32_t addr = v2 ?
+			(uint32_t(buf.data[5]) << 24 | uint32_t(buf.data[6]) << 16) :
+			(uint32_t(buf.data[3]) << 24 | uint32_t(buf.data[4]) << 16);
+
+		// v2.0 payload may be trimmed, missing bytes are zero
+		auto e = mavlink::mavlink_get_msg_entry(msgid);
+		if (e != nullptr) {
+			if ((e->flags & MAVLINK_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) && e->target_system_ofs < payload_len)
+				addr |= uint32_t(payload[e->target_system_ofs]) << 8;
+			if ((e->flags & MAVLINK_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) && e->target_component_ofs < payload_len)
+				addr |= payload[e->target_component_ofs];
+		}
+
+		return addr;
+	}
+
+private:
+	//! Fixed capacity FIFO of slot indexes
+	class IndexRing {
+	public:
+		explicit IndexRing(size_t capacity) :
+			idx(new size_t[capacity]),
+			capacity_(capacity),
+			head(0),
+			count(0)
+		{ }
+
+		inline size_t size() const {
+			return count;
+		}
+
+		inline bool empty() const {
+			return count == 0;
+		}
+
+		inline size_t at(size_t i) const {
+			return idx[(head + i) % capacity_];
+		}
+
+		inline void set(size_t i, size_t slot) {
+			idx[(head + i) % capacity_] = slot;
+		}
+
+		inline void push_back(size_t slot) {
+			assert(count < capacity_);
+			idx[(head + count) % capacity_] = slot;
+			count++;
+		}
+
+		inline size_t pop_front() {
+			assert(!empty());
+			size_t slot = idx[head];
+			head = (head + 1) % capacity_;
+			count--;
+			return slot;
+		}
+
+		inline void clear() {
+			head = 0;
+			count = 0;
+		}
+
+	private:
+		std::unique_ptr<size_t[]> idx;
+		size_t capacity_;
+		size_t head;
+		size_t count;
+	};
+
+	std::unique_ptr<MsgBuffer[]> slots;
+	std::unique_ptr<uint8_t[]> slot_prio;
+	std::unique_ptr<size_t[]> free_slots;	//!< stack of free slot indexes
+	size_t n_free;
+
+	IndexRing scheduled;					//!< buffers given to writer
+	std::array<IndexRing, TX_PRIORITY_COUNT> pending;	//!< waiting buffers per class
+
+	const size_t capacity_;
+	size_t count;
+	size_t high_water_mark_;
+	std::array<size_t, TX_PRIORITY_COUNT> depth_;
+	std::array<size_t, TX_PRIORITY_COUNT> dropped_;
+	size_t coalesced_;
+
+	template<typename ... Args>
+	MsgBuffer *emplace(Args&& ... args) {
+		// spare slot always present, so class known before eviction
+		assert(n_free > 0);
+		const size_t slot = free_slots[--n_free];
+		auto &buf = slots[slot];
+		new (&buf) MsgBuffer(std::forward<Args>(args)...);
+
+		mavlink::msgid_t msgid;
+		const bool is_frame = get_msgid(buf, msgid);
+		const size_t prio = size_t(is_frame ?
+				MAVConnInterface::get_tx_priority(msgid) : TxPriority::telemetry);
+
+		if (is_frame && MAVConnInterface::is_tx_coalesced(msgid) && replace_pending(prio, slot, msgid)) {
+			coalesced_++;
+			return &buf;
+		}
+
+		if (full() && !evict(prio)) {
+			free_slots[n_free++] = slot;
+			dropped_[prio]++;
+			return nullptr;
+		}
+
+		slot_prio[slot] = prio;
+		pending[prio].push_back(slot);
+		depth_[prio]++;
+
+		count++;
+		if (count > high_water_mark_)
+			high_water_mark_ = count;
+
+		return &buf;
+	}
+
+	//! Drop oldest pending buffer of the lowest class not higher than @a prio
+	bool evict(size_t prio) {
+		for (size_t p = TX_PRIORITY_COUNT; p-- > prio; ) {
+			if (pending[p].empty())
+				continue;
+
+			dropped_[p]++;
+			release(pending[p].pop_front());
+			return true;
+		}
+
+		return false;
+	}
+
+	//! Put @a slot in place of pending buffer with same msgid and address
+	bool replace_pending(size_t prio, size_t slot, mavlink::msgid_t msgid) {
+		auto &ring = pending[prio];
+		const uint32_t addr = get_address(slots[slot], msgid);
+
+		for (size_t i = ring.size(); i-- > 0; ) {
+			const size_t old = ring.at(i);
+			mavlink::msgid_t old_msgid;
+
+			if (get_msgid(slots[old], old_msgid) && old_msgid == msgid &&
+					get_address(slots[old], msgid) == addr) {
+				ring.set(i, slot);
+				slot_prio[slot] = prio;
+				free_slots[n_free++] = old;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	inline void release(size_t slot) {
+		depth_[slot_prio[slot]]--;
+		count--;
+		free_slots[n_free++] = slot;
+	}
+
+	void schedule_next() {
+		for (auto &r : pending) {
+			if (!r.empty()) {
+				scheduled.push_back(r.pop_front());
+				return;
+			}
+		}
+
+		assert(false);
+	}
+};
+}	// namespace mavconn
@@ -21,8 +21,19 @@
 #include <boost/asio.hpp>
 #include <mavconn/interface.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/txqueue.h>
+#include <mavconn/io_pool.h>
 
 namespace mavconn {
+//! UDP socket options, set before bind
+struct UDPSocketOptions {
+	int rcvbuf = 512 * 1024;	//!< SO_RCVBUF [bytes], kernel clamps to net.core.rmem_max
+	int sndbuf = 256 * 1024;	//!< SO_SNDBUF [bytes], kernel clamps to net.core.wmem_max
+	int busy_poll_us = -1;		//!< SO_BUSY_POLL (Linux, raise needs CAP_NET_ADMIN), -1 - leave as is
+	int dscp = -1;			//!< DSCP put to IP_TOS, e.g. 46 (EF) for WiFi voice access class, -1 - leave as is
+	bool reuse_port = false;	//!< SO_REUSEPORT: several processes bind same port
+};
+
 /**
  * @brief UDP interface
  *
@@ -38,30 +49,60 @@ public:
 	//! Markers for broadcast modes. Not valid domain names.
 	static constexpr auto BROADCAST_REMOTE_HOST = "***i want broadcast***";
 	static constexpr auto PERMANENT_BROADCAST_REMOTE_HOST = "***permanent broadcast***";
+	//! Upper limit for datagrams per sendmmsg()/recvmmsg() call
+	static constexpr size_t MAX_BATCH_SIZE = 64;
 
 	/**
 	 * @param[id] bind_host    bind host
 	 * @param[id] bind_port    bind port
 	 * @param[id] remote_host  remote host (optional)
 	 * @param[id] remote_port  remote port (optional)
+	 * @param[id] io_pool      run on shared pool instead of own thread (optional)
+	 * @param[id] sock_opts    socket options (optional)
 	 */
 	MAVConnUDP(uint8_t system_id = 1, uint8_t component_id = MAV_COMP_ID_UDP_BRIDGE,
 			std::string bind_host = DEFAULT_BIND_HOST, unsigned short bind_port = DEFAULT_BIND_PORT,
-			std::string remote_host = DEFAULT_REMOTE_HOST, unsigned short remote_port = DEFAULT_REMOTE_PORT);
+			std::string remote_host = DEFAULT_REMOTE_HOST, unsigned short remote_port = DEFAULT_REMOTE_PORT,
+			IOPool::Ptr io_pool = nullptr, const UDPSocketOptions &sock_opts = UDPSocketOptions());
 	~MAVConnUDP();
 
 	void close() override;
 
+	/**
+	 * @brief Start receiving on link attached to IOPool
+	 *
+	 * Link with own thread starts in constructor, this is no-op for it.
+	 * Call after make_shared(), open_url() does that.
+	 */
+	void start();
+
 	void send_message(const mavlink::mavlink_message_t *message) override;
 	void send_message(const mavlink::Message &message, const uint8_t source_compid) override;
 	void send_bytes(const uint8_t *bytes, size_t length) override;
+	bool set_thread_options(const ThreadOptions &opts) override;
+	TxStat get_tx_stat() override;
 
 	inline bool is_open() override {
 		return socket.is_open();
 	}
 
+	/**
+	 * @brief Set batched datagram I/O mode
+	 *
+	 * When @a batch > 1 link moves up to @a batch datagrams
+	 * per sendmmsg()/recvmmsg() call instead of one per async operation.
+	 * Each received datagram still passes parse_buffer().
+	 *
+	 * @note Linux only, on other systems request ignored.
+	 * @param[in] batch  datagrams per syscall, clamped to MAX_BATCH_SIZE
+	 */
+	void set_batch_size(size_t batch);
+
 private:
-	boost::asio::io_service io_service;
+	IOPool::Ptr io_pool;
+	std::unique_ptr<boost::asio::io_service> own_io_service;	//!< null if link runs on pool
+	boost::asio::io_service &io_service;
+	boost::asio::io_service::strand strand;
 	std::unique_ptr<boost::asio::io_service::work> io_work;
 	std::thread io_thread;
 	bool permanent_broadcast;
@@ -73,12 +114,26 @@ private:
 	boost::asio::ip::udp::endpoint last_remote_ep;
 	boost::asio::ip::udp::endpoint bind_ep;
 
+	std::once_flag start_flag;
 	std::atomic<bool> tx_in_progress;
-	std::deque<MsgBuffer> tx_q;
+	TxQueue tx_q;
 	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
 	std::recursive_mutex mutex;
 
+	//! batch mode state, used only from io_thread
+	size_t batch_size;
+	std::vector<std::array<uint8_t, MsgBuffer::MAX_SIZE> > rx_batch_buf;
+	std::vector<boost::asio::ip::udp::endpoint> rx_batch_ep;
+
+	void do_start();
 	void do_recvfrom();
 	void do_sendto(bool check_tx_state);
+
+	void do_recvmmsg();
+	void do_sendmmsg(bool check_tx_state);
+	//! update remote endpoint from datagram source
+	void handle_remote_ep(const boost::asio::ip::udp::endpoint &ep);
+	//! options which need raw setsockopt()
+	void set_socket_options(const UDPSocketOptions &opts);
 };
 }	// namespace mavconn
@@ -16,38 +16,60 @@
  */
 
 #include <set>
+#include <map>
+#include <iterator>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <cstdint>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/interface.h>
 #include <mavconn/msgbuffer.h>
+#include <mavconn/rate_limiter.h>
+#include <mavconn/thread_utils.h>
 #include <mavconn/serial.h>
 #include <mavconn/udp.h>
 #include <mavconn/tcp.h>
+#include <mavconn/shm.h>
+#include <mavconn/tlog.h>
 
 namespace mavconn {
 #define PFX	"mavconn: "
 
 using mavlink::mavlink_message_t;
 using mavlink::mavlink_status_t;
+using mavlink::msgid_t;
 
 // static members
 std::once_flag MAVConnInterface::init_flag;
-std::unordered_map<mavlink::msgid_t, const mavlink::mavlink_msg_entry_t*> MAVConnInterface::message_entries {};
+std::array<const mavlink::mavlink_msg_entry_t*, MAVConnInterface::MSG_ENTRY_DIRECT_SIZE> MAVConnInterface::message_entries_direct {};
+std::vector<const mavlink::mavlink_msg_entry_t*> MAVConnInterface::message_entries_sparse {};
 std::atomic<size_t> MAVConnInterface::conn_id_counter {0};
 
 
 MAVConnInterface::MAVConnInterface(uint8_t system_id, uint8_t component_id) :
 	sys_id(system_id),
 	comp_id(component_id),
+	rx_stamp_ns(0),
 	m_parse_status {},
 	m_buffer {},
 	m_mavlink_status {},
+	busy_poll_us(0),
+	signing_p(nullptr),
+	tlog_p(nullptr),
 	tx_total_bytes(0),
 	rx_total_bytes(0),
-	last_tx_total_bytes(0),
-	last_rx_total_bytes(0),
-	last_iostat(steady_clock::now())
+	tx_total_packets(0),
+	rx_total_packets(0),
+	tx_total_syscalls(0),
+	rx_total_syscalls(0),
+	rx_read_last_ns(0),
+	rx_read_window_start_ns(0),
+	rx_read_window_max_us(0),
+	rx_read_interval_avg_us(0),
+	rx_read_interval_max_us(0),
+	rx_kernel_drops(0)
 {
 	conn_id = conn_id_counter.fetch_add(1);
 	std::call_once(init_flag, init_msg_entry);
@@ -60,37 +82,412 @@ mavlink_status_t MAVConnInterface::get_status()
 
 MAVConnInterface::IOStat MAVConnInterface::get_iostat()
 {
-	std::lock_guard<std::recursive_mutex> lock(iostat_mutex);
 	IOStat stat;
 
 	stat.tx_total_bytes = tx_total_bytes;
 	stat.rx_total_bytes = rx_total_bytes;
 
-	auto d_tx = stat.tx_total_bytes - last_tx_total_bytes;
-	auto d_rx = stat.rx_total_bytes - last_rx_total_bytes;
-	last_tx_total_bytes = stat.tx_total_bytes;
-	last_rx_total_bytes = stat.rx_total_bytes;
+	// windowed: result does not depend on poll period
+	const auto now = RollingRate::clock::now();
+	const auto tx = tx_rate.get(now);
+	const auto rx = rx_rate.get(now);
 
-	auto now = steady_clock::now();
-	auto dt = now - last_iostat;
-	last_iostat = now;
+	stat.tx_speed = tx.last;
+	stat.rx_speed = rx.last;
+	stat.tx_speed_avg = tx.average;
+	stat.rx_speed_avg = rx.average;
+	stat.tx_speed_peak = tx.peak;
+	stat.rx_speed_peak = rx.peak;
 
-	float dt_s = std::chrono::duration_cast<std::chrono::seconds>(dt).count();
+	size_t tx_syscalls = tx_total_syscalls;
+	size_t rx_syscalls = rx_total_syscalls;
+	stat.tx_packets_per_syscall = (tx_syscalls > 0) ? float(tx_total_packets) / tx_syscalls : 0.0f;
+	stat.rx_packets_per_syscall = (rx_syscalls > 0) ? float(rx_total_packets) / rx_syscalls : 0.0f;
 
-	stat.tx_speed = d_tx / dt_s;
-	stat.rx_speed = d_rx / dt_s;
+	stat.rx_read_interval_avg_us = rx_read_interval_avg_us;
+	stat.rx_read_interval_max_us = rx_read_interval_max_us;
+	stat.rx_kernel_drops = rx_kernel_drops;
 
 	return stat;
 }
 
+MAVConnInterface::TxStat MAVConnInterface::get_tx_stat()
+{
+	// links without Tx queue
+	return TxStat {};
+}
+
+void MAVConnInterface::set_signing(std::shared_ptr<Signing> signing)
+{
+	std::lock_guard<std::mutex> lock(signing_mutex);
+
+	if (signing)
+		signing_keep.push_back(signing);
+	signing_p.store(signing.get(), std::memory_order_release);
+}
+
+void MAVConnInterface::set_tlog(std::shared_ptr<TlogWriter> tlog)
+{
+	std::lock_guard<std::mutex> lock(tlog_mutex);
+
+	if (tlog)
+		tlog_keep.push_back(tlog);
+	tlog_p.store(tlog.get(), std::memory_order_release);
+}
+
+Signing::Stat MAVConnInterface::get_signing_stat()
+{
+	auto signing = get_signing_p();
+	return signing ? signing->get_stat() : Signing::Stat {};
+}
+
+TxPriority MAVConnInterface::get_tx_priority(msgid_t msgid)
+{
+	// sorted, numeric ids to not depend on dialect
+	static const msgid_t command_ids[] = {
+		0,	// HEARTBEAT
+		11,	// SET_MODE
+		69,	// MANUAL_CONTROL
+		70,	// RC_CHANNELS_OVERRIDE
+		75,	// COMMAND_INT
+		76,	// COMMAND_LONG
+		77,	// COMMAND_ACK
+		82,	// SET_ATTITUDE_TARGET
+		84,	// SET_POSITION_TARGET_LOCAL_NED
+		86,	// SET_POSITION_TARGET_GLOBAL_INT
+		107,	// HIL_SENSOR
+		111,	// TIMESYNC
+		113,	// HIL_GPS
+		114,	// HIL_OPTICAL_FLOW
+		115,	// HIL_STATE_QUATERNION
+		123,	// GPS_INJECT_DATA
+		139,	// SET_ACTUATOR_CONTROL_TARGET
+		233,	// GPS_RTCM_DATA
+	};
+	static const msgid_t param_ids[] = {
+		20, 21, 22, 23,	// PARAM_REQUEST_READ .. PARAM_SET
+		37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,	// MISSION_REQUEST_PARTIAL_LIST .. MISSION_ACK
+		51,	// MISSION_REQUEST_INT
+		73,	// MISSION_ITEM_INT
+		110,	// FILE_TRANSFER_PROTOCOL
+		320, 321, 322, 323, 324,	// PARAM_EXT_*
+	};
+
+	if (std::binary_search(std::begin(command_ids), std::end(command_ids), msgid))
+		return TxPriority::command;
+	if (std::binary_search(std::begin(param_ids), std::end(param_ids), msgid))
+		return TxPriority::param;
+
+	return TxPriority::telemetry;
+}
+
+bool MAVConnInterface::is_tx_coalesced(msgid_t msgid)
+{
+	static const msgid_t coalesced_ids[] = {
+		69,	// MANUAL_CONTROL
+		70,	// RC_CHANNELS_OVERRIDE
+		82,	// SET_ATTITUDE_TARGET
+		84,	// SET_POSITION_TARGET_LOCAL_NED
+		86,	// SET_POSITION_TARGET_GLOBAL_INT
+		139,	// SET_ACTUATOR_CONTROL_TARGET
+	};
+
+	return std::binary_search(std::begin(coalesced_ids), std::end(coalesced_ids), msgid);
+}
+
+void MAVConnInterface::io_service_run(boost::asio::io_service &io_service)
+{
+	for (;;) {
+		auto budget = std::chrono::microseconds(busy_poll_us.load());
+		if (budget.count() > 0) {
+			// spin while traffic flows, fall to blocking wait when link is quiet
+			auto deadline = steady_clock::now() + budget;
+			while (!io_service.stopped() && steady_clock::now() < deadline) {
+				if (io_service.poll() > 0)
+					deadline = steady_clock::now() + budget;
+			}
+		}
+
+		// returns 0 when stopped or out of work, same as run()
+		if (io_service.run_one() == 0)
+			break;
+	}
+}
+
+bool MAVConnInterface::apply_thread_options(const char *pfx, std::thread &thd, const ThreadOptions &opts)
+{
+	bool ret = true;
+
+	if (!thd.joinable()) {
+		CONSOLE_BRIDGE_logWarn("%s%zu: no own I/O thread, options ignored", pfx, conn_id);
+		return false;
+	}
+
+	busy_poll_us = opts.busy_poll_us;
+	if (opts.busy_poll_us > 0)
+		CONSOLE_BRIDGE_logInform("%s%zu: I/O thread: busy poll %u us", pfx, conn_id, opts.busy_poll_us);
+
+	if (opts.cpu >= 0) {
+		if (utils::set_thread_affinity(thd, opts.cpu)) {
+			CONSOLE_BRIDGE_logInform("%s%zu: I/O thread: pinned to CPU %d", pfx, conn_id, opts.cpu);
+		}
+		else {
+			CONSOLE_BRIDGE_logWarn("%s%zu: I/O thread: failed to set CPU affinity %d", pfx, conn_id, opts.cpu);
+			ret = false;
+		}
+	}
+
+	if (opts.sched_policy >= 0) {
+		if (utils::set_thread_sched(thd, opts.sched_policy, opts.sched_priority)) {
+			CONSOLE_BRIDGE_logInform("%s%zu: I/O thread: sched policy %d priority %d", pfx, conn_id,
+					opts.sched_policy, opts.sched_priority);
+		}
+		else {
+			CONSOLE_BRIDGE_logWarn("%s%zu: I/O thread: failed to set sched policy %d priority %d", pfx, conn_id,
+					opts.sched_policy, opts.sched_priority);
+			ret = false;
+		}
+	}
+
+	return ret;
+}
+
+std::vector<MsgidCounters::Stat> MAVConnInterface::get_msgid_stats()
+{
+	return msgid_counters.get_stats();
+}
+
 void MAVConnInterface::iostat_tx_add(size_t bytes)
 {
 	tx_total_bytes += bytes;
+	tx_rate.add(bytes);
 }
 
 void MAVConnInterface::iostat_rx_add(size_t bytes)
 {
 	rx_total_bytes += bytes;
+	rx_rate.add(bytes);
+}
+
+void MAVConnInterface::iostat_tx_msg(msgid_t msgid, size_t bytes)
+{
+	msgid_counters.add_tx(msgid, bytes);
+}
+
+void MAVConnInterface::iostat_tx_syscall(size_t packets)
+{
+	tx_total_syscalls++;
+	tx_total_packets += packets;
+}
+
+void MAVConnInterface::iostat_rx_syscall(size_t packets)
+{
+	rx_total_syscalls++;
+	rx_total_packets += packets;
+}
+
+void MAVConnInterface::iostat_rx_kernel_drops(size_t total)
+{
+	rx_kernel_drops.store(total, std::memory_order_relaxed);
+}
+
+void MAVConnInterface::iostat_rx_read(uint64_t stamp_ns)
+{
+	const uint64_t last = rx_read_last_ns;
+	rx_read_last_ns = stamp_ns;
+	if (last == 0) {
+		// first read opens max window, published after full second
+		rx_read_window_start_ns = stamp_ns;
+		return;
+	}
+	if (stamp_ns < last)
+		return;
+
+	const uint32_t interval_us = std::min<uint64_t>((stamp_ns - last) / 1000, UINT32_MAX);
+
+	// EWMA 1/16: on busy USB link settles on adapter latency timer period
+	const uint32_t avg = rx_read_interval_avg_us.load(std::memory_order_relaxed);
+	rx_read_interval_avg_us.store((avg == 0) ? interval_us : avg - avg / 16 + interval_us / 16,
+			std::memory_order_relaxed);
+
+	rx_read_window_max_us = std::max(rx_read_window_max_us, interval_us);
+	if (stamp_ns - rx_read_window_start_ns >= 1000000000ULL) {
+		rx_read_interval_max_us.store(rx_read_window_max_us, std::memory_order_relaxed);
+		rx_read_window_max_us = 0;
+		rx_read_window_start_ns = stamp_ns;
+	}
+}
+
+/**
+ * X.25 CRC lookup table, same polynomial as mavlink crc_accumulate().
+ */
+struct CrcTable {
+	uint16_t table[256];
+
+	constexpr CrcTable() : table{}
+	{
+		for (int i = 0; i < 256; i++) {
+			uint8_t tmp = uint8_t(i);
+			tmp = uint8_t(tmp ^ (tmp << 4));
+			table[i] = uint16_t((tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+		}
+	}
+};
+
+static constexpr CrcTable crc_table {};
+
+static inline uint16_t crc_accumulate_bulk(uint16_t crc, const uint8_t *pbuf, size_t length)
+{
+	for (; length > 0; length--)
+		crc = (crc >> 8) ^ crc_table.table[(crc ^ *pbuf++) & 0xff];
+
+	return crc;
+}
+
+//! find first STX (v1 or v2) in [buf, end) or return end
+static inline const uint8_t *find_stx(const uint8_t *buf, const uint8_t *end)
+{
+	auto stx2 = static_cast<const uint8_t *>(std::memchr(buf, MAVLINK_STX, end - buf));
+	if (stx2 == nullptr)
+		stx2 = end;
+
+	auto stx1 = static_cast<const uint8_t *>(std::memchr(buf, MAVLINK_STX_MAVLINK1, stx2 - buf));
+	return (stx1 != nullptr) ? stx1 : stx2;
+}
+
+//! copy parser state to user visible status, as mavlink_frame_char_buffer() does
+static inline void sync_parse_status(mavlink_status_t *status, mavlink_status_t *r_mavlink_status)
+{
+	r_mavlink_status->parse_state = status->parse_state;
+	r_mavlink_status->packet_idx = status->packet_idx;
+	r_mavlink_status->current_rx_seq = status->current_rx_seq + 1;
+	r_mavlink_status->packet_rx_success_count = status->packet_rx_success_count;
+	r_mavlink_status->packet_rx_drop_count = status->parse_error;
+	r_mavlink_status->flags = status->flags;
+	status->parse_error = 0;
+}
+
+/**
+ * Decode whole frame starting at STX in @a buf.
+ *
+ * Handles only complete frames (unsigned or signed) with good CRC,
+ * everything else should go to mavlink_frame_char_buffer().
+ * Resulting state equals to byte-by-byte parsing of that frame.
+ *
+ * @return frame length or 0 if frame not decoded
+ */
+static size_t parse_frame_bulk(const uint8_t *buf, size_t avail,
+		mavlink_message_t *rxmsg, mavlink_status_t *status, mavlink_status_t *r_mavlink_status)
+{
+	const bool is_v1 = buf[0] == MAVLINK_STX_MAVLINK1;
+	const size_t header_len = is_v1 ? MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 : MAVLINK_NUM_HEADER_BYTES;
+
+	if (avail < header_len)
+		return 0;
+
+	// unknown incompat flags handled by state machine
+	const bool is_signed = !is_v1 && buf[2] == MAVLINK_IFLAG_SIGNED;
+	if (!is_v1 && buf[2] != 0 && !is_signed)
+		return 0;
+
+	const uint8_t len = buf[1];
+	const size_t frame_len = header_len + len + MAVLINK_NUM_CHECKSUM_BYTES +
+			(is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+	if (avail < frame_len)
+		return 0;
+
+	const mavlink::msgid_t msgid = is_v1 ? buf[5] : (buf[7] | (buf[8] << 8) | (uint32_t(buf[9]) << 16));
+	const mavlink::mavlink_msg_entry_t *e = mavlink::mavlink_get_msg_entry(msgid);
+	const uint8_t crc_extra = e ? e->crc_extra : 0;
+
+	uint16_t crc = crc_accumulate_bulk(X25_INIT_CRC, buf + 1, header_len - 1 + len);
+	crc = crc_accumulate_bulk(crc, &crc_extra, 1);
+
+	const uint8_t *ck = buf + header_len + len;
+	if (ck[0] != (crc & 0xff) || ck[1] != (crc >> 8))
+		return 0;
+
+	rxmsg->magic = buf[0];
+	rxmsg->len = len;
+	if (is_v1) {
+		rxmsg->incompat_flags = 0;
+		rxmsg->compat_flags = 0;
+		rxmsg->seq = buf[2];
+		rxmsg->sysid = buf[3];
+		rxmsg->compid = buf[4];
+		status->flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+	}
+	else {
+		rxmsg->incompat_flags = buf[2];
+		rxmsg->compat_flags = buf[3];
+		rxmsg->seq = buf[4];
+		rxmsg->sysid = buf[5];
+		rxmsg->compid = buf[6];
+		status->flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+	}
+	rxmsg->msgid = msgid;
+	rxmsg->checksum = crc;
+	rxmsg->ck[0] = ck[0];
+	rxmsg->ck[1] = ck[1];
+	// signature checked by Signing, as parser without mavlink_signing_t does not
+	if (is_signed)
+		std::memcpy(rxmsg->signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, MAVLINK_SIGNATURE_BLOCK_LEN);
+
+	auto payload = reinterpret_cast<uint8_t *>(_MAV_PAYLOAD_NON_CONST(rxmsg));
+	std::memcpy(payload, buf + header_len, len);
+	// zero-fill truncated payload
+	if (e && len < e->max_msg_len)
+		std::memset(payload + len, 0, e->max_msg_len - len);
+
+	status->packet_idx = len;
+	status->parse_state = mavlink::MAVLINK_PARSE_STATE_IDLE;
+	status->msg_received = mavlink::MAVLINK_FRAMING_OK;
+
+	status->current_rx_seq = rxmsg->seq;
+	if (status->packet_rx_success_count == 0)
+		status->packet_rx_drop_count = 0;
+	status->packet_rx_success_count++;
+
+	sync_parse_status(status, r_mavlink_status);
+	return frame_len;
+}
+
+/**
+ * Frame bytes as they came from the wire
+ *
+ * Unlike mavlink_msg_to_send_buffer() payload is not trimmed again,
+ * so received CRC and signature stay valid.
+ */
+static size_t wire_frame(const mavlink_message_t &msg, uint8_t *buf)
+{
+	uint8_t *p = buf;
+
+	*p++ = msg.magic;
+	*p++ = msg.len;
+	if (msg.magic == MAVLINK_STX) {
+		*p++ = msg.incompat_flags;
+		*p++ = msg.compat_flags;
+	}
+	*p++ = msg.seq;
+	*p++ = msg.sysid;
+	*p++ = msg.compid;
+	*p++ = msg.msgid & 0xff;
+	if (msg.magic == MAVLINK_STX) {
+		*p++ = (msg.msgid >> 8) & 0xff;
+		*p++ = (msg.msgid >> 16) & 0xff;
+	}
+
+	std::memcpy(p, _MAV_PAYLOAD(&msg), msg.len);
+	p += msg.len;
+	*p++ = msg.ck[0];
+	*p++ = msg.ck[1];
+
+	if (msg.magic == MAVLINK_STX && (msg.incompat_flags & MAVLINK_IFLAG_SIGNED)) {
+		std::memcpy(p, msg.signature, MAVLINK_SIGNATURE_BLOCK_LEN);
+		p += MAVLINK_SIGNATURE_BLOCK_LEN;
+	}
+
+	return p - buf;
 }
 
 void MAVConnInterface::parse_buffer(const char *pfx, uint8_t *buf, const size_t bufsize, size_t bytes_received)
@@ -100,14 +497,63 @@ void MAVConnInterface::parse_buffer(const char *pfx, uint8_t *buf, const size_t
 	assert(bufsize >= bytes_received);
 
 	iostat_rx_add(bytes_received);
-	for (; bytes_received > 0; bytes_received--) {
-		auto c = *buf++;
 
-		auto msg_received = static_cast<Framing>(mavlink::mavlink_frame_char_buffer(&m_buffer, &m_parse_status, c, &message, &m_mavlink_status));
+	// Complete frames decoded in one pass, only frames which straddle reads
+	// (or need signing/error handling) go through byte state machine.
+	const uint8_t *pos = buf;
+	const uint8_t *end = buf + bytes_received;
+	while (pos < end) {
+		size_t frame_len = 0;
+		Framing msg_received;
+
+		const bool idle = m_parse_status.parse_state == mavlink::MAVLINK_PARSE_STATE_UNINIT ||
+				m_parse_status.parse_state == mavlink::MAVLINK_PARSE_STATE_IDLE;
+
+		if (idle && m_parse_status.signing == nullptr) {
+			auto stx = find_stx(pos, end);
+			if (stx != pos) {
+				// skipped garbage leaves state unchanged
+				m_parse_status.msg_received = mavlink::MAVLINK_FRAMING_INCOMPLETE;
+				sync_parse_status(&m_parse_status, &m_mavlink_status);
+				pos = stx;
+				if (pos == end)
+					break;
+			}
+
+			frame_len = parse_frame_bulk(pos, end - pos, &m_buffer, &m_parse_status, &m_mavlink_status);
+		}
+
+		if (frame_len > 0) {
+			pos += frame_len;
+			message = m_buffer;
+			msg_received = Framing::ok;
+		}
+		else {
+			msg_received = static_cast<Framing>(mavlink::mavlink_frame_char_buffer(&m_buffer, &m_parse_status, *pos++, &message, &m_mavlink_status));
+		}
 
 		if (msg_received != Framing::incomplete) {
+			auto signing = get_signing_p();
+			if (signing && msg_received == Framing::ok && !signing->check(message))
+				msg_received = Framing::bad_signature;
+
+			// only accepted frames are recorded, with original bytes
+			auto tlog = tlog_p.load(std::memory_order_acquire);
+			if (tlog && msg_received == Framing::ok) {
+				uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+				const uint64_t stamp_us = rx_stamp_ns ? rx_stamp_ns / 1000 :
+						std::chrono::duration_cast<std::chrono::microseconds>(
+						std::chrono::system_clock::now().time_since_epoch()).count();
+				tlog->write(stamp_us, frame, wire_frame(message, frame));
+			}
+
 			log_recv(pfx, message, msg_received);
 
+			if (msg_received == Framing::ok) {
+				seq_tracker.tick(message.sysid, message.compid, message.seq);
+				msgid_counters.add_rx(message.msgid, TxRateLimiter::frame_size(&message));
+			}
+
 			if (message_received_cb)
 				message_received_cb(&message, msg_received);
 		}
@@ -222,33 +668,24 @@ static void url_parse_host(std::string host,
 	port_out = std::stoi(port);
 }
 
+//! Link specific URL query arguments (all except ids=)
+using url_args_t = std::map<std::string, std::string>;
+
 /**
  * Parse ?ids=sid,cid
  */
-static void url_parse_query(std::string query, uint8_t &sysid, uint8_t &compid)
+static void url_parse_ids(std::string ids, uint8_t &sysid, uint8_t &compid)
 {
-	const std::string ids_end("ids=");
 	std::string sys, comp;
 
-	if (query.empty())
-		return;
-
-	auto ids_it = std::search(query.begin(), query.end(),
-			ids_end.begin(), ids_end.end());
-	if (ids_it == query.end()) {
-		CONSOLE_BRIDGE_logWarn(PFX "URL: unknown query arguments");
-		return;
-	}
-
-	std::advance(ids_it, ids_end.length());
-	auto comma_it = std::find(ids_it, query.end(), ',');
-	if (comma_it == query.end()) {
+	auto comma_it = std::find(ids.begin(), ids.end(), ',');
+	if (comma_it == ids.end()) {
 		CONSOLE_BRIDGE_logError(PFX "URL: no comma in ids= query");
 		return;
 	}
 
-	sys.assign(ids_it, comma_it);
-	comp.assign(comma_it + 1, query.end());
+	sys.assign(ids.begin(), comma_it);
+	comp.assign(comma_it + 1, ids.end());
 
 	sysid = std::stoi(sys);
 	compid = std::stoi(comp);
@@ -256,6 +693,232 @@ static void url_parse_query(std::string query, uint8_t &sysid, uint8_t &compid)
 	CONSOLE_BRIDGE_logDebug(PFX "URL: found system/component id = [%u, %u]", sysid, compid);
 }
 
+/**
+ * Parse ?ids=sid,cid&key=value&...
+ *
+ * ids= applied here, other arguments returned to link parser.
+ */
+static url_args_t url_parse_query(std::string query, uint8_t &sysid, uint8_t &compid)
+{
+	url_args_t args;
+
+	auto arg_it = query.begin();
+	while (arg_it != query.end()) {
+		auto amp_it = std::find(arg_it, query.end(), '&');
+		auto eq_it = std::find(arg_it, amp_it, '=');
+
+		std::string key(arg_it, eq_it);
+		std::string value;
+		if (eq_it != amp_it)
+			value.assign(eq_it + 1, amp_it);
+
+		if (key == "ids")
+			url_parse_ids(value, sysid, compid);
+		else if (!key.empty())
+			args[key] = value;
+
+		arg_it = (amp_it != query.end()) ? amp_it + 1 : amp_it;
+	}
+
+	return args;
+}
+
+/**
+ * Take argument from query set
+ *
+ * @return false if argument not present
+ */
+static bool url_pop_arg(url_args_t &args, const std::string &key, std::string &value)
+{
+	auto it = args.find(key);
+	if (it == args.end())
+		return false;
+
+	value = it->second;
+	args.erase(it);
+	return true;
+}
+
+/**
+ * Report query arguments not used by link parser
+ */
+static void url_check_args(const url_args_t &args)
+{
+	for (auto &kv : args)
+		CONSOLE_BRIDGE_logWarn(PFX "URL: unknown query argument: %s", kv.first.c_str());
+}
+
+/**
+ * Parse ?cpu=N&sched=fifo|rr|other&prio=N&busypoll=us
+ *
+ * @return true if some of thread options present
+ */
+static bool url_pop_thread_args(url_args_t &args, MAVConnInterface::ThreadOptions &opts)
+{
+	std::string value;
+	bool found = false;
+
+	if (url_pop_arg(args, "cpu", value)) {
+		opts.cpu = std::stoi(value);
+		found = true;
+	}
+
+	if (url_pop_arg(args, "sched", value)) {
+		if (value == "fifo")
+			opts.sched_policy = SCHED_FIFO;
+		else if (value == "rr")
+			opts.sched_policy = SCHED_RR;
+		else if (value == "other")
+			opts.sched_policy = SCHED_OTHER;
+		else
+			CONSOLE_BRIDGE_logError(PFX "URL: unknown sched policy: %s", value.c_str());
+		found = true;
+	}
+
+	if (url_pop_arg(args, "prio", value)) {
+		opts.sched_priority = std::stoi(value);
+		// priority alone means realtime
+		if (opts.sched_policy < 0)
+			opts.sched_policy = SCHED_FIFO;
+		found = true;
+	}
+
+	if (url_pop_arg(args, "busypoll", value)) {
+		opts.busy_poll_us = std::stoul(value);
+		found = true;
+	}
+
+	return found;
+}
+
+/**
+ * Parse ?io=pool
+ *
+ * @return process-wide pool or nullptr for own I/O thread
+ */
+static IOPool::Ptr url_pop_io_pool(url_args_t &args)
+{
+	std::string value;
+	if (!url_pop_arg(args, "io", value))
+		return nullptr;
+
+	if (value == "pool")
+		return IOPool::get_shared();
+	else if (value != "thread")
+		CONSOLE_BRIDGE_logError(PFX "URL: unknown io mode: %s", value.c_str());
+
+	return nullptr;
+}
+
+/**
+ * Parse ?signing_key=KEY&signing_link_id=N&signing_accept_unsigned=1
+ *
+ * @return nullptr if no key
+ */
+static std::shared_ptr<Signing> url_pop_signing_args(url_args_t &args)
+{
+	std::string key, value;
+	int link_id = 0;
+	bool accept_unsigned = false;
+
+	const bool has_key = url_pop_arg(args, "signing_key", key);
+	if (url_pop_arg(args, "signing_link_id", value))
+		link_id = std::stoi(value);
+	if (url_pop_arg(args, "signing_accept_unsigned", value))
+		accept_unsigned = value == "1" || value == "true";
+
+	if (!has_key)
+		return nullptr;
+
+	return std::make_shared<Signing>(Signing::parse_key(key), link_id, accept_unsigned);
+}
+
+/**
+ * Parse ?tlog=PATH&tlog_prealloc=MiB
+ *
+ * @return nullptr if no path
+ */
+static std::shared_ptr<TlogWriter> url_pop_tlog_args(url_args_t &args)
+{
+	std::string path, value;
+	size_t prealloc = TlogWriter::DEFAULT_PREALLOC;
+
+	const bool has_path = url_pop_arg(args, "tlog", path);
+	if (url_pop_arg(args, "tlog_prealloc", value))
+		prealloc = std::stoul(value) << 20;
+
+	if (!has_path)
+		return nullptr;
+
+	return std::make_shared<TlogWriter>(path, prealloc);
+}
+
+static MAVConnInterface::Ptr url_parse_tlog(
+		std::string path, std::string query,
+		uint8_t system_id, uint8_t component_id)
+{
+	auto args = url_parse_query(query, system_id, component_id);
+
+	// ?speed=X&start=tx|now
+	std::string value;
+	double speed = 1.0;
+	bool wait_tx = true;
+	if (url_pop_arg(args, "speed", value))
+		speed = std::stod(value);
+	if (url_pop_arg(args, "start", value)) {
+		if (value == "now")
+			wait_tx = false;
+		else if (value != "tx")
+			CONSOLE_BRIDGE_logWarn(PFX "URL: unknown tlog start: %s", value.c_str());
+	}
+
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	url_check_args(args);
+
+	auto tlog = std::make_shared<MAVConnTlog>(system_id, component_id,
+			path, speed, wait_tx);
+
+	if (has_topts)
+		tlog->set_thread_options(topts);
+	if (signing)
+		tlog->set_signing(signing);
+
+	return tlog;
+}
+
+static MAVConnInterface::Ptr url_parse_shm(
+		std::string name, std::string query,
+		uint8_t system_id, uint8_t component_id)
+{
+	auto args = url_parse_query(query, system_id, component_id);
+
+	// shm://mavros?slots=N
+	std::string value;
+	size_t slots = MAVConnSHM::DEFAULT_SLOTS;
+	if (url_pop_arg(args, "slots", value))
+		slots = std::stoul(value);
+
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	auto tlog = url_pop_tlog_args(args);
+	url_check_args(args);
+
+	auto shm = std::make_shared<MAVConnSHM>(system_id, component_id,
+			name.empty() ? "mavros" : name, slots);
+
+	if (has_topts)
+		shm->set_thread_options(topts);
+	if (signing)
+		shm->set_signing(signing);
+	if (tlog)
+		shm->set_tlog(tlog);
+
+	return shm;
+}
+
 static MAVConnInterface::Ptr url_parse_serial(
 		std::string path, std::string query,
 		uint8_t system_id, uint8_t component_id, bool hwflow)
@@ -265,10 +928,50 @@ static MAVConnInterface::Ptr url_parse_serial(
 
 	// /dev/ttyACM0:57600
 	url_parse_host(path, file_path, baudrate, MAVConnSerial::DEFAULT_DEVICE, MAVConnSerial::DEFAULT_BAUDRATE);
-	url_parse_query(query, system_id, component_id);
+	auto args = url_parse_query(query, system_id, component_id);
+
+	// ?low_latency=0|1&vmin=N&vtime=N&rx_buf=bytes
+	std::string value;
+	MAVConnSerial::SerialOptions sopts;
+	bool has_sopts = false;
+	if (url_pop_arg(args, "low_latency", value)) {
+		sopts.low_latency = value != "0";
+		has_sopts = true;
+	}
+	if (url_pop_arg(args, "vmin", value)) {
+		sopts.vmin = std::stoi(value);
+		has_sopts = true;
+	}
+	if (url_pop_arg(args, "vtime", value)) {
+		sopts.vtime = std::stoi(value);
+		has_sopts = true;
+	}
+	if (url_pop_arg(args, "rx_buf", value)) {
+		sopts.rx_buffer = std::stoul(value);
+		has_sopts = true;
+	}
 
-	return std::make_shared<MAVConnSerial>(system_id, component_id,
-			file_path, baudrate, hwflow);
+	auto io_pool = url_pop_io_pool(args);
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	auto tlog = url_pop_tlog_args(args);
+	url_check_args(args);
+
+	auto serial = std::make_shared<MAVConnSerial>(system_id, component_id,
+			file_path, baudrate, hwflow, io_pool);
+
+	if (has_sopts)
+		serial->set_serial_options(sopts);
+	if (has_topts)
+		serial->set_thread_options(topts);
+	if (signing)
+		serial->set_signing(signing);
+	if (tlog)
+		serial->set_tlog(tlog);
+
+	serial->start();
+	return serial;
 }
 
 static MAVConnInterface::Ptr url_parse_udp(
@@ -291,14 +994,53 @@ static MAVConnInterface::Ptr url_parse_udp(
 	// udp://0.0.0.0:14555@:14550
 	url_parse_host(bind_pair, bind_host, bind_port, "0.0.0.0", MAVConnUDP::DEFAULT_BIND_PORT);
 	url_parse_host(remote_pair, remote_host, remote_port, MAVConnUDP::DEFAULT_REMOTE_HOST, MAVConnUDP::DEFAULT_REMOTE_PORT);
-	url_parse_query(query, system_id, component_id);
+	auto args = url_parse_query(query, system_id, component_id);
+
+	// ?batch=N
+	std::string value;
+	size_t batch = 1;
+	if (url_pop_arg(args, "batch", value))
+		batch = std::stoul(value);
+
+	// ?rcvbuf=bytes&sndbuf=bytes&so_busy_poll=us&dscp=N&reuse_port=1
+	UDPSocketOptions sock_opts;
+	if (url_pop_arg(args, "rcvbuf", value))
+		sock_opts.rcvbuf = std::stoi(value);
+	if (url_pop_arg(args, "sndbuf", value))
+		sock_opts.sndbuf = std::stoi(value);
+	if (url_pop_arg(args, "so_busy_poll", value))
+		sock_opts.busy_poll_us = std::stoi(value);
+	if (url_pop_arg(args, "dscp", value))
+		sock_opts.dscp = std::stoi(value);
+	if (url_pop_arg(args, "reuse_port", value))
+		sock_opts.reuse_port = value != "0";
+
+	auto io_pool = url_pop_io_pool(args);
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	auto tlog = url_pop_tlog_args(args);
+	url_check_args(args);
 
 	if (is_udpb)
 		remote_host = permanent_broadcast ? MAVConnUDP::PERMANENT_BROADCAST_REMOTE_HOST : MAVConnUDP::BROADCAST_REMOTE_HOST;
 
-	return std::make_shared<MAVConnUDP>(system_id, component_id,
+	auto udp = std::make_shared<MAVConnUDP>(system_id, component_id,
 			bind_host, bind_port,
-			remote_host, remote_port);
+			remote_host, remote_port,
+			io_pool, sock_opts);
+
+	if (batch > 1)
+		udp->set_batch_size(batch);
+	if (has_topts)
+		udp->set_thread_options(topts);
+	if (signing)
+		udp->set_signing(signing);
+	if (tlog)
+		udp->set_tlog(tlog);
+
+	udp->start();
+	return udp;
 }
 
 static MAVConnInterface::Ptr url_parse_tcp_client(
@@ -310,10 +1052,27 @@ static MAVConnInterface::Ptr url_parse_tcp_client(
 
 	// tcp://localhost:5760
 	url_parse_host(host, server_host, server_port, "localhost", 5760);
-	url_parse_query(query, system_id, component_id);
-
-	return std::make_shared<MAVConnTCPClient>(system_id, component_id,
-			server_host, server_port);
+	auto args = url_parse_query(query, system_id, component_id);
+
+	auto io_pool = url_pop_io_pool(args);
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	auto tlog = url_pop_tlog_args(args);
+	url_check_args(args);
+
+	auto client = std::make_shared<MAVConnTCPClient>(system_id, component_id,
+			server_host, server_port, io_pool);
+
+	if (has_topts)
+		client->set_thread_options(topts);
+	if (signing)
+		client->set_signing(signing);
+	if (tlog)
+		client->set_tlog(tlog);
+
+	client->start();
+	return client;
 }
 
 static MAVConnInterface::Ptr url_parse_tcp_server(
@@ -325,10 +1084,36 @@ static MAVConnInterface::Ptr url_parse_tcp_server(
 
 	// tcp-l://0.0.0.0:5760
 	url_parse_host(host, bind_host, bind_port, "0.0.0.0", 5760);
-	url_parse_query(query, system_id, component_id);
+	auto args = url_parse_query(query, system_id, component_id);
+
+	// ?slow_client=drop|disconnect
+	std::string value;
+	auto slow_client = MAVConnTCPServer::SlowClient::drop;
+	if (url_pop_arg(args, "slow_client", value)) {
+		if (value == "disconnect")
+			slow_client = MAVConnTCPServer::SlowClient::disconnect;
+		else if (value != "drop")
+			CONSOLE_BRIDGE_logWarn(PFX "URL: unknown slow_client policy: %s", value.c_str());
+	}
 
-	return std::make_shared<MAVConnTCPServer>(system_id, component_id,
+	MAVConnInterface::ThreadOptions topts;
+	bool has_topts = url_pop_thread_args(args, topts);
+	auto signing = url_pop_signing_args(args);
+	auto tlog = url_pop_tlog_args(args);
+	url_check_args(args);
+
+	auto server = std::make_shared<MAVConnTCPServer>(system_id, component_id,
 			bind_host, bind_port);
+	server->set_slow_client_policy(slow_client);
+
+	if (has_topts)
+		server->set_thread_options(topts);
+	if (signing)
+		server->set_signing(signing);
+	if (tlog)
+		server->set_tlog(tlog);
+
+	return server;
 }
 
 MAVConnInterface::Ptr MAVConnInterface::open_url(std::string url,
@@ -391,6 +1176,10 @@ MAVConnInterface::Ptr MAVConnInterface::open_url(std::string url,
 		return url_parse_serial(path, query, system_id, component_id, false);
 	else if (proto == "serial-hwfc")
 		return url_parse_serial(path, query, system_id, component_id, true);
+	else if (proto == "tlog")
+		return url_parse_tlog(path, query, system_id, component_id);
+	else if (proto == "shm")
+		return url_parse_shm(host, query, system_id, component_id);
 	else
 		throw DeviceError("url", "Unknown URL type");
 }
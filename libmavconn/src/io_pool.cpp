@@ -0,0 +1,76 @@
+/**
+ * @brief MAVConn shared I/O thread pool
+ * @file io_pool.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/io_pool.h>
+
+namespace mavconn {
+
+#define PFX	"mavconn: pool: "
+
+constexpr size_t IOPool::DEFAULT_MAX_THREADS;
+std::mutex IOPool::shared_mutex;
+IOPool::Ptr IOPool::shared_pool;
+
+
+IOPool::IOPool(size_t nthreads) :
+	io_service(std::make_shared<boost::asio::io_service>()),
+	io_work(new boost::asio::io_service::work(*io_service))
+{
+	if (nthreads == 0) {
+		nthreads = std::thread::hardware_concurrency();
+		nthreads = std::max<size_t>(1, std::min<size_t>(nthreads, DEFAULT_MAX_THREADS));
+	}
+
+	CONSOLE_BRIDGE_logInform(PFX "Starting %zu I/O threads", nthreads);
+
+	for (size_t i = 0; i < nthreads; i++) {
+		auto ios = io_service;
+		threads.emplace_back([ios, i] () {
+					utils::set_this_thread_name("mpool%zu", i);
+					ios->run();
+				});
+	}
+}
+
+IOPool::~IOPool()
+{
+	io_work.reset();
+	io_service->stop();
+
+	for (auto &thd : threads) {
+		// can not join self, that thread finishes after handler returns
+		if (thd.get_id() == std::this_thread::get_id())
+			thd.detach();
+		else if (thd.joinable())
+			thd.join();
+	}
+}
+
+IOPool::Ptr IOPool::get_shared(size_t nthreads)
+{
+	std::lock_guard<std::mutex> lock(shared_mutex);
+
+	if (!shared_pool)
+		shared_pool = std::make_shared<IOPool>(nthreads);
+
+	return shared_pool;
+}
+}	// namespace mavconn
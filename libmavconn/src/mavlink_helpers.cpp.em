@@ -20,6 +20,8 @@
 @# EmPy template of dialect helpers source file
 @#
 
+#include <map>
+#include <algorithm>
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/interface.h>
 
@@ -30,11 +32,14 @@ using mavconn::MAVConnInterface;
 
 void MAVConnInterface::init_msg_entry()
 {
-	CONSOLE_BRIDGE_logDebug("mavconn: Initialize message_entries map");
+	CONSOLE_BRIDGE_logDebug("mavconn: Initialize message entry tables");
+
+	// sorted, so sparse table can be filled in order
+	std::map<mavlink::msgid_t, const mavlink::mavlink_msg_entry_t*> entries;
 
 	auto load = [&](const char *dialect, const mavlink::mavlink_msg_entry_t & e) {
-		auto it = message_entries.find(e.msgid);
-		if (it != message_entries.end()) {
+		auto it = entries.find(e.msgid);
+		if (it != entries.end()) {
 			if (memcmp(&e, it->second, sizeof(e)) != 0) {
 				CONSOLE_BRIDGE_logDebug("mavconn: init: message from %s, MSG-ID %d ignored! Table has different entry.", dialect, e.msgid);
 			}
@@ -44,12 +49,19 @@ void MAVConnInterface::init_msg_entry()
 		}
 		else {
 			CONSOLE_BRIDGE_logDebug("mavconn: init: add message entry for %s, MSG-ID %d", dialect, e.msgid);
-			message_entries[e.msgid] = &e;
+			entries[e.msgid] = &e;
 		}
 	};
 
 	@[for dialect in MAVLINK_V20_DIALECTS]for (auto &e : mavlink::@dialect::MESSAGE_ENTRIES) @(' ' * (20 - len(dialect))) load("@dialect", e);
 	@[end for]
+
+	for (auto &kv : entries) {
+		if (kv.first < MSG_ENTRY_DIRECT_SIZE)
+			message_entries_direct[kv.first] = kv.second;
+		else
+			message_entries_sparse.push_back(kv.second);
+	}
 }
 
 std::vector<std::string> MAVConnInterface::get_known_dialects()
@@ -65,9 +77,14 @@ std::vector<std::string> MAVConnInterface::get_known_dialects()
  */
 const mavlink::mavlink_msg_entry_t* mavlink::mavlink_get_msg_entry(uint32_t msgid)
 {
-	auto it = MAVConnInterface::message_entries.find(msgid);
-	if (it != MAVConnInterface::message_entries.end())
-		return it->second;
+	if (msgid < MAVConnInterface::MSG_ENTRY_DIRECT_SIZE)
+		return MAVConnInterface::message_entries_direct[msgid];
+
+	auto &sparse = MAVConnInterface::message_entries_sparse;
+	auto it = std::lower_bound(sparse.begin(), sparse.end(), msgid,
+			[](const mavlink::mavlink_msg_entry_t *e, uint32_t id) { return e->msgid < id; });
+	if (it != sparse.end() && (*it)->msgid == msgid)
+		return *it;
 	else
 		return nullptr;
 }
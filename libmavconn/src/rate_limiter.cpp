@@ -0,0 +1,189 @@
+/**
+ * @brief MAVConn Tx rate limiter
+ * @file rate_limiter.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+
+#include <mavconn/rate_limiter.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+//! budget scale limits and steps, similar to ArduPilot stream slowdown on RADIO_STATUS
+static constexpr float MIN_BUDGET_SCALE = 0.1;
+static constexpr uint8_t TXBUF_LOW = 20;
+static constexpr uint8_t TXBUF_MEDIUM = 50;
+static constexpr uint8_t TXBUF_HIGH = 90;
+
+
+static void sort_unique(std::vector<msgid_t> &v)
+{
+	std::sort(v.begin(), v.end());
+	v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+static bool contains(const std::vector<msgid_t> &v, msgid_t msgid)
+{
+	return std::binary_search(v.begin(), v.end(), msgid);
+}
+
+TxRateLimiter::TxRateLimiter() :
+	byte_rate(0),
+	burst_bytes(0),
+	budget_scale(1.0),
+	tokens(0),
+	last_refill(clock::now()),
+	stat{}
+{ }
+
+void TxRateLimiter::set_byte_rate(float bytes_per_sec, float burst_sec)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	byte_rate = std::max(0.0f, bytes_per_sec);
+	// bucket should hold at least one biggest frame
+	burst_bytes = std::max<float>(byte_rate * burst_sec, MAVLINK_MAX_PACKET_LEN);
+	tokens = burst_bytes;
+	last_refill = clock::now();
+}
+
+void TxRateLimiter::set_msg_rate(msgid_t msgid, float rate_hz)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (rate_hz <= 0) {
+		msg_rates.erase(msgid);
+		return;
+	}
+
+	auto period = std::chrono::duration_cast<clock::duration>(
+			std::chrono::duration<float>(1.0 / rate_hz));
+	msg_rates[msgid] = MsgRate{period, clock::time_point()};
+}
+
+void TxRateLimiter::set_allow(std::vector<msgid_t> msgids)
+{
+	sort_unique(msgids);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	allow = std::move(msgids);
+}
+
+void TxRateLimiter::set_deny(std::vector<msgid_t> msgids)
+{
+	sort_unique(msgids);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	deny = std::move(msgids);
+}
+
+void TxRateLimiter::set_priority(std::vector<msgid_t> msgids)
+{
+	sort_unique(msgids);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	priority = std::move(msgids);
+}
+
+void TxRateLimiter::update_link_budget(uint8_t txbuf)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (txbuf < TXBUF_LOW)
+		budget_scale *= 0.5;
+	else if (txbuf < TXBUF_MEDIUM)
+		budget_scale *= 0.9;
+	else if (txbuf > TXBUF_HIGH)
+		budget_scale *= 1.1;
+
+	budget_scale = std::min(1.0f, std::max(MIN_BUDGET_SCALE, budget_scale));
+}
+
+size_t TxRateLimiter::frame_size(const mavlink_message_t *msg)
+{
+	if (msg->magic == MAVLINK_STX_MAVLINK1)
+		return MAVLINK_NUM_NON_PAYLOAD_BYTES - 4 + msg->len;	// v1.0 header has no flags and 1 byte msgid
+
+	size_t sz = MAVLINK_NUM_NON_PAYLOAD_BYTES + msg->len;
+	if (msg->incompat_flags & MAVLINK_IFLAG_SIGNED)
+		sz += MAVLINK_SIGNATURE_BLOCK_LEN;
+
+	return sz;
+}
+
+bool TxRateLimiter::check_budget(const mavlink_message_t *msg, clock::time_point now)
+{
+	if (byte_rate <= 0)
+		return true;
+
+	const float dt = std::chrono::duration<float>(now - last_refill).count();
+	if (dt > 0) {
+		tokens = std::min(burst_bytes, tokens + dt * byte_rate * budget_scale);
+		last_refill = now;
+	}
+
+	const float size = frame_size(msg);
+	if (tokens >= size || contains(priority, msg->msgid)) {
+		// priority message may take budget in advance
+		tokens -= size;
+		return true;
+	}
+
+	return false;
+}
+
+bool TxRateLimiter::accept(const mavlink_message_t *msg, clock::time_point now)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if ((!allow.empty() && !contains(allow, msg->msgid)) || contains(deny, msg->msgid)) {
+		stat.denied++;
+		return false;
+	}
+
+	auto it = msg_rates.find(msg->msgid);
+	if (it != msg_rates.end() && now < it->second.next) {
+		stat.decimated++;
+		return false;
+	}
+
+	if (!check_budget(msg, now)) {
+		stat.dropped++;
+		return false;
+	}
+
+	if (it != msg_rates.end()) {
+		// keep average rate, but do not accumulate burst after pause
+		auto &r = it->second;
+		r.next = (now - r.next < r.period) ? r.next + r.period : now + r.period;
+	}
+
+	stat.passed++;
+	return true;
+}
+
+TxRateLimiter::Stat TxRateLimiter::get_stat()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto st = stat;
+	st.budget_scale = budget_scale;
+	return st;
+}
+
+}	// namespace mavconn
@@ -0,0 +1,201 @@
+/**
+ * @brief MAVConn message router
+ * @file router.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2014,2015,2016 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cassert>
+#include <stdexcept>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/router.h>
+
+namespace mavconn {
+
+#define PFX	"mavconn: router: "
+
+using mavlink::mavlink_message_t;
+
+constexpr size_t Router::MAX_ENDPOINTS;
+
+
+Router::Endpoint::Endpoint(MAVConnInterface::Ptr link_, bool own_rx_) :
+	link(link_),
+	own_rx(own_rx_),
+	rx(0),
+	tx(0),
+	filtered(0),
+	overflow(0)
+{ }
+
+Router::Router() :
+	started(false),
+	systems{}
+{ }
+
+Router::~Router()
+{
+	// stop links which call route() from our callback
+	for (auto &ep : endpoints) {
+		if (started && ep->own_rx)
+			ep->link->close();
+	}
+}
+
+size_t Router::add_endpoint(MAVConnInterface::Ptr link, bool own_rx)
+{
+	assert(!started);
+
+	if (endpoints.size() >= MAX_ENDPOINTS)
+		throw std::length_error("Router: too many endpoints");
+
+	endpoints.emplace_back(new Endpoint(link, own_rx));
+	return endpoints.size() - 1;
+}
+
+void Router::set_tx_filter(size_t ep, FilterCb cb)
+{
+	assert(!started);
+
+	endpoints.at(ep)->filter = cb;
+}
+
+void Router::start()
+{
+	started = true;
+
+	for (size_t i = 0; i < endpoints.size(); i++) {
+		auto &ep = *endpoints[i];
+		if (!ep.own_rx)
+			continue;
+
+		ep.link->message_received_cb = [this, i](const mavlink_message_t *msg, const Framing framing) {
+			route(i, msg, framing);
+		};
+	}
+
+	CONSOLE_BRIDGE_logInform(PFX "%zu endpoints", endpoints.size());
+}
+
+void Router::get_targets(const mavlink_message_t *msg, uint8_t &sysid, uint8_t &compid)
+{
+	sysid = 0;
+	compid = 0;
+
+	auto e = mavlink::mavlink_get_msg_entry(msg->msgid);
+	if (e == nullptr)
+		return;
+
+	// v2.0 payload may be trimmed, missing bytes are zero
+	auto payload = reinterpret_cast<const uint8_t *>(msg->payload64);
+	if ((e->flags & MAVLINK_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) && e->target_system_ofs < msg->len)
+		sysid = payload[e->target_system_ofs];
+	if ((e->flags & MAVLINK_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) && e->target_component_ofs < msg->len)
+		compid = payload[e->target_component_ofs];
+}
+
+Router::EndpointMask Router::find_target(uint8_t sysid, uint8_t compid)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (compid != 0) {
+		auto it = components.find(uint16_t(sysid) << 8 | compid);
+		if (it != components.end())
+			return it->second;
+	}
+
+	return systems[sysid];
+}
+
+void Router::learn(size_t src, const mavlink_message_t *msg)
+{
+	const EndpointMask bit = EndpointMask(1) << src;
+	const uint16_t key = uint16_t(msg->sysid) << 8 | msg->compid;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto &mask = components[key];
+	if (mask & bit)
+		return;
+
+	mask |= bit;
+	systems[msg->sysid] |= bit;
+
+	CONSOLE_BRIDGE_logInform(PFX "component %u.%u seen on endpoint %zu", msg->sysid, msg->compid, src);
+}
+
+void Router::route(size_t src, const mavlink_message_t *msg, const Framing framing)
+{
+	auto &src_ep = *endpoints[src];
+	src_ep.rx.fetch_add(1, std::memory_order_relaxed);
+
+	// signing rejected it: forwarded to signed link it would get our signature
+	if (framing == Framing::bad_signature)
+		return;
+
+	// ids of broken frame can not be trusted
+	if (framing == Framing::ok)
+		learn(src, msg);
+
+	const EndpointMask all = ((endpoints.size() < MAX_ENDPOINTS) ?
+			(EndpointMask(1) << endpoints.size()) - 1 : ~EndpointMask(0));
+	const EndpointMask src_bit = EndpointMask(1) << src;
+
+	uint8_t tgt_sysid, tgt_compid;
+	get_targets(msg, tgt_sysid, tgt_compid);
+
+	EndpointMask dst = all;
+	if (tgt_sysid != 0) {
+		auto known = find_target(tgt_sysid, tgt_compid);
+		if (known != 0)
+			dst = known;
+	}
+
+	dst &= ~src_bit;
+
+	for (size_t i = 0; dst != 0; i++, dst >>= 1) {
+		if (dst & 1)
+			send_to(*endpoints[i], msg);
+	}
+}
+
+void Router::send_to(Endpoint &ep, const mavlink_message_t *msg)
+{
+	if (ep.filter && !ep.filter(msg)) {
+		ep.filtered.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	try {
+		ep.link->send_message(msg);
+		ep.tx.fetch_add(1, std::memory_order_relaxed);
+	}
+	catch (std::length_error &) {
+		ep.overflow.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+Router::Stat Router::get_stat(size_t ep) const
+{
+	auto &e = *endpoints.at(ep);
+
+	return Stat {
+		e.rx.load(std::memory_order_relaxed),
+		e.tx.load(std::memory_order_relaxed),
+		e.filtered.load(std::memory_order_relaxed),
+		e.overflow.load(std::memory_order_relaxed),
+	};
+}
+
+}	// namespace mavconn
@@ -16,6 +16,11 @@
  */
 
 #include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <fstream>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/thread_utils.h>
@@ -36,18 +41,28 @@ using mavlink::mavlink_message_t;
 #define PFX	"mavconn: serial"
 #define PFXd	PFX "%zu: "
 
+constexpr size_t MAVConnSerial::MAX_RX_BUFFER;
+
 
 MAVConnSerial::MAVConnSerial(uint8_t system_id, uint8_t component_id,
-		std::string device, unsigned baudrate, bool hwflow) :
+		std::string device, unsigned baudrate, bool hwflow,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
+	io_pool(io_pool_),
+	own_io_service(io_pool ? nullptr : new boost::asio::io_service()),
+	io_service(io_pool ? io_pool->get_io_service() : *own_io_service),
+	strand(io_service),
+	serial_dev(io_service),
 	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	io_service(),
-	serial_dev(io_service)
+	tx_q(MAX_TXQ_SIZE),
+	rx_buf(MsgBuffer::MAX_SIZE),
+	rx_buf_size(MsgBuffer::MAX_SIZE),
+	device_path(device)
 {
 	using SPB = boost::asio::serial_port_base;
 
+	tx_iov.reserve(TxQueue::MAX_GATHER);
+
 	CONSOLE_BRIDGE_logInform(PFXd "device: %s @ %d bps", conn_id, device.c_str(), baudrate);
 
 	try {
@@ -89,19 +104,7 @@ MAVConnSerial::MAVConnSerial(uint8_t system_id, uint8_t component_id,
 		}
 #endif
 
-#if defined(__linux__)
-		// Enable low latency mode on Linux
-		{
-			int fd = serial_dev.native_handle();
-
-			struct serial_struct ser_info;
-			ioctl(fd, TIOCGSERIAL, &ser_info);
-
-			ser_info.flags |= ASYNC_LOW_LATENCY;
-
-			ioctl(fd, TIOCSSERIAL, &ser_info);
-		}
-#endif
+		set_low_latency(true);
 	}
 	catch (boost::system::system_error &err) {
 		throw DeviceError("serial", err);
@@ -109,14 +112,17 @@ MAVConnSerial::MAVConnSerial(uint8_t system_id, uint8_t component_id,
 
 	// NOTE: shared_from_this() should not be used in constructors
 
-	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnSerial::do_read, this));
+	// run io_service for async io, link on pool waits for start()
+	if (own_io_service) {
+		// give some work to io_service before start
+		// (raw this is fine: close() joins that thread)
+		strand.post(std::bind(&MAVConnSerial::do_start, this));
 
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mserial%zu", conn_id);
-				io_service.run();
-			});
+		io_thread = std::thread([this] () {
+					utils::set_this_thread_name("mserial%zu", conn_id);
+					io_service_run(io_service);
+				});
+	}
 }
 
 MAVConnSerial::~MAVConnSerial()
@@ -133,12 +139,16 @@ void MAVConnSerial::close()
 	serial_dev.cancel();
 	serial_dev.close();
 
-	io_service.stop();
+	// pooled link: pending handlers complete with operation_aborted,
+	// they hold shared_ptr of link, so destructor never races with them
+	if (own_io_service) {
+		io_service.stop();
 
-	if (io_thread.joinable())
-		io_thread.join();
+		if (io_thread.joinable())
+			io_thread.join();
 
-	io_service.reset();
+		io_service.reset();
+	}
 
 	if (port_closed_cb)
 		port_closed_cb();
@@ -154,12 +164,113 @@ void MAVConnSerial::send_bytes(const uint8_t *bytes, size_t length)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		if (!tx_q.push(bytes, length))
 			throw std::length_error("MAVConnSerial::send_bytes: TX queue overflow");
+	}
+	strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+}
+
+bool MAVConnSerial::set_low_latency(bool enable)
+{
+#if defined(__linux__)
+	int fd = serial_dev.native_handle();
 
-		tx_q.emplace_back(bytes, length);
+	struct serial_struct ser_info {};
+	if (ioctl(fd, TIOCGSERIAL, &ser_info) < 0) {
+		// not a UART driver (e.g. CDC ACM on older kernels, pty)
+		CONSOLE_BRIDGE_logDebug(PFXd "low latency: TIOCGSERIAL: %s", conn_id, strerror(errno));
+		return !enable;
 	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+
+	if (enable)
+		ser_info.flags |= ASYNC_LOW_LATENCY;
+	else
+		ser_info.flags &= ~ASYNC_LOW_LATENCY;
+
+	if (ioctl(fd, TIOCSSERIAL, &ser_info) < 0) {
+		CONSOLE_BRIDGE_logWarn(PFXd "low latency: TIOCSSERIAL: %s", conn_id, strerror(errno));
+		return false;
+	}
+
+	if (!enable)
+		return true;
+
+	// ftdi_sio applies flag to its latency timer, check it took effect
+	char real[PATH_MAX];
+	if (::realpath(device_path.c_str(), real)) {
+		std::string name(real);
+		name = name.substr(name.rfind('/') + 1);
+
+		std::ifstream timer("/sys/bus/usb-serial/devices/" + name + "/latency_timer");
+		int latency_ms = 0;
+		if (timer >> latency_ms) {
+			if (latency_ms > 1)
+				CONSOLE_BRIDGE_logWarn(PFXd "USB serial latency timer is %d ms, "
+						"write 1 to /sys/bus/usb-serial/devices/%s/latency_timer",
+						conn_id, latency_ms, name.c_str());
+			else
+				CONSOLE_BRIDGE_logInform(PFXd "USB serial latency timer: %d ms", conn_id, latency_ms);
+		}
+	}
+
+	return true;
+#else
+	return !enable;
+#endif
+}
+
+bool MAVConnSerial::set_serial_options(const SerialOptions &opts)
+{
+	bool ret = true;
+
+	lock_guard lock(mutex);
+	if (!is_open())
+		return false;
+
+	if (!set_low_latency(opts.low_latency))
+		ret = false;
+
+	if (opts.vmin >= 0 || opts.vtime >= 0) {
+		int fd = serial_dev.native_handle();
+
+		termios tio;
+		bool ok = tcgetattr(fd, &tio) == 0;
+		if (ok) {
+			if (opts.vmin >= 0)
+				tio.c_cc[VMIN] = std::min(opts.vmin, 255);
+			if (opts.vtime >= 0)
+				tio.c_cc[VTIME] = std::min(opts.vtime, 255);
+			ok = tcsetattr(fd, TCSANOW, &tio) == 0;
+		}
+
+		if (!ok) {
+			CONSOLE_BRIDGE_logWarn(PFXd "termios VMIN/VTIME: %s", conn_id, strerror(errno));
+			ret = false;
+		}
+		else {
+			CONSOLE_BRIDGE_logInform(PFXd "termios VMIN %u VTIME %u", conn_id,
+					unsigned(tio.c_cc[VMIN]), unsigned(tio.c_cc[VTIME]));
+		}
+	}
+
+	if (opts.rx_buffer > 0) {
+		const size_t size = std::max<size_t>(std::min(opts.rx_buffer, MAX_RX_BUFFER), MsgBuffer::MAX_SIZE);
+		rx_buf_size = size;
+		CONSOLE_BRIDGE_logInform(PFXd "read size: %zu bytes", conn_id, size);
+	}
+
+	return ret;
+}
+
+bool MAVConnSerial::set_thread_options(const ThreadOptions &opts)
+{
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+MAVConnInterface::TxStat MAVConnSerial::get_tx_stat()
+{
+	lock_guard lock(mutex);
+	return tx_q.get_stat();
 }
 
 void MAVConnSerial::send_message(const mavlink_message_t *message)
@@ -176,12 +287,13 @@ void MAVConnSerial::send_message(const mavlink_message_t *message)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
+		iostat_tx_msg(message->msgid, buf->len);
 	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
 }
 
 void MAVConnSerial::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -196,29 +308,63 @@ void MAVConnSerial::send_message(const mavlink::Message &message, const uint8_t
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_status_p(), sys_id, source_compid, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnSerial::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
+		iostat_tx_msg(message.get_message_id(), buf->len);
+	}
+	strand.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+}
+
+void MAVConnSerial::do_start()
+{
+	// own thread only: constructor posts that before make_shared() is finished
+	try {
+		shared_from_this();
 	}
-	io_service.post(std::bind(&MAVConnSerial::do_write, shared_from_this(), true));
+	catch (std::bad_weak_ptr &) {
+		strand.post(std::bind(&MAVConnSerial::do_start, this));
+		return;
+	}
+
+	do_read();
+}
+
+void MAVConnSerial::start()
+{
+	// own thread link started by constructor
+	if (!io_pool)
+		return;
+
+	// every pooled handler owns the link, so none may run after destruction
+	std::call_once(start_flag, [this]() {
+				strand.post(std::bind(&MAVConnSerial::do_read, shared_from_this()));
+			});
 }
 
 void MAVConnSerial::do_read(void)
 {
+	// no read in flight here: safe to reallocate
+	const size_t size = rx_buf_size;
+	if (rx_buf.size() != size)
+		rx_buf.resize(size);
+
 	auto sthis = shared_from_this();
 	serial_dev.async_read_some(
 			buffer(rx_buf),
-			[sthis] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
+				sthis->stamp_rx_now();
+				sthis->iostat_rx_read(sthis->rx_stamp_ns);
 				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
 				sthis->do_read();
-			});
+			}));
 }
 
 void MAVConnSerial::do_write(bool check_tx_state)
@@ -231,13 +377,18 @@ void MAVConnSerial::do_write(bool check_tx_state)
 		return;
 
 	tx_in_progress = true;
+
+	// gather queued buffers into one vectored write
+	tx_iov.clear();
+	for (size_t i = 0; i < tx_q.size() && i < TxQueue::MAX_GATHER; i++) {
+		auto &buf = tx_q.at(i);
+		tx_iov.emplace_back(buf.dpos(), buf.nbytes());
+	}
+
 	auto sthis = shared_from_this();
-	auto &buf_ref = tx_q.front();
 	serial_dev.async_write_some(
-			buffer(buf_ref.dpos(), buf_ref.nbytes()),
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
-				assert(bytes_transferred <= buf_ref.len);
-
+			tx_iov,
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "write: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
@@ -252,15 +403,12 @@ void MAVConnSerial::do_write(bool check_tx_state)
 					return;
 				}
 
-				buf_ref.pos += bytes_transferred;
-				if (buf_ref.nbytes() == 0) {
-					sthis->tx_q.pop_front();
-				}
+				sthis->tx_q.consume(bytes_transferred);
 
 				if (!sthis->tx_q.empty())
 					sthis->do_write(false);
 				else
 					sthis->tx_in_progress = false;
-			});
+			}));
 }
 }	// namespace mavconn
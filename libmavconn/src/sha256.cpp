@@ -0,0 +1,259 @@
+/**
+ * @brief MAVConn SHA-256 for MAVLink 2 signing
+ * @file sha256.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cstring>
+
+#include <mavconn/sha256.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MAVCONN_SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__linux__) && (defined(__clang__) || __GNUC__ >= 10)
+// older GCC arm_neon.h hides crypto intrinsics unless whole unit built with +crypto
+#define MAVCONN_SHA256_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace mavconn {
+namespace sha256 {
+
+alignas(16) static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror(uint32_t x, unsigned n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+void compress_generic(State &state, const uint8_t *blocks, size_t nblocks)
+{
+	for (; nblocks > 0; nblocks--, blocks += BLOCK_LEN) {
+		uint32_t w[64];
+		for (size_t i = 0; i < 16; i++) {
+			const uint8_t *p = blocks + 4 * i;
+			w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+		}
+		for (size_t i = 16; i < 64; i++) {
+			const uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			const uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+		uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+		for (size_t i = 0; i < 64; i++) {
+			const uint32_t s1 = ror(e, 6) ^ ror(e, 11) ^ ror(e, 25);
+			const uint32_t ch = (e & f) ^ (~e & g);
+			const uint32_t t1 = h + s1 + ch + K[i] + w[i];
+			const uint32_t s0 = ror(a, 2) ^ ror(a, 13) ^ ror(a, 22);
+			const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+			const uint32_t t2 = s0 + maj;
+
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+	}
+}
+
+#ifdef MAVCONN_SHA256_X86
+__attribute__((target("sha,sse4.1")))
+static void compress_shani(State &state, const uint8_t *blocks, size_t nblocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	// SHA-NI keeps state as ABEF and CDGH
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xb1);
+	__m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1b);
+	__m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; nblocks > 0; nblocks--, blocks += BLOCK_LEN) {
+		const __m128i abef_save = abef;
+		const __m128i cdgh_save = cdgh;
+
+		__m128i msg[4];
+		for (size_t i = 0; i < 4; i++)
+			msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + 16 * i)), bswap);
+
+		// 16 groups of 4 rounds, schedule of group g + 4 computed in group g
+		for (size_t g = 0; g < 16; g++) {
+			const __m128i wk = _mm_add_epi32(msg[g & 3], _mm_load_si128(reinterpret_cast<const __m128i *>(&K[4 * g])));
+
+			if (g < 12) {
+				__m128i next = _mm_sha256msg1_epu32(msg[g & 3], msg[(g + 1) & 3]);
+				next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(g + 3) & 3], msg[(g + 2) & 3], 4));
+				msg[g & 3] = _mm_sha256msg2_epu32(next, msg[(g + 3) & 3]);
+			}
+
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	abef = _mm_blend_epi16(tmp, cdgh, 0xf0);
+	cdgh = _mm_alignr_epi8(cdgh, tmp, 8);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), abef);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), cdgh);
+}
+
+static bool have_shani()
+{
+	unsigned a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1) || !(c & bit_SSSE3))
+		return false;
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		return false;
+	return b & (1u << 29);
+}
+#endif
+
+#ifdef MAVCONN_SHA256_ARMV8
+#ifdef __clang__
+__attribute__((target("crypto")))
+#else
+__attribute__((target("+crypto")))
+#endif
+static void compress_armv8(State &state, const uint8_t *blocks, size_t nblocks)
+{
+	uint32x4_t abcd = vld1q_u32(&state[0]);
+	uint32x4_t efgh = vld1q_u32(&state[4]);
+
+	for (; nblocks > 0; nblocks--, blocks += BLOCK_LEN) {
+		const uint32x4_t abcd_save = abcd;
+		const uint32x4_t efgh_save = efgh;
+
+		uint32x4_t msg[4];
+		for (size_t i = 0; i < 4; i++)
+			msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + 16 * i)));
+
+		for (size_t g = 0; g < 16; g++) {
+			const uint32x4_t wk = vaddq_u32(msg[g & 3], vld1q_u32(&K[4 * g]));
+
+			if (g < 12)
+				msg[g & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[g & 3], msg[(g + 1) & 3]),
+						msg[(g + 2) & 3], msg[(g + 3) & 3]);
+
+			const uint32x4_t abcd_prev = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, wk);
+			efgh = vsha256h2q_u32(efgh, abcd_prev, wk);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+
+static bool have_armv8_sha2()
+{
+	return getauxval(AT_HWCAP) & HWCAP_SHA2;
+}
+#endif
+
+using CompressFn = void (*)(State &, const uint8_t *, size_t);
+
+struct Impl {
+	CompressFn fn;
+	const char *name;
+};
+
+static Impl select_impl()
+{
+#ifdef MAVCONN_SHA256_X86
+	if (have_shani())
+		return {compress_shani, "sha-ni"};
+#endif
+#ifdef MAVCONN_SHA256_ARMV8
+	if (have_armv8_sha2())
+		return {compress_armv8, "armv8-ce"};
+#endif
+	return {compress_generic, "generic"};
+}
+
+static const Impl impl = select_impl();
+
+void compress(State &state, const uint8_t *blocks, size_t nblocks)
+{
+	impl.fn(state, blocks, nblocks);
+}
+
+const char *implementation()
+{
+	return impl.name;
+}
+
+size_t pad(uint8_t *buf, size_t len, uint64_t msg_len)
+{
+	const size_t nblocks = (len + 9 + BLOCK_LEN - 1) / BLOCK_LEN;
+	const size_t end = nblocks * BLOCK_LEN;
+	const uint64_t bits = msg_len * 8;
+
+	buf[len] = 0x80;
+	std::memset(buf + len + 1, 0, end - 8 - len - 1);
+	for (size_t i = 0; i < 8; i++)
+		buf[end - 1 - i] = uint8_t(bits >> (8 * i));
+
+	return nblocks;
+}
+
+Digest digest(const uint8_t *data, size_t len)
+{
+	State state = INIT;
+
+	const size_t full = len / BLOCK_LEN;
+	compress(state, data, full);
+
+	uint8_t tail[2 * BLOCK_LEN];
+	const size_t rest = len - full * BLOCK_LEN;
+	std::memcpy(tail, data + full * BLOCK_LEN, rest);
+	compress(state, tail, pad(tail, rest, len));
+
+	Digest out;
+	for (size_t i = 0; i < 8; i++) {
+		out[4 * i + 0] = state[i] >> 24;
+		out[4 * i + 1] = state[i] >> 16;
+		out[4 * i + 2] = state[i] >> 8;
+		out[4 * i + 3] = state[i];
+	}
+
+	return out;
+}
+}	// namespace sha256
+}	// namespace mavconn
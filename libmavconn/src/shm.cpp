@@ -0,0 +1,405 @@
+/**
+ * @brief MAVConn shared memory link
+ * @file shm.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cassert>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/shm.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+#define PFX	"mavconn: shm"
+#define PFXd	PFX "%zu: "
+
+static constexpr uint32_t SHM_MAGIC = 0x4d56534d;	// "MVSM"
+static constexpr uint32_t SHM_VERSION = 1;
+
+//! idle reader wakes that often to notice close()
+static constexpr long FUTEX_TIMEOUT_NS = 100000000;
+//! wait for writer of previous lap of slot, then assume it died
+static constexpr size_t WRITER_SPIN_LIMIT = 1000000;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+		"shared memory atomics should be lock free");
+
+struct MAVConnSHM::Header {
+	std::atomic<uint32_t> magic;	//!< set last by creator
+	uint32_t version;
+	uint32_t nslots;
+	uint32_t slot_size;
+
+	alignas(64) std::atomic<uint64_t> head;		//!< next ticket to claim
+	alignas(64) std::atomic<uint32_t> futex_word;	//!< bumped on every publish
+	std::atomic<uint32_t> waiters;			//!< readers in futex wait
+	std::atomic<uint32_t> next_peer;
+};
+
+struct alignas(64) MAVConnSHM::Slot {
+	//! 2 * ticket + 1 while written, 2 * ticket + 2 when published
+	std::atomic<uint64_t> seq;
+	uint32_t sender;
+	uint16_t len;
+	uint8_t data[MsgBuffer::MAX_SIZE];
+};
+
+size_t MAVConnSHM::slots_offset()
+{
+	return (sizeof(Header) + 63) / 64 * 64;
+}
+
+size_t MAVConnSHM::segment_size(size_t nslots)
+{
+	return slots_offset() + nslots * sizeof(Slot);
+}
+
+#ifdef __linux__
+static inline void futex_wait(std::atomic<uint32_t> *addr, uint32_t val)
+{
+	// shared futex: no FUTEX_PRIVATE_FLAG, waiters are in other processes
+	struct timespec ts = { 0, FUTEX_TIMEOUT_NS };
+	::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT, val, &ts, nullptr, 0);
+}
+
+static inline void futex_wake(std::atomic<uint32_t> *addr)
+{
+	::syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+#endif
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile ("yield");
+#endif
+}
+
+MAVConnSHM::MAVConnSHM(uint8_t system_id, uint8_t component_id,
+		std::string name, size_t nslots) :
+	MAVConnInterface(system_id, component_id),
+	fd(-1),
+	map(nullptr),
+	map_len(0),
+	hdr(nullptr),
+	slots(nullptr),
+	slot_mask(0),
+	peer_id(0),
+	is_open_(false),
+	rx_overruns(0)
+{
+#ifndef __linux__
+	throw DeviceError("shm", "not supported on that system");
+#else
+	if (name.empty() || name.find_first_not_of(
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.-") != std::string::npos)
+		throw DeviceError("shm", "bad segment name");
+	if (nslots < 2 || (nslots & (nslots - 1)) != 0)
+		throw DeviceError("shm", "slots should be power of two");
+
+	const std::string shm_name = "/mavconn." + name;
+
+	bool created = true;
+	fd = ::shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+	if (fd < 0 && errno == EEXIST) {
+		created = false;
+		fd = ::shm_open(shm_name.c_str(), O_RDWR | O_CLOEXEC, 0);
+	}
+	if (fd < 0)
+		throw DeviceError("shm", errno);
+
+	auto fail = [this] (int err) {
+		if (map)
+			::munmap(map, map_len);
+		::close(fd);
+		throw DeviceError("shm", err);
+	};
+
+	if (created) {
+		map_len = segment_size(nslots);
+		// new pages are zero: all atomics start as zero
+		if (::ftruncate(fd, map_len) < 0) {
+			const int err = errno;
+			::shm_unlink(shm_name.c_str());
+			fail(err);
+		}
+	}
+	else {
+		// creator truncates right after shm_open()
+		struct stat st {};
+		for (size_t i = 0; i < 1000; i++) {
+			if (::fstat(fd, &st) < 0)
+				fail(errno);
+			if (size_t(st.st_size) >= sizeof(Header))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		map_len = st.st_size;
+		if (map_len < sizeof(Header))
+			fail(EPROTO);
+	}
+
+	map = ::mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		map = nullptr;
+		fail(errno);
+	}
+
+	hdr = static_cast<Header *>(map);
+	slots = reinterpret_cast<Slot *>(static_cast<uint8_t *>(map) + slots_offset());
+
+	if (created) {
+		hdr->version = SHM_VERSION;
+		hdr->nslots = nslots;
+		hdr->slot_size = sizeof(Slot);
+		hdr->magic.store(SHM_MAGIC, std::memory_order_release);
+	}
+	else {
+		for (size_t i = 0; i < 1000 && hdr->magic.load(std::memory_order_acquire) != SHM_MAGIC; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		if (hdr->magic.load(std::memory_order_acquire) != SHM_MAGIC ||
+				hdr->version != SHM_VERSION ||
+				hdr->slot_size != sizeof(Slot) ||
+				map_len != segment_size(hdr->nslots)) {
+			CONSOLE_BRIDGE_logError(PFX ": %s: incompatible segment, remove /dev/shm%s",
+					name.c_str(), shm_name.c_str());
+			fail(EPROTO);
+		}
+		nslots = hdr->nslots;
+	}
+
+	slot_mask = nslots - 1;
+	peer_id = hdr->next_peer.fetch_add(1) + 1;
+
+	CONSOLE_BRIDGE_logInform(PFXd "%s segment %s, %zu slots, peer %u",
+			conn_id, created ? "created" : "attached", shm_name.c_str(), nslots, peer_id);
+
+	is_open_ = true;
+	io_thread = std::thread([this] () {
+				utils::set_this_thread_name("mshm%zu", conn_id);
+				do_read();
+			});
+#endif
+}
+
+MAVConnSHM::~MAVConnSHM()
+{
+	close();
+
+	if (map)
+		::munmap(map, map_len);
+	if (fd >= 0)
+		::close(fd);
+}
+
+void MAVConnSHM::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!is_open_.exchange(false))
+			return;
+	}
+
+#ifdef __linux__
+	// our reader may sleep, others recheck and sleep again
+	hdr->futex_word.fetch_add(1);
+	futex_wake(&hdr->futex_word);
+#endif
+
+	if (io_thread.joinable())
+		io_thread.join();
+
+	if (port_closed_cb)
+		port_closed_cb();
+}
+
+void MAVConnSHM::push(const uint8_t *frame, size_t len)
+{
+#ifdef __linux__
+	if (!is_open_)
+		return;
+
+	const uint64_t ticket = hdr->head.fetch_add(1);
+	Slot &slot = slots[ticket & slot_mask];
+
+	// writer of previous lap should finish first.
+	// Stuck odd seq means it died in the middle, then slot is ours anyway.
+	const uint64_t prev_done = (ticket > slot_mask) ? 2 * (ticket - slot_mask - 1) + 2 : 0;
+	for (size_t i = 0; i < WRITER_SPIN_LIMIT && slot.seq.load(std::memory_order_acquire) < prev_done; i++)
+		cpu_relax();
+
+	slot.seq.store(2 * ticket + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.sender = peer_id;
+	slot.len = len;
+	std::memcpy(slot.data, frame, len);
+
+	slot.seq.store(2 * ticket + 2, std::memory_order_release);
+
+	// pairs with waiters increment in do_read()
+	hdr->futex_word.fetch_add(1);
+	if (hdr->waiters.load() > 0)
+		futex_wake(&hdr->futex_word);
+
+	iostat_tx_add(len);
+#endif
+}
+
+void MAVConnSHM::send_bytes(const uint8_t *bytes, size_t length)
+{
+	if (length == 0 || length >= size_t(MsgBuffer::MAX_SIZE))
+		throw std::length_error("MAVConnSHM::send_bytes: bad frame length");
+
+	push(bytes, length);
+}
+
+void MAVConnSHM::send_message(const mavlink_message_t *message)
+{
+	assert(message != nullptr);
+
+	log_send(PFX, message);
+
+	MsgBuffer buf(message, get_signing_p());
+	iostat_tx_msg(message->msgid, buf.len);
+	push(buf.data, buf.len);
+}
+
+void MAVConnSHM::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{
+	log_send_obj(PFX, message);
+
+	MsgBuffer buf;
+	{
+		// seq counter
+		std::lock_guard<std::mutex> lock(mutex);
+		buf = MsgBuffer(message, get_status_p(), sys_id, source_compid, get_signing_p());
+	}
+
+	iostat_tx_msg(message.get_message_info().id, buf.len);
+	push(buf.data, buf.len);
+}
+
+bool MAVConnSHM::set_thread_options(const ThreadOptions &opts)
+{
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+void MAVConnSHM::do_read()
+{
+#ifdef __linux__
+	std::array<uint8_t, MsgBuffer::MAX_SIZE> rx_buf;
+
+	// new peer does not see history
+	uint64_t next = hdr->head.load(std::memory_order_acquire);
+	size_t stuck = 0;
+
+	while (is_open_) {
+		Slot &slot = slots[next & slot_mask];
+		const uint64_t expected = 2 * next + 2;
+		const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+
+		if (seq == expected) {
+			const uint32_t sender = slot.sender;
+			const size_t len = std::min<size_t>(slot.len, rx_buf.size());
+			std::memcpy(rx_buf.data(), slot.data, len);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) != expected)
+				continue;	// overwritten while copied, next round sees overrun
+
+			next++;
+			stuck = 0;
+			if (sender == peer_id)
+				continue;
+
+			stamp_rx_now();
+			parse_buffer(PFX, rx_buf.data(), rx_buf.size(), len);
+			continue;
+		}
+
+		if (seq > expected) {
+			// lapped by writers: restart from oldest slot which is surely intact
+			const uint64_t head = hdr->head.load(std::memory_order_acquire);
+			const uint64_t resume = (head > slot_mask) ? head - slot_mask / 2 : 0;
+			if (resume > next) {
+				const size_t lost = resume - next;
+				if (rx_overruns.fetch_add(lost) == 0)
+					CONSOLE_BRIDGE_logWarn(PFXd "reader overrun, %zu frames lost", conn_id, lost);
+				next = resume;
+			}
+			else
+				next++;
+
+			continue;
+		}
+
+		// slot claimed, but not published yet: other writer in the middle of memcpy
+		if (hdr->head.load(std::memory_order_acquire) > next) {
+			if (++stuck > WRITER_SPIN_LIMIT) {
+				CONSOLE_BRIDGE_logWarn(PFXd "slot %llu never published, writer died?",
+						conn_id, (unsigned long long) next);
+				rx_overruns++;
+				next++;
+				stuck = 0;
+			}
+
+			cpu_relax();
+			continue;
+		}
+
+		const auto budget = std::chrono::microseconds(get_busy_poll_us());
+		if (budget.count() > 0) {
+			const auto deadline = steady_clock::now() + budget;
+			while (is_open_ && hdr->head.load(std::memory_order_acquire) <= next &&
+					steady_clock::now() < deadline)
+				cpu_relax();
+
+			if (hdr->head.load(std::memory_order_acquire) > next)
+				continue;
+		}
+
+		hdr->waiters.fetch_add(1);
+		const uint32_t word = hdr->futex_word.load();
+		if (is_open_ && slot.seq.load(std::memory_order_acquire) < expected)
+			futex_wait(&hdr->futex_word, word);
+		hdr->waiters.fetch_sub(1);
+	}
+#endif
+}
+}	// namespace mavconn
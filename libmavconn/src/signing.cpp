@@ -0,0 +1,233 @@
+/**
+ * @brief MAVConn MAVLink 2 message signing
+ * @file signing.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+#include <mavconn/signing.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+//! 2015-01-01 00:00 UTC, unix time
+static constexpr uint64_t SIGNING_EPOCH_S = 1420070400;
+
+//! key + header + payload + CRC + link id + timestamp, padded
+static constexpr size_t HASH_BUF_LEN = 6 * sha256::BLOCK_LEN;
+
+static_assert(Signing::KEY_LEN + MAVLINK_NUM_HEADER_BYTES + MAVLINK_MAX_PAYLOAD_LEN +
+		MAVLINK_NUM_CHECKSUM_BYTES + 7 + 9 <= HASH_BUF_LEN, "hash buffer size");
+
+Signing::Signing(const Key &key_, uint8_t link_id_, bool accept_unsigned_) :
+	key(key_),
+	link_id(link_id_),
+	accept_unsigned(accept_unsigned_),
+	timestamp(clock_timestamp()),
+	streams{},
+	nstreams(0),
+	tx_signed(0),
+	rx_signed(0),
+	rx_unsigned(0),
+	bad_signature(0),
+	replayed(0),
+	unsigned_rejected(0)
+{ }
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	else if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	else if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	else
+		return -1;
+}
+
+Signing::Key Signing::parse_key(const std::string &str)
+{
+	Key k;
+
+	bool is_hex = str.size() == 2 * KEY_LEN;
+	for (size_t i = 0; is_hex && i < KEY_LEN; i++) {
+		const int hi = hex_digit(str[2 * i]);
+		const int lo = hex_digit(str[2 * i + 1]);
+		is_hex = hi >= 0 && lo >= 0;
+		k[i] = (hi << 4) | lo;
+	}
+
+	if (!is_hex)
+		k = sha256::digest(reinterpret_cast<const uint8_t *>(str.data()), str.size());
+
+	return k;
+}
+
+uint64_t Signing::clock_timestamp()
+{
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	return (uint64_t(us) - SIGNING_EPOCH_S * 1000000) / 10;
+}
+
+uint64_t Signing::next_timestamp()
+{
+	// unique per frame, but not behind the clock: other side tolerates a minute for new streams
+	const uint64_t now = clock_timestamp();
+	uint64_t cur = timestamp.load(std::memory_order_relaxed);
+	uint64_t next;
+	do {
+		next = std::max(cur + 1, now);
+	} while (!timestamp.compare_exchange_weak(cur, next, std::memory_order_relaxed));
+
+	return next;
+}
+
+void Signing::signature(const uint8_t *header, const uint8_t *payload, size_t payload_len,
+		const uint8_t *crc, const uint8_t *tail, uint8_t *out) const
+{
+	alignas(16) uint8_t buf[HASH_BUF_LEN];
+	uint8_t *p = buf;
+
+	std::memcpy(p, key.data(), KEY_LEN);
+	p += KEY_LEN;
+	std::memcpy(p, header, MAVLINK_NUM_HEADER_BYTES);
+	p += MAVLINK_NUM_HEADER_BYTES;
+	std::memcpy(p, payload, payload_len);
+	p += payload_len;
+	std::memcpy(p, crc, MAVLINK_NUM_CHECKSUM_BYTES);
+	p += MAVLINK_NUM_CHECKSUM_BYTES;
+	std::memcpy(p, tail, 7);
+	p += 7;
+
+	sha256::State state = sha256::INIT;
+	sha256::compress(state, buf, sha256::pad(buf, p - buf));
+
+	// first 48 bits of digest
+	for (size_t i = 0; i < 4; i++)
+		out[i] = state[0] >> (24 - 8 * i);
+	out[4] = state[1] >> 24;
+	out[5] = state[1] >> 16;
+}
+
+size_t Signing::sign_frame(uint8_t *frame, size_t len, uint8_t crc_extra)
+{
+	assert(frame[0] == MAVLINK_STX && !(frame[2] & MAVLINK_IFLAG_SIGNED));
+
+	const size_t payload_len = frame[1];
+	uint8_t *crc = frame + MAVLINK_NUM_HEADER_BYTES + payload_len;
+	assert(len == MAVLINK_NUM_HEADER_BYTES + payload_len + MAVLINK_NUM_CHECKSUM_BYTES);
+
+	// incompat flags are covered by CRC
+	frame[2] |= MAVLINK_IFLAG_SIGNED;
+	uint16_t ck = mavlink::crc_calculate(frame + 1, MAVLINK_NUM_HEADER_BYTES - 1 + payload_len);
+	mavlink::crc_accumulate(crc_extra, &ck);
+	crc[0] = ck & 0xff;
+	crc[1] = ck >> 8;
+
+	uint8_t *sig = crc + MAVLINK_NUM_CHECKSUM_BYTES;
+	const uint64_t ts = next_timestamp();
+	sig[0] = link_id;
+	for (size_t i = 0; i < 6; i++)
+		sig[1 + i] = ts >> (8 * i);
+
+	signature(frame, frame + MAVLINK_NUM_HEADER_BYTES, payload_len, crc, sig, sig + 7);
+
+	tx_signed.fetch_add(1, std::memory_order_relaxed);
+	return len + SIGNATURE_LEN;
+}
+
+bool Signing::check(const mavlink_message_t &msg)
+{
+	if (msg.magic != MAVLINK_STX || !(msg.incompat_flags & MAVLINK_IFLAG_SIGNED)) {
+		if (accept_unsigned || msg.msgid == mavlink::common::msg::RADIO_STATUS::MSG_ID) {
+			rx_unsigned.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		unsigned_rejected.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	const uint8_t header[MAVLINK_NUM_HEADER_BYTES] = {
+		msg.magic, msg.len, msg.incompat_flags, msg.compat_flags,
+		msg.seq, msg.sysid, msg.compid,
+		uint8_t(msg.msgid), uint8_t(msg.msgid >> 8), uint8_t(msg.msgid >> 16)
+	};
+
+	uint8_t expected[6];
+	signature(header, reinterpret_cast<const uint8_t *>(_MAV_PAYLOAD(&msg)), msg.len,
+			msg.ck, msg.signature, expected);
+	if (std::memcmp(expected, msg.signature + 7, sizeof(expected)) != 0) {
+		bad_signature.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint64_t ts = 0;
+	for (size_t i = 0; i < 6; i++)
+		ts |= uint64_t(msg.signature[1 + i]) << (8 * i);
+
+	const uint32_t skey = (uint32_t(msg.sysid) << 16) | (uint32_t(msg.compid) << 8) | msg.signature[0];
+	Stream *stream = nullptr;
+	for (size_t i = 0; i < nstreams; i++) {
+		if (streams[i].key == skey) {
+			stream = &streams[i];
+			break;
+		}
+	}
+
+	if (stream) {
+		if (ts <= stream->timestamp) {
+			replayed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	else {
+		if (nstreams == streams.size() || ts + NEW_STREAM_WINDOW < get_timestamp()) {
+			replayed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		stream = &streams[nstreams++];
+		stream->key = skey;
+	}
+
+	stream->timestamp = ts;
+
+	// our clock may be behind: keep sent timestamps ahead of what peers use
+	uint64_t cur = timestamp.load(std::memory_order_relaxed);
+	while (ts > cur && !timestamp.compare_exchange_weak(cur, ts, std::memory_order_relaxed)) { }
+
+	rx_signed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+Signing::Stat Signing::get_stat() const
+{
+	Stat s;
+	s.tx_signed = tx_signed.load(std::memory_order_relaxed);
+	s.rx_signed = rx_signed.load(std::memory_order_relaxed);
+	s.rx_unsigned = rx_unsigned.load(std::memory_order_relaxed);
+	s.bad_signature = bad_signature.load(std::memory_order_relaxed);
+	s.replayed = replayed.load(std::memory_order_relaxed);
+	s.unsigned_rejected = unsigned_rejected.load(std::memory_order_relaxed);
+	return s;
+}
+}	// namespace mavconn
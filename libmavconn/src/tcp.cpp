@@ -15,19 +15,13 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <map>
 #include <cassert>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/thread_utils.h>
 #include <mavconn/tcp.h>
 
-// Ensure the correct io_service() is called based on boost version
-#if BOOST_VERSION >= 107000
-#define GET_IO_SERVICE(s) ((boost::asio::io_context&)(s).get_executor().context())
-#else
-#define GET_IO_SERVICE(s) ((s).get_io_service())
-#endif
-
 namespace mavconn {
 
 using boost::system::error_code;
@@ -75,16 +69,22 @@ static bool resolve_address_tcp(io_service &io, size_t chan, std::string host, u
 /* -*- TCP client variant -*- */
 
 MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
-		std::string server_host, unsigned short server_port) :
+		std::string server_host, unsigned short server_port,
+		IOPool::Ptr io_pool_) :
 	MAVConnInterface(system_id, component_id),
+	io_pool(io_pool_),
+	own_io_service(io_pool ? nullptr : new boost::asio::io_service()),
+	io_service(io_pool ? io_pool->get_io_service() : *own_io_service),
+	strand(io_service),
+	io_work(own_io_service ? new io_service::work(io_service) : nullptr),
+	socket(io_service),
 	is_destroying(false),
 	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	io_service(),
-	io_work(new io_service::work(io_service)),
-	socket(io_service)
+	tx_q(MAX_TXQ_SIZE),
+	rx_buf {}
 {
+	tx_iov.reserve(TxQueue::MAX_GATHER);
+
 	if (!resolve_address_tcp(io_service, conn_id, server_host, server_port, server_ep))
 		throw DeviceError("tcp: resolve", "Bind address resolve failed");
 
@@ -100,24 +100,32 @@ MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
 
 	// NOTE: shared_from_this() should not be used in constructors
 
-	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnTCPClient::do_recv, this));
+	// run io_service for async io, link on pool waits for start()
+	if (own_io_service) {
+		// give some work to io_service before start
+		// (raw this is fine: close() joins that thread)
+		strand.post(std::bind(&MAVConnTCPClient::do_start, this));
 
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mtcp%zu", conn_id);
-				io_service.run();
-			});
+		io_thread = std::thread([this] () {
+					utils::set_this_thread_name("mtcp%zu", conn_id);
+					io_service_run(io_service);
+				});
+	}
 }
 
 MAVConnTCPClient::MAVConnTCPClient(uint8_t system_id, uint8_t component_id,
 		boost::asio::io_service &server_io) :
 	MAVConnInterface(system_id, component_id),
+	io_service(server_io),
+	strand(server_io),
+	socket(server_io),
+	is_destroying(false),
 	tx_in_progress(false),
-	tx_q {},
-	rx_buf {},
-	socket(server_io)
+	tx_q(MAX_TXQ_SIZE),
+	rx_buf {}
 {
+	tx_iov.reserve(TxQueue::MAX_GATHER);
+
 	// waiting when server call client_connected()
 }
 
@@ -127,7 +135,7 @@ void MAVConnTCPClient::client_connected(size_t server_channel)
 			server_channel, conn_id, to_string_ss(server_ep).c_str());
 
 	// start recv
-	GET_IO_SERVICE(socket).post(std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
+	strand.post(std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
 }
 
 MAVConnTCPClient::~MAVConnTCPClient()
@@ -142,17 +150,23 @@ void MAVConnTCPClient::close()
 	if (!is_open())
 		return;
 
-	socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
-	socket.cancel();
-	socket.close();
+	// peer may be already gone, that is not an error here
+	error_code ec;
+	socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+	socket.cancel(ec);
+	socket.close(ec);
 
+	// pooled or server client: pending handlers complete with operation_aborted,
+	// they hold shared_ptr of link, so destructor never races with them
 	io_work.reset();
-	io_service.stop();
+	if (own_io_service) {
+		io_service.stop();
 
-	if (io_thread.joinable())
-		io_thread.join();
+		if (io_thread.joinable())
+			io_thread.join();
 
-	io_service.reset();
+		io_service.reset();
+	}
 
 	if (port_closed_cb)
 		port_closed_cb();
@@ -168,12 +182,22 @@ void MAVConnTCPClient::send_bytes(const uint8_t *bytes, size_t length)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		if (!tx_q.push(bytes, length))
 			throw std::length_error("MAVConnTCPClient::send_bytes: TX queue overflow");
-
-		tx_q.emplace_back(bytes, length);
 	}
-	GET_IO_SERVICE(socket).post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+}
+
+bool MAVConnTCPClient::set_thread_options(const ThreadOptions &opts)
+{
+	// accepted and pooled clients have no own thread
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+MAVConnInterface::TxStat MAVConnTCPClient::get_tx_stat()
+{
+	lock_guard lock(mutex);
+	return tx_q.get_stat();
 }
 
 void MAVConnTCPClient::send_message(const mavlink_message_t *message)
@@ -190,12 +214,13 @@ void MAVConnTCPClient::send_message(const mavlink_message_t *message)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
+		iostat_tx_msg(message->msgid, buf->len);
 	}
-	GET_IO_SERVICE(socket).post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
 }
 
 void MAVConnTCPClient::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -210,12 +235,60 @@ void MAVConnTCPClient::send_message(const mavlink::Message &message, const uint8
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_status_p(), sys_id, source_compid, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnTCPClient::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
+		iostat_tx_msg(message.get_message_id(), buf->len);
 	}
-	GET_IO_SERVICE(socket).post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+}
+
+bool MAVConnTCPClient::push_frame(const MsgBuffer &frame, mavlink::msgid_t msgid, bool counted)
+{
+	if (!is_open())
+		return true;
+
+	bool ok;
+	{
+		lock_guard lock(mutex);
+
+		// only len bytes copied, not whole slot
+		auto buf = tx_q.push(frame.data, frame.len);
+		if (buf && counted)
+			iostat_tx_msg(msgid, buf->len);
+
+		ok = buf != nullptr;
+	}
+	strand.post(std::bind(&MAVConnTCPClient::do_send, shared_from_this(), true));
+
+	return ok;
+}
+
+void MAVConnTCPClient::do_start()
+{
+	// own thread only: constructor posts that before make_shared() is finished
+	try {
+		shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		strand.post(std::bind(&MAVConnTCPClient::do_start, this));
+		return;
+	}
+
+	do_recv();
+}
+
+void MAVConnTCPClient::start()
+{
+	// own thread link started by constructor, server client by client_connected()
+	if (!io_pool)
+		return;
+
+	// every pooled handler owns the link, so none may run after destruction
+	std::call_once(start_flag, [this]() {
+				strand.post(std::bind(&MAVConnTCPClient::do_recv, shared_from_this()));
+			});
 }
 
 void MAVConnTCPClient::do_recv()
@@ -226,16 +299,17 @@ void MAVConnTCPClient::do_recv()
 	auto sthis = shared_from_this();
 	socket.async_receive(
 			buffer(rx_buf),
-			[sthis] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
+				sthis->stamp_rx_now();
 				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
 				sthis->do_recv();
-			});
+			}));
 }
 
 void MAVConnTCPClient::do_send(bool check_tx_state)
@@ -248,13 +322,18 @@ void MAVConnTCPClient::do_send(bool check_tx_state)
 		return;
 
 	tx_in_progress = true;
+
+	// gather queued buffers into one vectored write
+	tx_iov.clear();
+	for (size_t i = 0; i < tx_q.size() && i < TxQueue::MAX_GATHER; i++) {
+		auto &buf = tx_q.at(i);
+		tx_iov.emplace_back(buf.dpos(), buf.nbytes());
+	}
+
 	auto sthis = shared_from_this();
-	auto &buf_ref = tx_q.front();
 	socket.async_send(
-			buffer(buf_ref.dpos(), buf_ref.nbytes()),
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
-				assert(bytes_transferred <= buf_ref.len);
-
+			tx_iov,
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "send: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
@@ -269,16 +348,13 @@ void MAVConnTCPClient::do_send(bool check_tx_state)
 					return;
 				}
 
-				buf_ref.pos += bytes_transferred;
-				if (buf_ref.nbytes() == 0) {
-					sthis->tx_q.pop_front();
-				}
+				sthis->tx_q.consume(bytes_transferred);
 
 				if (!sthis->tx_q.empty())
 					sthis->do_send(false);
 				else
 					sthis->tx_in_progress = false;
-			});
+			}));
 }
 
 
@@ -289,7 +365,8 @@ MAVConnTCPServer::MAVConnTCPServer(uint8_t system_id, uint8_t component_id,
 	MAVConnInterface(system_id, component_id),
 	io_service(),
 	acceptor(io_service),
-	is_destroying(false)
+	is_destroying(false),
+	slow_client(SlowClient::drop)
 {
 	if (!resolve_address_tcp(io_service, conn_id, server_host, server_port, bind_ep))
 		throw DeviceError("tcp-l: resolve", "Bind address resolve failed");
@@ -312,7 +389,7 @@ MAVConnTCPServer::MAVConnTCPServer(uint8_t system_id, uint8_t component_id,
 	// run io_service for async io
 	io_thread = std::thread([this] () {
 				utils::set_this_thread_name("mtcps%zu", conn_id);
-				io_service.run();
+				io_service_run(io_service);
 			});
 }
 
@@ -375,41 +452,139 @@ MAVConnInterface::IOStat MAVConnTCPServer::get_iostat()
 
 		// [[[cog:
 		// for p in ('tx', 'rx'):
-		//     for f in ('total_bytes', 'speed'):
+		//     for f in ('total_bytes', 'speed', 'speed_avg', 'speed_peak'):
 		//         cog.outl("iostat.{p}_{f:11s} += inst_iostat.{p}_{f};".format(**locals()))
 		// ]]]
 		iostat.tx_total_bytes += inst_iostat.tx_total_bytes;
 		iostat.tx_speed       += inst_iostat.tx_speed;
+		iostat.tx_speed_avg   += inst_iostat.tx_speed_avg;
+		iostat.tx_speed_peak  += inst_iostat.tx_speed_peak;
 		iostat.rx_total_bytes += inst_iostat.rx_total_bytes;
 		iostat.rx_speed       += inst_iostat.rx_speed;
-		// [[[end]]] (checksum: fb4fe06794471d9b068ce0c129ee7673)
+		iostat.rx_speed_avg   += inst_iostat.rx_speed_avg;
+		iostat.rx_speed_peak  += inst_iostat.rx_speed_peak;
+		// [[[end]]] (checksum: 6a619460552b08c52994ac683b7205c5)
 	}
 
 	return iostat;
 }
 
-void MAVConnTCPServer::send_bytes(const uint8_t *bytes, size_t length)
+std::vector<MsgidCounters::Stat> MAVConnTCPServer::get_msgid_stats()
 {
+	std::map<uint32_t, MsgidCounters::Stat> sum;
+
 	lock_guard lock(mutex);
 	for (auto &instp : client_list) {
-		instp->send_bytes(bytes, length);
+		for (auto &st : instp->get_msgid_stats()) {
+			auto it = sum.emplace(st.msgid, MsgidCounters::Stat{st.msgid, 0, 0, 0, 0}).first;
+			it->second.rx_frames += st.rx_frames;
+			it->second.rx_bytes += st.rx_bytes;
+			it->second.tx_frames += st.tx_frames;
+			it->second.tx_bytes += st.tx_bytes;
+		}
 	}
+
+	std::vector<MsgidCounters::Stat> ret;
+	for (auto &p : sum)
+		ret.push_back(p.second);
+
+	return ret;
 }
 
-void MAVConnTCPServer::send_message(const mavlink_message_t *message)
+MAVConnInterface::TxStat MAVConnTCPServer::get_tx_stat()
 {
+	MAVConnInterface::TxStat txstat {};
+
 	lock_guard lock(mutex);
 	for (auto &instp : client_list) {
-		instp->send_message(message);
+		auto inst_txstat = instp->get_tx_stat();
+
+		for (size_t i = 0; i < TX_PRIORITY_COUNT; i++) {
+			txstat.depth[i] += inst_txstat.depth[i];
+			txstat.dropped[i] += inst_txstat.dropped[i];
+		}
+		txstat.coalesced += inst_txstat.coalesced;
 	}
+
+	return txstat;
+}
+
+void MAVConnTCPServer::send_bytes(const uint8_t *bytes, size_t length)
+{
+	if (length == 0 || length >= MsgBuffer::MAX_SIZE)
+		throw std::length_error("MAVConnTCPServer::send_bytes: bad length");
+
+	MsgBuffer frame(bytes, length);
+	fan_out(frame, 0, false);
+}
+
+bool MAVConnTCPServer::set_thread_options(const ThreadOptions &opts)
+{
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+void MAVConnTCPServer::send_message(const mavlink_message_t *message)
+{
+	assert(message != nullptr);
+
+	log_send(PFX, message);
+
+	// fan_out() relocks, mutex is recursive
+	lock_guard lock(mutex);
+	MsgBuffer frame(message, get_signing_p());
+	fan_out(frame, message->msgid, true);
 }
 
 void MAVConnTCPServer::send_message(const mavlink::Message &message, const uint8_t source_compid)
 {
+	log_send_obj(PFX, message);
+
+	// one sequence for all clients: serialized here, not by each client.
+	// Under lock, so concurrent senders keep frames in sequence order.
+	lock_guard lock(mutex);
+	MsgBuffer frame(message, get_status_p(), sys_id, source_compid, get_signing_p());
+	fan_out(frame, message.get_message_id(), true);
+}
+
+void MAVConnTCPServer::fan_out(const MsgBuffer &frame, mavlink::msgid_t msgid, bool counted)
+{
+	std::vector<std::shared_ptr<MAVConnTCPClient>> slow;
+
 	lock_guard lock(mutex);
 	for (auto &instp : client_list) {
-		instp->send_message(message, source_compid);
+		if (!instp->push_frame(frame, msgid, counted) && slow_client == SlowClient::disconnect)
+			slow.push_back(instp);
 	}
+
+	// close() removes client from list (client_closed())
+	for (auto &instp : slow) {
+		CONSOLE_BRIDGE_logWarn(PFXd "Client %s does not read, disconnected",
+				conn_id, to_string_ss(instp->server_ep).c_str());
+		instp->close();
+	}
+}
+
+void MAVConnTCPServer::set_signing(std::shared_ptr<Signing> signing)
+{
+	// server signs frames once in fan_out(), clients check received ones.
+	// All clients run on server I/O thread, so they can share stream table.
+	MAVConnInterface::set_signing(signing);
+
+	lock_guard lock(mutex);
+	clients_signing = signing;
+	for (auto &instp : client_list)
+		instp->set_signing(signing);
+}
+
+void MAVConnTCPServer::set_tlog(std::shared_ptr<TlogWriter> tlog)
+{
+	// frames are parsed by clients, writer serializes them
+	MAVConnInterface::set_tlog(tlog);
+
+	lock_guard lock(mutex);
+	clients_tlog = tlog;
+	for (auto &instp : client_list)
+		instp->set_tlog(tlog);
 }
 
 void MAVConnTCPServer::do_accept()
@@ -432,8 +607,13 @@ void MAVConnTCPServer::do_accept()
 				lock_guard lock(sthis->mutex);
 
 				std::weak_ptr<MAVConnTCPClient> weak_client{acceptor_client};
+				if (sthis->clients_signing)
+					acceptor_client->set_signing(sthis->clients_signing);
+				if (sthis->clients_tlog)
+					acceptor_client->set_tlog(sthis->clients_tlog);
 				acceptor_client->client_connected(sthis->conn_id);
-				acceptor_client->message_received_cb = std::bind(&MAVConnTCPServer::recv_message, sthis, std::placeholders::_1, std::placeholders::_2);
+				acceptor_client->message_received_cb = std::bind(&MAVConnTCPServer::recv_message, sthis, acceptor_client.get(),
+						std::placeholders::_1, std::placeholders::_2);
 				acceptor_client->port_closed_cb = [weak_client, sthis] () { sthis->client_closed(weak_client); };
 
 				sthis->client_list.push_back(acceptor_client);
@@ -455,8 +635,11 @@ void MAVConnTCPServer::client_closed(std::weak_ptr<MAVConnTCPClient> weak_instp)
 	}
 }
 
-void MAVConnTCPServer::recv_message(const mavlink_message_t *message, const Framing framing)
+void MAVConnTCPServer::recv_message(MAVConnTCPClient *client, const mavlink_message_t *message, const Framing framing)
 {
+	// called from client's receive handler, so its stamp is of this message
+	rx_stamp_ns = client->get_rx_stamp_ns();
+
 	if (message_received_cb)
 		message_received_cb(message, framing);
 }
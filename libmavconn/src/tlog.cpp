@@ -0,0 +1,322 @@
+/**
+ * @brief MAVConn telemetry log recording and replay
+ * @file tlog.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup mavconn
+ * @{
+ */
+/*
+ * libmavconn
+ * Copyright 2017 Vladimir Ermakov, All rights reserved.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mavconn/console_bridge_compat.h>
+#include <mavconn/thread_utils.h>
+#include <mavconn/tlog.h>
+
+namespace mavconn {
+
+using mavlink::mavlink_message_t;
+
+#define PFX	"mavconn: tlog"
+#define PFXd	PFX "%zu: "
+
+static constexpr size_t STAMP_LEN = 8;
+
+
+size_t tlog_record_len(const uint8_t *p, size_t avail)
+{
+	if (avail < STAMP_LEN + 3)
+		return 0;
+
+	const uint8_t *frame = p + STAMP_LEN;
+	size_t len;
+	if (frame[0] == MAVLINK_STX)
+		len = MAVLINK_NUM_HEADER_BYTES + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES +
+				((frame[2] & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+	else if (frame[0] == MAVLINK_STX_MAVLINK1)
+		len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+	else
+		return 0;
+
+	return (STAMP_LEN + len <= avail) ? STAMP_LEN + len : 0;
+}
+
+/* -*- writer -*- */
+
+TlogWriter::TlogWriter(const std::string &path, size_t prealloc) :
+	fd(-1),
+	map(nullptr),
+	map_len(0),
+	length(0),
+	frames_(0)
+{
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw DeviceError("tlog", errno);
+
+	struct stat st;
+	if (::fstat(fd, &st) < 0) {
+		const int err = errno;
+		::close(fd);
+		throw DeviceError("tlog", err);
+	}
+
+	const size_t existing = st.st_size;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		grow(existing + std::max<size_t>(prealloc, 4096));
+	}
+
+	if (map == nullptr) {
+		const int err = errno;
+		::close(fd);
+		throw DeviceError("tlog", err);
+	}
+
+	// append after last good record, zero tail of crashed writer overwritten
+	for (size_t rlen; (rlen = tlog_record_len(map + length, existing - length)) != 0; )
+		length += rlen;
+
+	CONSOLE_BRIDGE_logInform(PFX ": recording to %s, %zu bytes of previous data",
+			path.c_str(), length);
+}
+
+TlogWriter::~TlogWriter()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (map)
+		::munmap(map, map_len);
+	if (::ftruncate(fd, length) < 0)
+		CONSOLE_BRIDGE_logWarn(PFX ": truncate: %s", strerror(errno));
+	::close(fd);
+}
+
+void TlogWriter::grow(size_t need)
+{
+	const size_t new_len = std::max(need, map_len * 2);
+
+	int err = ::posix_fallocate(fd, 0, new_len);
+	// filesystem without fallocate: sparse file
+	if (err == EOPNOTSUPP || err == EINVAL)
+		err = (::ftruncate(fd, new_len) < 0) ? errno : 0;
+	if (err != 0) {
+		CONSOLE_BRIDGE_logError(PFX ": allocate %zu bytes: %s", new_len, strerror(err));
+		return;
+	}
+
+	void *p;
+	if (map)
+		p = ::mremap(map, map_len, new_len, MREMAP_MAYMOVE);
+	else
+		p = ::mmap(nullptr, new_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (p == MAP_FAILED) {
+		CONSOLE_BRIDGE_logError(PFX ": map %zu bytes: %s", new_len, strerror(errno));
+		return;
+	}
+
+	map = static_cast<uint8_t *>(p);
+	map_len = new_len;
+}
+
+void TlogWriter::write(uint64_t stamp_us, const uint8_t *frame, size_t len)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (length + STAMP_LEN + len > map_len) {
+		grow(length + STAMP_LEN + len);
+		if (length + STAMP_LEN + len > map_len)
+			return;
+	}
+
+	uint8_t *p = map + length;
+	for (size_t i = 0; i < STAMP_LEN; i++)
+		p[i] = stamp_us >> (8 * (STAMP_LEN - 1 - i));
+	std::memcpy(p + STAMP_LEN, frame, len);
+
+	length += STAMP_LEN + len;
+	frames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t TlogWriter::size()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return length;
+}
+
+/* -*- replay -*- */
+
+MAVConnTlog::MAVConnTlog(uint8_t system_id, uint8_t component_id,
+		std::string path, double speed_, bool wait_tx) :
+	MAVConnInterface(system_id, component_id),
+	fd(-1),
+	map(nullptr),
+	map_len(0),
+	speed(std::max(speed_, 0.0)),
+	started(!wait_tx),
+	is_open_(false),
+	replayed_(0)
+{
+	CONSOLE_BRIDGE_logInform(PFXd "replay: %s, speed: %.2f", conn_id, path.c_str(), speed);
+
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw DeviceError("tlog", errno);
+
+	struct stat st;
+	if (::fstat(fd, &st) < 0) {
+		const int err = errno;
+		::close(fd);
+		throw DeviceError("tlog", err);
+	}
+
+	map_len = st.st_size;
+	if (map_len > 0) {
+		void *p = ::mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			const int err = errno;
+			::close(fd);
+			throw DeviceError("tlog", err);
+		}
+
+		map = static_cast<const uint8_t *>(p);
+		::madvise(const_cast<uint8_t *>(map), map_len, MADV_SEQUENTIAL);
+	}
+
+	is_open_ = true;
+	io_thread = std::thread([this] () {
+				utils::set_this_thread_name("mtlog%zu", conn_id);
+				replay();
+			});
+}
+
+MAVConnTlog::~MAVConnTlog()
+{
+	close();
+
+	// port_closed_cb may drop last reference from replay thread
+	if (io_thread.joinable()) {
+		if (io_thread.get_id() == std::this_thread::get_id())
+			io_thread.detach();
+		else
+			io_thread.join();
+	}
+
+	if (map)
+		::munmap(const_cast<uint8_t *>(map), map_len);
+	::close(fd);
+}
+
+void MAVConnTlog::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!is_open_.exchange(false))
+			return;
+	}
+	start_cond.notify_all();
+
+	if (io_thread.joinable() && io_thread.get_id() != std::this_thread::get_id())
+		io_thread.join();
+
+	if (port_closed_cb)
+		port_closed_cb();
+}
+
+void MAVConnTlog::start()
+{
+	if (started.load(std::memory_order_relaxed))
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		started = true;
+	}
+	start_cond.notify_all();
+}
+
+void MAVConnTlog::send_message(const mavlink_message_t *message)
+{
+	log_send(PFX, message);
+	start();
+}
+
+void MAVConnTlog::send_message(const mavlink::Message &message, const uint8_t source_compid)
+{
+	log_send_obj(PFX, message);
+	start();
+}
+
+void MAVConnTlog::send_bytes(const uint8_t *bytes, size_t length)
+{
+	start();
+}
+
+bool MAVConnTlog::set_thread_options(const ThreadOptions &opts)
+{
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+void MAVConnTlog::replay()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		start_cond.wait(lock, [this] { return started || !is_open_; });
+	}
+
+	const auto wall_start = steady_clock::now();
+	uint64_t first_stamp = 0;
+	size_t pos = 0;
+
+	while (is_open_ && pos < map_len) {
+		const size_t rlen = tlog_record_len(map + pos, map_len - pos);
+		if (rlen == 0)
+			break;
+
+		uint64_t stamp_us = 0;
+		for (size_t i = 0; i < STAMP_LEN; i++)
+			stamp_us = (stamp_us << 8) | map[pos + i];
+
+		if (first_stamp == 0)
+			first_stamp = stamp_us;
+
+		if (speed > 0.0 && stamp_us > first_stamp) {
+			const auto due = wall_start + std::chrono::microseconds(uint64_t((stamp_us - first_stamp) / speed));
+			std::unique_lock<std::mutex> lock(mutex);
+			if (start_cond.wait_until(lock, due, [this] { return !is_open_; }))
+				break;
+		}
+
+		// recorded time, so replayed stamps are deterministic
+		rx_stamp_ns = stamp_us * 1000;
+		parse_buffer(PFX, const_cast<uint8_t *>(map + pos + STAMP_LEN), rlen - STAMP_LEN, rlen - STAMP_LEN);
+
+		pos += rlen;
+		replayed_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const double wall = std::chrono::duration<double>(steady_clock::now() - wall_start).count();
+	CONSOLE_BRIDGE_logInform(PFXd "replay done: %zu frames in %.3f s (%.0f frames/s), stopped at %zu of %zu bytes",
+			conn_id, replayed_.load(), wall, (wall > 0.0) ? replayed_ / wall : 0.0, pos, map_len);
+
+	// end of file closes link, that is how replay user learns it is done
+	if (is_open_.exchange(false) && port_closed_cb)
+		port_closed_cb();
+}
+}	// namespace mavconn
@@ -15,12 +15,30 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <ctime>
 #include <cassert>
+#include <cstring>
 
 #include <mavconn/console_bridge_compat.h>
 #include <mavconn/thread_utils.h>
 #include <mavconn/udp.h>
 
+#if defined(__linux__) && BOOST_ASIO_VERSION >= 101200
+#include <sys/socket.h>
+#define MAVCONN_HAVE_MMSG
+#ifdef SO_TIMESTAMPNS
+#define MAVCONN_HAVE_RX_TIMESTAMP
+#endif
+#ifdef SO_RXQ_OVFL
+#define MAVCONN_HAVE_RXQ_OVFL
+#endif
+#endif
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#endif
+
 namespace mavconn {
 
 using boost::system::error_code;
@@ -28,12 +46,18 @@ using boost::asio::io_service;
 using boost::asio::ip::udp;
 using boost::asio::buffer;
 using utils::to_string_ss;
-using utils::operator"" _KiB;
 using mavlink::mavlink_message_t;
 
 #define PFX	"mavconn: udp"
 #define PFXd	PFX "%zu: "
 
+#ifdef MAVCONN_HAVE_RX_TIMESTAMP
+//! kernel stamps come in control messages, so receive always goes through recvmmsg()
+static constexpr bool HAVE_RX_TIMESTAMP = true;
+#else
+static constexpr bool HAVE_RX_TIMESTAMP = false;
+#endif
+
 
 static bool resolve_address_udp(io_service &io, size_t chan, std::string host, unsigned short port, udp::endpoint &ep)
 {
@@ -67,16 +91,23 @@ static bool resolve_address_udp(io_service &io, size_t chan, std::string host, u
 
 MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 		std::string bind_host, unsigned short bind_port,
-		std::string remote_host, unsigned short remote_port) :
+		std::string remote_host, unsigned short remote_port,
+		IOPool::Ptr io_pool_, const UDPSocketOptions &sock_opts) :
 	MAVConnInterface(system_id, component_id),
+	io_pool(io_pool_),
+	own_io_service(io_pool ? nullptr : new boost::asio::io_service()),
+	io_service(io_pool ? io_pool->get_io_service() : *own_io_service),
+	strand(io_service),
+	io_work(own_io_service ? new io_service::work(io_service) : nullptr),
+	permanent_broadcast(false),
 	remote_exists(false),
+	socket(io_service),
 	tx_in_progress(false),
-	tx_q {},
+	tx_q(MAX_TXQ_SIZE),
 	rx_buf {},
-	io_service(),
-	io_work(new io_service::work(io_service)),
-	socket(io_service),
-	permanent_broadcast(false)
+	batch_size(1),
+	rx_batch_buf(1),
+	rx_batch_ep(1)
 {
 	using udps = boost::asio::ip::udp::socket;
 
@@ -102,13 +133,20 @@ MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 	try {
 		socket.open(udp::v4());
 
-		// set buffer opt. size from QGC
+		// default buffer sizes from QGC
 		socket.set_option(udps::reuse_address(true));
-		socket.set_option(udps::send_buffer_size(256_KiB));
-		socket.set_option(udps::receive_buffer_size(512_KiB));
+		socket.set_option(udps::send_buffer_size(sock_opts.sndbuf));
+		socket.set_option(udps::receive_buffer_size(sock_opts.rcvbuf));
+		set_socket_options(sock_opts);
 
 		socket.bind(bind_ep);
 
+#ifdef MAVCONN_HAVE_RX_TIMESTAMP
+		int on = 1;
+		if (::setsockopt(socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+			CONSOLE_BRIDGE_logWarn(PFXd "SO_TIMESTAMPNS: %s", conn_id, strerror(errno));
+#endif
+
 		if (remote_host == BROADCAST_REMOTE_HOST) {
 			socket.set_option(udps::broadcast(true));
 		} else if (remote_host == PERMANENT_BROADCAST_REMOTE_HOST) {
@@ -122,14 +160,17 @@ MAVConnUDP::MAVConnUDP(uint8_t system_id, uint8_t component_id,
 
 	// NOTE: shared_from_this() should not be used in constructors
 
-	// give some work to io_service before start
-	io_service.post(std::bind(&MAVConnUDP::do_recvfrom, this));
+	// run io_service for async io, link on pool waits for start()
+	if (own_io_service) {
+		// give some work to io_service before start
+		// (raw this is fine: close() joins that thread)
+		strand.post(std::bind(&MAVConnUDP::do_start, this));
 
-	// run io_service for async io
-	io_thread = std::thread([this] () {
-				utils::set_this_thread_name("mudp%zu", conn_id);
-				io_service.run();
-			});
+		io_thread = std::thread([this] () {
+					utils::set_this_thread_name("mudp%zu", conn_id);
+					io_service_run(io_service);
+				});
+	}
 }
 
 MAVConnUDP::~MAVConnUDP()
@@ -146,13 +187,17 @@ void MAVConnUDP::close()
 	socket.cancel();
 	socket.close();
 
+	// pooled link: pending handlers complete with operation_aborted,
+	// they hold shared_ptr of link, so destructor never races with them
 	io_work.reset();
-	io_service.stop();
+	if (own_io_service) {
+		io_service.stop();
 
-	if (io_thread.joinable())
-		io_thread.join();
+		if (io_thread.joinable())
+			io_thread.join();
 
-	io_service.reset();
+		io_service.reset();
+	}
 
 	if (port_closed_cb)
 		port_closed_cb();
@@ -173,12 +218,10 @@ void MAVConnUDP::send_bytes(const uint8_t *bytes, size_t length)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		if (!tx_q.push(bytes, length))
 			throw std::length_error("MAVConnUDP::send_bytes: TX queue overflow");
-
-		tx_q.emplace_back(bytes, length);
 	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
 }
 
 void MAVConnUDP::send_message(const mavlink_message_t *message)
@@ -200,12 +243,13 @@ void MAVConnUDP::send_message(const mavlink_message_t *message)
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message);
+		iostat_tx_msg(message->msgid, buf->len);
 	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+	strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
 }
 
 void MAVConnUDP::send_message(const mavlink::Message &message, const uint8_t source_compid)
@@ -225,40 +269,178 @@ void MAVConnUDP::send_message(const mavlink::Message &message, const uint8_t sou
 	{
 		lock_guard lock(mutex);
 
-		if (tx_q.size() >= MAX_TXQ_SIZE)
+		auto buf = tx_q.push(message, get_status_p(), sys_id, source_compid, get_signing_p());
+		if (!buf)
 			throw std::length_error("MAVConnUDP::send_message: TX queue overflow");
 
-		tx_q.emplace_back(message, get_status_p(), sys_id, source_compid);
+		iostat_tx_msg(message.get_message_id(), buf->len);
+	}
+	strand.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+}
+
+void MAVConnUDP::set_batch_size(size_t batch)
+{
+#ifdef MAVCONN_HAVE_MMSG
+	batch = std::max<size_t>(batch, 1);
+	if (batch > MAX_BATCH_SIZE)
+		batch = MAX_BATCH_SIZE;
+
+	CONSOLE_BRIDGE_logInform(PFXd "Batched I/O: up to %zu datagrams per syscall", conn_id, batch);
+
+	// batch buffers owned by io_thread
+	auto sthis = shared_from_this();
+	strand.post([sthis, batch] () {
+				sthis->rx_batch_buf.resize(batch);
+				sthis->rx_batch_ep.resize(batch);
+				sthis->batch_size = batch;
+			});
+#else
+	CONSOLE_BRIDGE_logWarn(PFXd "Batched I/O not supported on this system, ignored.", conn_id);
+#endif
+}
+
+bool MAVConnUDP::set_thread_options(const ThreadOptions &opts)
+{
+	return apply_thread_options(PFX, io_thread, opts);
+}
+
+MAVConnInterface::TxStat MAVConnUDP::get_tx_stat()
+{
+	lock_guard lock(mutex);
+	return tx_q.get_stat();
+}
+
+void MAVConnUDP::set_socket_options(const UDPSocketOptions &opts)
+{
+	using udps = boost::asio::ip::udp::socket;
+	const int fd = socket.native_handle();
+
+	// Linux doubles requested size for bookkeeping, and clamps to sysctl limit
+	udps::receive_buffer_size rcvbuf;
+	socket.get_option(rcvbuf);
+	if (rcvbuf.value() < opts.rcvbuf)
+		CONSOLE_BRIDGE_logWarn(PFXd "SO_RCVBUF: got %d of %d bytes, raise net.core.rmem_max",
+				conn_id, rcvbuf.value(), opts.rcvbuf);
+
+	udps::send_buffer_size sndbuf;
+	socket.get_option(sndbuf);
+	if (sndbuf.value() < opts.sndbuf)
+		CONSOLE_BRIDGE_logWarn(PFXd "SO_SNDBUF: got %d of %d bytes, raise net.core.wmem_max",
+				conn_id, sndbuf.value(), opts.sndbuf);
+
+	if (opts.reuse_port) {
+#ifdef SO_REUSEPORT
+		int on = 1;
+		if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+			CONSOLE_BRIDGE_logWarn(PFXd "SO_REUSEPORT: %s", conn_id, strerror(errno));
+#else
+		CONSOLE_BRIDGE_logWarn(PFXd "SO_REUSEPORT not supported on this system, ignored.", conn_id);
+#endif
+	}
+
+	if (opts.busy_poll_us >= 0) {
+#ifdef SO_BUSY_POLL
+		int us = opts.busy_poll_us;
+		if (::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0)
+			CONSOLE_BRIDGE_logWarn(PFXd "SO_BUSY_POLL: %s", conn_id, strerror(errno));
+		else
+			CONSOLE_BRIDGE_logInform(PFXd "SO_BUSY_POLL: %d us", conn_id, us);
+#else
+		CONSOLE_BRIDGE_logWarn(PFXd "SO_BUSY_POLL not supported on this system, ignored.", conn_id);
+#endif
+	}
+
+	if (opts.dscp >= 0) {
+		int tos = (opts.dscp & 0x3f) << 2;
+		if (::setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0)
+			CONSOLE_BRIDGE_logWarn(PFXd "IP_TOS: %s", conn_id, strerror(errno));
+		else
+			CONSOLE_BRIDGE_logInform(PFXd "DSCP: %d", conn_id, opts.dscp & 0x3f);
+	}
+
+#ifdef MAVCONN_HAVE_RXQ_OVFL
+	// drop counter comes with every datagram
+	int on = 1;
+	if (::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+		CONSOLE_BRIDGE_logWarn(PFXd "SO_RXQ_OVFL: %s", conn_id, strerror(errno));
+#endif
+}
+
+void MAVConnUDP::handle_remote_ep(const udp::endpoint &ep)
+{
+	if (permanent_broadcast) {
+		recv_ep = ep;
+		return;
+	}
+
+	remote_ep = ep;
+	if (remote_ep != last_remote_ep) {
+		CONSOLE_BRIDGE_logInform(PFXd "Remote address: %s", conn_id, to_string_ss(remote_ep).c_str());
+		remote_exists = true;
+		last_remote_ep = remote_ep;
 	}
-	io_service.post(std::bind(&MAVConnUDP::do_sendto, shared_from_this(), true));
+}
+
+void MAVConnUDP::do_start()
+{
+	// own thread only: constructor posts that before make_shared() is finished
+	try {
+		shared_from_this();
+	}
+	catch (std::bad_weak_ptr &) {
+		strand.post(std::bind(&MAVConnUDP::do_start, this));
+		return;
+	}
+
+	do_recvfrom();
+}
+
+void MAVConnUDP::start()
+{
+	// own thread link started by constructor
+	if (!io_pool)
+		return;
+
+	// every pooled handler owns the link, so none may run after destruction
+	std::call_once(start_flag, [this]() {
+				strand.post(std::bind(&MAVConnUDP::do_recvfrom, shared_from_this()));
+			});
 }
 
 void MAVConnUDP::do_recvfrom()
 {
+	if (batch_size > 1 || HAVE_RX_TIMESTAMP) {
+		do_recvmmsg();
+		return;
+	}
+
 	auto sthis = shared_from_this();
 	socket.async_receive_from(
 			buffer(rx_buf),
 			permanent_broadcast ? recv_ep : remote_ep,
-			[sthis] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis] (error_code error, size_t bytes_transferred) {
 				if (error) {
 					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
 					sthis->close();
 					return;
 				}
 
-				if (!sthis->permanent_broadcast && sthis->remote_ep != sthis->last_remote_ep) {
-					CONSOLE_BRIDGE_logInform(PFXd "Remote address: %s", sthis->conn_id, to_string_ss(sthis->remote_ep).c_str());
-					sthis->remote_exists = true;
-					sthis->last_remote_ep = sthis->remote_ep;
-				}
+				sthis->handle_remote_ep(sthis->permanent_broadcast ? sthis->recv_ep : sthis->remote_ep);
 
+				sthis->iostat_rx_syscall(1);
+				sthis->stamp_rx_now();
 				sthis->parse_buffer(PFX, sthis->rx_buf.data(), sthis->rx_buf.size(), bytes_transferred);
 				sthis->do_recvfrom();
-			});
+			}));
 }
 
 void MAVConnUDP::do_sendto(bool check_tx_state)
 {
+	if (batch_size > 1) {
+		do_sendmmsg(check_tx_state);
+		return;
+	}
+
 	if (check_tx_state && tx_in_progress)
 		return;
 
@@ -272,7 +454,7 @@ void MAVConnUDP::do_sendto(bool check_tx_state)
 	socket.async_send_to(
 			buffer(buf_ref.dpos(), buf_ref.nbytes()),
 			remote_ep,
-			[sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
+			strand.wrap([sthis, &buf_ref] (error_code error, size_t bytes_transferred) {
 				assert(bytes_transferred <= buf_ref.len);
 
 				if (error == boost::asio::error::network_unreachable) {
@@ -286,6 +468,7 @@ void MAVConnUDP::do_sendto(bool check_tx_state)
 				}
 
 				sthis->iostat_tx_add(bytes_transferred);
+				sthis->iostat_tx_syscall(1);
 				lock_guard lock(sthis->mutex);
 
 				if (sthis->tx_q.empty()) {
@@ -302,6 +485,191 @@ void MAVConnUDP::do_sendto(bool check_tx_state)
 					sthis->do_sendto(false);
 				else
 					sthis->tx_in_progress = false;
-			});
+			}));
+}
+
+#ifdef MAVCONN_HAVE_MMSG
+//! Control buffer for one datagram, room for SCM_TIMESTAMPNS and SO_RXQ_OVFL
+struct alignas(cmsghdr) RxControl {
+	uint8_t buf[CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+};
+
+//! Kernel receive time from control messages, 0 if absent
+static uint64_t get_rx_timestamp(msghdr &hdr)
+{
+#ifdef MAVCONN_HAVE_RX_TIMESTAMP
+	for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			timespec ts;
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+		}
+	}
+#endif
+
+	return 0;
+}
+
+//! Socket drop counter from control messages
+static bool get_rx_drops(msghdr &hdr, uint32_t &drops)
+{
+#ifdef MAVCONN_HAVE_RXQ_OVFL
+	for (auto cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+			memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+			return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
+void MAVConnUDP::do_recvmmsg()
+{
+	auto sthis = shared_from_this();
+	socket.async_wait(udp::socket::wait_read,
+			strand.wrap([sthis] (error_code error) {
+				if (error) {
+					CONSOLE_BRIDGE_logError(PFXd "receive: %s", sthis->conn_id, error.message().c_str());
+					sthis->close();
+					return;
+				}
+
+				std::array<mmsghdr, MAX_BATCH_SIZE> msgs;
+				std::array<iovec, MAX_BATCH_SIZE> iovs;
+				std::array<RxControl, MAX_BATCH_SIZE> ctrls;
+				const size_t batch = sthis->batch_size;
+
+				for (size_t i = 0; i < batch; i++) {
+					auto &buf = sthis->rx_batch_buf[i];
+					auto &ep = sthis->rx_batch_ep[i];
+
+					iovs[i].iov_base = buf.data();
+					iovs[i].iov_len = buf.size();
+
+					msgs[i] = {};
+					msgs[i].msg_hdr.msg_name = ep.data();
+					msgs[i].msg_hdr.msg_namelen = ep.capacity();
+					msgs[i].msg_hdr.msg_iov = &iovs[i];
+					msgs[i].msg_hdr.msg_iovlen = 1;
+					msgs[i].msg_hdr.msg_control = ctrls[i].buf;
+					msgs[i].msg_hdr.msg_controllen = sizeof(ctrls[i].buf);
+				}
+
+				int n = ::recvmmsg(sthis->socket.native_handle(), msgs.data(), batch, MSG_DONTWAIT, nullptr);
+				if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+					CONSOLE_BRIDGE_logError(PFXd "recvmmsg: %s", sthis->conn_id, strerror(errno));
+					sthis->close();
+					return;
+				}
+
+				if (n > 0)
+					sthis->iostat_rx_syscall(n);
+
+				for (int i = 0; i < n; i++) {
+					auto &buf = sthis->rx_batch_buf[i];
+					auto &ep = sthis->rx_batch_ep[i];
+
+					ep.resize(msgs[i].msg_hdr.msg_namelen);
+					sthis->handle_remote_ep(ep);
+
+					sthis->rx_stamp_ns = get_rx_timestamp(msgs[i].msg_hdr);
+					if (sthis->rx_stamp_ns == 0)
+						sthis->stamp_rx_now();
+
+					uint32_t drops;
+					if (get_rx_drops(msgs[i].msg_hdr, drops))
+						sthis->iostat_rx_kernel_drops(drops);
+
+					sthis->parse_buffer(PFX, buf.data(), buf.size(), msgs[i].msg_len);
+				}
+
+				sthis->do_recvfrom();
+			}));
+}
+
+void MAVConnUDP::do_sendmmsg(bool check_tx_state)
+{
+	if (check_tx_state && tx_in_progress)
+		return;
+
+	lock_guard lock(mutex);
+	if (tx_q.empty())
+		return;
+
+	tx_in_progress = true;
+
+	std::array<mmsghdr, MAX_BATCH_SIZE> msgs;
+	std::array<iovec, MAX_BATCH_SIZE> iovs;
+	const size_t batch = std::min(batch_size, tx_q.size());
+
+	for (size_t i = 0; i < batch; i++) {
+		auto &buf = tx_q.at(i);
+
+		iovs[i].iov_base = buf.dpos();
+		iovs[i].iov_len = buf.nbytes();
+
+		msgs[i] = {};
+		msgs[i].msg_hdr.msg_name = remote_ep.data();
+		msgs[i].msg_hdr.msg_namelen = remote_ep.size();
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int n = ::sendmmsg(socket.native_handle(), msgs.data(), batch, MSG_DONTWAIT);
+	if (n < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			// socket buffer full, continue when it drains
+			auto sthis = shared_from_this();
+			socket.async_wait(udp::socket::wait_write,
+					strand.wrap([sthis] (error_code error) {
+						if (error) {
+							CONSOLE_BRIDGE_logError(PFXd "sendmmsg: %s", sthis->conn_id, error.message().c_str());
+							sthis->close();
+							return;
+						}
+
+						sthis->do_sendmmsg(false);
+					}));
+			return;
+		}
+		else if (errno == ENETUNREACH || errno == EINTR) {
+			CONSOLE_BRIDGE_logWarn(PFXd "sendmmsg: %s, retrying", conn_id, strerror(errno));
+			// do not return, try to resend
+		}
+		else {
+			CONSOLE_BRIDGE_logError(PFXd "sendmmsg: %s", conn_id, strerror(errno));
+			close();
+			return;
+		}
+	}
+	else {
+		iostat_tx_syscall(n);
+
+		// datagram sent as a whole
+		for (int i = 0; i < n; i++) {
+			iostat_tx_add(msgs[i].msg_len);
+			tx_q.pop_front();
+		}
+	}
+
+	if (!tx_q.empty())
+		strand.post(std::bind(&MAVConnUDP::do_sendmmsg, shared_from_this(), false));
+	else
+		tx_in_progress = false;
+}
+#else
+void MAVConnUDP::do_recvmmsg()
+{
+	batch_size = 1;
+	do_recvfrom();
 }
+
+void MAVConnUDP::do_sendmmsg(bool check_tx_state)
+{
+	batch_size = 1;
+	do_sendto(check_tx_state);
+}
+#endif
 }	// namespace mavconn
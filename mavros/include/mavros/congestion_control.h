@@ -0,0 +1,138 @@
+/**
+ * @brief AIMD telemetry rate control from radio link state
+ * @file congestion_control.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace mavros {
+/**
+ * @brief Scale of low priority stream rates, driven by radio link congestion
+ *
+ * Fed on each RADIO_STATUS. Link is congested when radio Tx buffer
+ * is nearly full, receive errors grow, or our Tx queue backs up;
+ * then scale halves (multiplicative decrease). When buffer is mostly
+ * free, errors stopped and queue drained, scale grows by fixed step
+ * (additive increase) back to 1. Otherwise it holds.
+ *
+ * Commands then find room in radio buffer, so their latency stays bounded.
+ */
+class CongestionControl {
+public:
+	struct Config {
+		int txbuf_low = 30;		//!< free radio buffer [%] below that - congested
+		int txbuf_high = 70;		//!< free radio buffer [%] above that - may increase
+		int rxerrors_max = 5;		//!< new receive errors per report above that - congested
+		size_t tx_queue_max = 32;	//!< our Tx queue depth above that - congested
+		double min_scale = 0.1;		//!< lowest rate scale
+		double increase = 0.1;		//!< additive step
+	};
+
+	enum class State {
+		increase,
+		hold,
+		decrease
+	};
+
+	CongestionControl() :
+		scale_(1.0),
+		has_rxerrors(false),
+		last_rxerrors(0),
+		decreases_(0)
+	{ }
+
+	void configure(const Config &conf)
+	{
+		cfg = conf;
+		cfg.min_scale = std::min(1.0, std::max(0.01, cfg.min_scale));
+	}
+
+	/**
+	 * @brief Account one radio report
+	 *
+	 * @param txbuf     RADIO_STATUS.txbuf, free buffer [%]
+	 * @param rxerrors  RADIO_STATUS.rxerrors, wrapping counter
+	 * @param tx_queue  buffers waiting in FCU link Tx queue
+	 * @return true if scale changed
+	 */
+	bool update(uint8_t txbuf, uint16_t rxerrors, size_t tx_queue)
+	{
+		const uint16_t new_errors = (has_rxerrors) ? uint16_t(rxerrors - last_rxerrors) : 0;
+		has_rxerrors = true;
+		last_rxerrors = rxerrors;
+
+		const double prev = scale_;
+		state_ = classify(txbuf, new_errors, tx_queue);
+
+		if (state_ == State::decrease) {
+			scale_ = std::max(cfg.min_scale, scale_ * 0.5);
+			if (scale_ != prev)
+				decreases_++;
+		}
+		else if (state_ == State::increase) {
+			// steps sum with rounding error, snap to full rate
+			scale_ = scale_ + cfg.increase;
+			if (scale_ > 1.0 - 1e-6)
+				scale_ = 1.0;
+		}
+
+		return scale_ != prev;
+	}
+
+	//! Rate multiplier of low priority streams, (0, 1]
+	inline double scale() const {
+		return scale_;
+	}
+
+	//! Decision of last update()
+	inline State state() const {
+		return state_;
+	}
+
+	//! Reports which lowered scale
+	inline size_t decreases() const {
+		return decreases_;
+	}
+
+	//! Forget link state, e.g. on reconnect
+	void reset()
+	{
+		scale_ = 1.0;
+		state_ = State::hold;
+		has_rxerrors = false;
+	}
+
+private:
+	Config cfg;
+	double scale_;
+	State state_ = State::hold;
+	bool has_rxerrors;
+	uint16_t last_rxerrors;
+	size_t decreases_;
+
+	State classify(uint8_t txbuf, uint16_t new_errors, size_t tx_queue) const
+	{
+		if (txbuf < cfg.txbuf_low || new_errors > cfg.rxerrors_max || tx_queue > cfg.tx_queue_max)
+			return State::decrease;
+		else if (txbuf > cfg.txbuf_high && new_errors == 0 && tx_queue <= cfg.tx_queue_max / 2)
+			return State::increase;
+		else
+			return State::hold;
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,208 @@
+/**
+ * @brief Lazy diagnostic updater
+ * @file diag_updater.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+#include <ros/ros.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <mavconn/thread_utils.h>
+
+namespace mavros {
+/**
+ * @brief Diagnostic updater which formats and publishes only for subscribers
+ *
+ * Replacement of diagnostic_updater::Updater (same add(), removeByName(),
+ * setHardwareID() and update()). Tasks are run every period, so their
+ * windows and delta counters stay valid, but when nobody subscribes
+ * /diagnostics or ~diagnostics_compact run is quiet: DiagCache values
+ * are not formatted and nothing is published.
+ *
+ * Along with DiagnosticArray numeric values added by DiagCache
+ * are published as mavros_msgs/DiagnosticCompact.
+ */
+class DiagUpdater : public diagnostic_updater::DiagnosticTaskVector {
+public:
+	DiagUpdater();
+
+	void setHardwareID(const std::string &hwid_) {
+		hwid = hwid_;
+	}
+
+	//! run tasks, if ~diagnostic_period passed, and publish for subscribers
+	void update();
+
+	//! run tasks now and publish for subscribers
+	void force_update();
+
+	/**
+	 * @brief Numeric values of status now being run by update()
+	 *
+	 * @return nullptr if @a stat is not filled by DiagUpdater (e.g. plain Updater of gcs_bridge)
+	 */
+	static std::vector<double> *running_values(const diagnostic_updater::DiagnosticStatusWrapper &stat);
+
+	/**
+	 * @brief Status now being run by update() without subscribers
+	 *
+	 * Task should only update its bookkeeping, values are dropped.
+	 */
+	static bool running_quiet(const diagnostic_updater::DiagnosticStatusWrapper &stat);
+
+private:
+	ros::NodeHandle nh;
+	ros::NodeHandle private_nh;
+
+	ros::Publisher diag_pub;
+	ros::Publisher compact_pub;
+	//! shared with connect callbacks, which may outlive this object
+	std::shared_ptr<std::atomic<int>> num_subscribers;
+
+	std::string hwid;
+	std::string name_prefix;	//!< "<node>: "
+	ros::Duration period;
+	ros::Time next_time;
+
+	//! reused between runs, so KeyValue vectors keep capacity
+	std::vector<diagnostic_updater::DiagnosticStatusWrapper> statuses;
+	std::vector<std::vector<double>> values;
+};
+
+/**
+ * @brief Formatted values of diagnostic task kept between runs
+ *
+ * Task calls begin() and then add()/addf() in same order every run.
+ * Value is formatted only when its numbers differ from previous run
+ * (or key at this position changed), otherwise cached string is used.
+ * When run by DiagUpdater numbers also go to DiagnosticCompact,
+ * on quiet run (no subscribers) values are skipped.
+ *
+ * Not locked: one task is run by one updater.
+ */
+class DiagCache {
+public:
+	DiagCache() :
+		stat(nullptr),
+		numbers(nullptr),
+		index(0),
+		quiet(false)
+	{ }
+
+	DiagCache &begin(diagnostic_updater::DiagnosticStatusWrapper &stat_) {
+		stat = &stat_;
+		numbers = DiagUpdater::running_values(stat_);
+		quiet = DiagUpdater::running_quiet(stat_);
+		index = 0;
+		return *this;
+	}
+
+	/**
+	 * @brief Add value formatted by @a format(), called only if @a values changed
+	 */
+	template<typename Key, typename Format>
+	void add(const Key &key, std::initializer_list<double> values, Format format) {
+		if (quiet)
+			return;
+
+		auto &e = next(key);
+		if (!e.valid || e.numbers.size() != values.size() ||
+				!std::equal(values.begin(), values.end(), e.numbers.begin())) {
+			e.numbers.assign(values.begin(), values.end());
+			e.value = format();
+			e.valid = true;
+		}
+
+		stat->add(e.key, e.value);
+		if (numbers)
+			numbers->insert(numbers->end(), values.begin(), values.end());
+	}
+
+	//! like DiagnosticStatusWrapper::addf(), numeric arguments only
+	template<typename Key, typename ... Args>
+	void addf(const Key &key, const char *fmt, Args ... args) {
+		static_assert(all_arithmetic<Args...>::value, "DiagCache::addf() takes only numbers, use add() for strings");
+
+		add(key, {static_cast<double>(args)...}, [&]() {
+					return mavconn::utils::format(fmt, args...);
+				});
+	}
+
+	//! string value, copied only when changed
+	template<typename Key>
+	void add(const Key &key, const char *value) {
+		if (quiet)
+			return;
+
+		auto &e = next(key);
+		if (!e.valid || e.value != value) {
+			e.numbers.clear();
+			e.value = value;
+			e.valid = true;
+		}
+
+		stat->add(e.key, e.value);
+	}
+
+	template<typename Key>
+	void add(const Key &key, const std::string &value) {
+		add(key, value.c_str());
+	}
+
+private:
+	struct Entry {
+		bool valid;
+		std::string key;
+		std::string value;
+		std::vector<double> numbers;
+
+		Entry() : valid(false) { }
+	};
+
+	template<typename ... Args>
+	struct all_arithmetic : std::true_type {};
+
+	template<typename T, typename ... Args>
+	struct all_arithmetic<T, Args...> : std::integral_constant<bool,
+		std::is_arithmetic<T>::value && all_arithmetic<Args...>::value> {};
+
+	diagnostic_updater::DiagnosticStatusWrapper *stat;
+	std::vector<double> *numbers;
+	size_t index;
+	bool quiet;
+	std::vector<Entry> entries;
+
+	template<typename Key>
+	Entry &next(const Key &key) {
+		if (index >= entries.size())
+			entries.emplace_back();
+
+		auto &e = entries[index++];
+		if (e.key != key) {
+			// optional entry appeared or gone, rest of layout shifted
+			e.key = key;
+			e.valid = false;
+		}
+
+		return e;
+	}
+};
+}	// namespace mavros
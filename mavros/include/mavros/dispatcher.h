@@ -0,0 +1,139 @@
+/**
+ * @brief Message dispatcher class
+ * @file dispatcher.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <mavconn/interface.h>
+#include <mavros/spsc_queue.h>
+
+namespace mavros {
+/**
+ * @brief Moves message handling from mavconn I/O thread to worker threads
+ *
+ * I/O thread copies each received message to lock-free queue of worker(s)
+ * selected by route table, so messages with same msgid always handled in order
+ * by each worker. Message without route goes to worker (msgid % nworkers).
+ *
+ * When queue is filled above @a DROP_THRESHOLD only messages from
+ * droppable list are discarded, other messages dropped only when queue is full.
+ */
+class Dispatcher : public diagnostic_updater::DiagnosticTask
+{
+public:
+	using HandlerCb = std::function<void (const mavlink::mavlink_message_t *msg, const mavconn::Framing framing,
+			uint64_t rx_stamp_ns, size_t worker)>;
+
+	//! Worker set for route, one bit per worker
+	using WorkerMask = uint64_t;
+
+	//! Limited by @a WorkerMask width
+	static constexpr size_t MAX_WORKERS = 64;
+
+	//! Queue fill ratio (percent) when droppable messages start to be discarded
+	static constexpr size_t DROP_THRESHOLD = 75;
+
+	explicit Dispatcher(std::string name);
+	~Dispatcher();
+
+	/**
+	 * @brief Start worker threads
+	 *
+	 * @param[in] nworkers     number of worker threads, each owns its queue, max @a MAX_WORKERS
+	 * @param[in] queue_size   per worker queue capacity
+	 * @param[in] cb           handler called from worker thread
+	 */
+	void start(size_t nworkers, size_t queue_size, HandlerCb cb);
+
+	/**
+	 * @brief Stop and join workers, queued messages are discarded
+	 *
+	 * Workers are destroyed, so diagnostics should not run concurrently.
+	 * push() may: it returns false once stopped.
+	 */
+	void stop();
+
+	//! Set list of msgids allowed to be dropped under overload, call before start()
+	void set_droppable(std::vector<mavlink::msgid_t> msgids);
+
+	/**
+	 * @brief Set workers which receive copy of @a msgid, call before start()
+	 *
+	 * Each selected worker gets own copy of message.
+	 */
+	void set_route(mavlink::msgid_t msgid, WorkerMask mask);
+
+	/**
+	 * @brief Enqueue message to worker
+	 *
+	 * @param[in] rx_stamp_ns  link receive time, passed to handler
+	 * @note Should be called only from one thread (link I/O thread).
+	 * @return false if message dropped or dispatcher stopped
+	 */
+	bool push(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, uint64_t rx_stamp_ns = 0);
+
+	inline bool is_running() const {
+		return running.load(std::memory_order_relaxed);
+	}
+
+	inline size_t worker_count() const {
+		return workers.size();
+	}
+
+	void run(diagnostic_updater::DiagnosticStatusWrapper &stat);
+
+private:
+	struct Item {
+		mavlink::mavlink_message_t msg;
+		mavconn::Framing framing;
+		uint64_t rx_stamp_ns;
+	};
+
+	struct Worker {
+		SPSCQueue<Item> queue;
+		size_t drop_level;
+
+		std::atomic<bool> waiting;
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::thread thread;
+
+		std::atomic<size_t> dropped;	//!< droppable messages discarded at threshold
+		std::atomic<size_t> overflow;	//!< messages discarded on full queue
+		size_t last_drop_count;		//!< diag only
+
+		explicit Worker(size_t queue_size);
+	};
+
+	HandlerCb handler_cb;
+	std::atomic<bool> running;
+	std::atomic<bool> in_push;	//!< push() in progress, stop() waits for it
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<mavlink::msgid_t> droppable;	// sorted
+	std::unordered_map<mavlink::msgid_t, WorkerMask> routes;
+
+	void worker_loop(Worker &w, size_t idx);
+	bool is_droppable(mavlink::msgid_t msgid) const;
+	bool push_to(Worker &w, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing, uint64_t rx_stamp_ns);
+};
+}	// namespace mavros
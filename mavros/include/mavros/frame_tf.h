@@ -140,6 +140,93 @@ Covariance9d transform_static_frame(const Covariance9d &cov, const StaticTF tran
  */
 Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec, const Eigen::Vector3d &map_origin, const StaticTF transform);
 
+/**
+ * @brief Axes mapping of static transform: out[i] = sign(i) * in[axis(i)]
+ *
+ * NED <-> ENU and aircraft <-> base_link axes are perfectly aligned,
+ * so these transforms are just swaps and sign flips.
+ * Defined only for such transforms, ECEF ones fail to compile.
+ */
+template<StaticTF transform>
+struct StaticAxisMap;
+
+template<>
+struct StaticAxisMap<StaticTF::NED_TO_ENU> {
+	static constexpr size_t axis(size_t i) { return (i == 0) ? 1 : (i == 1) ? 0 : 2; }
+	static constexpr double sign(size_t i) { return (i == 2) ? -1.0 : 1.0; }
+};
+
+template<>
+struct StaticAxisMap<StaticTF::ENU_TO_NED> : StaticAxisMap<StaticTF::NED_TO_ENU> {};
+
+template<>
+struct StaticAxisMap<StaticTF::AIRCRAFT_TO_BASELINK> {
+	static constexpr size_t axis(size_t i) { return i; }
+	static constexpr double sign(size_t i) { return (i == 0) ? 1.0 : -1.0; }
+};
+
+template<>
+struct StaticAxisMap<StaticTF::BASELINK_TO_AIRCRAFT> : StaticAxisMap<StaticTF::AIRCRAFT_TO_BASELINK> {};
+
+/**
+ * @brief Transform data expressed in one frame to another frame.
+ *
+ * Compile time variant, no matrix product.
+ */
+template<StaticTF transform>
+inline Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec)
+{
+	using M = StaticAxisMap<transform>;
+
+	return Eigen::Vector3d(
+		M::sign(0) * vec(M::axis(0)),
+		M::sign(1) * vec(M::axis(1)),
+		M::sign(2) * vec(M::axis(2)));
+}
+
+/**
+ * @brief Transform 3d, 6d or 9d covariance expressed in one frame to another
+ *
+ * Compile time variant of R * cov * R^T, where R is block diagonal
+ * of axes mapping, so each element just moved and maybe negated.
+ */
+template<StaticTF transform, size_t N>
+inline boost::array<double, N> transform_static_frame(const boost::array<double, N> &cov)
+{
+	static_assert(N == 9 || N == 36 || N == 81, "3x3, 6x6 or 9x9 covariance expected");
+	using M = StaticAxisMap<transform>;
+	constexpr size_t D = (N == 9) ? 3 : (N == 36) ? 6 : 9;
+
+	// keep unknown covariance marker in place
+	if (cov[0] == -1.0)
+		return cov;
+
+	boost::array<double, N> out;
+	for (size_t r = 0; r < D; r++) {
+		const size_t in_r = r - r % 3 + M::axis(r % 3);
+		const double sign_r = M::sign(r % 3);
+
+		for (size_t c = 0; c < D; c++) {
+			const size_t in_c = c - c % 3 + M::axis(c % 3);
+			out[r * D + c] = sign_r * M::sign(c % 3) * cov[in_r * D + in_c];
+		}
+	}
+
+	return out;
+}
+
+/**
+ * @brief Transform contiguous array of points (trajectory, waypoints, obstacles...)
+ *
+ * @a in and @a out may be the same array.
+ */
+template<StaticTF transform>
+inline void transform_static_frame(const Eigen::Vector3d *in, Eigen::Vector3d *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = transform_static_frame<transform>(in[i]);
+}
+
 }	// namespace detail
 
 // -*- frame tf -*-
@@ -185,7 +272,12 @@ inline T transform_orientation_baselink_aircraft(const T &in) {
  */
 template<class T>
 inline T transform_frame_ned_enu(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::NED_TO_ENU);
+	return detail::transform_static_frame<StaticTF::NED_TO_ENU>(in);
+}
+
+//! @brief Batch variant of @a transform_frame_ned_enu(), @a in and @a out may be the same
+inline void transform_frame_ned_enu(const Eigen::Vector3d *in, Eigen::Vector3d *out, size_t count) {
+	detail::transform_static_frame<StaticTF::NED_TO_ENU>(in, out, count);
 }
 
 /**
@@ -194,7 +286,12 @@ inline T transform_frame_ned_enu(const T &in) {
  */
 template<class T>
 inline T transform_frame_enu_ned(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::ENU_TO_NED);
+	return detail::transform_static_frame<StaticTF::ENU_TO_NED>(in);
+}
+
+//! @brief Batch variant of @a transform_frame_enu_ned(), @a in and @a out may be the same
+inline void transform_frame_enu_ned(const Eigen::Vector3d *in, Eigen::Vector3d *out, size_t count) {
+	detail::transform_static_frame<StaticTF::ENU_TO_NED>(in, out, count);
 }
 
 /**
@@ -203,7 +300,12 @@ inline T transform_frame_enu_ned(const T &in) {
  */
 template<class T>
 inline T transform_frame_aircraft_baselink(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::AIRCRAFT_TO_BASELINK);
+	return detail::transform_static_frame<StaticTF::AIRCRAFT_TO_BASELINK>(in);
+}
+
+//! @brief Batch variant of @a transform_frame_aircraft_baselink(), @a in and @a out may be the same
+inline void transform_frame_aircraft_baselink(const Eigen::Vector3d *in, Eigen::Vector3d *out, size_t count) {
+	detail::transform_static_frame<StaticTF::AIRCRAFT_TO_BASELINK>(in, out, count);
 }
 
 /**
@@ -212,7 +314,12 @@ inline T transform_frame_aircraft_baselink(const T &in) {
  */
 template<class T>
 inline T transform_frame_baselink_aircraft(const T &in) {
-	return detail::transform_static_frame(in, StaticTF::BASELINK_TO_AIRCRAFT);
+	return detail::transform_static_frame<StaticTF::BASELINK_TO_AIRCRAFT>(in);
+}
+
+//! @brief Batch variant of @a transform_frame_baselink_aircraft(), @a in and @a out may be the same
+inline void transform_frame_baselink_aircraft(const Eigen::Vector3d *in, Eigen::Vector3d *out, size_t count) {
+	detail::transform_static_frame<StaticTF::BASELINK_TO_AIRCRAFT>(in, out, count);
 }
 
 /**
@@ -293,6 +400,21 @@ inline T transform_frame_baselink_enu(const T &in, const Eigen::Quaterniond &q)
 	return detail::transform_frame(in, q);
 }
 
+/**
+ * @brief Rotate covariance in place, e.g. right in ROS message field
+ *
+ * Same as R * cov * R^T with block diagonal R, but computed per 3x3 block,
+ * all-zero blocks skipped. Unknown covariance (first element -1) left untouched.
+ */
+void rotate_covariance(Covariance3d &cov, const Eigen::Matrix3d &R);
+void rotate_covariance(Covariance6d &cov, const Eigen::Matrix3d &R);
+void rotate_covariance(Covariance9d &cov, const Eigen::Matrix3d &R);
+
+template<class T>
+inline void rotate_covariance(T &cov, const Eigen::Quaterniond &q) {
+	rotate_covariance(cov, q.normalized().toRotationMatrix());
+}
+
 // -*- utils -*-
 
 
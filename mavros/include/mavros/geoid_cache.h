@@ -0,0 +1,159 @@
+/**
+ * @brief Geoid height lookup cache
+ * @file geoid_cache.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <mavros/seqlock.h>
+
+namespace mavros {
+/**
+ * @brief Memo of geoid heights around vehicle
+ *
+ * Space divided to cells of 30" (about 900 m), height inside cell
+ * is bilinear interpolation of exact geoid heights at cell corners.
+ * Geoid varies on much larger scale, so error stays at mm level,
+ * but lookup costs few flops instead of cubic interpolation over dataset.
+ *
+ * Cells kept in direct mapped 8x8 table, so any 8x8 cells area
+ * (like one filled by preload()) fits without eviction.
+ * Readers do not lock: each slot is @a SeqLock.
+ */
+class GeoidCache {
+public:
+	//! Geoid height above ellipsoid [m] at lat, lon [deg]
+	using HeightFn = std::function<double(double lat, double lon)>;
+
+	//! Cell size, degrees
+	static constexpr double CELL_DEG = 1.0 / 120.0;
+	//! Table is TABLE_SIDE x TABLE_SIDE cells
+	static constexpr int64_t TABLE_SIDE = 8;
+
+	explicit GeoidCache(HeightFn fn = nullptr) :
+		height_fn(fn)
+	{ }
+
+	GeoidCache(const GeoidCache&) = delete;
+	GeoidCache &operator=(const GeoidCache&) = delete;
+
+	/**
+	 * @brief Set geoid model and drop cached cells
+	 *
+	 * @note Not safe against concurrent height() calls, only for initialization.
+	 */
+	void reset(HeightFn fn)
+	{
+		height_fn = fn;
+		for (auto &slot : slots)
+			slot.store(Cell {});
+	}
+
+	inline bool is_valid() const {
+		return bool(height_fn);
+	}
+
+	//! Geoid height above ellipsoid [m], 0 if model not set
+	double height(double lat, double lon)
+	{
+		if (!height_fn)
+			return 0.0;
+
+		const double y = lat / CELL_DEG;
+		const double x = lon / CELL_DEG;
+		const int64_t ilat = std::floor(y);
+		const int64_t ilon = std::floor(x);
+
+		auto &slot = slots[index(ilat, ilon)];
+		Cell c = slot.load();
+		if (!c.valid || c.ilat != ilat || c.ilon != ilon) {
+			c = make_cell(ilat, ilon);
+			slot.store(c);
+		}
+
+		const double fy = y - ilat;
+		const double fx = x - ilon;
+		return (1.0 - fy) * ((1.0 - fx) * c.h[0] + fx * c.h[1]) +
+		       fy * ((1.0 - fx) * c.h[2] + fx * c.h[3]);
+	}
+
+	/**
+	 * @brief Fill cells around point, so first lookups there do not touch geoid model
+	 *
+	 * Area limited to table size (about 7 km).
+	 *
+	 * @return number of cells computed
+	 */
+	size_t preload(double lat, double lon, double radius_m)
+	{
+		if (!height_fn)
+			return 0;
+
+		// cell count from center to edge, both directions fit to table
+		constexpr double M_PER_DEG = 111320.0;
+		const double cos_lat = std::max(0.01, std::cos(lat * M_PI / 180.0));
+		const int64_t max_half = (TABLE_SIDE - 1) / 2;
+		const int64_t half_lat = std::min<int64_t>(max_half, std::ceil(radius_m / M_PER_DEG / CELL_DEG));
+		const int64_t half_lon = std::min<int64_t>(max_half, std::ceil(radius_m / (M_PER_DEG * cos_lat) / CELL_DEG));
+
+		const int64_t clat = std::floor(lat / CELL_DEG);
+		const int64_t clon = std::floor(lon / CELL_DEG);
+		size_t count = 0;
+
+		for (int64_t ilat = clat - half_lat; ilat <= clat + half_lat; ilat++) {
+			for (int64_t ilon = clon - half_lon; ilon <= clon + half_lon; ilon++) {
+				slots[index(ilat, ilon)].store(make_cell(ilat, ilon));
+				count++;
+			}
+		}
+
+		return count;
+	}
+
+private:
+	struct Cell {
+		int64_t ilat;
+		int64_t ilon;
+		double h[4];	//!< corners: (lat, lon), (lat, lon+1), (lat+1, lon), (lat+1, lon+1)
+		bool valid;
+	};
+
+	HeightFn height_fn;
+	SeqLock<Cell> slots[TABLE_SIDE * TABLE_SIDE];
+
+	static inline size_t index(int64_t ilat, int64_t ilon) {
+		// two's complement: negative indexes wrap as well
+		const uint64_t mask = TABLE_SIDE - 1;
+		return (uint64_t(ilat) & mask) * TABLE_SIDE + (uint64_t(ilon) & mask);
+	}
+
+	Cell make_cell(int64_t ilat, int64_t ilon) const
+	{
+		const double lat0 = std::max(-90.0, std::min(90.0, ilat * CELL_DEG));
+		const double lat1 = std::max(-90.0, std::min(90.0, (ilat + 1) * CELL_DEG));
+		const double lon0 = ilon * CELL_DEG;
+		const double lon1 = (ilon + 1) * CELL_DEG;
+
+		return Cell {
+			ilat, ilon,
+			{ height_fn(lat0, lon0), height_fn(lat0, lon1), height_fn(lat1, lon0), height_fn(lat1, lon1) },
+			true
+		};
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,181 @@
+/**
+ * @brief Wire to publish latency tracing
+ * @file latency_trace.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace mavros {
+/**
+ * @brief Stage timestamps of received frames
+ *
+ * Thread handling frame calls begin(), mark() at each stage it passes
+ * and end(). Record is built in thread local storage and then copied
+ * to ring of that thread (single writer, per slot sequence counter),
+ * so traced path takes no locks.
+ *
+ * collect() drains rings into per msgid histograms, dump() writes
+ * records still in rings as Chrome trace event JSON (perfetto and
+ * chrome://tracing open it).
+ *
+ * All stamps are CLOCK_REALTIME, same as link receive stamp.
+ *
+ * @note In code use MAVROS_TRACE_* macros: they are empty unless
+ *       mavros built with MAVROS_ENABLE_TRACE.
+ */
+class LatencyTrace {
+public:
+	enum Stage : uint8_t {
+		RX = 0,		//!< link read (kernel stamp if available)
+		ROUTE,		//!< parsed, dispatched to plugin routes
+		HANDLER,	//!< plugin handler entered
+		PUBLISH,	//!< first ROS publish of handler
+		DONE,		//!< all handlers returned
+		STAGE_COUNT
+	};
+
+	//! Records kept per thread
+	static constexpr size_t RING_SIZE = 1024;
+	//! Histogram bins: [0, 1) us, then [2^(k-1), 2^k) us
+	static constexpr size_t HIST_BINS = 24;
+
+	struct Record {
+		uint64_t msgid;
+		std::array<uint64_t, STAGE_COUNT> stamp_ns;	//!< 0 - stage not passed
+	};
+
+	struct Histogram {
+		std::array<uint64_t, HIST_BINS> bins;
+		uint64_t count;
+		uint64_t max_ns;
+
+		Histogram() :
+			bins{},
+			count(0),
+			max_ns(0)
+		{ }
+
+		void add(uint64_t ns);
+		//! upper bound of bin where @a p quantile falls [s]
+		double quantile(double p) const;
+	};
+
+	struct MsgStat {
+		Histogram total;				//!< RX to DONE
+		std::array<Histogram, STAGE_COUNT> stage;	//!< from previous passed stage, RX unused
+	};
+
+	static LatencyTrace &instance();
+
+	//! runtime switch, when off traced path only checks flags
+	inline void set_enabled(bool enable) {
+		enabled.store(enable, std::memory_order_relaxed);
+	}
+
+	inline bool is_enabled() const {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	//! start record of frame in this thread, @a rx_stamp_ns = 0 - stamp now
+	void begin(uint32_t msgid, uint64_t rx_stamp_ns);
+	//! stamp stage of current record, first mark of stage wins
+	void mark(Stage stage);
+	//! stamp DONE and store record
+	void end();
+
+	/**
+	 * Move new records of all threads to histograms
+	 *
+	 * @return histograms since start, by msgid
+	 */
+	std::map<uint32_t, MsgStat> collect();
+
+	//! Records overwritten before collect()
+	inline uint64_t overruns() const {
+		return overruns_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Write records in rings as Chrome trace event JSON
+	 *
+	 * @return number of records written
+	 * @throws std::runtime_error  on file error
+	 */
+	size_t dump(const std::string &path);
+
+	static const char *stage_name(Stage stage);
+
+	//! stamp in trace clock
+	static uint64_t now_ns();
+
+private:
+	static constexpr size_t N_WORDS = 1 + STAGE_COUNT;
+
+	struct Slot {
+		std::atomic<uint32_t> seq;	//!< odd - being written
+		std::array<std::atomic<uint64_t>, N_WORDS> words;
+	};
+
+	struct Ring {
+		size_t tid;
+		std::atomic<uint64_t> head;	//!< records written
+		uint64_t read_pos;		//!< collect() side
+		std::array<Slot, RING_SIZE> slots;
+
+		explicit Ring(size_t tid);
+		void push(const Record &rec);
+		//! copy of record @a pos, false if overwritten meanwhile
+		bool read(uint64_t pos, Record &rec) const;
+	};
+
+	struct ThreadState {
+		Ring *ring;
+		bool active;
+		Record rec;
+	};
+
+	LatencyTrace();
+
+	std::atomic<bool> enabled;
+	std::atomic<uint64_t> overruns_;
+
+	//! guards rings list and histograms
+	std::mutex mutex;
+	std::vector<std::unique_ptr<Ring>> rings;
+	std::map<uint32_t, MsgStat> stats;
+
+	static ThreadState &thread_state();
+	Ring *register_ring();
+	void add_record(const Record &rec);
+};
+}	// namespace mavros
+
+#ifdef MAVROS_TRACE
+#define MAVROS_TRACE_BEGIN(msgid, rx_stamp_ns)	mavros::LatencyTrace::instance().begin(msgid, rx_stamp_ns)
+#define MAVROS_TRACE_MARK(stage)		mavros::LatencyTrace::instance().mark(mavros::LatencyTrace::stage)
+#define MAVROS_TRACE_END()			mavros::LatencyTrace::instance().end()
+#else
+#define MAVROS_TRACE_BEGIN(msgid, rx_stamp_ns)	do { } while (0)
+#define MAVROS_TRACE_MARK(stage)		do { } while (0)
+#define MAVROS_TRACE_END()			do { } while (0)
+#endif
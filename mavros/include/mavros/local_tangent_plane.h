@@ -0,0 +1,188 @@
+/**
+ * @brief Geodetic to local ENU conversion with cached origin
+ * @file local_tangent_plane.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Eigen>
+#include <GeographicLib/Geocentric.hpp>
+
+namespace mavros {
+/**
+ * @brief LLA -> ENU of map origin
+ *
+ * Origin ECEF position and ECEF -> ENU rotation computed once in set_origin().
+ *
+ * Exact conversion is LLA -> ECEF (GeographicLib) then rotation.
+ * Vehicle moves little between fixes, so most points are converted with
+ * first order expansion around last exactly converted point (anchor):
+ * enu = enu_anchor + J * (lla - lla_anchor), a 3x3 product.
+ * Error grows as (distance to anchor)^2 / earth radius, below 1 mm for 100 m.
+ * Anchor moves to exactly converted point when point is farther than
+ * @a radius, or every @a period conversions.
+ */
+class LocalTangentPlane {
+public:
+	//! Default anchor radius [m]
+	static constexpr double DEFAULT_RADIUS = 100.0;
+	//! Default exact conversion period
+	static constexpr size_t DEFAULT_PERIOD = 50;
+
+	/**
+	 * @param radius  max distance to anchor for linear conversion [m], 0 - always exact
+	 * @param period  convert exactly at least every @a period points
+	 */
+	explicit LocalTangentPlane(double radius = DEFAULT_RADIUS, size_t period = DEFAULT_PERIOD) :
+		earth(GeographicLib::Geocentric::WGS84()),
+		radius(radius),
+		period(period),
+		has_anchor(false),
+		since_exact(0),
+		exact_count_(0),
+		linear_count_(0)
+	{
+		set_origin(Eigen::Vector3d::Zero());
+	}
+
+	/**
+	 * @brief Change linear conversion limits, see constructor
+	 */
+	void set_linear_limits(double radius_, size_t period_)
+	{
+		radius = radius_;
+		period = period_;
+	}
+
+	/**
+	 * @brief Set origin
+	 * @param lla  latitude, longitude [deg], height above ellipsoid [m]
+	 */
+	void set_origin(const Eigen::Vector3d &lla)
+	{
+		std::vector<double> m(9);
+		earth.Forward(lla.x(), lla.y(), lla.z(),
+				ecef_origin_.x(), ecef_origin_.y(), ecef_origin_.z(), m);
+
+		// m is row major ENU -> ECEF rotation
+		origin_ = lla;
+		ecef_to_enu_ = Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor> >(m.data()).transpose();
+		has_anchor = false;
+	}
+
+	//! Origin [lla]
+	inline const Eigen::Vector3d &origin() const {
+		return origin_;
+	}
+
+	//! Origin [ECEF]
+	inline const Eigen::Vector3d &ecef_origin() const {
+		return ecef_origin_;
+	}
+
+	//! ECEF -> ENU rotation at origin
+	inline const Eigen::Matrix3d &ecef_to_enu() const {
+		return ecef_to_enu_;
+	}
+
+	//! Local ENU [m] of @a lla, exact
+	Eigen::Vector3d to_enu_exact(const Eigen::Vector3d &lla) const
+	{
+		Eigen::Vector3d ecef;
+		earth.Forward(lla.x(), lla.y(), lla.z(), ecef.x(), ecef.y(), ecef.z());
+		return ecef_to_enu_ * (ecef - ecef_origin_);
+	}
+
+	//! Local ENU [m] of @a lla
+	Eigen::Vector3d to_enu(const Eigen::Vector3d &lla)
+	{
+		if (has_anchor && radius > 0.0 && ++since_exact < period) {
+			Eigen::Vector3d d = lla - anchor_lla;
+			d.y() = std::remainder(d.y(), 360.0);
+
+			const Eigen::Vector3d delta = jacobian * d;
+			if (delta.squaredNorm() <= radius * radius) {
+				linear_count_++;
+				return anchor_enu + delta;
+			}
+		}
+
+		return set_anchor(lla);
+	}
+
+	//! conversions done exactly
+	inline size_t exact_count() const {
+		return exact_count_;
+	}
+
+	//! conversions done by linear expansion
+	inline size_t linear_count() const {
+		return linear_count_;
+	}
+
+private:
+	const GeographicLib::Geocentric &earth;
+	double radius;
+	size_t period;
+
+	Eigen::Vector3d origin_;
+	Eigen::Vector3d ecef_origin_;
+	Eigen::Matrix3d ecef_to_enu_;
+
+	bool has_anchor;
+	size_t since_exact;
+	Eigen::Vector3d anchor_lla;
+	Eigen::Vector3d anchor_enu;
+	Eigen::Matrix3d jacobian;	//!< d enu / d (lat [deg], lon [deg], alt [m]) at anchor
+
+	size_t exact_count_;
+	size_t linear_count_;
+
+	Eigen::Vector3d set_anchor(const Eigen::Vector3d &lla)
+	{
+		constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+		std::vector<double> m(9);
+		Eigen::Vector3d ecef;
+		earth.Forward(lla.x(), lla.y(), lla.z(), ecef.x(), ecef.y(), ecef.z(), m);
+		const Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor> > enu_to_ecef(m.data());
+
+		// meridian and prime vertical radii of curvature
+		const double a = earth.MajorRadius();
+		const double f = earth.Flattening();
+		const double e2 = f * (2.0 - f);
+		const double sin_lat = std::sin(lla.x() * DEG_TO_RAD);
+		const double w2 = 1.0 - e2 * sin_lat * sin_lat;
+		const double rn = a / std::sqrt(w2);
+		const double rm = rn * (1.0 - e2) / w2;
+
+		// (lat, lon, alt) -> ENU at anchor
+		Eigen::Matrix3d s = Eigen::Matrix3d::Zero();
+		s(0, 1) = (rn + lla.z()) * std::cos(lla.x() * DEG_TO_RAD) * DEG_TO_RAD;
+		s(1, 0) = (rm + lla.z()) * DEG_TO_RAD;
+		s(2, 2) = 1.0;
+
+		anchor_lla = lla;
+		anchor_enu = ecef_to_enu_ * (ecef - ecef_origin_);
+		jacobian.noalias() = ecef_to_enu_ * enu_to_ecef * s;
+		has_anchor = true;
+		since_exact = 0;
+		exact_count_++;
+
+		return anchor_enu;
+	}
+};
+}	// namespace mavros
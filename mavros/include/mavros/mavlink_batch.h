@@ -0,0 +1,92 @@
+/**
+ * @brief Mavlink batch publisher
+ * @file mavlink_batch.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <ros/ros.h>
+#include <mavconn/interface.h>
+#include <mavros/mavros_plugin.h>
+#include <mavros_msgs/MavlinkBatch.h>
+#include <mavros_msgs/mavlink_convert.h>
+
+namespace mavros {
+/**
+ * @brief Packs mavlink frames to mavros_msgs/MavlinkBatch
+ *
+ * Batch published when it contains @a batch_size frames
+ * or by timer, so frame latency is limited by timeout.
+ * Nothing collected while topic has no subscribers.
+ *
+ * @note push() may be called from several threads.
+ */
+class MavlinkBatcher
+{
+public:
+	MavlinkBatcher();
+
+	/**
+	 * @brief Advertise batch topic and start flush timer
+	 *
+	 * @param[in] nh          node handle of topic
+	 * @param[in] topic       topic name
+	 * @param[in] batch_size  frames per batch, 0 - do not advertise
+	 * @param[in] timeout     max time between push() and publish
+	 */
+	void advertise(ros::NodeHandle &nh, const std::string &topic, size_t batch_size, ros::Duration timeout);
+
+	inline bool is_enabled() const {
+		return batch_size > 0;
+	}
+
+	//! Add frame to current batch, publish it if full
+	void push(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+
+	//! Publish collected frames now
+	void flush();
+
+private:
+	plugin::LazyPublisher pub;
+	ros::Timer flush_timer;
+	size_t batch_size;
+
+	std::mutex mutex;
+	mavros_msgs::MavlinkBatch::Ptr batch;
+
+	void publish_locked();
+};
+
+/**
+ * @brief Convert each frame of batch and pass it to @a send
+ *
+ * @return number of frames failed to convert
+ */
+template<typename _Send>
+size_t unpack_batch(const mavros_msgs::MavlinkBatch &batch, _Send send)
+{
+	size_t errors = 0;
+	mavlink::mavlink_message_t mmsg;
+
+	for (auto &rmsg : batch.messages) {
+		if (mavros_msgs::mavlink::convert(rmsg, mmsg))
+			send(&mmsg);
+		else
+			errors++;
+	}
+
+	return errors;
+}
+}	// namespace mavros
@@ -18,6 +18,8 @@
 
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <mavconn/interface.h>
+#include <mavros/protocol_negotiator.h>
+#include <mavros/diag_updater.h>
 
 namespace mavros {
 class MavlinkDiag : public diagnostic_updater::DiagnosticTask
@@ -35,10 +37,19 @@ public:
 		is_connected = connected;
 	}
 
+	//! report protocol negotiation state (fcu_protocol: auto)
+	void set_protocol_negotiator(const ProtocolNegotiator *negotiator) {
+		protocol_negotiator = negotiator;
+	}
+
 private:
 	mavconn::MAVConnInterface::WeakPtr weak_link;
 	unsigned int last_drop_count;
+	size_t last_tx_drop_count;
+	size_t last_seq_lost_count;
 	std::atomic<bool> is_connected;
+	const ProtocolNegotiator *protocol_negotiator;
+	DiagCache cache;
 };
 };	// namespace mavros
 
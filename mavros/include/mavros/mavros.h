@@ -18,11 +18,28 @@
 #pragma once
 
 #include <array>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include <ros/ros.h>
-#include <pluginlib/class_loader.h>
+#include <ros/callback_queue.h>
+#include <mavros/plugin_registry.h>
 #include <mavconn/interface.h>
+#include <mavconn/router.h>
+#include <mavconn/rate_limiter.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/plugin_stats.h>
 #include <mavros/mavlink_diag.h>
+#include <mavros/dispatcher.h>
+#include <mavros/route_table.h>
+#include <mavros/mavlink_batch.h>
+#include <mavros/message_pool.h>
+#include <mavros/stream_stats.h>
+#include <mavros/latency_trace.h>
+#include <mavros/protocol_negotiator.h>
+#include <mavros_msgs/MavlinkRaw.h>
+#include <mavros_msgs/StreamStatusList.h>
+#include <std_srvs/Trigger.h>
 #include <mavros/utils.h>
 
 namespace mavros {
@@ -30,53 +47,211 @@ namespace mavros {
  * @brief MAVROS node class
  *
  * This class implement mavros_node
+ *
+ * In multi-vehicle mode (multi_vehicle/enable) one FCU link serves many vehicles:
+ * messages demultiplexed by sysid, each vehicle gets own UAS and plugin set
+ * in "~<multi_vehicle/prefix><sysid>" namespace, created on its first autopilot HEARTBEAT.
+ * Links, dispatcher, spinner queues and geoid dataset are shared.
  */
 class MavRos
 {
 public:
-	MavRos();
-	~MavRos() {};
+	/**
+	 * @param[in] nh  node handle used for node parameters
+	 */
+	explicit MavRos(const ros::NodeHandle &nh = ros::NodeHandle("~"));
+	~MavRos();
+
+	//! start periodic tasks and spinners of plugin queues, global queue served by caller's spinner (nodelet)
+	void start();
 
+	//! start() and serve callbacks until ROS shutdown (node)
 	void spin();
 
 private:
+	ros::NodeHandle node_nh;
 	ros::NodeHandle mavlink_nh;
+	ros::Timer diag_timer;
 	// fcu_link stored in mav_uas
 	mavconn::MAVConnInterface::Ptr gcs_link;
+	//! forwards messages between FCU, GCS and router/urls links in their I/O threads
+	mavconn::Router::Ptr router;
+	//! optional limits of messages forwarded to GCS link
+	mavconn::TxRateLimiter::Ptr gcs_limiter;
 	bool gcs_quiet_mode;
 	ros::Time last_message_received_from_gcs;
 	ros::Duration conn_timeout;
 
-	ros::Publisher mavlink_pub;
+	plugin::LazyPublisher mavlink_pub;
 	ros::Subscriber mavlink_sub;
+	MavlinkBatcher mavlink_batch_pub;
+	ros::Subscriber mavlink_batch_sub;
+	plugin::LazyPublisher mavlink_raw_pub;
+	ros::Subscriber mavlink_raw_sub;
+	MessagePool<mavros_msgs::MavlinkRaw> mavlink_raw_pool;
+
+	//! arrival statistics of FCU messages (stream_stats)
+	StreamStats stream_stats;
+	bool stream_stats_enabled;
+	double stream_stats_rate;
+	ros::Publisher stream_stats_pub;
+	ros::Timer stream_stats_timer;
+
+	//! latency trace export, only with MAVROS_ENABLE_TRACE build
+	std::string trace_dump_file;
+	ros::ServiceServer trace_dump_srv;
 
-	diagnostic_updater::Updater gcs_diag_updater;
+	DiagUpdater gcs_diag_updater;
 	MavlinkDiag fcu_link_diag;
 	MavlinkDiag gcs_link_diag;
 
-	pluginlib::ClassLoader<plugin::PluginBase> plugin_loader;
+	//! fcu_protocol: auto
+	bool fcu_protocol_auto;
+	ProtocolNegotiator fcu_protocol_negotiator;
+
+	//! separate callback queue of plugin group (spinner/queues)
+	struct SpinnerQueue {
+		std::string name;
+		int threads;
+		ros::V_string plugins;		//!< plugin name patterns
+		std::unique_ptr<ros::CallbackQueue> queue;
+		std::unique_ptr<ros::AsyncSpinner> spinner;
+	};
+	//! @note declared before plugins: their callbacks should leave queues first
+	std::vector<SpinnerQueue> spinner_queues;
+	//! threads serving global queue in spin()
+	int spinner_threads;
+
+	//! handler and callback accounting of one plugin (plugin_stats/enable)
+	struct PluginAccount {
+		std::string name;
+		plugin::PluginStats::Ptr stats;
+		std::unique_ptr<plugin::StatsCallbackQueue> queue;
+		uint64_t last_cycles;		//!< at previous diag run
+	};
+	//! @note declared before plugins: their node handles use queue proxies
+	bool plugin_stats_enabled;
+	std::mutex plugin_stats_mutex;
+	std::vector<PluginAccount> plugin_accounts;
+	ros::WallTime plugin_stats_last;
+
+	plugin::PluginRegistry plugin_loader;
 	std::vector<plugin::PluginBase::Ptr> loaded_plugins;
+	ros::V_string plugin_blacklist;
+	ros::V_string plugin_whitelist;
 
-	//! FCU link -> router -> plugin handler
-	std::unordered_map<mavlink::msgid_t, plugin::PluginBase::Subscriptions> plugin_subscriptions;
+	//! startup profile, same order as loaded_plugins
+	struct PluginTiming {
+		std::string name;
+		ros::WallDuration load_time;
+		ros::WallDuration init_time;
+		size_t shard;		//!< dispatch worker (plugin shard mode)
+	};
+	std::vector<PluginTiming> plugin_timings;
+
+	using SubscriptionsMap = RouteTable::SubscriptionsMap;
+
+	//! plugin handlers collected by add_plugin()
+	SubscriptionsMap plugin_subscriptions;
+	//! per dispatch worker subset of plugin_subscriptions (plugin shard mode only)
+	std::vector<SubscriptionsMap> shard_subscriptions;
+
+	//! FCU link -> router -> plugin handler, frozen after plugin loading
+	RouteTable plugin_routes;
+	std::vector<RouteTable> shard_routes;
 
 	//! UAS object passed to all plugins
 	UAS mav_uas;
 
+	//! multi-vehicle mode: context of one FCU sysid
+	struct Vehicle {
+		uint8_t sysid;
+		std::unique_ptr<UAS> uas;
+		std::vector<plugin::PluginBase::Ptr> plugins;
+		RouteTable routes;
+	};
+
+	bool multi_vehicle;
+	std::string vehicle_prefix;
+	std::vector<int> vehicle_sysids;	//!< allowed sysids, empty - any
+	int max_vehicles;
+	int vehicle_tgt_component;
+	std::string vehicle_hw_id;
+	//! owned contexts, appended by vehicle_timer, guarded by vehicles_mutex
+	std::mutex vehicles_mutex;
+	std::mutex vehicle_create_mutex;
+	std::vector<std::unique_ptr<Vehicle>> vehicles;
+	//! lookup of dispatch workers, set once per sysid after vehicle initialized
+	std::array<std::atomic<Vehicle*>, 256> vehicle_by_sysid;
+	//! HEARTBEAT from new vehicle seen, create it
+	std::array<std::atomic<bool>, 256> vehicle_pending;
+	//! vehicles with HEARTBEAT, FCU connection diag is ok while any
+	std::atomic<int> vehicles_connected;
+	ros::Timer vehicle_timer;
+
+	//! fcu link -> worker threads -> router
+	//! @note declared after plugins: workers should be stopped first
+	Dispatcher dispatcher;
+
 	//! fcu link -> ros
 	void mavlink_pub_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
 	//! ros -> fcu link
 	void mavlink_sub_cb(const mavros_msgs::Mavlink::ConstPtr &rmsg);
+	//! ros -> fcu link, batched
+	void mavlink_batch_sub_cb(const mavros_msgs::MavlinkBatch::ConstPtr &batch);
+	//! ros -> fcu link, verbatim frame
+	void mavlink_raw_sub_cb(const mavros_msgs::MavlinkRaw::ConstPtr &rmsg);
+
+	//! FCU heartbeat framing -> output protocol, FCU I/O thread
+	void fcu_protocol_cb(mavconn::MAVConnInterface *link, const mavlink::mavlink_message_t *mmsg);
+	//! fcu link message handling in dispatch worker
+	void dispatch_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing,
+			uint64_t rx_stamp_ns, size_t worker);
+	void setup_dispatch_routes(size_t nworkers);
+	//! count message in stream_stats, called once per message
+	void stream_stats_tick(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing, uint64_t rx_stamp_ns);
+	void stream_stats_publish();
+	void stream_stats_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
+	void trace_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
+	bool trace_dump_cb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
 
 	//! message router
-	void plugin_route_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+	void plugin_route_cb(const RouteTable &routes, const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+	//! multi-vehicle mode router, notes new vehicles
+	void vehicle_route_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing);
+	//! create pending vehicles, ROS thread
+	void vehicle_timer_cb();
+	void create_vehicle(uint8_t sysid);
+	void vehicles_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
-	//! load plugin
+	//! load plugin and collect its routes
 	void add_plugin(std::string &pl_name, ros::V_string &blacklist, ros::V_string &whitelist);
+	//! initialize loaded plugins, not matching @a serial ones in @a nthreads threads
+	void initialize_plugins(size_t nthreads, ros::V_string &serial);
+	void initialize_plugin(size_t idx);
+	void plugin_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
+	/**
+	 * @brief Start accounting of plugin @a name, if enabled
+	 *
+	 * @param[in,out] queue  plugin callback queue, replaced by accounting proxy
+	 * @return stats for plugin handlers, nullptr - disabled
+	 */
+	plugin::PluginStats *add_plugin_stats(const std::string &name, ros::CallbackQueueInterface *&queue);
+	void plugin_stats_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
 	//! start mavlink app on USB
 	void startup_px4_usb_quirk();
 	void log_connect_change(bool connected);
+	bool setup_gcs_limits(const ros::NodeHandle &nh);
+	void setup_spinner_queues(const ros::NodeHandle &nh);
+	//! queue of first group matching plugin, nullptr - global
+	ros::CallbackQueue *find_callback_queue(std::string &pl_name);
+	void stop_spinners();
+	void setup_tf_aggregator(const ros::NodeHandle &nh, UAS &uas);
+	void setup_stream_demand(const ros::NodeHandle &nh, UAS &uas);
+	void setup_timer_wheel(const ros::NodeHandle &nh, UAS &uas);
+	//! router endpoint counters
+	void router_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat, const std::vector<std::string> &names);
 };
 }	// namespace mavros
 
@@ -18,11 +18,18 @@
 #pragma once
 
 #include <tuple>
+#include <string>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <functional>
+#include <type_traits>
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <mavconn/interface.h>
 #include <mavros/mavros_uas.h>
+#include <mavros/plugin_stats.h>
 
 namespace mavros {
 namespace plugin {
@@ -31,6 +38,72 @@ using mavros::UAS;
 typedef std::lock_guard<std::recursive_mutex> lock_guard;
 typedef std::unique_lock<std::recursive_mutex> unique_lock;
 
+/**
+ * @brief ros::Publisher which knows if topic has subscribers
+ *
+ * Subscriber count cached by connect/disconnect callbacks,
+ * so has_subscribers() is one atomic load, unlike
+ * ros::Publisher::getNumSubscribers() which locks publication.
+ *
+ * Handler should check it before message allocation and conversion:
+ * @code
+ * if (!foo_pub.has_subscribers())
+ *	return;
+ *
+ * auto msg = boost::make_shared<Foo>();
+ * ...
+ * foo_pub.publish(msg);
+ * @endcode
+ *
+ * @note Do not use it for latched topics: skipped message will not be latched.
+ */
+class LazyPublisher {
+public:
+	LazyPublisher() :
+		num_subscribers(std::make_shared<std::atomic<int>>(0))
+	{ }
+
+	template<class M>
+	void advertise(ros::NodeHandle &nh, const std::string &topic, uint32_t queue_size) {
+		// callbacks may outlive this object, so counter is shared with them
+		auto cnt = num_subscribers;
+
+		pub = nh.advertise<M>(topic, queue_size,
+				[cnt](const ros::SingleSubscriberPublisher &) { cnt->fetch_add(1, std::memory_order_relaxed); },
+				[cnt](const ros::SingleSubscriberPublisher &) { cnt->fetch_sub(1, std::memory_order_relaxed); });
+	}
+
+	inline bool has_subscribers() const {
+		return num_subscribers->load(std::memory_order_relaxed) > 0;
+	}
+
+	template<class M>
+	inline void publish(const boost::shared_ptr<M> &message) const {
+		pub.publish(message);
+	}
+
+	template<class M>
+	inline void publish(const M &message) const {
+		pub.publish(message);
+	}
+
+	inline uint32_t getNumSubscribers() const {
+		return pub.getNumSubscribers();
+	}
+
+	inline std::string getTopic() const {
+		return pub.getTopic();
+	}
+
+	inline void shutdown() {
+		pub.shutdown();
+	}
+
+private:
+	ros::Publisher pub;
+	std::shared_ptr<std::atomic<int>> num_subscribers;
+};
+
 /**
  * @brief MAVROS Plugin base class
  */
@@ -40,13 +113,100 @@ private:
 	PluginBase(const PluginBase&) = delete;
 
 public:
-	//! generic message handler callback
-	using HandlerCb = mavconn::MAVConnInterface::ReceivedCb;
+	/**
+	 * @brief Generic message handler callback
+	 *
+	 * Delegate: plugin object, its handler member function
+	 * and trampoline function which restores handler type.
+	 * Unlike std::function built by std::bind it do not allocate
+	 * and costs one indirect call.
+	 *
+	 * Typed handler also carries @a FanOut function, which decodes message
+	 * once and passes same object to several typed handlers (see RouteTable).
+	 * Handler taking non-const message gets own copy when object is shared.
+	 *
+	 * With @a PluginStats set each call is accounted to plugin (plugin_stats/enable).
+	 */
+	class HandlerCb {
+	public:
+		//! type erased pointer to handler member function
+		using GenericFn = void (PluginBase::*)();
+		//! raw handler trampoline
+		using Trampoline = void (*)(PluginBase *obj, GenericFn fn, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing);
+		//! typed handler trampoline, @a decoded points to message object, @a shared if other handlers get it too
+		using TypedTrampoline = void (*)(PluginBase *obj, GenericFn fn, const mavlink::mavlink_message_t *msg, const void *decoded, bool shared);
+		//! decode message and call typed handlers [begin, end) of same message type
+		using FanOut = void (*)(const mavlink::mavlink_message_t *msg, const HandlerCb *begin, const HandlerCb *end);
+
+		HandlerCb() :
+			obj(nullptr), fn(nullptr), call(nullptr), call_typed_(nullptr), fanout_(nullptr), stats(nullptr)
+		{ }
+
+		HandlerCb(PluginBase *obj_, GenericFn fn_, Trampoline call_) :
+			obj(obj_), fn(fn_), call(call_), call_typed_(nullptr), fanout_(nullptr), stats(nullptr)
+		{ }
+
+		HandlerCb(PluginBase *obj_, GenericFn fn_, TypedTrampoline call_, FanOut fanout) :
+			obj(obj_), fn(fn_), call(nullptr), call_typed_(call_), fanout_(fanout), stats(nullptr)
+		{ }
+
+		inline void operator() (const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) const {
+			if (call) {
+				if (stats) {
+					PluginStats::Scope scope(stats->handlers);
+					call(obj, fn, msg, framing);
+				}
+				else
+					call(obj, fn, msg, framing);
+			}
+			else if (framing == mavconn::Framing::ok)
+				fanout_(msg, this, this + 1);
+		}
+
+		explicit operator bool() const {
+			return call != nullptr || call_typed_ != nullptr;
+		}
+
+		inline bool is_typed() const {
+			return call_typed_ != nullptr;
+		}
+
+		inline FanOut fanout() const {
+			return fanout_;
+		}
+
+		//! call typed handler with already decoded message
+		inline void call_typed(const mavlink::mavlink_message_t *msg, const void *decoded, bool shared) const {
+			if (stats) {
+				PluginStats::Scope scope(stats->handlers);
+				call_typed_(obj, fn, msg, decoded, shared);
+			}
+			else
+				call_typed_(obj, fn, msg, decoded, shared);
+		}
+
+		//! account calls to @a stats_, which should outlive route tables
+		inline void set_stats(PluginStats *stats_) {
+			stats = stats_;
+		}
+
+	private:
+		PluginBase *obj;
+		GenericFn fn;
+		Trampoline call;
+		TypedTrampoline call_typed_;
+		FanOut fanout_;
+		PluginStats *stats;
+	};
+
 	//! Tuple: MSG ID, MSG NAME, message type into hash_code, message handler callback
 	using HandlerInfo = std::tuple<mavlink::msgid_t, const char*, size_t, HandlerCb>;
 	//! Subscriptions vector
 	using Subscriptions = std::vector<HandlerInfo>;
 
+	//! Timer served by UAS::timer_wheel
+	using Timer = TimerWheel::Timer;
+
 	// pluginlib return boost::shared_ptr
 	using Ptr = boost::shared_ptr<PluginBase>;
 	using ConstPtr = boost::shared_ptr<PluginBase const>;
@@ -62,19 +222,116 @@ public:
 		m_uas = &uas;
 	}
 
+	/**
+	 * @brief Set queue of plugin ROS callbacks, nullptr - global queue
+	 *
+	 * Called by node before initialize().
+	 */
+	void set_callback_queue(ros::CallbackQueueInterface *queue) {
+		callback_queue = queue;
+	}
+
+	/**
+	 * @brief Account make_timer() callbacks to @a stats, nullptr - disabled
+	 *
+	 * Called by node before initialize().
+	 */
+	void set_plugin_stats(PluginStats *stats) {
+		plugin_stats = stats;
+	}
+
 	/**
 	 * @brief Return vector of MAVLink message subscriptions (handlers)
 	 */
 	virtual Subscriptions get_subscriptions() = 0;
 
+	/**
+	 * @brief Namespace of plugins constructed by this thread, empty - process private ("~")
+	 *
+	 * Set by node around plugin creation, e.g. "~uav2" in multi-vehicle mode.
+	 */
+	static thread_local std::string construct_namespace;
+
 protected:
 	/**
 	 * @brief Plugin constructor
 	 * Should not do anything before initialize()
 	 */
-	PluginBase() : m_uas(nullptr) {};
+	PluginBase() : m_uas(nullptr), callback_queue(nullptr), plugin_stats(nullptr), plugin_namespace(construct_namespace) {};
 
 	UAS *m_uas;
+	ros::CallbackQueueInterface *callback_queue;
+	PluginStats *plugin_stats;
+
+	/**
+	 * @brief Node handle of plugin namespace @a ns
+	 *
+	 * Use instead of ros::NodeHandle("~ns"), so same plugin
+	 * can serve several vehicles of one node.
+	 */
+	ros::NodeHandle private_nh(const std::string &ns = "") const {
+		if (plugin_namespace.empty())
+			return ros::NodeHandle("~" + ns);
+		else if (ns.empty())
+			return ros::NodeHandle(plugin_namespace);
+		else
+			return ros::NodeHandle(plugin_namespace + "/" + ns);
+	}
+
+	/**
+	 * @brief Serve subscriptions, services and timers of @a nh from plugin queue
+	 *
+	 * Should be called in initialize() before any of them created.
+	 */
+	inline void setup_node_handle(ros::NodeHandle &nh) {
+		nh.setCallbackQueue(callback_queue);
+	}
+
+	/**
+	 * @brief Setup @a timer on UAS timer wheel, instead of NodeHandle::createTimer()
+	 *
+	 * Callback called from wheel thread, not from plugin queue,
+	 * so it should lock plugin state and must not block (e.g. on service calls).
+	 * Event has current_real and current_expected set to ros::Time::now() of call.
+	 *
+	 * @param[in] period     timer period
+	 * @param[in] cb         callback
+	 * @param[in] oneshot    fire once per start()
+	 * @param[in] autostart  start now
+	 */
+	void make_timer(Timer &timer, const ros::Duration &period,
+			std::function<void(const ros::TimerEvent&)> cb,
+			bool oneshot = false, bool autostart = true) {
+		ros::TimerEvent last{};
+		auto stats = plugin_stats;
+
+		timer.setup(m_uas->timer_wheel, [cb, last, stats]() mutable {
+					ros::TimerEvent event{};
+					event.last_expected = last.current_expected;
+					event.last_real = last.current_real;
+					event.current_expected = event.current_real = ros::Time::now();
+					last = event;
+
+					try {
+						if (stats) {
+							PluginStats::Scope scope(stats->callbacks);
+							cb(event);
+						}
+						else
+							cb(event);
+					}
+					catch (std::exception &ex) {
+						ROS_ERROR_NAMED("mavros", "Timer callback exception: %s", ex.what());
+					}
+				}, period.toSec(), oneshot, autostart);
+	}
+
+	//! make_timer() with member function callback
+	template<class _C>
+	void make_timer(Timer &timer, const ros::Duration &period, void (_C::*fn)(const ros::TimerEvent&),
+			bool oneshot = false, bool autostart = true) {
+		make_timer(timer, period, std::bind(fn, static_cast<_C*>(this), std::placeholders::_1), oneshot, autostart);
+	}
 
 	// TODO: filtered handlers
 
@@ -86,36 +343,35 @@ protected:
 	 */
 	template<class _C>
 	HandlerInfo make_handler(const mavlink::msgid_t id, void (_C::*fn)(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing)) {
-		auto bfn = std::bind(fn, static_cast<_C*>(this), std::placeholders::_1, std::placeholders::_2);
 		const auto type_hash_ = typeid(mavlink::mavlink_message_t).hash_code();
 
-		return HandlerInfo{ id, nullptr, type_hash_, bfn };
+		return HandlerInfo{
+			id, nullptr, type_hash_,
+			HandlerCb(this, reinterpret_cast<HandlerCb::GenericFn>(fn), &raw_handler_trampoline<_C>)
+		};
 	}
 
 	/**
 	 * Make subscription to message with automatic decoding.
 	 *
+	 * Message decoded once per frame, decoded object shared between
+	 * all typed handlers of that message. Handler taking @a _T& may modify
+	 * its message: when it is shared, handler gets a copy.
+	 * Prefer const @a _T& handler, it never copies.
+	 *
 	 * @param[in] fn  pointer to member function (handler)
 	 */
 	template<class _C, class _T>
 	HandlerInfo make_handler(void (_C::*fn)(const mavlink::mavlink_message_t*, _T&)) {
-		auto bfn = std::bind(fn, static_cast<_C*>(this), std::placeholders::_1, std::placeholders::_2);
-		const auto id = _T::MSG_ID;
-		const auto name = _T::NAME;
-		const auto type_hash_ = typeid(_T).hash_code();
+		using _M = typename std::remove_const<_T>::type;
+
+		const auto id = _M::MSG_ID;
+		const auto name = _M::NAME;
+		const auto type_hash_ = typeid(_M).hash_code();
 
 		return HandlerInfo{
 			id, name, type_hash_,
-			[bfn](const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) {
-				if (framing != mavconn::Framing::ok)
-					return;
-
-				mavlink::MsgMap map(msg);
-				_T obj;
-				obj.deserialize(map);
-
-				bfn(msg, obj);
-			}
+			HandlerCb(this, reinterpret_cast<HandlerCb::GenericFn>(fn), &typed_handler_trampoline<_C, _T>, &decode_fanout<_M>)
 		};
 	}
 
@@ -132,6 +388,59 @@ protected:
 	inline void enable_connection_cb() {
 		m_uas->add_connection_change_handler(std::bind(&PluginBase::connection_cb, this, std::placeholders::_1));
 	}
+
+private:
+	const std::string plugin_namespace;
+
+	template<class _C>
+	static void raw_handler_trampoline(PluginBase *obj, HandlerCb::GenericFn fn, const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) {
+		auto mfn = reinterpret_cast<void (_C::*)(const mavlink::mavlink_message_t*, const mavconn::Framing)>(fn);
+
+		(static_cast<_C*>(obj)->*mfn)(msg, framing);
+	}
+
+	template<class _C, class _T>
+	static void typed_handler_trampoline(PluginBase *obj, HandlerCb::GenericFn fn, const mavlink::mavlink_message_t *msg, const void *decoded, bool shared) {
+		using _M = typename std::remove_const<_T>::type;
+		auto mfn = reinterpret_cast<void (_C::*)(const mavlink::mavlink_message_t*, _T&)>(fn);
+
+		call_decoded(static_cast<_C*>(obj), mfn, msg, *static_cast<const _M*>(decoded), shared);
+	}
+
+	template<class _C, class _M>
+	static void call_decoded(_C *obj, void (_C::*mfn)(const mavlink::mavlink_message_t*, const _M&),
+			const mavlink::mavlink_message_t *msg, const _M &decoded, bool shared) {
+		(obj->*mfn)(msg, decoded);
+	}
+
+	template<class _C, class _M>
+	static void call_decoded(_C *obj, void (_C::*mfn)(const mavlink::mavlink_message_t*, _M&),
+			const mavlink::mavlink_message_t *msg, const _M &decoded, bool shared) {
+		if (shared) {
+			// other handlers see original
+			_M copy(decoded);
+			(obj->*mfn)(msg, copy);
+		}
+		else {
+			// sole handler: object is non-const local of decode_fanout()
+			(obj->*mfn)(msg, const_cast<_M&>(decoded));
+		}
+	}
+
+	/**
+	 * Decode once for all subscribers.
+	 * @note handlers receive same object, non-const ones get a copy if there are several.
+	 */
+	template<class _M>
+	static void decode_fanout(const mavlink::mavlink_message_t *msg, const HandlerCb *begin, const HandlerCb *end) {
+		mavlink::MsgMap map(msg);
+		_M obj;
+		obj.deserialize(map);
+
+		const bool shared = end - begin > 1;
+		for (auto it = begin; it != end; ++it)
+			it->call_typed(msg, &obj, shared);
+	}
 };
 }	// namespace plugin
 }	// namespace mavros
@@ -25,9 +25,17 @@
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <diagnostic_updater/diagnostic_updater.h>
+#include <mavros/diag_updater.h>
 #include <mavconn/interface.h>
 #include <mavros/utils.h>
 #include <mavros/frame_tf.h>
+#include <mavros/seqlock.h>
+#include <mavros/state_history.h>
+#include <mavros/geoid_cache.h>
+#include <mavros/stream_demand.h>
+#include <mavros/timer_wheel.h>
+#include <mavros/tf_aggregator.h>
+#include <mavros/tf_watcher.h>
 
 #include <GeographicLib/Geoid.hpp>
 
@@ -62,10 +70,14 @@ namespace mavros {
  * - Vehicle type (@a mavplugin::SystemStatusPlugin)
  * - IMU data (@a mavplugin::IMUPubPlugin)
  * - GPS data (@a mavplugin::GPSPlugin)
+ *
+ * IMU and GPS getters do not lock: POD part read from @a SeqLock,
+ * message pointers swapped atomically.
  */
 class UAS {
 public:
 	using ConnectionCb = std::function<void(bool)>;
+	using LinkBudgetCb = std::function<void(uint8_t txbuf)>;
 	using lock_guard = std::lock_guard<std::recursive_mutex>;
 	using unique_lock = std::unique_lock<std::recursive_mutex>;
 
@@ -77,7 +89,10 @@ public:
 	using timesync_mode = utils::timesync_mode;
 
 	UAS();
-	~UAS() {};
+	//! stops timer_wheel first: plugin timers use other members
+	~UAS() {
+		timer_wheel.stop();
+	};
 
 	/**
 	 * @brief MAVLink FCU device conection
@@ -87,7 +102,7 @@ public:
 	/**
 	 * @brief Mavros diagnostic updater
 	 */
-	diagnostic_updater::Updater diag_updater;
+	DiagUpdater diag_updater;
 
 	/**
 	 * @brief Return connection status
@@ -113,6 +128,18 @@ public:
 	 */
 	void add_connection_change_handler(ConnectionCb cb);
 
+	/* -*- radio link budget -*- */
+
+	/**
+	 * @brief Pass radio free Tx buffer report (RADIO_STATUS.txbuf, percent) to all handlers
+	 */
+	void update_link_budget(uint8_t txbuf);
+
+	/**
+	 * @brief Add link budget handler callback
+	 */
+	void add_link_budget_handler(LinkBudgetCb cb);
+
 	/**
 	 * @brief Returns vehicle type
 	 */
@@ -171,6 +198,21 @@ public:
 
 	/* -*- IMU data -*- */
 
+	//! Attitude part of IMU data, copied on update for lock-free getters
+	struct AttitudeState {
+		bool valid;
+		double orientation[4];		//!< x, y, z, w
+		double angular_velocity[3];	//!< x, y, z
+	};
+
+	//! GPS accuracy data
+	struct GpsEpts {
+		float eph;
+		float epv;
+		int fix_type;
+		int satellites_visible;
+	};
+
 	/**
 	 * @brief Store IMU data [ENU]
 	 */
@@ -215,6 +257,43 @@ public:
 	 */
 	geometry_msgs::Vector3 get_attitude_angular_velocity_ned();
 
+	/**
+	 * @brief Get orientation and angular velocity of one IMU sample
+	 *
+	 * Single snapshot, unlike pair of calls above which may see different samples.
+	 *
+	 * @param[out] orientation       orientation quaternion [ENU]
+	 * @param[out] angular_velocity  vector3 [ENU]
+	 */
+	void get_attitude_enu(geometry_msgs::Quaternion &orientation, geometry_msgs::Vector3 &angular_velocity);
+
+
+	/* -*- state history -*- */
+
+	/**
+	 * @brief Get attitude at the moment of @a stamp [ENU]
+	 *
+	 * Interpolated from IMU data history (slerp for orientation).
+	 * Stamp newer than last IMU data gives the last one.
+	 * Cheaper than tf2 lookup: no frame names, readers do not lock.
+	 *
+	 * @return false if history does not reach @a stamp
+	 */
+	bool get_attitude_at(const ros::Time &stamp,
+			geometry_msgs::Quaternion &orientation, geometry_msgs::Vector3 &angular_velocity);
+
+	/**
+	 * @brief Store local position [ENU] for get_local_position_at()
+	 */
+	void update_local_position(const ros::Time &stamp, const Eigen::Vector3d &position);
+
+	/**
+	 * @brief Get local position at the moment of @a stamp [ENU]
+	 *
+	 * Linear interpolation, same rules as get_attitude_at().
+	 */
+	bool get_local_position_at(const ros::Time &stamp, Eigen::Vector3d &position);
+
 
 	/* -*- GPS data -*- */
 
@@ -232,11 +311,21 @@ public:
 	/* -*- GograpticLib utils -*- */
 
 	/**
-	 * @brief Geoid dataset used to convert between AMSL and WGS-84
+	 * @brief Memo of egm96_5 geoid heights around vehicle
+	 *
+	 * Conversions below use it, so repeated lookups cost few flops.
+	 * Dataset opened on first cache miss and read on demand,
+	 * see geoid_height().
+	 */
+	GeoidCache geoid_cache;
+
+	/**
+	 * @brief Precompute geoid heights of operating area
 	 *
-	 * That class loads egm96_5 dataset to RAM, it is about 24 MiB.
+	 * @param lat, lon  area center [deg]
+	 * @param radius_m  area radius, limited to few km
 	 */
-	std::shared_ptr<GeographicLib::Geoid> egm96_5;
+	void preload_geoid_area(double lat, double lon, double radius_m);
 
 	/**
 	 * @brief Conversion from height above geoid (AMSL)
@@ -245,10 +334,7 @@ public:
 	template <class T>
 	inline double geoid_to_ellipsoid_height(T lla)
 	{
-		if (egm96_5)
-			return GeographicLib::Geoid::GEOIDTOELLIPSOID * (*egm96_5)(lla->latitude, lla->longitude);
-		else
-			return 0.0;
+		return GeographicLib::Geoid::GEOIDTOELLIPSOID * geoid_cache.height(lla->latitude, lla->longitude);
 	}
 
 	/**
@@ -258,10 +344,7 @@ public:
 	template <class T>
 	inline double ellipsoid_to_geoid_height(T lla)
 	{
-		if (egm96_5)
-			return GeographicLib::Geoid::ELLIPSOIDTOGEOID * (*egm96_5)(lla->latitude, lla->longitude);
-		else
-			return 0.0;
+		return GeographicLib::Geoid::ELLIPSOIDTOGEOID * geoid_cache.height(lla->latitude, lla->longitude);
 	}
 
 	/* -*- transform -*- */
@@ -271,6 +354,38 @@ public:
 	tf2_ros::TransformBroadcaster tf2_broadcaster;
 	tf2_ros::StaticTransformBroadcaster tf2_static_broadcaster;
 
+	/**
+	 * @brief Batched broadcaster for plugins
+	 *
+	 * Use tf_aggregator.send() instead of tf2_broadcaster.sendTransform():
+	 * transforms of all plugins published together, with per-frame rate caps.
+	 */
+	TfAggregator tf_aggregator;
+
+	/**
+	 * @brief Shared listener for plugins
+	 *
+	 * One thread calls plugin callbacks when watched transforms update,
+	 * instead of polling thread per plugin. Used by TF2ListenerMixin.
+	 */
+	TfWatcher tf_watcher;
+
+	/**
+	 * @brief FCU message rates from topic subscribers
+	 *
+	 * Plugins declare which msgids feed their topics,
+	 * sys_status sends SET_MESSAGE_INTERVAL when demand changes.
+	 */
+	StreamDemand stream_demand;
+
+	/**
+	 * @brief Timers of plugins
+	 *
+	 * Protocol timeouts and periodic sends of all plugins served by one thread,
+	 * instead of ros::Timer per plugin. Use PluginBase::make_timer().
+	 */
+	TimerWheel timer_wheel;
+
 	/**
 	 * @brief Add static transform. To publish all static transforms at once, we stack them in a std::vector.
 	 *
@@ -292,12 +407,33 @@ public:
 
 	/* -*- time sync -*- */
 
+	/**
+	 * @brief Linear model of FCU to ROS time
+	 *
+	 * ros_time = fcu_time + offset_ns + skew * (fcu_time - epoch_ns)
+	 */
+	struct TimeSyncModel {
+		uint64_t offset_ns;	//!< offset at @a epoch_ns, 0 - unknown
+		double skew;		//!< offset change per FCU nanosecond
+		uint64_t epoch_ns;	//!< FCU time of offset estimate
+	};
+
+	//! Set offset without drift
 	inline void set_time_offset(uint64_t offset_ns) {
-		time_offset = offset_ns;
+		time_sync.store(TimeSyncModel {offset_ns, 0.0, 0});
 	}
 
 	inline uint64_t get_time_offset(void) {
-		return time_offset;
+		return time_sync.load().offset_ns;
+	}
+
+	//! Publish whole model, synchronise_stamp() readers do not lock
+	inline void set_time_sync_model(const TimeSyncModel &model) {
+		time_sync.store(model);
+	}
+
+	inline TimeSyncModel get_time_sync_model(void) {
+		return time_sync.load();
 	}
 
 	inline void set_timesync_mode(timesync_mode mode) {
@@ -312,10 +448,22 @@ public:
 	uint64_t get_capabilities();
 	void update_capabilities(bool known, uint64_t caps = 0);
 
+	/**
+	 * @brief Arrival time of FCU message being handled
+	 *
+	 * Kernel receive timestamp (UDP) or read completion time,
+	 * free of dispatch latency. Valid in message handlers,
+	 * otherwise (and with simulated time) returns ros::Time::now().
+	 */
+	static ros::Time get_rx_stamp();
+
+	//! Set arrival time for handlers called in this thread, 0 - unknown
+	static void set_rx_stamp(uint64_t rx_stamp_ns);
+
 	/**
 	 * @brief Compute FCU message time from time_boot_ms or time_usec field
 	 *
-	 * Uses time_offset for calculation
+	 * Uses time sync model (offset and skew) for calculation
 	 *
 	 * @return FCU time if it is known else current wall time.
 	 */
@@ -416,20 +564,41 @@ private:
 
 	std::atomic<bool> connected;
 	std::vector<ConnectionCb> connection_cb_vec;
+	std::vector<LinkBudgetCb> link_budget_cb_vec;
 
+	// accessed by boost::atomic_load/store
 	sensor_msgs::Imu::Ptr imu_enu_data;
 	sensor_msgs::Imu::Ptr imu_ned_data;
+	SeqLock<AttitudeState> attitude_enu;
+	SeqLock<AttitudeState> attitude_ned;
+
+	StateHistory<AttitudeState> attitude_history;		//!< ENU
+	StateHistory<std::array<double, 3>> local_position_history;	//!< ENU
 
-	sensor_msgs::NavSatFix::Ptr gps_fix;
-	float gps_eph;
-	float gps_epv;
-	int gps_fix_type;
-	int gps_satellites_visible;
+	sensor_msgs::NavSatFix::Ptr gps_fix;	// atomic access
+	SeqLock<GpsEpts> gps_epts;
 
-	std::atomic<uint64_t> time_offset;
+	SeqLock<TimeSyncModel> time_sync;
 	timesync_mode tsync_mode;
 
 	std::atomic<bool> fcu_caps_known;
 	std::atomic<uint64_t> fcu_capabilities;
+
+	/**
+	 * @brief Geoid dataset used to convert between AMSL and WGS-84
+	 *
+	 * Not thread safe object (does not load whole 24 MiB grid to RAM),
+	 * calls serialized by @a geoid_mutex, they happen only on cache misses.
+	 * Shared by all UAS objects of process (multi-vehicle mode).
+	 */
+	static std::mutex geoid_mutex;
+	static std::shared_ptr<GeographicLib::Geoid> egm96_5;
+	static bool geoid_load_failed;
+	static ros::WallDuration geoid_load_time;
+
+	//! Exact geoid height, opens dataset on first call
+	double geoid_height(double lat, double lon);
+	bool load_geoid_locked();
+	void geoid_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 };
 }	// namespace mavros
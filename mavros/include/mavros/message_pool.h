@@ -0,0 +1,185 @@
+/**
+ * @brief Recycling message pool
+ * @file message_pool.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <new>
+#include <boost/shared_ptr.hpp>
+
+namespace mavros {
+/**
+ * @brief Pool of reusable messages for high rate publishers
+ *
+ * acquire() returns shared pointer with deleter which puts message back
+ * to free list when last owner (publisher queue, intra-process subscriber,
+ * UAS storage) releases it. Shared pointer control blocks are recycled too,
+ * so after warm up acquire()/release cycle does not touch heap.
+ *
+ * Pool may be destroyed before released messages,
+ * those are deleted when last reference goes away.
+ *
+ * @note Recycled message keeps content of previous use (and vector/string capacity),
+ *       caller should fill every field it uses.
+ */
+template<class M>
+class MessagePool
+{
+public:
+	using Ptr = boost::shared_ptr<M>;
+
+	/**
+	 * @param[in] max_free  number of released messages kept for reuse
+	 */
+	explicit MessagePool(size_t max_free = 8) :
+		storage(std::make_shared<Storage>(max_free))
+	{ }
+
+	//! Get free message or allocate new one
+	Ptr acquire()
+	{
+		M *obj = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(storage->mutex);
+			if (!storage->objects.empty()) {
+				obj = storage->objects.back();
+				storage->objects.pop_back();
+			}
+		}
+
+		if (obj == nullptr)
+			obj = new M();
+
+		// on exception shared_ptr passes obj to deleter
+		return Ptr(obj, Deleter{storage}, BlockAllocator<M>(storage));
+	}
+
+	//! Number of messages ready for reuse
+	size_t free_count() const
+	{
+		std::lock_guard<std::mutex> lock(storage->mutex);
+		return storage->objects.size();
+	}
+
+private:
+	struct Storage {
+		std::mutex mutex;
+		const size_t max_free;
+		std::vector<M *> objects;
+		std::vector<void *> blocks;	//!< free control blocks
+		size_t block_size;		//!< size of blocks, known after first allocation
+
+		explicit Storage(size_t max_free_) :
+			max_free(max_free_),
+			block_size(0)
+		{
+			objects.reserve(max_free);
+			blocks.reserve(max_free);
+		}
+
+		~Storage()
+		{
+			for (auto obj : objects)
+				delete obj;
+			for (auto blk : blocks)
+				::operator delete(blk);
+		}
+	};
+
+	struct Deleter {
+		std::shared_ptr<Storage> storage;
+
+		void operator() (M *obj) const
+		{
+			{
+				std::lock_guard<std::mutex> lock(storage->mutex);
+				if (storage->objects.size() < storage->max_free) {
+					storage->objects.push_back(obj);
+					return;
+				}
+			}
+
+			delete obj;
+		}
+	};
+
+	//! Allocator for shared_ptr control block
+	template<class T>
+	struct BlockAllocator {
+		using value_type = T;
+
+		std::shared_ptr<Storage> storage;
+
+		explicit BlockAllocator(std::shared_ptr<Storage> s) :
+			storage(std::move(s))
+		{ }
+
+		template<class U>
+		BlockAllocator(const BlockAllocator<U> &other) :
+			storage(other.storage)
+		{ }
+
+		T *allocate(size_t n)
+		{
+			const size_t bytes = n * sizeof(T);
+
+			{
+				std::lock_guard<std::mutex> lock(storage->mutex);
+				if (storage->block_size == 0)
+					storage->block_size = bytes;
+
+				if (bytes == storage->block_size && !storage->blocks.empty()) {
+					void *blk = storage->blocks.back();
+					storage->blocks.pop_back();
+					return static_cast<T *>(blk);
+				}
+			}
+
+			return static_cast<T *>(::operator new(bytes));
+		}
+
+		void deallocate(T *p, size_t n)
+		{
+			const size_t bytes = n * sizeof(T);
+
+			{
+				std::lock_guard<std::mutex> lock(storage->mutex);
+				if (bytes == storage->block_size && storage->blocks.size() < storage->max_free) {
+					storage->blocks.push_back(p);
+					return;
+				}
+			}
+
+			::operator delete(p);
+		}
+
+		template<class U>
+		bool operator== (const BlockAllocator<U> &other) const {
+			return storage == other.storage;
+		}
+
+		template<class U>
+		bool operator!= (const BlockAllocator<U> &other) const {
+			return storage != other.storage;
+		}
+	};
+
+	std::shared_ptr<Storage> storage;
+};
+}	// namespace mavros
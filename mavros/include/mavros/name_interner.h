@@ -0,0 +1,117 @@
+/**
+ * @brief Interning table of fixed length MAVLink names
+ * @file name_interner.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace mavros {
+/**
+ * @brief Maps char[NameLen] names (NAMED_VALUE_*, DEBUG_VECT) to small ids
+ *
+ * Ids are given in order of first appearance, starting from 0,
+ * so owner can keep per-name state in plain vector.
+ * std::string of name made once, on insert.
+ * Name ends at first NUL or at NameLen chars, bytes after NUL ignored.
+ *
+ * @note not thread safe, owner locks.
+ */
+template<size_t NameLen, size_t Capacity = 256>
+class NameInterner {
+public:
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity should be power of two");
+
+	using Name = std::array<char, NameLen>;
+
+	//! Names kept at most
+	static constexpr size_t MAX_NAMES = Capacity * 3 / 4;
+
+	NameInterner()
+	{
+		slots.fill(-1);
+	}
+
+	/**
+	 * @brief Id of @a name, inserted if new
+	 * @return id, -1 if table is full
+	 */
+	int intern(const Name &name)
+	{
+		const Name key = normalize(name);
+
+		size_t i = hash(key) & (Capacity - 1);
+		for (; slots[i] >= 0; i = (i + 1) & (Capacity - 1)) {
+			if (keys[slots[i]] == key)
+				return slots[i];
+		}
+
+		if (keys.size() >= MAX_NAMES)
+			return -1;
+
+		const int id = keys.size();
+		slots[i] = id;
+		keys.push_back(key);
+		strings.emplace_back(key.data(), length(key));
+		return id;
+	}
+
+	//! Name of @a id
+	inline const std::string &name(int id) const {
+		return strings[id];
+	}
+
+	inline size_t size() const {
+		return keys.size();
+	}
+
+private:
+	std::array<int16_t, Capacity> slots;
+	std::vector<Name> keys;
+	std::vector<std::string> strings;
+
+	static Name normalize(const Name &name)
+	{
+		Name key;
+		key.fill('\0');
+		for (size_t i = 0; i < NameLen && name[i] != '\0'; i++)
+			key[i] = name[i];
+		return key;
+	}
+
+	static size_t length(const Name &key)
+	{
+		size_t n = 0;
+		while (n < NameLen && key[n] != '\0')
+			n++;
+		return n;
+	}
+
+	//! FNV-1a
+	static uint32_t hash(const Name &key)
+	{
+		uint32_t h = 2166136261U;
+		for (auto c : key) {
+			h ^= uint8_t(c);
+			h *= 16777619U;
+		}
+		return h;
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,227 @@
+/**
+ * @brief Angular sectors of OBSTACLE_DISTANCE
+ * @file obstacle_sectors.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace mavros {
+/**
+ * @brief Nearest obstacle in each of fixed angular sectors [cm]
+ *
+ * Sector i centered at i * increment_deg(), angles clockwise from forward
+ * (MAV_FRAME_BODY_FRD), as OBSTACLE_DISTANCE.distances with angle_offset 0.
+ *
+ * Value coding follows the message:
+ * - distance in range: centimeters;
+ * - beyond max range (+inf return): max_distance + 1, no obstacle;
+ * - NaN, -inf, below min range: UINT16_MAX, unknown.
+ * Minimum of these codes is right merge of two readings.
+ *
+ * Scans reduced by runs of beams falling to one sector, each run
+ * by min_pool_cm(): integer only loop, compiler vectorizes it.
+ */
+class ObstacleSectors {
+public:
+	static constexpr size_t SECTORS = 72;
+	static constexpr uint16_t UNKNOWN = UINT16_MAX;
+
+	using Distances = std::array<uint16_t, SECTORS>;
+
+	ObstacleSectors() {
+		clear();
+	}
+
+	void clear() {
+		distances.fill(UNKNOWN);
+	}
+
+	static constexpr double increment_deg() {
+		return 360.0 / SECTORS;
+	}
+
+	/**
+	 * @brief Min-pool ranges to one distance code
+	 *
+	 * @param[in] ranges     [m]
+	 * @param[in] range_min  [m], values below are unknown
+	 * @param[in] range_max  [m], values above are no obstacle
+	 */
+	static uint16_t min_pool_cm(const float *ranges, size_t n, float range_min, float range_max)
+	{
+		// keep cm in uint16_t, zero is not valid return
+		range_max = std::min(range_max, 655.0f);
+		range_min = std::max(range_min, 0.01f);
+
+		// positive floats compare as their bit patterns, NaN and negative are above +inf.
+		// Integer only body: no float compare (may trap), mask instead of select, so it vectorizes.
+		const uint32_t min_b = float_bits(range_min);
+		const uint32_t max_b = float_bits(range_max);
+		const uint32_t inf_b = float_bits(std::numeric_limits<float>::infinity());
+
+		uint32_t in_range = UINT32_MAX;
+		uint32_t beyond = UINT32_MAX;
+		for (size_t i = 0; i < n; i++) {
+			uint32_t rb;
+			std::memcpy(&rb, ranges + i, sizeof(rb));
+
+			const uint32_t not_in = uint32_t(0) - uint32_t(rb - min_b > max_b - min_b);
+			const uint32_t not_beyond = uint32_t(0) - uint32_t(rb - max_b - 1 > inf_b - max_b - 1);
+			in_range = std::min(in_range, rb | not_in);
+			beyond = std::min(beyond, rb | not_beyond);
+		}
+
+		if (in_range != UINT32_MAX) {
+			float r;
+			std::memcpy(&r, &in_range, sizeof(r));
+			return uint16_t(r * 100.0f);
+		}
+		else if (beyond != UINT32_MAX)
+			return uint16_t(range_max * 100.0f) + 1;
+		else
+			return UNKNOWN;
+	}
+
+	/**
+	 * @brief Add scan
+	 *
+	 * @param[in] start_deg  angle of first beam, FRD
+	 * @param[in] inc_deg    angle between beams, FRD (negative for ROS CCW scan)
+	 */
+	void add_scan(const float *ranges, size_t n, double start_deg, double inc_deg, float range_min, float range_max)
+	{
+		const double step = inc_deg / increment_deg();	// sectors per beam
+
+		for (size_t b = 0; b < n; ) {
+			const double pos = (start_deg + b * inc_deg) / increment_deg() + 0.5;
+			const double cell = std::floor(pos);
+			const double frac = pos - cell;
+
+			// beams left before crossing sector edge
+			size_t run = n - b;
+			if (step > 0.0)
+				run = std::min<double>(run, std::max(1.0, std::ceil((1.0 - frac) / step)));
+			else if (step < 0.0)
+				run = std::min<double>(run, std::floor(frac / -step) + 1.0);
+
+			auto &d = distances[wrap(cell)];
+			d = std::min(d, min_pool_cm(ranges + b, run, range_min, range_max));
+			b += run;
+		}
+	}
+
+	//! Index of sector containing @a angle_deg (FRD)
+	static inline size_t sector(double angle_deg) {
+		return wrap(std::floor(angle_deg / increment_deg() + 0.5));
+	}
+
+	//! Add single reading at @a angle_deg (FRD), in range already checked
+	inline void add_point(double angle_deg, float range)
+	{
+		auto &d = distances[sector(angle_deg)];
+		d = std::min<uint16_t>(d, std::min(range * 100.0f, 65534.0f));
+	}
+
+	//! Sector-wise minimum with @a other
+	void merge(const ObstacleSectors &other)
+	{
+		for (size_t i = 0; i < SECTORS; i++)
+			distances[i] = std::min(distances[i], other.distances[i]);
+	}
+
+	inline const Distances &get() const {
+		return distances;
+	}
+
+private:
+	Distances distances;
+
+	static inline uint32_t float_bits(float f) {
+		uint32_t b;
+		std::memcpy(&b, &f, sizeof(b));
+		return b;
+	}
+
+	static inline size_t wrap(double cell) {
+		const long s = long(cell) % long(SECTORS);
+		return (s < 0) ? s + SECTORS : s;
+	}
+};
+
+/**
+ * @brief Polar voxel grid over sectors of ObstacleSectors
+ *
+ * Column of each sector split to radial cells of voxel_size, points only
+ * counted. Sector distance is near edge of first cell with at least
+ * min_points, so single noisy points of depth camera do not make obstacle.
+ */
+class PolarVoxelGrid {
+public:
+	PolarVoxelGrid() :
+		voxel_size(0.0f),
+		cells(0)
+	{ }
+
+	//! Set cell size, cells cover [0, range_max]
+	void resize(float voxel_size_, float range_max)
+	{
+		voxel_size = voxel_size_;
+		cells = size_t(std::ceil(range_max / voxel_size)) + 1;
+		counts.assign(ObstacleSectors::SECTORS * cells, 0);
+	}
+
+	void clear()
+	{
+		std::fill(counts.begin(), counts.end(), 0);
+	}
+
+	//! Count point at @a angle_deg (FRD), range in [0, range_max]
+	inline void add_point(double angle_deg, float range)
+	{
+		const size_t cell = std::min(size_t(range / voxel_size), cells - 1);
+		auto &c = counts[ObstacleSectors::sector(angle_deg) * cells + cell];
+		c = std::min<uint32_t>(c + 1, UINT16_MAX);
+	}
+
+	//! Put nearest dense cell of each sector to @a out, sectors without any stay untouched
+	void reduce(ObstacleSectors &out, size_t min_points) const
+	{
+		min_points = std::max<size_t>(min_points, 1);
+
+		for (size_t s = 0; s < ObstacleSectors::SECTORS; s++) {
+			const uint16_t *column = &counts[s * cells];
+			for (size_t c = 0; c < cells; c++) {
+				if (column[c] >= min_points) {
+					out.add_point(s * ObstacleSectors::increment_deg(), std::max(c * voxel_size, 0.01f));
+					break;
+				}
+			}
+		}
+	}
+
+private:
+	float voxel_size;
+	size_t cells;
+	std::vector<uint16_t> counts;
+};
+}	// namespace mavros
@@ -0,0 +1,97 @@
+/**
+ * @brief Plugin factory: pluginlib or compile-time registry
+ * @file plugin_registry.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <mavros/mavros_plugin.h>
+#include <pluginlib/exceptions.h>
+
+#ifndef MAVROS_STATIC_PLUGINS
+#include <pluginlib/class_list_macros.h>
+#endif
+
+namespace pluginlib {
+template<class T> class ClassLoader;
+}	// namespace pluginlib
+
+namespace mavros {
+namespace plugin {
+/**
+ * @brief Creates plugins by name
+ *
+ * Default build uses pluginlib: manifests parsed and plugin libraries
+ * dlopen()-ed at start.
+ *
+ * With MAVROS_STATIC_PLUGINS build option plugins are linked into the node,
+ * each registers its factory by MAVROS_PLUGIN_EXPORT(), and names come from
+ * table generated of mavros_plugins.xml at build time.
+ * Names and their order are same in both builds, and so is class layout
+ * (MavRos member): loader is just not created by static build.
+ */
+class PluginRegistry {
+public:
+	//! factory of statically linked plugin
+	using Factory = PluginBase::Ptr (*)();
+
+	PluginRegistry();
+
+	//! Names of available plugins, sorted, same as pluginlib::ClassLoader
+	std::vector<std::string> getDeclaredClasses();
+
+	/**
+	 * @brief Create plugin instance
+	 * @throws pluginlib::PluginlibException on unknown or failed plugin
+	 */
+	PluginBase::Ptr createInstance(const std::string &name);
+
+	//! Register factory of plugin class @a type, used by MAVROS_PLUGIN_EXPORT()
+	struct ClassEntry {
+		ClassEntry(const char *type, Factory factory);
+	};
+
+	//! Register plugin @a name of class @a type, used by generated name table
+	struct NameEntry {
+		NameEntry(const char *name, const char *type);
+	};
+
+private:
+	//! pluginlib build only, empty in static build. shared_ptr: deleter does not need complete type
+	std::shared_ptr<pluginlib::ClassLoader<PluginBase>> loader;
+};
+}	// namespace plugin
+}	// namespace mavros
+
+/**
+ * @brief Export plugin class, instead of PLUGINLIB_EXPORT_CLASS()
+ *
+ * @param class_type  fully qualified name, as "type" in mavros_plugins.xml
+ * @note used at file scope without trailing semicolon, like pluginlib macro
+ */
+#ifdef MAVROS_STATIC_PLUGINS
+#define MAVROS_PLUGIN_EXPORT(class_type)						\
+	static const ::mavros::plugin::PluginRegistry::ClassEntry			\
+	mavros_plugin_class_entry_(#class_type,						\
+			[]() -> ::mavros::plugin::PluginBase::Ptr {			\
+				return boost::make_shared<class_type>();		\
+			});
+#else
+#define MAVROS_PLUGIN_EXPORT(class_type)						\
+	PLUGINLIB_EXPORT_CLASS(class_type, mavros::plugin::PluginBase)
+#endif
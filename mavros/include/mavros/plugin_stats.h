@@ -0,0 +1,140 @@
+/**
+ * @brief Per plugin handler accounting
+ * @file plugin_stats.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <ros/callback_queue_interface.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace mavros {
+namespace plugin {
+/**
+ * @brief Call count and time spent in handlers of one plugin
+ *
+ * MAVLink handlers and callbacks (ROS ones through StatsCallbackQueue,
+ * timer wheel ones by PluginBase::make_timer()) are counted separately.
+ * Time measured by cycle counter (TSC on x86, steady_clock elsewhere):
+ * two reads and few relaxed atomics per call.
+ *
+ * Allocations made inside calls are counted only when mavros built
+ * with MAVROS_ENABLE_ALLOC_STATS, which replaces global operator new.
+ */
+class PluginStats {
+public:
+	using Ptr = std::shared_ptr<PluginStats>;
+
+	struct Counters {
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> cycles;
+		std::atomic<uint64_t> max_cycles;
+		std::atomic<uint64_t> allocs;
+
+		Counters() :
+			calls(0),
+			cycles(0),
+			max_cycles(0),
+			allocs(0)
+		{ }
+
+		void add(uint64_t dt, uint64_t nallocs) {
+			calls.fetch_add(1, std::memory_order_relaxed);
+			cycles.fetch_add(dt, std::memory_order_relaxed);
+			allocs.fetch_add(nallocs, std::memory_order_relaxed);
+
+			auto max = max_cycles.load(std::memory_order_relaxed);
+			while (dt > max && !max_cycles.compare_exchange_weak(max, dt, std::memory_order_relaxed));
+		}
+	};
+
+	Counters handlers;	//!< MAVLink message handlers
+	Counters callbacks;	//!< ROS subscription, service, timer and timer wheel callbacks
+
+	/**
+	 * @brief Account call made in this scope
+	 *
+	 * Nested scopes (e.g. handler publishing to other plugin's
+	 * intra-process subscriber) count to both plugins.
+	 */
+	class Scope {
+	public:
+		Scope(Counters &counters_) :
+			counters(counters_),
+			start(cycles()),
+			start_allocs(thread_allocs)
+		{ }
+
+		~Scope() {
+			counters.add(cycles() - start, thread_allocs - start_allocs);
+		}
+
+	private:
+		Counters &counters;
+		uint64_t start;
+		uint64_t start_allocs;
+	};
+
+	//! Cycle counter value
+	static inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	//! Cycle counter rate, estimated against steady_clock since library load
+	static double cycles_per_second();
+
+	//! Allocations are counted in this build
+	static bool alloc_stats_enabled();
+
+	//! Allocations made by this thread (MAVROS_ENABLE_ALLOC_STATS only)
+	static thread_local uint64_t thread_allocs;
+};
+
+/**
+ * @brief Callback queue proxy accounting callbacks of one plugin
+ *
+ * Set to plugin NodeHandle instead of its queue: callbacks are
+ * wrapped and forwarded to @a target queue, which still runs them.
+ */
+class StatsCallbackQueue : public ros::CallbackQueueInterface {
+public:
+	StatsCallbackQueue(ros::CallbackQueueInterface *target_, PluginStats::Ptr stats_) :
+		target(target_),
+		stats(stats_)
+	{ }
+
+	void addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id = 0) override;
+
+	void removeByID(uint64_t owner_id) override {
+		target->removeByID(owner_id);
+	}
+
+private:
+	ros::CallbackQueueInterface *target;
+	PluginStats::Ptr stats;
+};
+}	// namespace plugin
+}	// namespace mavros
@@ -0,0 +1,406 @@
+/**
+ * @brief Onboard computer status from procfs
+ * @file procfs_stat.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+
+namespace mavros {
+namespace procfs {
+//! CPU jiffies of one /proc/stat line
+struct CpuTimes {
+	uint64_t busy;
+	uint64_t total;
+};
+
+//! Network interface byte counters of /proc/net/dev
+struct NetCounters {
+	char name[16];
+	uint64_t rx_bytes;
+	uint64_t tx_bytes;
+};
+
+//! Next line of NUL terminated @a p, nullptr at end
+inline const char *next_line(const char *p)
+{
+	p = std::strchr(p, '\n');
+	return p ? p + 1 : nullptr;
+}
+
+/**
+ * @brief Parse cpu lines of /proc/stat
+ *
+ * @param[out] combined  "cpu" line
+ * @param[out] cores     "cpuN" lines, at most @a max_cores
+ * @return number of cores parsed
+ */
+inline size_t parse_stat(const char *buf, CpuTimes &combined, CpuTimes *cores, size_t max_cores)
+{
+	size_t ncores = 0;
+	combined = {0, 0};
+
+	for (const char *p = buf; p && std::strncmp(p, "cpu", 3) == 0; p = next_line(p)) {
+		const bool is_core = p[3] != ' ';
+		char *end;
+		const char *f = p + 3;
+		if (is_core) {
+			std::strtoul(f, &end, 10);	// core number
+			f = end;
+		}
+
+		// user nice system idle iowait irq softirq steal (guest counted in user)
+		uint64_t v[8] = {};
+		for (size_t i = 0; i < 8; i++) {
+			v[i] = std::strtoull(f, &end, 10);
+			if (end == f)
+				break;
+			f = end;
+		}
+
+		const uint64_t idle = v[3] + v[4];
+		uint64_t total = 0;
+		for (auto x : v)
+			total += x;
+
+		if (!is_core)
+			combined = {total - idle, total};
+		else if (ncores < max_cores)
+			cores[ncores++] = {total - idle, total};
+	}
+
+	return ncores;
+}
+
+/**
+ * @brief Parse MemTotal and MemAvailable of /proc/meminfo
+ * @return false if fields absent
+ */
+inline bool parse_meminfo(const char *buf, uint64_t &total_kb, uint64_t &available_kb)
+{
+	int found = 0;
+	for (const char *p = buf; p && found != 3; p = next_line(p)) {
+		if (std::strncmp(p, "MemTotal:", 9) == 0) {
+			total_kb = std::strtoull(p + 9, nullptr, 10);
+			found |= 1;
+		}
+		else if (std::strncmp(p, "MemAvailable:", 13) == 0) {
+			available_kb = std::strtoull(p + 13, nullptr, 10);
+			found |= 2;
+		}
+	}
+
+	return found == 3;
+}
+
+/**
+ * @brief Parse /proc/net/dev, loopback skipped
+ * @return number of interfaces parsed, at most @a max_ifaces
+ */
+inline size_t parse_net_dev(const char *buf, NetCounters *out, size_t max_ifaces)
+{
+	size_t n = 0;
+
+	// two header lines
+	const char *p = next_line(buf);
+	p = p ? next_line(p) : nullptr;
+
+	for (; p && n < max_ifaces; p = next_line(p)) {
+		const char *colon = std::strchr(p, ':');
+		const char *eol = std::strchr(p, '\n');
+		if (!colon || (eol && colon > eol))
+			break;
+
+		while (*p == ' ')
+			p++;
+
+		const size_t len = std::min<size_t>(colon - p, sizeof(out[n].name) - 1);
+		if (len == 2 && std::strncmp(p, "lo", 2) == 0)
+			continue;
+
+		std::memcpy(out[n].name, p, len);
+		out[n].name[len] = '\0';
+
+		// rx: bytes packets errs drop fifo frame compressed multicast, tx: bytes ...
+		char *end;
+		const char *f = colon + 1;
+		uint64_t v[9];
+		for (size_t i = 0; i < 9; i++) {
+			v[i] = std::strtoull(f, &end, 10);
+			f = end;
+		}
+
+		out[n].rx_bytes = v[0];
+		out[n].tx_bytes = v[8];
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * @brief File kept open, re-read from start by pread()
+ *
+ * procfs regenerates content on each read at offset 0,
+ * so no open/close per sample.
+ */
+class ProcFile {
+public:
+	ProcFile() : fd(-1) { }
+
+	explicit ProcFile(const std::string &path) :
+		fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+	{ }
+
+	ProcFile(ProcFile &&other) : fd(other.fd) {
+		other.fd = -1;
+	}
+
+	ProcFile &operator=(ProcFile &&other) {
+		std::swap(fd, other.fd);
+		return *this;
+	}
+
+	ProcFile(const ProcFile &) = delete;
+	ProcFile &operator=(const ProcFile &) = delete;
+
+	~ProcFile() {
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	inline bool is_open() const {
+		return fd >= 0;
+	}
+
+	/**
+	 * @brief Read whole file (up to @a size - 1 bytes), NUL terminated
+	 * @return false on error
+	 */
+	bool read(char *buf, size_t size) const
+	{
+		if (fd < 0)
+			return false;
+
+		const ssize_t n = ::pread(fd, buf, size - 1, 0);
+		if (n < 0)
+			return false;
+
+		buf[n] = '\0';
+		return true;
+	}
+
+private:
+	int fd;
+};
+
+/**
+ * @brief Collects ONBOARD_COMPUTER_STATUS fields
+ *
+ * Usage and rates are deltas since previous sample(), so first sample
+ * reports them unused. Field units and "unused" values follow the message.
+ *
+ * @note not thread safe
+ */
+class StatusCollector {
+public:
+	static constexpr size_t MAX_CORES = 8;
+	static constexpr size_t MAX_TEMPS = 8;
+	static constexpr size_t MAX_LINKS = 6;
+	static constexpr size_t COMBINED_LEN = 10;
+
+	struct Status {
+		uint32_t uptime_ms;
+		std::array<uint8_t, MAX_CORES> cpu_cores;
+		std::array<uint8_t, COMBINED_LEN> cpu_combined;	//!< newest last
+		int8_t temperature_board;
+		std::array<int8_t, MAX_TEMPS> temperature_core;
+		uint32_t ram_usage;		//!< MiB
+		uint32_t ram_total;		//!< MiB
+		uint32_t storage_usage;		//!< MiB
+		uint32_t storage_total;		//!< MiB
+		std::array<uint32_t, MAX_LINKS> link_tx_rate;	//!< KiB/s
+		std::array<uint32_t, MAX_LINKS> link_rx_rate;	//!< KiB/s
+	};
+
+	StatusCollector() :
+		have_cpu(false),
+		ncores(0),
+		nlinks(0),
+		last_stamp(0.0)
+	{
+		combined_hist.fill(UINT8_MAX);
+	}
+
+	/**
+	 * @brief Open procfs and sysfs files
+	 * @param storage_path  mount point for storage usage, empty - disabled
+	 */
+	void open(const std::string &storage_path = "/")
+	{
+		f_stat = ProcFile("/proc/stat");
+		f_meminfo = ProcFile("/proc/meminfo");
+		f_netdev = ProcFile("/proc/net/dev");
+		f_uptime = ProcFile("/proc/uptime");
+		storage = storage_path;
+
+		thermal.clear();
+		for (size_t i = 0; i < MAX_TEMPS; i++) {
+			ProcFile f("/sys/class/thermal/thermal_zone" + std::to_string(i) + "/temp");
+			if (!f.is_open())
+				break;
+			thermal.emplace_back(std::move(f));
+		}
+	}
+
+	inline size_t thermal_zones() const {
+		return thermal.size();
+	}
+
+	//! Read all sources, @a now [s] is used for rates
+	void sample(double now, Status &st)
+	{
+		st.uptime_ms = 0;
+		st.cpu_cores.fill(UINT8_MAX);
+		st.temperature_board = INT8_MAX;
+		st.temperature_core.fill(INT8_MAX);
+		st.ram_usage = UINT32_MAX;
+		st.ram_total = UINT32_MAX;
+		st.storage_usage = UINT32_MAX;
+		st.storage_total = UINT32_MAX;
+		st.link_tx_rate.fill(UINT32_MAX);
+		st.link_rx_rate.fill(UINT32_MAX);
+
+		if (f_uptime.read(buf, sizeof(buf)))
+			st.uptime_ms = std::strtod(buf, nullptr) * 1e3;
+
+		sample_cpu(st);
+		sample_net(now, st);
+
+		uint64_t total_kb = 0, avail_kb = 0;
+		if (f_meminfo.read(buf, sizeof(buf)) && parse_meminfo(buf, total_kb, avail_kb)) {
+			st.ram_total = total_kb / 1024;
+			st.ram_usage = (total_kb - avail_kb) / 1024;
+		}
+
+		for (size_t i = 0; i < thermal.size(); i++) {
+			if (!thermal[i].read(buf, sizeof(buf)))
+				continue;
+
+			const long mdeg = std::strtol(buf, nullptr, 10);
+			st.temperature_core[i] = std::max<long>(INT8_MIN, std::min<long>(INT8_MAX - 1, mdeg / 1000));
+		}
+		// first zone usually is SoC/board sensor
+		if (!thermal.empty())
+			st.temperature_board = st.temperature_core[0];
+
+		struct statvfs vfs;
+		if (!storage.empty() && ::statvfs(storage.c_str(), &vfs) == 0) {
+			const uint64_t frsize = vfs.f_frsize;
+			st.storage_total = (vfs.f_blocks * frsize) >> 20;
+			st.storage_usage = ((vfs.f_blocks - vfs.f_bfree) * frsize) >> 20;
+		}
+
+		last_stamp = now;
+	}
+
+private:
+	ProcFile f_stat, f_meminfo, f_netdev, f_uptime;
+	std::vector<ProcFile> thermal;
+	std::string storage;
+
+	char buf[16384];	//!< cpu lines are first in /proc/stat, rest may be truncated
+
+	bool have_cpu;
+	CpuTimes prev_combined;
+	std::array<CpuTimes, MAX_CORES> prev_cores;
+	size_t ncores;
+
+	std::array<NetCounters, MAX_LINKS> prev_links;
+	size_t nlinks;
+	double last_stamp;
+
+	std::array<uint8_t, COMBINED_LEN> combined_hist;
+
+	static inline uint8_t usage(const CpuTimes &now, const CpuTimes &prev)
+	{
+		const uint64_t dtotal = now.total - prev.total;
+		if (dtotal == 0)
+			return 0;
+		return 100 * (now.busy - prev.busy) / dtotal;
+	}
+
+	void sample_cpu(Status &st)
+	{
+		if (!f_stat.read(buf, sizeof(buf)))
+			return;
+
+		CpuTimes combined;
+		std::array<CpuTimes, MAX_CORES> cores;
+		const size_t n = parse_stat(buf, combined, cores.data(), cores.size());
+
+		if (have_cpu && ncores == n) {
+			for (size_t i = 0; i < n; i++)
+				st.cpu_cores[i] = usage(cores[i], prev_cores[i]);
+
+			std::rotate(combined_hist.begin(), combined_hist.begin() + 1, combined_hist.end());
+			combined_hist.back() = usage(combined, prev_combined);
+		}
+
+		st.cpu_combined = combined_hist;
+
+		prev_combined = combined;
+		prev_cores = cores;
+		ncores = n;
+		have_cpu = true;
+	}
+
+	void sample_net(double now, Status &st)
+	{
+		if (!f_netdev.read(buf, sizeof(buf)))
+			return;
+
+		std::array<NetCounters, MAX_LINKS> links;
+		const size_t n = parse_net_dev(buf, links.data(), links.size());
+		const double dt = now - last_stamp;
+
+		if (n == nlinks && last_stamp > 0.0 && dt > 0.0) {
+			for (size_t i = 0; i < n; i++) {
+				// interface list changed
+				if (std::strcmp(links[i].name, prev_links[i].name) != 0)
+					break;
+
+				st.link_rx_rate[i] = (links[i].rx_bytes - prev_links[i].rx_bytes) / dt / 1024.0;
+				st.link_tx_rate[i] = (links[i].tx_bytes - prev_links[i].tx_bytes) / dt / 1024.0;
+			}
+		}
+
+		prev_links = links;
+		nlinks = n;
+	}
+};
+}	// namespace procfs
+}	// namespace mavros
@@ -0,0 +1,86 @@
+/**
+ * @brief MAVLink protocol version negotiation
+ * @file protocol_negotiator.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace mavros {
+/**
+ * @brief Chooses FCU output protocol by framing of FCU heartbeats
+ *
+ * Output starts as v2.0 (probe): v2 capable FCU in auto mode (PX4) answers
+ * with v2 frames after it got some, v2 only FCU sends them anyway.
+ * If @a probe_heartbeats heartbeats still come in v1 framing, FCU does not
+ * parse v2 and output falls back to v1.0. Later v2 heartbeat upgrades it again,
+ * v2.0 is never downgraded (v2 parsers accept v1 frames).
+ */
+class ProtocolNegotiator {
+public:
+	enum class State {
+		probing,	//!< output v2.0, not decided
+		v1,		//!< output v1.0
+		v2,		//!< output v2.0
+	};
+
+	explicit ProtocolNegotiator(size_t probe_heartbeats = 3) :
+		probe_heartbeats(probe_heartbeats),
+		v1_heartbeats(0),
+		state_(State::probing)
+	{ }
+
+	/**
+	 * @brief Feed FCU heartbeat framing
+	 * @return true if state changed
+	 */
+	bool heartbeat(bool is_v2)
+	{
+		const State prev = state_;
+
+		if (is_v2)
+			state_ = State::v2;
+		else if (prev == State::probing && ++v1_heartbeats >= probe_heartbeats)
+			state_ = State::v1;
+
+		return state_ != prev;
+	}
+
+	inline State state() const {
+		return state_;
+	}
+
+	//! Output v1.0 framing
+	inline bool use_v1() const {
+		return state_ == State::v1;
+	}
+
+	static const char *to_string(State s)
+	{
+		switch (s) {
+		case State::probing:	return "probing";
+		case State::v1:		return "v1.0";
+		case State::v2:		return "v2.0";
+		}
+		return "unknown";
+	}
+
+private:
+	const size_t probe_heartbeats;
+	size_t v1_heartbeats;
+	std::atomic<State> state_;	//!< also read by diagnostics
+};
+}	// namespace mavros
@@ -105,7 +105,9 @@ union custom_mode {
  * @return uint32_t representation
  */
 constexpr uint32_t define_mode(enum custom_mode::MAIN_MODE mm, uint8_t sm = 0) {
-	return custom_mode(mm, sm).data;
+	// same as custom_mode(mm, sm).data (little endian),
+	// but reading other union member is not a constant expression
+	return (uint32_t(mm) << 16) | (uint32_t(sm) << 24);
 }
 
 /**
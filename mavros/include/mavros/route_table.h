@@ -0,0 +1,98 @@
+/**
+ * @brief Plugin message routing table
+ * @file route_table.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <mavros/mavros_plugin.h>
+
+namespace mavros {
+/**
+ * @brief Frozen msgid -> handlers table
+ *
+ * Built once after plugin loading from subscriptions map.
+ * Subscribed msgids remapped to dense index, handlers of all msgids
+ * stored in one vector, so routing is array index plus direct calls.
+ *
+ * Raw handlers of msgid called first, then message decoded once
+ * and passed to all typed handlers (add_plugin() guarantees one type per msgid).
+ *
+ * Same scheme as libmavconn message entry table:
+ * msgid below @a DIRECT_SIZE indexed directly, others found in sorted vector.
+ *
+ * @note Not modified after build(), so safe to use from several threads.
+ */
+class RouteTable {
+public:
+	using SubscriptionsMap = std::unordered_map<mavlink::msgid_t, plugin::PluginBase::Subscriptions>;
+	using HandlerCb = plugin::PluginBase::HandlerCb;
+
+	//! msgids indexed without search
+	static constexpr size_t DIRECT_SIZE = 1024;
+
+	RouteTable();
+
+	//! Replace table content
+	void build(const SubscriptionsMap &subscriptions);
+
+	//! Call all handlers of message
+	inline void route(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing) const {
+		auto idx = find(msg->msgid);
+		if (idx == 0)
+			return;
+
+		auto &r = routes[idx];
+		for (auto i = r.begin; i < r.typed_begin; i++)
+			handlers[i](msg, framing);
+
+		if (r.typed_begin != r.end && framing == mavconn::Framing::ok)
+			r.fanout(msg, handlers.data() + r.typed_begin, handlers.data() + r.end);
+	}
+
+	//! Number of routed msgids
+	inline size_t size() const {
+		return routes.size() - 1;
+	}
+
+private:
+	using Index = uint16_t;		// 0 - no route
+
+	//! handlers of one msgid: raw [begin, typed_begin), typed [typed_begin, end)
+	struct Route {
+		uint32_t begin;
+		uint32_t typed_begin;
+		uint32_t end;
+		HandlerCb::FanOut fanout;
+	};
+
+	std::array<Index, DIRECT_SIZE> direct;
+	std::vector<std::pair<mavlink::msgid_t, Index>> sparse;	// sorted by msgid
+	std::vector<Route> routes;
+	std::vector<HandlerCb> handlers;
+
+	inline Index find(mavlink::msgid_t msgid) const {
+		if (msgid < DIRECT_SIZE)
+			return direct[msgid];
+
+		return find_sparse(msgid);
+	}
+
+	Index find_sparse(mavlink::msgid_t msgid) const;
+};
+}	// namespace mavros
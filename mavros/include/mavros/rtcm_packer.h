@@ -0,0 +1,188 @@
+/**
+ * @brief RTCM3 stream packer
+ * @file rtcm_packer.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+
+namespace mavros {
+/**
+ * @brief Packs RTCM3 frames to GPS_RTCM_DATA sized packets
+ *
+ * Autopilot injects GPS_RTCM_DATA payload to the receiver as a byte stream,
+ * so several small frames may share one non fragmented message.
+ * Frames are not split between packets, frame longer than fragment
+ * goes alone, sender fragments it. Data not framed as RTCM3
+ * (e.g. NTRIP chunks cut in the middle) is packed as plain bytes.
+ *
+ * When link is saturated station description frames, which base
+ * repeats anyway, are dropped if same type was sent within redundant period.
+ */
+class RtcmPacker {
+public:
+	//! GPS_RTCM_DATA.data size
+	static constexpr size_t FRAG_LEN = 180;
+	//! RTCM3 preamble, 10 bit length, 24 bit CRC
+	static constexpr uint8_t PREAMBLE = 0xD3;
+	static constexpr size_t HEADER_LEN = 3;
+	static constexpr size_t CRC_LEN = 3;
+
+	//! Called with packet to send, at most FRAG_LEN unless it is single long frame
+	using Callback = std::function<void (const uint8_t *data, size_t len)>;
+
+	explicit RtcmPacker(Callback cb_) :
+		cb(cb_),
+		redundant_period(5.0),
+		skipped_(0)
+	{
+		last_sent.fill(-1e9);
+	}
+
+	//! Minimum interval between redundant frames on saturated link [s]
+	void set_redundant_period(double period) {
+		redundant_period = period;
+	}
+
+	/**
+	 * @brief Add data
+	 *
+	 * @param[in] now        time [s], any monotonic base
+	 * @param[in] saturated  drop redundant frames
+	 */
+	void push(const uint8_t *data, size_t len, double now, bool saturated)
+	{
+		size_t pos = 0;
+
+		while (pos < len) {
+			const size_t flen = frame_length(data + pos, len - pos);
+			if (flen == 0) {
+				// not a frame: rest as plain stream bytes
+				push_bytes(data + pos, len - pos);
+				return;
+			}
+
+			const int slot = redundant_slot(frame_type(data + pos));
+			if (slot >= 0) {
+				if (saturated && now - last_sent[slot] < redundant_period) {
+					skipped_++;
+					pos += flen;
+					continue;
+				}
+
+				last_sent[slot] = now;
+			}
+
+			push_frame(data + pos, flen);
+			pos += flen;
+		}
+	}
+
+	//! Send pending packet
+	void flush()
+	{
+		if (!pending.empty()) {
+			cb(pending.data(), pending.size());
+			pending.clear();
+		}
+	}
+
+	inline bool empty() const {
+		return pending.empty();
+	}
+
+	//! Frames dropped as redundant
+	inline size_t skipped() const {
+		return skipped_;
+	}
+
+	/**
+	 * @brief Length of complete RTCM3 frame at @a data
+	 * @return frame length with header and CRC, 0 if there is no frame
+	 */
+	static size_t frame_length(const uint8_t *data, size_t len)
+	{
+		if (len < HEADER_LEN + CRC_LEN || data[0] != PREAMBLE)
+			return 0;
+
+		const size_t flen = HEADER_LEN + (size_t(data[1] & 0x03) << 8 | data[2]) + CRC_LEN;
+		return (flen <= len) ? flen : 0;
+	}
+
+	//! 12 bit message number, 0 if payload too short
+	static uint16_t frame_type(const uint8_t *frame)
+	{
+		const size_t plen = size_t(frame[1] & 0x03) << 8 | frame[2];
+		if (plen < 2)
+			return 0;
+
+		return uint16_t(frame[3]) << 4 | frame[4] >> 4;
+	}
+
+private:
+	static constexpr size_t REDUNDANT_COUNT = 6;
+
+	Callback cb;
+	std::vector<uint8_t> pending;
+	std::array<double, REDUNDANT_COUNT> last_sent;
+	double redundant_period;
+	size_t skipped_;
+
+	//! station and antenna description, GLONASS biases
+	static int redundant_slot(uint16_t type)
+	{
+		switch (type) {
+		case 1005: return 0;
+		case 1006: return 1;
+		case 1007: return 2;
+		case 1008: return 3;
+		case 1033: return 4;
+		case 1230: return 5;
+		default:   return -1;
+		}
+	}
+
+	void push_frame(const uint8_t *frame, size_t len)
+	{
+		if (pending.size() + len > FRAG_LEN)
+			flush();
+
+		if (len > FRAG_LEN) {
+			cb(frame, len);
+			return;
+		}
+
+		pending.insert(pending.end(), frame, frame + len);
+	}
+
+	void push_bytes(const uint8_t *data, size_t len)
+	{
+		while (len > 0) {
+			const size_t n = std::min(len, FRAG_LEN - pending.size());
+			pending.insert(pending.end(), data, data + n);
+			data += n;
+			len -= n;
+
+			if (pending.size() == FRAG_LEN)
+				flush();
+		}
+	}
+};
+}	// namespace mavros
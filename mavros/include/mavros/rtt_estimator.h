@@ -0,0 +1,92 @@
+/**
+ * @brief Round trip time estimator
+ * @file rtt_estimator.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+namespace mavros {
+/**
+ * @brief Smoothed RTT of request-reply exchange (RFC 6298)
+ *
+ * Used by plugins that keep several requests in flight
+ * to derive retry timeout from link latency instead of fixed one.
+ *
+ * @note Feed only replies to not resent requests (Karn's rule).
+ */
+class RttEstimator {
+public:
+	RttEstimator() :
+		srtt_(0.0),
+		rttvar_(0.0),
+		samples_(0)
+	{ }
+
+	void reset()
+	{
+		srtt_ = 0.0;
+		rttvar_ = 0.0;
+		samples_ = 0;
+	}
+
+	//! Add sample [s]
+	void update(double rtt)
+	{
+		if (samples_ == 0) {
+			srtt_ = rtt;
+			rttvar_ = rtt / 2;
+		}
+		else {
+			rttvar_ = 0.75 * rttvar_ + 0.25 * std::abs(srtt_ - rtt);
+			srtt_ = 0.875 * srtt_ + 0.125 * rtt;
+		}
+
+		samples_++;
+	}
+
+	inline bool empty() const {
+		return samples_ == 0;
+	}
+
+	inline double srtt() const {
+		return srtt_;
+	}
+
+	inline size_t samples() const {
+		return samples_;
+	}
+
+	/**
+	 * @brief Retry timeout [s]
+	 *
+	 * srtt + 4 * rttvar bounded by [min_s, max_s],
+	 * max_s until first sample.
+	 */
+	double timeout(double min_s, double max_s) const
+	{
+		if (samples_ == 0)
+			return max_s;
+
+		return std::max(min_s, std::min(max_s, srtt_ + 4 * rttvar_));
+	}
+
+private:
+	double srtt_;
+	double rttvar_;
+	size_t samples_;
+};
+}	// namespace mavros
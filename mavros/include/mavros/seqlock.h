@@ -0,0 +1,100 @@
+/**
+ * @brief Sequence lock for small POD state
+ * @file seqlock.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace mavros {
+/**
+ * @brief Value shared between writer and many readers without reader locks
+ *
+ * Writer increments sequence counter before and after update,
+ * reader retries copy if counter was odd or changed meanwhile.
+ * Value kept in relaxed atomic words, so there is no data race
+ * on torn copy, it just gets discarded.
+ *
+ * Writers serialized by mutex, readers never block writer.
+ *
+ * @note T should be trivially copyable and small (few cache lines).
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock value copied bytewise");
+
+public:
+	explicit SeqLock(const T &value = T()) :
+		seq(0)
+	{
+		store(value);
+	}
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock &operator=(const SeqLock&) = delete;
+
+	void store(const T &value)
+	{
+		uint64_t buf[N_WORDS] = {};
+		std::memcpy(buf, &value, sizeof(T));
+
+		std::lock_guard<std::mutex> lock(write_mutex);
+
+		const uint32_t s = seq.load(std::memory_order_relaxed);
+		seq.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < N_WORDS; i++)
+			words[i].store(buf[i], std::memory_order_relaxed);
+
+		seq.store(s + 2, std::memory_order_release);
+	}
+
+	T load() const
+	{
+		uint64_t buf[N_WORDS];
+		uint32_t s0, s1;
+
+		do {
+			s0 = seq.load(std::memory_order_acquire);
+			for (size_t i = 0; i < N_WORDS; i++)
+				buf[i] = words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s1 = seq.load(std::memory_order_relaxed);
+		} while ((s0 & 1) || s0 != s1);
+
+		T value;
+		std::memcpy(&value, buf, sizeof(T));
+		return value;
+	}
+
+	//! Number of completed store() calls
+	inline uint32_t version() const {
+		return seq.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	static constexpr size_t N_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint32_t> seq;
+	std::atomic<uint64_t> words[N_WORDS];
+	std::mutex write_mutex;
+};
+}	// namespace mavros
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <memory>
 #include <functional>
 #include <mavros/utils.h>
 #include <mavros/mavros_plugin.h>
@@ -158,92 +159,98 @@ public:
 };
 
 /**
- * @brief This mixin adds TF2 listener thread to plugin
+ * @brief This mixin adds TF2 listener to plugin
  *
  * It requires tf_frame_id, tf_child_frame_id strings
- * tf_rate double and uas object pointer
+ * tf_rate double and uas object pointer.
+ *
+ * Callback called by shared UAS::tf_watcher thread when transform
+ * updates, at most tf_rate times per second.
  */
 template <class D>
 class TF2ListenerMixin {
 public:
-	std::thread tf_thread;
-	std::string tf_thd_name;
+	TF2ListenerMixin() :
+		tf_uas(nullptr),
+		tf_watch_id(0)
+	{ }
+
+	~TF2ListenerMixin()
+	{
+		tf2_stop();
+	}
 
 	/**
 	 * @brief start tf listener
 	 *
-	 * @param _thd_name  listener thread name
+	 * @param _thd_name  listener name, for log messages
 	 * @param cbp        plugin callback function
 	 */
 	void tf2_start(const char *_thd_name, void (D::*cbp)(const geometry_msgs::TransformStamped &) )
 	{
-		tf_thd_name = _thd_name;
-		auto tf_transform_cb = std::bind(cbp, static_cast<D *>(this), std::placeholders::_1);
-
-		tf_thread = std::thread([this, tf_transform_cb]() {
-			mavconn::utils::set_this_thread_name("%s", tf_thd_name.c_str());
-
-			mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
-			std::string &_frame_id = static_cast<D *>(this)->tf_frame_id;
-			std::string &_child_frame_id = static_cast<D *>(this)->tf_child_frame_id;
-
-			ros::Rate rate(static_cast<D *>(this)->tf_rate);
-			while (ros::ok()) {
-				// Wait up to 3s for transform
-				if (m_uas_->tf2_buffer.canTransform(_frame_id, _child_frame_id, ros::Time(0), ros::Duration(3.0))) {
-					try {
-						auto transform = m_uas_->tf2_buffer.lookupTransform(
-								_frame_id, _child_frame_id, ros::Time(0), ros::Duration(3.0));
-						tf_transform_cb(transform);
-					}
-					catch (tf2::LookupException &ex) {
-						ROS_ERROR_NAMED("tf2_buffer", "%s: %s", tf_thd_name.c_str(), ex.what());
-					}
-				}
-				rate.sleep();
-			}
-		});
+		auto d = static_cast<D *>(this);
+
+		tf_uas = d->m_uas;
+		tf_watch_id = tf_uas->tf_watcher.add(_thd_name, d->tf_frame_id, d->tf_child_frame_id, d->tf_rate,
+				std::bind(cbp, d, std::placeholders::_1));
+	}
+
+	/**
+	 * @brief stop tf listener
+	 *
+	 * Plugin destructor should call it: mixin destructor runs
+	 * after plugin members used by callback are destroyed.
+	 */
+	void tf2_stop()
+	{
+		if (tf_uas && tf_watch_id)
+			tf_uas->tf_watcher.remove(tf_watch_id);
+
+		tf_watch_id = 0;
 	}
 
 	/**
 	 * @brief start tf listener syncronized with another topic
 	 *
-	 * @param _thd_name  listener thread name
+	 * Callback called for each topic message when its frame transformable,
+	 * with latest transform. Runs in plugin node handle queue, no thread.
+	 *
+	 * @param _thd_name  listener name, for log messages
 	 * @param cbp        plugin callback function
 	 */
 	template <class T>
 	void tf2_start(const char *_thd_name, message_filters::Subscriber<T> &topic_sub, void (D::*cbp)(const geometry_msgs::TransformStamped &, const typename T::ConstPtr &))
 	{
-		tf_thd_name = _thd_name;
-
-		tf_thread = std::thread([this, cbp, &topic_sub]() {
-			mavconn::utils::set_this_thread_name("%s", tf_thd_name.c_str());
-
-			mavros::UAS *m_uas_ = static_cast<D *>(this)->m_uas;
-			ros::NodeHandle &_sp_nh = static_cast<D *>(this)->sp_nh;
-			std::string &_frame_id = static_cast<D *>(this)->tf_frame_id;
-			std::string &_child_frame_id = static_cast<D *>(this)->tf_child_frame_id;
-
-			tf2_ros::MessageFilter<T> tf2_filter(topic_sub, m_uas_->tf2_buffer, _frame_id, 10, _sp_nh);
-
-			ros::Rate rate(static_cast<D *>(this)->tf_rate);
-			while (ros::ok()) {
-				// Wait up to 3s for transform
-				if (m_uas_->tf2_buffer.canTransform(_frame_id, _child_frame_id, ros::Time(0), ros::Duration(3.0))) {
-					try {
-						auto transform = m_uas_->tf2_buffer.lookupTransform(
-								_frame_id, _child_frame_id, ros::Time(0), ros::Duration(3.0));
-
-						tf2_filter.registerCallback(boost::bind(cbp, static_cast<D *>(this), transform, _1));
-					}
-					catch (tf2::LookupException &ex) {
-						ROS_ERROR_NAMED("tf2_buffer", "%s: %s", tf_thd_name.c_str(), ex.what());
-					}
+		auto d = static_cast<D *>(this);
+		auto &tf2_buffer = d->m_uas->tf2_buffer;
+		std::string name = _thd_name;
+
+		auto filter = std::make_shared<tf2_ros::MessageFilter<T>>(tf2_buffer, d->tf_frame_id, 10, d->sp_nh);
+		std::weak_ptr<tf2_ros::MessageFilter<T>> weak_filter = filter;
+
+		// not connectInput(): subscriber is plugin member, destroyed before mixin and its filter
+		topic_sub.registerCallback([weak_filter](const typename T::ConstPtr &msg) {
+				if (auto f = weak_filter.lock())
+					f->add(msg);
+			});
+
+		filter->registerCallback([d, cbp, name, &tf2_buffer](const typename T::ConstPtr &msg) {
+				try {
+					auto transform = tf2_buffer.lookupTransform(d->tf_frame_id, d->tf_child_frame_id, ros::Time(0));
+					(d->*cbp)(transform, msg);
+				}
+				catch (tf2::TransformException &ex) {
+					ROS_ERROR_NAMED("tf2_buffer", "%s: %s", name.c_str(), ex.what());
 				}
-				rate.sleep();
-			}
-		});
+			});
+
+		tf_filter = filter;
 	}
+
+private:
+	mavros::UAS *tf_uas;
+	size_t tf_watch_id;
+	std::shared_ptr<void> tf_filter;	//!< tf2_ros::MessageFilter<T> of synchronized listener
 };
 }	// namespace plugin
 }	// namespace mavros
@@ -0,0 +1,188 @@
+/**
+ * @brief Sliding window mean and variance
+ * @file sliding_variance.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+namespace mavros {
+/**
+ * @brief Mean and variance of last N samples, O(1) per sample
+ *
+ * Fixed ring of samples, running mean and sum of squared deviations
+ * updated Welford way: on add and on replacement of oldest sample.
+ * Sums recomputed from ring once per N * RESYNC_WINDOWS replacements,
+ * so rounding error does not accumulate.
+ *
+ * Optional median gate: sample farther than @a threshold from median
+ * of last @a median_size accepted or rejected samples not added.
+ * Spike does not reach variance, step change passes after half of median window.
+ */
+template<size_t N>
+class SlidingVariance {
+	static_assert(N >= 2, "window too small");
+
+public:
+	//! Max median gate window
+	static constexpr size_t MAX_MEDIAN = 15;
+	//! Windows between exact recomputations
+	static constexpr size_t RESYNC_WINDOWS = 16;
+
+	SlidingVariance() :
+		median_size(0),
+		threshold(0.0)
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		count = 0;
+		head = 0;
+		mean_ = 0.0;
+		m2 = 0.0;
+		replaced = 0;
+		median_count = 0;
+		median_head = 0;
+		rejected_ = 0;
+	}
+
+	/**
+	 * Setup median gate
+	 *
+	 * @param[in] size       median window, 0 - gate off, limited to MAX_MEDIAN
+	 * @param[in] threshold_  max distance from median
+	 */
+	void set_median_gate(size_t size, double threshold_)
+	{
+		median_size = std::min(size, size_t(MAX_MEDIAN));
+		threshold = threshold_;
+		median_count = 0;
+		median_head = 0;
+	}
+
+	/**
+	 * Add sample
+	 *
+	 * @return false if rejected by median gate
+	 */
+	bool add(double x)
+	{
+		if (!std::isfinite(x))
+			return false;
+
+		if (median_size > 0 && !gate(x)) {
+			rejected_++;
+			return false;
+		}
+
+		if (count < N) {
+			samples[head] = x;
+			count++;
+
+			const double delta = x - mean_;
+			mean_ += delta / count;
+			m2 += delta * (x - mean_);
+		}
+		else {
+			const double old = samples[head];
+			samples[head] = x;
+
+			const double old_mean = mean_;
+			mean_ += (x - old) / N;
+			m2 += (x - old) * (x - mean_ + old - old_mean);
+
+			if (++replaced >= N * RESYNC_WINDOWS)
+				resync();
+		}
+
+		head = (head + 1) % N;
+		return true;
+	}
+
+	inline size_t size() const {
+		return count;
+	}
+
+	inline double mean() const {
+		return mean_;
+	}
+
+	//! population variance of window
+	inline double variance() const {
+		return (count > 0) ? std::max(0.0, m2 / count) : 0.0;
+	}
+
+	//! samples rejected by gate
+	inline size_t rejected() const {
+		return rejected_;
+	}
+
+private:
+	std::array<double, N> samples;
+	size_t count;
+	size_t head;
+	double mean_;
+	double m2;
+	size_t replaced;
+
+	std::array<double, MAX_MEDIAN> median_ring;
+	size_t median_size;
+	size_t median_count;
+	size_t median_head;
+	double threshold;
+	size_t rejected_;
+
+	bool gate(double x)
+	{
+		bool pass = true;
+
+		// pass until window filled, nothing to compare with
+		if (median_count == median_size) {
+			std::array<double, MAX_MEDIAN> tmp;
+			std::copy(median_ring.begin(), median_ring.begin() + median_count, tmp.begin());
+
+			auto mid = tmp.begin() + median_count / 2;
+			std::nth_element(tmp.begin(), mid, tmp.begin() + median_count);
+			pass = std::abs(x - *mid) <= threshold;
+		}
+		else
+			median_count++;
+
+		// rejected samples too, so gate follows real step
+		median_ring[median_head] = x;
+		median_head = (median_head + 1) % median_size;
+		return pass;
+	}
+
+	void resync()
+	{
+		double sum = 0.0;
+		for (auto v : samples)
+			sum += v;
+
+		mean_ = sum / N;
+		m2 = 0.0;
+		for (auto v : samples)
+			m2 += (v - mean_) * (v - mean_);
+
+		replaced = 0;
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,147 @@
+/**
+ * @brief Bounded lock-free single producer single consumer queue
+ * @file spsc_queue.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cassert>
+#include <cstddef>
+
+namespace mavros {
+/**
+ * @brief Fixed capacity ring with one writer and one reader thread
+ *
+ * Slots are allocated once in constructor, capacity rounded up to power of two.
+ * Producer fills slot returned by alloc() then publish it by commit(),
+ * consumer process element in place by front() and release it by pop(),
+ * so element is copied only once.
+ *
+ * @note Only one thread may call producer side (alloc/commit/push)
+ *       and only one thread may call consumer side (front/pop).
+ */
+template<typename T>
+class SPSCQueue {
+public:
+	explicit SPSCQueue(size_t capacity) :
+		mask(round_up_pow2(capacity) - 1),
+		slots(new T[mask + 1]),
+		head(0),
+		tail(0),
+		high_water_mark_(0)
+	{ }
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue &operator=(const SPSCQueue&) = delete;
+
+	inline size_t capacity() const {
+		return mask + 1;
+	}
+
+	//! Approximate number of queued elements (exact for producer and consumer threads)
+	inline size_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	inline bool empty() const {
+		return size() == 0;
+	}
+
+	//! Maximum queue depth since creation
+	inline size_t high_water_mark() const {
+		return high_water_mark_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Producer: get free slot
+	 *
+	 * @return pointer to slot or nullptr if queue full
+	 */
+	T *alloc() {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask)
+			return nullptr;
+
+		return &slots[t & mask];
+	}
+
+	/**
+	 * @brief Producer: publish slot returned by alloc()
+	 */
+	void commit() {
+		auto t = tail.load(std::memory_order_relaxed) + 1;
+		tail.store(t, std::memory_order_release);
+
+		auto depth = t - head.load(std::memory_order_relaxed);
+		if (depth > high_water_mark_.load(std::memory_order_relaxed))
+			high_water_mark_.store(depth, std::memory_order_relaxed);
+	}
+
+	//! Producer: copy element to queue, false if full
+	bool push(const T &value) {
+		auto slot = alloc();
+		if (slot == nullptr)
+			return false;
+
+		*slot = value;
+		commit();
+		return true;
+	}
+
+	/**
+	 * @brief Consumer: oldest element
+	 *
+	 * Pointer stays valid until pop().
+	 *
+	 * @return pointer to element or nullptr if queue empty
+	 */
+	T *front() {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &slots[h & mask];
+	}
+
+	//! Consumer: release element returned by front()
+	void pop() {
+		auto h = head.load(std::memory_order_relaxed);
+		assert(h != tail.load(std::memory_order_relaxed));
+		head.store(h + 1, std::memory_order_release);
+	}
+
+private:
+	static constexpr size_t CACHELINE_SIZE = 64;
+
+	const size_t mask;
+	std::unique_ptr<T[]> slots;
+
+	// head and tail written by different threads, keep them on own cache lines
+	char pad0_[CACHELINE_SIZE];
+	std::atomic<size_t> head;
+	char pad1_[CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> tail;
+	std::atomic<size_t> high_water_mark_;
+	char pad2_[CACHELINE_SIZE - 2 * sizeof(std::atomic<size_t>)];
+
+	static size_t round_up_pow2(size_t v) {
+		size_t p = 1;
+		while (p < v)
+			p <<= 1;
+		return p;
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,170 @@
+/**
+ * @brief Time-indexed history of vehicle state
+ * @file state_history.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cassert>
+#include <cstdint>
+#include <mavros/seqlock.h>
+
+namespace mavros {
+/**
+ * @brief Fixed size ring of time stamped samples
+ *
+ * Samples should be pushed in stamp order, lookup() finds
+ * two samples around requested stamp by binary search.
+ *
+ * Readers do not lock: each slot is @a SeqLock and keeps
+ * sequence number of the sample, so slot overwritten
+ * during search detected and lookup restarted.
+ *
+ * @note T should be trivially copyable.
+ */
+template<typename T>
+class StateHistory {
+public:
+	explicit StateHistory(size_t capacity) :
+		slots(new SeqLock<Entry>[capacity]),
+		capacity_(capacity),
+		written(0),
+		last_stamp(0)
+	{
+		assert(capacity > 1);
+	}
+
+	StateHistory(const StateHistory&) = delete;
+	StateHistory &operator=(const StateHistory&) = delete;
+
+	inline size_t capacity() const {
+		return capacity_;
+	}
+
+	//! Number of samples available for lookup
+	inline size_t size() const {
+		const uint64_t n = written.load(std::memory_order_acquire);
+		return (n < capacity_) ? n : capacity_;
+	}
+
+	/**
+	 * @brief Add newest sample
+	 *
+	 * @return false if @a stamp_ns older than last pushed sample (sample ignored)
+	 */
+	bool push(uint64_t stamp_ns, const T &value)
+	{
+		std::lock_guard<std::mutex> lock(write_mutex);
+
+		if (stamp_ns < last_stamp)
+			return false;
+
+		const uint64_t n = written.load(std::memory_order_relaxed);
+		slots[n % capacity_].store(Entry {n, stamp_ns, value});
+		written.store(n + 1, std::memory_order_release);
+		last_stamp = stamp_ns;
+		return true;
+	}
+
+	/**
+	 * @brief Find samples around @a stamp_ns
+	 *
+	 * Result is before + (after - before) * ratio.
+	 * Stamp newer than newest sample gives newest one (ratio = 0).
+	 *
+	 * @return false if history empty or @a stamp_ns older than oldest sample
+	 */
+	bool lookup(uint64_t stamp_ns, T &before, T &after, double &ratio) const
+	{
+		// writer may overwrite oldest slots while we search, few retries are enough
+		for (int attempt = 0; attempt < 4; attempt++) {
+			const uint64_t n = written.load(std::memory_order_acquire);
+			if (n == 0)
+				return false;
+
+			uint64_t lo = (n > capacity_) ? n - capacity_ : 0;
+			uint64_t hi = n - 1;
+			Entry e_lo, e_hi;
+
+			if (!read(hi, e_hi))
+				continue;
+
+			if (stamp_ns >= e_hi.stamp) {
+				before = after = e_hi.value;
+				ratio = 0.0;
+				return true;
+			}
+
+			if (!read(lo, e_lo))
+				continue;
+			if (stamp_ns < e_lo.stamp)
+				return false;
+
+			// invariant: e_lo.stamp <= stamp_ns < e_hi.stamp
+			bool overwritten = false;
+			while (hi - lo > 1) {
+				const uint64_t mid = lo + (hi - lo) / 2;
+				Entry e;
+
+				if (!read(mid, e)) {
+					overwritten = true;
+					break;
+				}
+
+				if (e.stamp <= stamp_ns) {
+					lo = mid;
+					e_lo = e;
+				}
+				else {
+					hi = mid;
+					e_hi = e;
+				}
+			}
+
+			if (overwritten)
+				continue;
+
+			before = e_lo.value;
+			after = e_hi.value;
+			ratio = double(stamp_ns - e_lo.stamp) / double(e_hi.stamp - e_lo.stamp);
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	struct Entry {
+		uint64_t seq;		//!< number of sample since creation
+		uint64_t stamp;
+		T value;
+	};
+
+	std::unique_ptr<SeqLock<Entry>[]> slots;
+	const size_t capacity_;
+	std::atomic<uint64_t> written;
+
+	std::mutex write_mutex;
+	uint64_t last_stamp;
+
+	//! Load sample @a seq, false if slot already reused
+	inline bool read(uint64_t seq, Entry &e) const {
+		e = slots[seq % capacity_].load();
+		return e.seq == seq;
+	}
+};
+}	// namespace mavros
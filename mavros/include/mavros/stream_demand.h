@@ -0,0 +1,203 @@
+/**
+ * @brief FCU stream rates driven by topic subscribers
+ * @file stream_demand.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+namespace mavros {
+/**
+ * @brief Chooses SET_MESSAGE_INTERVAL of each stream from live subscriber counts
+ *
+ * Plugins declare which msgid feeds which topic and rate it needs
+ * while topic has subscribers. Stream rate is highest rate of its
+ * subscribed topics, or idle rate if none has subscribers.
+ *
+ * Rate values, same as set_message_interval service:
+ * > 0 - Hz, 0 - FCU default rate, < 0 - stream disabled.
+ *
+ * Stream is managed only after its message was received once,
+ * so demand never turns on message FCU does not send on its own
+ * (e.g. RAW_IMU of PX4, which sends HIGHRES_IMU).
+ */
+class StreamDemand {
+public:
+	//! subscriber count of topic
+	using SubscribersFn = std::function<uint32_t()>;
+	//! rate of topic @a key, given plugin default
+	using RateLookupFn = std::function<double(const std::string &key, double default_rate)>;
+
+	//! Rate value of FCU default rate
+	static constexpr double RATE_DEFAULT = 0.0;
+	//! Rate value of disabled stream
+	static constexpr double RATE_DISABLED = -1.0;
+
+	//! Managed message stream
+	class Stream {
+	public:
+		//! mark message received, call from handler
+		inline void seen() {
+			if (!seen_.load(std::memory_order_relaxed))
+				seen_.store(true, std::memory_order_relaxed);
+		}
+
+	private:
+		friend class StreamDemand;
+
+		struct Topic {
+			std::string key;
+			SubscribersFn subscribers;
+			double rate;
+		};
+
+		std::atomic<bool> seen_ { false };
+		std::vector<Topic> topics;	//!< guarded by StreamDemand::mutex
+		double sent_rate = 0.0;
+		bool sent = false;
+	};
+
+	//! Interval change to send
+	struct Request {
+		uint32_t msgid;
+		double rate;		//!< see class notes
+		float interval_us;	//!< SET_MESSAGE_INTERVAL param2
+	};
+
+	StreamDemand() :
+		enabled(false),
+		period(1.0),
+		idle_rate(RATE_DISABLED)
+	{ }
+
+	StreamDemand(const StreamDemand&) = delete;
+	StreamDemand &operator=(const StreamDemand&) = delete;
+
+	/**
+	 * @brief Setup by node, before plugins declare streams
+	 *
+	 * @param enable     manage rates, otherwise update() never called
+	 * @param period_    subscriber check period [s]
+	 * @param idle_rate_ rate of stream without subscribers
+	 * @param lookup     topic rate override, nullptr - declared rates
+	 */
+	void configure(bool enable, double period_, double idle_rate_, RateLookupFn lookup)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		enabled = enable;
+		period = period_;
+		idle_rate = idle_rate_;
+		rate_lookup = lookup;
+	}
+
+	inline bool is_enabled() const {
+		return enabled;
+	}
+
+	//! subscriber check period [s]
+	inline double get_period() const {
+		return period;
+	}
+
+	/**
+	 * @brief Declare that @a msgid feeds topic @a key
+	 *
+	 * @param msgid        message id
+	 * @param key          topic name relative to plugin node, e.g. "imu/data_raw", key of rate override
+	 * @param subscribers  returns subscriber count, called from update()
+	 * @param rate         rate needed while topic has subscribers
+	 * @return stream of @a msgid, same object for all its topics, lives as long as this
+	 */
+	Stream *declare(uint32_t msgid, const std::string &key, SubscribersFn subscribers, double rate)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (rate_lookup)
+			rate = rate_lookup(key, rate);
+
+		auto &stream = streams[msgid];
+		if (!stream)
+			stream.reset(new Stream());
+
+		stream->topics.push_back(Stream::Topic { key, subscribers, rate });
+		return stream.get();
+	}
+
+	/**
+	 * @brief Compute interval changes
+	 *
+	 * @param force  return all managed streams, e.g. after FCU (re)connected
+	 * @return streams which rate differs from last returned one
+	 */
+	std::vector<Request> update(bool force = false)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Request> changes;
+
+		for (auto &p : streams) {
+			auto &stream = *p.second;
+			if (!stream.seen_.load(std::memory_order_relaxed))
+				continue;
+
+			double rate = idle_rate;
+			bool demand = false;
+			for (auto &topic : stream.topics) {
+				if (topic.subscribers() == 0)
+					continue;
+
+				// any explicit rate beats FCU default, which beats disabled
+				rate = (demand) ? std::max(rate, topic.rate) : topic.rate;
+				demand = true;
+			}
+
+			if (!force && stream.sent && rate == stream.sent_rate)
+				continue;
+
+			stream.sent = true;
+			stream.sent_rate = rate;
+			changes.push_back(Request { p.first, rate, interval_us(rate) });
+		}
+
+		return changes;
+	}
+
+	//! SET_MESSAGE_INTERVAL interval of rate
+	static float interval_us(double rate)
+	{
+		if (rate < 0.0)
+			return -1.0f;
+		else if (rate == 0.0)
+			return 0.0f;
+		else
+			return 1e6 / rate;
+	}
+
+private:
+	std::mutex mutex;
+	std::atomic<bool> enabled;
+	double period;
+	double idle_rate;
+	RateLookupFn rate_lookup;
+	std::map<uint32_t, std::unique_ptr<Stream> > streams;
+};
+}	// namespace mavros
@@ -0,0 +1,223 @@
+/**
+ * @brief Per message id arrival statistics
+ * @file stream_stats.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace mavros {
+/**
+ * @brief Rate, jitter and loss of each received message id
+ *
+ * Fixed open addressing table of msgids, each slot keeps ring of
+ * last @a WINDOW arrival times. Rate and interval jitter computed
+ * over that window by reader, so tick() costs table probe and few stores.
+ *
+ * Loss estimated from gaps: interval of k average periods means k-1
+ * messages missed. That suits periodic streams only.
+ *
+ * @note tick() of one msgid should be called from one thread at time
+ *       (true for msgid dispatch), different msgids may be ticked concurrently.
+ *       get_stats() does not lock and may run in any thread, its result is approximate.
+ */
+class StreamStats {
+public:
+	//! Max tracked msgids
+	static constexpr size_t TABLE_SIZE = 256;
+	//! Arrivals kept per msgid
+	static constexpr size_t WINDOW = 32;
+	//! Intervals seen before gaps counted as loss
+	static constexpr uint64_t LOSS_MIN_SAMPLES = 8;
+
+	struct Stat {
+		uint32_t msgid;
+		uint64_t count;		//!< received since start
+		uint64_t lost;		//!< estimated missed
+		double rate;		//!< Hz
+		double jitter;		//!< interval standard deviation [s]
+		double age;		//!< since last arrival [s]
+	};
+
+	StreamStats() :
+		overflow_(0)
+	{
+		for (auto &slot : slots) {
+			slot.msgid.store(EMPTY, std::memory_order_relaxed);
+			slot.count.store(0, std::memory_order_relaxed);
+			slot.lost.store(0, std::memory_order_relaxed);
+			slot.avg_interval_ns.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	StreamStats(const StreamStats&) = delete;
+	StreamStats &operator=(const StreamStats&) = delete;
+
+	//! Record arrival at @a stamp_ns
+	void tick(uint32_t msgid, uint64_t stamp_ns)
+	{
+		auto slot = find_slot(msgid, true);
+		if (!slot) {
+			overflow_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		const uint64_t n = slot->count.load(std::memory_order_relaxed);
+		if (n > 0) {
+			const uint64_t prev = slot->stamps[(n - 1) % WINDOW].load(std::memory_order_relaxed);
+			if (stamp_ns > prev)
+				update_interval(*slot, stamp_ns - prev, n);
+		}
+
+		slot->stamps[n % WINDOW].store(stamp_ns, std::memory_order_relaxed);
+		slot->count.store(n + 1, std::memory_order_release);
+	}
+
+	//! Statistics of all seen msgids, ordered by msgid
+	std::vector<Stat> get_stats(uint64_t now_ns) const
+	{
+		std::vector<Stat> ret;
+
+		for (auto &slot : slots) {
+			const uint32_t msgid = slot.msgid.load(std::memory_order_acquire);
+			if (msgid == EMPTY)
+				continue;
+
+			ret.push_back(make_stat(slot, msgid, now_ns));
+		}
+
+		std::sort(ret.begin(), ret.end(), [](const Stat &a, const Stat &b) {
+				return a.msgid < b.msgid;
+			});
+		return ret;
+	}
+
+	//! Arrivals not counted because table is full
+	inline size_t overflow() const {
+		return overflow_.load(std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr uint32_t EMPTY = UINT32_MAX;
+
+	struct Slot {
+		std::atomic<uint32_t> msgid;
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> lost;
+		std::atomic<uint64_t> avg_interval_ns;	//!< EWMA, reference period of loss detection
+		std::array<std::atomic<uint64_t>, WINDOW> stamps;
+	};
+
+	std::array<Slot, TABLE_SIZE> slots;
+	std::atomic<size_t> overflow_;
+
+	Slot *find_slot(uint32_t msgid, bool insert)
+	{
+		// MAVLink v1 ids are dense, Fibonacci hash spreads v2 ones
+		const size_t start = (msgid * 2654435769U) >> 24;
+
+		for (size_t i = 0; i < TABLE_SIZE; i++) {
+			auto &slot = slots[(start + i) % TABLE_SIZE];
+			uint32_t id = slot.msgid.load(std::memory_order_acquire);
+
+			if (id == msgid)
+				return &slot;
+
+			if (id == EMPTY) {
+				if (!insert)
+					return nullptr;
+
+				// other msgid may claim that slot at same time
+				if (slot.msgid.compare_exchange_strong(id, msgid, std::memory_order_acq_rel) || id == msgid)
+					return &slot;
+			}
+		}
+
+		return nullptr;
+	}
+
+	static void update_interval(Slot &slot, uint64_t dt, uint64_t n)
+	{
+		int64_t avg = slot.avg_interval_ns.load(std::memory_order_relaxed);
+		if (avg == 0) {
+			slot.avg_interval_ns.store(dt, std::memory_order_relaxed);
+			return;
+		}
+
+		if (n > LOSS_MIN_SAMPLES && dt > uint64_t(avg) * 3 / 2) {
+			const uint64_t missed = (dt + avg / 2) / avg - 1;
+			slot.lost.store(slot.lost.load(std::memory_order_relaxed) + missed, std::memory_order_relaxed);
+		}
+
+		// gaps clipped: they should not skew reference period
+		const int64_t sample = std::min<int64_t>(dt, 2 * avg);
+		avg += (sample - avg) / 8;
+		slot.avg_interval_ns.store(std::max<int64_t>(avg, 1), std::memory_order_relaxed);
+	}
+
+	static Stat make_stat(const Slot &slot, uint32_t msgid, uint64_t now_ns)
+	{
+		Stat st{};
+		st.msgid = msgid;
+		st.count = slot.count.load(std::memory_order_acquire);
+		st.lost = slot.lost.load(std::memory_order_relaxed);
+
+		const size_t k = std::min<uint64_t>(st.count, WINDOW);
+		if (k == 0)
+			return st;
+
+		const uint64_t first = slot.stamps[(st.count - k) % WINDOW].load(std::memory_order_relaxed);
+		const uint64_t last = slot.stamps[(st.count - 1) % WINDOW].load(std::memory_order_relaxed);
+		st.age = (now_ns > last) ? (now_ns - last) * 1e-9 : 0.0;
+
+		if (k < 2 || last <= first)
+			return st;
+
+		double sum = 0.0, sum_sq = 0.0;
+		size_t intervals = 0;
+		uint64_t prev = first;
+		for (size_t i = 1; i < k; i++) {
+			const uint64_t t = slot.stamps[(st.count - k + i) % WINDOW].load(std::memory_order_relaxed);
+			if (t <= prev) {
+				// overwritten meanwhile or clock step
+				prev = t;
+				continue;
+			}
+
+			const double dt = (t - prev) * 1e-9;
+			sum += dt;
+			sum_sq += dt * dt;
+			intervals++;
+			prev = t;
+		}
+
+		if (intervals == 0)
+			return st;
+
+		const double mean = sum / intervals;
+		st.jitter = std::sqrt(std::max(0.0, sum_sq / intervals - mean * mean));
+
+		// stopped stream: rate decays instead of keeping last value
+		const double span = (last - first) * 1e-9;
+		st.rate = (k - 1) / ((st.age > 2 * mean) ? span + st.age : span);
+		return st;
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,95 @@
+/**
+ * @brief TF broadcast aggregator
+ * @file tf_aggregator.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ros/ros.h>
+#include <tf2_ros/transform_broadcaster.h>
+#include <geometry_msgs/TransformStamped.h>
+
+namespace mavros {
+/**
+ * @brief Collects transforms of plugins and broadcasts them together
+ *
+ * Transforms queued by send() are published by timer as one
+ * tf2_msgs/TFMessage. Until next flush only latest transform
+ * of each child frame kept.
+ *
+ * Child frame may have max publish rate, its transform stays queued
+ * until period since last publish elapsed, so latest one is sent.
+ *
+ * Before start() send() broadcasts immediately.
+ *
+ * @note send() may be called from several threads.
+ */
+class TfAggregator
+{
+public:
+	struct Stat {
+		size_t published;	//!< transforms broadcasted
+		size_t coalesced;	//!< replaced by newer one before flush
+		size_t messages;	//!< TFMessages broadcasted
+	};
+
+	explicit TfAggregator(tf2_ros::TransformBroadcaster &broadcaster);
+
+	/**
+	 * @brief Start flush timer
+	 *
+	 * @param[in] nh       node handle of timer
+	 * @param[in] rate_hz  flush rate, 0 - no batching (broadcast on send())
+	 */
+	void start(ros::NodeHandle &nh, double rate_hz);
+
+	//! Queue transform (or broadcast it if not started)
+	void send(const geometry_msgs::TransformStamped &transform);
+
+	//! Max publish rate of @a child_frame_id, 0 - use default
+	void set_max_rate(const std::string &child_frame_id, double rate_hz);
+
+	//! Max publish rate of frames without own limit, 0 - unlimited
+	void set_default_max_rate(double rate_hz);
+
+	//! Publish queued transforms now
+	void flush();
+
+	Stat get_stat();
+
+private:
+	struct Frame {
+		geometry_msgs::TransformStamped transform;
+		bool pending;
+		ros::Duration min_period;	//!< own limit, zero - default
+		ros::Time last_published;
+	};
+
+	tf2_ros::TransformBroadcaster &broadcaster;
+	ros::Timer flush_timer;
+	bool started;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, Frame> frames;	//!< by child frame id
+	ros::Duration default_min_period;
+	std::vector<geometry_msgs::TransformStamped> out;	//!< reused by flush()
+	Stat stat;
+
+	static ros::Duration period_from_rate(double rate_hz);
+};
+}	// namespace mavros
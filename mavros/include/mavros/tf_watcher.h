@@ -0,0 +1,108 @@
+/**
+ * @brief Shared TF listener
+ * @file tf_watcher.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+#include <geometry_msgs/TransformStamped.h>
+
+namespace mavros {
+/**
+ * @brief Calls plugin callbacks when watched transforms update
+ *
+ * One thread for all watches. It sleeps until tf2 buffer reports
+ * new transforms, then looks up watches whose rate limit period
+ * elapsed and calls callback if transform is newer than last delivered.
+ *
+ * Static only chain (stamp 0) never updates, it is redelivered
+ * at rate limit, as fixed rate polling did (10 Hz if not limited).
+ *
+ * @note Callbacks run in watcher thread, they should not call remove().
+ */
+class TfWatcher
+{
+public:
+	using Callback = std::function<void (const geometry_msgs::TransformStamped &)>;
+
+	explicit TfWatcher(tf2_ros::Buffer &buffer);
+	~TfWatcher();
+
+	TfWatcher(const TfWatcher&) = delete;
+	TfWatcher &operator=(const TfWatcher&) = delete;
+
+	/**
+	 * @brief Watch transform @a frame_id -> @a child_frame_id
+	 *
+	 * @param[in] name        user name for log messages
+	 * @param[in] rate_limit  max callback rate [Hz], 0 - not limited
+	 * @return watch id
+	 */
+	size_t add(const std::string &name, const std::string &frame_id, const std::string &child_frame_id,
+			double rate_limit, Callback cb);
+
+	//! Stop watch, callback in progress finishes before return
+	void remove(size_t id);
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Watch {
+		size_t id;
+		std::string name;
+		std::string frame_id;
+		std::string child_frame_id;
+		clock::duration period;
+		Callback cb;
+
+		// guarded by mutex
+		bool pending;
+		bool removed;
+		clock::time_point next_due;
+
+		// watcher thread only
+		ros::Time last_stamp;
+	};
+
+	using WatchPtr = std::shared_ptr<Watch>;
+
+	tf2_ros::Buffer &buffer;
+	boost::signals2::connection changed_conn;
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<WatchPtr> watches;
+	size_t last_id;
+	bool stop;
+	std::thread thread;
+
+	//! held while callbacks run
+	std::mutex cb_mutex;
+
+	void transforms_changed();
+	void run();
+	//! @return true if should be retried at rate limit (static transform)
+	bool deliver(Watch &w);
+};
+}	// namespace mavros
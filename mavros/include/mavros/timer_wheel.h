@@ -0,0 +1,187 @@
+/**
+ * @brief Hierarchical timer wheel
+ * @file timer_wheel.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <condition_variable>
+
+namespace mavros {
+/**
+ * @brief Timers of protocol timeouts and periodic sends, served by own thread
+ *
+ * Four levels of 64 slots: 1 ms tick covers 64 ms, 4 s, 4.4 min and 4.6 h,
+ * longer delays wait in last level until in range.
+ * Timer arm and cancel are O(1): timer is intrusive list node of its slot.
+ * Thread sleeps until next non-empty slot, found by per level bitmaps.
+ *
+ * Periodic timers keep their phase: next expiry is previous expiry plus period.
+ *
+ * Callbacks run on wheel thread without wheel lock: they may arm and cancel
+ * timers, but should be short and must not throw.
+ */
+class TimerWheel {
+public:
+	using Clock = std::chrono::steady_clock;
+	using Callback = std::function<void()>;
+
+	static constexpr size_t LEVELS = 4;
+	static constexpr size_t SLOT_BITS = 6;
+	static constexpr size_t SLOTS = 1 << SLOT_BITS;
+
+	/**
+	 * @brief Timer owned by user, bound to one wheel
+	 *
+	 * Destructor cancels timer and waits for running callback,
+	 * unless called from that callback.
+	 */
+	class Timer {
+	public:
+		Timer();
+		~Timer();
+
+		Timer(const Timer&) = delete;
+		Timer &operator=(const Timer&) = delete;
+
+		/**
+		 * @brief Bind to @a wheel, stops previous setup
+		 *
+		 * @note not from own callback
+		 *
+		 * @param period    [s]
+		 * @param oneshot   fire once per start()
+		 * @param autostart start() now
+		 */
+		void setup(TimerWheel &wheel, Callback cb, double period, bool oneshot = false, bool autostart = true);
+
+		//! Arm to fire after period, no-op if armed
+		void start();
+
+		/**
+		 * @brief Cancel
+		 *
+		 * Does not wait for running callback, like ros::Timer,
+		 * so may be called with lock which callback takes.
+		 */
+		void stop();
+
+		/**
+		 * @brief Change period [s]
+		 *
+		 * Armed timer is re-armed to fire after new period (as ros::Timer reset).
+		 */
+		void setPeriod(double period);
+
+		//! timer armed
+		bool hasStarted() const;
+
+		//! setup() done and wheel alive
+		bool isValid() const;
+
+	private:
+		friend class TimerWheel;
+
+		TimerWheel *wheel;
+		Callback cb;
+		uint64_t period;	//!< [ticks]
+		bool oneshot;
+
+		// guarded by wheel mutex
+		Timer *prev;
+		Timer *next;
+		size_t slot;		//!< level * SLOTS + index
+		uint64_t expires;	//!< [tick]
+		bool armed;
+	};
+
+	/**
+	 * @param tick  resolution
+	 */
+	explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(1));
+
+	//! Stop thread, unbind all timers
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel &operator=(const TimerWheel&) = delete;
+
+	//! Change resolution, only before start() and timers setup
+	bool set_tick(Clock::duration tick);
+
+	//! Resolution
+	inline Clock::duration get_tick() const {
+		return tick;
+	}
+
+	//! Start thread
+	void start();
+
+	//! Stop and join thread, timers stay armed but do not fire
+	void stop();
+
+	/**
+	 * @brief Fire timers expired by @a now, used by thread
+	 *
+	 * Without start() lets caller drive the wheel, e.g. in tests.
+	 */
+	void advance(Clock::time_point now);
+
+	//! Timers armed
+	size_t armed_count();
+
+private:
+	using lock_guard = std::lock_guard<std::mutex>;
+	using unique_lock = std::unique_lock<std::mutex>;
+
+	std::mutex mutex;
+	std::condition_variable cond;		//!< wakes thread on stop() and earlier arm
+	std::condition_variable cb_done;	//!< wakes Timer::stop() waiting for callback
+	std::thread thread;
+	bool running;
+
+	Clock::duration tick;
+	Clock::time_point epoch;	//!< time of tick 0
+	uint64_t now_tick;		//!< last processed tick
+	size_t armed_;
+
+	std::array<Timer*, LEVELS * SLOTS> slots;
+	std::array<uint64_t, LEVELS> occupied;		//!< bitmap of non-empty slots per level
+	std::unordered_set<Timer*> bound;		//!< all timers set up on this wheel
+
+	Timer *current;			//!< callback running
+	std::thread::id cb_thread;	//!< thread running callbacks
+	uint64_t wake_tick;		//!< tick thread sleeps until
+
+	void run();
+	uint64_t tick_of(Clock::time_point tp) const;
+	uint64_t current_tick() const;
+	uint64_t ticks_of(double sec) const;
+
+	void link(Timer *t);		//!< insert armed t at its expires
+	void unlink(Timer *t);
+	void arm(Timer *t, uint64_t expires);
+	void cancel(unique_lock &lock, Timer *t);
+	void cascade(size_t level);
+	void fire_slot(unique_lock &lock, size_t index);
+	uint64_t next_event() const;	//!< tick of next slot to process, UINT64_MAX - none
+};
+}	// namespace mavros
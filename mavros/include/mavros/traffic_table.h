@@ -0,0 +1,186 @@
+/**
+ * @brief Flat table of traffic keyed by address
+ * @file traffic_table.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace mavros {
+/**
+ * @brief Open addressing table of last report per ICAO address, with expiry
+ *
+ * Linear probing over fixed slot array, sized to power of two.
+ * Expired entries removed by backward shift, so no tombstones
+ * and lookups stay short after traffic leaves.
+ *
+ * @note not thread safe, owner locks.
+ */
+template<typename Value, size_t Capacity = 1024>
+class TrafficTable {
+public:
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity should be power of two");
+
+	//! Entries kept at most, rest of table length keeps probes short
+	static constexpr size_t MAX_ENTRIES = Capacity * 3 / 4;
+
+	struct Entry {
+		uint32_t key;
+		double stamp;		//!< last update [s]
+		Value value;
+	};
+
+	TrafficTable() :
+		size_(0),
+		overflow_(0)
+	{
+		for (auto &s : slots)
+			s.used = false;
+	}
+
+	/**
+	 * @brief Find or insert entry of @a key
+	 *
+	 * @param[out] inserted  true if new entry (its value default constructed)
+	 * @return entry, nullptr if table is full
+	 */
+	Entry *update(uint32_t key, double now, bool &inserted)
+	{
+		inserted = false;
+
+		size_t i = start(key);
+		for (; slots[i].used; i = next(i)) {
+			if (slots[i].entry.key == key) {
+				slots[i].entry.stamp = now;
+				return &slots[i].entry;
+			}
+		}
+
+		if (size_ >= MAX_ENTRIES) {
+			overflow_++;
+			return nullptr;
+		}
+
+		slots[i].used = true;
+		slots[i].entry.key = key;
+		slots[i].entry.stamp = now;
+		slots[i].entry.value = Value();
+		size_++;
+		inserted = true;
+		return &slots[i].entry;
+	}
+
+	//! Entry of @a key, nullptr if absent
+	const Entry *find(uint32_t key) const
+	{
+		for (size_t i = start(key); slots[i].used; i = next(i)) {
+			if (slots[i].entry.key == key)
+				return &slots[i].entry;
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * @brief Remove entries not updated since @a now - @a timeout
+	 * @return removed count
+	 */
+	size_t expire(double now, double timeout)
+	{
+		size_t removed = 0;
+
+		for (size_t i = 0; i < Capacity; ) {
+			if (slots[i].used && now - slots[i].entry.stamp > timeout) {
+				erase(i);
+				removed++;
+				// shifted entry took that slot, check it again.
+				// Entry wrapped from table start may be missed until next call.
+				continue;
+			}
+
+			i++;
+		}
+
+		return removed;
+	}
+
+	//! Call @a f for each entry, order unspecified
+	template<typename F>
+	void for_each(F f) const
+	{
+		for (auto &s : slots) {
+			if (s.used)
+				f(s.entry);
+		}
+	}
+
+	inline size_t size() const {
+		return size_;
+	}
+
+	//! Updates rejected because table is full
+	inline size_t overflow() const {
+		return overflow_;
+	}
+
+private:
+	struct Slot {
+		bool used;
+		Entry entry;
+	};
+
+	std::array<Slot, Capacity> slots;
+	size_t size_;
+	size_t overflow_;
+
+	static constexpr unsigned log2(size_t n) {
+		return (n <= 1) ? 0 : 1 + log2(n / 2);
+	}
+
+	static inline size_t start(uint32_t key) {
+		// ICAO addresses are allocated in national blocks, Fibonacci hash spreads them
+		return uint32_t(key * 2654435769U) >> (32 - log2(Capacity));
+	}
+
+	static inline size_t next(size_t i) {
+		return (i + 1) & (Capacity - 1);
+	}
+
+	//! Backward shift deletion
+	void erase(size_t hole)
+	{
+		slots[hole].used = false;
+		size_--;
+
+		for (size_t i = next(hole); slots[i].used; i = next(i)) {
+			const size_t home = start(slots[i].entry.key);
+
+			// entry can move to hole if hole lies on its probe path: home..i cyclic
+			const bool movable = (hole <= i) ?
+					(home <= hole || home > i) :
+					(home <= hole && home > i);
+			if (!movable)
+				continue;
+
+			slots[hole].used = true;
+			slots[hole].entry = slots[i].entry;
+			slots[i].used = false;
+			hole = i;
+		}
+	}
+};
+}	// namespace mavros
@@ -0,0 +1,215 @@
+/**
+ * @brief Uniform resampling of trajectory points
+ * @file trajectory_sampler.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Geometry>
+
+namespace mavros {
+/**
+ * @brief Trajectory resampled to fixed rate once, when received
+ *
+ * Points (already in FCU frame) are linearly interpolated, yaw by shortest arc,
+ * into contiguous buffer of samples: sample k belongs to time start_time() + k / get_rate().
+ * So sender only indexes buffer on each tick, whatever point spacing is.
+ *
+ * Sample rate is configured rate, raised up to @a MAX_RATE
+ * when points are denser, so none of them is skipped.
+ * Long trajectory is sampled at lower rate (not below configured one)
+ * to fit @a MAX_SAMPLES.
+ */
+class TrajectorySampler {
+public:
+	//! highest sample rate [Hz]
+	static constexpr double MAX_RATE = 250.0;
+	//! buffer limit, about 20 min at 50 Hz
+	static constexpr size_t MAX_SAMPLES = 1 << 16;
+
+	//! values present in point
+	enum Fields : uint8_t {
+		POSITION = 1 << 0,	//!< position and yaw
+		VELOCITY = 1 << 1,	//!< velocity and yaw rate
+		ACCELERATION = 1 << 2,
+	};
+
+	struct Point {
+		double time = 0.0;	//!< since trajectory start [s]
+		uint8_t fields = 0;	//!< @a Fields
+		Eigen::Vector3d position = Eigen::Vector3d::Zero();
+		Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+		Eigen::Vector3d acceleration = Eigen::Vector3d::Zero();
+		double yaw = 0.0;
+		double yaw_rate = 0.0;
+	};
+
+	TrajectorySampler() :
+		rate(50.0),
+		sample_rate(rate),
+		start_time_(0.0)
+	{ }
+
+	//! Lowest sample rate [Hz], clamped to (0, @a MAX_RATE], used by next resample()
+	void set_rate(double rate_)
+	{
+		if (std::isfinite(rate_) && rate_ > 0.0)
+			rate = std::min(rate_, double(MAX_RATE));
+
+		if (samples_.empty())
+			sample_rate = rate;
+	}
+
+	/**
+	 * @brief Replace samples by @a points resampled
+	 *
+	 * Points going back in time are dropped.
+	 * Fields not present in both ends of segment are held from its start.
+	 *
+	 * @return false if no points or trajectory needs more than @a MAX_SAMPLES at configured rate
+	 */
+	bool resample(const std::vector<Point> &points)
+	{
+		samples_.clear();
+
+		std::vector<const Point*> knots;
+		knots.reserve(points.size());
+		for (auto &p : points) {
+			if (!std::isfinite(p.time) || (!knots.empty() && p.time < knots.back()->time))
+				continue;
+
+			knots.push_back(&p);
+		}
+
+		if (knots.empty())
+			return false;
+
+		start_time_ = knots.front()->time;
+		const double duration = knots.back()->time - start_time_;
+
+		// closest points need own samples
+		double min_dt = duration;
+		for (size_t i = 1; i < knots.size(); i++) {
+			const double dt = knots[i]->time - knots[i - 1]->time;
+			if (dt > 0.0)
+				min_dt = std::min(min_dt, dt);
+		}
+
+		sample_rate = rate;
+		if (min_dt > 0.0)
+			sample_rate = std::min(double(MAX_RATE), std::max(rate, 1.0 / min_dt));
+
+		// checked in double: duration may overflow size_t
+		const double max_span = MAX_SAMPLES - 1;
+		if (duration * sample_rate > max_span)
+			sample_rate = std::max(rate, max_span / duration);
+
+		if (duration * sample_rate > max_span) {
+			sample_rate = rate;
+			return false;
+		}
+
+		const double dt = 1.0 / sample_rate;
+		const size_t n = size_t(std::ceil(duration * sample_rate - 1e-9)) + 1;
+		samples_.reserve(n);
+
+		size_t seg = 0;
+		for (size_t k = 0; k < n; k++) {
+			// last sample is last point exactly
+			const double t = std::min(start_time_ + k * dt, knots.back()->time);
+
+			while (seg + 1 < knots.size() - 1 && knots[seg + 1]->time <= t)
+				seg++;
+
+			if (seg + 1 >= knots.size()) {
+				samples_.push_back(*knots[seg]);
+				samples_.back().time = t;
+				continue;
+			}
+
+			const Point &a = *knots[seg];
+			const Point &b = *knots[seg + 1];
+			const double span = b.time - a.time;
+			const double alpha = (span > 0.0) ? std::min(1.0, std::max(0.0, (t - a.time) / span)) : 1.0;
+
+			samples_.push_back(interpolate(a, b, alpha));
+			samples_.back().time = t;
+		}
+
+		return true;
+	}
+
+	void clear()
+	{
+		samples_.clear();
+	}
+
+	//! Sample rate of current buffer [Hz]
+	double get_rate() const {
+		return sample_rate;
+	}
+
+	//! Time of first sample [s]
+	double start_time() const {
+		return start_time_;
+	}
+
+	const std::vector<Point> &samples() const {
+		return samples_;
+	}
+
+	bool empty() const {
+		return samples_.empty();
+	}
+
+private:
+	double rate;
+	double sample_rate;
+	double start_time_;
+	std::vector<Point> samples_;
+
+	static double wrap_pi(double a)
+	{
+		return std::atan2(std::sin(a), std::cos(a));
+	}
+
+	static Point interpolate(const Point &a, const Point &b, double alpha)
+	{
+		if (alpha >= 1.0)
+			return b;
+
+		Point p = a;
+		const uint8_t both = a.fields & b.fields;
+
+		if (both & POSITION) {
+			p.position = a.position + alpha * (b.position - a.position);
+			p.yaw = wrap_pi(a.yaw + alpha * wrap_pi(b.yaw - a.yaw));
+		}
+
+		if (both & VELOCITY) {
+			p.velocity = a.velocity + alpha * (b.velocity - a.velocity);
+			p.yaw_rate = a.yaw_rate + alpha * (b.yaw_rate - a.yaw_rate);
+		}
+
+		if (both & ACCELERATION)
+			p.acceleration = a.acceleration + alpha * (b.acceleration - a.acceleration);
+
+		return p;
+	}
+};
+}	// namespace mavros
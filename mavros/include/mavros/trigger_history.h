@@ -0,0 +1,106 @@
+/**
+ * @brief Camera trigger history indexed by sequence number
+ * @file trigger_history.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace mavros {
+/**
+ * @brief Last @a Capacity camera triggers, slot is seq modulo capacity
+ *
+ * Lookup by frame seq is one slot check, no search.
+ * Trigger seq going back (FCU reboot, trigger restart) clears history,
+ * repeated seq (resent trigger) is ignored, first stamp kept.
+ *
+ * @note not thread safe, owner locks.
+ */
+template<size_t Capacity = 64>
+class TriggerHistory {
+public:
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity should be power of two");
+
+	TriggerHistory()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (auto &s : slots)
+			s.used = false;
+		newest_ = 0;
+		empty_ = true;
+	}
+
+	//! Store trigger @a seq fired at @a stamp_ns
+	void add(uint32_t seq, uint64_t stamp_ns)
+	{
+		if (!empty_ && seq == newest_)
+			return;
+		if (!empty_ && seq < newest_)
+			clear();
+
+		auto &s = slots[seq & (Capacity - 1)];
+		s.used = true;
+		s.seq = seq;
+		s.stamp_ns = stamp_ns;
+		newest_ = seq;
+		empty_ = false;
+	}
+
+	/**
+	 * @brief Stamp of trigger @a seq
+	 * @return false if that trigger not received or already overwritten
+	 */
+	bool find(uint32_t seq, uint64_t &stamp_ns) const
+	{
+		auto &s = slots[seq & (Capacity - 1)];
+		if (!s.used || s.seq != seq)
+			return false;
+
+		stamp_ns = s.stamp_ns;
+		return true;
+	}
+
+	//! true if trigger @a seq can not arrive anymore (newer received)
+	inline bool passed(uint32_t seq) const {
+		return !empty_ && seq < newest_;
+	}
+
+	inline bool empty() const {
+		return empty_;
+	}
+
+	//! Seq of last trigger
+	inline uint32_t newest() const {
+		return newest_;
+	}
+
+private:
+	struct Slot {
+		bool used;
+		uint32_t seq;
+		uint64_t stamp_ns;
+	};
+
+	std::array<Slot, Capacity> slots;
+	uint32_t newest_;
+	bool empty_;
+};
+}	// namespace mavros
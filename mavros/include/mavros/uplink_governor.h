@@ -0,0 +1,152 @@
+/**
+ * @brief Rate governor and covariance cache of estimate uplinks
+ * @file uplink_governor.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace mavros {
+/**
+ * @brief Decimates estimate stream to rate FCU estimator fuses
+ *
+ * Decision made on data stamps, so input jitter does not alias:
+ * sample passes when at least 0.9 period passed since last sent one.
+ * Stamp going back (estimator reset, bag loop) always passes.
+ */
+class UplinkGovernor {
+public:
+	UplinkGovernor() :
+		min_interval_ns(0),
+		last_ns(0),
+		dropped_(0)
+	{ }
+
+	//! Max rate [Hz], 0 - no limit
+	void set_rate(double rate_hz)
+	{
+		min_interval_ns = (rate_hz > 0.0) ? uint64_t(0.9e9 / rate_hz) : 0;
+	}
+
+	//! @return true if sample of @a stamp_ns should be sent
+	bool pass(uint64_t stamp_ns)
+	{
+		if (min_interval_ns != 0 && last_ns != 0 &&
+				stamp_ns >= last_ns && stamp_ns - last_ns < min_interval_ns) {
+			dropped_++;
+			return false;
+		}
+
+		last_ns = stamp_ns;
+		return true;
+	}
+
+	//! Samples not sent
+	inline size_t dropped() const {
+		return dropped_;
+	}
+
+private:
+	uint64_t min_interval_ns;
+	uint64_t last_ns;
+	size_t dropped_;
+};
+
+/**
+ * @brief Cache of converted covariance
+ *
+ * Keeps last input (ROS row major N x N) and its MAVLink form
+ * (frame transform and URT packing done by caller supplied function).
+ * Conversion repeats only when some element changed more than
+ * relative tolerance, which is usual case for VIO keeping
+ * same covariance for many frames.
+ */
+template<size_t N, size_t OUT>
+class CovarianceCache {
+public:
+	using Input = std::array<double, N * N>;
+	using Output = std::array<float, OUT>;
+
+	CovarianceCache() :
+		tolerance(0.0),
+		valid(false),
+		hits_(0)
+	{ }
+
+	//! Relative change treated as same covariance, 0 - exact
+	void set_tolerance(double rel) {
+		tolerance = rel;
+	}
+
+	//! Force next get() to convert (e.g. frame transform changed)
+	void invalidate() {
+		valid = false;
+	}
+
+	/**
+	 * @brief Converted covariance of @a cov
+	 *
+	 * @param cov      N * N elements container (std::array, boost::array)
+	 * @param convert  void (const T &cov, Output &out)
+	 */
+	template<typename T, typename F>
+	const Output &get(const T &cov, F convert)
+	{
+		static_assert(sizeof(cov) == sizeof(Input), "covariance size");
+
+		if (valid && same(cov)) {
+			hits_++;
+			return output;
+		}
+
+		std::copy(cov.begin(), cov.end(), input.begin());
+		convert(cov, output);
+		valid = true;
+		return output;
+	}
+
+	//! Conversions skipped
+	inline size_t hits() const {
+		return hits_;
+	}
+
+private:
+	double tolerance;
+	bool valid;
+	size_t hits_;
+	Input input;
+	Output output;
+
+	template<typename T>
+	bool same(const T &cov) const
+	{
+		for (size_t i = 0; i < input.size(); i++) {
+			// unknown covariance (NaN) stays same, NaN on one side is a change
+			if (std::isnan(cov[i]) && std::isnan(input[i]))
+				continue;
+
+			const double d = std::abs(cov[i] - input[i]);
+			if (!(d <= tolerance * std::max(std::abs(cov[i]), std::abs(input[i]))))
+				return false;
+		}
+
+		return true;
+	}
+};
+}	// namespace mavros
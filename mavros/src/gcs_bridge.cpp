@@ -16,6 +16,8 @@
 
 #include <mavros/utils.h>
 #include <mavros/mavlink_diag.h>
+#include <mavros/mavlink_batch.h>
+#include <mavros/message_pool.h>
 #include <mavconn/interface.h>
 
 using namespace mavros;
@@ -23,6 +25,8 @@ using namespace mavconn;
 
 ros::Publisher mavlink_pub;
 ros::Subscriber mavlink_sub;
+MavlinkBatcher mavlink_batch_pub;
+MessagePool<mavros_msgs::MavlinkRaw> mavlink_raw_pool;
 MAVConnInterface::Ptr gcs_link;
 
 
@@ -45,6 +49,33 @@ void mavlink_sub_cb(const mavros_msgs::Mavlink::ConstPtr &rmsg)
 		ROS_ERROR("Packet drop: convert error.");
 }
 
+void mavlink_raw_pub_cb(const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing)
+{
+	auto rmsg = mavlink_raw_pool.acquire();
+
+	rmsg->header.stamp = ros::Time::now();
+	mavros_msgs::mavlink::convert(*mmsg, *rmsg, mavros::utils::enum_value(framing));
+	mavlink_pub.publish(rmsg);
+}
+
+void mavlink_raw_sub_cb(const mavros_msgs::MavlinkRaw::ConstPtr &rmsg)
+{
+	if (mavros_msgs::mavlink::is_valid(*rmsg))
+		gcs_link->send_bytes(rmsg->data.data(), rmsg->data.size());	// queue exception, same as mavlink_sub_cb()
+	else
+		ROS_ERROR("Packet drop: bad raw frame.");
+}
+
+void mavlink_batch_sub_cb(const mavros_msgs::MavlinkBatch::ConstPtr &batch)
+{
+	auto errors = unpack_batch(*batch, [](const mavlink::mavlink_message_t *mmsg) {
+				gcs_link->send_message(mmsg);
+			});
+
+	if (errors)
+		ROS_ERROR("Packet drop: %zu convert error(s) in batch.", errors);
+}
+
 int main(int argc, char *argv[])
 {
 	ros::init(argc, argv, "gcs_bridge");
@@ -54,7 +85,13 @@ int main(int argc, char *argv[])
 	mavros::MavlinkDiag gcs_link_diag("GCS bridge");
 
 	std::string gcs_url;
+	bool raw;
+	int batch_size;
+	double batch_timeout;
 	priv_nh.param<std::string>("gcs_url", gcs_url, "udp://@");
+	priv_nh.param("raw", raw, false);
+	priv_nh.param("batch/size", batch_size, 0);
+	priv_nh.param("batch/timeout", batch_timeout, 0.01);
 
 	try {
 		gcs_link = MAVConnInterface::open_url(gcs_url);
@@ -66,14 +103,35 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	mavlink_pub = mavlink_nh.advertise<mavros_msgs::Mavlink>("to", 10);
-	gcs_link->message_received_cb = mavlink_pub_cb;
+	if (raw) {
+		// verbatim frames, no payload repacking
+		mavlink_pub = mavlink_nh.advertise<mavros_msgs::MavlinkRaw>("to_raw", 10);
+		gcs_link->message_received_cb = mavlink_raw_pub_cb;
 
-	// prefer UDPROS, but allow TCPROS too
-	mavlink_sub = mavlink_nh.subscribe("from", 10, mavlink_sub_cb,
-		ros::TransportHints()
-			.unreliable().maxDatagramSize(1024)
-			.reliable());
+		mavlink_sub = mavlink_nh.subscribe("from_raw", 10, mavlink_raw_sub_cb,
+			ros::TransportHints()
+				.unreliable().maxDatagramSize(1024)
+				.reliable());
+	}
+	else if (batch_size > 0) {
+		// batched bridge topics, used to reduce per frame ROS overhead
+		mavlink_batch_pub.advertise(mavlink_nh, "to_batch", batch_size, ros::Duration(batch_timeout));
+		gcs_link->message_received_cb = [](const mavlink::mavlink_message_t *mmsg, const mavconn::Framing framing) {
+			mavlink_batch_pub.push(mmsg, framing);
+		};
+
+		mavlink_sub = mavlink_nh.subscribe("from_batch", 10, mavlink_batch_sub_cb);
+	}
+	else {
+		mavlink_pub = mavlink_nh.advertise<mavros_msgs::Mavlink>("to", 10);
+		gcs_link->message_received_cb = mavlink_pub_cb;
+
+		// prefer UDPROS, but allow TCPROS too
+		mavlink_sub = mavlink_nh.subscribe("from", 10, mavlink_sub_cb,
+			ros::TransportHints()
+				.unreliable().maxDatagramSize(1024)
+				.reliable());
+	}
 
 	// setup updater
 	updater.setHardwareID(gcs_url);
@@ -0,0 +1,130 @@
+/**
+ * @brief Lazy diagnostic updater
+ * @file diag_updater.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/diag_updater.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <mavros_msgs/DiagnosticCompact.h>
+
+using namespace mavros;
+using diagnostic_updater::DiagnosticStatusWrapper;
+
+//! status filled by DiagUpdater::force_update() on this thread
+static thread_local const DiagnosticStatusWrapper *running_status = nullptr;
+static thread_local std::vector<double> *running_status_values = nullptr;
+static thread_local bool running_status_quiet = false;
+
+DiagUpdater::DiagUpdater() :
+	nh(),
+	private_nh("~"),
+	num_subscribers(std::make_shared<std::atomic<int>>(0)),
+	period(1.0)
+{
+	double period_s;
+	private_nh.param("diagnostic_period", period_s, 1.0);
+	period = ros::Duration(period_s);
+
+	name_prefix = ros::this_node::getName().substr(1) + ": ";
+
+	// callbacks may outlive this object, so counter is shared with them
+	auto cnt = num_subscribers;
+	auto connect_cb = [cnt](const ros::SingleSubscriberPublisher &) { cnt->fetch_add(1, std::memory_order_relaxed); };
+	auto disconnect_cb = [cnt](const ros::SingleSubscriberPublisher &) { cnt->fetch_sub(1, std::memory_order_relaxed); };
+
+	diag_pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1, connect_cb, disconnect_cb);
+	compact_pub = private_nh.advertise<mavros_msgs::DiagnosticCompact>("diagnostics_compact", 1, connect_cb, disconnect_cb);
+}
+
+std::vector<double> *DiagUpdater::running_values(const DiagnosticStatusWrapper &stat)
+{
+	return (running_status == &stat) ? running_status_values : nullptr;
+}
+
+bool DiagUpdater::running_quiet(const DiagnosticStatusWrapper &stat)
+{
+	return running_status == &stat && running_status_quiet;
+}
+
+void DiagUpdater::update()
+{
+	if (ros::Time::now() < next_time)
+		return;
+
+	force_update();
+}
+
+void DiagUpdater::force_update()
+{
+	// most setups: nobody listens, tasks run only for their windows and counters
+	const bool quiet = num_subscribers->load(std::memory_order_relaxed) == 0;
+	const bool want_array = diag_pub.getNumSubscribers() > 0;
+	const bool want_compact = compact_pub.getNumSubscribers() > 0;
+	const auto now = ros::Time::now();
+	next_time = now + period;
+
+	{
+		boost::mutex::scoped_lock lock(lock_);	// no adds while tasks run
+		const auto &tasks = getTasks();
+
+		statuses.resize(tasks.size());
+		values.resize(tasks.size());
+
+		for (size_t i = 0; i < tasks.size(); i++) {
+			auto &status = statuses[i];
+
+			status.name.assign(name_prefix).append(tasks[i].getName());
+			status.level = 2;
+			status.message = "No message was set";
+			status.hardware_id = hwid;
+			status.values.clear();
+			values[i].clear();
+
+			running_status = &status;
+			running_status_values = &values[i];
+			running_status_quiet = quiet;
+			tasks[i].run(status);
+			running_status = nullptr;
+			running_status_values = nullptr;
+			running_status_quiet = false;
+		}
+	}
+
+	if (quiet)
+		return;
+
+	if (want_array) {
+		auto array = boost::make_shared<diagnostic_msgs::DiagnosticArray>();
+
+		array->header.stamp = now;
+		array->status.assign(statuses.begin(), statuses.end());
+		diag_pub.publish(array);
+	}
+
+	if (want_compact) {
+		auto compact = boost::make_shared<mavros_msgs::DiagnosticCompact>();
+
+		compact->header.stamp = now;
+		compact->hardware_id = hwid;
+		compact->names.reserve(statuses.size());
+		compact->levels.reserve(statuses.size());
+		compact->value_offsets.reserve(statuses.size());
+
+		for (size_t i = 0; i < statuses.size(); i++) {
+			compact->names.push_back(statuses[i].name);
+			compact->levels.push_back(statuses[i].level);
+			compact->value_offsets.push_back(compact->values.size());
+			compact->values.insert(compact->values.end(), values[i].begin(), values[i].end());
+		}
+
+		compact_pub.publish(compact);
+	}
+}
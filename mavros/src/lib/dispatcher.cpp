@@ -0,0 +1,215 @@
+/**
+ * @brief Message dispatcher class
+ * @file dispatcher.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <ros/console.h>
+#include <mavconn/thread_utils.h>
+#include <mavros/dispatcher.h>
+
+using namespace mavros;
+using mavconn::Framing;
+using mavlink::mavlink_message_t;
+using mavlink::msgid_t;
+
+constexpr size_t Dispatcher::MAX_WORKERS;
+constexpr size_t Dispatcher::DROP_THRESHOLD;
+
+
+Dispatcher::Worker::Worker(size_t queue_size) :
+	queue(queue_size),
+	drop_level(queue.capacity() * DROP_THRESHOLD / 100),
+	waiting(false),
+	dropped(0),
+	overflow(0),
+	last_drop_count(0)
+{ }
+
+Dispatcher::Dispatcher(std::string name) :
+	diagnostic_updater::DiagnosticTask(name),
+	running(false),
+	in_push(false)
+{ }
+
+Dispatcher::~Dispatcher()
+{
+	stop();
+}
+
+void Dispatcher::start(size_t nworkers, size_t queue_size, HandlerCb cb)
+{
+	assert(nworkers > 0 && nworkers <= MAX_WORKERS && workers.empty());
+
+	handler_cb = cb;
+
+	for (size_t i = 0; i < nworkers; i++)
+		workers.emplace_back(new Worker(queue_size));
+
+	running = true;
+
+	// start threads only when vector is complete
+	for (size_t i = 0; i < workers.size(); i++) {
+		auto &w = *workers[i];
+
+		w.thread = std::thread(&Dispatcher::worker_loop, this, std::ref(w), i);
+	}
+
+	ROS_INFO("DISP: %zu dispatch worker(s), queue size %zu, %zu droppable msgid(s)",
+			workers.size(), workers.front()->queue.capacity(), droppable.size());
+}
+
+void Dispatcher::stop()
+{
+	if (!running.exchange(false))
+		return;
+
+	// push() in flight on I/O thread finishes, next one sees !running
+	while (in_push.load())
+		std::this_thread::yield();
+
+	for (auto &w : workers) {
+		{
+			std::lock_guard<std::mutex> lock(w->mutex);
+			w->cond.notify_one();
+		}
+
+		if (w->thread.joinable())
+			w->thread.join();
+	}
+
+	workers.clear();
+}
+
+void Dispatcher::set_droppable(std::vector<msgid_t> msgids)
+{
+	std::sort(msgids.begin(), msgids.end());
+	msgids.erase(std::unique(msgids.begin(), msgids.end()), msgids.end());
+	droppable = std::move(msgids);
+}
+
+bool Dispatcher::is_droppable(msgid_t msgid) const
+{
+	return std::binary_search(droppable.begin(), droppable.end(), msgid);
+}
+
+void Dispatcher::set_route(msgid_t msgid, WorkerMask mask)
+{
+	routes[msgid] = mask;
+}
+
+bool Dispatcher::push(const mavlink_message_t *msg, const Framing framing, uint64_t rx_stamp_ns)
+{
+	// pairs with stop(): either it waits for us or we see !running
+	in_push.store(true);
+	if (!running.load()) {
+		in_push.store(false, std::memory_order_release);
+		return false;
+	}
+
+	bool ret = true;
+	auto it = routes.find(msg->msgid);
+	if (it == routes.end()) {
+		ret = push_to(*workers[msg->msgid % workers.size()], msg, framing, rx_stamp_ns);
+	}
+	else {
+		for (size_t i = 0; i < workers.size(); i++) {
+			if (it->second & (WorkerMask(1) << i))
+				ret = push_to(*workers[i], msg, framing, rx_stamp_ns) && ret;
+		}
+	}
+
+	in_push.store(false, std::memory_order_release);
+	return ret;
+}
+
+bool Dispatcher::push_to(Worker &w, const mavlink_message_t *msg, const Framing framing, uint64_t rx_stamp_ns)
+{
+	if (w.queue.size() >= w.drop_level && is_droppable(msg->msgid)) {
+		w.dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	auto slot = w.queue.alloc();
+	if (slot == nullptr) {
+		w.overflow.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	slot->msg = *msg;
+	slot->framing = framing;
+	slot->rx_stamp_ns = rx_stamp_ns;
+	w.queue.commit();
+
+	// pairs with fence in worker_loop(): either we see waiting flag or worker sees new element
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (w.waiting.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(w.mutex);
+		w.cond.notify_one();
+	}
+
+	return true;
+}
+
+void Dispatcher::worker_loop(Worker &w, size_t idx)
+{
+	mavconn::utils::set_this_thread_name("mavros-disp%zu", idx);
+
+	while (running) {
+		auto item = w.queue.front();
+		if (item == nullptr) {
+			std::unique_lock<std::mutex> lock(w.mutex);
+
+			w.waiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (w.queue.empty() && running)
+				w.cond.wait_for(lock, std::chrono::milliseconds(100));
+
+			w.waiting.store(false, std::memory_order_relaxed);
+			continue;
+		}
+
+		try {
+			handler_cb(&item->msg, item->framing, item->rx_stamp_ns, idx);
+		}
+		catch (std::exception &ex) {
+			ROS_ERROR_NAMED("mavros", "DISP: handler exception for msgid %u: %s", item->msg.msgid, ex.what());
+		}
+
+		w.queue.pop();
+	}
+}
+
+void Dispatcher::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	size_t new_drops = 0;
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		auto &w = *workers[i];
+		auto dropped = w.dropped.load(std::memory_order_relaxed);
+		auto overflow = w.overflow.load(std::memory_order_relaxed);
+
+		stat.addf(mavconn::utils::format("Worker %zu queue:", i), "%zu / %zu (max %zu)",
+				w.queue.size(), w.queue.capacity(), w.queue.high_water_mark());
+		stat.addf(mavconn::utils::format("Worker %zu dropped:", i), "%zu", dropped);
+		stat.addf(mavconn::utils::format("Worker %zu overflow:", i), "%zu", overflow);
+
+		new_drops += dropped + overflow - w.last_drop_count;
+		w.last_drop_count = dropped + overflow;
+	}
+
+	if (workers.empty())
+		stat.summary(0, "disabled, handled in I/O thread");
+	else if (new_drops > 0)
+		stat.summaryf(1, "%zu messages dropped since last report", new_drops);
+	else
+		stat.summary(0, "ok");
+}
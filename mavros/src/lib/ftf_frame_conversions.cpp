@@ -35,41 +35,6 @@ static const auto NED_ENU_Q = quaternion_from_rpy(M_PI, 0.0, M_PI_2);
  */
 static const auto AIRCRAFT_BASELINK_Q = quaternion_from_rpy(M_PI, 0.0, 0.0);
 
-/**
- * @brief Static vector needed for rotating between ENU and NED frames
- * +PI rotation around X (North) axis follwed by +PI/2 rotation about Z (Down)
- * gives the ENU frame.  Similarly, a +PI rotation about X (East) followed by
- * a +PI/2 roation about Z (Up) gives the NED frame.
- */
-static const Eigen::Affine3d NED_ENU_AFFINE(NED_ENU_Q);
-
-/**
- * @brief Static vector needed for rotating between aircraft and base_link frames
- * +PI rotation around X (Forward) axis transforms from Forward, Right, Down (aircraft)
- * Fto Forward, Left, Up (base_link) frames.
- */
-static const Eigen::Affine3d AIRCRAFT_BASELINK_AFFINE(AIRCRAFT_BASELINK_Q);
-
-/**
- * @brief 3-D matrices to fill 6-D rotation matrix applied to change covariance matrices coordinate frames
- */
-static const auto NED_ENU_R = NED_ENU_Q.normalized().toRotationMatrix();
-static const auto AIRCRAFT_BASELINK_R = AIRCRAFT_BASELINK_Q.normalized().toRotationMatrix();
-
-/**
- * @brief Use reflections instead of rotations for NED <-> ENU transformation
- * to avoid NaN/Inf floating point pollution across different axes
- * since in NED <-> ENU the axes are perfectly aligned.
- */
-static const Eigen::PermutationMatrix<3> NED_ENU_REFLECTION_XY(Eigen::Vector3i(1,0,2));
-static const Eigen::DiagonalMatrix<double,3> NED_ENU_REFLECTION_Z(1,1,-1);
-
-/**
- * @brief Auxiliar matrices to Covariance transforms
- */
-using Matrix6d = Eigen::Matrix<double, 6, 6>;
-using Matrix9d = Eigen::Matrix<double, 9, 9>;
-
 
 Eigen::Quaterniond transform_orientation(const Eigen::Quaterniond &q, const StaticTF transform)
 {
@@ -88,101 +53,49 @@ Eigen::Quaterniond transform_orientation(const Eigen::Quaterniond &q, const Stat
 }
 
 
-Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec, const StaticTF transform)
+/**
+ * @brief Runtime dispatch to compile time covariance kernels
+ */
+template<size_t N>
+static boost::array<double, N> transform_static_covariance(const boost::array<double, N> &cov, const StaticTF transform)
 {
 	switch (transform) {
 	case StaticTF::NED_TO_ENU:
 	case StaticTF::ENU_TO_NED:
-		return NED_ENU_REFLECTION_XY * (NED_ENU_REFLECTION_Z * vec);
+		return transform_static_frame<StaticTF::NED_TO_ENU>(cov);
 
 	case StaticTF::AIRCRAFT_TO_BASELINK:
 	case StaticTF::BASELINK_TO_AIRCRAFT:
-		return AIRCRAFT_BASELINK_AFFINE * vec;
+		return transform_static_frame<StaticTF::AIRCRAFT_TO_BASELINK>(cov);
 	}
 }
 
-Covariance3d transform_static_frame(const Covariance3d &cov, const StaticTF transform)
+Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec, const StaticTF transform)
 {
-	Covariance3d cov_out_;
-	EigenMapConstCovariance3d cov_in(cov.data());
-	EigenMapCovariance3d cov_out(cov_out_.data());
-
 	switch (transform) {
 	case StaticTF::NED_TO_ENU:
 	case StaticTF::ENU_TO_NED:
-		cov_out = NED_ENU_REFLECTION_XY * (NED_ENU_REFLECTION_Z * cov_in * NED_ENU_REFLECTION_Z) *
-		          NED_ENU_REFLECTION_XY.transpose();
-		return cov_out_;
+		return transform_static_frame<StaticTF::NED_TO_ENU>(vec);
 
 	case StaticTF::AIRCRAFT_TO_BASELINK:
 	case StaticTF::BASELINK_TO_AIRCRAFT:
-		cov_out = cov_in * AIRCRAFT_BASELINK_Q;
-		return cov_out_;
+		return transform_static_frame<StaticTF::AIRCRAFT_TO_BASELINK>(vec);
 	}
 }
 
-Covariance6d transform_static_frame(const Covariance6d &cov, const StaticTF transform)
+Covariance3d transform_static_frame(const Covariance3d &cov, const StaticTF transform)
 {
-	Covariance6d cov_out_;
-	Matrix6d R = Matrix6d::Zero();	// not `auto` because Zero ret is const
-
-	EigenMapConstCovariance6d cov_in(cov.data());
-	EigenMapCovariance6d cov_out(cov_out_.data());
-
-	switch (transform) {
-	case StaticTF::NED_TO_ENU:
-	case StaticTF::ENU_TO_NED:
-	{
-		Eigen::PermutationMatrix<6> NED_ENU_REFLECTION_XY_6 (NED_ENU_REFLECTION_XY.indices().replicate<2,1>());
-		NED_ENU_REFLECTION_XY_6.indices().middleRows<3>(3).array() += 3;
-		Eigen::DiagonalMatrix<double,6> NED_ENU_REFLECTION_Z_6(NED_ENU_REFLECTION_Z.diagonal().replicate<2,1>());
-
-		cov_out = NED_ENU_REFLECTION_XY_6 * (NED_ENU_REFLECTION_Z_6 * cov_in * NED_ENU_REFLECTION_Z_6) *
-		          NED_ENU_REFLECTION_XY_6.transpose();
-
-		return cov_out_;
-        }
-	case StaticTF::AIRCRAFT_TO_BASELINK:
-	case StaticTF::BASELINK_TO_AIRCRAFT:
-		R.block<3, 3>(0, 0) =
-			R.block<3, 3>(3, 3) = AIRCRAFT_BASELINK_R;
+	return transform_static_covariance(cov, transform);
+}
 
-		cov_out = R * cov_in * R.transpose();
-		return cov_out_;
-	}
+Covariance6d transform_static_frame(const Covariance6d &cov, const StaticTF transform)
+{
+	return transform_static_covariance(cov, transform);
 }
 
 Covariance9d transform_static_frame(const Covariance9d &cov, const StaticTF transform)
 {
-	Covariance9d cov_out_;
-	Matrix9d R = Matrix9d::Zero();
-
-	EigenMapConstCovariance9d cov_in(cov.data());
-	EigenMapCovariance9d cov_out(cov_out_.data());
-
-	switch (transform) {
-	case StaticTF::NED_TO_ENU:
-	case StaticTF::ENU_TO_NED:
-	{
-		Eigen::PermutationMatrix<9> NED_ENU_REFLECTION_XY_9 (NED_ENU_REFLECTION_XY.indices().replicate<3,1>());
-		NED_ENU_REFLECTION_XY_9.indices().middleRows<3>(3).array() += 3;
-		NED_ENU_REFLECTION_XY_9.indices().middleRows<3>(6).array() += 6;
-		Eigen::DiagonalMatrix<double,9> NED_ENU_REFLECTION_Z_9(NED_ENU_REFLECTION_Z.diagonal().replicate<3,1>());
-
-		cov_out = NED_ENU_REFLECTION_XY_9 * (NED_ENU_REFLECTION_Z_9 * cov_in * NED_ENU_REFLECTION_Z_9) *
-		          NED_ENU_REFLECTION_XY_9.transpose();
-
-		return cov_out_;
-        }
-	case StaticTF::AIRCRAFT_TO_BASELINK:
-	case StaticTF::BASELINK_TO_AIRCRAFT:
-		R.block<3, 3>(0, 0) =
-			R.block<3, 3>(3, 3) =
-				R.block<3, 3>(6, 6) = AIRCRAFT_BASELINK_R;
-
-		cov_out = R * cov_in * R.transpose();
-		return cov_out_;
-	}
+	return transform_static_covariance(cov, transform);
 }
 
 Eigen::Vector3d transform_static_frame(const Eigen::Vector3d &vec, const Eigen::Vector3d &map_origin, const StaticTF transform)
@@ -232,47 +145,68 @@ Eigen::Vector3d transform_frame(const Eigen::Vector3d &vec, const Eigen::Quatern
 	return transformation * vec;
 }
 
-Covariance3d transform_frame(const Covariance3d &cov, const Eigen::Quaterniond &q)
+/**
+ * @brief Apply block diagonal rotation to row-major DxD covariance, one 3x3 block at time
+ */
+template<size_t N>
+static void rotate_covariance_blocks(boost::array<double, N> &cov, const Eigen::Matrix3d &R)
 {
-	Covariance3d cov_out_;
-	EigenMapConstCovariance3d cov_in(cov.data());
-	EigenMapCovariance3d cov_out(cov_out_.data());
+	constexpr size_t D = (N == 9) ? 3 : (N == 36) ? 6 : 9;
+	using MatrixD = Eigen::Matrix<double, D, D, Eigen::RowMajor>;
+
+	if (cov[0] == -1.0)
+		return;
+
+	Eigen::Map<MatrixD> m(cov.data());
+	for (size_t r = 0; r < D; r += 3) {
+		for (size_t c = 0; c < D; c += 3) {
+			auto block = m.template block<3, 3>(r, c);
+			if ((block.array() == 0.0).all())
+				continue;
+
+			const Eigen::Matrix3d b = block;
+			block.noalias() = R * b * R.transpose();
+		}
+	}
+}
 
-	cov_out = cov_in * q;
-	return cov_out_;
+Covariance3d transform_frame(const Covariance3d &cov, const Eigen::Quaterniond &q)
+{
+	Covariance3d cov_out = cov;
+	rotate_covariance(cov_out, q);
+	return cov_out;
 }
 
 Covariance6d transform_frame(const Covariance6d &cov, const Eigen::Quaterniond &q)
 {
-	Covariance6d cov_out_;
-	Matrix6d R = Matrix6d::Zero();
-
-	EigenMapConstCovariance6d cov_in(cov.data());
-	EigenMapCovariance6d cov_out(cov_out_.data());
-
-	R.block<3, 3>(0, 0) =
-		R.block<3, 3>(3, 3) = q.normalized().toRotationMatrix();
-
-	cov_out = R * cov_in * R.transpose();
-	return cov_out_;
+	Covariance6d cov_out = cov;
+	rotate_covariance(cov_out, q);
+	return cov_out;
 }
 
 Covariance9d transform_frame(const Covariance9d &cov, const Eigen::Quaterniond &q)
 {
-	Covariance9d cov_out_;
-	Matrix9d R = Matrix9d::Zero();
+	Covariance9d cov_out = cov;
+	rotate_covariance(cov_out, q);
+	return cov_out;
+}
 
-	EigenMapConstCovariance9d cov_in(cov.data());
-	EigenMapCovariance9d cov_out(cov_out_.data());
+}	// namespace detail
+
+void rotate_covariance(Covariance3d &cov, const Eigen::Matrix3d &R)
+{
+	detail::rotate_covariance_blocks(cov, R);
+}
 
-	R.block<3, 3>(0, 0) =
-		R.block<3, 3>(3, 3) =
-			R.block<3, 3>(6, 6) = q.normalized().toRotationMatrix();
+void rotate_covariance(Covariance6d &cov, const Eigen::Matrix3d &R)
+{
+	detail::rotate_covariance_blocks(cov, R);
+}
 
-	cov_out = R * cov_in * R.transpose();
-	return cov_out_;
+void rotate_covariance(Covariance9d &cov, const Eigen::Matrix3d &R)
+{
+	detail::rotate_covariance_blocks(cov, R);
 }
 
-}	// namespace detail
 }	// namespace ftf
 }	// namespace mavros
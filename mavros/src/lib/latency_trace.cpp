@@ -0,0 +1,267 @@
+/**
+ * @brief Wire to publish latency tracing
+ * @file latency_trace.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include <mavros/latency_trace.h>
+
+using namespace mavros;
+
+constexpr size_t LatencyTrace::RING_SIZE;
+constexpr size_t LatencyTrace::HIST_BINS;
+
+
+void LatencyTrace::Histogram::add(uint64_t ns)
+{
+	const uint64_t us = ns / 1000;
+	size_t bin = 0;
+	while (bin < HIST_BINS - 1 && (uint64_t(1) << bin) <= us)
+		bin++;
+
+	bins[bin]++;
+	count++;
+	max_ns = std::max(max_ns, ns);
+}
+
+double LatencyTrace::Histogram::quantile(double p) const
+{
+	if (count == 0)
+		return 0.0;
+
+	const uint64_t rank = std::max<uint64_t>(1, p * count + 0.5);
+	uint64_t acc = 0;
+	for (size_t bin = 0; bin < HIST_BINS; bin++) {
+		acc += bins[bin];
+		if (acc >= rank)
+			return std::min((uint64_t(1) << bin) * 1e-6, max_ns * 1e-9);
+	}
+
+	return max_ns * 1e-9;
+}
+
+LatencyTrace::Ring::Ring(size_t tid_) :
+	tid(tid_),
+	head(0),
+	read_pos(0)
+{
+	for (auto &slot : slots) {
+		slot.seq.store(0, std::memory_order_relaxed);
+		for (auto &w : slot.words)
+			w.store(0, std::memory_order_relaxed);
+	}
+}
+
+void LatencyTrace::Ring::push(const Record &rec)
+{
+	const uint64_t pos = head.load(std::memory_order_relaxed);
+	auto &slot = slots[pos % RING_SIZE];
+
+	const uint32_t s = slot.seq.load(std::memory_order_relaxed);
+	slot.seq.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.words[0].store(rec.msgid, std::memory_order_relaxed);
+	for (size_t i = 0; i < STAGE_COUNT; i++)
+		slot.words[1 + i].store(rec.stamp_ns[i], std::memory_order_relaxed);
+
+	slot.seq.store(s + 2, std::memory_order_release);
+	head.store(pos + 1, std::memory_order_release);
+}
+
+bool LatencyTrace::Ring::read(uint64_t pos, Record &rec) const
+{
+	const auto &slot = slots[pos % RING_SIZE];
+
+	const uint32_t s0 = slot.seq.load(std::memory_order_acquire);
+	rec.msgid = slot.words[0].load(std::memory_order_relaxed);
+	for (size_t i = 0; i < STAGE_COUNT; i++)
+		rec.stamp_ns[i] = slot.words[1 + i].load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint32_t s1 = slot.seq.load(std::memory_order_relaxed);
+
+	// writer may lap reader meanwhile
+	return !(s0 & 1) && s0 == s1 && head.load(std::memory_order_acquire) - pos <= RING_SIZE;
+}
+
+LatencyTrace::LatencyTrace() :
+	enabled(false),
+	overruns_(0)
+{ }
+
+LatencyTrace &LatencyTrace::instance()
+{
+	static LatencyTrace trace;
+	return trace;
+}
+
+LatencyTrace::ThreadState &LatencyTrace::thread_state()
+{
+	static thread_local ThreadState state{nullptr, false, Record{}};
+	return state;
+}
+
+uint64_t LatencyTrace::now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char *LatencyTrace::stage_name(Stage stage)
+{
+	switch (stage) {
+	case RX:	return "rx";
+	case ROUTE:	return "route";
+	case HANDLER:	return "handler";
+	case PUBLISH:	return "publish";
+	case DONE:	return "done";
+	default:	return "unknown";
+	}
+}
+
+void LatencyTrace::begin(uint32_t msgid, uint64_t rx_stamp_ns)
+{
+	auto &st = thread_state();
+	st.active = is_enabled();
+	if (!st.active)
+		return;
+
+	st.rec.msgid = msgid;
+	st.rec.stamp_ns.fill(0);
+	st.rec.stamp_ns[RX] = (rx_stamp_ns != 0) ? rx_stamp_ns : now_ns();
+}
+
+void LatencyTrace::mark(Stage stage)
+{
+	auto &st = thread_state();
+	if (st.active && st.rec.stamp_ns[stage] == 0)
+		st.rec.stamp_ns[stage] = now_ns();
+}
+
+void LatencyTrace::end()
+{
+	auto &st = thread_state();
+	if (!st.active)
+		return;
+
+	st.active = false;
+	st.rec.stamp_ns[DONE] = now_ns();
+
+	if (!st.ring)
+		st.ring = register_ring();
+
+	st.ring->push(st.rec);
+}
+
+LatencyTrace::Ring *LatencyTrace::register_ring()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	rings.emplace_back(new Ring(rings.size()));
+	return rings.back().get();
+}
+
+void LatencyTrace::add_record(const Record &rec)
+{
+	auto &ms = stats[rec.msgid];
+
+	uint64_t prev = rec.stamp_ns[RX];
+	for (size_t i = ROUTE; i < STAGE_COUNT; i++) {
+		const uint64_t t = rec.stamp_ns[i];
+		if (t == 0)
+			continue;
+
+		// clock step or kernel stamp ahead of ours
+		ms.stage[i].add((t > prev) ? t - prev : 0);
+		prev = std::max(prev, t);
+	}
+
+	const uint64_t rx = rec.stamp_ns[RX], done = rec.stamp_ns[DONE];
+	ms.total.add((done > rx) ? done - rx : 0);
+}
+
+std::map<uint32_t, LatencyTrace::MsgStat> LatencyTrace::collect()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto &ring : rings) {
+		const uint64_t head = ring->head.load(std::memory_order_acquire);
+		if (head - ring->read_pos > RING_SIZE) {
+			overruns_.fetch_add(head - ring->read_pos - RING_SIZE, std::memory_order_relaxed);
+			ring->read_pos = head - RING_SIZE;
+		}
+
+		for (; ring->read_pos < head; ring->read_pos++) {
+			Record rec;
+			if (ring->read(ring->read_pos, rec))
+				add_record(rec);
+			else
+				overruns_.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	return stats;
+}
+
+size_t LatencyTrace::dump(const std::string &path)
+{
+	std::unique_ptr<FILE, int (*)(FILE *)> fp(std::fopen(path.c_str(), "w"), &std::fclose);
+	if (!fp)
+		throw std::runtime_error("LatencyTrace: can not open " + path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t nrecords = 0;
+	bool first = true;
+	std::fprintf(fp.get(), "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	for (auto &ring : rings) {
+		const uint64_t head = ring->head.load(std::memory_order_acquire);
+		const uint64_t start = (head > RING_SIZE) ? head - RING_SIZE : 0;
+
+		for (uint64_t pos = start; pos < head; pos++) {
+			Record rec;
+			if (!ring->read(pos, rec))
+				continue;
+
+			// one complete event per stage, spanning from previous passed stage
+			uint64_t prev = rec.stamp_ns[RX];
+			for (size_t i = ROUTE; i < STAGE_COUNT; i++) {
+				const uint64_t t = rec.stamp_ns[i];
+				if (t == 0)
+					continue;
+
+				std::fprintf(fp.get(),
+						"%s{\"name\":\"%s\",\"cat\":\"msgid %u\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+						"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"msgid\":%u}}",
+						first ? "" : ",\n",
+						stage_name(Stage(i)), unsigned(rec.msgid), ring->tid,
+						prev * 1e-3, (t > prev) ? (t - prev) * 1e-3 : 0.0,
+						unsigned(rec.msgid));
+
+				first = false;
+				prev = std::max(prev, t);
+			}
+
+			nrecords++;
+		}
+	}
+
+	std::fprintf(fp.get(), "\n]}\n");
+	if (std::ferror(fp.get()))
+		throw std::runtime_error("LatencyTrace: write error " + path);
+
+	return nrecords;
+}
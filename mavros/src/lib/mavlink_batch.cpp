@@ -0,0 +1,79 @@
+/**
+ * @brief Mavlink batch publisher
+ * @file mavlink_batch.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/mavlink_batch.h>
+#include <mavros/utils.h>
+
+using namespace mavros;
+using mavconn::Framing;
+using mavlink::mavlink_message_t;
+using utils::enum_value;
+
+
+MavlinkBatcher::MavlinkBatcher() :
+	batch_size(0)
+{ }
+
+void MavlinkBatcher::advertise(ros::NodeHandle &nh, const std::string &topic, size_t batch_size_, ros::Duration timeout)
+{
+	batch_size = batch_size_;
+	if (batch_size == 0)
+		return;
+
+	pub.advertise<mavros_msgs::MavlinkBatch>(nh, topic, 10);
+	flush_timer = nh.createTimer(timeout,
+			[this](const ros::TimerEvent &) {
+				flush();
+			});
+
+	ROS_INFO("Mavlink batch %s: %zu frames, timeout %.3f s",
+			pub.getTopic().c_str(), batch_size, timeout.toSec());
+}
+
+void MavlinkBatcher::push(const mavlink_message_t *mmsg, const Framing framing)
+{
+	if (!pub.has_subscribers())
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!batch) {
+		batch = boost::make_shared<mavros_msgs::MavlinkBatch>();
+		batch->messages.reserve(batch_size);
+	}
+
+	batch->messages.emplace_back();
+	auto &rmsg = batch->messages.back();
+
+	rmsg.header.stamp = ros::Time::now();
+	mavros_msgs::mavlink::convert(*mmsg, rmsg, enum_value(framing));
+
+	if (batch->messages.size() >= batch_size)
+		publish_locked();
+}
+
+void MavlinkBatcher::flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (batch && !batch->messages.empty())
+		publish_locked();
+}
+
+void MavlinkBatcher::publish_locked()
+{
+	// published under lock: batches keep frame order
+	batch->header.stamp = ros::Time::now();
+	pub.publish(batch);
+	batch.reset();
+}
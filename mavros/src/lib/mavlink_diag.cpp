@@ -11,6 +11,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mavros/utils.h>
 #include <mavros/mavlink_diag.h>
 
 using namespace mavros;
@@ -18,7 +19,10 @@ using namespace mavros;
 MavlinkDiag::MavlinkDiag(std::string name) :
 	diagnostic_updater::DiagnosticTask(name),
 	last_drop_count(0),
-	is_connected(false)
+	last_tx_drop_count(0),
+	last_seq_lost_count(0),
+	is_connected(false),
+	protocol_negotiator(nullptr)
 { };
 
 void MavlinkDiag::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
@@ -26,22 +30,77 @@ void MavlinkDiag::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 	if (auto link = weak_link.lock()) {
 		auto mav_status = link->get_status();
 		auto iostat = link->get_iostat();
+		auto txstat = link->get_tx_stat();
 
-		stat.addf("Received packets:", "%u", mav_status.packet_rx_success_count);
-		stat.addf("Dropped packets:", "%u", mav_status.packet_rx_drop_count);
-		stat.addf("Buffer overruns:", "%u", mav_status.buffer_overrun);
-		stat.addf("Parse errors:", "%u", mav_status.parse_error);
-		stat.addf("Rx sequence number:", "%u", mav_status.current_rx_seq);
-		stat.addf("Tx sequence number:", "%u", mav_status.current_tx_seq);
+		// counters mostly same between runs, and seldom someone looks at them
+		auto &c = cache.begin(stat);
 
-		stat.addf("Rx total bytes:", "%u", iostat.rx_total_bytes);
-		stat.addf("Tx total bytes:", "%u", iostat.tx_total_bytes);
-		stat.addf("Rx speed:", "%f", iostat.rx_speed);
-		stat.addf("Tx speed:", "%f", iostat.tx_speed);
+		c.addf("Received packets:", "%u", mav_status.packet_rx_success_count);
+		c.addf("Dropped packets:", "%u", mav_status.packet_rx_drop_count);
+		c.addf("Buffer overruns:", "%u", mav_status.buffer_overrun);
+		c.addf("Parse errors:", "%u", mav_status.parse_error);
+		c.addf("Rx sequence number:", "%u", mav_status.current_rx_seq);
+		c.addf("Tx sequence number:", "%u", mav_status.current_tx_seq);
+
+		const auto version = link->get_protocol_version();
+		const char *protocol = (version == mavconn::Protocol::V10) ? "v1.0" : "v2.0";
+		if (protocol_negotiator) {
+			const auto state = protocol_negotiator->state();
+			c.add("MAVLink protocol:", {double(utils::enum_value(version)), double(utils::enum_value(state))}, [&]() {
+						return utils::format("%s (auto: %s)", protocol, ProtocolNegotiator::to_string(state));
+					});
+		}
+		else
+			c.add("MAVLink protocol:", protocol);
+
+		c.addf("Rx total bytes:", "%u", iostat.rx_total_bytes);
+		c.addf("Tx total bytes:", "%u", iostat.tx_total_bytes);
+		c.addf("Rx speed:", "%f", iostat.rx_speed);
+		c.addf("Tx speed:", "%f", iostat.tx_speed);
+		c.addf("Rx speed 10 s / peak:", "%f / %f", iostat.rx_speed_avg, iostat.rx_speed_peak);
+		c.addf("Tx speed 10 s / peak:", "%f / %f", iostat.tx_speed_avg, iostat.tx_speed_peak);
+		if (iostat.rx_read_interval_avg_us > 0.0f)
+			c.addf("Rx read interval avg / max [us]:", "%.0f / %.0f",
+					iostat.rx_read_interval_avg_us, iostat.rx_read_interval_max_us);
+		if (iostat.rx_kernel_drops > 0)
+			c.addf("Rx kernel drops:", "%zu", iostat.rx_kernel_drops);
+
+		// same order as mavconn::TxPriority
+		static const char *const tx_queue_keys[] = {"Tx queue command:", "Tx queue param:", "Tx queue telemetry:"};
+		static const char *const tx_dropped_keys[] = {"Tx dropped command:", "Tx dropped param:", "Tx dropped telemetry:"};
+		size_t tx_drop_count = 0;
+		for (size_t i = 0; i < mavconn::TX_PRIORITY_COUNT; i++) {
+			c.addf(tx_queue_keys[i], "%zu", txstat.depth[i]);
+			c.addf(tx_dropped_keys[i], "%zu", txstat.dropped[i]);
+			tx_drop_count += txstat.dropped[i];
+		}
+		c.addf("Tx coalesced setpoints:", "%zu", txstat.coalesced);
+
+		if (link->is_signing()) {
+			auto sst = link->get_signing_stat();
+			c.addf("Signing:", "tx %zu, rx %zu, rx unsigned %zu, bad %zu, replayed %zu, rejected unsigned %zu",
+					sst.tx_signed, sst.rx_signed, sst.rx_unsigned,
+					sst.bad_signature, sst.replayed, sst.unsigned_rejected);
+		}
+
+		// seq gaps of each source, link drop counter can not tell whose frames were lost
+		size_t seq_lost_count = 0;
+		for (auto &src : link->get_source_stats()) {
+			c.addf(utils::format("Source %u.%u:", src.sysid, src.compid),
+					"received %zu, lost %zu, duplicates %zu, reordered %zu, resyncs %zu",
+					src.received, src.lost, src.duplicates, src.reordered, src.resyncs);
+			seq_lost_count += src.lost;
+		}
 
 		if (mav_status.packet_rx_drop_count > last_drop_count)
 			stat.summaryf(1, "%d packeges dropped since last report",
 				mav_status.packet_rx_drop_count - last_drop_count);
+		else if (tx_drop_count > last_tx_drop_count)
+			stat.summaryf(1, "%zu Tx buffers dropped since last report",
+				tx_drop_count - last_tx_drop_count);
+		else if (seq_lost_count > last_seq_lost_count)
+			stat.summaryf(1, "%zu frames lost since last report",
+				seq_lost_count - last_seq_lost_count);
 		else if (is_connected)
 			stat.summary(0, "connected");
 		else
@@ -49,6 +108,8 @@ void MavlinkDiag::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 			stat.summary(1, "not connected");
 
 		last_drop_count = mav_status.packet_rx_drop_count;
+		last_tx_drop_count = tx_drop_count;
+		last_seq_lost_count = seq_lost_count;
 	} else {
 		stat.summary(2, "not connected");
 	}
@@ -15,6 +15,9 @@
 #include <mavros/mavros.h>
 #include <mavros/utils.h>
 #include <fnmatch.h>
+#include <algorithm>
+#include <thread>
+#include <exception>
 
 // MAVLINK_VERSION string
 #include <mavlink/config.h>
@@ -27,14 +30,27 @@ using mavlink::mavlink_message_t;
 using plugin::PluginBase;
 using utils::enum_value;
 
+thread_local std::string PluginBase::construct_namespace;
 
-MavRos::MavRos() :
+
+MavRos::MavRos(const ros::NodeHandle &nh) :
+	node_nh(nh),
 	mavlink_nh("mavlink"),		// allow to namespace it
+	stream_stats_enabled(false),
+	stream_stats_rate(1.0),
 	fcu_link_diag("FCU connection"),
 	gcs_link_diag("GCS bridge"),
-	plugin_loader("mavros", "mavros::plugin::PluginBase"),
+	fcu_protocol_auto(false),
+	spinner_threads(4),
+	plugin_stats_enabled(false),
+	plugin_loader(),
 	last_message_received_from_gcs(0),
-	plugin_subscriptions{}
+	plugin_subscriptions{},
+	multi_vehicle(false),
+	max_vehicles(64),
+	vehicle_tgt_component(1),
+	vehicles_connected(0),
+	dispatcher("Dispatch")
 {
 	std::string fcu_url, gcs_url;
 	std::string fcu_protocol;
@@ -42,10 +58,16 @@ MavRos::MavRos() :
 	int tgt_system_id, tgt_component_id;
 	bool px4_usb_quirk;
 	double conn_timeout_d;
-	ros::V_string plugin_blacklist{}, plugin_whitelist{};
+	int batch_size;
+	double batch_timeout;
+	int dispatch_workers, dispatch_queue_size;
+	std::string dispatch_shard;
+	std::vector<int> dispatch_drop_msgids{};
+	ros::V_string router_urls{};
+	int plugin_init_threads;
+	ros::V_string plugin_init_serial{};
 	MAVConnInterface::Ptr fcu_link;
-
-	ros::NodeHandle nh("~");
+	std::vector<MAVConnInterface::Ptr> router_links;
 
 	nh.param<std::string>("fcu_url", fcu_url, "serial:///dev/ttyACM0");
 	nh.param<std::string>("gcs_url", gcs_url, "udp://@");
@@ -60,11 +82,49 @@ MavRos::MavRos() :
 	nh.param("startup_px4_usb_quirk", px4_usb_quirk, false);
 	nh.getParam("plugin_blacklist", plugin_blacklist);
 	nh.getParam("plugin_whitelist", plugin_whitelist);
+	nh.param("dispatch/workers", dispatch_workers, 1);
+	nh.param("dispatch/queue_size", dispatch_queue_size, 1024);
+	nh.param<std::string>("dispatch/shard", dispatch_shard, "plugin");
+	nh.getParam("dispatch/drop_msgids", dispatch_drop_msgids);
+	nh.param("mavlink_batch/size", batch_size, 0);
+	nh.param("mavlink_batch/timeout", batch_timeout, 0.01);
+	nh.getParam("router/urls", router_urls);
+	nh.param("plugin_init/threads", plugin_init_threads, 1);
+	nh.param("stream_stats/enable", stream_stats_enabled, false);
+	nh.param("stream_stats/rate", stream_stats_rate, 1.0);
+	nh.param("plugin_stats/enable", plugin_stats_enabled, false);
+	if (!nh.getParam("plugin_init/serial", plugin_init_serial))
+		plugin_init_serial = {"sys_status", "sys_time", "global_position", "3dr_radio"};
+	nh.param("multi_vehicle/enable", multi_vehicle, false);
+	nh.param<std::string>("multi_vehicle/prefix", vehicle_prefix, "uav");
+	nh.getParam("multi_vehicle/sysids", vehicle_sysids);
+	nh.param("multi_vehicle/max_vehicles", max_vehicles, 64);
+
+	for (size_t i = 0; i < vehicle_by_sysid.size(); i++) {
+		vehicle_by_sysid[i].store(nullptr);
+		vehicle_pending[i].store(false);
+	}
 
 	conn_timeout = ros::Duration(conn_timeout_d);
 
+	setup_tf_aggregator(nh, mav_uas);
+	setup_stream_demand(nh, mav_uas);
+	setup_timer_wheel(nh, mav_uas);
+	setup_spinner_queues(nh);
+
+	// precompute geoid heights of operating area, so first fix does not wait for them
+	std::vector<double> geoid_preload{};
+	double geoid_preload_radius;
+	nh.getParam("geoid/preload", geoid_preload);
+	nh.param("geoid/preload_radius", geoid_preload_radius, 2000.0);
+	if (geoid_preload.size() == 2)
+		mav_uas.preload_geoid_area(geoid_preload[0], geoid_preload[1], geoid_preload_radius);
+	else if (!geoid_preload.empty())
+		ROS_WARN("UAS: geoid/preload should be [lat, lon]");
+
 	// Now we use FCU URL as a hardware Id
 	UAS_DIAG(&mav_uas).setHardwareID(fcu_url);
+	vehicle_hw_id = fcu_url;
 
 	ROS_INFO_STREAM("FCU URL: " << fcu_url);
 	try {
@@ -88,11 +148,14 @@ MavRos::MavRos() :
 	else if (fcu_protocol == "v2.0") {
 		fcu_link->set_protocol_version(mavconn::Protocol::V20);
 	}
-	//else if (fcu_protocol == "auto") {	// XXX TODO
-	//	fcu_link->set_protocol_version(mavconn::Protocol::V20);
-	//}
+	else if (fcu_protocol == "auto") {
+		// probe with v2.0, fcu_protocol_cb() decides by FCU heartbeats
+		fcu_link->set_protocol_version(mavconn::Protocol::V20);
+		fcu_protocol_auto = true;
+		fcu_link_diag.set_protocol_negotiator(&fcu_protocol_negotiator);
+	}
 	else {
-		ROS_WARN("Unknown FCU protocol: \"%s\", should be: \"v1.0\" or \"v2.0\". Used default v1.0.", fcu_protocol.c_str());
+		ROS_WARN("Unknown FCU protocol: \"%s\", should be: \"v1.0\", \"v2.0\" or \"auto\". Used default v1.0.", fcu_protocol.c_str());
 		fcu_link->set_protocol_version(mavconn::Protocol::V10);
 	}
 
@@ -114,13 +177,57 @@ MavRos::MavRos() :
 	else
 		ROS_INFO("GCS bridge disabled");
 
+	for (auto &url : router_urls) {
+		ROS_INFO_STREAM("Router URL: " << url);
+		try {
+			router_links.push_back(MAVConnInterface::open_url(url, system_id, component_id));
+		}
+		catch (mavconn::DeviceError &ex) {
+			ROS_FATAL("Router: %s", ex.what());
+			ros::shutdown();
+			return;
+		}
+	}
+
 	// ROS mavlink bridge
-	mavlink_pub = mavlink_nh.advertise<mavros_msgs::Mavlink>("from", 100);
+	mavlink_pub.advertise<mavros_msgs::Mavlink>(mavlink_nh, "from", 100);
 	mavlink_sub = mavlink_nh.subscribe("to", 100, &MavRos::mavlink_sub_cb, this,
 		ros::TransportHints()
 			.unreliable().maxDatagramSize(1024)
 			.reliable());
 
+	// batched bridge, optional
+	mavlink_batch_pub.advertise(mavlink_nh, "from_batch", std::max(batch_size, 0), ros::Duration(batch_timeout));
+	mavlink_batch_sub = mavlink_nh.subscribe("to_batch", 10, &MavRos::mavlink_batch_sub_cb, this);
+
+	// raw bridge: frames relayed as on wire
+	mavlink_raw_pub.advertise<mavros_msgs::MavlinkRaw>(mavlink_nh, "from_raw", 100);
+	mavlink_raw_sub = mavlink_nh.subscribe("to_raw", 100, &MavRos::mavlink_raw_sub_cb, this,
+		ros::TransportHints()
+			.unreliable().maxDatagramSize(1024)
+			.reliable());
+
+	// per msgid rate, jitter and loss, optional
+	if (stream_stats_enabled) {
+		stream_stats_pub = mavlink_nh.advertise<mavros_msgs::StreamStatusList>("stream_status", 10);
+		UAS_DIAG(&mav_uas).add("MAVLink streams", this, &MavRos::stream_stats_diag_run);
+	}
+
+#ifdef MAVROS_TRACE
+	// wire to publish latency of FCU messages
+	{
+		ros::NodeHandle trace_nh(nh, "trace");
+		bool trace_enabled;
+
+		trace_nh.param("enable", trace_enabled, true);
+		trace_nh.param<std::string>("dump_file", trace_dump_file, "/tmp/mavros_trace.json");
+
+		LatencyTrace::instance().set_enabled(trace_enabled);
+		UAS_DIAG(&mav_uas).add("Latency trace", this, &MavRos::trace_diag_run);
+		trace_dump_srv = trace_nh.advertiseService("dump", &MavRos::trace_dump_cb, this);
+	}
+#endif
+
 	// setup UAS and diag
 	mav_uas.set_tgt(tgt_system_id, tgt_component_id);
 	UAS_FCU(&mav_uas) = fcu_link;
@@ -128,29 +235,159 @@ MavRos::MavRos() :
 	mav_uas.add_connection_change_handler(std::bind(&MavlinkDiag::set_connection_status, &fcu_link_diag, std::placeholders::_1));
 	mav_uas.add_connection_change_handler(std::bind(&MavRos::log_connect_change, this, std::placeholders::_1));
 
+	// prepare dispatch sharding
+	if (dispatch_workers > int(Dispatcher::MAX_WORKERS)) {
+		ROS_WARN("DISP: too many workers: %d, limited to %zu", dispatch_workers, Dispatcher::MAX_WORKERS);
+		dispatch_workers = Dispatcher::MAX_WORKERS;
+	}
+
+	if (dispatch_shard != "plugin" && dispatch_shard != "msgid") {
+		ROS_WARN("DISP: unknown shard mode: \"%s\", should be: \"msgid\" or \"plugin\". Used plugin.", dispatch_shard.c_str());
+		dispatch_shard = "plugin";
+	}
+
+	if (dispatch_shard == "plugin" && multi_vehicle && dispatch_workers > 1) {
+		ROS_WARN("DISP: plugin shard mode not supported with multi_vehicle, used msgid.");
+		dispatch_shard = "msgid";
+	}
+
+	if (dispatch_shard == "plugin") {
+		if (dispatch_workers > 1)
+			shard_subscriptions.resize(dispatch_workers);
+	}
+	else if (dispatch_workers > 1) {
+		// handlers of one plugin for different msgids run in parallel
+		ROS_WARN("DISP: msgid shard mode: plugin handlers may run concurrently, plugins must lock shared state.");
+	}
+
 	// prepare plugin lists
 	// issue #257 2: assume that all plugins blacklisted
 	if (plugin_blacklist.empty() and !plugin_whitelist.empty())
 		plugin_blacklist.emplace_back("*");
 
-	for (auto &name : plugin_loader.getDeclaredClasses())
-		add_plugin(name, plugin_blacklist, plugin_whitelist);
+	if (multi_vehicle) {
+		// plugins created per vehicle, see create_vehicle()
+		nh.param("target_component_id", vehicle_tgt_component, 1);
+		UAS_DIAG(&mav_uas).add("Vehicles", this, &MavRos::vehicles_diag_run);
+		ROS_INFO("Multi-vehicle mode: plugins in ~%s<sysid> namespaces, up to %d vehicles",
+				vehicle_prefix.c_str(), max_vehicles);
+	}
+	else {
+		// routes collected in declaration order, only initialize() may run concurrently
+		auto load_start = ros::WallTime::now();
+		for (auto &name : plugin_loader.getDeclaredClasses())
+			add_plugin(name, plugin_blacklist, plugin_whitelist);
+
+		auto init_start = ros::WallTime::now();
+		initialize_plugins(std::max(plugin_init_threads, 1), plugin_init_serial);
+
+		auto init_end = ros::WallTime::now();
+		ROS_INFO("Plugins: %zu loaded in %.3f s, initialized in %.3f s (%d threads)",
+				loaded_plugins.size(),
+				(init_start - load_start).toSec(),
+				(init_end - init_start).toSec(),
+				std::max(plugin_init_threads, 1));
+
+		UAS_DIAG(&mav_uas).add("Plugins", this, &MavRos::plugin_diag_run);
+	}
 
-	// connect FCU link
+	if (plugin_stats_enabled) {
+		plugin_stats_last = ros::WallTime::now();
+		UAS_DIAG(&mav_uas).add("Plugin stats", this, &MavRos::plugin_stats_diag_run);
+		ROS_INFO("Plugins: handler accounting enabled%s",
+				plugin::PluginStats::alloc_stats_enabled() ? ", with allocations" : "");
+	}
 
-	// XXX TODO: move workers to ROS Spinner, let mavconn threads to do only IO
-	fcu_link->message_received_cb = [this](const mavlink_message_t *msg, const Framing framing) {
-		mavlink_pub_cb(msg, framing);
-		plugin_route_cb(msg, framing);
+	// freeze routing tables
+	plugin_routes.build(plugin_subscriptions);
+	shard_routes.resize(shard_subscriptions.size());
+	for (size_t i = 0; i < shard_subscriptions.size(); i++)
+		shard_routes[i].build(shard_subscriptions[i]);
+
+	ROS_DEBUG("Routing table: %zu msgids", plugin_routes.size());
+
+	// start dispatch workers, so mavconn threads do only IO and GCS forwarding
+	if (dispatch_workers > 0) {
+		dispatcher.set_droppable(std::vector<mavlink::msgid_t>(
+				dispatch_drop_msgids.begin(), dispatch_drop_msgids.end()));
+		setup_dispatch_routes(dispatch_workers);
+		dispatcher.start(dispatch_workers, std::max(dispatch_queue_size, 1),
+				std::bind(&MavRos::dispatch_cb, this,
+					std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+	}
+	else
+		ROS_INFO("DISP: message handlers run in FCU I/O thread");
+
+	UAS_DIAG(&mav_uas).add(dispatcher);
+
+	// router is ready before FCU link callback may use it
+	if (gcs_link || !router_links.empty()) {
+		// setup router: FCU is endpoint 0, GCS link (if any) 1, then router/urls links
+		std::vector<std::string> names{fcu_url};
+		router = std::make_shared<mavconn::Router>();
+		router->add_endpoint(fcu_link, false);
 
 		if (gcs_link) {
-			if (this->gcs_quiet_mode && msg->msgid != mavlink::common::msg::HEARTBEAT::MSG_ID &&
-				(ros::Time::now() - this->last_message_received_from_gcs > this->conn_timeout)) {
-				return;
-			}
+			auto gcs_ep = router->add_endpoint(gcs_link, false);
+			names.push_back(gcs_url);
+
+			bool radio_on_gcs = setup_gcs_limits(nh);
+
+			router->set_tx_filter(gcs_ep, [this](const mavlink_message_t *msg) {
+					if (this->gcs_quiet_mode && msg->msgid != mavlink::common::msg::HEARTBEAT::MSG_ID &&
+						(ros::Time::now() - this->last_message_received_from_gcs > this->conn_timeout))
+						return false;
 
-			gcs_link->send_message_ignore_drop(msg);
+					return !gcs_limiter || gcs_limiter->accept(msg);
+				});
+
+			gcs_link->message_received_cb = [this, gcs_ep, radio_on_gcs](const mavlink_message_t *msg, const Framing framing) {
+				this->last_message_received_from_gcs = ros::Time::now();
+
+				// radio on GCS link inserts own RADIO_STATUS to the stream
+				if (radio_on_gcs && framing == Framing::ok &&
+						msg->msgid == mavlink::common::msg::RADIO_STATUS::MSG_ID) {
+					mavlink::MsgMap map(msg);
+					mavlink::common::msg::RADIO_STATUS rst;
+					rst.deserialize(map);
+					gcs_limiter->update_link_budget(rst.txbuf);
+				}
+
+				router->route(gcs_ep, msg, framing);
+			};
+
+			gcs_link_diag.set_connection_status(true);
+		}
+
+		for (size_t i = 0; i < router_links.size(); i++) {
+			router->add_endpoint(router_links[i]);
+			names.push_back(router_urls[i]);
 		}
+
+		router->start();
+
+		if (!gcs_link)
+			gcs_diag_updater.setHardwareID("router");
+		gcs_diag_updater.add("MAVLink router", std::bind(&MavRos::router_diag_run, this, std::placeholders::_1, names));
+	}
+
+	// connect FCU link
+	// raw pointers: link owns the callback, router is not reassigned
+	auto fcu_link_p = fcu_link.get();
+	auto router_p = router.get();
+	fcu_link->message_received_cb = [this, fcu_link_p, router_p](const mavlink_message_t *msg, const Framing framing) {
+		const uint64_t rx_stamp_ns = fcu_link_p->get_rx_stamp_ns();
+
+		if (fcu_protocol_auto && msg->msgid == mavlink::common::msg::HEARTBEAT::MSG_ID)
+			fcu_protocol_cb(fcu_link_p, msg);
+
+		if (dispatcher.is_running())
+			dispatcher.push(msg, framing, rx_stamp_ns);
+		else
+			dispatch_cb(msg, framing, rx_stamp_ns, 0);
+
+		if (router_p)
+			router_p->route(0, msg, framing);
 	};
 
 	fcu_link->port_closed_cb = []() {
@@ -158,16 +395,6 @@ MavRos::MavRos() :
 		ros::requestShutdown();
 	};
 
-	if (gcs_link) {
-		// setup GCS link bridge
-		gcs_link->message_received_cb = [this, fcu_link](const mavlink_message_t *msg, const Framing framing) {
-			this->last_message_received_from_gcs = ros::Time::now();
-			fcu_link->send_message_ignore_drop(msg);
-		};
-
-		gcs_link_diag.set_connection_status(true);
-	}
-
 	if (px4_usb_quirk)
 		startup_px4_usb_quirk();
 
@@ -183,35 +410,306 @@ MavRos::MavRos() :
 		tgt_system_id, tgt_component_id);
 }
 
-void MavRos::spin()
+MavRos::~MavRos()
+{
+	// plugins go before queues, do not let spinners call them meanwhile
+	stop_spinners();
+
+	// same for timers
+	mav_uas.timer_wheel.stop();
+
+	// plugins use UAS (tf_watcher) in destructors, so they go before it,
+	// after FCU link stopped calling their handlers.
+	// Not locked: link handlers take vehicles_mutex.
+	dispatcher.stop();
+	auto fcu_link = UAS_FCU(&mav_uas);
+	if (fcu_link) {
+		fcu_link->port_closed_cb = nullptr;	// nodelet unload is not a link failure
+		fcu_link->close();
+	}
+
+	std::lock_guard<std::mutex> lock(vehicles_mutex);
+	for (auto &v : vehicles) {
+		v->uas->timer_wheel.stop();
+		v->plugins.clear();
+	}
+
+	loaded_plugins.clear();
+}
+
+void MavRos::start()
 {
-	ros::AsyncSpinner spinner(4 /* threads */);
+	for (auto &q : spinner_queues)
+		q.spinner->start();
 
-	auto diag_timer = mavlink_nh.createTimer(
+	diag_timer = mavlink_nh.createTimer(
 			ros::Duration(0.5),
-			[&](const ros::TimerEvent &) {
+			[this](const ros::TimerEvent &) {
 				UAS_DIAG(&mav_uas).update();
 
-				if (gcs_link)
+				if (router)
 					gcs_diag_updater.update();
+
+				std::lock_guard<std::mutex> lock(vehicles_mutex);
+				for (auto &v : vehicles)
+					UAS_DIAG(v->uas.get()).update();
 			});
 	diag_timer.start();
 
+	if (multi_vehicle) {
+		vehicle_timer = mavlink_nh.createTimer(
+				ros::Duration(0.2),
+				[this](const ros::TimerEvent &) {
+					vehicle_timer_cb();
+				});
+	}
+
+	if (stream_stats_enabled && stream_stats_rate > 0.0) {
+		stream_stats_timer = mavlink_nh.createTimer(
+				ros::Duration(1.0 / stream_stats_rate),
+				[this](const ros::TimerEvent &) {
+					stream_stats_publish();
+				});
+	}
+}
+
+void MavRos::spin()
+{
+	ros::AsyncSpinner spinner(spinner_threads);
+
+	start();
 	spinner.start();
 	ros::waitForShutdown();
 
 	ROS_INFO("Stopping mavros...");
+	// spinners run diagnostics, which read dispatcher workers
 	spinner.stop();
+	stop_spinners();
+	dispatcher.stop();
+}
+
+void MavRos::stop_spinners()
+{
+	for (auto &q : spinner_queues)
+		q.spinner->stop();
+}
+
+void MavRos::fcu_protocol_cb(MAVConnInterface *link, const mavlink_message_t *mmsg)
+{
+	using mavlink::common::MAV_COMPONENT;
+
+	// FCU autopilot heartbeats only: GCS or companion on same link tell nothing
+	if (mmsg->sysid == link->get_system_id() ||
+			mmsg->compid != enum_value(MAV_COMPONENT::COMP_ID_AUTOPILOT1))
+		return;
+
+	if (!fcu_protocol_negotiator.heartbeat(mmsg->magic == MAVLINK_STX))
+		return;
+
+	const bool v1 = fcu_protocol_negotiator.use_v1();
+	link->set_protocol_version(v1 ? mavconn::Protocol::V10 : mavconn::Protocol::V20);
+	ROS_INFO("FCU: MAVLink protocol negotiated: %s", v1 ? "v1.0" : "v2.0");
+}
+
+void MavRos::dispatch_cb(const mavlink_message_t *mmsg, const Framing framing, uint64_t rx_stamp_ns, size_t worker)
+{
+	// handlers of this thread get arrival time by UAS::get_rx_stamp()
+	UAS::set_rx_stamp(rx_stamp_ns);
+	MAVROS_TRACE_BEGIN(mmsg->msgid, rx_stamp_ns);
+
+	if (shard_routes.empty()) {
+		stream_stats_tick(mmsg, framing, rx_stamp_ns);
+		mavlink_pub_cb(mmsg, framing);
+		if (multi_vehicle)
+			vehicle_route_cb(mmsg, framing);
+		else
+			plugin_route_cb(plugin_routes, mmsg, framing);
+	}
+	else {
+		// plugin shards: message copied to several workers, publish it only once
+		if (worker == mmsg->msgid % shard_routes.size()) {
+			stream_stats_tick(mmsg, framing, rx_stamp_ns);
+			mavlink_pub_cb(mmsg, framing);
+		}
+
+		plugin_route_cb(shard_routes[worker], mmsg, framing);
+	}
+
+	MAVROS_TRACE_END();
+}
+
+/**
+ * @brief Assign subscribed msgids to dispatch workers
+ *
+ * msgid shard: subscribed msgids distributed round-robin,
+ * so all handlers of one msgid run in one worker,
+ * but handlers of one plugin may run in several workers at once.
+ *
+ * plugin shard: message copied to every worker having handler for it,
+ * plus worker (msgid % nworkers) which publish it to ROS.
+ */
+void MavRos::setup_dispatch_routes(size_t nworkers)
+{
+	using WorkerMask = Dispatcher::WorkerMask;
+
+	if (nworkers < 2)
+		return;
+
+	if (shard_subscriptions.empty()) {
+		std::vector<mavlink::msgid_t> msgids;
+		for (auto &p : plugin_subscriptions)
+			msgids.push_back(p.first);
+
+		std::sort(msgids.begin(), msgids.end());
+		for (size_t i = 0; i < msgids.size(); i++)
+			dispatcher.set_route(msgids[i], WorkerMask(1) << (i % nworkers));
+
+		return;
+	}
+
+	std::unordered_map<mavlink::msgid_t, WorkerMask> routes;
+	for (size_t w = 0; w < shard_subscriptions.size(); w++) {
+		for (auto &p : shard_subscriptions[w])
+			routes[p.first] |= WorkerMask(1) << w;
+	}
+
+	for (auto &r : routes)
+		dispatcher.set_route(r.first, r.second | (WorkerMask(1) << (r.first % nworkers)));
+}
+
+void MavRos::stream_stats_tick(const mavlink_message_t *mmsg, const Framing framing, uint64_t rx_stamp_ns)
+{
+	if (!stream_stats_enabled || framing != Framing::ok)
+		return;
+
+	if (rx_stamp_ns == 0)
+		rx_stamp_ns = ros::WallTime::now().toNSec();
+
+	stream_stats.tick(mmsg->msgid, rx_stamp_ns);
+}
+
+void MavRos::stream_stats_publish()
+{
+	// rx stamps are CLOCK_REALTIME
+	auto stats = stream_stats.get_stats(ros::WallTime::now().toNSec());
+
+	auto msg = boost::make_shared<mavros_msgs::StreamStatusList>();
+	msg->header.stamp = ros::Time::now();
+	msg->streams.resize(stats.size());
+
+	for (size_t i = 0; i < stats.size(); i++) {
+		auto &st = stats[i];
+		auto &out = msg->streams[i];
+
+		out.msgid = st.msgid;
+		out.count = st.count;
+		out.lost = st.lost;
+		out.rate = st.rate;
+		out.jitter = st.jitter;
+		out.age = st.age;
+	}
+
+	stream_stats_pub.publish(msg);
+}
+
+void MavRos::stream_stats_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	auto stats = stream_stats.get_stats(ros::WallTime::now().toNSec());
+	auto overflow = stream_stats.overflow();
+
+	for (auto &st : stats) {
+		stat.addf(utils::format("MSG-ID %u", st.msgid), "%.1f Hz, jitter %.1f ms, lost %llu, age %.1f s",
+				st.rate, st.jitter * 1e3, (unsigned long long)st.lost, st.age);
+	}
+
+	if (overflow > 0) {
+		stat.addf("Not tracked", "%zu", overflow);
+		stat.summary(1, "too many msgids");
+	}
+	else
+		stat.summaryf(0, "%zu streams", stats.size());
+}
+
+void MavRos::trace_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	auto &trace = LatencyTrace::instance();
+	auto stats = trace.collect();
+	auto overruns = trace.overruns();
+
+	for (auto &p : stats) {
+		auto &total = p.second.total;
+
+		stat.addf(utils::format("MSG-ID %u", p.first), "p50 %.0f us, p99 %.0f us, max %.0f us, %llu frames",
+				total.quantile(0.5) * 1e6, total.quantile(0.99) * 1e6, total.max_ns * 1e-3,
+				(unsigned long long)total.count);
+
+		// median time from previous stage
+		std::string stages;
+		for (size_t i = LatencyTrace::ROUTE; i < LatencyTrace::STAGE_COUNT; i++) {
+			auto &h = p.second.stage[i];
+			if (h.count == 0)
+				continue;
+
+			stages += utils::format("%s%s %.0f", stages.empty() ? "" : ", ",
+					LatencyTrace::stage_name(LatencyTrace::Stage(i)), h.quantile(0.5) * 1e6);
+		}
+		stat.add(utils::format("MSG-ID %u stages [us]", p.first), stages);
+
+		// non empty bins, by upper bound
+		std::string bins;
+		for (size_t i = 0; i < LatencyTrace::HIST_BINS; i++) {
+			if (total.bins[i] == 0)
+				continue;
+
+			bins += utils::format("%s<%llu: %llu", bins.empty() ? "" : ", ",
+					1ULL << i, (unsigned long long)total.bins[i]);
+		}
+		stat.add(utils::format("MSG-ID %u histogram [us]", p.first), bins);
+	}
+
+	if (overruns > 0) {
+		stat.addf("Records lost", "%llu", (unsigned long long)overruns);
+		stat.summary(1, "trace rings overrun");
+	}
+	else
+		stat.summaryf(0, "%zu msgids", stats.size());
+}
+
+bool MavRos::trace_dump_cb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
+{
+	try {
+		auto nrecords = LatencyTrace::instance().dump(trace_dump_file);
+
+		res.success = true;
+		res.message = utils::format("%zu records written to %s", nrecords, trace_dump_file.c_str());
+	}
+	catch (std::exception &ex) {
+		res.success = false;
+		res.message = ex.what();
+	}
+
+	return true;
 }
 
 void MavRos::mavlink_pub_cb(const mavlink_message_t *mmsg, Framing framing)
 {
-	auto rmsg = boost::make_shared<mavros_msgs::Mavlink>();
+	if (mavlink_batch_pub.is_enabled())
+		mavlink_batch_pub.push(mmsg, framing);
 
-	if  (mavlink_pub.getNumSubscribers() == 0)
+	if (mavlink_raw_pub.has_subscribers()) {
+		auto raw = mavlink_raw_pool.acquire();
+
+		raw->header.stamp = UAS::get_rx_stamp();
+		mavros_msgs::mavlink::convert(*mmsg, *raw, enum_value(framing));
+		mavlink_raw_pub.publish(raw);
+	}
+
+	if (!mavlink_pub.has_subscribers())
 		return;
 
-	rmsg->header.stamp = ros::Time::now();
+	auto rmsg = boost::make_shared<mavros_msgs::Mavlink>();
+
+	rmsg->header.stamp = UAS::get_rx_stamp();
 	mavros_msgs::mavlink::convert(*mmsg, *rmsg, enum_value(framing));
 	mavlink_pub.publish(rmsg);
 }
@@ -226,14 +724,36 @@ void MavRos::mavlink_sub_cb(const mavros_msgs::Mavlink::ConstPtr &rmsg)
 		ROS_ERROR("Drop mavlink packet: convert error.");
 }
 
-void MavRos::plugin_route_cb(const mavlink_message_t *mmsg, const Framing framing)
+void MavRos::mavlink_raw_sub_cb(const mavros_msgs::MavlinkRaw::ConstPtr &rmsg)
 {
-	auto it = plugin_subscriptions.find(mmsg->msgid);
-	if (it == plugin_subscriptions.end())
+	if (!mavros_msgs::mavlink::is_valid(*rmsg)) {
+		ROS_ERROR("Drop raw mavlink packet: bad frame.");
 		return;
+	}
+
+	try {
+		UAS_FCU(&mav_uas)->send_bytes(rmsg->data.data(), rmsg->data.size());
+	}
+	catch (std::length_error &ex) {
+		ROS_ERROR_THROTTLE(1, "Drop raw mavlink packet: %s", ex.what());
+	}
+}
+
+void MavRos::mavlink_batch_sub_cb(const mavros_msgs::MavlinkBatch::ConstPtr &batch)
+{
+	auto fcu_link = UAS_FCU(&mav_uas);
+	auto errors = unpack_batch(*batch, [&fcu_link](const mavlink_message_t *mmsg) {
+				fcu_link->send_message_ignore_drop(mmsg);
+			});
+
+	if (errors)
+		ROS_ERROR("Drop %zu mavlink packet(s) of batch: convert error.", errors);
+}
 
-	for (auto &info : it->second)
-		std::get<3>(info)(mmsg, framing);
+void MavRos::plugin_route_cb(const RouteTable &routes, const mavlink_message_t *mmsg, const Framing framing)
+{
+	MAVROS_TRACE_MARK(ROUTE);
+	routes.route(mmsg, framing);
 }
 
 static bool pattern_match(std::string &pattern, std::string &pl_name)
@@ -285,6 +805,59 @@ inline bool is_mavlink_message_t(const size_t rt)
 	return h == rt;
 }
 
+/**
+ * @brief Add plugin handler to subscriptions map
+ *
+ * @return false if handler dropped: msgid already routed to different message type
+ */
+static bool add_route(RouteTable::SubscriptionsMap &subscriptions, const PluginBase::HandlerInfo &info, const std::string &pl_name)
+{
+	auto msgid = std::get<0>(info);
+	auto msgname = std::get<1>(info);
+	auto type_hash_ = std::get<2>(info);
+
+	std::string log_msgname;
+
+	if (is_mavlink_message_t(type_hash_))
+		log_msgname = utils::format("MSG-ID (%u) <%zu>", msgid, type_hash_);
+	else
+		log_msgname = utils::format("%s (%u) <%zu>", msgname, msgid, type_hash_);
+
+	ROS_DEBUG_STREAM("Route " << log_msgname << " to " << pl_name);
+
+	auto it = subscriptions.find(msgid);
+	if (it == subscriptions.end()) {
+		// new entry
+
+		ROS_DEBUG_STREAM(log_msgname << " - new element");
+		subscriptions[msgid] = PluginBase::Subscriptions{{info}};
+		return true;
+	}
+
+	// existing: check handler message type
+
+	bool append_allowed = is_mavlink_message_t(type_hash_);
+	if (!append_allowed) {
+		append_allowed = true;
+		for (auto &e : it->second) {
+			auto t2 = std::get<2>(e);
+			if (!is_mavlink_message_t(t2) && t2 != type_hash_) {
+				ROS_ERROR_STREAM(log_msgname << " routed to different message type (hash: " << t2 << ")");
+				append_allowed = false;
+			}
+		}
+	}
+
+	if (!append_allowed) {
+		ROS_ERROR_STREAM(log_msgname << " handler dropped because this ID are used for another message type");
+		return false;
+	}
+
+	ROS_DEBUG_STREAM(log_msgname << " - emplace");
+	it->second.emplace_back(info);
+	return true;
+}
+
 /**
  * @brief Loads plugin (if not blacklisted)
  */
@@ -296,62 +869,341 @@ void MavRos::add_plugin(std::string &pl_name, ros::V_string &blacklist, ros::V_s
 	}
 
 	try {
+		auto start = ros::WallTime::now();
 		auto plugin = plugin_loader.createInstance(pl_name);
+		auto load_time = ros::WallTime::now() - start;
 
-		ROS_INFO_STREAM("Plugin " << pl_name << " loaded");
+		ros::CallbackQueueInterface *queue = find_callback_queue(pl_name);
+		auto stats = add_plugin_stats(pl_name, queue);
+		plugin->set_callback_queue(queue);
+		plugin->set_plugin_stats(stats);
+
+		ROS_INFO_STREAM("Plugin " << pl_name << " loaded in " << load_time.toSec() << " s");
+
+		// plugin shard mode: all handlers of plugin run in one worker
+		auto shard = shard_subscriptions.empty() ? 0 : loaded_plugins.size() % shard_subscriptions.size();
 
 		for (auto &info : plugin->get_subscriptions()) {
-			auto msgid = std::get<0>(info);
-			auto msgname = std::get<1>(info);
-			auto type_hash_ = std::get<2>(info);
+			std::get<3>(info).set_stats(stats);
+			if (add_route(plugin_subscriptions, info, pl_name) && !shard_subscriptions.empty())
+				shard_subscriptions[shard][std::get<0>(info)].emplace_back(info);
+		}
+
+		loaded_plugins.push_back(plugin);
+		plugin_timings.push_back(PluginTiming {pl_name, load_time, ros::WallDuration(0.0), shard});
+	} catch (pluginlib::PluginlibException &ex) {
+		ROS_ERROR_STREAM("Plugin " << pl_name << " load exception: " << ex.what());
+	}
+}
+
+void MavRos::initialize_plugin(size_t idx)
+{
+	auto &timing = plugin_timings[idx];
 
-			std::string log_msgname;
+	auto start = ros::WallTime::now();
+	loaded_plugins[idx]->initialize(mav_uas);
+	timing.init_time = ros::WallTime::now() - start;
 
-			if (is_mavlink_message_t(type_hash_))
-				log_msgname = utils::format("MSG-ID (%u) <%zu>", msgid, type_hash_);
-			else
-				log_msgname = utils::format("%s (%u) <%zu>", msgname, msgid, type_hash_);
+	if (!shard_subscriptions.empty())
+		ROS_INFO_STREAM("Plugin " << timing.name << " initialized in " << timing.init_time.toSec() <<
+				" s, dispatch worker " << timing.shard);
+	else
+		ROS_INFO_STREAM("Plugin " << timing.name << " initialized in " << timing.init_time.toSec() << " s");
+}
 
-			ROS_DEBUG_STREAM("Route " << log_msgname << " to " << pl_name);
+void MavRos::initialize_plugins(size_t nthreads, ros::V_string &serial)
+{
+	std::vector<size_t> concurrent;
+
+	// plugins from serial list (they use not thread safe parts, like diagnostic updater)
+	// initialized first, in declaration order
+	for (size_t i = 0; i < loaded_plugins.size(); i++) {
+		bool is_serial = nthreads <= 1;
+		for (auto &pattern : serial) {
+			if (is_serial)
+				break;
+			is_serial = pattern_match(pattern, plugin_timings[i].name);
+		}
 
-			auto it = plugin_subscriptions.find(msgid);
-			if (it == plugin_subscriptions.end()) {
-				// new entry
+		if (is_serial)
+			initialize_plugin(i);
+		else
+			concurrent.push_back(i);
+	}
 
-				ROS_DEBUG_STREAM(log_msgname << " - new element");
-				plugin_subscriptions[msgid] = PluginBase::Subscriptions{{info}};
-			}
-			else {
-				// existing: check handler message type
-
-				bool append_allowed = is_mavlink_message_t(type_hash_);
-				if (!append_allowed) {
-					append_allowed = true;
-					for (auto &e : it->second) {
-						auto t2 = std::get<2>(e);
-						if (!is_mavlink_message_t(t2) && t2 != type_hash_) {
-							ROS_ERROR_STREAM(log_msgname << " routed to different message type (hash: " << t2 << ")");
-							append_allowed = false;
-						}
+	if (concurrent.empty())
+		return;
+
+	// rest of plugins do param reads, advertise and subscribe: master round trips
+	std::atomic<size_t> next(0);
+	std::vector<std::exception_ptr> errors(concurrent.size());
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < std::min(nthreads, concurrent.size()); t++) {
+		threads.emplace_back([&]() {
+				for (size_t n = next++; n < concurrent.size(); n = next++) {
+					try {
+						initialize_plugin(concurrent[n]);
+					}
+					catch (...) {
+						errors[n] = std::current_exception();
 					}
 				}
+			});
+	}
 
-				if (append_allowed) {
-					ROS_DEBUG_STREAM(log_msgname << " - emplace");
-					it->second.emplace_back(info);
+	for (auto &th : threads)
+		th.join();
+
+	// same exception as in serial mode
+	for (auto &e : errors) {
+		if (e)
+			std::rethrow_exception(e);
+	}
+}
+
+void MavRos::plugin_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	ros::WallDuration total_load(0.0), total_init(0.0);
+	const PluginTiming *slowest = nullptr;
+
+	for (auto &t : plugin_timings) {
+		stat.addf(t.name, "load %.3f s, init %.3f s", t.load_time.toSec(), t.init_time.toSec());
+
+		total_load += t.load_time;
+		total_init += t.init_time;
+		if (!slowest || t.load_time + t.init_time > slowest->load_time + slowest->init_time)
+			slowest = &t;
+	}
+
+	if (slowest)
+		stat.summaryf(0, "%zu plugins, load %.3f s, init %.3f s, slowest %s",
+				plugin_timings.size(), total_load.toSec(), total_init.toSec(), slowest->name.c_str());
+	else
+		stat.summary(0, "no plugins");
+}
+
+plugin::PluginStats *MavRos::add_plugin_stats(const std::string &name, ros::CallbackQueueInterface *&queue)
+{
+	if (!plugin_stats_enabled)
+		return nullptr;
+
+	PluginAccount account{};
+	account.name = name;
+	account.stats = std::make_shared<plugin::PluginStats>();
+	account.queue.reset(new plugin::StatsCallbackQueue(
+				queue ? queue : ros::getGlobalCallbackQueue(), account.stats));
+	account.last_cycles = 0;
+
+	queue = account.queue.get();
+	auto stats = account.stats.get();
+
+	std::lock_guard<std::mutex> lock(plugin_stats_mutex);
+	plugin_accounts.emplace_back(std::move(account));
+	return stats;
+}
+
+/**
+ * @brief Per plugin calls, time and busy share since previous run
+ *
+ * Busy is wall time (TSC) spent in handlers and callbacks per period,
+ * it includes preemption and blocking, so it is not CPU usage.
+ */
+void MavRos::plugin_stats_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	auto now = ros::WallTime::now();
+	const double period = (now - plugin_stats_last).toSec();
+	const double cps = plugin::PluginStats::cycles_per_second();
+	const bool allocs = plugin::PluginStats::alloc_stats_enabled();
+	plugin_stats_last = now;
+
+	double total_load = 0.0, hottest_load = -1.0;
+	std::string hottest;
+
+	std::lock_guard<std::mutex> lock(plugin_stats_mutex);
+	for (auto &a : plugin_accounts) {
+		auto &h = a.stats->handlers;
+		auto &c = a.stats->callbacks;
+
+		const uint64_t h_cycles = h.cycles.load(std::memory_order_relaxed);
+		const uint64_t c_cycles = c.cycles.load(std::memory_order_relaxed);
+		const double load = (period > 0.0) ? 100.0 * (h_cycles + c_cycles - a.last_cycles) / cps / period : 0.0;
+		a.last_cycles = h_cycles + c_cycles;
+
+		auto line = utils::format("%.1f%% busy; handlers %llu calls, %.3f s, max %.1f us; callbacks %llu calls, %.3f s, max %.1f us",
+				load,
+				(unsigned long long) h.calls.load(std::memory_order_relaxed), h_cycles / cps,
+				1e6 * h.max_cycles.load(std::memory_order_relaxed) / cps,
+				(unsigned long long) c.calls.load(std::memory_order_relaxed), c_cycles / cps,
+				1e6 * c.max_cycles.load(std::memory_order_relaxed) / cps);
+
+		if (allocs)
+			line += utils::format("; allocs %llu",
+					(unsigned long long) (h.allocs.load(std::memory_order_relaxed) + c.allocs.load(std::memory_order_relaxed)));
+
+		stat.add(a.name, line);
+
+		total_load += load;
+		if (load > hottest_load) {
+			hottest_load = load;
+			hottest = a.name;
+		}
+	}
+
+	if (hottest_load >= 0.0)
+		stat.summaryf(0, "%zu plugins, %.1f%% busy, hottest %s %.1f%%",
+				plugin_accounts.size(), total_load, hottest.c_str(), hottest_load);
+	else
+		stat.summary(0, "no plugins");
+}
+
+void MavRos::vehicle_route_cb(const mavlink_message_t *mmsg, const Framing framing)
+{
+	auto vehicle = vehicle_by_sysid[mmsg->sysid].load(std::memory_order_acquire);
+	if (vehicle) {
+		plugin_route_cb(vehicle->routes, mmsg, framing);
+		return;
+	}
+
+	// new vehicle is announced by autopilot HEARTBEAT, GCS and companions are not served
+	if (framing != Framing::ok || mmsg->msgid != mavlink::common::msg::HEARTBEAT::MSG_ID ||
+			vehicle_pending[mmsg->sysid].load(std::memory_order_relaxed))
+		return;
+
+	mavlink::MsgMap map(mmsg);
+	mavlink::common::msg::HEARTBEAT hb;
+	hb.deserialize(map);
+
+	if (hb.autopilot == enum_value(mavlink::common::MAV_AUTOPILOT::INVALID))
+		return;
+	if (!vehicle_sysids.empty() &&
+			std::find(vehicle_sysids.begin(), vehicle_sysids.end(), mmsg->sysid) == vehicle_sysids.end())
+		return;
+
+	vehicle_pending[mmsg->sysid].store(true, std::memory_order_release);
+}
+
+void MavRos::vehicle_timer_cb()
+{
+	std::unique_lock<std::mutex> lock(vehicle_create_mutex, std::try_to_lock);
+	if (!lock)
+		return;
+
+	// sysid 0 is broadcast
+	for (size_t sysid = 1; sysid < vehicle_pending.size(); sysid++) {
+		if (!vehicle_pending[sysid].load(std::memory_order_acquire) ||
+				vehicle_by_sysid[sysid].load(std::memory_order_relaxed))
+			continue;
+
+		if (vehicles.size() >= size_t(std::max(max_vehicles, 0))) {
+			ROS_WARN_THROTTLE(10, "Multi-vehicle: limit of %d vehicles reached, sysid %zu not served",
+					max_vehicles, sysid);
+			return;
+		}
+
+		create_vehicle(sysid);
+	}
+}
+
+/**
+ * @brief Create UAS and plugins of vehicle @a sysid
+ *
+ * Plugins loaded and initialized serially in caller (ROS) thread,
+ * their node handles are in vehicle namespace.
+ * Dispatch workers see the vehicle after its route table is built.
+ */
+void MavRos::create_vehicle(uint8_t sysid)
+{
+	auto start = ros::WallTime::now();
+
+	std::unique_ptr<Vehicle> vehicle(new Vehicle());
+	vehicle->sysid = sysid;
+	vehicle->uas.reset(new UAS());
+
+	auto uas = vehicle->uas.get();
+	uas->set_tgt(sysid, vehicle_tgt_component);
+	UAS_FCU(uas) = UAS_FCU(&mav_uas);
+	UAS_DIAG(uas).setHardwareID(utils::format("%s sysid %u", vehicle_hw_id.c_str(), sysid));
+	setup_tf_aggregator(node_nh, *uas);
+	setup_stream_demand(node_nh, *uas);
+	setup_timer_wheel(node_nh, *uas);
+
+	uas->add_connection_change_handler([this, sysid](bool connected) {
+				// called on change only, so counter stays balanced
+				if (connected) {
+					if (vehicles_connected.fetch_add(1) == 0)
+						fcu_link_diag.set_connection_status(true);
+					ROS_INFO("CON: vehicle %u: got HEARTBEAT, connected.", sysid);
 				}
-				else
-					ROS_ERROR_STREAM(log_msgname << " handler dropped because this ID are used for another message type");
+				else {
+					if (vehicles_connected.fetch_sub(1) == 1)
+						fcu_link_diag.set_connection_status(false);
+					ROS_WARN("CON: vehicle %u: lost connection, HEARTBEAT timed out.", sysid);
+				}
+			});
+
+	// plugins take node handles in constructors
+	PluginBase::construct_namespace = utils::format("~%s%u", vehicle_prefix.c_str(), sysid);
+
+	SubscriptionsMap subscriptions;
+	for (auto &name : plugin_loader.getDeclaredClasses()) {
+		if (is_blacklisted(name, plugin_blacklist, plugin_whitelist))
+			continue;
+
+		try {
+			auto plugin = plugin_loader.createInstance(name);
+
+			ros::CallbackQueueInterface *queue = find_callback_queue(name);
+			auto stats = add_plugin_stats(utils::format("%s%u/%s", vehicle_prefix.c_str(), sysid, name.c_str()), queue);
+			plugin->set_callback_queue(queue);
+			plugin->set_plugin_stats(stats);
+
+			for (auto &info : plugin->get_subscriptions()) {
+				std::get<3>(info).set_stats(stats);
+				add_route(subscriptions, info, name);
 			}
+
+			vehicle->plugins.push_back(plugin);
+		}
+		catch (pluginlib::PluginlibException &ex) {
+			ROS_ERROR_STREAM("Vehicle " << int(sysid) << ": plugin " << name << " load exception: " << ex.what());
 		}
+	}
 
-		plugin->initialize(mav_uas);
-		loaded_plugins.push_back(plugin);
+	PluginBase::construct_namespace.clear();
 
-		ROS_INFO_STREAM("Plugin " << pl_name << " initialized");
-	} catch (pluginlib::PluginlibException &ex) {
-		ROS_ERROR_STREAM("Plugin " << pl_name << " load exception: " << ex.what());
+	for (auto &plugin : vehicle->plugins)
+		plugin->initialize(*uas);
+
+	vehicle->routes.build(subscriptions);
+
+	ROS_INFO("Multi-vehicle: vehicle %u: %zu plugins started in %.3f s, namespace %s%u",
+			sysid, vehicle->plugins.size(), (ros::WallTime::now() - start).toSec(),
+			vehicle_prefix.c_str(), sysid);
+
+	auto vehicle_p = vehicle.get();
+	{
+		std::lock_guard<std::mutex> lock(vehicles_mutex);
+		vehicles.push_back(std::move(vehicle));
 	}
+
+	vehicle_by_sysid[sysid].store(vehicle_p, std::memory_order_release);
+}
+
+void MavRos::vehicles_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	std::lock_guard<std::mutex> lock(vehicles_mutex);
+
+	size_t connected = 0;
+	for (auto &v : vehicles) {
+		if (v->uas->is_connected())
+			connected++;
+
+		stat.addf(utils::format("Vehicle %u", v->sysid), "%s, %zu plugins",
+				v->uas->is_connected() ? "connected" : "not connected", v->plugins.size());
+	}
+
+	stat.summaryf(0, "%zu vehicles, %zu connected", vehicles.size(), connected);
 }
 
 void MavRos::startup_px4_usb_quirk()
@@ -376,3 +1228,206 @@ void MavRos::log_connect_change(bool connected)
 	else
 		ROS_WARN("CON: Lost connection, HEARTBEAT timed out.");
 }
+
+/**
+ * @brief Setup rate limiter of messages forwarded to GCS link
+ *
+ * @return true if link budget should be taken from RADIO_STATUS received on GCS link
+ */
+bool MavRos::setup_gcs_limits(const ros::NodeHandle &nh)
+{
+	double byte_rate, burst;
+	bool use_fcu_radio_status;
+	std::map<std::string, double> msg_rates{};
+	std::vector<int> allow{}, deny{}, priority{};
+
+	nh.param("gcs_limits/byte_rate", byte_rate, 0.0);
+	nh.param("gcs_limits/burst", burst, 0.5);
+	nh.param("gcs_limits/use_fcu_radio_status", use_fcu_radio_status, false);
+	nh.getParam("gcs_limits/msg_rate", msg_rates);
+	nh.getParam("gcs_limits/allow", allow);
+	nh.getParam("gcs_limits/deny", deny);
+	nh.getParam("gcs_limits/priority", priority);
+
+	if (byte_rate <= 0 && msg_rates.empty() && allow.empty() && deny.empty())
+		return false;
+
+	gcs_limiter = std::make_shared<mavconn::TxRateLimiter>();
+	gcs_limiter->set_byte_rate(byte_rate, burst);
+	gcs_limiter->set_allow(std::vector<mavlink::msgid_t>(allow.begin(), allow.end()));
+	gcs_limiter->set_deny(std::vector<mavlink::msgid_t>(deny.begin(), deny.end()));
+	gcs_limiter->set_priority(std::vector<mavlink::msgid_t>(priority.begin(), priority.end()));
+
+	for (auto &p : msg_rates) {
+		try {
+			gcs_limiter->set_msg_rate(std::stoul(p.first), p.second);
+		}
+		catch (std::logic_error &) {
+			ROS_WARN("GCS: bad msgid in gcs_limits/msg_rate: \"%s\"", p.first.c_str());
+		}
+	}
+
+	ROS_INFO("GCS: rate limit %.0f B/s, %zu msgid rate caps, %zu allowed, %zu denied",
+			byte_rate, msg_rates.size(), allow.size(), deny.size());
+
+	gcs_diag_updater.add("GCS rate limit", [this](diagnostic_updater::DiagnosticStatusWrapper &stat) {
+				auto st = gcs_limiter->get_stat();
+
+				stat.addf("Passed", "%zu", st.passed);
+				stat.addf("Denied", "%zu", st.denied);
+				stat.addf("Decimated", "%zu", st.decimated);
+				stat.addf("Dropped", "%zu", st.dropped);
+				stat.addf("Budget scale", "%.2f", st.budget_scale);
+
+				if (st.budget_scale < 1.0)
+					stat.summary(1, "radio Tx buffer low, budget reduced");
+				else
+					stat.summary(0, "ok");
+			});
+
+	if (use_fcu_radio_status) {
+		mav_uas.add_link_budget_handler([this](uint8_t txbuf) {
+					gcs_limiter->update_link_budget(txbuf);
+				});
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Setup callback queues of plugin groups
+ *
+ * Each group in spinner/queues gets own queue and spinner, so e.g.
+ * setpoint subscribers do not wait for threads blocked in bulk transfer services.
+ */
+void MavRos::setup_spinner_queues(const ros::NodeHandle &nh)
+{
+	ros::V_string names{};
+
+	nh.param("spinner/threads", spinner_threads, 4);
+	nh.getParam("spinner/queues", names);
+	spinner_threads = std::max(spinner_threads, 1);
+
+	for (auto &name : names) {
+		SpinnerQueue q{};
+		q.name = name;
+		nh.param("spinner/" + name + "/threads", q.threads, 1);
+		nh.getParam("spinner/" + name + "/plugins", q.plugins);
+		q.threads = std::max(q.threads, 1);
+
+		if (q.plugins.empty()) {
+			ROS_WARN("SPIN: queue \"%s\" has no plugins, skipped", name.c_str());
+			continue;
+		}
+
+		q.queue.reset(new ros::CallbackQueue());
+		q.spinner.reset(new ros::AsyncSpinner(q.threads, q.queue.get()));
+
+		ROS_INFO("SPIN: queue \"%s\": %d threads, %zu plugin patterns", name.c_str(), q.threads, q.plugins.size());
+		spinner_queues.emplace_back(std::move(q));
+	}
+}
+
+ros::CallbackQueue *MavRos::find_callback_queue(std::string &pl_name)
+{
+	for (auto &q : spinner_queues) {
+		for (auto &pattern : q.plugins) {
+			if (pattern_match(pattern, pl_name)) {
+				ROS_DEBUG_STREAM("Plugin " << pl_name << " callbacks in queue " << q.name);
+				return q.queue.get();
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Setup batching and rate caps of plugin TF broadcasts
+ */
+void MavRos::setup_tf_aggregator(const ros::NodeHandle &nh, UAS &uas)
+{
+	double rate, max_frame_rate;
+	std::map<std::string, double> frame_rates{};
+
+	nh.param("tf_aggregator/rate", rate, 50.0);
+	nh.param("tf_aggregator/max_frame_rate", max_frame_rate, 0.0);
+	nh.getParam("tf_aggregator/frame_rates", frame_rates);
+
+	auto &aggregator = uas.tf_aggregator;
+	aggregator.set_default_max_rate(max_frame_rate);
+	for (auto &p : frame_rates)
+		aggregator.set_max_rate(p.first, p.second);
+
+	aggregator.start(mavlink_nh, rate);
+
+	UAS_DIAG(&uas).add("TF aggregator", [&uas](diagnostic_updater::DiagnosticStatusWrapper &stat) {
+				auto st = uas.tf_aggregator.get_stat();
+
+				stat.addf("Published transforms", "%zu", st.published);
+				stat.addf("Coalesced transforms", "%zu", st.coalesced);
+				stat.addf("TF messages", "%zu", st.messages);
+				stat.summary(0, "ok");
+			});
+}
+
+void MavRos::setup_stream_demand(const ros::NodeHandle &nh, UAS &uas)
+{
+	bool enable;
+	double period, idle_rate;
+
+	nh.param("stream_demand/enable", enable, false);
+	nh.param("stream_demand/period", period, 1.0);
+	nh.param("stream_demand/idle_rate", idle_rate, double(StreamDemand::RATE_DISABLED));
+
+	// rates/<plugin>/<topic>: [Hz] while topic has subscribers
+	ros::NodeHandle rates_nh(nh, "stream_demand/rates");
+	uas.stream_demand.configure(enable, period, idle_rate, [rates_nh](const std::string &key, double default_rate) {
+				double rate;
+				rates_nh.param(key, rate, default_rate);
+				return rate;
+			});
+}
+
+/**
+ * @brief Setup resolution and start thread of plugin timers
+ */
+void MavRos::setup_timer_wheel(const ros::NodeHandle &nh, UAS &uas)
+{
+	double tick;
+
+	nh.param("timer_wheel/tick", tick, 0.001);
+
+	auto &wheel = uas.timer_wheel;
+	if (tick > 0.0)
+		wheel.set_tick(std::chrono::duration_cast<TimerWheel::Clock::duration>(
+					std::chrono::duration<double>(tick)));
+	wheel.start();
+
+	UAS_DIAG(&uas).add("Timer wheel", [&uas](diagnostic_updater::DiagnosticStatusWrapper &stat) {
+				auto &wheel = uas.timer_wheel;
+
+				stat.addf("Tick [s]", "%g", std::chrono::duration<double>(wheel.get_tick()).count());
+				stat.addf("Armed timers", "%zu", wheel.armed_count());
+				stat.summary(0, "ok");
+			});
+}
+
+void MavRos::router_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat, const std::vector<std::string> &names)
+{
+	size_t overflow = 0;
+
+	for (size_t i = 0; i < router->size(); i++) {
+		auto st = router->get_stat(i);
+		overflow += st.overflow;
+
+		stat.addf(names[i], "rx %zu, tx %zu, filtered %zu, overflow %zu",
+				st.rx, st.tx, st.filtered, st.overflow);
+	}
+
+	if (overflow > 0)
+		stat.summaryf(1, "%zu messages dropped on Tx queue overflow", overflow);
+	else
+		stat.summary(0, "ok");
+}
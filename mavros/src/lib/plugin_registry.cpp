@@ -0,0 +1,100 @@
+/**
+ * @brief Plugin factory: pluginlib or compile-time registry
+ * @file plugin_registry.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <map>
+#include <mavros/plugin_registry.h>
+
+#ifndef MAVROS_STATIC_PLUGINS
+#include <pluginlib/class_loader.h>
+#endif
+
+using namespace mavros::plugin;
+
+#ifdef MAVROS_STATIC_PLUGINS
+
+//! registrations run from static constructors of other units: construct on first use
+static std::map<std::string, PluginRegistry::Factory> &class_table()
+{
+	static std::map<std::string, PluginRegistry::Factory> table;
+	return table;
+}
+
+//! plugin name -> class type
+static std::map<std::string, std::string> &name_table()
+{
+	static std::map<std::string, std::string> table;
+	return table;
+}
+
+PluginRegistry::ClassEntry::ClassEntry(const char *type, Factory factory)
+{
+	class_table()[type] = factory;
+}
+
+PluginRegistry::NameEntry::NameEntry(const char *name, const char *type)
+{
+	name_table()[name] = type;
+}
+
+PluginRegistry::PluginRegistry()
+{ }
+
+std::vector<std::string> PluginRegistry::getDeclaredClasses()
+{
+	// plugins not built (e.g. their dialect pruned) are not declared
+	std::vector<std::string> names;
+	names.reserve(name_table().size());
+	for (auto &p : name_table()) {
+		if (class_table().count(p.second))
+			names.push_back(p.first);
+	}
+
+	return names;
+}
+
+PluginBase::Ptr PluginRegistry::createInstance(const std::string &name)
+{
+	auto nit = name_table().find(name);
+	if (nit == name_table().end())
+		throw pluginlib::CreateClassException("Unknown plugin " + name);
+
+	auto cit = class_table().find(nit->second);
+	if (cit == class_table().end())
+		throw pluginlib::CreateClassException("Plugin " + name + " class " + nit->second + " not linked in");
+
+	return cit->second();
+}
+
+#else
+
+PluginRegistry::ClassEntry::ClassEntry(const char *type, Factory factory)
+{ }
+
+PluginRegistry::NameEntry::NameEntry(const char *name, const char *type)
+{ }
+
+PluginRegistry::PluginRegistry() :
+	loader(std::make_shared<pluginlib::ClassLoader<PluginBase>>("mavros", "mavros::plugin::PluginBase"))
+{ }
+
+std::vector<std::string> PluginRegistry::getDeclaredClasses()
+{
+	return loader->getDeclaredClasses();
+}
+
+PluginBase::Ptr PluginRegistry::createInstance(const std::string &name)
+{
+	return loader->createInstance(name);
+}
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @brief Per plugin handler accounting
+ * @file plugin_stats.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <new>
+#include <cstdlib>
+#include <boost/make_shared.hpp>
+#include <mavros/plugin_stats.h>
+
+using namespace mavros::plugin;
+
+thread_local uint64_t PluginStats::thread_allocs = 0;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+//! reference point of cycles_per_second()
+const Clock::time_point start_time = Clock::now();
+const uint64_t start_cycles = PluginStats::cycles();
+
+/**
+ * @brief Callback accounted to plugin
+ */
+class StatsCallback : public ros::CallbackInterface {
+public:
+	StatsCallback(const ros::CallbackInterfacePtr &callback_, const PluginStats::Ptr &stats_) :
+		callback(callback_),
+		stats(stats_)
+	{ }
+
+	CallResult call() override {
+		PluginStats::Scope scope(stats->callbacks);
+		return callback->call();
+	}
+
+	bool ready() override {
+		return callback->ready();
+	}
+
+private:
+	ros::CallbackInterfacePtr callback;
+	PluginStats::Ptr stats;		//!< callback may stay in queue after plugin
+};
+}	// namespace
+
+double PluginStats::cycles_per_second()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	const auto elapsed = std::chrono::duration<double>(Clock::now() - start_time).count();
+	if (elapsed <= 0.0)
+		return 1e9;
+
+	return (cycles() - start_cycles) / elapsed;
+#else
+	return 1e9;
+#endif
+}
+
+bool PluginStats::alloc_stats_enabled()
+{
+#ifdef MAVROS_ALLOC_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void StatsCallbackQueue::addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id)
+{
+	target->addCallback(boost::make_shared<StatsCallback>(callback, stats), owner_id);
+}
+
+#ifdef MAVROS_ALLOC_STATS
+/*
+ * Counting replacement of global operator new.
+ * Array and nothrow forms call this one or malloc(), so free() matches all of them.
+ */
+void *operator new(std::size_t size)
+{
+	PluginStats::thread_allocs++;
+
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+#endif
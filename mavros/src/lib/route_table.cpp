@@ -0,0 +1,90 @@
+/**
+ * @brief Plugin message routing table
+ * @file route_table.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <mavros/route_table.h>
+
+using namespace mavros;
+using mavlink::msgid_t;
+
+constexpr size_t RouteTable::DIRECT_SIZE;
+
+
+RouteTable::RouteTable() :
+	direct{},
+	routes(1)	// index 0 reserved for "no route"
+{ }
+
+void RouteTable::build(const SubscriptionsMap &subscriptions)
+{
+	std::vector<msgid_t> msgids;
+	for (auto &p : subscriptions)
+		msgids.push_back(p.first);
+
+	if (msgids.size() >= std::numeric_limits<Index>::max())
+		throw std::length_error("RouteTable: too many msgids");
+
+	// sorted order keeps table layout independent from hash map order
+	std::sort(msgids.begin(), msgids.end());
+
+	direct.fill(0);
+	sparse.clear();
+	routes.assign(1, Route{0, 0, 0, nullptr});
+	handlers.clear();
+
+	for (auto msgid : msgids) {
+		auto &subs = subscriptions.at(msgid);
+		Index idx = routes.size();
+		Route r{};
+
+		r.begin = handlers.size();
+		for (auto &info : subs) {
+			auto &cb = std::get<3>(info);
+			if (!cb.is_typed())
+				handlers.push_back(cb);
+		}
+
+		r.typed_begin = handlers.size();
+		for (auto &info : subs) {
+			auto &cb = std::get<3>(info);
+			if (cb.is_typed()) {
+				// any fanout of same type can be used, they differ only by plugin library
+				if (r.fanout == nullptr)
+					r.fanout = cb.fanout();
+
+				handlers.push_back(cb);
+			}
+		}
+
+		r.end = handlers.size();
+		routes.push_back(r);
+
+		if (msgid < DIRECT_SIZE)
+			direct[msgid] = idx;
+		else
+			sparse.emplace_back(msgid, idx);
+	}
+}
+
+RouteTable::Index RouteTable::find_sparse(msgid_t msgid) const
+{
+	auto it = std::lower_bound(sparse.begin(), sparse.end(), msgid,
+			[](const std::pair<msgid_t, Index> &e, msgid_t id) { return e.first < id; });
+
+	if (it != sparse.end() && it->first == msgid)
+		return it->second;
+
+	return 0;
+}
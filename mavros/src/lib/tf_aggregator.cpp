@@ -0,0 +1,119 @@
+/**
+ * @brief TF broadcast aggregator
+ * @file tf_aggregator.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/tf_aggregator.h>
+
+using namespace mavros;
+
+
+TfAggregator::TfAggregator(tf2_ros::TransformBroadcaster &broadcaster_) :
+	broadcaster(broadcaster_),
+	started(false),
+	stat{}
+{ }
+
+ros::Duration TfAggregator::period_from_rate(double rate_hz)
+{
+	return (rate_hz > 0.0) ? ros::Duration(1.0 / rate_hz) : ros::Duration(0.0);
+}
+
+void TfAggregator::start(ros::NodeHandle &nh, double rate_hz)
+{
+	if (rate_hz <= 0.0) {
+		ROS_INFO("TF aggregator disabled");
+		return;
+	}
+
+	flush_timer = nh.createTimer(period_from_rate(rate_hz),
+			[this](const ros::TimerEvent &) {
+				flush();
+			});
+
+	std::lock_guard<std::mutex> lock(mutex);
+	started = true;
+
+	ROS_INFO("TF aggregator: flush rate %.1f Hz", rate_hz);
+}
+
+void TfAggregator::set_max_rate(const std::string &child_frame_id, double rate_hz)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frames[child_frame_id].min_period = period_from_rate(rate_hz);
+}
+
+void TfAggregator::set_default_max_rate(double rate_hz)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	default_min_period = period_from_rate(rate_hz);
+}
+
+void TfAggregator::send(const geometry_msgs::TransformStamped &transform)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if (!started) {
+		stat.published++;
+		stat.messages++;
+		lock.unlock();
+
+		broadcaster.sendTransform(transform);
+		return;
+	}
+
+	auto &frame = frames[transform.child_frame_id];
+	if (frame.pending)
+		stat.coalesced++;
+
+	frame.transform = transform;
+	frame.pending = true;
+}
+
+void TfAggregator::flush()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto now = ros::Time::now();
+	out.clear();
+
+	for (auto &kv : frames) {
+		auto &frame = kv.second;
+		if (!frame.pending)
+			continue;
+
+		// time may jump back on sim restart, do not hold frame in that case
+		const auto &min_period = frame.min_period.isZero() ? default_min_period : frame.min_period;
+		if (now >= frame.last_published && now - frame.last_published < min_period)
+			continue;
+
+		out.push_back(frame.transform);
+		frame.pending = false;
+		frame.last_published = now;
+	}
+
+	if (out.empty())
+		return;
+
+	// published under lock: out is reused
+	broadcaster.sendTransform(out);
+	stat.published += out.size();
+	stat.messages++;
+}
+
+TfAggregator::Stat TfAggregator::get_stat()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stat;
+}
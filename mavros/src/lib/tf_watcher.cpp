@@ -0,0 +1,193 @@
+/**
+ * @brief Shared TF listener
+ * @file tf_watcher.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup nodelib
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <algorithm>
+#include <mavros/tf_watcher.h>
+#include <mavconn/thread_utils.h>
+
+using namespace mavros;
+
+//! redelivery period of static transform when rate not limited
+static constexpr std::chrono::milliseconds STATIC_PERIOD(100);
+
+TfWatcher::TfWatcher(tf2_ros::Buffer &buffer_) :
+	buffer(buffer_),
+	last_id(0),
+	stop(false)
+{ }
+
+TfWatcher::~TfWatcher()
+{
+	if (changed_conn.connected())
+		buffer._removeTransformsChangedListener(changed_conn);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	cond.notify_all();
+
+	if (thread.joinable())
+		thread.join();
+}
+
+size_t TfWatcher::add(const std::string &name, const std::string &frame_id, const std::string &child_frame_id,
+		double rate_limit, Callback cb)
+{
+	auto w = std::make_shared<Watch>();
+	w->name = name;
+	w->frame_id = frame_id;
+	w->child_frame_id = child_frame_id;
+	w->period = (rate_limit > 0.0) ?
+			std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / rate_limit)) :
+			clock::duration::zero();
+	w->cb = cb;
+	w->pending = true;	// transform may be already in buffer
+	w->removed = false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	w->id = ++last_id;
+	watches.push_back(w);
+
+	// nor thread nor buffer listener until first watch
+	if (!thread.joinable()) {
+		changed_conn = buffer._addTransformsChangedListener(std::bind(&TfWatcher::transforms_changed, this));
+		thread = std::thread(&TfWatcher::run, this);
+	}
+
+	cond.notify_all();
+	return w->id;
+}
+
+void TfWatcher::remove(size_t id)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = std::find_if(watches.begin(), watches.end(),
+				[id](const WatchPtr &w) { return w->id == id; });
+		if (it == watches.end())
+			return;
+
+		(*it)->removed = true;
+		watches.erase(it);
+	}
+
+	// wait for delivery in progress
+	std::lock_guard<std::mutex> cb_lock(cb_mutex);
+}
+
+void TfWatcher::transforms_changed()
+{
+	// tf listener thread: only mark, lookups done by watcher
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &w : watches)
+			w->pending = true;
+	}
+	cond.notify_all();
+}
+
+void TfWatcher::run()
+{
+	mavconn::utils::set_this_thread_name("tf_watcher");
+
+	std::vector<WatchPtr> due;
+	std::vector<WatchPtr> retry;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!stop) {
+		const auto now = clock::now();
+		auto next = clock::time_point::max();
+
+		due.clear();
+		for (auto &w : watches) {
+			if (!w->pending)
+				continue;
+
+			if (w->next_due <= now) {
+				w->pending = false;
+				w->next_due = now + w->period;
+				due.push_back(w);
+			}
+			else
+				next = std::min(next, w->next_due);
+		}
+
+		if (due.empty()) {
+			if (next == clock::time_point::max())
+				cond.wait(lock);
+			else
+				cond.wait_until(lock, next);
+			continue;
+		}
+
+		lock.unlock();
+
+		retry.clear();
+		{
+			std::lock_guard<std::mutex> cb_lock(cb_mutex);
+			for (auto &w : due) {
+				// removed flag written under mutex, checked under cb_mutex: no call after remove()
+				bool removed;
+				{
+					std::lock_guard<std::mutex> l(mutex);
+					removed = w->removed;
+				}
+
+				if (!removed && deliver(*w))
+					retry.push_back(w);
+			}
+		}
+
+		lock.lock();
+		for (auto &w : retry) {
+			w->pending = true;
+
+			// static transform without rate limit: do not spin
+			if (w->period == clock::duration::zero())
+				w->next_due = clock::now() + STATIC_PERIOD;
+		}
+	}
+}
+
+bool TfWatcher::deliver(Watch &w)
+{
+	geometry_msgs::TransformStamped transform;
+
+	try {
+		transform = buffer.lookupTransform(w.frame_id, w.child_frame_id, ros::Time(0));
+	}
+	catch (tf2::TransformException &ex) {
+		// frames not published yet, next buffer change retries
+		ROS_DEBUG_THROTTLE_NAMED(10, "tf_watcher", "TF: %s: %s", w.name.c_str(), ex.what());
+		return false;
+	}
+
+	const bool is_static = transform.header.stamp.isZero();
+	if (!is_static && transform.header.stamp <= w.last_stamp)
+		return false;
+
+	w.last_stamp = transform.header.stamp;
+
+	try {
+		w.cb(transform);
+	}
+	catch (std::exception &ex) {
+		ROS_ERROR_NAMED("tf_watcher", "TF: %s: callback error: %s", w.name.c_str(), ex.what());
+	}
+
+	return is_static;
+}
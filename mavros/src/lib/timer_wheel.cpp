@@ -0,0 +1,396 @@
+/**
+ * @brief Hierarchical timer wheel
+ * @file timer_wheel.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <mavros/timer_wheel.h>
+
+using namespace mavros;
+
+constexpr size_t TimerWheel::LEVELS;
+constexpr size_t TimerWheel::SLOT_BITS;
+constexpr size_t TimerWheel::SLOTS;
+
+static constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+static constexpr uint64_t NO_EVENT = std::numeric_limits<uint64_t>::max();
+
+//! ticks covered by one slot of @a level
+static inline uint64_t level_span(size_t level)
+{
+	return uint64_t(1) << (level * TimerWheel::SLOT_BITS);
+}
+
+//! offset from @a start to first set bit, cyclic, -1 if none
+static inline int first_set_from(uint64_t mask, size_t start)
+{
+	if (!mask)
+		return -1;
+
+	const uint64_t r = (start == 0) ? mask : (mask >> start) | (mask << (64 - start));
+	return __builtin_ctzll(r);
+}
+
+
+/* -*- Timer -*- */
+
+TimerWheel::Timer::Timer() :
+	wheel(nullptr),
+	period(1),
+	oneshot(false),
+	prev(nullptr),
+	next(nullptr),
+	slot(0),
+	expires(0),
+	armed(false)
+{ }
+
+TimerWheel::Timer::~Timer()
+{
+	if (!wheel)
+		return;
+
+	unique_lock lock(wheel->mutex);
+	wheel->cancel(lock, this);
+	wheel->bound.erase(this);
+}
+
+void TimerWheel::Timer::setup(TimerWheel &wheel_, Callback cb_, double period_, bool oneshot_, bool autostart)
+{
+	if (wheel && wheel != &wheel_) {
+		unique_lock lock(wheel->mutex);
+		wheel->cancel(lock, this);
+		wheel->bound.erase(this);
+	}
+
+	unique_lock lock(wheel_.mutex);
+	wheel_.cancel(lock, this);
+	wheel_.bound.insert(this);
+
+	wheel = &wheel_;
+	cb = std::move(cb_);
+	period = wheel_.ticks_of(period_);
+	oneshot = oneshot_;
+
+	if (autostart)
+		wheel_.arm(this, wheel_.current_tick() + period);
+}
+
+void TimerWheel::Timer::start()
+{
+	if (!wheel)
+		return;
+
+	lock_guard lock(wheel->mutex);
+	if (!armed)
+		wheel->arm(this, wheel->current_tick() + period);
+}
+
+void TimerWheel::Timer::stop()
+{
+	if (!wheel)
+		return;
+
+	lock_guard lock(wheel->mutex);
+	if (armed)
+		wheel->unlink(this);
+}
+
+void TimerWheel::Timer::setPeriod(double period_)
+{
+	if (!wheel)
+		return;
+
+	lock_guard lock(wheel->mutex);
+	period = wheel->ticks_of(period_);
+	if (armed) {
+		wheel->unlink(this);
+		wheel->arm(this, wheel->current_tick() + period);
+	}
+}
+
+bool TimerWheel::Timer::hasStarted() const
+{
+	if (!wheel)
+		return false;
+
+	lock_guard lock(wheel->mutex);
+	return armed;
+}
+
+bool TimerWheel::Timer::isValid() const
+{
+	return wheel != nullptr;
+}
+
+
+/* -*- TimerWheel -*- */
+
+TimerWheel::TimerWheel(Clock::duration tick_) :
+	running(false),
+	tick(std::max(tick_, Clock::duration(1))),
+	epoch(Clock::now()),
+	now_tick(0),
+	armed_(0),
+	slots{},
+	occupied{},
+	current(nullptr),
+	wake_tick(NO_EVENT)
+{ }
+
+TimerWheel::~TimerWheel()
+{
+	stop();
+
+	lock_guard lock(mutex);
+	for (auto t : bound) {
+		t->armed = false;
+		t->wheel = nullptr;
+	}
+	bound.clear();
+}
+
+bool TimerWheel::set_tick(Clock::duration tick_)
+{
+	// periods of bound timers are in ticks
+	lock_guard lock(mutex);
+	if (running || !bound.empty())
+		return false;
+
+	tick = std::max(tick_, Clock::duration(1));
+	return true;
+}
+
+void TimerWheel::start()
+{
+	lock_guard lock(mutex);
+	if (running)
+		return;
+
+	running = true;
+	thread = std::thread(&TimerWheel::run, this);
+}
+
+void TimerWheel::stop()
+{
+	{
+		lock_guard lock(mutex);
+		if (!running)
+			return;
+
+		running = false;
+		cond.notify_all();
+	}
+
+	if (thread.joinable())
+		thread.join();
+}
+
+size_t TimerWheel::armed_count()
+{
+	lock_guard lock(mutex);
+	return armed_;
+}
+
+uint64_t TimerWheel::tick_of(Clock::time_point tp) const
+{
+	if (tp <= epoch)
+		return 0;
+
+	return (tp - epoch) / tick;
+}
+
+uint64_t TimerWheel::current_tick() const
+{
+	// wheel may be advanced ahead of clock
+	return std::max(tick_of(Clock::now()), now_tick);
+}
+
+uint64_t TimerWheel::ticks_of(double sec) const
+{
+	const double tick_sec = std::chrono::duration<double>(tick).count();
+	if (!std::isfinite(sec) || sec <= 0.0)
+		return 1;
+
+	return std::max<uint64_t>(1, std::llround(sec / tick_sec));
+}
+
+void TimerWheel::arm(Timer *t, uint64_t expires)
+{
+	// never into slot being fired
+	t->expires = std::max(expires, now_tick + 1);
+	t->armed = true;
+	armed_++;
+	link(t);
+
+	if (t->expires < wake_tick)
+		cond.notify_one();
+}
+
+void TimerWheel::link(Timer *t)
+{
+	const uint64_t delta = t->expires - now_tick;
+
+	// level l holds delta < SLOTS^(l+1), so slot index differs from current one
+	size_t level = 0;
+	while (level < LEVELS - 1 && delta >= level_span(level + 1))
+		level++;
+
+	// too far: wait in last level, re-linked on cascade
+	const uint64_t at = std::min(t->expires, now_tick + level_span(LEVELS) - 1);
+	const size_t index = (at >> (level * SLOT_BITS)) & SLOT_MASK;
+	const size_t slot = level * SLOTS + index;
+
+	t->slot = slot;
+	t->prev = nullptr;
+	t->next = slots[slot];
+	if (t->next)
+		t->next->prev = t;
+
+	slots[slot] = t;
+	occupied[level] |= uint64_t(1) << index;
+}
+
+void TimerWheel::unlink(Timer *t)
+{
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		slots[t->slot] = t->next;
+
+	if (t->next)
+		t->next->prev = t->prev;
+
+	if (!slots[t->slot]) {
+		const size_t level = t->slot / SLOTS;
+		occupied[level] &= ~(uint64_t(1) << (t->slot % SLOTS));
+	}
+
+	t->prev = t->next = nullptr;
+	t->armed = false;
+	armed_--;
+}
+
+void TimerWheel::cancel(unique_lock &lock, Timer *t)
+{
+	if (t->armed)
+		unlink(t);
+
+	// callback may use owner state, let it finish
+	while (current == t && std::this_thread::get_id() != cb_thread)
+		cb_done.wait(lock);
+}
+
+void TimerWheel::cascade(size_t level)
+{
+	const size_t slot = level * SLOTS + ((now_tick >> (level * SLOT_BITS)) & SLOT_MASK);
+
+	Timer *t = slots[slot];
+	slots[slot] = nullptr;
+	occupied[level] &= ~(uint64_t(1) << (slot % SLOTS));
+
+	while (t) {
+		Timer *next = t->next;
+		link(t);
+		t = next;
+	}
+}
+
+void TimerWheel::fire_slot(unique_lock &lock, size_t index)
+{
+	while (Timer *t = slots[index]) {
+		unlink(t);
+
+		// periodic: next expiry from this one, keeps phase
+		if (!t->oneshot)
+			arm(t, t->expires + t->period);
+
+		current = t;
+		cb_thread = std::this_thread::get_id();
+		lock.unlock();
+
+		t->cb();
+
+		lock.lock();
+		current = nullptr;
+		cb_done.notify_all();
+	}
+}
+
+uint64_t TimerWheel::next_event() const
+{
+	uint64_t event = NO_EVENT;
+
+	// level 0: slots of next SLOTS ticks
+	int k = first_set_from(occupied[0], (now_tick + 1) & SLOT_MASK);
+	if (k >= 0)
+		event = now_tick + 1 + k;
+
+	// upper levels: cascade at slot boundary
+	for (size_t level = 1; level < LEVELS; level++) {
+		const uint64_t span = level_span(level);
+		const uint64_t boundary = (now_tick / span + 1) * span;
+		if (boundary >= event)
+			break;
+
+		k = first_set_from(occupied[level], (boundary >> (level * SLOT_BITS)) & SLOT_MASK);
+		if (k >= 0)
+			event = std::min(event, boundary + k * span);
+	}
+
+	return event;
+}
+
+void TimerWheel::advance(Clock::time_point now)
+{
+	unique_lock lock(mutex);
+	const uint64_t target = tick_of(now);
+
+	while (now_tick < target) {
+		const uint64_t event = next_event();
+		if (event > target) {
+			now_tick = target;
+			break;
+		}
+
+		// nothing to do between: jump
+		now_tick = event;
+
+		for (size_t level = LEVELS - 1; level > 0; level--) {
+			if ((now_tick & (level_span(level) - 1)) == 0)
+				cascade(level);
+		}
+
+		fire_slot(lock, now_tick & SLOT_MASK);
+	}
+}
+
+void TimerWheel::run()
+{
+	unique_lock lock(mutex);
+	while (running) {
+		wake_tick = next_event();
+		if (wake_tick == NO_EVENT)
+			cond.wait(lock);
+		else
+			cond.wait_until(lock, epoch + tick * wake_tick);
+
+		if (!running)
+			break;
+
+		wake_tick = NO_EVENT;
+		lock.unlock();
+		advance(Clock::now());
+		lock.lock();
+	}
+}
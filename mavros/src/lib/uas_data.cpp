@@ -12,6 +12,7 @@
  */
 
 #include <array>
+#include <fstream>
 #include <unordered_map>
 #include <stdexcept>
 #include <mavros/mavros_uas.h>
@@ -21,36 +22,46 @@
 using namespace mavros;
 using utils::enum_value;
 
+//! samples kept for time lookups, few seconds of IMU data at usual rates
+static constexpr size_t ATTITUDE_HISTORY_SIZE = 512;
+static constexpr size_t LOCAL_POSITION_HISTORY_SIZE = 256;
+//! smallest dataset with 5' grid
+static constexpr const char *GEOID_NAME = "egm96-5";
+
 UAS::UAS() :
 	tf2_listener(tf2_buffer, true),
+	tf_aggregator(tf2_broadcaster),
+	tf_watcher(tf2_buffer),
 	type(enum_value(MAV_TYPE::GENERIC)),
 	autopilot(enum_value(MAV_AUTOPILOT::GENERIC)),
 	base_mode(0),
 	target_system(1),
 	target_component(1),
 	connected(false),
-	gps_eph(NAN),
-	gps_epv(NAN),
-	gps_fix_type(0),
-	gps_satellites_visible(0),
-	time_offset(0),
+	attitude_enu(AttitudeState{}),
+	attitude_ned(AttitudeState{}),
+	attitude_history(ATTITUDE_HISTORY_SIZE),
+	local_position_history(LOCAL_POSITION_HISTORY_SIZE),
+	gps_epts(GpsEpts{NAN, NAN, 0, 0}),
+	time_sync(TimeSyncModel {0, 0.0, 0}),
 	tsync_mode(UAS::timesync_mode::NONE),
 	fcu_caps_known(false),
 	fcu_capabilities(0)
 {
-	try {
-		// Using smallest dataset with 5' grid,
-		// From default location,
-		// Use cubic interpolation, Thread safe
-		egm96_5 = std::make_shared<GeographicLib::Geoid>("egm96-5", "", true, true);
-	}
-	catch (const std::exception &e) {
-		// catch exception and shutdown node
-		ROS_FATAL_STREAM("UAS: GeographicLib exception: " << e.what() <<
+	// Geoid dataset opened on first use, only check that it is installed
+	const std::string geoid_path = GeographicLib::Geoid::DefaultGeoidPath() + "/" + GEOID_NAME + ".pgm";
+	if (!std::ifstream(geoid_path).good()) {
+		// shutdown node, as it did on load error
+		ROS_FATAL_STREAM("UAS: GeographicLib: geoid dataset not found: " << geoid_path <<
 				" | Run install_geographiclib_dataset.sh script in order to install Geoid Model dataset!");
 		ros::shutdown();
 	}
 
+	geoid_cache.reset([this](double lat, double lon) {
+				return geoid_height(lat, lon);
+			});
+	diag_updater.add("Geoid", this, &UAS::geoid_diag_run);
+
 	// Publish helper TFs used for frame transformation in the odometry plugin
 	std::vector<geometry_msgs::TransformStamped> transform_vector;
 	add_static_transform("map", "map_ned", Eigen::Affine3d(ftf::quaternion_from_rpy(M_PI, 0, M_PI_2)),transform_vector);
@@ -86,6 +97,21 @@ void UAS::add_connection_change_handler(UAS::ConnectionCb cb)
 	connection_cb_vec.push_back(cb);
 }
 
+/* -*- radio link budget -*- */
+
+void UAS::update_link_budget(uint8_t txbuf)
+{
+	lock_guard lock(mutex);
+	for (auto &cb : link_budget_cb_vec)
+		cb(txbuf);
+}
+
+void UAS::add_link_budget_handler(UAS::LinkBudgetCb cb)
+{
+	lock_guard lock(mutex);
+	link_budget_cb_vec.push_back(cb);
+}
+
 /* -*- autopilot version -*- */
 
 static uint64_t get_default_caps(UAS::MAV_AUTOPILOT ap_type)
@@ -114,80 +140,137 @@ void UAS::update_capabilities(bool known, uint64_t caps)
 
 /* -*- IMU data -*- */
 
+static UAS::AttitudeState make_attitude_state(const sensor_msgs::Imu &imu)
+{
+	return UAS::AttitudeState {
+		true,
+		{imu.orientation.x, imu.orientation.y, imu.orientation.z, imu.orientation.w},
+		{imu.angular_velocity.x, imu.angular_velocity.y, imu.angular_velocity.z},
+	};
+}
+
+static geometry_msgs::Quaternion get_orientation(const UAS::AttitudeState &st)
+{
+	geometry_msgs::Quaternion q;
+	if (st.valid) {
+		q.x = st.orientation[0];
+		q.y = st.orientation[1];
+		q.z = st.orientation[2];
+		q.w = st.orientation[3];
+	}
+	else {
+		// fallback - return identity
+		q.w = 1.0; q.x = q.y = q.z = 0.0;
+	}
+
+	return q;
+}
+
+static geometry_msgs::Vector3 get_angular_velocity(const UAS::AttitudeState &st)
+{
+	geometry_msgs::Vector3 v;
+	if (st.valid) {
+		v.x = st.angular_velocity[0];
+		v.y = st.angular_velocity[1];
+		v.z = st.angular_velocity[2];
+	}
+	else {
+		// fallback
+		v.x = v.y = v.z = 0.0;
+	}
+
+	return v;
+}
+
 void UAS::update_attitude_imu_enu(sensor_msgs::Imu::Ptr &imu)
 {
-	lock_guard lock(mutex);
-	imu_enu_data = imu;
+	auto st = make_attitude_state(*imu);
+
+	attitude_enu.store(st);
+	attitude_history.push(imu->header.stamp.toNSec(), st);
+	boost::atomic_store(&imu_enu_data, imu);
 }
 
 void UAS::update_attitude_imu_ned(sensor_msgs::Imu::Ptr &imu)
 {
-	lock_guard lock(mutex);
-	imu_ned_data = imu;
+	attitude_ned.store(make_attitude_state(*imu));
+	boost::atomic_store(&imu_ned_data, imu);
 }
 
 sensor_msgs::Imu::Ptr UAS::get_attitude_imu_enu()
 {
-	lock_guard lock(mutex);
-	return imu_enu_data;
+	return boost::atomic_load(&imu_enu_data);
 }
 
 sensor_msgs::Imu::Ptr UAS::get_attitude_imu_ned()
 {
-	lock_guard lock(mutex);
-	return imu_ned_data;
+	return boost::atomic_load(&imu_ned_data);
 }
 
 geometry_msgs::Quaternion UAS::get_attitude_orientation_enu()
 {
-	lock_guard lock(mutex);
-	if (imu_enu_data)
-		return imu_enu_data->orientation;
-	else {
-		// fallback - return identity
-		geometry_msgs::Quaternion q;
-		q.w = 1.0; q.x = q.y = q.z = 0.0;
-		return q;
-	}
+	return get_orientation(attitude_enu.load());
 }
 
 geometry_msgs::Quaternion UAS::get_attitude_orientation_ned()
 {
-	lock_guard lock(mutex);
-	if (imu_ned_data)
-		return imu_ned_data->orientation;
-	else {
-		// fallback - return identity
-		geometry_msgs::Quaternion q;
-		q.w = 1.0; q.x = q.y = q.z = 0.0;
-		return q;
-	}
+	return get_orientation(attitude_ned.load());
 }
 
 geometry_msgs::Vector3 UAS::get_attitude_angular_velocity_enu()
 {
-	lock_guard lock(mutex);
-	if (imu_enu_data)
-		return imu_enu_data->angular_velocity;
-	else {
-		// fallback
-		geometry_msgs::Vector3 v;
-		v.x = v.y = v.z = 0.0;
-		return v;
-	}
+	return get_angular_velocity(attitude_enu.load());
 }
 
 geometry_msgs::Vector3 UAS::get_attitude_angular_velocity_ned()
 {
-	lock_guard lock(mutex);
-	if (imu_ned_data)
-		return imu_ned_data->angular_velocity;
-	else {
-		// fallback
-		geometry_msgs::Vector3 v;
-		v.x = v.y = v.z = 0.0;
-		return v;
-	}
+	return get_angular_velocity(attitude_ned.load());
+}
+
+void UAS::get_attitude_enu(geometry_msgs::Quaternion &orientation, geometry_msgs::Vector3 &angular_velocity)
+{
+	const auto st = attitude_enu.load();
+	orientation = get_orientation(st);
+	angular_velocity = get_angular_velocity(st);
+}
+
+
+/* -*- state history -*- */
+
+bool UAS::get_attitude_at(const ros::Time &stamp,
+	geometry_msgs::Quaternion &orientation, geometry_msgs::Vector3 &angular_velocity)
+{
+	AttitudeState a, b;
+	double ratio;
+
+	if (!attitude_history.lookup(stamp.toNSec(), a, b, ratio))
+		return false;
+
+	Eigen::Quaterniond qa(a.orientation[3], a.orientation[0], a.orientation[1], a.orientation[2]);
+	Eigen::Quaterniond qb(b.orientation[3], b.orientation[0], b.orientation[1], b.orientation[2]);
+	Eigen::Vector3d wa(a.angular_velocity), wb(b.angular_velocity);
+
+	tf::quaternionEigenToMsg(qa.slerp(ratio, qb), orientation);
+	tf::vectorEigenToMsg(wa + (wb - wa) * ratio, angular_velocity);
+	return true;
+}
+
+void UAS::update_local_position(const ros::Time &stamp, const Eigen::Vector3d &position)
+{
+	local_position_history.push(stamp.toNSec(), {{position.x(), position.y(), position.z()}});
+}
+
+bool UAS::get_local_position_at(const ros::Time &stamp, Eigen::Vector3d &position)
+{
+	std::array<double, 3> a, b;
+	double ratio;
+
+	if (!local_position_history.lookup(stamp.toNSec(), a, b, ratio))
+		return false;
+
+	Eigen::Vector3d pa(a.data()), pb(b.data());
+	position = pa + (pb - pa) * ratio;
+	return true;
 }
 
 
@@ -197,31 +280,99 @@ void UAS::update_gps_fix_epts(sensor_msgs::NavSatFix::Ptr &fix,
 	float eph, float epv,
 	int fix_type, int satellites_visible)
 {
-	lock_guard lock(mutex);
-
-	gps_fix = fix;
-	gps_eph = eph;
-	gps_epv = epv;
-	gps_fix_type = fix_type;
-	gps_satellites_visible = satellites_visible;
+	gps_epts.store(GpsEpts{eph, epv, fix_type, satellites_visible});
+	boost::atomic_store(&gps_fix, fix);
 }
 
 //! Returns EPH, EPV, Fix type and satellites visible
 void UAS::get_gps_epts(float &eph, float &epv, int &fix_type, int &satellites_visible)
 {
-	lock_guard lock(mutex);
+	auto epts = gps_epts.load();
 
-	eph = gps_eph;
-	epv = gps_epv;
-	fix_type = gps_fix_type;
-	satellites_visible = gps_satellites_visible;
+	eph = epts.eph;
+	epv = epts.epv;
+	fix_type = epts.fix_type;
+	satellites_visible = epts.satellites_visible;
 }
 
 //! Retunrs last GPS RAW message
 sensor_msgs::NavSatFix::Ptr UAS::get_gps_fix()
 {
-	lock_guard lock(mutex);
-	return gps_fix;
+	return boost::atomic_load(&gps_fix);
+}
+
+/* -*- GeographicLib utils -*- */
+
+std::mutex UAS::geoid_mutex;
+std::shared_ptr<GeographicLib::Geoid> UAS::egm96_5;
+bool UAS::geoid_load_failed = false;
+ros::WallDuration UAS::geoid_load_time;
+
+bool UAS::load_geoid_locked()
+{
+	if (egm96_5)
+		return true;
+	if (geoid_load_failed)
+		return false;
+
+	auto start = ros::WallTime::now();
+	try {
+		// From default location,
+		// Use cubic interpolation, Not thread safe (grid read on demand)
+		egm96_5 = std::make_shared<GeographicLib::Geoid>(GEOID_NAME, "", true, false);
+	}
+	catch (const std::exception &e) {
+		geoid_load_failed = true;
+		ROS_ERROR_STREAM("UAS: GeographicLib exception: " << e.what() <<
+				" | Run install_geographiclib_dataset.sh script in order to install Geoid Model dataset!");
+		return false;
+	}
+
+	geoid_load_time = ros::WallTime::now() - start;
+	ROS_INFO("UAS: geoid dataset %s opened in %.3f s", GEOID_NAME, geoid_load_time.toSec());
+	return true;
+}
+
+double UAS::geoid_height(double lat, double lon)
+{
+	std::lock_guard<std::mutex> lock(geoid_mutex);
+
+	if (!load_geoid_locked())
+		return 0.0;
+
+	return (*egm96_5)(lat, lon);
+}
+
+void UAS::preload_geoid_area(double lat, double lon, double radius_m)
+{
+	{
+		std::lock_guard<std::mutex> lock(geoid_mutex);
+
+		if (load_geoid_locked()) {
+			// read grid of area to RAM, so later cache misses there do not touch file
+			const double dlat = radius_m / 111320.0;
+			const double dlon = dlat / std::max(0.01, std::cos(lat * M_PI / 180.0));
+			egm96_5->CacheArea(lat - dlat, lon - dlon, lat + dlat, lon + dlon);
+		}
+	}
+
+	auto cells = geoid_cache.preload(lat, lon, radius_m);
+	ROS_INFO("UAS: geoid heights precomputed: %zu cells around %.6f %.6f", cells, lat, lon);
+}
+
+void UAS::geoid_diag_run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+	std::lock_guard<std::mutex> lock(geoid_mutex);
+
+	stat.add("Dataset", GEOID_NAME);
+	if (egm96_5) {
+		stat.addf("Load time", "%.3f s", geoid_load_time.toSec());
+		stat.summary(0, "loaded");
+	}
+	else if (geoid_load_failed)
+		stat.summary(2, "load failed");
+	else
+		stat.summary(0, "not used yet");
 }
 
 /* -*- transform -*- */
@@ -12,7 +12,9 @@
  */
 
 #include <array>
-#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <algorithm>
 #include <stdexcept>
 #include <mavros/mavros_uas.h>
 #include <mavros/px4_custom_mode.h>
@@ -23,13 +25,92 @@ using mavros::utils::enum_value;
 
 /* -*- mode stringify functions -*- */
 
-typedef std::unordered_map<uint32_t, const std::string> cmode_map;
+//! custom mode and its name
+struct cmode_name {
+	uint32_t mode;
+	const char *name;
+};
+
+template<size_t N>
+using cmode_table = std::array<cmode_name, N>;
+
+//! tables sorted by mode at compile time, lookup is binary search
+template<size_t N>
+static constexpr bool is_sorted_by_mode(const cmode_table<N> &table)
+{
+	for (size_t i = 1; i < N; i++)
+		if (!(table[i - 1].mode < table[i].mode))
+			return false;
+
+	return true;
+}
+
+/**
+ * @brief Lookup both ways in constant table
+ *
+ * Mode -> name binary searched in table itself,
+ * name -> mode in index sorted by name once at start.
+ * Neither allocates nor copies strings.
+ */
+class cmode_map {
+public:
+	template<size_t N>
+	explicit cmode_map(const cmode_table<N> &table) :
+		begin_(table.data()),
+		end_(table.data() + N),
+		by_name(N)
+	{
+		for (size_t i = 0; i < N; i++)
+			by_name[i] = &table[i];
+
+		std::sort(by_name.begin(), by_name.end(), [](const cmode_name *a, const cmode_name *b) {
+					return std::strcmp(a->name, b->name) < 0;
+				});
+	}
+
+	//! name of @a mode, nullptr if unknown
+	const char *find(uint32_t mode) const
+	{
+		auto it = std::lower_bound(begin_, end_, mode, [](const cmode_name &a, uint32_t m) {
+					return a.mode < m;
+				});
+
+		return (it != end_ && it->mode == mode) ? it->name : nullptr;
+	}
+
+	//! mode of @a name
+	bool find(const std::string &name, uint32_t &mode) const
+	{
+		auto it = std::lower_bound(by_name.begin(), by_name.end(), name.c_str(), [](const cmode_name *a, const char *n) {
+					return std::strcmp(a->name, n) < 0;
+				});
+
+		if (it == by_name.end() || name != (*it)->name)
+			return false;
+
+		mode = (*it)->mode;
+		return true;
+	}
+
+	const cmode_name *begin() const {
+		return begin_;
+	}
+
+	const cmode_name *end() const {
+		return end_;
+	}
+
+private:
+	const cmode_name *begin_;
+	const cmode_name *end_;
+	std::vector<const cmode_name*> by_name;
+};
 
 /** APM:Plane custom mode -> string
  *
  * ArduPlane/defines.h
  */
-static const cmode_map arduplane_cmode_map{{
+static constexpr cmode_table<20> arduplane_cmode_table{{
 	{ 0, "MANUAL" },
 	{ 1, "CIRCLE" },
 	{ 2, "STABILIZE" },
@@ -51,12 +132,14 @@ static const cmode_map arduplane_cmode_map{{
 	{ 20, "QLAND" },
 	{ 21, "QRTL" }
 }};
+static_assert(is_sorted_by_mode(arduplane_cmode_table), "arduplane custom modes not sorted");
+static const cmode_map arduplane_cmode_map(arduplane_cmode_table);
 
 /** APM:Copter custom mode -> string
  *
  * ArduCopter/defines.h
  */
-static const cmode_map arducopter_cmode_map{{
+static constexpr cmode_table<20> arducopter_cmode_table{{
 	{ 0, "STABILIZE" },
 	{ 1, "ACRO" },
 	{ 2, "ALT_HOLD" },
@@ -78,12 +161,14 @@ static const cmode_map arducopter_cmode_map{{
 	{ 19, "AVOID_ADSB" },
 	{ 20, "GUIDED_NOGPS" }
 }};
+static_assert(is_sorted_by_mode(arducopter_cmode_table), "arducopter custom modes not sorted");
+static const cmode_map arducopter_cmode_map(arducopter_cmode_table);
 
 /** APM:Rover custom mode -> string
  *
  * APMrover2/defines.h
  */
-static const cmode_map apmrover2_cmode_map{{
+static constexpr cmode_table<8> apmrover2_cmode_table{{
 	{ 0, "MANUAL" },
 	{ 2, "LEARNING" },
 	{ 3, "STEERING" },
@@ -93,6 +178,8 @@ static const cmode_map apmrover2_cmode_map{{
 	{ 15, "GUIDED" },
 	{ 16, "INITIALISING" }
 }};
+static_assert(is_sorted_by_mode(apmrover2_cmode_table), "apmrover2 custom modes not sorted");
+static const cmode_map apmrover2_cmode_map(apmrover2_cmode_table);
 
 /** ArduSub custom mode -> string
  *
@@ -100,7 +187,7 @@ static const cmode_map apmrover2_cmode_map{{
  *
  * ArduSub/defines.h
  */
-static const cmode_map ardusub_cmode_map{{
+static constexpr cmode_table<18> ardusub_cmode_table{{
 	{ 0, "STABILIZE" },
 	{ 1, "ACRO" },
 	{ 2, "ALT_HOLD" },
@@ -120,26 +207,30 @@ static const cmode_map ardusub_cmode_map{{
 	{ 18, "THROW" },
 	{ 19, "MANUAL" }
 }};
+static_assert(is_sorted_by_mode(ardusub_cmode_table), "ardusub custom modes not sorted");
+static const cmode_map ardusub_cmode_map(ardusub_cmode_table);
 
-//! PX4 custom mode -> string
-static const cmode_map px4_cmode_map{{
+//! PX4 custom mode -> string, sorted: main mode in bits 16..23, auto sub-mode in 24..31
+static constexpr cmode_table<16> px4_cmode_table{{
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_MANUAL),           "MANUAL" },
-	{ px4::define_mode(px4::custom_mode::MAIN_MODE_ACRO),             "ACRO" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_ALTCTL),           "ALTCTL" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_POSCTL),           "POSCTL" },
+	{ px4::define_mode(px4::custom_mode::MAIN_MODE_ACRO),             "ACRO" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_OFFBOARD),         "OFFBOARD" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_STABILIZED),       "STABILIZED" },
 	{ px4::define_mode(px4::custom_mode::MAIN_MODE_RATTITUDE),        "RATTITUDE" },
-	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_MISSION), "AUTO.MISSION" },
+	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_READY),   "AUTO.READY" },
+	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_TAKEOFF), "AUTO.TAKEOFF" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_LOITER),  "AUTO.LOITER" },
+	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_MISSION), "AUTO.MISSION" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_RTL),     "AUTO.RTL" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_LAND),    "AUTO.LAND" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_RTGS),    "AUTO.RTGS" },
-	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_READY),   "AUTO.READY" },
-	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_TAKEOFF), "AUTO.TAKEOFF" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_FOLLOW_TARGET), "AUTO.FOLLOW_TARGET" },
 	{ px4::define_mode_auto(px4::custom_mode::SUB_MODE_AUTO_PRECLAND), "AUTO.PRECLAND" },
 }};
+static_assert(is_sorted_by_mode(px4_cmode_table), "px4 custom modes not sorted");
+static const cmode_map px4_cmode_map(px4_cmode_table);
 
 static inline std::string str_base_mode(int base_mode) {
 	return utils::format("MODE(0x%2X)", base_mode);
@@ -151,9 +242,9 @@ static std::string str_custom_mode(uint32_t custom_mode) {
 
 static std::string str_mode_cmap(const cmode_map &cmap, uint32_t custom_mode)
 {
-	auto it = cmap.find(custom_mode);
-	if (it != cmap.end())
-		return it->second;
+	auto name = cmap.find(custom_mode);
+	if (name)
+		return name;
 	else
 		return str_custom_mode(custom_mode);
 }
@@ -219,12 +310,8 @@ std::string UAS::str_mode_v10(uint8_t base_mode, uint32_t custom_mode)
 static bool cmode_find_cmap(const cmode_map &cmap, std::string &cmode_str, uint32_t &cmode)
 {
 	// 1. try find by name
-	for (auto &mode : cmap) {
-		if (mode.second == cmode_str) {
-			cmode = mode.first;
-			return true;
-		}
-	}
+	if (cmap.find(cmode_str, cmode))
+		return true;
 
 	// 2. try convert integer
 	//! @todo parse CMODE(dec)
@@ -239,7 +326,7 @@ static bool cmode_find_cmap(const cmode_map &cmap, std::string &cmode_str, uint3
 	// Debugging output.
 	std::ostringstream os;
 	for (auto &mode : cmap)
-		os << " " << mode.second;
+		os << " " << mode.name;
 
 	ROS_ERROR_STREAM_NAMED("uas", "MODE: Unknown mode: " << cmode_str);
 	ROS_INFO_STREAM_NAMED("uas", "MODE: Known modes are:" << os.str());
@@ -29,12 +29,33 @@ static inline ros::Time ros_time_from_ns(const uint64_t stamp_ns) {
 		stamp_ns % 1000000000UL);		// t_nsec
 }
 
+//! arrival time of message handled by this thread (CLOCK_REALTIME)
+static thread_local uint64_t rx_stamp_ns = 0;
+
+void UAS::set_rx_stamp(uint64_t stamp_ns) {
+	rx_stamp_ns = stamp_ns;
+}
+
+ros::Time UAS::get_rx_stamp() {
+	// link stamps are wall clock
+	if (rx_stamp_ns == 0 || ros::Time::isSimTime())
+		return ros::Time::now();
+
+	return ros_time_from_ns(rx_stamp_ns);
+}
+
+//! FCU time to ROS time by linear model
+static inline uint64_t apply_time_sync_model(const UAS::TimeSyncModel &m, const uint64_t fcu_ns) {
+	const int64_t dt_ns = static_cast<int64_t>(fcu_ns - m.epoch_ns);
+	return fcu_ns + m.offset_ns + static_cast<int64_t>(m.skew * dt_ns);
+}
+
 ros::Time UAS::synchronise_stamp(uint32_t time_boot_ms) {
-	// copy offset from atomic var
-	uint64_t offset_ns = time_offset;
+	// consistent copy of offset, skew and epoch
+	auto model = time_sync.load();
 
-	if (offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
-		uint64_t stamp_ns = static_cast<uint64_t>(time_boot_ms) * 1000000UL + offset_ns;
+	if (model.offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
+		uint64_t stamp_ns = apply_time_sync_model(model, static_cast<uint64_t>(time_boot_ms) * 1000000UL);
 		return ros_time_from_ns(stamp_ns);
 	}
 	else
@@ -42,10 +63,10 @@ ros::Time UAS::synchronise_stamp(uint32_t time_boot_ms) {
 }
 
 ros::Time UAS::synchronise_stamp(uint64_t time_usec) {
-	uint64_t offset_ns = time_offset;
+	auto model = time_sync.load();
 
-	if (offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
-		uint64_t stamp_ns = time_usec * 1000UL + offset_ns;
+	if (model.offset_ns > 0 || tsync_mode == timesync_mode::PASSTHROUGH) {
+		uint64_t stamp_ns = apply_time_sync_model(model, time_usec * 1000UL);
 		return ros_time_from_ns(stamp_ns);
 	}
 	else
@@ -27,7 +27,7 @@ from std_srvs.srv import Empty
 from mavros_msgs.msg import FileEntry
 from mavros_msgs.srv import FileOpen, FileClose, FileRead, FileList, FileOpenRequest, \
     FileMakeDir, FileRemoveDir, FileRemove, FileWrite, FileTruncate, FileRename, \
-    FileChecksum
+    FileChecksum, FileDownload
 
 
 def _get_proxy(service, type):
@@ -226,6 +226,18 @@ def checksum(path):
     return ret.crc32
 
 
+def download(path, local_path, resume=False):
+    """Download :path: to :local_path: on mavros host, returns file size"""
+    download_ = _get_proxy('download', FileDownload)
+    try:
+        ret = download_(file_path=path, local_path=local_path, resume=resume)
+    except rospy.ServiceException as ex:
+        raise IOError(str(ex))
+
+    _check_raise_errno(ret)
+    return ret.size
+
+
 def reset_server():
     reset = _get_proxy('reset', Empty)
     try:
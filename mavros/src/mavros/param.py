@@ -13,7 +13,7 @@ import rospy
 import mavros
 
 from mavros_msgs.msg import ParamValue
-from mavros_msgs.srv import ParamPull, ParamPush, ParamGet, ParamSet
+from mavros_msgs.srv import ParamPull, ParamPush, ParamGet, ParamSet, ParamSetBatch
 
 
 class Parameter(object):
@@ -133,11 +133,15 @@ def param_get(param_id):
     return param_ret_value(ret)
 
 
-def param_set(param_id, value):
+def param_value(value):
     if isinstance(value, float):
-        val = ParamValue(integer=0, real=value)
+        return ParamValue(integer=0, real=value)
     else:
-        val = ParamValue(integer=value, real=0.0)
+        return ParamValue(integer=value, real=0.0)
+
+
+def param_set(param_id, value):
+    val = param_value(value)
 
     try:
         set = rospy.ServiceProxy(mavros.get_topic('param', 'set'), ParamSet)
@@ -185,3 +189,21 @@ def param_set_list(param_list):
         raise IOError("Request failed.")
 
     return ret.param_transfered
+
+
+def param_set_batch(param_list):
+    """Set parameters by pipelined ~param/set_batch
+
+    Returns list of (Parameter, success) with values reported by FCU.
+    """
+    param_list = list(param_list)
+
+    try:
+        set_batch = rospy.ServiceProxy(mavros.get_topic('param', 'set_batch'), ParamSetBatch)
+        ret = set_batch(param_id=[p.param_id for p in param_list],
+                        value=[param_value(p.param_value) for p in param_list])
+    except rospy.ServiceException as ex:
+        raise IOError(str(ex))
+
+    return [(Parameter(p.param_id, param_ret_value(v)), ok)
+            for p, v, ok in zip(param_list, ret.value, ret.results)]
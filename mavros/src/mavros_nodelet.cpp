@@ -0,0 +1,45 @@
+/**
+ * @brief MAVROS Nodelet
+ * @file mavros_nodelet.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <memory>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <mavros/mavros.h>
+
+namespace mavros {
+/**
+ * @brief MAVROS nodelet
+ *
+ * Same as mavros_node, but runs in nodelet manager,
+ * so subscribers in the same manager receive published messages
+ * by shared pointer without serialization.
+ *
+ * @note plugins use private namespace of the process ("~plugin"),
+ *       so name manager "mavros" to keep usual topic names.
+ */
+class MavRosNodelet : public nodelet::Nodelet
+{
+private:
+	std::unique_ptr<MavRos> mavros;
+
+	void onInit() override
+	{
+		NODELET_INFO("Starting mavros nodelet");
+
+		mavros.reset(new MavRos(getPrivateNodeHandle()));
+		mavros->start();
+	}
+};
+}	// namespace mavros
+
+PLUGINLIB_EXPORT_CLASS(mavros::MavRosNodelet, nodelet::Nodelet)
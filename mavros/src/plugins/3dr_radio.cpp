@@ -15,6 +15,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/congestion_control.h>
 
 #include <mavros_msgs/RadioStatus.h>
 
@@ -26,17 +27,21 @@ namespace std_plugins {
 class TDRRadioPlugin : public plugin::PluginBase {
 public:
 	TDRRadioPlugin() : PluginBase(),
-		nh("~"),
+		nh(private_nh()),
 		has_radio_status(false),
 		diag_added(false),
-		low_rssi(0)
+		low_rssi(0),
+		congestion_enabled(false),
+		congestion_resend(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		nh.param("tdr_radio/low_rssi", low_rssi, 40);
+		setup_congestion();
 
 		status_pub = nh.advertise<mavros_msgs::RadioStatus>("radio_status", 10);
 
@@ -47,7 +52,9 @@ public:
 	{
 		return {
 			make_handler(&TDRRadioPlugin::handle_radio_status),
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 			make_handler(&TDRRadioPlugin::handle_radio),
+#endif
 		};
 	}
 
@@ -58,6 +65,17 @@ private:
 	bool diag_added;
 	int low_rssi;
 
+	//! low priority streams slowed down on congested link
+	struct Stream {
+		mavlink::msgid_t msgid;
+		double rate;		//!< Hz on free link
+	};
+
+	bool congestion_enabled;
+	bool congestion_resend;		//!< send rates on next report
+	CongestionControl congestion;
+	std::vector<Stream> congestion_streams;
+
 	ros::Publisher status_pub;
 
 	std::mutex diag_mutex;
@@ -71,6 +89,7 @@ private:
 		handle_message(msg, rst);
 	}
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 	void handle_radio(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::RADIO &rst)
 	{
 		if (has_radio_status)
@@ -79,6 +98,7 @@ private:
 		// actually the same data, but from earlier modems
 		handle_message(msg, rst);
 	}
+#endif
 
 	template<typename msgT>
 	void handle_message(const mavlink::mavlink_message_t *mmsg, msgT &rst)
@@ -116,6 +136,14 @@ private:
 			last_status = msg;
 		}
 
+		// rate limiter of forwarded streams follows radio buffer
+		m_uas->update_link_budget(rst.txbuf);
+
+		if (congestion_enabled) {
+			std::lock_guard<std::mutex> lock(diag_mutex);
+			congestion_update(rst.txbuf, rst.rxerrors);
+		}
+
 		status_pub.publish(msg);
 	}
 
@@ -144,17 +172,92 @@ private:
 		stat.addf("Remote noice level", "%u", last_status->remnoise);
 		stat.addf("Rx errors", "%u", last_status->rxerrors);
 		stat.addf("Fixed", "%u", last_status->fixed);
+
+		if (congestion_enabled) {
+			stat.addf("Telemetry rate scale", "%.2f", congestion.scale());
+			stat.addf("Telemetry backoffs", "%zu", congestion.decreases());
+		}
+	}
+
+	/* -*- congestion control -*- */
+
+	void setup_congestion()
+	{
+		CongestionControl::Config cfg;
+		std::vector<int> msgids{};
+		std::vector<double> rates{};
+		int tx_queue_max = cfg.tx_queue_max;
+
+		nh.param("tdr_radio/congestion/enable", congestion_enabled, false);
+		nh.getParam("tdr_radio/congestion/msgids", msgids);
+		nh.getParam("tdr_radio/congestion/rates", rates);
+		nh.param("tdr_radio/congestion/txbuf_low", cfg.txbuf_low, cfg.txbuf_low);
+		nh.param("tdr_radio/congestion/txbuf_high", cfg.txbuf_high, cfg.txbuf_high);
+		nh.param("tdr_radio/congestion/rxerrors_max", cfg.rxerrors_max, cfg.rxerrors_max);
+		nh.param("tdr_radio/congestion/tx_queue_max", tx_queue_max, tx_queue_max);
+		nh.param("tdr_radio/congestion/min_scale", cfg.min_scale, cfg.min_scale);
+		nh.param("tdr_radio/congestion/increase", cfg.increase, cfg.increase);
+
+		if (!congestion_enabled)
+			return;
+
+		if (msgids.size() != rates.size() || msgids.empty()) {
+			ROS_ERROR_NAMED("radio", "RADIO: congestion/msgids and congestion/rates should be same non empty size, control disabled");
+			congestion_enabled = false;
+			return;
+		}
+
+		cfg.tx_queue_max = std::max(tx_queue_max, 0);
+		congestion.configure(cfg);
+		for (size_t i = 0; i < msgids.size(); i++)
+			congestion_streams.push_back(Stream { mavlink::msgid_t(msgids[i]), rates[i] });
+
+		ROS_INFO_NAMED("radio", "RADIO: congestion control of %zu streams", congestion_streams.size());
+	}
+
+	//! called locked by diag_mutex
+	void congestion_update(uint8_t txbuf, uint16_t rxerrors)
+	{
+		using mavlink::common::MAV_CMD;
+
+		size_t tx_queue = 0;
+		for (auto depth : UAS_FCU(m_uas)->get_tx_stat().depth)
+			tx_queue += depth;
+
+		const bool changed = congestion.update(txbuf, rxerrors, tx_queue);
+		if (!changed && !congestion_resend)
+			return;
+
+		congestion_resend = false;
+		const double scale = congestion.scale();
+		ROS_DEBUG_NAMED("radio", "RADIO: telemetry rate scale %.2f (txbuf %u%%, Tx queue %zu)", scale, txbuf, tx_queue);
+
+		for (auto &s : congestion_streams) {
+			mavlink::common::msg::COMMAND_LONG cmd {};
+			m_uas->msg_set_target(cmd);
+
+			cmd.command = enum_value(MAV_CMD::SET_MESSAGE_INTERVAL);
+			cmd.param1 = s.msgid;
+			cmd.param2 = StreamDemand::interval_us(s.rate * scale);
+
+			UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+		}
 	}
 
 	void connection_cb(bool connected) override
 	{
 		UAS_DIAG(m_uas).removeByName("3DR Radio");
 		diag_added = false;
+
+		// link lost: FCU may keep reduced rates or reboot to defaults, so restore on next report
+		std::lock_guard<std::mutex> lock(diag_mutex);
+		congestion.reset();
+		congestion_resend = true;
 	}
 
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::TDRRadioPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::TDRRadioPlugin)
@@ -14,7 +14,10 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <thread>
+#include <mavros/seqlock.h>
 #include <mavros/mavros_plugin.h>
+#include <mavconn/thread_utils.h>
 
 #include <mavros_msgs/ActuatorControl.h>
 
@@ -24,34 +27,196 @@ namespace std_plugins {
  * @brief ActuatorControl plugin
  *
  * Sends actuator controls to FCU controller.
+ *
+ * For high-rate controllers two options cut jitter:
+ * - ~actuator_control/queue/enable: ~actuator_control served by own thread,
+ *   optionally pinned to CPU and realtime, instead of shared spinner queue;
+ * - ~actuator_control/sync/source: command is not sent by callback, but kept
+ *   as latest-wins and sent from handler of IMU message, so it leaves phase
+ *   aligned with sensor arrival, at most at ~actuator_control/sync/rate.
+ *   If FCU does not send that message for ~actuator_control/sync/timeout
+ *   commands are sent by callback until it comes again.
  */
 class ActuatorControlPlugin : public plugin::PluginBase {
 public:
 	ActuatorControlPlugin() : PluginBase(),
-		nh("~")
+		nh(private_nh()),
+		sync_msgid(0),
+		sync_stream(nullptr),
+		sync_period_ns(0),
+		sync_timeout_ns(0),
+		sync_lost_ns(0),
+		last_sync_ns(0),
+		sync_lost(false),
+		sent_version(0),
+		last_sensor_ns(0),
+		sensor_interval_ns(0),
+		last_send_ns(0),
+		queue_running(false)
 	{ }
 
+	~ActuatorControlPlugin()
+	{
+		// subscription leaves cmd_queue before it is destroyed
+		actuator_control_sub.shutdown();
+		queue_running = false;
+		if (queue_thread.joinable())
+			queue_thread.join();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
+
+		bool queue_enable;
+		int queue_cpu, queue_priority;
+		std::string sync_source;
+		double sync_rate, sync_timeout;
+
+		nh.param("actuator_control/queue/enable", queue_enable, false);
+		nh.param("actuator_control/queue/cpu", queue_cpu, -1);
+		nh.param("actuator_control/queue/priority", queue_priority, 0);
+		nh.param<std::string>("actuator_control/sync/source", sync_source, "none");
+		nh.param("actuator_control/sync/rate", sync_rate, 0.0);
+		nh.param("actuator_control/sync/timeout", sync_timeout, 0.1);
+
+		sync_msgid = find_sync_msgid(sync_source);
+		sync_period_ns = (sync_rate > 0.0) ? int64_t(1e9 / sync_rate) : 0;
+		sync_timeout_ns = (sync_timeout > 0.0) ? int64_t(sync_timeout * 1e9) : 0;
+		sync_lost_ns = (sync_timeout_ns > 0) ? sync_timeout_ns : int64_t(0.1e9);
+		sent_version = pending.version();	// initial value is not a command
+
+		if (sync_msgid != 0)
+			ROS_INFO_NAMED("actuator_control", "AC: commands sent with %s, rate %s",
+					sync_source.c_str(), sync_rate > 0.0 ? std::to_string(sync_rate).c_str() : "of sensor");
+		else if (sync_source != "none")
+			ROS_ERROR_NAMED("actuator_control", "AC: unknown sync/source: %s, commands sent immediately", sync_source.c_str());
 
 		target_actuator_control_pub = nh.advertise<mavros_msgs::ActuatorControl>("target_actuator_control", 10);
-		actuator_control_sub = nh.subscribe("actuator_control", 10, &ActuatorControlPlugin::actuator_control_cb, this);
+
+		// commands should not wait behind other plugins callbacks
+		ros::NodeHandle cmd_nh(nh);
+		if (queue_enable)
+			cmd_nh.setCallbackQueue(&cmd_queue);
+
+		actuator_control_sub = cmd_nh.subscribe("actuator_control", 10, &ActuatorControlPlugin::actuator_control_cb, this,
+				ros::TransportHints().tcpNoDelay());
+
+		if (queue_enable)
+			start_queue_thread(queue_cpu, queue_priority);
+
+		// sensor stream kept at commanded rate while controller publishes, even if imu topics are idle
+		if (sync_msgid != 0) {
+			auto publishers = [this]() { return actuator_control_sub.getNumPublishers(); };
+			sync_stream = m_uas->stream_demand.declare(sync_msgid, "actuator_control", publishers,
+					sync_rate > 0.0 ? sync_rate : StreamDemand::RATE_DEFAULT);
+		}
 	}
 
 	Subscriptions get_subscriptions()
 	{
 		return {
 			       make_handler(&ActuatorControlPlugin::handle_actuator_control_target),
+			       make_handler(mavlink::common::msg::HIGHRES_IMU::MSG_ID, &ActuatorControlPlugin::handle_sensor),
+			       make_handler(mavlink::common::msg::RAW_IMU::MSG_ID, &ActuatorControlPlugin::handle_sensor),
+			       make_handler(mavlink::common::msg::SCALED_IMU::MSG_ID, &ActuatorControlPlugin::handle_sensor),
+			       make_handler(mavlink::common::msg::ATTITUDE::MSG_ID, &ActuatorControlPlugin::handle_sensor),
+			       make_handler(mavlink::common::msg::ATTITUDE_QUATERNION::MSG_ID, &ActuatorControlPlugin::handle_sensor),
 		};
 	}
 
 private:
+	//! command waiting for sensor frame
+	struct Command {
+		uint64_t time_usec;
+		int64_t rx_ns;		//!< steady clock
+		uint8_t group_mix;
+		std::array<float, 8> controls;
+	};
+
 	ros::NodeHandle nh;
 
 	ros::Publisher target_actuator_control_pub;
 	ros::Subscriber actuator_control_sub;
 
+	//! IMU message which triggers sending, 0 - send in callback
+	mavlink::msgid_t sync_msgid;
+	StreamDemand::Stream *sync_stream;
+	int64_t sync_period_ns;
+	int64_t sync_timeout_ns;
+	int64_t sync_lost_ns;			//!< no sync frame that long: send by callback
+	std::atomic<int64_t> last_sync_ns;	//!< sync frame (or first command) time, steady clock
+	std::atomic<bool> sync_lost;
+
+	//! latest command, written by callback, read by sensor handler
+	SeqLock<Command> pending;
+
+	//! sensor handler state, handlers of one msgid run in order, so not locked
+	uint32_t sent_version;
+	int64_t last_sensor_ns;
+	int64_t sensor_interval_ns;
+	int64_t last_send_ns;
+
+	ros::CallbackQueue cmd_queue;
+	std::thread queue_thread;
+	std::atomic<bool> queue_running;
+
+	static int64_t steady_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static mavlink::msgid_t find_sync_msgid(const std::string &source)
+	{
+		using namespace mavlink::common::msg;
+
+		if (source == "highres_imu")
+			return HIGHRES_IMU::MSG_ID;
+		else if (source == "raw_imu")
+			return RAW_IMU::MSG_ID;
+		else if (source == "scaled_imu")
+			return SCALED_IMU::MSG_ID;
+		else if (source == "attitude")
+			return ATTITUDE::MSG_ID;
+		else if (source == "attitude_quaternion")
+			return ATTITUDE_QUATERNION::MSG_ID;
+		else
+			return 0;
+	}
+
+	void start_queue_thread(int cpu, int priority)
+	{
+		queue_running = true;
+		queue_thread = std::thread([this]() {
+					mavconn::utils::set_this_thread_name("mavros-act");
+					while (queue_running && ros::ok())
+						cmd_queue.callAvailable(ros::WallDuration(0.01));
+				});
+
+		if (cpu >= 0 && !mavconn::utils::set_thread_affinity(queue_thread, cpu))
+			ROS_WARN_NAMED("actuator_control", "AC: failed to pin queue thread to CPU %d", cpu);
+		if (priority > 0 && !mavconn::utils::set_thread_sched(queue_thread, SCHED_FIFO, priority))
+			ROS_WARN_NAMED("actuator_control", "AC: failed to set SCHED_FIFO priority %d", priority);
+	}
+
+	void send_command(const Command &cmd)
+	{
+		//! about groups, mixing and channels: @p https://pixhawk.org/dev/mixing
+		//! message definiton here: @p https://mavlink.io/en/messages/common.html#SET_ACTUATOR_CONTROL_TARGET
+		mavlink::common::msg::SET_ACTUATOR_CONTROL_TARGET act{};
+
+		act.time_usec = cmd.time_usec;
+		act.group_mlx = cmd.group_mix;
+		act.target_system = m_uas->get_tgt_system();
+		act.target_component = m_uas->get_tgt_component();
+		act.controls = cmd.controls;
+
+		// latest-wins in link Tx queue
+		UAS_FCU(m_uas)->send_message_ignore_drop(act);
+	}
+
 	/* -*- rx handlers -*- */
 
 	void handle_actuator_control_target(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ACTUATOR_CONTROL_TARGET &actuator_control_target)
@@ -66,24 +231,85 @@ private:
 		target_actuator_control_pub.publish(actuator_control_target_msg);
 	}
 
+	/**
+	 * @brief Send latest command with sync/source message
+	 *
+	 * Between sends sensor frames are skipped, so send falls on frame
+	 * closest to sync/rate period: frame interval halved gives the margin.
+	 */
+	void handle_sensor(const mavlink::mavlink_message_t *msg, const mavconn::Framing framing)
+	{
+		if (msg->msgid != sync_msgid || framing != mavconn::Framing::ok ||
+				msg->sysid != m_uas->get_tgt_system())
+			return;
+
+		sync_stream->seen();
+
+		const auto now = steady_ns();
+		last_sync_ns.store(now, std::memory_order_relaxed);
+		if (sync_lost.exchange(false))
+			ROS_INFO_NAMED("actuator_control", "AC: sync frames resumed");
+
+		if (last_sensor_ns != 0) {
+			const auto dt = now - last_sensor_ns;
+			sensor_interval_ns = (sensor_interval_ns == 0) ? dt : (7 * sensor_interval_ns + dt) / 8;
+		}
+		last_sensor_ns = now;
+
+		if (sync_period_ns > 0 && now - last_send_ns + sensor_interval_ns / 2 < sync_period_ns)
+			return;
+
+		// each command sent once (version read first: newer one may be resent next time)
+		const auto version = pending.version();
+		if (version == sent_version)
+			return;
+
+		const auto cmd = pending.load();
+		sent_version = version;
+
+		if (sync_timeout_ns > 0 && now - cmd.rx_ns > sync_timeout_ns)
+			return;
+
+		last_send_ns = now;
+		send_command(cmd);
+	}
+
 	/* -*- callbacks -*- */
 
 	void actuator_control_cb(const mavros_msgs::ActuatorControl::ConstPtr &req) {
-		//! about groups, mixing and channels: @p https://pixhawk.org/dev/mixing
-		//! message definiton here: @p https://mavlink.io/en/messages/common.html#SET_ACTUATOR_CONTROL_TARGET
-		mavlink::common::msg::SET_ACTUATOR_CONTROL_TARGET act{};
+		Command cmd{};
 
-		act.time_usec = req->header.stamp.toNSec() / 1000;
-		act.group_mlx = req->group_mix;
-		act.target_system = m_uas->get_tgt_system();
-		act.target_component = m_uas->get_tgt_component();
-		std::copy(req->controls.begin(), req->controls.end(), act.controls.begin());	// std::array = boost::array
+		cmd.time_usec = req->header.stamp.toNSec() / 1000;
+		cmd.rx_ns = steady_ns();
+		cmd.group_mix = req->group_mix;
+		std::copy(req->controls.begin(), req->controls.end(), cmd.controls.begin());	// std::array = boost::array
 
-		UAS_FCU(m_uas)->send_message_ignore_drop(act);
+		if (sync_msgid == 0 || sync_is_lost(cmd.rx_ns))
+			send_command(cmd);
+		else
+			pending.store(cmd);
+	}
+
+	//! true if no sync frame since @a sync_lost_ns, warns once per loss
+	bool sync_is_lost(int64_t now)
+	{
+		// wait for first frame counted from first command
+		int64_t last = 0;
+		if (last_sync_ns.compare_exchange_strong(last, now, std::memory_order_relaxed))
+			return false;
+
+		if (now - last <= sync_lost_ns)
+			return false;
+
+		if (!sync_lost.exchange(true))
+			ROS_WARN_NAMED("actuator_control", "AC: no sync frame for %.2f s, commands sent immediately",
+					sync_lost_ns / 1e9);
+
+		return true;
 	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ActuatorControlPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::ActuatorControlPlugin)
@@ -26,7 +26,7 @@ namespace std_plugins {
 class AltitudePlugin : public plugin::PluginBase {
 public:
 	AltitudePlugin() : PluginBase(),
-		nh("~")
+		nh(private_nh())
 	{ }
 
 	/**
@@ -35,6 +35,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		nh.param<std::string>("frame_id", frame_id, "map");
 		altitude_pub = nh.advertise<mavros_msgs::Altitude>("altitude", 10);
@@ -71,5 +72,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::AltitudePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::AltitudePlugin)
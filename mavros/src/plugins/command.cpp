@@ -15,10 +15,14 @@
  */
 
 #include <chrono>
+#include <functional>
+#include <unordered_map>
 #include <condition_variable>
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/CommandLong.h>
+#include <mavros_msgs/CommandLongAsync.h>
+#include <mavros_msgs/CommandAsyncResult.h>
 #include <mavros_msgs/CommandInt.h>
 #include <mavros_msgs/CommandBool.h>
 #include <mavros_msgs/CommandHome.h>
@@ -30,22 +34,32 @@
 namespace mavros {
 namespace std_plugins {
 static constexpr double ACK_TIMEOUT_DEFAULT = 5.0;
+//! period of in-flight table scan for expired transactions
+static constexpr double ACK_EXPIRE_PERIOD = 0.1;
 using utils::enum_value;
 using lock_guard = std::lock_guard<std::mutex>;
 using unique_lock = std::unique_lock<std::mutex>;
+using steady_clock = std::chrono::steady_clock;
 
+/**
+ * @brief Command waiting for COMMAND_ACK
+ *
+ * @a done called once: on ACK or when deadline passed,
+ * always with plugin mutex locked.
+ */
 class CommandTransaction {
 public:
-	std::mutex cond_mutex;
-	std::condition_variable ack;
+	//! timeout, result
+	using CompletionFn = std::function<void(bool, uint8_t)>;
+
 	uint16_t expected_command;
-	uint8_t result;
+	steady_clock::time_point deadline;
+	CompletionFn done;
 
-	explicit CommandTransaction(uint16_t command) :
-		ack(),
+	CommandTransaction(uint16_t command, steady_clock::time_point deadline_, CompletionFn done_) :
 		expected_command(command),
-		// Default result if wait ack timeout
-		result(enum_value(mavlink::common::MAV_RESULT::FAILED))
+		deadline(deadline_),
+		done(done_)
 	{ }
 };
 
@@ -53,17 +67,23 @@ public:
  * @brief Command plugin.
  *
  * Send any command via COMMAND_LONG
+ *
+ * In-flight commands kept in table indexed by command id (that is the only
+ * thing COMMAND_ACK can be matched by), so one transaction per command.
+ * Services block caller until completion, ~cmd/async does not:
+ * its result published on ~cmd/async_result.
  */
 class CommandPlugin : public plugin::PluginBase {
 public:
 	CommandPlugin() : PluginBase(),
-		cmd_nh("~cmd"),
+		cmd_nh(private_nh("cmd")),
 		use_comp_id_system_control(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(cmd_nh);
 
 		double command_ack_timeout;
 
@@ -81,6 +101,10 @@ public:
 		trigger_control_srv = cmd_nh.advertiseService("trigger_control", &CommandPlugin::trigger_control_cb, this);
 		trigger_interval_srv = cmd_nh.advertiseService("trigger_interval", &CommandPlugin::trigger_interval_cb, this);
 		vtol_transition_srv = cmd_nh.advertiseService("vtol_transition", &CommandPlugin::vtol_transition_cb, this);
+
+		async_sub = cmd_nh.subscribe("async", 100, &CommandPlugin::command_async_cb, this);
+		async_result_pub = cmd_nh.advertise<mavros_msgs::CommandAsyncResult>("async_result", 100);
+		make_timer(expire_timer, ros::Duration(ACK_EXPIRE_PERIOD), &CommandPlugin::expire_cb);
 	}
 
 	Subscriptions get_subscriptions()
@@ -91,9 +115,10 @@ public:
 	}
 
 private:
-	using L_CommandTransaction = std::list<CommandTransaction>;
+	using M_CommandTransaction = std::unordered_map<uint16_t, CommandTransaction>;
 
 	std::mutex mutex;
+	std::condition_variable ack_cond;
 
 	ros::NodeHandle cmd_nh;
 	ros::ServiceServer command_long_srv;
@@ -105,10 +130,13 @@ private:
 	ros::ServiceServer trigger_control_srv;
 	ros::ServiceServer trigger_interval_srv;
 	ros::ServiceServer vtol_transition_srv;
+	ros::Subscriber async_sub;
+	ros::Publisher async_result_pub;
+	Timer expire_timer;
 
 	bool use_comp_id_system_control;
 
-	L_CommandTransaction ack_waiting_list;
+	M_CommandTransaction ack_waiting_table;
 	ros::Duration command_ack_timeout_dt;
 
 	/* -*- message handlers -*- */
@@ -119,30 +147,66 @@ private:
 
 		// XXX(vooon): place here source ids check
 
-		for (auto &tr : ack_waiting_list) {
-			if (tr.expected_command == ack.command) {
-				tr.result = ack.result;
-				tr.ack.notify_all();
-				return;
-			}
+		auto it = ack_waiting_table.find(ack.command);
+		if (it == ack_waiting_table.end()) {
+			ROS_WARN_THROTTLE_NAMED(10, "cmd", "CMD: Unexpected command %u, result %u",
+				ack.command, ack.result);
+			return;
 		}
 
-		ROS_WARN_THROTTLE_NAMED(10, "cmd", "CMD: Unexpected command %u, result %u",
-			ack.command, ack.result);
+		auto done = std::move(it->second.done);
+		ack_waiting_table.erase(it);
+		done(false, ack.result);
 	}
 
 	/* -*- mid-level functions -*- */
 
-	bool wait_ack_for(CommandTransaction &tr) {
-		unique_lock lock(tr.cond_mutex);
-		if (tr.ack.wait_for(lock, std::chrono::nanoseconds(command_ack_timeout_dt.toNSec())) == std::cv_status::timeout) {
-			ROS_WARN_NAMED("cmd", "CMD: Command %u -- wait ack timeout", tr.expected_command);
-			return false;
-		} else {
-			return true;
+	//! Complete transactions which deadline passed
+	void expire_cb(const ros::TimerEvent &)
+	{
+		using mavlink::common::MAV_RESULT;
+
+		lock_guard lock(mutex);
+
+		const auto now = steady_clock::now();
+		for (auto it = ack_waiting_table.begin(); it != ack_waiting_table.end(); ) {
+			if (it->second.deadline > now) {
+				++it;
+				continue;
+			}
+
+			ROS_WARN_NAMED("cmd", "CMD: Command %u -- wait ack timeout", it->first);
+			auto done = std::move(it->second.done);
+			it = ack_waiting_table.erase(it);
+			done(true, enum_value(MAV_RESULT::FAILED));
 		}
 	}
 
+	/**
+	 * @brief Register transaction for @a command
+	 *
+	 * @note mutex should be locked
+	 * @return false if that command already in progress
+	 */
+	bool add_transaction(uint16_t command, CommandTransaction::CompletionFn done)
+	{
+		const auto deadline = steady_clock::now() + std::chrono::nanoseconds(command_ack_timeout_dt.toNSec());
+		auto ret = ack_waiting_table.emplace(command, CommandTransaction(command, deadline, done));
+		if (!ret.second)
+			ROS_WARN_THROTTLE_NAMED(10, "cmd", "CMD: Command %u already in progress", command);
+
+		return ret.second;
+	}
+
+	/**
+	 * @note APM & PX4 master always send COMMAND_ACK. Old PX4 never.
+	 * Don't expect any ACK in broadcast mode.
+	 */
+	inline bool is_ack_required(bool broadcast, uint8_t confirmation)
+	{
+		return (confirmation != 0 || m_uas->is_ardupilotmega() || m_uas->is_px4()) && !broadcast;
+	}
+
 	/**
 	 * Common function for command service callbacks.
 	 *
@@ -160,23 +224,35 @@ private:
 
 		unique_lock lock(mutex);
 
-		L_CommandTransaction::iterator ack_it;
-
-		/* check transactions */
-		for (const auto &tr : ack_waiting_list) {
-			if (tr.expected_command == command) {
+		if (!is_ack_required(broadcast, confirmation)) {
+			if (ack_waiting_table.count(command)) {
 				ROS_WARN_THROTTLE_NAMED(10, "cmd", "CMD: Command %u already in progress", command);
 				return false;
 			}
+
+			command_long(broadcast,
+				command, confirmation,
+				param1, param2,
+				param3, param4,
+				param5, param6,
+				param7);
+
+			success = true;
+			result = enum_value(MAV_RESULT::ACCEPTED);
+			return true;
 		}
 
-		/**
-		 * @note APM & PX4 master always send COMMAND_ACK. Old PX4 never.
-		 * Don't expect any ACK in broadcast mode.
-		 */
-		bool is_ack_required = (confirmation != 0 || m_uas->is_ardupilotmega() || m_uas->is_px4()) && !broadcast;
-		if (is_ack_required)
-			ack_it = ack_waiting_list.emplace(ack_waiting_list.end(), command);
+		bool is_done = false;
+		bool is_timeout = false;
+		uint8_t ack_result = enum_value(MAV_RESULT::FAILED);
+
+		if (!add_transaction(command, [&](bool timeout, uint8_t res) {
+				is_done = true;
+				is_timeout = timeout;
+				ack_result = res;
+				ack_cond.notify_all();
+			}))
+			return false;
 
 		command_long(broadcast,
 			command, confirmation,
@@ -185,24 +261,33 @@ private:
 			param5, param6,
 			param7);
 
-		if (is_ack_required) {
-			lock.unlock();
-			bool is_not_timeout = wait_ack_for(*ack_it);
-			lock.lock();
-
-			success = is_not_timeout && ack_it->result == enum_value(MAV_RESULT::ACCEPTED);
-			result = ack_it->result;
-
-			ack_waiting_list.erase(ack_it);
-		}
-		else {
-			success = true;
-			result = enum_value(MAV_RESULT::ACCEPTED);
+		// do not rely on expire timer: spinner threads may be all busy
+		const auto deadline = ack_waiting_table.at(command).deadline;
+		if (!ack_cond.wait_until(lock, deadline, [&] { return is_done; })) {
+			ROS_WARN_NAMED("cmd", "CMD: Command %u -- wait ack timeout", command);
+			ack_waiting_table.erase(command);
+			is_timeout = true;
 		}
 
+		success = !is_timeout && ack_result == enum_value(MAV_RESULT::ACCEPTED);
+		result = ack_result;
 		return true;
 	}
 
+	void publish_async_result(uint32_t id, uint16_t command, bool timeout, uint8_t result)
+	{
+		using mavlink::common::MAV_RESULT;
+
+		auto msg = boost::make_shared<mavros_msgs::CommandAsyncResult>();
+		msg->header.stamp = ros::Time::now();
+		msg->id = id;
+		msg->command = command;
+		msg->success = !timeout && result == enum_value(MAV_RESULT::ACCEPTED);
+		msg->timeout = timeout;
+		msg->result = result;
+		async_result_pub.publish(msg);
+	}
+
 	/**
 	 * Common function for COMMAND_INT service callbacks.
 	 */
@@ -297,6 +382,42 @@ private:
 
 	/* -*- callbacks -*- */
 
+	void command_async_cb(const mavros_msgs::CommandLongAsync::ConstPtr &req)
+	{
+		using mavlink::common::MAV_RESULT;
+
+		lock_guard lock(mutex);
+
+		const uint32_t id = req->id;
+		const uint16_t command = req->command;
+
+		if (!is_ack_required(req->broadcast, req->confirmation)) {
+			command_long(req->broadcast,
+				command, req->confirmation,
+				req->param1, req->param2,
+				req->param3, req->param4,
+				req->param5, req->param6,
+				req->param7);
+
+			publish_async_result(id, command, false, enum_value(MAV_RESULT::ACCEPTED));
+			return;
+		}
+
+		if (!add_transaction(command, [this, id, command](bool timeout, uint8_t result) {
+				publish_async_result(id, command, timeout, result);
+			})) {
+			publish_async_result(id, command, false, enum_value(MAV_RESULT::TEMPORARILY_REJECTED));
+			return;
+		}
+
+		command_long(req->broadcast,
+			command, req->confirmation,
+			req->param1, req->param2,
+			req->param3, req->param4,
+			req->param5, req->param6,
+			req->param7);
+	}
+
 	bool command_long_cb(mavros_msgs::CommandLong::Request &req,
 		mavros_msgs::CommandLong::Response &res)
 	{
@@ -409,5 +530,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::CommandPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::CommandPlugin)
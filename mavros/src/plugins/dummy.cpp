@@ -28,7 +28,7 @@ namespace std_plugins {
 class DummyPlugin : public plugin::PluginBase {
 public:
 	DummyPlugin() : PluginBase(),
-		nh("~")
+		nh(private_nh())
 	{ }
 
 	/**
@@ -37,6 +37,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		ROS_INFO_NAMED("dummy", "Dummy::initialize");
 	}
@@ -83,5 +84,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::DummyPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::DummyPlugin)
@@ -15,8 +15,14 @@
  */
 
 #include <chrono>
+#include <deque>
+#include <unordered_map>
 #include <cerrno>
 #include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <boost/crc.hpp>
 #include <mavros/mavros_plugin.h>
 
 #include <std_srvs/Empty.h>
@@ -32,6 +38,7 @@
 #include <mavros_msgs/FileTruncate.h>
 #include <mavros_msgs/FileRename.h>
 #include <mavros_msgs/FileChecksum.h>
+#include <mavros_msgs/FileDownload.h>
 
 // enable debugging messages
 //#define FTP_LL_DEBUG
@@ -55,7 +62,8 @@ public:
 		uint8_t		opcode;		///< Command opcode
 		uint8_t		size;		///< Size of data
 		uint8_t		req_opcode;	///< Request opcode returned in kRspAck, kRspNak message
-		uint8_t		padding[2];	///< 32 bit aligment padding
+		uint8_t		burst_complete;	///< Last packet of kCmdBurstReadFile burst
+		uint8_t		padding;	///< 32 bit aligment padding
 		uint32_t	offset;		///< Offsets for List and Read commands
 		uint8_t		data[];		///< command data, varies by Opcode
 	};
@@ -193,33 +201,33 @@ public:
 
 /**
  * @brief FTP plugin.
+ *
+ * Each service call runs its own operation, several operations
+ * may be in flight over one FILE_TRANSFER_PROTOCOL stream.
+ * Replies routed to operation by seqNumber, burst packets by session.
  */
 class FTPPlugin : public plugin::PluginBase {
 public:
 	FTPPlugin() : PluginBase(),
-		ftp_nh("~ftp"),
-		op_state(OP::IDLE),
+		ftp_nh(private_nh("ftp")),
 		last_send_seqnr(0),
-		active_session(0),
-		is_error(false),
-		r_errno(0),
-		list_offset(0),
-		read_offset(0),
-		write_offset(0),
-		open_size(0),
-		read_size(0),
-		read_buffer {},
-		checksum_crc32(0)
+		burst_supported(true),
+		write_window(8)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(ftp_nh);
 
 		// since C++ generator do not produce field length defs make check explicit.
 		FTPRequest r;
 		ROS_ASSERT(r.payload.size() - sizeof(FTPRequest::PayloadHeader) == r.DATA_MAXSZ);
 
+		ftp_nh.param("burst_read", burst_supported, true);
+		ftp_nh.param("write_window", write_window, 8);
+		write_window = std::max(1, write_window);
+
 		list_srv = ftp_nh.advertiseService("list", &FTPPlugin::list_cb, this);
 		open_srv = ftp_nh.advertiseService("open", &FTPPlugin::open_cb, this);
 		close_srv = ftp_nh.advertiseService("close", &FTPPlugin::close_cb, this);
@@ -232,6 +240,7 @@ public:
 		reset_srv = ftp_nh.advertiseService("reset", &FTPPlugin::reset_cb, this);
 		rename_srv = ftp_nh.advertiseService("rename", &FTPPlugin::rename_cb, this);
 		checksum_srv = ftp_nh.advertiseService("checksum", &FTPPlugin::checksum_cb, this);
+		download_srv = ftp_nh.advertiseService("download", &FTPPlugin::download_cb, this);
 	}
 
 	Subscriptions get_subscriptions()
@@ -255,10 +264,13 @@ private:
 	ros::ServiceServer truncate_srv;
 	ros::ServiceServer reset_srv;
 	ros::ServiceServer checksum_srv;
+	ros::ServiceServer download_srv;
 
 	//! This type used in servicies to store 'data' fileds.
 	typedef std::vector<uint8_t> V_FileData;
 
+	using unique_lock = std::unique_lock<std::mutex>;
+
 	enum class OP {
 		IDLE,
 		ACK,
@@ -269,37 +281,82 @@ private:
 		CHECKSUM
 	};
 
-	OP op_state;
-	uint16_t last_send_seqnr;	//!< seqNumber for send.
-	uint32_t active_session;	//!< session id of current operation
+	//! Unacknowledged kCmdWriteFile
+	struct WriteChunk {
+		uint32_t offset;
+		uint8_t size;
+	};
 
-	std::mutex cond_mutex;
-	std::condition_variable cond;	//!< wait condvar
-	bool is_error;			//!< error signaling flag (timeout/proto error)
-	int r_errno;			//!< store errno from server
+	/**
+	 * @brief State of one operation
+	 *
+	 * Owned by service callback, registered in @a pending
+	 * while its request waits for reply.
+	 */
+	struct Operation {
+		OP state;
+		std::vector<uint16_t> reply_seqnrs;	//!< expected replies, registered in pending
+		size_t progress;		//!< replies received, for stall detection
+		uint32_t session;		//!< session id of read/write
+		std::condition_variable cond;	//!< wait condvar
+		bool is_error;			//!< error signaling flag (timeout/proto error)
+		int r_errno;			//!< store errno from server
+
+		// FTP:List
+		uint32_t list_offset;
+		std::string list_path;
+		std::vector<mavros_msgs::FileEntry> list_entries;
+
+		// FTP:Open
+		std::string open_path;
+		size_t open_size;
+
+		// FTP:Read
+		size_t read_size;
+		uint32_t read_offset;		//!< next offset to request
+		uint32_t read_start;		//!< offset of read_buffer[0]
+		size_t read_data_end;		//!< end offset of received data
+		bool read_burst;		//!< kCmdBurstReadFile in progress
+		std::deque<std::pair<uint32_t, uint32_t>> read_gaps;	//!< chunks lost in burst [start, end)
+		V_FileData read_buffer;
+
+		// FTP:Write
+		uint32_t write_offset;		//!< offset of write_buffer[0]
+		size_t write_sent;		//!< bytes of write_buffer sent at least once
+		V_FileData write_buffer;
+		std::unordered_map<uint16_t, WriteChunk> write_inflight;	//!< by reply seqNumber
+
+		// FTP:CalcCRC32
+		uint32_t checksum_crc32;
+
+		Operation() :
+			state(OP::IDLE),
+			progress(0),
+			session(0),
+			is_error(false),
+			r_errno(0),
+			list_offset(0),
+			open_size(0),
+			read_size(0),
+			read_offset(0),
+			read_start(0),
+			read_data_end(0),
+			read_burst(false),
+			write_offset(0),
+			write_sent(0),
+			checksum_crc32(0)
+		{ }
+	};
 
-	// FTP:List
-	uint32_t list_offset;
-	std::string list_path;
-	std::vector<mavros_msgs::FileEntry> list_entries;
+	std::mutex mutex;		//!< guards all operations and session map
+	uint16_t last_send_seqnr;	//!< seqNumber of last request
+	std::unordered_map<uint16_t, Operation *> pending;	//!< operations by expected reply seqNumber
 
 	// FTP:Open / FTP:Close
-	std::string open_path;
-	size_t open_size;
 	std::map<std::string, uint32_t> session_file_map;
 
-	// FTP:Read
-	size_t read_size;
-	uint32_t read_offset;
-	V_FileData read_buffer;
-
-	// FTP:Write
-	uint32_t write_offset;
-	V_FileData write_buffer;
-	V_FileData::iterator write_it;
-
-	// FTP:CalcCRC32
-	uint32_t checksum_crc32;
+	bool burst_supported;		//!< server accepts kCmdBurstReadFile
+	int write_window;		//!< kCmdWriteFile requests in flight
 
 	// Timeouts,
 	// computed as x4 time that needed for transmission of
@@ -308,12 +365,11 @@ private:
 	static constexpr int OPEN_TIMEOUT_MS = 200;
 	static constexpr int CHUNK_TIMEOUT_MS = 200;
 
-	//! Maximum difference between allocated space and used
-	static constexpr size_t MAX_RESERVE_DIFF = 0x10000;
+	//! ftp/download transfer unit, bounds memory use
+	static constexpr size_t DOWNLOAD_PIECE_SIZE = 0x100000;
 
 	//! @todo exchange speed calculation
 	//! @todo diagnostics
-	//! @todo multisession not present anymore
 
 	/* -*- message handler -*- */
 
@@ -326,92 +382,121 @@ private:
 			return;
 		}
 
-		const uint16_t incoming_seqnr = req.header()->seqNumber;
-		const uint16_t expected_seqnr = last_send_seqnr + 1;
-		if (incoming_seqnr != expected_seqnr) {
-			ROS_WARN_NAMED("ftp", "FTP: Lost sync! seqnr: %u != %u",
-					incoming_seqnr, expected_seqnr);
-			go_idle(true, EILSEQ);
-			return;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto hdr = req.header();
+		Operation *op = nullptr;
+		if (hdr->req_opcode == FTPRequest::kCmdBurstReadFile) {
+			// server numbers burst packets itself, so they found by session.
+			// Burst may outlive our read, drop its tail.
+			op = find_burst(hdr->session);
+			if (!op) {
+				ROS_DEBUG_NAMED("ftp", "FTP: dropping stale burst packet, seqnr: %u", hdr->seqNumber);
+				return;
+			}
 		}
+		else {
+			auto it = pending.find(hdr->seqNumber);
+			if (it == pending.end()) {
+				// send_reset() does not wait for its reply
+				if (hdr->req_opcode == FTPRequest::kCmdResetSessions)
+					ROS_DEBUG_NAMED("ftp", "FTP: Reset reply, seqnr: %u", hdr->seqNumber);
+				else
+					ROS_WARN_NAMED("ftp", "FTP: Unexpected reply, seqnr: %u", hdr->seqNumber);
+				return;
+			}
 
-		last_send_seqnr = incoming_seqnr;
+			op = it->second;
+			pending.erase(it);
+			op->reply_seqnrs.erase(std::find(op->reply_seqnrs.begin(), op->reply_seqnrs.end(), hdr->seqNumber));
+		}
 
 		// logic from QGCUASFileManager.cc
-		if (req.header()->opcode == FTPRequest::kRspAck)
-			handle_req_ack(req);
-		else if (req.header()->opcode == FTPRequest::kRspNak)
-			handle_req_nack(req);
+		if (hdr->opcode == FTPRequest::kRspAck)
+			handle_req_ack(*op, req);
+		else if (hdr->opcode == FTPRequest::kRspNak)
+			handle_req_nack(*op, req);
 		else {
-			ROS_ERROR_NAMED("ftp", "FTP: Unknown request response: %u", req.header()->opcode);
-			go_idle(true, EBADRQC);
+			ROS_ERROR_NAMED("ftp", "FTP: Unknown request response: %u", hdr->opcode);
+			go_idle(*op, true, EBADRQC);
 		}
 	}
 
-	void handle_req_ack(FTPRequest &req)
+	void handle_req_ack(Operation &op, FTPRequest &req)
 	{
-		switch (op_state) {
-		case OP::IDLE:		send_reset();			break;
-		case OP::ACK:		go_idle(false);			break;
-		case OP::LIST:		handle_ack_list(req);		break;
-		case OP::OPEN:		handle_ack_open(req);		break;
-		case OP::READ:		handle_ack_read(req);		break;
-		case OP::WRITE:		handle_ack_write(req);		break;
-		case OP::CHECKSUM:	handle_ack_checksum(req);	break;
+		switch (op.state) {
+		case OP::ACK:		go_idle(op, false);		break;
+		case OP::LIST:		handle_ack_list(op, req);	break;
+		case OP::OPEN:		handle_ack_open(op, req);	break;
+		case OP::READ:		handle_ack_read(op, req);	break;
+		case OP::WRITE:		handle_ack_write(op, req);	break;
+		case OP::CHECKSUM:	handle_ack_checksum(op, req);	break;
 		default:
 			ROS_ERROR_NAMED("ftp", "FTP: wrong op_state");
-			go_idle(true, EBADRQC);
+			go_idle(op, true, EBADRQC);
 		}
 	}
 
-	void handle_req_nack(FTPRequest &req)
+	void handle_req_nack(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 		auto error_code = static_cast<FTPRequest::ErrorCode>(req.data()[0]);
-		auto prev_op = op_state;
+		auto prev_op = op.state;
 
 		ROS_ASSERT(hdr->size == 1 || (error_code == FTPRequest::kErrFailErrno && hdr->size == 2));
 
-		op_state = OP::IDLE;
+		op.state = OP::IDLE;
 		if (error_code == FTPRequest::kErrFailErrno)
-			r_errno = req.data()[1];
+			op.r_errno = req.data()[1];
 		// translate other protocol errors to errno
 		else if (error_code == FTPRequest::kErrFail)
-			r_errno = EFAULT;
+			op.r_errno = EFAULT;
 		else if (error_code == FTPRequest::kErrInvalidDataSize)
-			r_errno = EMSGSIZE;
+			op.r_errno = EMSGSIZE;
 		else if (error_code == FTPRequest::kErrInvalidSession)
-			r_errno = EBADFD;
+			op.r_errno = EBADFD;
 		else if (error_code == FTPRequest::kErrNoSessionsAvailable)
-			r_errno = EMFILE;
+			op.r_errno = EMFILE;
 		else if (error_code == FTPRequest::kErrUnknownCommand)
-			r_errno = ENOSYS;
+			op.r_errno = ENOSYS;
 
 		if (prev_op == OP::LIST && error_code == FTPRequest::kErrEOF) {
 			/* dir list done */
-			list_directory_end();
+			list_directory_end(op);
 			return;
 		}
 		else if (prev_op == OP::READ && error_code == FTPRequest::kErrEOF) {
 			/* read done */
-			read_file_end();
+			op.state = OP::READ;
+			if (op.read_burst)
+				read_burst_end(op);
+			else
+				read_file_end(op);
+			return;
+		}
+		else if (prev_op == OP::READ && op.read_burst && error_code == FTPRequest::kErrUnknownCommand) {
+			ROS_INFO_NAMED("ftp", "FTP: server does not support burst read, fall back to kCmdReadFile");
+			burst_supported = false;
+			op.read_burst = false;
+			op.state = OP::READ;
+			send_read_command(op);
 			return;
 		}
 
 		ROS_ERROR_NAMED("ftp", "FTP: NAK: %u Opcode: %u State: %u Errno: %d (%s)",
-				error_code, hdr->req_opcode, enum_value(prev_op), r_errno, strerror(r_errno));
-		go_idle(true);
+				error_code, hdr->req_opcode, enum_value(prev_op), op.r_errno, strerror(op.r_errno));
+		go_idle(op, true);
 	}
 
-	void handle_ack_list(FTPRequest &req)
+	void handle_ack_list(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 
 		ROS_DEBUG_NAMED("ftp", "FTP:m: ACK List SZ(%u) OFF(%u)", hdr->size, hdr->offset);
-		if (hdr->offset != list_offset) {
+		if (hdr->offset != op.list_offset) {
 			ROS_ERROR_NAMED("ftp", "FTP: Wrong list offset, req %u, ret %u",
-					list_offset, hdr->offset);
-			go_idle(true, EBADE);
+					op.list_offset, hdr->offset);
+			go_idle(op, true, EBADE);
 			return;
 		}
 
@@ -426,18 +511,18 @@ private:
 			if ((ptr[0] == FTPRequest::DIRENT_SKIP && slen > 1) ||
 					(ptr[0] != FTPRequest::DIRENT_SKIP && slen < 2)) {
 				ROS_ERROR_NAMED("ftp", "FTP: Incorrect list entry: %s", ptr);
-				go_idle(true, ERANGE);
+				go_idle(op, true, ERANGE);
 				return;
 			}
 			else if (slen == bytes_left) {
 				ROS_ERROR_NAMED("ftp", "FTP: Missing NULL termination in list entry");
-				go_idle(true, EOVERFLOW);
+				go_idle(op, true, EOVERFLOW);
 				return;
 			}
 
 			if (ptr[0] == FTPRequest::DIRENT_FILE ||
 					ptr[0] == FTPRequest::DIRENT_DIR) {
-				add_dirent(ptr, slen);
+				add_dirent(op, ptr, slen);
 			}
 			else if (ptr[0] == FTPRequest::DIRENT_SKIP) {
 				// do nothing
@@ -452,78 +537,137 @@ private:
 
 		if (hdr->size == 0) {
 			// dir empty, we are done
-			list_directory_end();
+			list_directory_end(op);
 		}
 		else {
 			ROS_ASSERT_MSG(n_list_entries > 0, "FTP:List don't parse entries");
 			// Possibly more to come, try get more
-			list_offset += n_list_entries;
-			send_list_command();
+			op.list_offset += n_list_entries;
+			send_list_command(op);
 		}
 	}
 
-	void handle_ack_open(FTPRequest &req)
+	void handle_ack_open(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 
 		ROS_DEBUG_NAMED("ftp", "FTP:m: ACK Open OPCODE(%u)", hdr->req_opcode);
 		ROS_ASSERT(hdr->size == sizeof(uint32_t));
-		open_size = *req.data_u32();
+		op.open_size = *req.data_u32();
 
 		ROS_INFO_NAMED("ftp", "FTP:Open %s: success, session %u, size %zu",
-				open_path.c_str(), hdr->session, open_size);
-		session_file_map.insert(std::make_pair(open_path, hdr->session));
-		go_idle(false);
+				op.open_path.c_str(), hdr->session, op.open_size);
+		session_file_map.insert(std::make_pair(op.open_path, hdr->session));
+		go_idle(op, false);
 	}
 
-	void handle_ack_read(FTPRequest &req)
+	void handle_ack_read(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 
 		ROS_DEBUG_NAMED("ftp", "FTP:m: ACK Read SZ(%u)", hdr->size);
-		if (hdr->session != active_session) {
+		if (hdr->session != op.session) {
 			ROS_ERROR_NAMED("ftp", "FTP:Read unexpected session");
-			go_idle(true, EBADSLT);
+			go_idle(op, true, EBADSLT);
+			return;
+		}
+
+		if (op.read_burst) {
+			handle_ack_burst_read(op, req);
 			return;
 		}
 
-		if (hdr->offset != read_offset) {
+		if (hdr->offset != op.read_offset) {
 			ROS_ERROR_NAMED("ftp", "FTP:Read different offset");
-			go_idle(true, EBADE);
+			go_idle(op, true, EBADE);
 			return;
 		}
 
 		// kCmdReadFile return cunks of DATA_MAXSZ or smaller (last chunk)
 		// We requested specific amount of data, that can be smaller,
 		// but not larger.
-		const size_t bytes_left = read_size - read_buffer.size();
-		const size_t bytes_to_copy = std::min<size_t>(bytes_left, hdr->size);
-
-		read_buffer.insert(read_buffer.end(), req.data(), req.data() + bytes_to_copy);
-
-		if (bytes_to_copy == FTPRequest::DATA_MAXSZ) {
+		const size_t bytes_to_copy = store_chunk(op, hdr->offset, req.data(), hdr->size);
+		op.progress++;
+
+		if (!op.read_gaps.empty()) {
+			// re-reading chunks lost in burst
+			auto &gap = op.read_gaps.front();
+			gap.first += hdr->size;
+			if (gap.first >= gap.second || hdr->size == 0)
+				op.read_gaps.pop_front();
+
+			if (op.read_gaps.empty())
+				read_file_end(op);
+			else {
+				op.read_offset = op.read_gaps.front().first;
+				send_read_command(op);
+			}
+		}
+		else if (bytes_to_copy == FTPRequest::DATA_MAXSZ) {
 			// Possibly more data
-			read_offset += bytes_to_copy;
-			send_read_command();
+			op.read_offset += bytes_to_copy;
+			send_read_command(op);
 		}
 		else
-			read_file_end();
+			read_file_end(op);
 	}
 
-	void handle_ack_write(FTPRequest &req)
+	/**
+	 * @brief Chunk of kCmdBurstReadFile
+	 *
+	 * Offset jump means lost chunks, they stored to @a read_gaps
+	 * and re-read by kCmdReadFile after burst.
+	 */
+	void handle_ack_burst_read(Operation &op, FTPRequest &req)
+	{
+		auto hdr = req.header();
+		const size_t read_end = op.read_start + op.read_size;
+
+		if (hdr->offset < op.read_offset) {
+			ROS_DEBUG_NAMED("ftp", "FTP:Read duplicate chunk, off: %u", hdr->offset);
+		}
+		else {
+			if (hdr->offset > op.read_offset) {
+				ROS_DEBUG_NAMED("ftp", "FTP:Read lost chunks %u - %u", op.read_offset, hdr->offset);
+				op.read_gaps.emplace_back(op.read_offset, std::min<size_t>(hdr->offset, read_end));
+			}
+
+			store_chunk(op, hdr->offset, req.data(), hdr->size);
+			op.read_offset = hdr->offset + hdr->size;
+		}
+
+		op.progress++;
+
+		if (op.read_offset >= read_end)
+			read_burst_end(op);
+		else if (hdr->burst_complete)
+			send_burst_read_command(op);
+	}
+
+	void handle_ack_write(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 
 		ROS_DEBUG_NAMED("ftp", "FTP:m: ACK Write SZ(%u)", hdr->size);
-		if (hdr->session != active_session) {
+		if (hdr->session != op.session) {
 			ROS_ERROR_NAMED("ftp", "FTP:Write unexpected session");
-			go_idle(true, EBADSLT);
+			go_idle(op, true, EBADSLT);
 			return;
 		}
 
-		if (hdr->offset != write_offset) {
+		auto chunk_it = op.write_inflight.find(hdr->seqNumber);
+		if (chunk_it == op.write_inflight.end()) {
+			ROS_ERROR_NAMED("ftp", "FTP:Write unexpected ack");
+			go_idle(op, true, EBADE);
+			return;
+		}
+
+		const auto chunk = chunk_it->second;
+		op.write_inflight.erase(chunk_it);
+
+		if (hdr->offset != chunk.offset) {
 			ROS_ERROR_NAMED("ftp", "FTP:Write different offset");
-			go_idle(true, EBADE);
+			go_idle(op, true, EBADE);
 			return;
 		}
 
@@ -531,33 +675,34 @@ private:
 		const size_t bytes_written = *req.data_u32();
 
 		// check that reported size not out of range
-		const size_t bytes_left_before_advance = std::distance(write_it, write_buffer.end());
-		ROS_ASSERT_MSG(bytes_written <= bytes_left_before_advance, "Bad write size");
-		ROS_ASSERT(bytes_written != 0);
-
-		// move iterator to written size
-		std::advance(write_it, bytes_written);
-
-		const size_t bytes_to_copy = write_bytes_to_copy();
-		if (bytes_to_copy > 0) {
-			// More data to write
-			write_offset += bytes_written;
-			send_write_command(bytes_to_copy);
+		if (bytes_written == 0 || bytes_written > chunk.size) {
+			ROS_ERROR_NAMED("ftp", "FTP:Write bad write size: %zu of %u", bytes_written, chunk.size);
+			go_idle(op, true, EIO);
+			return;
 		}
+
+		op.progress++;
+
+		// short write, send rest of chunk again
+		if (bytes_written < chunk.size)
+			send_write_command(op, WriteChunk{uint32_t(chunk.offset + bytes_written), uint8_t(chunk.size - bytes_written)});
+
+		if (op.write_inflight.empty() && op.write_sent == op.write_buffer.size())
+			write_file_end(op);
 		else
-			write_file_end();
+			fill_write_window(op);
 	}
 
-	void handle_ack_checksum(FTPRequest &req)
+	void handle_ack_checksum(Operation &op, FTPRequest &req)
 	{
 		auto hdr = req.header();
 
 		ROS_DEBUG_NAMED("ftp", "FTP:m: ACK CalcFileCRC32 OPCODE(%u)", hdr->req_opcode);
 		ROS_ASSERT(hdr->size == sizeof(uint32_t));
-		checksum_crc32 = *req.data_u32();
+		op.checksum_crc32 = *req.data_u32();
 
-		ROS_DEBUG_NAMED("ftp", "FTP:Checksum: success, crc32: 0x%08x", checksum_crc32);
-		go_idle(false);
+		ROS_DEBUG_NAMED("ftp", "FTP:Checksum: success, crc32: 0x%08x", op.checksum_crc32);
+		go_idle(op, false);
 	}
 
 	/* -*- send helpers -*- */
@@ -568,13 +713,76 @@ private:
 	 * @param is_error_ mark that caused in error case
 	 * @param r_errno_ set r_errno in error case
 	 */
-	void go_idle(bool is_error_, int r_errno_ = 0)
+	void go_idle(Operation &op, bool is_error_, int r_errno_ = 0)
 	{
-		op_state = OP::IDLE;
-		is_error = is_error_;
-		if (is_error && r_errno_ != 0) r_errno = r_errno_;
-		else if (!is_error) r_errno = 0;
-		cond.notify_all();
+		unregister(op);
+		op.write_inflight.clear();
+		op.state = OP::IDLE;
+		op.is_error = is_error_;
+		if (op.is_error && r_errno_ != 0) op.r_errno = r_errno_;
+		else if (!op.is_error) op.r_errno = 0;
+		op.cond.notify_all();
+	}
+
+	//! Forget expected replies of operation
+	void unregister(Operation &op)
+	{
+		for (auto seqnr : op.reply_seqnrs)
+			pending.erase(seqnr);
+
+		op.reply_seqnrs.clear();
+	}
+
+	//! Operation doing burst read of session
+	Operation *find_burst(uint32_t session)
+	{
+		for (auto &kv : pending) {
+			auto op = kv.second;
+			if (op->state == OP::READ && op->read_burst && op->session == session)
+				return op;
+		}
+
+		return nullptr;
+	}
+
+	//! Session already used by other read or write
+	bool session_busy(uint32_t session)
+	{
+		for (auto &kv : pending) {
+			auto op = kv.second;
+			if ((op->state == OP::READ || op->state == OP::WRITE) && op->session == session)
+				return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief Send request of operation, replaces its previous request
+	 *
+	 * Each request gets own seqNumber, so replies of
+	 * different operations do not mix.
+	 */
+	void send_request(Operation &op, FTPRequest &req)
+	{
+		unregister(op);
+		send_window_request(op, req);
+	}
+
+	/**
+	 * @brief Send one more request of operation
+	 *
+	 * @return seqNumber of expected reply
+	 */
+	uint16_t send_window_request(Operation &op, FTPRequest &req)
+	{
+		const uint16_t seqnr = ++last_send_seqnr;
+		const uint16_t reply_seqnr = seqnr + 1;
+		op.reply_seqnrs.push_back(reply_seqnr);
+		pending[reply_seqnr] = &op;
+
+		req.send(m_uas, seqnr);
+		return reply_seqnr;
 	}
 
 	void send_reset()
@@ -586,72 +794,114 @@ private:
 			session_file_map.clear();
 		}
 
-		op_state = OP::ACK;
+		// reply not awaited
 		FTPRequest req(FTPRequest::kCmdResetSessions);
-		req.send(m_uas, last_send_seqnr);
+		req.send(m_uas, ++last_send_seqnr);
 	}
 
 	/// Send any command with string payload (usually file/dir path)
-	inline void send_any_path_command(FTPRequest::Opcode op, const std::string &debug_msg, std::string &path, uint32_t offset)
+	inline void send_any_path_command(Operation &op, FTPRequest::Opcode opcode, const std::string &debug_msg, std::string &path, uint32_t offset)
 	{
 		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: " << debug_msg << path << " off: " << offset);
-		FTPRequest req(op);
+		FTPRequest req(opcode);
 		req.header()->offset = offset;
 		req.set_data_string(path);
-		req.send(m_uas, last_send_seqnr);
+		send_request(op, req);
 	}
 
-	void send_list_command() {
-		send_any_path_command(FTPRequest::kCmdListDirectory, "kCmdListDirectory: ", list_path, list_offset);
+	void send_list_command(Operation &op) {
+		send_any_path_command(op, FTPRequest::kCmdListDirectory, "kCmdListDirectory: ", op.list_path, op.list_offset);
 	}
 
-	void send_open_ro_command() {
-		send_any_path_command(FTPRequest::kCmdOpenFileRO, "kCmdOpenFileRO: ", open_path, 0);
+	void send_open_ro_command(Operation &op) {
+		send_any_path_command(op, FTPRequest::kCmdOpenFileRO, "kCmdOpenFileRO: ", op.open_path, 0);
 	}
 
-	void send_open_wo_command() {
-		send_any_path_command(FTPRequest::kCmdOpenFileWO, "kCmdOpenFileWO: ", open_path, 0);
+	void send_open_wo_command(Operation &op) {
+		send_any_path_command(op, FTPRequest::kCmdOpenFileWO, "kCmdOpenFileWO: ", op.open_path, 0);
 	}
 
-	void send_create_command() {
-		send_any_path_command(FTPRequest::kCmdCreateFile, "kCmdCreateFile: ", open_path, 0);
+	void send_create_command(Operation &op) {
+		send_any_path_command(op, FTPRequest::kCmdCreateFile, "kCmdCreateFile: ", op.open_path, 0);
 	}
 
-	void send_terminate_command(uint32_t session)
+	void send_terminate_command(Operation &op, uint32_t session)
 	{
 		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdTerminateSession: " << session);
 		FTPRequest req(FTPRequest::kCmdTerminateSession, session);
 		req.header()->offset = 0;
 		req.header()->size = 0;
-		req.send(m_uas, last_send_seqnr);
+		send_request(op, req);
 	}
 
-	void send_read_command()
+	void send_read_command(Operation &op)
 	{
 		// read operation always try read DATA_MAXSZ block (hdr->size ignored)
-		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdReadFile: " << active_session << " off: " << read_offset);
-		FTPRequest req(FTPRequest::kCmdReadFile, active_session);
-		req.header()->offset = read_offset;
+		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdReadFile: " << op.session << " off: " << op.read_offset);
+		FTPRequest req(FTPRequest::kCmdReadFile, op.session);
+		req.header()->offset = op.read_offset;
 		req.header()->size = 0 /* FTPRequest::DATA_MAXSZ */;
-		req.send(m_uas, last_send_seqnr);
+		send_request(op, req);
+	}
+
+	void send_burst_read_command(Operation &op)
+	{
+		// server streams DATA_MAXSZ chunks from offset until burst end or EOF
+		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdBurstReadFile: " << op.session << " off: " << op.read_offset);
+		FTPRequest req(FTPRequest::kCmdBurstReadFile, op.session);
+		req.header()->offset = op.read_offset;
+		req.header()->size = 0;
+		send_request(op, req);
+	}
+
+	void send_write_command(Operation &op, const WriteChunk &chunk)
+	{
+		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdWriteFile: " << op.session << " off: " << chunk.offset << " sz: " << unsigned(chunk.size));
+		FTPRequest req(FTPRequest::kCmdWriteFile, op.session);
+		req.header()->offset = chunk.offset;
+		req.header()->size = chunk.size;
+
+		auto data_it = op.write_buffer.begin() + (chunk.offset - op.write_offset);
+		std::copy(data_it, data_it + chunk.size, req.data());
+
+		op.write_inflight[send_window_request(op, req)] = chunk;
+	}
+
+	//! Keep write_window chunks in flight
+	void fill_write_window(Operation &op)
+	{
+		while (op.write_inflight.size() < size_t(write_window) && op.write_sent < op.write_buffer.size()) {
+			const size_t bytes_to_copy = std::min<size_t>(op.write_buffer.size() - op.write_sent,
+					FTPRequest::DATA_MAXSZ);
+
+			send_write_command(op, WriteChunk{uint32_t(op.write_offset + op.write_sent), uint8_t(bytes_to_copy)});
+			op.write_sent += bytes_to_copy;
+		}
 	}
 
-	void send_write_command(const size_t bytes_to_copy)
+	//! Send unacknowledged chunks again, with new seqNumbers
+	void resend_write_window(Operation &op)
 	{
-		// write chunk from write_buffer [write_it..bytes_to_copy]
-		ROS_DEBUG_STREAM_NAMED("ftp", "FTP:m: kCmdWriteFile: " << active_session << " off: " << write_offset << " sz: " << bytes_to_copy);
-		FTPRequest req(FTPRequest::kCmdWriteFile, active_session);
-		req.header()->offset = write_offset;
-		req.header()->size = bytes_to_copy;
-		std::copy(write_it, write_it + bytes_to_copy, req.data());
-		req.send(m_uas, last_send_seqnr);
+		std::vector<WriteChunk> chunks;
+		chunks.reserve(op.write_inflight.size());
+		for (auto &kv : op.write_inflight)
+			chunks.push_back(kv.second);
+
+		unregister(op);
+		op.write_inflight.clear();
+
+		// keep offset order, server may extend file by each write
+		std::sort(chunks.begin(), chunks.end(),
+				[](const WriteChunk &a, const WriteChunk &b) { return a.offset < b.offset; });
+		for (auto &chunk : chunks)
+			send_write_command(op, chunk);
 	}
 
-	void send_remove_command(std::string &path) {
-		send_any_path_command(FTPRequest::kCmdRemoveFile, "kCmdRemoveFile: ", path, 0);
+	void send_remove_command(Operation &op, std::string &path) {
+		send_any_path_command(op, FTPRequest::kCmdRemoveFile, "kCmdRemoveFile: ", path, 0);
 	}
 
-	bool send_rename_command(std::string &old_path, std::string &new_path)
+	bool send_rename_command(Operation &op, std::string &old_path, std::string &new_path)
 	{
 		std::ostringstream os;
 		os << old_path;
@@ -661,33 +911,33 @@ private:
 		std::string paths = os.str();
 		if (paths.size() >= FTPRequest::DATA_MAXSZ) {
 			ROS_ERROR_NAMED("ftp", "FTP: rename file paths is too long: %zu", paths.size());
-			r_errno = ENAMETOOLONG;
+			op.r_errno = ENAMETOOLONG;
 			return false;
 		}
 
-		send_any_path_command(FTPRequest::kCmdRename, "kCmdRename: ", paths, 0);
+		send_any_path_command(op, FTPRequest::kCmdRename, "kCmdRename: ", paths, 0);
 		return true;
 	}
 
-	void send_truncate_command(std::string &path, size_t length) {
-		send_any_path_command(FTPRequest::kCmdTruncateFile, "kCmdTruncateFile: ", path, length);
+	void send_truncate_command(Operation &op, std::string &path, size_t length) {
+		send_any_path_command(op, FTPRequest::kCmdTruncateFile, "kCmdTruncateFile: ", path, length);
 	}
 
-	void send_create_dir_command(std::string &path) {
-		send_any_path_command(FTPRequest::kCmdCreateDirectory, "kCmdCreateDirectory: ", path, 0);
+	void send_create_dir_command(Operation &op, std::string &path) {
+		send_any_path_command(op, FTPRequest::kCmdCreateDirectory, "kCmdCreateDirectory: ", path, 0);
 	}
 
-	void send_remove_dir_command(std::string &path) {
-		send_any_path_command(FTPRequest::kCmdRemoveDirectory, "kCmdRemoveDirectory: ", path, 0);
+	void send_remove_dir_command(Operation &op, std::string &path) {
+		send_any_path_command(op, FTPRequest::kCmdRemoveDirectory, "kCmdRemoveDirectory: ", path, 0);
 	}
 
-	void send_calc_file_crc32_command(std::string &path) {
-		send_any_path_command(FTPRequest::kCmdCalcFileCRC32, "kCmdCalcFileCRC32: ", path, 0);
+	void send_calc_file_crc32_command(Operation &op, std::string &path) {
+		send_any_path_command(op, FTPRequest::kCmdCalcFileCRC32, "kCmdCalcFileCRC32: ", path, 0);
 	}
 
 	/* -*- helpers -*- */
 
-	void add_dirent(const char *ptr, size_t slen)
+	void add_dirent(Operation &op, const char *ptr, size_t slen)
 	{
 		mavros_msgs::FileEntry ent;
 		ent.size = 0;
@@ -715,194 +965,422 @@ private:
 			ROS_DEBUG_STREAM_NAMED("ftp", "FTP:List File: " << ent.name << " SZ: " << ent.size);
 		}
 
-		list_entries.push_back(ent);
+		op.list_entries.push_back(ent);
 	}
 
-	void list_directory_end() {
+	void list_directory_end(Operation &op) {
 		ROS_DEBUG_NAMED("ftp", "FTP:List done");
-		go_idle(false);
+		go_idle(op, false);
 	}
 
-	void list_directory(std::string &path)
+	void list_directory(Operation &op, std::string &path)
 	{
-		list_offset = 0;
-		list_path = path;
-		list_entries.clear();
-		op_state = OP::LIST;
+		op.list_offset = 0;
+		op.list_path = path;
+		op.list_entries.clear();
+		op.state = OP::LIST;
 
-		send_list_command();
+		send_list_command(op);
 	}
 
-	bool open_file(std::string &path, int mode)
+	bool open_file(Operation &op, std::string &path, int mode)
 	{
-		open_path = path;
-		open_size = 0;
-		op_state = OP::OPEN;
+		op.open_path = path;
+		op.open_size = 0;
+		op.state = OP::OPEN;
 
 		if (mode == mavros_msgs::FileOpenRequest::MODE_READ)
-			send_open_ro_command();
+			send_open_ro_command(op);
 		else if (mode == mavros_msgs::FileOpenRequest::MODE_WRITE)
-			send_open_wo_command();
+			send_open_wo_command(op);
 		else if (mode == mavros_msgs::FileOpenRequest::MODE_CREATE)
-			send_create_command();
+			send_create_command(op);
 		else {
 			ROS_ERROR_NAMED("ftp", "FTP: Unsupported open mode: %d", mode);
-			op_state = OP::IDLE;
-			r_errno = EINVAL;
+			op.state = OP::IDLE;
+			op.r_errno = EINVAL;
 			return false;
 		}
 
 		return true;
 	}
 
-	bool close_file(std::string &path)
+	bool close_file(Operation &op, std::string &path)
 	{
 		auto it = session_file_map.find(path);
 		if (it == session_file_map.end()) {
 			ROS_ERROR_NAMED("ftp", "FTP:Close %s: not opened", path.c_str());
-			r_errno = EBADF;
+			op.r_errno = EBADF;
+			return false;
+		}
+
+		if (session_busy(it->second)) {
+			ROS_ERROR_NAMED("ftp", "FTP:Close %s: busy", path.c_str());
+			op.r_errno = EBUSY;
 			return false;
 		}
 
-		op_state = OP::ACK;
-		send_terminate_command(it->second);
+		op.state = OP::ACK;
+		send_terminate_command(op, it->second);
 		session_file_map.erase(it);
 		return true;
 	}
 
-	void read_file_end() {
+	void read_file_end(Operation &op) {
 		ROS_DEBUG_NAMED("ftp", "FTP:Read done");
-		go_idle(false);
+		go_idle(op, false);
 	}
 
-	bool read_file(std::string &path, size_t off, size_t len)
+	//! Burst done, re-read lost chunks if any
+	void read_burst_end(Operation &op)
+	{
+		op.read_burst = false;
+		if (op.read_gaps.empty()) {
+			read_file_end(op);
+			return;
+		}
+
+		ROS_DEBUG_NAMED("ftp", "FTP:Read burst done, %zu gaps to re-read", op.read_gaps.size());
+		op.read_offset = op.read_gaps.front().first;
+		send_read_command(op);
+	}
+
+	/**
+	 * @brief Copy chunk to its place in read_buffer
+	 *
+	 * @return bytes copied, data past requested size are dropped
+	 */
+	size_t store_chunk(Operation &op, uint32_t offset, const uint8_t *data, size_t size)
+	{
+		const size_t read_end = op.read_start + op.read_size;
+		if (offset < op.read_start || offset >= read_end)
+			return 0;
+
+		const size_t bytes_to_copy = std::min<size_t>(size, read_end - offset);
+		std::copy(data, data + bytes_to_copy, op.read_buffer.begin() + (offset - op.read_start));
+		op.read_data_end = std::max<size_t>(op.read_data_end, offset + bytes_to_copy);
+		return bytes_to_copy;
+	}
+
+	bool read_file(Operation &op, std::string &path, size_t off, size_t len)
 	{
 		auto it = session_file_map.find(path);
 		if (it == session_file_map.end()) {
 			ROS_ERROR_NAMED("ftp", "FTP:Read %s: not opened", path.c_str());
-			r_errno = EBADF;
+			op.r_errno = EBADF;
 			return false;
 		}
 
-		op_state = OP::READ;
-		active_session = it->second;
-		read_size = len;
-		read_offset = off;
-		read_buffer.clear();
-		if (read_buffer.capacity() < len ||
-				read_buffer.capacity() > len + MAX_RESERVE_DIFF) {
-			// reserve memory
-			read_buffer.reserve(len);
+		if (session_busy(it->second)) {
+			ROS_ERROR_NAMED("ftp", "FTP:Read %s: busy", path.c_str());
+			op.r_errno = EBUSY;
+			return false;
 		}
 
-		send_read_command();
+		op.state = OP::READ;
+		op.session = it->second;
+		op.read_size = len;
+		op.read_offset = off;
+		op.read_start = off;
+		op.read_data_end = off;
+		op.read_gaps.clear();
+
+		// chunks may come out of order, so they placed directly to final position
+		op.read_buffer.clear();
+		op.read_buffer.resize(len);
+
+		op.read_burst = burst_supported;
+		if (op.read_burst)
+			send_burst_read_command(op);
+		else
+			send_read_command(op);
 		return true;
 	}
 
-	void write_file_end() {
+	void write_file_end(Operation &op) {
 		ROS_DEBUG_NAMED("ftp", "FTP:Write done");
-		go_idle(false);
+		go_idle(op, false);
 	}
 
-	bool write_file(std::string &path, size_t off, V_FileData &data)
+	bool write_file(Operation &op, std::string &path, size_t off, V_FileData &data)
 	{
 		auto it = session_file_map.find(path);
 		if (it == session_file_map.end()) {
 			ROS_ERROR_NAMED("ftp", "FTP:Write %s: not opened", path.c_str());
-			r_errno = EBADF;
+			op.r_errno = EBADF;
+			return false;
+		}
+
+		if (session_busy(it->second)) {
+			ROS_ERROR_NAMED("ftp", "FTP:Write %s: busy", path.c_str());
+			op.r_errno = EBUSY;
 			return false;
 		}
 
-		op_state = OP::WRITE;
-		active_session = it->second;
-		write_offset = off;
-		write_buffer = std::move(data);
-		write_it = write_buffer.begin();
+		op.state = OP::WRITE;
+		op.session = it->second;
+		op.write_offset = off;
+		op.write_sent = 0;
+		op.write_buffer = std::move(data);
+		op.write_inflight.clear();
 
-		send_write_command(write_bytes_to_copy());
+		if (op.write_buffer.empty())
+			write_file_end(op);
+		else
+			fill_write_window(op);
 		return true;
 	}
 
-	void remove_file(std::string &path) {
-		op_state = OP::ACK;
-		send_remove_command(path);
+	void remove_file(Operation &op, std::string &path) {
+		op.state = OP::ACK;
+		send_remove_command(op, path);
 	}
 
-	bool rename_(std::string &old_path, std::string &new_path) {
-		op_state = OP::ACK;
-		return send_rename_command(old_path, new_path);
+	bool rename_(Operation &op, std::string &old_path, std::string &new_path) {
+		op.state = OP::ACK;
+		if (!send_rename_command(op, old_path, new_path)) {
+			op.state = OP::IDLE;
+			return false;
+		}
+
+		return true;
 	}
 
-	void truncate_file(std::string &path, size_t length) {
-		op_state = OP::ACK;
-		send_truncate_command(path, length);
+	void truncate_file(Operation &op, std::string &path, size_t length) {
+		op.state = OP::ACK;
+		send_truncate_command(op, path, length);
 	}
 
-	void create_directory(std::string &path) {
-		op_state = OP::ACK;
-		send_create_dir_command(path);
+	void create_directory(Operation &op, std::string &path) {
+		op.state = OP::ACK;
+		send_create_dir_command(op, path);
 	}
 
-	void remove_directory(std::string &path) {
-		op_state = OP::ACK;
-		send_remove_dir_command(path);
+	void remove_directory(Operation &op, std::string &path) {
+		op.state = OP::ACK;
+		send_remove_dir_command(op, path);
 	}
 
-	void checksum_crc32_file(std::string &path) {
-		op_state = OP::CHECKSUM;
-		checksum_crc32 = 0;
-		send_calc_file_crc32_command(path);
+	void checksum_crc32_file(Operation &op, std::string &path) {
+		op.state = OP::CHECKSUM;
+		op.checksum_crc32 = 0;
+		send_calc_file_crc32_command(op, path);
 	}
 
 	static constexpr int compute_rw_timeout(size_t len) {
 		return CHUNK_TIMEOUT_MS * (len / FTPRequest::DATA_MAXSZ + 1);
 	}
 
-	size_t write_bytes_to_copy() {
-		return std::min<size_t>(std::distance(write_it, write_buffer.end()),
-				FTPRequest::DATA_MAXSZ);
+	/**
+	 * @brief Read opened remote file to local fd by pieces
+	 *
+	 * Local I/O done with unlocked @a lock, operation is idle then.
+	 *
+	 * @param[in,out] off  start offset, on return end of written data
+	 */
+	bool download_pieces(Operation &op, unique_lock &lock, std::string &path, int fd, size_t &off)
+	{
+		while (off < op.open_size) {
+			const size_t len = std::min(op.open_size - off, size_t(DOWNLOAD_PIECE_SIZE));
+
+			if (!read_file(op, path, off, len) || !wait_transfer_completion(op, lock, compute_rw_timeout(len)))
+				return false;
+
+			const size_t got = op.read_data_end - op.read_start;
+			lock.unlock();
+			const bool written = ::pwrite(fd, op.read_buffer.data(), got, off) == ssize_t(got);
+			const int local_errno = errno;
+			lock.lock();
+
+			if (!written) {
+				op.r_errno = local_errno;
+				return false;
+			}
+
+			off += got;
+			if (got < len)
+				break;	// file shrinked after open
+		}
+
+		return true;
+	}
+
+	bool truncate_local(Operation &op, int fd, size_t length)
+	{
+		if (::ftruncate(fd, length) < 0) {
+			op.r_errno = errno;
+			return false;
+		}
+
+		return true;
+	}
+
+	//! CRC32 of local file, same algorithm as kCmdCalcFileCRC32
+	static bool local_file_crc32(int fd, size_t size, uint32_t &crc32, int &r_errno)
+	{
+		// init 0, no final xor
+		boost::crc_optimal<32, 0x04C11DB7, 0, 0, true, true> crc;
+
+		V_FileData buffer(std::min(size, size_t(DOWNLOAD_PIECE_SIZE)));
+		for (size_t off = 0; off < size; ) {
+			const ssize_t got = ::pread(fd, buffer.data(), std::min(buffer.size(), size - off), off);
+			if (got <= 0) {
+				r_errno = (got < 0) ? errno : EIO;
+				return false;
+			}
+
+			crc.process_bytes(buffer.data(), got);
+			off += got;
+		}
+
+		crc32 = crc.checksum();
+		return true;
+	}
+
+	/**
+	 * @brief Download remote file and verify its checksum
+	 *
+	 * Local file grows only by complete pieces,
+	 * so its size is valid resume offset after interrupted download.
+	 */
+	bool download_file(Operation &op, unique_lock &lock,
+			mavros_msgs::FileDownload::Request &req, mavros_msgs::FileDownload::Response &res)
+	{
+		int fd = ::open(req.local_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			ROS_ERROR_NAMED("ftp", "FTP:Download: can't open %s: %s", req.local_path.c_str(), strerror(errno));
+			op.r_errno = errno;
+			return false;
+		}
+
+		if (!open_file(op, req.file_path, mavros_msgs::FileOpenRequest::MODE_READ)
+				|| !wait_completion(op, lock, OPEN_TIMEOUT_MS)) {
+			::close(fd);
+			return false;
+		}
+
+		struct stat st;
+		size_t off = 0;
+		if (req.resume && ::fstat(fd, &st) == 0 && size_t(st.st_size) <= op.open_size)
+			off = st.st_size;
+
+		ROS_INFO_NAMED("ftp", "FTP:Download %s -> %s: from %zu of %zu", req.file_path.c_str(),
+				req.local_path.c_str(), off, op.open_size);
+
+		bool ok = truncate_local(op, fd, off)
+			  && download_pieces(op, lock, req.file_path, fd, off)
+			  && truncate_local(op, fd, off);
+
+		// release session even if data failed, keep first error
+		const int data_errno = op.r_errno;
+		if (close_file(op, req.file_path))
+			wait_completion(op, lock, OPEN_TIMEOUT_MS);
+		op.r_errno = data_errno;
+		op.read_buffer.clear();
+
+		res.size = off;
+		if (ok) {
+			checksum_crc32_file(op, req.file_path);
+			ok = wait_completion(op, lock, LIST_TIMEOUT_MS);
+			res.crc32 = op.checksum_crc32;
+		}
+
+		if (ok) {
+			uint32_t local_crc32 = 0;
+			lock.unlock();
+			ok = local_file_crc32(fd, off, local_crc32, op.r_errno);
+			lock.lock();
+
+			if (ok && local_crc32 != res.crc32) {
+				ROS_ERROR_NAMED("ftp", "FTP:Download %s: checksum mismatch, local 0x%08x remote 0x%08x",
+						req.file_path.c_str(), local_crc32, res.crc32);
+				op.r_errno = EBADMSG;
+				ok = false;
+			}
+		}
+
+		::close(fd);
+		return ok;
 	}
 
-	bool wait_completion(const int msecs)
+	/**
+	 * @brief Wait read or write, restart stalled transfer
+	 *
+	 * Loss of burst tail or of write ack is noticed only by silence,
+	 * then burst requested again from first missing offset,
+	 * or unacknowledged write chunks resent.
+	 */
+	bool wait_transfer_completion(Operation &op, unique_lock &lock, const int msecs)
 	{
-		std::unique_lock<std::mutex> lock(cond_mutex);
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecs);
+		size_t last_progress = op.progress;
+
+		while (op.state != OP::IDLE) {
+			if (op.cond.wait_for(lock, std::chrono::milliseconds(CHUNK_TIMEOUT_MS))
+					== std::cv_status::no_timeout)
+				continue;
 
-		bool is_timedout = cond.wait_for(lock, std::chrono::milliseconds(msecs))
-				== std::cv_status::timeout;
+			if (std::chrono::steady_clock::now() >= deadline) {
+				timeout(op);
+				return false;
+			}
+
+			if (op.progress == last_progress) {
+				if (op.state == OP::READ && op.read_burst) {
+					ROS_DEBUG_NAMED("ftp", "FTP:Read burst stalled, off: %u", op.read_offset);
+					send_burst_read_command(op);
+				}
+				else if (op.state == OP::WRITE) {
+					ROS_DEBUG_NAMED("ftp", "FTP:Write stalled, resend %zu chunks", op.write_inflight.size());
+					resend_write_window(op);
+				}
+			}
 
-		if (is_timedout) {
+			last_progress = op.progress;
+		}
+
+		return !op.is_error;
+	}
+
+	//! Abandon operation, late reply will be dropped
+	void timeout(Operation &op)
+	{
+		unregister(op);
+		op.state = OP::IDLE;
+		op.read_burst = false;
+		op.write_inflight.clear();
+		op.is_error = true;
+		op.r_errno = ETIMEDOUT;
+	}
+
+	bool wait_completion(Operation &op, unique_lock &lock, const int msecs)
+	{
+		bool done = op.cond.wait_for(lock, std::chrono::milliseconds(msecs),
+				[&op] { return op.state == OP::IDLE; });
+
+		if (!done) {
 			// If timeout occurs don't forget to reset state
-			op_state = OP::IDLE;
-			r_errno = ETIMEDOUT;
+			timeout(op);
 			return false;
 		}
 		else
 			// if go_idle() occurs before timeout
-			return !is_error;
+			return !op.is_error;
 	}
 
 	/* -*- service callbacks -*- */
 
-	/**
-	 * Service handler common header code.
-	 */
-#define SERVICE_IDLE_CHECK()				\
-	if (op_state != OP::IDLE) {			\
-		ROS_ERROR_NAMED("ftp", "FTP: Busy");	\
-		return false;				\
-	}
-
 	bool list_cb(mavros_msgs::FileList::Request &req,
 			mavros_msgs::FileList::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		list_directory(req.dir_path);
-		res.success = wait_completion(LIST_TIMEOUT_MS);
-		res.r_errno = r_errno;
+		list_directory(op, req.dir_path);
+		res.success = wait_completion(op, lock, LIST_TIMEOUT_MS);
+		res.r_errno = op.r_errno;
 		if (res.success) {
-			res.list = std::move(list_entries);
-			list_entries.clear();	// not shure that it's needed
+			res.list = std::move(op.list_entries);
 		}
 
 		return true;
@@ -911,7 +1389,8 @@ private:
 	bool open_cb(mavros_msgs::FileOpen::Request &req,
 			mavros_msgs::FileOpen::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
 		// only one session per file
 		auto it = session_file_map.find(req.file_path);
@@ -921,12 +1400,12 @@ private:
 			return false;
 		}
 
-		res.success = open_file(req.file_path, req.mode);
+		res.success = open_file(op, req.file_path, req.mode);
 		if (res.success) {
-			res.success = wait_completion(OPEN_TIMEOUT_MS);
-			res.size = open_size;
+			res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
+			res.size = op.open_size;
 		}
-		res.r_errno = r_errno;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -934,13 +1413,14 @@ private:
 	bool close_cb(mavros_msgs::FileClose::Request &req,
 			mavros_msgs::FileClose::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		res.success = close_file(req.file_path);
+		res.success = close_file(op, req.file_path);
 		if (res.success) {
-			res.success = wait_completion(OPEN_TIMEOUT_MS);
+			res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
 		}
-		res.r_errno = r_errno;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -948,16 +1428,17 @@ private:
 	bool read_cb(mavros_msgs::FileRead::Request &req,
 			mavros_msgs::FileRead::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		res.success = read_file(req.file_path, req.offset, req.size);
+		res.success = read_file(op, req.file_path, req.offset, req.size);
 		if (res.success)
-			res.success = wait_completion(compute_rw_timeout(req.size));
+			res.success = wait_transfer_completion(op, lock, compute_rw_timeout(req.size));
 		if (res.success) {
-			res.data = std::move(read_buffer);
-			read_buffer.clear();	// same as for list_entries
+			op.read_buffer.resize(op.read_data_end - op.read_start);
+			res.data = std::move(op.read_buffer);
 		}
-		res.r_errno = r_errno;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -965,15 +1446,15 @@ private:
 	bool write_cb(mavros_msgs::FileWrite::Request &req,
 			mavros_msgs::FileWrite::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
 		const size_t data_size = req.data.size();
-		res.success = write_file(req.file_path, req.offset, req.data);
+		res.success = write_file(op, req.file_path, req.offset, req.data);
 		if (res.success) {
-			res.success = wait_completion(compute_rw_timeout(data_size));
+			res.success = wait_transfer_completion(op, lock, compute_rw_timeout(data_size));
 		}
-		write_buffer.clear();
-		res.r_errno = r_errno;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -981,11 +1462,12 @@ private:
 	bool remove_cb(mavros_msgs::FileRemove::Request &req,
 			mavros_msgs::FileRemove::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		remove_file(req.file_path);
-		res.success = wait_completion(OPEN_TIMEOUT_MS);
-		res.r_errno = r_errno;
+		remove_file(op, req.file_path);
+		res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -993,13 +1475,14 @@ private:
 	bool rename_cb(mavros_msgs::FileRename::Request &req,
 			mavros_msgs::FileRename::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		res.success = rename_(req.old_path, req.new_path);
+		res.success = rename_(op, req.old_path, req.new_path);
 		if (res.success) {
-			res.success = wait_completion(OPEN_TIMEOUT_MS);
+			res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
 		}
-		res.r_errno = r_errno;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -1008,12 +1491,13 @@ private:
 	bool truncate_cb(mavros_msgs::FileTruncate::Request &req,
 			mavros_msgs::FileTruncate::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
 		// Note: emulated truncate() can take a while
-		truncate_file(req.file_path, req.length);
-		res.success = wait_completion(LIST_TIMEOUT_MS * 5);
-		res.r_errno = r_errno;
+		truncate_file(op, req.file_path, req.length);
+		res.success = wait_completion(op, lock, LIST_TIMEOUT_MS * 5);
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -1021,11 +1505,12 @@ private:
 	bool mkdir_cb(mavros_msgs::FileMakeDir::Request &req,
 			mavros_msgs::FileMakeDir::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		create_directory(req.dir_path);
-		res.success = wait_completion(OPEN_TIMEOUT_MS);
-		res.r_errno = r_errno;
+		create_directory(op, req.dir_path);
+		res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -1033,11 +1518,12 @@ private:
 	bool rmdir_cb(mavros_msgs::FileRemoveDir::Request &req,
 			mavros_msgs::FileRemoveDir::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		remove_directory(req.dir_path);
-		res.success = wait_completion(OPEN_TIMEOUT_MS);
-		res.r_errno = r_errno;
+		remove_directory(op, req.dir_path);
+		res.success = wait_completion(op, lock, OPEN_TIMEOUT_MS);
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
@@ -1045,17 +1531,35 @@ private:
 	bool checksum_cb(mavros_msgs::FileChecksum::Request &req,
 			mavros_msgs::FileChecksum::Response &res)
 	{
-		SERVICE_IDLE_CHECK();
+		unique_lock lock(mutex);
+		Operation op;
 
-		checksum_crc32_file(req.file_path);
-		res.success = wait_completion(LIST_TIMEOUT_MS);
-		res.crc32 = checksum_crc32;
-		res.r_errno = r_errno;
+		checksum_crc32_file(op, req.file_path);
+		res.success = wait_completion(op, lock, LIST_TIMEOUT_MS);
+		res.crc32 = op.checksum_crc32;
+		res.r_errno = op.r_errno;
 
 		return true;
 	}
 
-#undef SERVICE_IDLE_CHECK
+	bool download_cb(mavros_msgs::FileDownload::Request &req,
+			mavros_msgs::FileDownload::Response &res)
+	{
+		unique_lock lock(mutex);
+		Operation op;
+
+		// only one session per file
+		if (session_file_map.count(req.file_path)) {
+			ROS_ERROR_NAMED("ftp", "FTP: File %s: already opened",
+					req.file_path.c_str());
+			return false;
+		}
+
+		res.success = download_file(op, lock, req, res);
+		res.r_errno = op.r_errno;
+
+		return true;
+	}
 
 	/**
 	 * @brief Reset communication on both sides.
@@ -1064,6 +1568,7 @@ private:
 	bool reset_cb(std_srvs::Empty::Request &req,
 			std_srvs::Empty::Response &res)
 	{
+		std::lock_guard<std::mutex> lock(mutex);
 		send_reset();
 		return true;
 	}
@@ -1071,5 +1576,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::FTPPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::FTPPlugin)
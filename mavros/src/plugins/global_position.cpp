@@ -18,6 +18,7 @@
 
 #include <angles/angles.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/local_tangent_plane.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <GeographicLib/Geocentric.hpp>
 
@@ -47,16 +48,18 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	GlobalPositionPlugin() : PluginBase(),
-		gp_nh("~global_position"),
+		gp_nh(private_nh("global_position")),
 		tf_send(false),
 		rot_cov(99999.0),
 		use_relative_alt(true),
-		is_map_init(false)
+		is_map_init(false),
+		gp_stream(nullptr)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(gp_nh);
 
 		// general params
 		gp_nh.param<std::string>("frame_id", frame_id, "map");
@@ -69,19 +72,25 @@ public:
 		gp_nh.param<std::string>("tf/frame_id", tf_frame_id, "map");
 		gp_nh.param<std::string>("tf/global_frame_id", tf_global_frame_id, "earth");	// The global_origin should be represented as "earth" coordinate frame (ECEF) (REP 105)
 		gp_nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "base_link");
+		// local coordinates linearization subsection
+		double linear_radius;
+		int linear_period;
+		gp_nh.param("linear/radius", linear_radius, double(LocalTangentPlane::DEFAULT_RADIUS));
+		gp_nh.param("linear/period", linear_period, int(LocalTangentPlane::DEFAULT_PERIOD));
+		map_ltp.set_linear_limits(linear_radius, std::max(linear_period, 1));
 
 		UAS_DIAG(m_uas).add("GPS", this, &GlobalPositionPlugin::gps_diag_run);
 
 		// gps data
 		raw_fix_pub = gp_nh.advertise<sensor_msgs::NavSatFix>("raw/fix", 10);
-		raw_vel_pub = gp_nh.advertise<geometry_msgs::TwistStamped>("raw/gps_vel", 10);
-		raw_sat_pub = gp_nh.advertise<std_msgs::UInt32>("raw/satellites", 10);
+		raw_vel_pub.advertise<geometry_msgs::TwistStamped>(gp_nh, "raw/gps_vel", 10);
+		raw_sat_pub.advertise<std_msgs::UInt32>(gp_nh, "raw/satellites", 10);
 
 		// fused global position
 		gp_fix_pub = gp_nh.advertise<sensor_msgs::NavSatFix>("global", 10);
 		gp_odom_pub = gp_nh.advertise<nav_msgs::Odometry>("local", 10);
-		gp_rel_alt_pub = gp_nh.advertise<std_msgs::Float64>("rel_alt", 10);
-		gp_hdg_pub = gp_nh.advertise<std_msgs::Float64>("compass_hdg", 10);
+		gp_rel_alt_pub.advertise<std_msgs::Float64>(gp_nh, "rel_alt", 10);
+		gp_hdg_pub.advertise<std_msgs::Float64>(gp_nh, "compass_hdg", 10);
 
 		// global origin
 		gp_global_origin_pub = gp_nh.advertise<geographic_msgs::GeoPointStamped>("gp_origin", 10);
@@ -93,6 +102,19 @@ public:
 
 		// offset from local position to the global origin ("earth")
 		gp_global_offset_pub = gp_nh.advertise<geometry_msgs::PoseStamped>("gp_lp_offset", 10);
+
+		// GLOBAL_POSITION_INT demand
+		using mavlink::common::msg::GLOBAL_POSITION_INT;
+		const auto msgid = GLOBAL_POSITION_INT::MSG_ID;
+		const double def = StreamDemand::RATE_DEFAULT;
+		auto &demand = m_uas->stream_demand;
+
+		gp_stream = demand.declare(msgid, "global_position/global", [this]() { return gp_fix_pub.getNumSubscribers(); }, def);
+		demand.declare(msgid, "global_position/local", [this]() { return gp_odom_pub.getNumSubscribers(); }, def);
+		demand.declare(msgid, "global_position/rel_alt", [this]() { return gp_rel_alt_pub.getNumSubscribers(); }, def);
+		demand.declare(msgid, "global_position/compass_hdg", [this]() { return gp_hdg_pub.getNumSubscribers(); }, def);
+		if (tf_send)
+			demand.declare(msgid, "global_position/tf", []() { return 1U; }, def);
 	}
 
 	Subscriptions get_subscriptions()
@@ -110,12 +132,12 @@ private:
 	ros::NodeHandle gp_nh;
 
 	ros::Publisher raw_fix_pub;
-	ros::Publisher raw_vel_pub;
-	ros::Publisher raw_sat_pub;
+	plugin::LazyPublisher raw_vel_pub;
+	plugin::LazyPublisher raw_sat_pub;
 	ros::Publisher gp_odom_pub;
 	ros::Publisher gp_fix_pub;
-	ros::Publisher gp_hdg_pub;
-	ros::Publisher gp_rel_alt_pub;
+	plugin::LazyPublisher gp_hdg_pub;
+	plugin::LazyPublisher gp_rel_alt_pub;
 	ros::Publisher gp_global_origin_pub;
 	ros::Publisher gp_global_offset_pub;
 
@@ -135,9 +157,10 @@ private:
 	double rot_cov;
 	double gps_uere;
 
-	Eigen::Vector3d map_origin {};	//!< geodetic origin of map frame [lla]
-	Eigen::Vector3d ecef_origin {};	//!< geocentric origin of map frame [m]
-	Eigen::Vector3d local_ecef {};	//!< local ECEF coordinates on map frame [m]
+	//! guards map_ltp and is_map_init: used by mavlink handler and home_position callback
+	std::mutex map_mutex;
+	LocalTangentPlane map_ltp;	//!< map frame origin and LLA -> local ENU conversion
+	StreamDemand::Stream *gp_stream;	//!< GLOBAL_POSITION_INT of UAS::stream_demand
 
 	template<typename MsgT>
 	inline void fill_lla(MsgT &msg, sensor_msgs::NavSatFix::Ptr fix)
@@ -197,7 +220,8 @@ private:
 		raw_fix_pub.publish(fix);
 
 		if (raw_gps.vel != UINT16_MAX &&
-					raw_gps.cog != UINT16_MAX) {
+					raw_gps.cog != UINT16_MAX &&
+					raw_vel_pub.has_subscribers()) {
 			double speed = raw_gps.vel / 1E2;				// m/s
 			double course = angles::from_degrees(raw_gps.cog / 1E2);	// rad
 
@@ -214,9 +238,11 @@ private:
 		}
 
 		// publish satellite count
-		auto sat_cnt = boost::make_shared<std_msgs::UInt32>();
-		sat_cnt->data = raw_gps.satellites_visible;
-		raw_sat_pub.publish(sat_cnt);
+		if (raw_sat_pub.has_subscribers()) {
+			auto sat_cnt = boost::make_shared<std_msgs::UInt32>();
+			sat_cnt->data = raw_gps.satellites_visible;
+			raw_sat_pub.publish(sat_cnt);
+		}
 	}
 
 	void handle_gps_global_origin(const mavlink::mavlink_message_t *msg, mavlink::common::msg::GPS_GLOBAL_ORIGIN &glob_orig)
@@ -253,10 +279,9 @@ private:
 
 	void handle_global_position_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::GLOBAL_POSITION_INT &gpos)
 	{
+		gp_stream->seen();
 		auto odom = boost::make_shared<nav_msgs::Odometry>();
 		auto fix = boost::make_shared<sensor_msgs::NavSatFix>();
-		auto relative_alt = boost::make_shared<std_msgs::Float64>();
-		auto compass_heading = boost::make_shared<std_msgs::Float64>();
 
 		auto header = m_uas->synchronized_header(child_frame_id, gpos.time_boot_ms);
 
@@ -282,8 +307,7 @@ private:
 			fill_unknown_cov(fix);
 		}
 
-		relative_alt->data = gpos.relative_alt / 1E3;	// in meters
-		compass_heading->data = (gpos.hdg != UINT16_MAX) ? gpos.hdg / 1E2 : NAN;	// in degrees
+		double relative_alt = gpos.relative_alt / 1E3;	// in meters
 
 		/**
 		 * @brief Global position odometry:
@@ -311,56 +335,34 @@ private:
 		vel_cov_out.fill(0.0);
 		vel_cov_out(0) = -1.0;
 
-		// Current fix in ECEF
-		Eigen::Vector3d map_point;
+		Eigen::Vector3d fix_lla(fix->latitude, fix->longitude, fix->altitude);
 
-		try {
-			/**
-			 * @brief Conversion from geodetic coordinates (LLA) to ECEF (Earth-Centered, Earth-Fixed)
-			 *
-			 * Note: "ecef_origin" is the origin of "map" frame, in ECEF, and the local coordinates are
-			 * in spherical coordinates, with the orientation in ENU (just like what is applied
-			 * on Gazebo)
-			 */
-			GeographicLib::Geocentric map(GeographicLib::Constants::WGS84_a(),
-						GeographicLib::Constants::WGS84_f());
-
-			/**
-			 * @brief Checks if the "map" origin is set.
-			 * - If not, and the home position is also not received, it sets the current fix as the origin;
-			 * - If the home position is received, it sets the "map" origin;
-			 * - If the "map" origin is set, then it applies the rotations to the offset between the origin
-			 * and the current local geocentric coordinates.
-			 */
-			// Current fix to ECEF
-			map.Forward(fix->latitude, fix->longitude, fix->altitude,
-						map_point.x(), map_point.y(), map_point.z());
-
-			// Set the current fix as the "map" origin if it's not set
+		/**
+		 * @brief Checks if the "map" origin is set.
+		 * - If not, and the home position is also not received, it sets the current fix as the origin;
+		 * - If the home position is received, it sets the "map" origin;
+		 * - If the "map" origin is set, the local coordinates are the offset from the origin
+		 * in ENU orientation (just like what is applied on Gazebo).
+		 *
+		 * Origin ECEF position and rotation are computed only when origin changes,
+		 * see @a LocalTangentPlane.
+		 */
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
 			if (!is_map_init && fix->status.status >= sensor_msgs::NavSatStatus::STATUS_FIX) {
-				map_origin.x() = fix->latitude;
-				map_origin.y() = fix->longitude;
-				map_origin.z() = fix->altitude;
-
-				ecef_origin = map_point; // Local position is zero
+				map_ltp.set_origin(fix_lla);
 				is_map_init = true;
 			}
-		}
-		catch (const std::exception& e) {
-			ROS_INFO_STREAM("GP: Caught exception: " << e.what() << std::endl);
-		}
 
-		// Compute the local coordinates in ECEF
-		local_ecef = map_point - ecef_origin;
-		// Compute the local coordinates in ENU
-		tf::pointEigenToMsg(ftf::transform_frame_ecef_enu(local_ecef, map_origin), odom->pose.pose.position);
+			tf::pointEigenToMsg(map_ltp.to_enu(fix_lla), odom->pose.pose.position);
+		}
 
 		/**
 		 * @brief By default, we are using the relative altitude instead of the geocentric
 		 * altitude, which is relative to the WGS-84 ellipsoid
 		 */
 		if (use_relative_alt)
-			odom->pose.pose.position.z = relative_alt->data;
+			odom->pose.pose.position.z = relative_alt;
 
 		odom->pose.pose.orientation = m_uas->get_attitude_orientation_enu();
 
@@ -377,8 +379,18 @@ private:
 		// publish
 		gp_fix_pub.publish(fix);
 		gp_odom_pub.publish(odom);
-		gp_rel_alt_pub.publish(relative_alt);
-		gp_hdg_pub.publish(compass_heading);
+
+		if (gp_rel_alt_pub.has_subscribers()) {
+			auto relative_alt_msg = boost::make_shared<std_msgs::Float64>();
+			relative_alt_msg->data = relative_alt;
+			gp_rel_alt_pub.publish(relative_alt_msg);
+		}
+
+		if (gp_hdg_pub.has_subscribers()) {
+			auto compass_heading = boost::make_shared<std_msgs::Float64>();
+			compass_heading->data = (gpos.hdg != UINT16_MAX) ? gpos.hdg / 1E2 : NAN;	// in degrees
+			gp_hdg_pub.publish(compass_heading);
+		}
 
 		// TF
 		if (tf_send) {
@@ -396,7 +408,7 @@ private:
 			transform.transform.translation.y = odom->pose.pose.position.y;
 			transform.transform.translation.z = odom->pose.pose.position.z;
 
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf_aggregator.send(transform);
 		}
 	}
 
@@ -431,7 +443,7 @@ private:
 			transform.transform.translation.y = global_offset->pose.position.y;
 			transform.transform.translation.z = global_offset->pose.position.z;
 
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf_aggregator.send(transform);
 		}
 	}
 
@@ -470,25 +482,8 @@ private:
 
 	void home_position_cb(const mavros_msgs::HomePosition::ConstPtr &req)
 	{
-		map_origin.x() = req->geo.latitude;
-		map_origin.y() = req->geo.longitude;
-		map_origin.z() = req->geo.altitude;
-
-		try {
-			/**
-			 * @brief Conversion from geodetic coordinates (LLA) to ECEF (Earth-Centered, Earth-Fixed)
-			 */
-			GeographicLib::Geocentric map(GeographicLib::Constants::WGS84_a(),
-						GeographicLib::Constants::WGS84_f());
-
-			// map_origin to ECEF
-			map.Forward(map_origin.x(), map_origin.y(), map_origin.z(),
-						ecef_origin.x(), ecef_origin.y(), ecef_origin.z());
-		}
-		catch (const std::exception& e) {
-			ROS_INFO_STREAM("GP: Caught exception: " << e.what() << std::endl);
-		}
-
+		std::lock_guard<std::mutex> lock(map_mutex);
+		map_ltp.set_origin(Eigen::Vector3d(req->geo.latitude, req->geo.longitude, req->geo.altitude));
 		is_map_init = true;
 	}
 
@@ -511,5 +506,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::GlobalPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::GlobalPositionPlugin)
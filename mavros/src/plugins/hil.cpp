@@ -16,6 +16,7 @@
  * in the top-level LICENSE file of the mavros repository.
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
+#include <mutex>
 #include <mavros/mavros_plugin.h>
 #include <eigen_conversions/eigen_msg.h>
 
@@ -24,6 +25,7 @@
 #include <mavros_msgs/HilStateQuaternion.h>
 #include <mavros_msgs/HilGPS.h>
 #include <mavros_msgs/HilSensor.h>
+#include <mavros_msgs/HilSensorBatch.h>
 #include <mavros_msgs/OpticalFlowRad.h>
 #include <mavros_msgs/RCIn.h>
 
@@ -36,24 +38,40 @@ static constexpr double PASCAL_TO_MILLIBAR = 1.0e-2;
 
 /**
  * @brief Hil plugin
+ *
+ * ~hil/batch takes all sensors of one simulator step, they are sent back to back.
+ * In lockstep mode FCU gets next batch only after HIL_ACTUATOR_CONTROLS of previous one
+ * (or lockstep/timeout), newer batch replaces waiting one. Waiting batch is sent
+ * from message handler, so it does not wait for ROS spinner.
  */
 class HilPlugin : public plugin::PluginBase {
 public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	HilPlugin() : PluginBase(),
-		hil_nh("~hil")
+		hil_nh(private_nh("hil")),
+		lockstep(false),
+		awaiting_reply(false),
+		has_pending(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(hil_nh);
 
 		hil_state_quaternion_sub = hil_nh.subscribe("state", 10, &HilPlugin::state_quat_cb, this);
 		hil_gps_sub = hil_nh.subscribe("gps", 10, &HilPlugin::gps_cb, this);
 		hil_sensor_sub = hil_nh.subscribe("imu_ned", 10, &HilPlugin::sensor_cb, this);
 		hil_flow_sub = hil_nh.subscribe("optical_flow", 10, &HilPlugin::optical_flow_cb, this);
 		hil_rcin_sub = hil_nh.subscribe("rc_inputs", 10, &HilPlugin::rcin_raw_cb, this);
+		hil_batch_sub = hil_nh.subscribe("batch", 10, &HilPlugin::batch_cb, this,
+				ros::TransportHints().tcpNoDelay());
+
+		double lockstep_timeout;
+		hil_nh.param("lockstep/enable", lockstep, false);
+		hil_nh.param("lockstep/timeout", lockstep_timeout, 0.1);
+		reply_timeout = ros::WallDuration(lockstep_timeout);
 
 		hil_controls_pub = hil_nh.advertise<mavros_msgs::HilControls>("controls", 10);
 		hil_actuator_controls_pub = hil_nh.advertise<mavros_msgs::HilActuatorControls>("actuator_controls", 10);
@@ -78,9 +96,29 @@ private:
 	ros::Subscriber hil_sensor_sub;
 	ros::Subscriber hil_flow_sub;
 	ros::Subscriber hil_rcin_sub;
+	ros::Subscriber hil_batch_sub;
 
 	Eigen::Quaterniond enu_orientation;
 
+	//! Converted simulator step, optional parts flagged
+	struct Frame {
+		mavlink::common::msg::HIL_SENSOR sensor;
+		mavlink::common::msg::HIL_STATE_QUATERNION state_quat;
+		mavlink::common::msg::HIL_GPS gps;
+		mavlink::common::msg::HIL_OPTICAL_FLOW of;
+		bool has_state_quat;
+		bool has_gps;
+		bool has_of;
+	};
+
+	std::mutex lockstep_mutex;
+	bool lockstep;
+	bool awaiting_reply;		//!< frame sent, no HIL_ACTUATOR_CONTROLS yet
+	bool has_pending;
+	Frame pending;			//!< latest frame waiting for reply
+	ros::WallTime sent_time;
+	ros::WallDuration reply_timeout;
+
 	/* -*- rx handlers -*- */
 
 	void handle_hil_controls(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HIL_CONTROLS &hil_controls) {
@@ -118,17 +156,26 @@ private:
 		hil_actuator_controls_msg->flags = hil_actuator_controls.flags;
 
 		hil_actuator_controls_pub.publish(hil_actuator_controls_msg);
+
+		if (!lockstep)
+			return;
+
+		// reply received: release waiting frame right from handler thread
+		std::lock_guard<std::mutex> lock(lockstep_mutex);
+		awaiting_reply = false;
+		if (has_pending) {
+			has_pending = false;
+			send_lockstep_frame(pending);
+		}
 	}
 
 	/* -*- callbacks / low level send -*- */
 
 	/**
-	 * @brief Send hil_state_quaternion to FCU.
+	 * @brief Convert to hil_state_quaternion.
 	 * Message specification: @p https://mavlink.io/en/messages/common.html#HIL_STATE_QUATERNION
 	 */
-	void state_quat_cb(const mavros_msgs::HilStateQuaternion::ConstPtr &req) {
-		mavlink::common::msg::HIL_STATE_QUATERNION state_quat;
-
+	static void fill_state_quat(const mavros_msgs::HilStateQuaternion *req, mavlink::common::msg::HIL_STATE_QUATERNION &state_quat) {
 		state_quat.time_usec = req->header.stamp.toNSec() / 1000;
 		auto q = ftf::transform_orientation_baselink_aircraft(
 					ftf::transform_orientation_enu_ned(
@@ -170,17 +217,20 @@ private:
 		state_quat.yacc = lin_acc.y();
 		state_quat.zacc = lin_acc.z();
 		// [[[end]]] (checksum: a29598b834ac1ec32ede01595aa5b3ac)
+	}
+
+	void state_quat_cb(const mavros_msgs::HilStateQuaternion::ConstPtr &req) {
+		mavlink::common::msg::HIL_STATE_QUATERNION state_quat;
+		fill_state_quat(req.get(), state_quat);
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(state_quat);
 	}
 
 	/**
-	 * @brief Send hil_gps to FCU.
+	 * @brief Convert to hil_gps.
 	 * Message specification: @p https://mavlink.io/en/messages/common.html#HIL_GPS
 	 */
-	void gps_cb(const mavros_msgs::HilGPS::ConstPtr &req) {
-		mavlink::common::msg::HIL_GPS gps;
-
+	static void fill_gps(const mavros_msgs::HilGPS *req, mavlink::common::msg::HIL_GPS &gps) {
 		gps.time_usec = req->header.stamp.toNSec() / 1000;
 		gps.fix_type = req->fix_type;
 		gps.lat = req->geo.latitude * 1E7;
@@ -203,17 +253,20 @@ private:
 		gps.cog = req->cog * 1E2;
 		// [[[end]]] (checksum: a283bcc78f496cead2e9f893200d825d)
 		gps.satellites_visible = req->satellites_visible;
+	}
+
+	void gps_cb(const mavros_msgs::HilGPS::ConstPtr &req) {
+		mavlink::common::msg::HIL_GPS gps;
+		fill_gps(req.get(), gps);
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(gps);
 	}
 
 	/**
-	 * @brief Send hil_sensor to FCU.
+	 * @brief Convert to hil_sensor.
 	 * Message specification: @p https://mavlink.io/en/messages/common.html#HIL_SENSOR
 	 */
-	void sensor_cb(const mavros_msgs::HilSensor::ConstPtr &req) {
-		mavlink::common::msg::HIL_SENSOR sensor;
-
+	static void fill_sensor(const mavros_msgs::HilSensor *req, mavlink::common::msg::HIL_SENSOR &sensor) {
 		sensor.time_usec = req->header.stamp.toNSec() / 1000;
 		// WRT world frame
 		auto acc = ftf::transform_frame_baselink_aircraft(
@@ -249,17 +302,20 @@ private:
 		sensor.temperature = req->temperature;
 		sensor.fields_updated = req->fields_updated;
 		// [[[end]]] (checksum: 316bef821ad6fc33d9726a1c8e8c5404)
+	}
+
+	void sensor_cb(const mavros_msgs::HilSensor::ConstPtr &req) {
+		mavlink::common::msg::HIL_SENSOR sensor;
+		fill_sensor(req.get(), sensor);
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(sensor);
 	}
 
 	/**
-	 * @brief Send simulated optical flow to FCU.
+	 * @brief Convert simulated optical flow.
 	 * Message specification: @p https://mavlink.io/en/messages/common.html#HIL_OPTICAL_FLOW
 	 */
-	void optical_flow_cb(const mavros_msgs::OpticalFlowRad::ConstPtr &req) {
-		mavlink::common::msg::HIL_OPTICAL_FLOW of;
-
+	static void fill_optical_flow(const mavros_msgs::OpticalFlowRad *req, mavlink::common::msg::HIL_OPTICAL_FLOW &of) {
 		auto int_xy = ftf::transform_frame_aircraft_baselink(
 					Eigen::Vector3d(
 						req->integrated_x,
@@ -292,10 +348,76 @@ private:
 		of.quality = req->quality;
 		// [[[end]]] (checksum: acbfae28f4f3bb8ca135423efaaa479e)
 		of.temperature = req->temperature * 100.0f;	// in centi-degrees celsius
+	}
+
+	void optical_flow_cb(const mavros_msgs::OpticalFlowRad::ConstPtr &req) {
+		mavlink::common::msg::HIL_OPTICAL_FLOW of;
+		fill_optical_flow(req.get(), of);
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(of);
 	}
 
+	void send_frame(const Frame &frame)
+	{
+		auto fcu = UAS_FCU(m_uas);
+
+		fcu->send_message_ignore_drop(frame.sensor);
+		if (frame.has_state_quat)
+			fcu->send_message_ignore_drop(frame.state_quat);
+		if (frame.has_gps)
+			fcu->send_message_ignore_drop(frame.gps);
+		if (frame.has_of)
+			fcu->send_message_ignore_drop(frame.of);
+	}
+
+	//! @note lockstep_mutex should be held
+	void send_lockstep_frame(const Frame &frame)
+	{
+		send_frame(frame);
+		awaiting_reply = true;
+		sent_time = ros::WallTime::now();
+	}
+
+	/**
+	 * @brief Send all sensors of one simulator step to FCU.
+	 * Conversion is done into stack frame, no heap allocations.
+	 */
+	void batch_cb(const mavros_msgs::HilSensorBatch::ConstPtr &req) {
+		Frame frame;
+
+		fill_sensor(&req->sensor, frame.sensor);
+
+		frame.has_state_quat = !req->state.empty();
+		if (frame.has_state_quat)
+			fill_state_quat(&req->state.front(), frame.state_quat);
+
+		frame.has_gps = !req->gps.empty();
+		if (frame.has_gps)
+			fill_gps(&req->gps.front(), frame.gps);
+
+		frame.has_of = !req->optical_flow.empty();
+		if (frame.has_of)
+			fill_optical_flow(&req->optical_flow.front(), frame.of);
+
+		if (!lockstep) {
+			send_frame(frame);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(lockstep_mutex);
+		if (awaiting_reply && ros::WallTime::now() - sent_time < reply_timeout) {
+			// latest wins
+			pending = frame;
+			has_pending = true;
+			return;
+		}
+
+		if (awaiting_reply)
+			ROS_WARN_THROTTLE_NAMED(10, "hil", "HIL: no actuator controls in %.3f s, lockstep frame sent", reply_timeout.toSec());
+
+		send_lockstep_frame(frame);
+	}
+
 	/**
 	 * @brief Send simulated received RAW values of the RC channels to the FCU.
 	 * Message specification: @p https://mavlink.io/en/messages/common.html#HIL_RC_INPUTS_RAW
@@ -335,5 +457,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::HilPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::HilPlugin)
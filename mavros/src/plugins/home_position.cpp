@@ -32,20 +32,20 @@ namespace std_plugins {
 class HomePositionPlugin : public plugin::PluginBase {
 public:
 	HomePositionPlugin() :
-		hp_nh("~home_position"),
+		hp_nh(private_nh("home_position")),
 		REQUEST_POLL_TIME_DT(REQUEST_POLL_TIME_MS / 1000.0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(hp_nh);
 
 		hp_pub = hp_nh.advertise<mavros_msgs::HomePosition>("home", 2, true);
 		hp_sub = hp_nh.subscribe("set", 10, &HomePositionPlugin::home_position_cb, this);
 		update_srv = hp_nh.advertiseService("req_update", &HomePositionPlugin::req_update_cb, this);
 
-		poll_timer = hp_nh.createTimer(REQUEST_POLL_TIME_DT, &HomePositionPlugin::timeout_cb, this);
-		poll_timer.stop();
+		make_timer(poll_timer, REQUEST_POLL_TIME_DT, &HomePositionPlugin::timeout_cb, false, false);
 		enable_connection_cb();
 	}
 
@@ -63,7 +63,7 @@ private:
 	ros::Subscriber hp_sub;
 	ros::ServiceServer update_srv;
 
-	ros::Timer poll_timer;
+	Timer poll_timer;
 
 	static constexpr int REQUEST_POLL_TIME_MS = 10000;	//! position refresh poll interval
 	const ros::Duration REQUEST_POLL_TIME_DT;
@@ -75,7 +75,7 @@ private:
 		bool ret = false;
 
 		try {
-			ros::NodeHandle pnh("~");
+			ros::NodeHandle pnh(private_nh());
 			auto client = pnh.serviceClient<mavros_msgs::CommandLong>("cmd/command");
 
 			mavros_msgs::CommandLong cmd{};
@@ -92,6 +92,18 @@ private:
 		return ret;
 	}
 
+	//! request without waiting for ACK, poll repeats it until HOME_POSITION received
+	void send_get_home_position(void)
+	{
+		using mavlink::common::MAV_CMD;
+
+		mavlink::common::msg::COMMAND_LONG cmd {};
+		m_uas->msg_set_target(cmd);
+		cmd.command = utils::enum_value(MAV_CMD::GET_HOME_POSITION);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+	}
+
 	void handle_home_position(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HOME_POSITION &home_position)
 	{
 		poll_timer.stop();
@@ -163,7 +175,7 @@ private:
 	void timeout_cb(const ros::TimerEvent &event)
 	{
 		ROS_INFO_NAMED("home_position", "HP: requesting home position");
-		call_get_home_position();
+		send_get_home_position();
 	}
 
 	void connection_cb(bool connected) override
@@ -177,5 +189,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::HomePositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::HomePositionPlugin)
@@ -16,6 +16,8 @@
 
 #include <cmath>
 #include <mavros/mavros_plugin.h>
+#include <mavros/message_pool.h>
+#include <mavros/latency_trace.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <sensor_msgs/Imu.h>
@@ -48,19 +50,28 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	IMUPlugin() : PluginBase(),
-		imu_nh("~imu"),
+		imu_nh(private_nh("imu")),
 		has_hr_imu(false),
 		has_raw_imu(false),
 		has_scaled_imu(false),
 		has_att_quat(false),
 		received_linear_accel(false),
 		linear_accel_vec_flu(Eigen::Vector3d::Zero()),
-		linear_accel_vec_frd(Eigen::Vector3d::Zero())
-	{ }
+		linear_accel_vec_frd(Eigen::Vector3d::Zero()),
+		hr_imu_stream(nullptr),
+		raw_imu_stream(nullptr),
+		scaled_imu_stream(nullptr),
+		scaled_press_stream(nullptr)
+	{
+		// axis signs of aircraft -> base_link, same for every sensor column
+		const Eigen::Vector3d signs = ftf::transform_frame_aircraft_baselink(Eigen::Vector3d::Ones());
+		frd_to_flu = signs.replicate<1, 3>();
+	}
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(imu_nh);
 
 		double linear_stdev, angular_stdev, orientation_stdev, mag_stdev;
 
@@ -83,12 +94,59 @@ public:
 		setup_covariance(unk_orientation_cov, 0.0);
 
 		imu_pub = imu_nh.advertise<sensor_msgs::Imu>("data", 10);
-		magn_pub = imu_nh.advertise<sensor_msgs::MagneticField>("mag", 10);
-		temp_imu_pub = imu_nh.advertise<sensor_msgs::Temperature>("temperature_imu", 10);
-		temp_baro_pub = imu_nh.advertise<sensor_msgs::Temperature>("temperature_baro", 10);
-		static_press_pub = imu_nh.advertise<sensor_msgs::FluidPressure>("static_pressure", 10);
-		diff_press_pub = imu_nh.advertise<sensor_msgs::FluidPressure>("diff_pressure", 10);
-		imu_raw_pub = imu_nh.advertise<sensor_msgs::Imu>("data_raw", 10);
+
+		// disabled output is never advertised, so it never has subscribers and its conversion is skipped
+		auto enabled = [this](const std::string &topic) {
+			bool en;
+			imu_nh.param("outputs/" + topic, en, true);
+			if (!en)
+				ROS_INFO_NAMED("imu", "IMU: %s output disabled", topic.c_str());
+			return en;
+		};
+
+		if (enabled("mag"))
+			magn_pub.advertise<sensor_msgs::MagneticField>(imu_nh, "mag", 10);
+		if (enabled("temperature_imu"))
+			temp_imu_pub.advertise<sensor_msgs::Temperature>(imu_nh, "temperature_imu", 10);
+		if (enabled("temperature_baro"))
+			temp_baro_pub.advertise<sensor_msgs::Temperature>(imu_nh, "temperature_baro", 10);
+		if (enabled("static_pressure"))
+			static_press_pub.advertise<sensor_msgs::FluidPressure>(imu_nh, "static_pressure", 10);
+		if (enabled("diff_pressure"))
+			diff_press_pub.advertise<sensor_msgs::FluidPressure>(imu_nh, "diff_pressure", 10);
+		if (enabled("data_raw"))
+			imu_raw_pub.advertise<sensor_msgs::Imu>(imu_nh, "data_raw", 10);
+
+		// topics fed by each message, linear acceleration of data comes from raw messages
+		using mavlink::common::msg::HIGHRES_IMU;
+		using mavlink::common::msg::RAW_IMU;
+		using mavlink::common::msg::SCALED_IMU;
+		using mavlink::common::msg::SCALED_PRESSURE;
+
+		auto &demand = m_uas->stream_demand;
+		auto subs = [](const plugin::LazyPublisher &pub) {
+			return [&pub]() { return pub.getNumSubscribers(); };
+		};
+		auto data_subs = [this]() { return imu_pub.getNumSubscribers(); };
+		const double def = StreamDemand::RATE_DEFAULT;
+
+		auto declare_imu = [&](mavlink::msgid_t msgid) {
+			demand.declare(msgid, "imu/data", data_subs, def);
+			demand.declare(msgid, "imu/data_raw", subs(imu_raw_pub), def);
+			return demand.declare(msgid, "imu/mag", subs(magn_pub), def);
+		};
+		auto declare_press = [&](mavlink::msgid_t msgid) {
+			demand.declare(msgid, "imu/static_pressure", subs(static_press_pub), def);
+			return demand.declare(msgid, "imu/diff_pressure", subs(diff_press_pub), def);
+		};
+
+		hr_imu_stream = declare_imu(HIGHRES_IMU::MSG_ID);
+		declare_press(HIGHRES_IMU::MSG_ID);
+		demand.declare(HIGHRES_IMU::MSG_ID, "imu/temperature_imu", subs(temp_imu_pub), def);
+		raw_imu_stream = declare_imu(RAW_IMU::MSG_ID);
+		scaled_imu_stream = declare_imu(SCALED_IMU::MSG_ID);
+		scaled_press_stream = declare_press(SCALED_PRESSURE::MSG_ID);
+		demand.declare(SCALED_PRESSURE::MSG_ID, "imu/temperature_baro", subs(temp_baro_pub), def);
 
 		// Reset has_* flags on connection change
 		enable_connection_cb();
@@ -109,13 +167,20 @@ private:
 	ros::NodeHandle imu_nh;
 	std::string frame_id;
 
-	ros::Publisher imu_pub;
-	ros::Publisher imu_raw_pub;
-	ros::Publisher magn_pub;
-	ros::Publisher temp_imu_pub;
-	ros::Publisher temp_baro_pub;
-	ros::Publisher static_press_pub;
-	ros::Publisher diff_press_pub;
+	ros::Publisher imu_pub;		// data always stored in UAS
+	plugin::LazyPublisher imu_raw_pub;
+	plugin::LazyPublisher magn_pub;
+	plugin::LazyPublisher temp_imu_pub;
+	plugin::LazyPublisher temp_baro_pub;
+	plugin::LazyPublisher static_press_pub;
+	plugin::LazyPublisher diff_press_pub;
+
+	// pools never mix messages with different filled field sets
+	MessagePool<sensor_msgs::Imu> imu_pool;
+	MessagePool<sensor_msgs::Imu> imu_raw_pool;
+	MessagePool<sensor_msgs::MagneticField> magn_pool;
+	MessagePool<sensor_msgs::Temperature> temp_pool;
+	MessagePool<sensor_msgs::FluidPressure> press_pool;
 
 	bool has_hr_imu;
 	bool has_raw_imu;
@@ -130,8 +195,37 @@ private:
 	ftf::Covariance3d unk_orientation_cov;
 	ftf::Covariance3d magnetic_cov;
 
+	//! sample columns: gyro, accel, mag
+	enum SampleCol { GYRO = 0, ACCEL = 1, MAG = 2 };
+	//! element factors of aircraft -> base_link for whole sample
+	Eigen::Matrix3d frd_to_flu;
+
+	//! streams of UAS::stream_demand, marked when message used
+	StreamDemand::Stream *hr_imu_stream;
+	StreamDemand::Stream *raw_imu_stream;
+	StreamDemand::Stream *scaled_imu_stream;
+	StreamDemand::Stream *scaled_press_stream;
+
 	/* -*- helpers -*- */
 
+	/**
+	 * @brief Convert all sensors of one report in one pass
+	 *
+	 * Aircraft -> base_link is an axis sign flip, so with unit scales
+	 * whole conversion is two element-wise products of 3x3 matrices.
+	 *
+	 * @param raw         columns gyro, accel, mag as sent by FCU
+	 * @param scale       unit coefficient of each column
+	 * @param[out] frd    scaled, aircraft frame
+	 * @param[out] flu    scaled, base_link frame
+	 */
+	void convert_sample(const Eigen::Matrix3d &raw, const Eigen::Vector3d &scale,
+			Eigen::Matrix3d &frd, Eigen::Matrix3d &flu)
+	{
+		frd.noalias() = raw * scale.asDiagonal();
+		flu = frd.cwiseProduct(frd_to_flu);
+	}
+
 	/**
 	 * @brief Setup 3x3 covariance matrix
 	 * @param cov		Covariance matrix
@@ -163,8 +257,8 @@ private:
 	void publish_imu_data(uint32_t time_boot_ms, Eigen::Quaterniond &orientation_enu,
 				Eigen::Quaterniond &orientation_ned, Eigen::Vector3d &gyro_flu, Eigen::Vector3d &gyro_frd)
 	{
-		auto imu_ned_msg = boost::make_shared<sensor_msgs::Imu>();
-		auto imu_enu_msg = boost::make_shared<sensor_msgs::Imu>();
+		auto imu_ned_msg = imu_pool.acquire();
+		auto imu_enu_msg = imu_pool.acquire();
 
 		// Fill message header
 		imu_enu_msg->header = m_uas->synchronized_header(frame_id, time_boot_ms);
@@ -216,6 +310,7 @@ private:
 		 *  @snippet src/plugins/imu.cpp pub_enu
 		 */
 		// [pub_enu]
+		MAVROS_TRACE_MARK(PUBLISH);
 		imu_pub.publish(imu_enu_msg);
 		// [pub_enu]
 	}
@@ -227,10 +322,18 @@ private:
 	 * @param accel_flu   Linear acceleration in the base_link Forward-Left-Up frame
 	 * @param accel_frd   Linear acceleration in the aircraft Forward-Right-Down frame
 	 */
-	void publish_imu_data_raw(std_msgs::Header &header, Eigen::Vector3d &gyro_flu,
-				Eigen::Vector3d &accel_flu, Eigen::Vector3d &accel_frd)
+	void publish_imu_data_raw(const std_msgs::Header &header, const Eigen::Vector3d &gyro_flu,
+				const Eigen::Vector3d &accel_flu, const Eigen::Vector3d &accel_frd)
 	{
-		auto imu_msg = boost::make_shared<sensor_msgs::Imu>();
+		// Save readings
+		linear_accel_vec_flu = accel_flu;
+		linear_accel_vec_frd = accel_frd;
+		received_linear_accel = true;
+
+		if (!imu_raw_pub.has_subscribers())
+			return;
+
+		auto imu_msg = imu_raw_pool.acquire();
 
 		// Fill message header
 		imu_msg->header = header;
@@ -238,16 +341,12 @@ private:
 		tf::vectorEigenToMsg(gyro_flu, imu_msg->angular_velocity);
 		tf::vectorEigenToMsg(accel_flu, imu_msg->linear_acceleration);
 
-		// Save readings
-		linear_accel_vec_flu = accel_flu;
-		linear_accel_vec_frd = accel_frd;
-		received_linear_accel = true;
-
 		imu_msg->orientation_covariance = unk_orientation_cov;
 		imu_msg->angular_velocity_covariance = angular_velocity_cov;
 		imu_msg->linear_acceleration_covariance = linear_acceleration_cov;
 
 		// Publish message [ENU frame]
+		MAVROS_TRACE_MARK(PUBLISH);
 		imu_raw_pub.publish(imu_msg);
 	}
 
@@ -256,9 +355,12 @@ private:
 	 * @param header	Message frame_id and timestamp
 	 * @param mag_field	Magnetic field in the base_link ENU frame
 	 */
-	void publish_mag(std_msgs::Header &header, Eigen::Vector3d &mag_field)
+	void publish_mag(const std_msgs::Header &header, const Eigen::Vector3d &mag_field)
 	{
-		auto magn_msg = boost::make_shared<sensor_msgs::MagneticField>();
+		if (!magn_pub.has_subscribers())
+			return;
+
+		auto magn_msg = magn_pool.acquire();
 
 		// Fill message header
 		magn_msg->header = header;
@@ -267,6 +369,7 @@ private:
 		magn_msg->magnetic_field_covariance = magnetic_cov;
 
 		// Publish message [ENU frame]
+		MAVROS_TRACE_MARK(PUBLISH);
 		magn_pub.publish(magn_msg);
 	}
 
@@ -280,6 +383,7 @@ private:
 	 */
 	void handle_attitude(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ATTITUDE &att)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		if (has_att_quat)
 			return;
 
@@ -325,6 +429,7 @@ private:
 	 */
 	void handle_attitude_quaternion(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ATTITUDE_QUATERNION &att_q)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		ROS_INFO_COND_NAMED(!has_att_quat, "imu", "IMU: Attitude quaternion IMU detected!");
 		has_att_quat = true;
 
@@ -367,46 +472,43 @@ private:
 	 */
 	void handle_highres_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HIGHRES_IMU &imu_hr)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		ROS_INFO_COND_NAMED(!has_hr_imu, "imu", "IMU: High resolution IMU detected!");
 		has_hr_imu = true;
+		hr_imu_stream->seen();
 
 		auto header = m_uas->synchronized_header(frame_id, imu_hr.time_usec);
 		/** @todo Make more paranoic check of HIGHRES_IMU.fields_updated
 		 */
 
-		/** Check if accelerometer + gyroscope data are available.
-		 *  Data is expressed in aircraft frame it is required to rotate to the base_link frame:
+		const bool has_accel_gyro = imu_hr.fields_updated & ((7 << 3) | (7 << 0));
+		const bool want_mag = (imu_hr.fields_updated & (7 << 6)) && magn_pub.has_subscribers();
+
+		/** Accelerometer, gyroscope and magnetometer are expressed in aircraft frame,
+		 *  all rotated to the base_link frame in one pass:
 		 *  @snippet src/plugins/imu.cpp accel_available
 		 */
 		// [accel_available]
-		if (imu_hr.fields_updated & ((7 << 3) | (7 << 0))) {
-			auto gyro_flu = ftf::transform_frame_aircraft_baselink(Eigen::Vector3d(imu_hr.xgyro, imu_hr.ygyro, imu_hr.zgyro));
-
-			auto accel_frd = Eigen::Vector3d(imu_hr.xacc, imu_hr.yacc, imu_hr.zacc);
-			auto accel_flu = ftf::transform_frame_aircraft_baselink(accel_frd);
-
-			publish_imu_data_raw(header, gyro_flu, accel_flu, accel_frd);
+		if (has_accel_gyro || want_mag) {
+			Eigen::Matrix3d raw, frd, flu;
+			raw << imu_hr.xgyro, imu_hr.xacc, imu_hr.xmag,
+				imu_hr.ygyro, imu_hr.yacc, imu_hr.ymag,
+				imu_hr.zgyro, imu_hr.zacc, imu_hr.zmag;
+			convert_sample(raw, Eigen::Vector3d(1.0, 1.0, GAUSS_TO_TESLA), frd, flu);
+
+			if (has_accel_gyro)
+				publish_imu_data_raw(header, flu.col(GYRO), flu.col(ACCEL), frd.col(ACCEL));
+			if (want_mag)
+				publish_mag(header, flu.col(MAG));
 		}
 		// [accel_available]
 
-		/** Check if magnetometer data is available:
-		 *  @snippet src/plugins/imu.cpp mag_available
-		 */
-		// [mag_available]
-		if (imu_hr.fields_updated & (7 << 6)) {
-			auto mag_field = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
-						Eigen::Vector3d(imu_hr.xmag, imu_hr.ymag, imu_hr.zmag) * GAUSS_TO_TESLA);
-
-			publish_mag(header, mag_field);
-		}
-		// [mag_available]
-
 		/** Check if static pressure sensor data is available:
 		 *  @snippet src/plugins/imu.cpp static_pressure_available
 		 */
 		// [static_pressure_available]
-		if (imu_hr.fields_updated & (1 << 9)) {
-			auto static_pressure_msg = boost::make_shared<sensor_msgs::FluidPressure>();
+		if ((imu_hr.fields_updated & (1 << 9)) && static_press_pub.has_subscribers()) {
+			auto static_pressure_msg = press_pool.acquire();
 
 			static_pressure_msg->header = header;
 			static_pressure_msg->fluid_pressure = imu_hr.abs_pressure;
@@ -419,8 +521,8 @@ private:
 		 *  @snippet src/plugins/imu.cpp differential_pressure_available
 		 */
 		// [differential_pressure_available]
-		if (imu_hr.fields_updated & (1 << 10)) {
-			auto differential_pressure_msg = boost::make_shared<sensor_msgs::FluidPressure>();
+		if ((imu_hr.fields_updated & (1 << 10)) && diff_press_pub.has_subscribers()) {
+			auto differential_pressure_msg = press_pool.acquire();
 
 			differential_pressure_msg->header = header;
 			differential_pressure_msg->fluid_pressure = imu_hr.diff_pressure;
@@ -433,8 +535,8 @@ private:
 		 *  @snippet src/plugins/imu.cpp temperature_available
 		 */
 		// [temperature_available]
-		if (imu_hr.fields_updated & (1 << 12)) {
-			auto temp_msg = boost::make_shared<sensor_msgs::Temperature>();
+		if ((imu_hr.fields_updated & (1 << 12)) && temp_imu_pub.has_subscribers()) {
+			auto temp_msg = temp_pool.acquire();
 
 			temp_msg->header = header;
 			temp_msg->temperature = imu_hr.temperature;
@@ -452,31 +554,36 @@ private:
 	 */
 	void handle_raw_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RAW_IMU &imu_raw)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		ROS_INFO_COND_NAMED(!has_raw_imu, "imu", "IMU: Raw IMU message used.");
 		has_raw_imu = true;
+		raw_imu_stream->seen();
 
 		if (has_hr_imu || has_scaled_imu)
 			return;
 
-		auto imu_msg = boost::make_shared<sensor_msgs::Imu>();
 		auto header = m_uas->synchronized_header(frame_id, imu_raw.time_usec);
 
 		/** @note APM send SCALED_IMU data as RAW_IMU
 		 */
-		auto gyro_flu = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
-					Eigen::Vector3d(imu_raw.xgyro, imu_raw.ygyro, imu_raw.zgyro) * MILLIRS_TO_RADSEC);
-		auto accel_frd = Eigen::Vector3d(imu_raw.xacc, imu_raw.yacc, imu_raw.zacc);
-		auto accel_flu = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(accel_frd);
-
-		if (m_uas->is_ardupilotmega()) {
-			accel_frd *= MILLIG_TO_MS2;
-			accel_flu *= MILLIG_TO_MS2;
-		} else if (m_uas->is_px4()) {
-			accel_frd *= MILLIMS2_TO_MS2;
-			accel_flu *= MILLIMS2_TO_MS2;
-		}
+		double accel_scale = 1.0;
+		if (m_uas->is_ardupilotmega())
+			accel_scale = MILLIG_TO_MS2;
+		else if (m_uas->is_px4())
+			accel_scale = MILLIMS2_TO_MS2;
 
-		publish_imu_data_raw(header, gyro_flu, accel_flu, accel_frd);
+		/** Gyroscope, accelerometer and magnetic field data, converted together:
+		 *  @snippet src/plugins/imu.cpp mag_field
+		 */
+		// [mag_field]
+		Eigen::Matrix3d raw, frd, flu;
+		raw << imu_raw.xgyro, imu_raw.xacc, imu_raw.xmag,
+			imu_raw.ygyro, imu_raw.yacc, imu_raw.ymag,
+			imu_raw.zgyro, imu_raw.zacc, imu_raw.zmag;
+		convert_sample(raw, Eigen::Vector3d(MILLIRS_TO_RADSEC, accel_scale, MILLIT_TO_TESLA), frd, flu);
+		// [mag_field]
+
+		publish_imu_data_raw(header, flu.col(GYRO), flu.col(ACCEL), frd.col(ACCEL));
 
 		if (!m_uas->is_ardupilotmega()) {
 			ROS_WARN_THROTTLE_NAMED(60, "imu", "IMU: linear acceleration on RAW_IMU known on APM only.");
@@ -485,15 +592,7 @@ private:
 			linear_accel_vec_frd.setZero();
 		}
 
-		/** Magnetic field data:
-		 *  @snippet src/plugins/imu.cpp mag_field
-		 */
-		// [mag_field]
-		auto mag_field = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
-					Eigen::Vector3d(imu_raw.xmag, imu_raw.ymag, imu_raw.zmag) * MILLIT_TO_TESLA);
-		// [mag_field]
-
-		publish_mag(header, mag_field);
+		publish_mag(header, flu.col(MAG));
 	}
 
 	/**
@@ -504,29 +603,27 @@ private:
 	 */
 	void handle_scaled_imu(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SCALED_IMU &imu_raw)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		if (has_hr_imu)
 			return;
 
 		ROS_INFO_COND_NAMED(!has_scaled_imu, "imu", "IMU: Scaled IMU message used.");
 		has_scaled_imu = true;
+		scaled_imu_stream->seen();
 
-		auto imu_msg = boost::make_shared<sensor_msgs::Imu>();
 		auto header = m_uas->synchronized_header(frame_id, imu_raw.time_boot_ms);
 
-		auto gyro_flu = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
-					Eigen::Vector3d(imu_raw.xgyro, imu_raw.ygyro, imu_raw.zgyro) * MILLIRS_TO_RADSEC);
-		auto accel_frd = Eigen::Vector3d(Eigen::Vector3d(imu_raw.xacc, imu_raw.yacc, imu_raw.zacc) * MILLIG_TO_MS2);
-		auto accel_flu = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(accel_frd);
-
-		publish_imu_data_raw(header, gyro_flu, accel_flu, accel_frd);
-
-		/** Magnetic field data:
+		/** Gyroscope, accelerometer and magnetic field data:
 		 *  @snippet src/plugins/imu.cpp mag_field
 		 */
-		auto mag_field = ftf::transform_frame_aircraft_baselink<Eigen::Vector3d>(
-					Eigen::Vector3d(imu_raw.xmag, imu_raw.ymag, imu_raw.zmag) * MILLIT_TO_TESLA);
-
-		publish_mag(header, mag_field);
+		Eigen::Matrix3d raw, frd, flu;
+		raw << imu_raw.xgyro, imu_raw.xacc, imu_raw.xmag,
+			imu_raw.ygyro, imu_raw.yacc, imu_raw.ymag,
+			imu_raw.zgyro, imu_raw.zacc, imu_raw.zmag;
+		convert_sample(raw, Eigen::Vector3d(MILLIRS_TO_RADSEC, MILLIG_TO_MS2, MILLIT_TO_TESLA), frd, flu);
+
+		publish_imu_data_raw(header, flu.col(GYRO), flu.col(ACCEL), frd.col(ACCEL));
+		publish_mag(header, flu.col(MAG));
 	}
 
 	/**
@@ -537,25 +634,33 @@ private:
 	 */
 	void handle_scaled_pressure(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SCALED_PRESSURE &press)
 	{
+		MAVROS_TRACE_MARK(HANDLER);
 		if (has_hr_imu)
 			return;
 
+		scaled_press_stream->seen();
 		auto header = m_uas->synchronized_header(frame_id, press.time_boot_ms);
 
-		auto temp_msg = boost::make_shared<sensor_msgs::Temperature>();
-		temp_msg->header = header;
-		temp_msg->temperature = press.temperature / 100.0;
-		temp_baro_pub.publish(temp_msg);
+		if (temp_baro_pub.has_subscribers()) {
+			auto temp_msg = temp_pool.acquire();
+			temp_msg->header = header;
+			temp_msg->temperature = press.temperature / 100.0;
+			temp_baro_pub.publish(temp_msg);
+		}
 
-		auto static_pressure_msg = boost::make_shared<sensor_msgs::FluidPressure>();
-		static_pressure_msg->header = header;
-		static_pressure_msg->fluid_pressure = press.press_abs * 100.0;
-		static_press_pub.publish(static_pressure_msg);
+		if (static_press_pub.has_subscribers()) {
+			auto static_pressure_msg = press_pool.acquire();
+			static_pressure_msg->header = header;
+			static_pressure_msg->fluid_pressure = press.press_abs * 100.0;
+			static_press_pub.publish(static_pressure_msg);
+		}
 
-		auto differential_pressure_msg = boost::make_shared<sensor_msgs::FluidPressure>();
-		differential_pressure_msg->header = header;
-		differential_pressure_msg->fluid_pressure = press.press_diff * 100.0;
-		diff_press_pub.publish(differential_pressure_msg);
+		if (diff_press_pub.has_subscribers()) {
+			auto differential_pressure_msg = press_pool.acquire();
+			differential_pressure_msg->header = header;
+			differential_pressure_msg->fluid_pressure = press.press_diff * 100.0;
+			diff_press_pub.publish(differential_pressure_msg);
+		}
 	}
 
 	// Checks for connection and overrides variable values
@@ -569,5 +674,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::IMUPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::IMUPlugin)
@@ -34,19 +34,25 @@ namespace std_plugins {
  * @brief Local position plugin.
  * Publish local position to TF, PositionStamped, TwistStamped
  * and Odometry
+ *
+ * State of each message computed once, then only outputs with subscribers
+ * are filled from it. With ~odom_only other topics are not advertised.
  */
 class LocalPositionPlugin : public plugin::PluginBase {
 public:
 	LocalPositionPlugin() : PluginBase(),
-		lp_nh("~local_position"),
+		lp_nh(private_nh("local_position")),
 		tf_send(false),
+		odom_only(false),
 		has_local_position_ned(false),
-		has_local_position_ned_cov(false)
+		has_local_position_ned_cov(false),
+		lp_stream(nullptr)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(lp_nh);
 
 		// header frame_id.
 		// default to map (world-fixed,ENU as per REP-105).
@@ -56,14 +62,41 @@ public:
 		lp_nh.param("tf/send", tf_send, false);
 		lp_nh.param<std::string>("tf/frame_id", tf_frame_id, "map");
 		lp_nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "base_link");
+		// estimator input: only odom (and TF), other topics not advertised
+		lp_nh.param("odom_only", odom_only, false);
+
+		local_odom.advertise<nav_msgs::Odometry>(lp_nh, "odom", 10);
+		if (!odom_only) {
+			local_position.advertise<geometry_msgs::PoseStamped>(lp_nh, "pose", 10);
+			local_position_cov.advertise<geometry_msgs::PoseWithCovarianceStamped>(lp_nh, "pose_cov", 10);
+			local_velocity_local.advertise<geometry_msgs::TwistStamped>(lp_nh, "velocity_local", 10);
+			local_velocity_body.advertise<geometry_msgs::TwistStamped>(lp_nh, "velocity_body", 10);
+			local_velocity_cov.advertise<geometry_msgs::TwistWithCovarianceStamped>(lp_nh, "velocity_body_cov", 10);
+			local_accel.advertise<geometry_msgs::AccelWithCovarianceStamped>(lp_nh, "accel", 10);
+		}
 
-		local_position = lp_nh.advertise<geometry_msgs::PoseStamped>("pose", 10);
-		local_position_cov = lp_nh.advertise<geometry_msgs::PoseWithCovarianceStamped>("pose_cov", 10);
-		local_velocity_local = lp_nh.advertise<geometry_msgs::TwistStamped>("velocity_local", 10);
-		local_velocity_body = lp_nh.advertise<geometry_msgs::TwistStamped>("velocity_body", 10);
-		local_velocity_cov = lp_nh.advertise<geometry_msgs::TwistWithCovarianceStamped>("velocity_body_cov", 10);
-		local_accel = lp_nh.advertise<geometry_msgs::AccelWithCovarianceStamped>("accel", 10);
-		local_odom = lp_nh.advertise<nav_msgs::Odometry>("odom",10);
+		// LOCAL_POSITION_NED demand: all topics, TF and position history of UAS
+		using mavlink::common::msg::LOCAL_POSITION_NED;
+		const auto msgid = LOCAL_POSITION_NED::MSG_ID;
+		const double def = StreamDemand::RATE_DEFAULT;
+		auto &demand = m_uas->stream_demand;
+		auto subs = [](const plugin::LazyPublisher &pub) {
+			return [&pub]() { return pub.getNumSubscribers(); };
+		};
+		auto always = []() { return 1U; };
+
+		demand.declare(msgid, "local_position/odom", subs(local_odom), def);
+		if (!odom_only) {
+			demand.declare(msgid, "local_position/pose", subs(local_position), def);
+			demand.declare(msgid, "local_position/pose_cov", subs(local_position_cov), def);
+			demand.declare(msgid, "local_position/velocity_local", subs(local_velocity_local), def);
+			demand.declare(msgid, "local_position/velocity_body", subs(local_velocity_body), def);
+			demand.declare(msgid, "local_position/velocity_body_cov", subs(local_velocity_cov), def);
+			demand.declare(msgid, "local_position/accel", subs(local_accel), def);
+		}
+		if (tf_send)
+			demand.declare(msgid, "local_position/tf", always, def);
+		lp_stream = demand.declare(msgid, "local_position/history", always, def);
 	}
 
 	Subscriptions get_subscriptions() {
@@ -74,163 +107,249 @@ public:
 	}
 
 private:
+	/**
+	 * @brief Vehicle state of one message, computed once for all outputs
+	 */
+	struct LocalState {
+		std_msgs::Header header;			//!< stamp and frame_id
+		Eigen::Vector3d position;			//!< ENU
+		Eigen::Vector3d velocity;			//!< ENU
+		Eigen::Quaterniond orientation;			//!< baselink -> ENU
+		geometry_msgs::Quaternion orientation_msg;	//!< baselink -> ENU
+		geometry_msgs::Vector3 angular_msg;		//!< baselink
+		Eigen::Vector3d linear_body;			//!< baselink
+	};
+
 	ros::NodeHandle lp_nh;
 
-	ros::Publisher local_position;
-	ros::Publisher local_position_cov;
-	ros::Publisher local_velocity_local;
-	ros::Publisher local_velocity_body;
-	ros::Publisher local_velocity_cov;
-	ros::Publisher local_accel;
-	ros::Publisher local_odom;
+	plugin::LazyPublisher local_position;
+	plugin::LazyPublisher local_position_cov;
+	plugin::LazyPublisher local_velocity_local;
+	plugin::LazyPublisher local_velocity_body;
+	plugin::LazyPublisher local_velocity_cov;
+	plugin::LazyPublisher local_accel;
+	plugin::LazyPublisher local_odom;
 
 	std::string frame_id;		//!< frame for Pose
 	std::string tf_frame_id;	//!< origin for TF
 	std::string tf_child_frame_id;	//!< frame for TF
 	bool tf_send;
+	bool odom_only;
 	bool has_local_position_ned;
 	bool has_local_position_ned_cov;
+	StreamDemand::Stream *lp_stream;	//!< LOCAL_POSITION_NED of UAS::stream_demand
+
+	//! state needed for TF or any topic
+	bool state_required() const
+	{
+		return tf_send ||
+		       local_odom.has_subscribers() ||
+		       local_position.has_subscribers() ||
+		       local_position_cov.has_subscribers() ||
+		       local_velocity_local.has_subscribers() ||
+		       local_velocity_body.has_subscribers() ||
+		       local_velocity_cov.has_subscribers() ||
+		       local_accel.has_subscribers();
+	}
+
+	/**
+	 * @brief Fill @a st from FCU NED position and velocity
+	 *
+	 * Attitude read once, so all outputs of the message use the same sample.
+	 */
+	void make_state(const ros::Time &stamp, const Eigen::Vector3d &enu_position,
+			const Eigen::Vector3d &ned_velocity, LocalState &st)
+	{
+		st.header.stamp = stamp;
+		st.header.frame_id = frame_id;
+		st.position = enu_position;
+		st.velocity = ftf::transform_frame_ned_enu(ned_velocity);
+
+		// Note this orientation describes baselink->ENU transform
+		m_uas->get_attitude_enu(st.orientation_msg, st.angular_msg);
+		tf::quaternionMsgToEigen(st.orientation_msg, st.orientation);
+		st.linear_body = ftf::transform_frame_enu_baselink(st.velocity, st.orientation.inverse());
+	}
+
+	void fill_pose(const LocalState &st, geometry_msgs::Pose &pose)
+	{
+		tf::pointEigenToMsg(st.position, pose.position);
+		pose.orientation = st.orientation_msg;
+	}
+
+	void fill_twist_body(const LocalState &st, geometry_msgs::Twist &twist)
+	{
+		tf::vectorEigenToMsg(st.linear_body, twist.linear);
+		twist.angular = st.angular_msg;
+	}
+
+	//! @note @a pose covariance expected zeroed (fresh message)
+	void fill_pose_cov(const LocalState &st, const mavlink::common::msg::LOCAL_POSITION_NED_COV &pos_ned,
+			geometry_msgs::PoseWithCovariance &pose)
+	{
+		fill_pose(st, pose.pose);
+		pose.covariance[0] = pos_ned.covariance[0];	// x
+		pose.covariance[7] = pos_ned.covariance[9];	// y
+		pose.covariance[14] = pos_ned.covariance[17];	// z
+	}
+
+	//! @note @a twist covariance expected zeroed (fresh message)
+	void fill_twist_cov(const LocalState &st, const mavlink::common::msg::LOCAL_POSITION_NED_COV &pos_ned,
+			geometry_msgs::TwistWithCovariance &twist)
+	{
+		fill_twist_body(st, twist.twist);
+		twist.covariance[0] = pos_ned.covariance[24];	// vx
+		twist.covariance[7] = pos_ned.covariance[30];	// vy
+		twist.covariance[14] = pos_ned.covariance[35];	// vz
+		// TODO: orientation + angular velocity covariances from ATTITUDE_QUATERION_COV
+	}
+
+	//! twist header: same stamp, body frame
+	std_msgs::Header body_header(const LocalState &st)
+	{
+		std_msgs::Header header;
+		header.stamp = st.header.stamp;
+		header.frame_id = tf_child_frame_id;
+		return header;
+	}
 
-	void publish_tf(boost::shared_ptr<nav_msgs::Odometry> &odom)
+	void publish_pose(const LocalState &st)
+	{
+		if (!local_position.has_subscribers())
+			return;
+
+		auto pose = boost::make_shared<geometry_msgs::PoseStamped>();
+		pose->header = st.header;
+		fill_pose(st, pose->pose);
+		local_position.publish(pose);
+	}
+
+	void publish_velocity_body(const LocalState &st)
+	{
+		if (!local_velocity_body.has_subscribers())
+			return;
+
+		auto twist_body = boost::make_shared<geometry_msgs::TwistStamped>();
+		twist_body->header = body_header(st);
+		fill_twist_body(st, twist_body->twist);
+		local_velocity_body.publish(twist_body);
+	}
+
+	void publish_tf(const LocalState &st)
 	{
 		if (tf_send) {
 			geometry_msgs::TransformStamped transform;
-			transform.header.stamp = odom->header.stamp;
+			transform.header.stamp = st.header.stamp;
 			transform.header.frame_id = tf_frame_id;
 			transform.child_frame_id = tf_child_frame_id;
-			transform.transform.translation.x = odom->pose.pose.position.x;
-			transform.transform.translation.y = odom->pose.pose.position.y;
-			transform.transform.translation.z = odom->pose.pose.position.z;
-			transform.transform.rotation = odom->pose.pose.orientation;
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			tf::vectorEigenToMsg(st.position, transform.transform.translation);
+			transform.transform.rotation = st.orientation_msg;
+			m_uas->tf_aggregator.send(transform);
 		}
 	}
 
 	void handle_local_position_ned(const mavlink::mavlink_message_t *msg, mavlink::common::msg::LOCAL_POSITION_NED &pos_ned)
 	{
 		has_local_position_ned = true;
+		lp_stream->seen();
 
 		//--------------- Transform FCU position and Velocity Data ---------------//
 		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z));
-		auto enu_velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz));
+		auto stamp = m_uas->synchronise_stamp(pos_ned.time_boot_ms);
 
-		//--------------- Get Odom Information ---------------//
-		// Note this orientation describes baselink->ENU transform
-		auto enu_orientation_msg = m_uas->get_attitude_orientation_enu();
-		auto baselink_angular_msg = m_uas->get_attitude_angular_velocity_enu();
-		Eigen::Quaterniond enu_orientation;
-		tf::quaternionMsgToEigen(enu_orientation_msg, enu_orientation);
-		auto baselink_linear = ftf::transform_frame_enu_baselink(enu_velocity, enu_orientation.inverse());
+		// history used by latency compensated lookups, even without subscribers
+		m_uas->update_local_position(stamp, enu_position);
 
-		auto odom = boost::make_shared<nav_msgs::Odometry>();
-		odom->header = m_uas->synchronized_header(frame_id, pos_ned.time_boot_ms);
-		odom->child_frame_id = tf_child_frame_id;
+		if (!state_required())
+			return;
 
-		tf::pointEigenToMsg(enu_position, odom->pose.pose.position);
-		odom->pose.pose.orientation = enu_orientation_msg;
-		tf::vectorEigenToMsg(baselink_linear, odom->twist.twist.linear);
-		odom->twist.twist.angular = baselink_angular_msg;
+		LocalState st;
+		make_state(stamp, enu_position, Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz), st);
 
 		// publish odom if we don't have LOCAL_POSITION_NED_COV
-		if (!has_local_position_ned_cov) {
+		if (!has_local_position_ned_cov && local_odom.has_subscribers()) {
+			auto odom = boost::make_shared<nav_msgs::Odometry>();
+			odom->header = st.header;
+			odom->child_frame_id = tf_child_frame_id;
+			fill_pose(st, odom->pose.pose);
+			fill_twist_body(st, odom->twist.twist);
 			local_odom.publish(odom);
 		}
 
 		// publish pose always
-		auto pose = boost::make_shared<geometry_msgs::PoseStamped>();
-		pose->header = odom->header;
-		pose->pose = odom->pose.pose;
-		local_position.publish(pose);
+		publish_pose(st);
 
 		// publish velocity always
 		// velocity in the body frame
-		auto twist_body = boost::make_shared<geometry_msgs::TwistStamped>();
-		twist_body->header.stamp = odom->header.stamp;
-		twist_body->header.frame_id = tf_child_frame_id;
-		twist_body->twist.linear = odom->twist.twist.linear;
-		twist_body->twist.angular = baselink_angular_msg;
-		local_velocity_body.publish(twist_body);
+		publish_velocity_body(st);
 
 		// velocity in the local frame
-		auto twist_local = boost::make_shared<geometry_msgs::TwistStamped>();
-		twist_local->header.stamp = twist_body->header.stamp;
-		twist_local->header.frame_id = tf_child_frame_id;
-		tf::vectorEigenToMsg(enu_velocity, twist_local->twist.linear);
-		tf::vectorEigenToMsg(ftf::transform_frame_baselink_enu(ftf::to_eigen(baselink_angular_msg), enu_orientation),
-						twist_body->twist.angular);
-		local_velocity_local.publish(twist_local);
+		if (local_velocity_local.has_subscribers()) {
+			auto twist_local = boost::make_shared<geometry_msgs::TwistStamped>();
+			twist_local->header = body_header(st);
+			tf::vectorEigenToMsg(st.velocity, twist_local->twist.linear);
+			tf::vectorEigenToMsg(ftf::transform_frame_baselink_enu(ftf::to_eigen(st.angular_msg), st.orientation),
+							twist_local->twist.angular);
+			local_velocity_local.publish(twist_local);
+		}
 
 		// publish tf
-		publish_tf(odom);
+		publish_tf(st);
 	}
 
 	void handle_local_position_ned_cov(const mavlink::mavlink_message_t *msg, mavlink::common::msg::LOCAL_POSITION_NED_COV &pos_ned)
 	{
 		has_local_position_ned_cov = true;
 
-		auto enu_position = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z));
-		auto enu_velocity = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz));
-
-		auto enu_orientation_msg = m_uas->get_attitude_orientation_enu();
-		auto baselink_angular_msg = m_uas->get_attitude_angular_velocity_enu();
-		Eigen::Quaterniond enu_orientation;
-		tf::quaternionMsgToEigen(enu_orientation_msg, enu_orientation);
-		auto baselink_linear = ftf::transform_frame_enu_baselink(enu_velocity, enu_orientation.inverse());
-
-		auto odom = boost::make_shared<nav_msgs::Odometry>();
-		odom->header = m_uas->synchronized_header(frame_id, pos_ned.time_usec);
-		odom->child_frame_id = tf_child_frame_id;
-
-		tf::pointEigenToMsg(enu_position, odom->pose.pose.position);
-		odom->pose.pose.orientation = enu_orientation_msg;
-		tf::vectorEigenToMsg(baselink_linear, odom->twist.twist.linear);
-		odom->twist.twist.angular = baselink_angular_msg;
-
-		odom->pose.covariance[0] = pos_ned.covariance[0];	// x
-		odom->pose.covariance[7] = pos_ned.covariance[9];	// y
-		odom->pose.covariance[14] = pos_ned.covariance[17];	// z
-
-		odom->twist.covariance[0] = pos_ned.covariance[24];	// vx
-		odom->twist.covariance[7] = pos_ned.covariance[30];	// vy
-		odom->twist.covariance[14] = pos_ned.covariance[35];	// vz
-		// TODO: orientation + angular velocity covariances from ATTITUDE_QUATERION_COV
+		if (!state_required())
+			return;
+
+		LocalState st;
+		make_state(m_uas->synchronise_stamp(pos_ned.time_usec),
+				ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.x, pos_ned.y, pos_ned.z)),
+				Eigen::Vector3d(pos_ned.vx, pos_ned.vy, pos_ned.vz), st);
 
 		// publish odom always
-		local_odom.publish(odom);
+		if (local_odom.has_subscribers()) {
+			auto odom = boost::make_shared<nav_msgs::Odometry>();
+			odom->header = st.header;
+			odom->child_frame_id = tf_child_frame_id;
+			fill_pose_cov(st, pos_ned, odom->pose);
+			fill_twist_cov(st, pos_ned, odom->twist);
+			local_odom.publish(odom);
+		}
 
 		// publish pose_cov always
-		auto pose_cov = boost::make_shared<geometry_msgs::PoseWithCovarianceStamped>();
-		pose_cov->header = odom->header;
-		pose_cov->pose = odom->pose;
-		local_position_cov.publish(pose_cov);
+		if (local_position_cov.has_subscribers()) {
+			auto pose_cov = boost::make_shared<geometry_msgs::PoseWithCovarianceStamped>();
+			pose_cov->header = st.header;
+			fill_pose_cov(st, pos_ned, pose_cov->pose);
+			local_position_cov.publish(pose_cov);
+		}
 
 		// publish velocity_cov always
-		auto twist_cov = boost::make_shared<geometry_msgs::TwistWithCovarianceStamped>();
-		twist_cov->header.stamp = odom->header.stamp;
-		twist_cov->header.frame_id = odom->child_frame_id;
-		twist_cov->twist = odom->twist;
-		local_velocity_cov.publish(twist_cov);
+		if (local_velocity_cov.has_subscribers()) {
+			auto twist_cov = boost::make_shared<geometry_msgs::TwistWithCovarianceStamped>();
+			twist_cov->header = body_header(st);
+			fill_twist_cov(st, pos_ned, twist_cov->twist);
+			local_velocity_cov.publish(twist_cov);
+		}
 
 		// publish pose, velocity, tf if we don't have LOCAL_POSITION_NED
 		if (!has_local_position_ned) {
-			auto pose = boost::make_shared<geometry_msgs::PoseStamped>();
-			pose->header = odom->header;
-			pose->pose = odom->pose.pose;
-			local_position.publish(pose);
-
-			auto twist = boost::make_shared<geometry_msgs::TwistStamped>();
-			twist->header.stamp = odom->header.stamp;
-			twist->header.frame_id = odom->child_frame_id;
-			twist->twist = odom->twist.twist;
-			local_velocity_body.publish(twist);
+			publish_pose(st);
+			publish_velocity_body(st);
 
 			// publish tf
-			publish_tf(odom);
+			publish_tf(st);
 		}
 
+		if (!local_accel.has_subscribers())
+			return;
+
 		// publish accelerations
 		auto accel = boost::make_shared<geometry_msgs::AccelWithCovarianceStamped>();
-		accel->header = odom->header;
+		accel->header = st.header;
 
 		auto enu_accel = ftf::transform_frame_ned_enu(Eigen::Vector3d(pos_ned.ax, pos_ned.ay, pos_ned.az));
 		tf::vectorEigenToMsg(enu_accel, accel->accel.accel.linear);
@@ -241,9 +360,10 @@ private:
 
 		local_accel.publish(accel);
 	}
+
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::LocalPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::LocalPositionPlugin)
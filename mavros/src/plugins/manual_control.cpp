@@ -26,12 +26,13 @@ namespace std_plugins {
 class ManualControlPlugin : public plugin::PluginBase {
 public:
 	ManualControlPlugin() : PluginBase(),
-		manual_control_nh("~manual_control")
+		manual_control_nh(private_nh("manual_control"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(manual_control_nh);
 
 		control_pub = manual_control_nh.advertise<mavros_msgs::ManualControl>("control", 10);
 		send_sub = manual_control_nh.subscribe("send", 1, &ManualControlPlugin::send_cb, this);
@@ -84,5 +85,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ManualControlPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::ManualControlPlugin)
@@ -14,11 +14,22 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <array>
 #include <chrono>
+#include <deque>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/rtt_estimator.h>
 
 #include <mavros_msgs/ParamSet.h>
+#include <mavros_msgs/ParamSetBatch.h>
 #include <mavros_msgs/ParamGet.h>
 #include <mavros_msgs/ParamPull.h>
 #include <mavros_msgs/ParamPush.h>
@@ -43,7 +54,8 @@ using utils::enum_value;
  * - int32 for int's
  * - real32 for float's
  *
- * So no reason to really use boost::any.
+ * So value is int32 or float (bool only comes from rosparam),
+ * XmlRpcValue made only for the rosparam mirror.
  * But feel free to fire an issue if your AP do not like it.
  */
 class Parameter {
@@ -52,20 +64,59 @@ public:
 	using PARAM_SET = mavlink::common::msg::PARAM_SET;
 	using XmlRpcValue = XmlRpc::XmlRpcValue;
 
-	std::string param_id;
-	XmlRpcValue param_value;
+	//! MAVLink param_id, null terminated only if shorter than 16 chars
+	using Id = std::array<char, 16>;
+
+	enum class Type : uint8_t {
+		NONE,
+		BOOL,
+		INT,
+		REAL
+	};
+
+	Id id;
+	Type type;
+	union {
+		int32_t int_value;	//!< BOOL and INT
+		float real_value;	//!< REAL
+	};
 	uint16_t param_index;
 	uint16_t param_count;
 
+	std::string param_id() const
+	{
+		return mavlink::to_string(id);
+	}
+
+	static Id make_id(const std::string &param_id)
+	{
+		Id ret{};
+		mavlink::set_string(ret, param_id);
+		return ret;
+	}
+
+	static inline int compare_id(const Id &a, const Id &b)
+	{
+		return std::strncmp(a.data(), b.data(), a.size());
+	}
+
+	void set_int(int32_t v)
+	{
+		type = Type::INT;
+		int_value = v;
+	}
+
+	void set_real(float v)
+	{
+		type = Type::REAL;
+		real_value = v;
+	}
+
 	void set_value(mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
 		mavlink::mavlink_param_union_t uv;
 		uv.param_float = pmsg.param_value;
 
-		// #170 - copy union value to itermediate var
-		int int_tmp;
-		float float_tmp;
-
 		switch (pmsg.param_type) {
 		// [[[cog:
 		// param_types = [ (s, 'float' if s == 'real32' else s) for s in (
@@ -77,46 +128,38 @@ public:
 		// unsupported_types = ('int64', 'uint64', 'real64')
 		//
 		// for a, b in param_types:
-		//     btype = 'int' if 'int' in b else b
+		//     btype = 'int' if 'int' in b else 'real'
 		//     cog.outl("case enum_value(MT::%s):" % a.upper())
-		//     cog.outl("\t%s_tmp = uv.param_%s;" % (btype, b))
-		//     cog.outl("\tparam_value = %s_tmp;" % btype)
+		//     cog.outl("\tset_%s(uv.param_%s);" % (btype, b))
 		//     cog.outl("\tbreak;")
 		// ]]]
 		case enum_value(MT::INT8):
-			int_tmp = uv.param_int8;
-			param_value = int_tmp;
+			set_int(uv.param_int8);
 			break;
 		case enum_value(MT::UINT8):
-			int_tmp = uv.param_uint8;
-			param_value = int_tmp;
+			set_int(uv.param_uint8);
 			break;
 		case enum_value(MT::INT16):
-			int_tmp = uv.param_int16;
-			param_value = int_tmp;
+			set_int(uv.param_int16);
 			break;
 		case enum_value(MT::UINT16):
-			int_tmp = uv.param_uint16;
-			param_value = int_tmp;
+			set_int(uv.param_uint16);
 			break;
 		case enum_value(MT::INT32):
-			int_tmp = uv.param_int32;
-			param_value = int_tmp;
+			set_int(uv.param_int32);
 			break;
 		case enum_value(MT::UINT32):
-			int_tmp = uv.param_uint32;
-			param_value = int_tmp;
+			set_int(uv.param_uint32);
 			break;
 		case enum_value(MT::REAL32):
-			float_tmp = uv.param_float;
-			param_value = float_tmp;
+			set_real(uv.param_float);
 			break;
-		// [[[end]]] (checksum: 5950e4ee032d4aa198b953f56909e129)
+		// [[[end]]] (checksum: a9de668ff61794b3719b82c39459f9f6)
 
 		default:
 			ROS_WARN_NAMED("param", "PM: Unsupported param %.16s (%u/%u) type: %u",
 					pmsg.param_id.data(), pmsg.param_index, pmsg.param_count, pmsg.param_type);
-			param_value = 0;
+			set_int(0);
 		};
 	}
 
@@ -125,97 +168,132 @@ public:
 	 */
 	void set_value_apm_quirk(mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
-		int32_t int_tmp;
-		float float_tmp;
-
 		switch (pmsg.param_type) {
 		// [[[cog:
 		// for a, b in param_types:
-		//     btype = 'int' if 'int' in b else b
+		//     btype = 'int' if 'int' in b else 'real'
 		//     cog.outl("case enum_value(MT::%s):" % a.upper())
-		//     cog.outl("\t%s_tmp = pmsg.param_value;" % btype)
-		//     cog.outl("\tparam_value = %s_tmp;" % btype)
+		//     cog.outl("\tset_%s(pmsg.param_value);" % btype)
 		//     cog.outl("\tbreak;")
 		// ]]]
 		case enum_value(MT::INT8):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::UINT8):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::INT16):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::UINT16):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::INT32):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::UINT32):
-			int_tmp = pmsg.param_value;
-			param_value = int_tmp;
+			set_int(pmsg.param_value);
 			break;
 		case enum_value(MT::REAL32):
-			float_tmp = pmsg.param_value;
-			param_value = float_tmp;
+			set_real(pmsg.param_value);
 			break;
-		// [[[end]]] (checksum: c30ee34dd84213471690612ab49f1f73)
+		// [[[end]]] (checksum: dd9b40906915db2cd967fd8b4995ff13)
 
 		default:
 			ROS_WARN_NAMED("param", "PM: Unsupported param %.16s (%u/%u) type: %u",
 					pmsg.param_id.data(), pmsg.param_index, pmsg.param_count, pmsg.param_type);
-			param_value = 0;
+			set_int(0);
 		}
 	}
 
-	//! Make PARAM_SET message. Set target ids manually!
-	PARAM_SET to_param_set()
+	/**
+	 * Set value from rosparam
+	 *
+	 * @return false if type not supported
+	 */
+	bool set_value(XmlRpcValue &xml)
 	{
 		// Note: XmlRpcValue does not have const cast operators.
-		//       This method can't be const.
 
+		switch (xml.getType()) {
+		case XmlRpcValue::TypeBoolean:
+			type = Type::BOOL;
+			int_value = static_cast<bool>(xml);
+			return true;
+		case XmlRpcValue::TypeInt:
+			set_int(static_cast<int32_t>(xml));
+			return true;
+		case XmlRpcValue::TypeDouble:
+			set_real(static_cast<double>(xml));
+			return true;
+
+		default:
+			ROS_WARN_NAMED("param", "PR: Unsupported XmlRpcValue type: %u", xml.getType());
+			return false;
+		}
+	}
+
+	//! Set value from service request, according to ParamValue description
+	void set_value(const mavros_msgs::ParamValue &value)
+	{
+		if (value.integer != 0)
+			set_int(value.integer);
+		else if (value.real != 0.0)
+			set_real(value.real);
+		else
+			set_int(0);
+	}
+
+	//! Value for rosparam mirror
+	XmlRpcValue to_xmlrpc() const
+	{
+		switch (type) {
+		case Type::BOOL:	return XmlRpcValue(int_value != 0);
+		case Type::INT:		return XmlRpcValue(int_value);
+		case Type::REAL:	return XmlRpcValue(double(real_value));
+		default:		return XmlRpcValue();
+		}
+	}
+
+	//! Make PARAM_SET message. Set target ids manually!
+	PARAM_SET to_param_set() const
+	{
 		mavlink::mavlink_param_union_t uv;
 		PARAM_SET ret{};
 
-		mavlink::set_string(ret.param_id, param_id);
+		ret.param_id = id;
 
-		switch (param_value.getType()) {
+		switch (type) {
 		// [[[cog:
-		// xmlrpc_types = (
-		//     ('TypeBoolean', 'uint8', 'bool'),
-		//     ('TypeInt', 'int32', 'int32_t'),
-		//     ('TypeDouble', 'real32', 'double'),
+		// value_types = (
+		//     ('BOOL', 'uint8', 'int_value != 0'),
+		//     ('INT', 'int32', 'int_value'),
+		//     ('REAL', 'real32', 'real_value'),
 		// )
 		//
-		// for a, b, c in xmlrpc_types:
+		// for a, b, c in value_types:
 		//     uvb = 'float' if 'real32' == b else b
-		//     cog.outl("case XmlRpcValue::%s:" % a)
-		//     cog.outl("\tuv.param_%s = static_cast<%s>(param_value);" % (uvb, c))
+		//     cog.outl("case Type::%s:" % a)
+		//     cog.outl("\tuv.param_%s = %s;" % (uvb, c))
 		//     cog.outl("\tret.param_type = enum_value(MT::%s);" % b.upper())
 		//     cog.outl("\tbreak;")
 		// ]]]
-		case XmlRpcValue::TypeBoolean:
-			uv.param_uint8 = static_cast<bool>(param_value);
+		case Type::BOOL:
+			uv.param_uint8 = int_value != 0;
 			ret.param_type = enum_value(MT::UINT8);
 			break;
-		case XmlRpcValue::TypeInt:
-			uv.param_int32 = static_cast<int32_t>(param_value);
+		case Type::INT:
+			uv.param_int32 = int_value;
 			ret.param_type = enum_value(MT::INT32);
 			break;
-		case XmlRpcValue::TypeDouble:
-			uv.param_float = static_cast<double>(param_value);
+		case Type::REAL:
+			uv.param_float = real_value;
 			ret.param_type = enum_value(MT::REAL32);
 			break;
-		// [[[end]]] (checksum: c414a3950fba234cbbe694a2576ae022)
+		// [[[end]]] (checksum: 45d9931dd14eb01427d8e80fa0443cc9)
 
 		default:
-			ROS_WARN_NAMED("param", "PR: Unsupported XmlRpcValue type: %u", param_value.getType());
+			ROS_WARN_NAMED("param", "PR: Parameter %.16s has no value", id.data());
 		}
 
 		ret.param_value = uv.param_float;
@@ -223,36 +301,36 @@ public:
 	}
 
 	//! Make PARAM_SET message. Set target ids manually!
-	PARAM_SET to_param_set_apm_qurk()
+	PARAM_SET to_param_set_apm_qurk() const
 	{
 		PARAM_SET ret{};
 
-		mavlink::set_string(ret.param_id, param_id);
+		ret.param_id = id;
 
-		switch (param_value.getType()) {
+		switch (type) {
 		// [[[cog:
-		// for a, b, c in xmlrpc_types:
-		//     cog.outl("case XmlRpcValue::%s:" % a)
-		//     cog.outl("\tret.param_value = static_cast<%s &>(param_value);" % c)
+		// for a, b, c in value_types:
+		//     cog.outl("case Type::%s:" % a)
+		//     cog.outl("\tret.param_value = %s;" % c)
 		//     cog.outl("\tret.param_type = enum_value(MT::%s);" % b.upper())
 		//     cog.outl("\tbreak;")
 		// ]]]
-		case XmlRpcValue::TypeBoolean:
-			ret.param_value = static_cast<bool &>(param_value);
+		case Type::BOOL:
+			ret.param_value = int_value != 0;
 			ret.param_type = enum_value(MT::UINT8);
 			break;
-		case XmlRpcValue::TypeInt:
-			ret.param_value = static_cast<int32_t &>(param_value);
+		case Type::INT:
+			ret.param_value = int_value;
 			ret.param_type = enum_value(MT::INT32);
 			break;
-		case XmlRpcValue::TypeDouble:
-			ret.param_value = static_cast<double &>(param_value);
+		case Type::REAL:
+			ret.param_value = real_value;
 			ret.param_type = enum_value(MT::REAL32);
 			break;
-		// [[[end]]] (checksum: 5b10c0e1f2e916f1c31313eaa5cc83e0)
+		// [[[end]]] (checksum: d92855302105f2ecdcada9d8203c4c5d)
 
 		default:
-			ROS_WARN_NAMED("param", "PR: Unsupported XmlRpcValue type: %u", param_value.getType());
+			ROS_WARN_NAMED("param", "PR: Parameter %.16s has no value", id.data());
 		}
 
 		return ret;
@@ -261,46 +339,52 @@ public:
 	/**
 	 * For get/set services
 	 */
-	int64_t to_integer()
+	int64_t to_integer() const
 	{
-		switch (param_value.getType()) {
-		// [[[cog:
-		// for a, b, c in xmlrpc_types:
-		//    if 'int' not in b:
-		//       continue
-		//    cog.outl("case XmlRpcValue::%s:\treturn static_cast<%s>(param_value);" % (a, c))
-		// ]]]
-		case XmlRpcValue::TypeBoolean:	return static_cast<bool>(param_value);
-		case XmlRpcValue::TypeInt:	return static_cast<int32_t>(param_value);
-		// [[[end]]] (checksum: ce23a3bc04354d8cfcb82341beb83709)
-
-		default:
-			return 0;
-		}
+		return (type == Type::BOOL || type == Type::INT) ? int_value : 0;
 	}
 
-	double to_real()
+	double to_real() const
 	{
-		if (param_value.getType() == XmlRpcValue::TypeDouble)
-			return static_cast<double>(param_value);
-		else
-			return 0.0;
+		return (type == Type::REAL) ? real_value : 0.0;
 	}
 
 	// for debugging
 	std::string to_string() const
 	{
-		return utils::format("%s (%u/%u): %s", param_id.c_str(), param_index, param_count, param_value.toXml().c_str());
+		const auto value = (type == Type::REAL) ?
+				utils::format("%f", real_value) :
+				utils::format("%d", int_value);
+
+		return utils::format("%.16s (%u/%u): %s", id.data(), param_index, param_count, value.c_str());
 	}
 
-	mavros_msgs::Param to_msg()
+	bool same_value(const Parameter &other) const
+	{
+		if (type != other.type)
+			return false;
+
+		return (type == Type::REAL) ? real_value == other.real_value : int_value == other.int_value;
+	}
+
+	void assign_value(const Parameter &other)
+	{
+		if (other.type == Type::REAL)
+			set_real(other.real_value);
+		else {
+			type = other.type;
+			int_value = other.int_value;
+		}
+	}
+
+	mavros_msgs::Param to_msg() const
 	{
 		mavros_msgs::Param msg;
 
 		// XXX(vooon): find better solution
 		msg.header.stamp = ros::Time::now();
 
-		msg.param_id = param_id;
+		msg.param_id = param_id();
 		msg.value.integer = to_integer();
 		msg.value.real = to_real();
 		msg.param_index = param_index;
@@ -328,6 +412,100 @@ public:
 };
 
 
+/**
+ * @brief Parameter list of FCU
+ *
+ * Parameters kept in flat vector in arrival order,
+ * with side indexes by param_index and by name (sorted),
+ * so PARAM_VALUE lookup does not build and hash std::string.
+ *
+ * @note References invalidated by insert() and clear().
+ */
+class ParamStore {
+public:
+	using Id = Parameter::Id;
+	using iterator = std::vector<Parameter>::iterator;
+
+	inline bool empty() const { return items.empty(); }
+	inline size_t size() const { return items.size(); }
+	inline iterator begin() { return items.begin(); }
+	inline iterator end() { return items.end(); }
+	inline const std::vector<Parameter> &list() const { return items; }
+
+	void clear()
+	{
+		items.clear();
+		by_index.clear();
+		by_name.clear();
+	}
+
+	Parameter *find(const Id &id)
+	{
+		auto it = lower_bound(id);
+		if (it != by_name.end() && Parameter::compare_id(it->first, id) == 0)
+			return &items[it->second];
+
+		return nullptr;
+	}
+
+	Parameter *find(const std::string &param_id)
+	{
+		if (param_id.size() > std::tuple_size<Id>::value)
+			return nullptr;
+
+		return find(Parameter::make_id(param_id));
+	}
+
+	//! Lookup for received PARAM_VALUE, index checked first
+	Parameter *find(uint16_t param_index, const Id &id)
+	{
+		if (param_index < by_index.size() && by_index[param_index] != NPOS) {
+			auto &p = items[by_index[param_index]];
+			if (Parameter::compare_id(p.id, id) == 0)
+				return &p;
+		}
+
+		return find(id);
+	}
+
+	//! Add parameter, its id must not be in the store
+	Parameter &insert(const Parameter &p)
+	{
+		const uint32_t pos = items.size();
+		items.push_back(p);
+
+		by_name.emplace(lower_bound(p.id), p.id, pos);
+
+		// _HASH_CHECK and set replies of APM out of list indexes
+		if (p.param_index < p.param_count && p.param_count != UINT16_MAX) {
+			if (by_index.size() <= p.param_index)
+				by_index.resize(p.param_count, NPOS);
+
+			by_index[p.param_index] = pos;
+		}
+
+		return items.back();
+	}
+
+private:
+	static constexpr uint32_t NPOS = UINT32_MAX;
+
+	std::vector<Parameter> items;
+	std::vector<uint32_t> by_index;			//!< param_index -> items position
+	std::vector<std::pair<Id, uint32_t>> by_name;	//!< sorted by id
+
+	std::vector<std::pair<Id, uint32_t>>::iterator lower_bound(const Id &id)
+	{
+		return std::lower_bound(by_name.begin(), by_name.end(), id,
+				[](const std::pair<Id, uint32_t> &a, const Id &b) {
+					return Parameter::compare_id(a.first, b) < 0;
+				});
+	}
+};
+
+constexpr uint32_t ParamStore::NPOS;
+
+
 /**
  * @brief Parameter set transaction data
  */
@@ -336,24 +514,154 @@ public:
 	ParamSetOpt(Parameter &_p, size_t _rem) :
 		param(_p),
 		retries_remaining(_rem),
+		is_acked(false),
 		is_timedout(false)
 	{ }
 
 	Parameter param;
 	size_t retries_remaining;
-	bool is_timedout;
+	bool is_acked;			//!< guarded by cond_mutex
+	bool is_timedout;		//!< guarded by cond_mutex
 	std::mutex cond_mutex;
 	std::condition_variable ack;
 };
 
 
+/**
+ * @brief Parameter list stored on disk
+ *
+ * File is a header followed by fixed size records holding PARAM_VALUE fields,
+ * so list is read by one mmap and decoded the same way as received values.
+ *
+ * List is keyed by hash of FCU parameters (PX4 _HASH_CHECK),
+ * if FCU reports same hash, cached list is valid.
+ */
+class ParamCache {
+public:
+	using PARAM_VALUE = mavlink::common::msg::PARAM_VALUE;
+
+	/**
+	 * @brief Read list file
+	 *
+	 * @return false if file missing or malformed
+	 */
+	static bool load(const std::string &path, uint32_t &hash, std::vector<PARAM_VALUE> &values)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (::fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(Header)) {
+			::close(fd);
+			return false;
+		}
+
+		const size_t size = st.st_size;
+		void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED)
+			return false;
+
+		auto header = static_cast<const Header *>(map);
+		auto records = reinterpret_cast<const Record *>(header + 1);
+		bool valid = header->magic == MAGIC
+			     && header->version == VERSION
+			     && size == sizeof(Header) + header->count * sizeof(Record);
+
+		if (valid) {
+			hash = header->hash;
+			values.clear();
+			values.reserve(header->count);
+
+			for (size_t i = 0; i < header->count; i++) {
+				auto &r = records[i];
+				PARAM_VALUE v{};
+
+				std::copy(std::begin(r.param_id), std::end(r.param_id), v.param_id.begin());
+				v.param_value = r.param_value;
+				v.param_index = r.param_index;
+				v.param_count = r.param_count;
+				v.param_type = r.param_type;
+				values.push_back(v);
+			}
+		}
+
+		::munmap(map, size);
+		return valid;
+	}
+
+	/**
+	 * @brief Write list file
+	 *
+	 * Data written to temporary file which then renamed,
+	 * so reader never see partially written list.
+	 */
+	static bool save(const std::string &path, uint32_t hash, const std::vector<PARAM_VALUE> &values)
+	{
+		std::vector<uint8_t> buf(sizeof(Header) + values.size() * sizeof(Record));
+
+		auto header = reinterpret_cast<Header *>(buf.data());
+		auto records = reinterpret_cast<Record *>(header + 1);
+		*header = Header{MAGIC, VERSION, hash, uint32_t(values.size())};
+
+		for (size_t i = 0; i < values.size(); i++) {
+			auto &v = values[i];
+			auto &r = records[i];
+
+			r = Record{};
+			std::copy(v.param_id.begin(), v.param_id.end(), std::begin(r.param_id));
+			r.param_value = v.param_value;
+			r.param_index = v.param_index;
+			r.param_count = v.param_count;
+			r.param_type = v.param_type;
+		}
+
+		const auto tmp_path = path + ".tmp";
+		int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+
+		bool ok = ::write(fd, buf.data(), buf.size()) == ssize_t(buf.size());
+		ok = ::fsync(fd) == 0 && ok;
+		ok = ::close(fd) == 0 && ok;
+		ok = ok && ::rename(tmp_path.c_str(), path.c_str()) == 0;
+
+		if (!ok)
+			::unlink(tmp_path.c_str());
+
+		return ok;
+	}
+
+private:
+	static constexpr uint32_t MAGIC = 0x4350564d;	//!< "MVPC"
+	static constexpr uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t hash;
+		uint32_t count;
+	};
+
+	struct Record {
+		char param_id[16];
+		float param_value;
+		uint16_t param_index;
+		uint16_t param_count;
+		uint8_t param_type;
+		uint8_t reserved[3];
+	};
+};
+
+
 /**
  * @brief Parameter manipulation plugin
  */
 class ParamPlugin : public plugin::PluginBase {
 public:
 	ParamPlugin() : PluginBase(),
-		param_nh("~param"),
+		param_nh(private_nh("param")),
 		param_count(-1),
 		param_state(PR::IDLE),
 		is_timedout(false),
@@ -361,24 +669,52 @@ public:
 		param_rx_retries(RETRIES_COUNT),
 		BOOTUP_TIME_DT(BOOTUP_TIME_MS / 1000.0),
 		LIST_TIMEOUT_DT(LIST_TIMEOUT_MS / 1000.0),
-		PARAM_TIMEOUT_DT(PARAM_TIMEOUT_MS / 1000.0)
+		PARAM_TIMEOUT_DT(PARAM_TIMEOUT_MS / 1000.0),
+		cache_hash(0),
+		cache_pending(false),
+		mirror_mode(MirrorMode::EACH),
+		parameters_missing_count(0),
+		rx_next_idx(0),
+		rx_window(RX_WINDOW_INIT)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(param_nh);
 
 		pull_srv = param_nh.advertiseService("pull", &ParamPlugin::pull_cb, this);
 		push_srv = param_nh.advertiseService("push", &ParamPlugin::push_cb, this);
 		set_srv = param_nh.advertiseService("set", &ParamPlugin::set_cb, this);
+		set_batch_srv = param_nh.advertiseService("set_batch", &ParamPlugin::set_batch_cb, this);
 		get_srv = param_nh.advertiseService("get", &ParamPlugin::get_cb, this);
 
 		param_value_pub = param_nh.advertise<mavros_msgs::Param>("param_value", 100);
 
-		shedule_timer = param_nh.createTimer(BOOTUP_TIME_DT, &ParamPlugin::shedule_cb, this, true);
-		shedule_timer.stop();
-		timeout_timer = param_nh.createTimer(PARAM_TIMEOUT_DT, &ParamPlugin::timeout_cb, this, true);
-		timeout_timer.stop();
+		// ~param namespace holds FCU parameters only
+		ros::NodeHandle cache_nh(private_nh("param_cache"));
+		cache_nh.param<std::string>("dir", cache_dir, "");
+		if (!cache_dir.empty()) {
+			if (::mkdir(cache_dir.c_str(), 0755) < 0 && errno != EEXIST)
+				ROS_WARN_NAMED("param", "PR: can't create cache dir %s: %s", cache_dir.c_str(), strerror(errno));
+			ROS_INFO_NAMED("param", "PR: parameter cache in %s", cache_dir.c_str());
+		}
+
+		ros::NodeHandle mirror_nh(private_nh("param_mirror"));
+		std::string mirror_mode_str;
+		mirror_nh.param<std::string>("mode", mirror_mode_str, "each");
+		if (mirror_mode_str == "batch")
+			mirror_mode = MirrorMode::BATCH;
+		else if (mirror_mode_str == "dirty")
+			mirror_mode = MirrorMode::DIRTY;
+		else {
+			ROS_WARN_COND_NAMED(mirror_mode_str != "each", "param",
+					"PR: unknown rosparam mirror mode: %s, using each", mirror_mode_str.c_str());
+			mirror_mode = MirrorMode::EACH;
+		}
+
+		make_timer(shedule_timer, BOOTUP_TIME_DT, &ParamPlugin::shedule_cb, true, false);
+		make_timer(timeout_timer, PARAM_TIMEOUT_DT, &ParamPlugin::timeout_cb, true, false);
 		enable_connection_cb();
 	}
 
@@ -399,29 +735,36 @@ private:
 	ros::ServiceServer pull_srv;
 	ros::ServiceServer push_srv;
 	ros::ServiceServer set_srv;
+	ros::ServiceServer set_batch_srv;
 	ros::ServiceServer get_srv;
 
 	ros::Publisher param_value_pub;
 
-	ros::Timer shedule_timer;			//!< for startup shedule fetch
-	ros::Timer timeout_timer;			//!< for timeout resend
+	Timer shedule_timer;			//!< for startup shedule fetch
+	Timer timeout_timer;			//!< for timeout resend
 
 	static constexpr int BOOTUP_TIME_MS = 10000;	//!< APM boot time
 	static constexpr int PARAM_TIMEOUT_MS = 1000;	//!< Param wait time
 	static constexpr int LIST_TIMEOUT_MS = 30000;	//!< Receive all time
 	static constexpr int _RETRIES_COUNT = 3;
+	static constexpr int SET_WINDOW = 8;		//!< batch PARAM_SETs in flight
+	static constexpr int RX_WINDOW_INIT = 4;	//!< missing params requests in flight
+	static constexpr int RX_WINDOW_MAX = 16;
+	static constexpr int RX_RTO_MIN_MS = 50;	//!< request timeout lower bound
 
 	const ros::Duration BOOTUP_TIME_DT;
 	const ros::Duration LIST_TIMEOUT_DT;
 	const ros::Duration PARAM_TIMEOUT_DT;
 	const int RETRIES_COUNT;
 
-	std::unordered_map<std::string, Parameter> parameters;
-	std::list<uint16_t> parameters_missing_idx;
+	ParamStore parameters;
+	std::vector<bool> parameters_missing_idx;	//!< bitset by param_index
+	size_t parameters_missing_count;
 	std::unordered_map<std::string, std::shared_ptr<ParamSetOpt>> set_parameters;
 	ssize_t param_count;
 	enum class PR {
 		IDLE,
+		RXHASH,
 		RXLIST,
 		RXPARAM,
 		RXPARAM_TIMEDOUT,
@@ -430,23 +773,54 @@ private:
 	PR param_state;
 
 	size_t param_rx_retries;
+
+	//! PARAM_REQUEST_READ of missing parameter
+	struct ParamRequest {
+		ros::Time sent;
+		size_t retries_remaining;
+		bool resent;
+	};
+
+	std::unordered_map<uint16_t, ParamRequest> parameters_inflight;
+	size_t rx_next_idx;		//!< next missing index to request
+	double rx_window;		//!< requests in flight, AIMD
+	RttEstimator rx_rtt;
 	bool is_timedout;
 	std::mutex list_cond_mutex;
 	std::condition_variable list_receiving;
 
+	std::string cache_dir;		//!< parameter cache location, empty - disabled
+	uint32_t cache_hash;
+	bool cache_pending;		//!< list complete, save it when hash received
+	std::vector<ParamCache::PARAM_VALUE> cache_values;	//!< list waiting for hash check
+
+	//! How pulled list written to ~param
+	enum class MirrorMode {
+		EACH,		//!< setParam() per parameter
+		BATCH,		//!< one setParam() of whole tree
+		DIRTY		//!< tree first time, then only changed values
+	};
+	MirrorMode mirror_mode;
+	ParamStore mirrored;		//!< values written to ~param, DIRTY mode only
+
 	/* -*- message handlers -*- */
 
 	void handle_param_value(const mavlink::mavlink_message_t *msg, mavlink::common::msg::PARAM_VALUE &pmsg)
 	{
 		lock_guard lock(mutex);
 
-		auto param_id = mavlink::to_string(pmsg.param_id);
+		const bool is_hash = is_hash_check(pmsg.param_id);
+
+		if (param_state == PR::RXHASH && is_hash) {
+			handle_hash_check(pmsg);
+			return;
+		}
 
 		// search
-		auto param_it = parameters.find(param_id);
-		if (param_it != parameters.end()) {
+		Parameter *found = parameters.find(pmsg.param_index, pmsg.param_id);
+		if (found) {
 			// parameter exists
-			auto &p = param_it->second;
+			auto &p = *found;
 
 			if (m_uas->is_ardupilotmega())
 				p.set_value_apm_quirk(pmsg);
@@ -454,9 +828,12 @@ private:
 				p.set_value(pmsg);
 
 			// check that ack required
-			auto set_it = set_parameters.find(param_id);
+			auto set_it = set_parameters.empty() ? set_parameters.end() : set_parameters.find(p.param_id());
 			if (set_it != set_parameters.end()) {
-				set_it->second->ack.notify_all();
+				auto &opt = set_it->second;
+				std::lock_guard<std::mutex> opt_lock(opt->cond_mutex);
+				opt->is_acked = true;
+				opt->ack.notify_all();
 			}
 
 			param_value_pub.publish(p.to_msg());
@@ -472,7 +849,7 @@ private:
 		else {
 			// insert new element
 			Parameter p{};
-			p.param_id = param_id;
+			p.id = pmsg.param_id;
 			p.param_index = pmsg.param_index;
 			p.param_count = pmsg.param_count;
 
@@ -481,13 +858,18 @@ private:
 			else
 				p.set_value(pmsg);
 
-			parameters[param_id] = p;
+			found = &parameters.insert(p);
 
 			param_value_pub.publish(p.to_msg());
 
 			ROS_DEBUG_STREAM_NAMED("param", "PR: New param " << p.to_string());
 		}
 
+		if (cache_pending && is_hash) {
+			cache_pending = false;
+			save_cache(found->to_integer());
+		}
+
 		if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 
 			// we received first param. setup list timeout
@@ -495,54 +877,160 @@ private:
 				param_count = pmsg.param_count;
 				param_state = PR::RXPARAM;
 
-				parameters_missing_idx.clear();
 				if (param_count != UINT16_MAX) {
 					ROS_DEBUG_NAMED("param", "PR: waiting %zu parameters", param_count);
 					// declare that all parameters are missing
-					for (uint16_t idx = 0; idx < param_count; idx++)
-						parameters_missing_idx.push_back(idx);
+					set_all_missing(param_count);
 				}
-				else
+				else {
+					set_all_missing(0);
 					ROS_WARN_NAMED("param", "PR: FCU does not know index for first element! "
 							"Param list may be truncated.");
+				}
 			}
 
-			// trying to avoid endless rerequest loop
-			// Issue #276
-			bool it_is_first_requested = parameters_missing_idx.front() == pmsg.param_index;
-
 			// remove idx for that message
-			parameters_missing_idx.remove(pmsg.param_index);
+			clear_missing(pmsg.param_index);
 
-			// in receiving mode we use param_rx_retries for LIST and PARAM
-			if (it_is_first_requested) {
-				ROS_DEBUG_NAMED("param", "PR: got a value of a requested param idx=%u, "
-						"resetting retries count", pmsg.param_index);
-				param_rx_retries = RETRIES_COUNT;
-			} else if (param_state == PR::RXPARAM_TIMEDOUT) {
-				ROS_INFO_NAMED("param", "PR: got an unsolicited param value idx=%u, "
-						"not resetting retries count %zu", pmsg.param_index, param_rx_retries);
-			}
+			if (param_state == PR::RXPARAM_TIMEDOUT) {
+				auto rq_it = parameters_inflight.find(pmsg.param_index);
+				if (rq_it != parameters_inflight.end()) {
+					// Karn: reply to resent request can't be matched to one of sends
+					if (!rq_it->second.resent)
+						rx_rtt.update((ros::Time::now() - rq_it->second.sent).toSec());
 
-			restart_timeout_timer();
+					rx_window = std::min<double>(RX_WINDOW_MAX, rx_window + 1.0 / rx_window);
+					parameters_inflight.erase(rq_it);
+				}
+				else {
+					ROS_DEBUG_NAMED("param", "PR: got an unsolicited param value idx=%u", pmsg.param_index);
+				}
+			}
 
 			/* index starting from 0, receivig done */
-			if (parameters_missing_idx.empty()) {
-				ssize_t missed = param_count - parameters.size();
-				ROS_INFO_COND_NAMED(missed == 0, "param", "PR: parameters list received");
-				ROS_WARN_COND_NAMED(missed > 0, "param",
-						"PR: parameters list received, but %zd parametars are missed",
-						missed);
-				go_idle();
-				list_receiving.notify_all();
+			if (parameters_missing_count == 0) {
+				list_received();
 			} else if (param_state == PR::RXPARAM_TIMEDOUT) {
-				uint16_t first_miss_idx = parameters_missing_idx.front();
-				ROS_DEBUG_NAMED("param", "PR: requesting next timed out parameter idx=%u", first_miss_idx);
-				param_request_read("", first_miss_idx);
+				fill_request_window();
+				restart_request_timer();
+			}
+			else {
+				restart_timeout_timer();
 			}
 		}
 	}
 
+	void list_received()
+	{
+		ssize_t missed = param_count - parameters.size();
+		ROS_INFO_COND_NAMED(missed == 0, "param", "PR: parameters list received");
+		ROS_WARN_COND_NAMED(missed > 0, "param",
+				"PR: parameters list received, but %zd parametars are missed",
+				missed);
+		if (missed <= 0)
+			cache_list();
+		go_idle();
+		list_receiving.notify_all();
+	}
+
+	/* -*- missing parameters requests -*- */
+
+	void set_all_missing(size_t count)
+	{
+		parameters_missing_idx.assign(count, true);
+		parameters_missing_count = count;
+		parameters_inflight.clear();
+	}
+
+	//! @return true if index was missing
+	bool clear_missing(uint16_t idx)
+	{
+		if (idx >= parameters_missing_idx.size() || !parameters_missing_idx[idx])
+			return false;
+
+		parameters_missing_idx[idx] = false;
+		parameters_missing_count--;
+		return true;
+	}
+
+	//! Request timeout, PARAM_TIMEOUT_DT until first RTT sample
+	ros::Duration request_timeout()
+	{
+		return ros::Duration(rx_rtt.timeout(RX_RTO_MIN_MS / 1000.0, PARAM_TIMEOUT_DT.toSec()));
+	}
+
+	//! Keep up to rx_window PARAM_REQUEST_READs in flight
+	void fill_request_window()
+	{
+		const auto now = ros::Time::now();
+
+		while (parameters_inflight.size() < size_t(rx_window)
+				&& rx_next_idx < parameters_missing_idx.size()) {
+			const uint16_t idx = rx_next_idx++;
+			if (!parameters_missing_idx[idx])
+				continue;
+
+			parameters_inflight[idx] = ParamRequest{now, size_t(RETRIES_COUNT), false};
+			param_request_read("", idx);
+		}
+	}
+
+	//! Resend timed out requests, drop ones out of retries
+	void expire_requests()
+	{
+		const auto now = ros::Time::now();
+		const auto rto = request_timeout();
+		bool lost = false;
+
+		for (auto it = parameters_inflight.begin(); it != parameters_inflight.end(); ) {
+			auto &rq = it->second;
+			if (now - rq.sent < rto) {
+				++it;
+				continue;
+			}
+
+			lost = true;
+			if (rq.retries_remaining > 0) {
+				rq.retries_remaining--;
+				rq.sent = now;
+				rq.resent = true;
+
+				ROS_WARN_NAMED("param", "PR: request param #%u timeout, retries left %zu, and %zu params still missing",
+						it->first, rq.retries_remaining, parameters_missing_count);
+				param_request_read("", it->first);
+				++it;
+			}
+			else {
+				ROS_ERROR_NAMED("param", "PR: request param #%u completely missing.", it->first);
+				clear_missing(it->first);
+				it = parameters_inflight.erase(it);
+			}
+		}
+
+		// multiplicative decrease, once per timeout
+		if (lost) {
+			rx_window = std::max(1.0, rx_window / 2);
+			ROS_DEBUG_NAMED("param", "PR: request window %.1f, rto %.3f s", rx_window, rto.toSec());
+		}
+	}
+
+	//! Timer to earliest deadline of requests in flight
+	void restart_request_timer()
+	{
+		if (parameters_inflight.empty()) {
+			restart_timeout_timer();
+			return;
+		}
+
+		ros::Time oldest = parameters_inflight.begin()->second.sent;
+		for (auto &kv : parameters_inflight)
+			oldest = std::min(oldest, kv.second.sent);
+
+		const ros::Duration min_dt(RX_RTO_MIN_MS / 1000.0);
+		const auto dt = oldest + request_timeout() - ros::Time::now();
+		restart_timeout_timer(std::max(min_dt, dt));
+	}
+
 	/* -*- low-level send function -*- */
 
 	void param_request_list()
@@ -565,7 +1053,8 @@ private:
 		m_uas->msg_set_target(rqr);
 		rqr.param_index = index;
 
-		if (index != -1) {
+		// param_id used only for read by name
+		if (index == -1) {
 			mavlink::set_string(rqr.param_id, id);
 		}
 
@@ -605,7 +1094,7 @@ private:
 	void shedule_pull(const ros::Duration &dt)
 	{
 		shedule_timer.stop();
-		shedule_timer.setPeriod(dt);
+		shedule_timer.setPeriod(dt.toSec());
 		shedule_timer.start();
 	}
 
@@ -616,9 +1105,19 @@ private:
 			// try later
 			ROS_DEBUG_NAMED("param", "PR: busy, reshedule pull");
 			shedule_pull(BOOTUP_TIME_DT);
+			return;
 		}
 
+		if (start_hash_check())
+			return;
+
 		ROS_DEBUG_NAMED("param", "PR: start sheduled pull");
+		start_list_pull();
+	}
+
+	void start_list_pull()
+	{
+		cache_pending = false;
 		param_state = PR::RXLIST;
 		param_rx_retries = RETRIES_COUNT;
 		parameters.clear();
@@ -627,10 +1126,141 @@ private:
 		param_request_list();
 	}
 
+	//! Cache file of current FCU, empty if cache not usable
+	std::string cache_path()
+	{
+		if (cache_dir.empty() || !m_uas->is_px4())
+			return "";
+
+		return utils::format("%s/params_%u_%u.bin", cache_dir.c_str(),
+				m_uas->get_tgt_system(), m_uas->get_tgt_component());
+	}
+
+	/**
+	 * @brief Request PX4 parameters hash if cached list exist
+	 *
+	 * @return false if list should be pulled
+	 */
+	bool start_hash_check()
+	{
+		auto path = cache_path();
+		if (path.empty())
+			return false;
+
+		if (!ParamCache::load(path, cache_hash, cache_values)) {
+			ROS_INFO_NAMED("param", "PR: no parameter cache %s", path.c_str());
+			return false;
+		}
+
+		ROS_DEBUG_NAMED("param", "PR: check cached list hash 0x%08x", cache_hash);
+		param_state = PR::RXHASH;
+		param_rx_retries = RETRIES_COUNT;
+
+		restart_timeout_timer();
+		param_request_read("_HASH_CHECK");
+		return true;
+	}
+
+	void handle_hash_check(mavlink::common::msg::PARAM_VALUE &pmsg)
+	{
+		mavlink::mavlink_param_union_t uv;
+		uv.param_float = pmsg.param_value;
+
+		if (uv.param_uint32 != cache_hash) {
+			ROS_INFO_NAMED("param", "PR: FCU parameters changed (hash 0x%08x, cached 0x%08x), pull list",
+					uv.param_uint32, cache_hash);
+			cache_values.clear();
+			start_list_pull();
+			return;
+		}
+
+		parameters.clear();
+		for (auto &v : cache_values) {
+			Parameter p{};
+			p.id = v.param_id;
+			p.param_index = v.param_index;
+			p.param_count = v.param_count;
+			p.set_value(v);
+
+			param_value_pub.publish(p.to_msg());
+			parameters.insert(p);
+		}
+
+		param_count = parameters.size();
+		cache_values.clear();
+
+		ROS_INFO_NAMED("param", "PR: parameters list loaded from cache (hash 0x%08x, %zu params)",
+				cache_hash, parameters.size());
+		go_idle();
+		list_receiving.notify_all();
+	}
+
+	/**
+	 * @brief Store complete list
+	 *
+	 * PX4 sends _HASH_CHECK after last parameter of list (it is not counted in param_count),
+	 * so most likely list saved when it arrives.
+	 */
+	void cache_list()
+	{
+		if (cache_path().empty())
+			return;
+
+		auto hash = parameters.find("_HASH_CHECK");
+		if (hash) {
+			save_cache(hash->to_integer());
+			return;
+		}
+
+		ROS_DEBUG_NAMED("param", "PR: wait _HASH_CHECK to cache list");
+		cache_pending = true;
+		param_request_read("_HASH_CHECK");
+	}
+
+	void save_cache(uint32_t hash)
+	{
+		auto path = cache_path();
+		if (path.empty())
+			return;
+
+		std::vector<ParamCache::PARAM_VALUE> values;
+		values.reserve(parameters.size());
+		for (auto &p : parameters) {
+			auto ps = p.to_param_set();
+
+			ParamCache::PARAM_VALUE v{};
+			v.param_id = ps.param_id;
+			v.param_value = ps.param_value;
+			v.param_type = ps.param_type;
+			v.param_index = p.param_index;
+			v.param_count = p.param_count;
+			values.push_back(v);
+		}
+
+		if (ParamCache::save(path, hash, values))
+			ROS_INFO_NAMED("param", "PR: parameters list cached to %s (hash 0x%08x)", path.c_str(), hash);
+		else
+			ROS_WARN_NAMED("param", "PR: failed to write parameter cache %s: %s", path.c_str(), strerror(errno));
+	}
+
 	void timeout_cb(const ros::TimerEvent &event)
 	{
 		lock_guard lock(mutex);
-		if (param_state == PR::RXLIST && param_rx_retries > 0) {
+		if (param_state == PR::RXHASH) {
+			if (param_rx_retries > 0) {
+				param_rx_retries--;
+				ROS_WARN_NAMED("param", "PR: _HASH_CHECK timeout, retries left %zu", param_rx_retries);
+
+				restart_timeout_timer();
+				param_request_read("_HASH_CHECK");
+			}
+			else {
+				ROS_WARN_NAMED("param", "PR: FCU does not report _HASH_CHECK, pull list");
+				cache_values.clear();
+				start_list_pull();
+			}
+		}
+		else if (param_state == PR::RXLIST && param_rx_retries > 0) {
 			param_rx_retries--;
 			ROS_WARN_NAMED("param", "PR: request list timeout, retries left %zu", param_rx_retries);
 
@@ -638,7 +1268,7 @@ private:
 			param_request_list();
 		}
 		else if (param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
-			if (parameters_missing_idx.empty()) {
+			if (parameters_missing_count == 0) {
 				ROS_WARN_NAMED("param", "PR: missing list is clear, but we in RXPARAM state, "
 						"maybe last rerequest fails. Params missed: %zd",
 						param_count - parameters.size());
@@ -647,51 +1277,58 @@ private:
 				return;
 			}
 
-			param_state = PR::RXPARAM_TIMEDOUT;
-			uint16_t first_miss_idx = parameters_missing_idx.front();
-			if (param_rx_retries > 0) {
-				param_rx_retries--;
-				ROS_WARN_NAMED("param", "PR: request param #%u timeout, retries left %zu, and %zu params still missing",
-						first_miss_idx, param_rx_retries, parameters_missing_idx.size());
-				restart_timeout_timer();
-				param_request_read("", first_miss_idx);
+			if (param_state == PR::RXPARAM) {
+				ROS_WARN_NAMED("param", "PR: list timeout, requesting %zu missing params", parameters_missing_count);
+				param_state = PR::RXPARAM_TIMEDOUT;
+				parameters_inflight.clear();
+				rx_next_idx = 0;
+				rx_window = RX_WINDOW_INIT;
 			}
 			else {
-				ROS_ERROR_NAMED("param", "PR: request param #%u completely missing.", first_miss_idx);
-				parameters_missing_idx.pop_front();
-				restart_timeout_timer();
-				if (!parameters_missing_idx.empty()) {
-					param_rx_retries = RETRIES_COUNT;
-					first_miss_idx = parameters_missing_idx.front();
+				expire_requests();
+			}
 
-					ROS_WARN_NAMED("param", "PR: %zu params still missing, trying to request next: #%u",
-							parameters_missing_idx.size(), first_miss_idx);
-					param_request_read("", first_miss_idx);
-				}
+			if (parameters_missing_count == 0) {
+				list_received();
+				return;
 			}
+
+			fill_request_window();
+			restart_request_timer();
 		}
 		else if (param_state == PR::TXPARAM) {
-			auto it = set_parameters.begin();
-			if (it == set_parameters.end()) {
+			if (set_parameters.empty()) {
 				ROS_DEBUG_NAMED("param", "PR: send list empty, but state TXPARAM");
 				go_idle();
 				return;
 			}
 
-			if (it->second->retries_remaining > 0) {
-				it->second->retries_remaining--;
-				ROS_WARN_NAMED("param", "PR: Resend param set for %s, retries left %zu",
-						it->second->param.param_id.c_str(),
-						it->second->retries_remaining);
-				restart_timeout_timer();
-				param_set(it->second->param);
-			}
-			else {
-				ROS_ERROR_NAMED("param", "PR: Param set for %s timed out.",
-						it->second->param.param_id.c_str());
-				it->second->is_timedout = true;
-				it->second->ack.notify_all();
+			// batch may have several sets in flight
+			bool resent = false;
+			for (auto &kv : set_parameters) {
+				auto &opt = kv.second;
+				std::lock_guard<std::mutex> opt_lock(opt->cond_mutex);
+				if (opt->is_acked || opt->is_timedout)
+					continue;
+
+				if (opt->retries_remaining > 0) {
+					opt->retries_remaining--;
+					ROS_WARN_NAMED("param", "PR: Resend param set for %s, retries left %zu",
+							opt->param.param_id().c_str(),
+							opt->retries_remaining);
+					param_set(opt->param);
+					resent = true;
+				}
+				else {
+					ROS_ERROR_NAMED("param", "PR: Param set for %s timed out.",
+							opt->param.param_id().c_str());
+					opt->is_timedout = true;
+					opt->ack.notify_all();
+				}
 			}
+
+			if (resent)
+				restart_timeout_timer();
 		}
 		else {
 			ROS_DEBUG_NAMED("param", "PR: timeout in IDLE!");
@@ -699,9 +1336,15 @@ private:
 	}
 
 	void restart_timeout_timer()
+	{
+		restart_timeout_timer(PARAM_TIMEOUT_DT);
+	}
+
+	void restart_timeout_timer(const ros::Duration &dt)
 	{
 		is_timedout = false;
 		timeout_timer.stop();
+		timeout_timer.setPeriod(dt.toSec());
 		timeout_timer.start();
 	}
 
@@ -724,9 +1367,11 @@ private:
 	{
 		std::unique_lock<std::mutex> lock(opt->cond_mutex);
 
-		return opt->ack.wait_for(lock, std::chrono::nanoseconds(PARAM_TIMEOUT_DT.toNSec()) * (RETRIES_COUNT + 2))
-		       == std::cv_status::no_timeout
-		       && !opt->is_timedout;
+		// ack may come before wait, e.g. for later sets of a batch
+		opt->ack.wait_for(lock, std::chrono::nanoseconds(PARAM_TIMEOUT_DT.toNSec()) * (RETRIES_COUNT + 2),
+				[&opt]() { return opt->is_acked || opt->is_timedout; });
+
+		return opt->is_acked;
 	}
 
 	bool send_param_set_and_wait(Parameter &param)
@@ -735,7 +1380,7 @@ private:
 
 		// add to waiting list
 		auto opt = std::make_shared<ParamSetOpt>(param, RETRIES_COUNT);
-		set_parameters[param.param_id] = opt;
+		set_parameters[param.param_id()] = opt;
 
 		param_state = PR::TXPARAM;
 		restart_timeout_timer();
@@ -746,25 +1391,112 @@ private:
 		lock.lock();
 
 		// free opt data
-		set_parameters.erase(param.param_id);
+		set_parameters.erase(param.param_id());
 
-		go_idle();
+		if (set_parameters.empty())
+			go_idle();
 		return is_not_timeout;
 	}
 
+	static bool is_hash_check(const Parameter::Id &id)
+	{
+		static const auto HASH_CHECK_ID = Parameter::make_id("_HASH_CHECK");
+		return Parameter::compare_id(id, HASH_CHECK_ID) == 0;
+	}
+
+	bool rosparam_allowed(const Parameter &p)
+	{
+		if (m_uas->is_px4() && is_hash_check(p.id)) {
+			ROS_INFO_NAMED("param", "PR: PX4 parameter _HASH_CHECK ignored: 0x%8x", p.int_value);
+			return false;
+		}
+
+		return true;
+	}
+
 	//! Set ROS param only if name is good
 	bool rosparam_set_allowed(const Parameter &p)
 	{
-		if (m_uas->is_px4() && p.param_id == "_HASH_CHECK") {
-			auto v = p.param_value;	// const XmlRpcValue can't cast
-			ROS_INFO_NAMED("param", "PR: PX4 parameter _HASH_CHECK ignored: 0x%8x", static_cast<int32_t>(v));
+		if (!rosparam_allowed(p))
 			return false;
+
+		param_nh.setParam(p.param_id(), p.to_xmlrpc());
+
+		if (mirror_mode == MirrorMode::DIRTY) {
+			lock_guard lock(mutex);
+			auto m = mirrored.find(p.id);
+			if (m)
+				m->assign_value(p);
+			else
+				mirrored.insert(p);
 		}
 
-		param_nh.setParam(p.param_id, p.param_value);
 		return true;
 	}
 
+	/**
+	 * @brief Write parameter list to ~param
+	 *
+	 * Call without lock held: setParam() is XML-RPC call to master.
+	 *
+	 * @return number of parameters written
+	 */
+	size_t mirror_rosparams(const std::vector<Parameter> &list)
+	{
+		if (mirror_mode == MirrorMode::EACH) {
+			size_t count = 0;
+			for (auto &p : list)
+				count += rosparam_set_allowed(p);
+
+			return count;
+		}
+
+		unique_lock lock(mutex);
+		if (mirror_mode == MirrorMode::DIRTY && !mirrored.empty()) {
+			std::vector<Parameter> changed;
+			for (auto &p : list) {
+				auto m = mirrored.find(p.id);
+				if (!m || !m->same_value(p))
+					changed.push_back(p);
+			}
+			lock.unlock();
+
+			ROS_DEBUG_NAMED("param", "PR: %zu of %zu rosparams changed", changed.size(), list.size());
+			size_t count = 0;
+			for (auto &p : changed)
+				count += rosparam_set_allowed(p);
+
+			return count;
+		}
+		lock.unlock();
+
+		XmlRpc::XmlRpcValue tree;
+		std::vector<Parameter> written;
+		written.reserve(list.size());
+		for (auto &p : list) {
+			if (!rosparam_allowed(p))
+				continue;
+
+			tree[p.param_id()] = p.to_xmlrpc();
+			written.push_back(p);
+		}
+
+		if (written.empty())
+			return 0;
+
+		// ~param holds FCU parameters only, whole tree replaced
+		param_nh.setParam("", tree);
+
+		if (mirror_mode == MirrorMode::DIRTY) {
+			lock.lock();
+			mirrored.clear();
+			for (auto &p : written)
+				mirrored.insert(p);
+		}
+
+		return written.size();
+	}
+
 	/* -*- ROS callbacks -*- */
 
 	/**
@@ -783,18 +1515,13 @@ private:
 			else
 				ROS_INFO_NAMED("param", "PR: start force pull");
 
-			param_state = PR::RXLIST;
-			param_rx_retries = RETRIES_COUNT;
-			parameters.clear();
-
 			shedule_timer.stop();
-			restart_timeout_timer();
-			param_request_list();
+			start_list_pull();
 
 			lock.unlock();
 			res.success = wait_fetch_all();
 		}
-		else if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+		else if (param_state == PR::RXHASH || param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 			lock.unlock();
 			res.success = wait_fetch_all();
 		}
@@ -806,12 +1533,11 @@ private:
 		lock.lock();
 		res.param_received = parameters.size();
 
-		for (auto &p : parameters) {
-			lock.unlock();
-			rosparam_set_allowed(p.second);
-			lock.lock();
-		}
+		// store may change while rosparams are set
+		auto list = parameters.list();
+		lock.unlock();
 
+		mirror_rosparams(list);
 		return true;
 	}
 
@@ -836,13 +1562,13 @@ private:
 			}
 
 			unique_lock lock(mutex);
-			auto param_it = parameters.find(param.first);
-			if (param_it != parameters.end()) {
+			auto found = parameters.find(param.first);
+			if (found) {
 				// copy current state of Parameter
-				auto to_send = param_it->second;
+				auto to_send = *found;
 
-				// Update XmlRpcValue
-				to_send.param_value = param.second;
+				if (!to_send.set_value(param.second))
+					continue;
 
 				lock.unlock();
 				bool set_res = send_param_set_and_wait(to_send);
@@ -871,32 +1597,30 @@ private:
 	{
 		unique_lock lock(mutex);
 
-		if (param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+		if (param_state == PR::RXHASH || param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
 			ROS_ERROR_NAMED("param", "PR: receiving not complete");
 			return false;
 		}
 
-		auto param_it = parameters.find(req.param_id);
-		if (param_it != parameters.end()) {
-			auto to_send = param_it->second;
-
-			// according to ParamValue description
-			if (req.value.integer != 0)
-				to_send.param_value = static_cast<int>(req.value.integer);
-			else if (req.value.real != 0.0)
-				to_send.param_value = req.value.real;
-			else
-				to_send.param_value = 0;
+		auto found = parameters.find(req.param_id);
+		if (found) {
+			auto to_send = *found;
+			to_send.set_value(req.value);
 
 			lock.unlock();
 			res.success = send_param_set_and_wait(to_send);
 			lock.lock();
 
-			res.value.integer = param_it->second.to_integer();
-			res.value.real = param_it->second.to_real();
+			// store may grow while unlocked, find again
+			found = parameters.find(req.param_id);
+			if (found)
+				to_send = *found;
+
+			res.value.integer = to_send.to_integer();
+			res.value.real = to_send.to_real();
 
 			lock.unlock();
-			rosparam_set_allowed(param_it->second);
+			rosparam_set_allowed(to_send);
 		}
 		else {
 			ROS_ERROR_STREAM_NAMED("param", "PR: Unknown parameter to set: " << req.param_id);
@@ -906,6 +1630,110 @@ private:
 		return true;
 	}
 
+	/**
+	 * @brief sets many parameters
+	 * @service ~param/set_batch
+	 *
+	 * Up to SET_WINDOW PARAM_SETs are in flight,
+	 * result of each parameter returned in request order.
+	 */
+	bool set_batch_cb(mavros_msgs::ParamSetBatch::Request &req,
+			mavros_msgs::ParamSetBatch::Response &res)
+	{
+		unique_lock lock(mutex);
+
+		if (param_state == PR::RXHASH || param_state == PR::RXLIST || param_state == PR::RXPARAM || param_state == PR::RXPARAM_TIMEDOUT) {
+			ROS_ERROR_NAMED("param", "PR: receiving not complete");
+			return false;
+		}
+
+		if (req.param_id.size() != req.value.size()) {
+			ROS_ERROR_NAMED("param", "PR: set_batch: %zu param_id for %zu values",
+					req.param_id.size(), req.value.size());
+			return false;
+		}
+
+		const size_t count = req.param_id.size();
+		res.success = false;
+		res.results.assign(count, false);
+		res.value.resize(count);
+
+		struct InFlight {
+			size_t idx;
+			std::shared_ptr<ParamSetOpt> opt;
+		};
+
+		std::deque<InFlight> inflight;
+		std::vector<Parameter> acked;
+		size_t next = 0;
+
+		while (next < count || !inflight.empty()) {
+			while (next < count && inflight.size() < size_t(SET_WINDOW)) {
+				const auto &param_id = req.param_id[next];
+
+				// set_parameters keyed by id: same id sent after previous one done
+				if (set_parameters.find(param_id) != set_parameters.end()) {
+					if (!inflight.empty())
+						break;
+
+					ROS_ERROR_STREAM_NAMED("param", "PR: Parameter already being set: " << param_id);
+					next++;
+					continue;
+				}
+
+				const size_t idx = next++;
+				auto found = parameters.find(param_id);
+				if (!found) {
+					ROS_ERROR_STREAM_NAMED("param", "PR: Unknown parameter to set: " << param_id);
+					continue;
+				}
+
+				auto to_send = *found;
+				to_send.set_value(req.value[idx]);
+
+				auto opt = std::make_shared<ParamSetOpt>(to_send, RETRIES_COUNT);
+				set_parameters[param_id] = opt;
+				inflight.push_back({idx, opt});
+
+				param_state = PR::TXPARAM;
+				restart_timeout_timer();
+				param_set(to_send);
+			}
+
+			if (inflight.empty())
+				continue;
+
+			auto head = inflight.front();
+			inflight.pop_front();
+
+			lock.unlock();
+			bool is_not_timeout = wait_param_set_ack_for(head.opt);
+			lock.lock();
+
+			const auto param_id = head.opt->param.param_id();
+			set_parameters.erase(param_id);
+
+			auto found = parameters.find(param_id);
+			auto &p = found ? *found : head.opt->param;
+			res.results[head.idx] = is_not_timeout;
+			res.value[head.idx].integer = p.to_integer();
+			res.value[head.idx].real = p.to_real();
+			if (is_not_timeout)
+				acked.push_back(p);
+		}
+
+		if (set_parameters.empty())
+			go_idle();
+		lock.unlock();
+
+		for (auto &p : acked)
+			rosparam_set_allowed(p);
+
+		ROS_INFO_NAMED("param", "PR: batch set %zu of %zu parameters", acked.size(), count);
+		res.success = acked.size() == count;
+		return true;
+	}
+
 	/**
 	 * @brief get parameter
 	 * @service ~param/get
@@ -915,12 +1743,12 @@ private:
 	{
 		lock_guard lock(mutex);
 
-		auto param_it = parameters.find(req.param_id);
-		if (param_it != parameters.end()) {
+		auto found = parameters.find(req.param_id);
+		if (found) {
 			res.success = true;
 
-			res.value.integer = param_it->second.to_integer();
-			res.value.real = param_it->second.to_real();
+			res.value.integer = found->to_integer();
+			res.value.real = found->to_real();
 		}
 		else {
 			ROS_ERROR_STREAM_NAMED("param", "PR: Unknown parameter to get: " << req.param_id);
@@ -933,5 +1761,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::ParamPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::ParamPlugin)
@@ -24,24 +24,56 @@ namespace mavros {
 namespace std_plugins {
 /**
  * @brief RC IO plugin
+ *
+ * With change_only ~rc/in and ~rc/out published only when some channel moved
+ * more than deadband since last published message, or heartbeat period passed.
+ * With out_coalesce SERVO_OUTPUT_RAW ports of one cycle merged to one RCOut.
+ *
+ * With override/rate ~rc/override only stores latest channels, timer streams them
+ * at fixed rate and releases override if no input for override/timeout.
  */
 class RCIOPlugin : public plugin::PluginBase {
 public:
 	RCIOPlugin() : PluginBase(),
-		rc_nh("~rc"),
-		raw_rc_in(0),
-		raw_rc_out(0),
-		has_rc_channels_msg(false)
-	{ }
+		rc_nh(private_nh("rc")),
+		rc_in_count(0),
+		rc_out_count(0),
+		has_rc_channels_msg(false),
+		change_only(false),
+		deadband(0),
+		out_coalesce(false),
+		out_ports(0),
+		out_max_port(0),
+		override_active(false)
+	{
+		// channels of port not received yet are published as 0
+		raw_rc_in.fill(0);
+		raw_rc_out.fill(0);
+	}
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(rc_nh);
+
+		double heartbeat_rate;
+		rc_nh.param("change_only", change_only, false);
+		rc_nh.param("deadband", deadband, 0);
+		rc_nh.param("heartbeat_rate", heartbeat_rate, 1.0);
+		rc_nh.param("out_coalesce", out_coalesce, false);
+		heartbeat = (heartbeat_rate > 0.0) ? ros::Duration(1.0 / heartbeat_rate) : ros::Duration(0);
 
-		rc_in_pub = rc_nh.advertise<mavros_msgs::RCIn>("in", 10);
-		rc_out_pub = rc_nh.advertise<mavros_msgs::RCOut>("out", 10);
+		rc_in_pub.advertise<mavros_msgs::RCIn>(rc_nh, "in", 10);
+		rc_out_pub.advertise<mavros_msgs::RCOut>(rc_nh, "out", 10);
 		override_sub = rc_nh.subscribe("override", 10, &RCIOPlugin::override_cb, this);
 
+		double override_rate, override_timeout;
+		rc_nh.param("override/rate", override_rate, 0.0);
+		rc_nh.param("override/timeout", override_timeout, 0.5);
+		override_release_timeout = ros::Duration(override_timeout);
+		if (override_rate > 0.0)
+			make_timer(override_timer, ros::Duration(1.0 / override_rate), &RCIOPlugin::override_timer_cb);
+
 		enable_connection_cb();
 	};
 
@@ -58,12 +90,72 @@ private:
 	std::mutex mutex;
 	ros::NodeHandle rc_nh;
 
-	std::vector<uint16_t> raw_rc_in;
-	std::vector<uint16_t> raw_rc_out;
+	//! RC_CHANNELS has 18, RC_CHANNELS_RAW ports 0..3
+	static constexpr size_t MAX_RC_IN = 32;
+	//! SERVO_OUTPUT_RAW ports 0..1 of 16 channels (0..3 of 8 on v1.0)
+	static constexpr size_t MAX_RC_OUT = 32;
+
+	/**
+	 * @brief Decides if channels state should be published
+	 *
+	 * Keeps copy of last published state, so slow drift below deadband
+	 * per message still publishes once accumulated.
+	 */
+	template<size_t N>
+	struct ChangeFilter {
+		std::array<uint16_t, N> sent;
+		size_t sent_count = 0;
+		ros::Time sent_time;
+
+		void clear() {
+			sent_count = 0;
+			sent_time = ros::Time();
+		}
+
+		bool update(const std::array<uint16_t, N> &raw, size_t count, int deadband, const ros::Duration &heartbeat)
+		{
+			const ros::Time now = ros::Time::now();
+
+			bool changed = count != sent_count;
+			for (size_t i = 0; !changed && i < count; i++)
+				changed = std::abs(int(raw[i]) - int(sent[i])) > deadband;
+
+			if (!changed && (heartbeat.isZero() || now - sent_time < heartbeat))
+				return false;
+
+			std::copy(raw.begin(), raw.begin() + count, sent.begin());
+			sent_count = count;
+			sent_time = now;
+			return true;
+		}
+	};
+
+	std::array<uint16_t, MAX_RC_IN> raw_rc_in;
+	std::array<uint16_t, MAX_RC_OUT> raw_rc_out;
+	size_t rc_in_count;
+	size_t rc_out_count;
 	std::atomic<bool> has_rc_channels_msg;
 
-	ros::Publisher rc_in_pub;
-	ros::Publisher rc_out_pub;
+	bool change_only;
+	int deadband;			//!< channel change not published [us]
+	ros::Duration heartbeat;	//!< publish period of unchanged state in change_only mode
+	ChangeFilter<MAX_RC_IN> rc_in_filter;
+	ChangeFilter<MAX_RC_OUT> rc_out_filter;
+
+	bool out_coalesce;
+	uint32_t out_ports;		//!< SERVO_OUTPUT_RAW ports received in current cycle
+	uint8_t out_max_port;		//!< highest port seen, ends cycle
+	ros::Time out_stamp;
+
+	//! Override streaming, latest wins
+	Timer override_timer;
+	ros::Duration override_release_timeout;
+	mavros_msgs::OverrideRCIn::_channels_type override_channels;
+	ros::Time override_last_rx;
+	bool override_active;
+
+	plugin::LazyPublisher rc_in_pub;
+	plugin::LazyPublisher rc_out_pub;
 	ros::Subscriber override_sub;
 
 	/* -*- rx handlers -*- */
@@ -77,8 +169,12 @@ private:
 		lock_guard lock(mutex);
 
 		size_t offset = port.port * 8;
-		if (raw_rc_in.size() < offset + 8)
-			raw_rc_in.resize(offset + 8);
+		if (offset + 8 > MAX_RC_IN) {
+			ROS_WARN_THROTTLE_NAMED(60, "rc", "RC_CHANNELS_RAW port %u ignored, %zu channels max", port.port, MAX_RC_IN);
+			return;
+		}
+
+		rc_in_count = std::max(rc_in_count, offset + 8);
 
 		// [[[cog:
 		// import cog
@@ -95,13 +191,7 @@ private:
 		raw_rc_in[offset + 7] = port.chan8_raw;
 		// [[[end]]] (checksum: fcb14b1ddfff9ce7dd02f5bd03825cff)
 
-		auto rcin_msg = boost::make_shared<mavros_msgs::RCIn>();
-
-		rcin_msg->header.stamp = m_uas->synchronise_stamp(port.time_boot_ms);
-		rcin_msg->rssi = port.rssi;
-		rcin_msg->channels = raw_rc_in;
-
-		rc_in_pub.publish(rcin_msg);
+		publish_rc_in(m_uas->synchronise_stamp(port.time_boot_ms), port.rssi);
 	}
 
 	void handle_rc_channels(const mavlink::mavlink_message_t *msg, mavlink::common::msg::RC_CHANNELS &channels)
@@ -112,18 +202,20 @@ private:
 		ROS_INFO_COND_NAMED(!has_rc_channels_msg, "rc", "RC_CHANNELS message detected!");
 		has_rc_channels_msg = true;
 
-		if (channels.chancount > MAX_CHANCNT) {
+		// note: decoded message shared with other handlers, do not modify it
+		size_t chancount = channels.chancount;
+		if (chancount > MAX_CHANCNT) {
 			ROS_WARN_THROTTLE_NAMED(60, "rc",
 						"FCU receives %u RC channels, but RC_CHANNELS can store %zu",
 						channels.chancount, MAX_CHANCNT);
 
-			channels.chancount = MAX_CHANCNT;
+			chancount = MAX_CHANCNT;
 		}
 
-		raw_rc_in.resize(channels.chancount);
+		rc_in_count = chancount;
 
 		// switch works as start point selector.
-		switch (channels.chancount) {
+		switch (chancount) {
 		// [[[cog:
 		// for i in range(18, 0, -1):
 		//     cog.outl("case %2d: raw_rc_in[%2d] = channels.chan%d_raw;" % (i, i - 1, i))
@@ -150,13 +242,7 @@ private:
 		case  0: break;
 		}
 
-		auto rcin_msg = boost::make_shared<mavros_msgs::RCIn>();
-
-		rcin_msg->header.stamp = m_uas->synchronise_stamp(channels.time_boot_ms);
-		rcin_msg->rssi = channels.rssi;
-		rcin_msg->channels = raw_rc_in;
-
-		rc_in_pub.publish(rcin_msg);
+		publish_rc_in(m_uas->synchronise_stamp(channels.time_boot_ms), channels.rssi);
 	}
 
 	void handle_servo_output_raw(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SERVO_OUTPUT_RAW &port)
@@ -173,8 +259,19 @@ private:
 			num_channels = 8;
 
 		size_t offset = port.port * num_channels;
-		if (raw_rc_out.size() < offset + num_channels)
-			raw_rc_out.resize(offset + num_channels);
+		if (offset + num_channels > MAX_RC_OUT) {
+			ROS_WARN_THROTTLE_NAMED(60, "rc", "SERVO_OUTPUT_RAW port %u ignored, %zu channels max", port.port, MAX_RC_OUT);
+			return;
+		}
+
+		// port repeated before cycle end (higher port stopped): publish what we have
+		const uint32_t port_bit = 1U << port.port;
+		if (out_coalesce && (out_ports & port_bit)) {
+			publish_rc_out(out_stamp);
+			out_ports = 0;
+		}
+
+		rc_out_count = std::max(rc_out_count, offset + num_channels);
 
 		// [[[cog:
 		// for i in range(1, 9):
@@ -205,13 +302,55 @@ private:
 			// [[[end]]] (checksum: 60a386cba6faa126ee7dfe1b22f50398)
 		}
 
-		auto rcout_msg = boost::make_shared<mavros_msgs::RCOut>();
-
 		// XXX: Why time_usec is 32 bit? We should test that.
 		uint64_t time_usec = port.time_usec;
+		out_stamp = m_uas->synchronise_stamp(time_usec);
+
+		if (out_coalesce) {
+			out_ports |= port_bit;
+			out_max_port = std::max(out_max_port, port.port);
+			if (port.port < out_max_port)
+				return;		// wait for rest of cycle
+
+			out_ports = 0;
+		}
 
-		rcout_msg->header.stamp = m_uas->synchronise_stamp(time_usec);
-		rcout_msg->channels = raw_rc_out;
+		publish_rc_out(out_stamp);
+	}
+
+	/* -*- helpers -*- */
+
+	//! @note mutex should be held
+	void publish_rc_in(const ros::Time &stamp, uint8_t rssi)
+	{
+		if (!rc_in_pub.has_subscribers())
+			return;
+
+		if (change_only && !rc_in_filter.update(raw_rc_in, rc_in_count, deadband, heartbeat))
+			return;
+
+		auto rcin_msg = boost::make_shared<mavros_msgs::RCIn>();
+
+		rcin_msg->header.stamp = stamp;
+		rcin_msg->rssi = rssi;
+		rcin_msg->channels.assign(raw_rc_in.begin(), raw_rc_in.begin() + rc_in_count);
+
+		rc_in_pub.publish(rcin_msg);
+	}
+
+	//! @note mutex should be held
+	void publish_rc_out(const ros::Time &stamp)
+	{
+		if (!rc_out_pub.has_subscribers())
+			return;
+
+		if (change_only && !rc_out_filter.update(raw_rc_out, rc_out_count, deadband, heartbeat))
+			return;
+
+		auto rcout_msg = boost::make_shared<mavros_msgs::RCOut>();
+
+		rcout_msg->header.stamp = stamp;
+		rcout_msg->channels.assign(raw_rc_out.begin(), raw_rc_out.begin() + rc_out_count);
 
 		rc_out_pub.publish(rcout_msg);
 	}
@@ -221,39 +360,74 @@ private:
 	void connection_cb(bool connected) override
 	{
 		lock_guard lock(mutex);
-		raw_rc_in.clear();
-		raw_rc_out.clear();
+		raw_rc_in.fill(0);
+		raw_rc_out.fill(0);
+		rc_in_count = 0;
+		rc_out_count = 0;
+		rc_in_filter.clear();
+		rc_out_filter.clear();
+		out_ports = 0;
+		out_max_port = 0;
 		has_rc_channels_msg = false;
 	}
 
-	void override_cb(const mavros_msgs::OverrideRCIn::ConstPtr req)
+	void send_override(const mavros_msgs::OverrideRCIn::_channels_type &channels)
 	{
-		if (!m_uas->is_ardupilotmega() && !m_uas->is_px4())
-			ROS_WARN_THROTTLE_NAMED(30, "rc", "RC override not supported by this FCU!");
-
 		mavlink::common::msg::RC_CHANNELS_OVERRIDE ovr;
 		ovr.target_system = m_uas->get_tgt_system();
 		ovr.target_component = m_uas->get_tgt_component();
 
 		// [[[cog:
 		// for i in range(1, 9):
-		//     cog.outl("ovr.chan%d_raw = req->channels[%d];" % (i, i - 1))
+		//     cog.outl("ovr.chan%d_raw = channels[%d];" % (i, i - 1))
 		// ]]]
-		ovr.chan1_raw = req->channels[0];
-		ovr.chan2_raw = req->channels[1];
-		ovr.chan3_raw = req->channels[2];
-		ovr.chan4_raw = req->channels[3];
-		ovr.chan5_raw = req->channels[4];
-		ovr.chan6_raw = req->channels[5];
-		ovr.chan7_raw = req->channels[6];
-		ovr.chan8_raw = req->channels[7];
-		// [[[end]]] (checksum: bd27f3e85f5ab614ce1332ae3f4c6ebd)
+		ovr.chan1_raw = channels[0];
+		ovr.chan2_raw = channels[1];
+		ovr.chan3_raw = channels[2];
+		ovr.chan4_raw = channels[3];
+		ovr.chan5_raw = channels[4];
+		ovr.chan6_raw = channels[5];
+		ovr.chan7_raw = channels[6];
+		ovr.chan8_raw = channels[7];
+		// [[[end]]] (checksum: d914dedbae2af4325b7bf45b5ea6ae00)
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(ovr);
 	}
+
+	void override_cb(const mavros_msgs::OverrideRCIn::ConstPtr req)
+	{
+		if (!m_uas->is_ardupilotmega() && !m_uas->is_px4())
+			ROS_WARN_THROTTLE_NAMED(30, "rc", "RC override not supported by this FCU!");
+
+		if (!override_timer.isValid()) {
+			send_override(req->channels);
+			return;
+		}
+
+		// streaming: timer sends
+		lock_guard lock(mutex);
+		override_channels = req->channels;
+		override_last_rx = ros::Time::now();
+		override_active = true;
+	}
+
+	void override_timer_cb(const ros::TimerEvent &event)
+	{
+		lock_guard lock(mutex);
+		if (!override_active)
+			return;
+
+		if (!override_release_timeout.isZero() && event.current_real - override_last_rx > override_release_timeout) {
+			ROS_WARN_NAMED("rc", "RC override: no input for %.2f s, released", override_release_timeout.toSec());
+			override_active = false;
+			override_channels.fill(mavros_msgs::OverrideRCIn::CHAN_RELEASE);
+		}
+
+		send_override(override_channels);
+	}
 };
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::RCIOPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::RCIOPlugin)
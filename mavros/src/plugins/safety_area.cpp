@@ -29,12 +29,13 @@ namespace std_plugins {
 class SafetyAreaPlugin : public plugin::PluginBase {
 public:
 	SafetyAreaPlugin() : PluginBase(),
-		safety_nh("~safety_area")
+		safety_nh(private_nh("safety_area"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(safety_nh);
 
 		safety_nh.param<std::string>("frame_id", frame_id, "safety_area");
 
@@ -174,5 +175,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SafetyAreaPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SafetyAreaPlugin)
@@ -33,13 +33,14 @@ class SetpointAccelerationPlugin : public plugin::PluginBase,
 	private plugin::SetPositionTargetLocalNEDMixin<SetpointAccelerationPlugin> {
 public:
 	SetpointAccelerationPlugin() : PluginBase(),
-		sp_nh("~setpoint_accel"),
+		sp_nh(private_nh("setpoint_accel")),
 		send_force(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
 
 		sp_nh.param("send_force", send_force, false);
 
@@ -101,5 +102,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointAccelerationPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SetpointAccelerationPlugin)
@@ -45,7 +45,7 @@ class SetpointAttitudePlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<SetpointAttitudePlugin> {
 public:
 	SetpointAttitudePlugin() : PluginBase(),
-		sp_nh("~setpoint_attitude"),
+		sp_nh(private_nh("setpoint_attitude")),
 		tf_rate(50.0),
 		use_quaternion(false),
 		reverse_thrust(false),
@@ -55,6 +55,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
 
 		// main params
 		sp_nh.param("use_quaternion", use_quaternion, false);
@@ -219,5 +220,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointAttitudePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SetpointAttitudePlugin)
@@ -41,15 +41,23 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	SetpointPositionPlugin() : PluginBase(),
-		sp_nh("~setpoint_position"),
-		spg_nh("~"),
+		sp_nh(private_nh("setpoint_position")),
+		spg_nh(private_nh()),
 		tf_rate(50.0),
 		tf_listen(false)
 	{ }
 
+	~SetpointPositionPlugin()
+	{
+		// callback uses members, they go before mixin
+		tf2_stop();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
+		setup_node_handle(spg_nh);
 
 		// tf params
 		sp_nh.param("tf/listen", tf_listen, false);
@@ -295,5 +303,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointPositionPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SetpointPositionPlugin)
@@ -36,12 +36,13 @@ class SetpointRawPlugin : public plugin::PluginBase,
 	private plugin::SetAttitudeTargetMixin<SetpointRawPlugin> {
 public:
 	SetpointRawPlugin() : PluginBase(),
-		sp_nh("~setpoint_raw")
+		sp_nh(private_nh("setpoint_raw"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
 
 		bool tf_listen;
 
@@ -262,5 +263,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointRawPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SetpointRawPlugin)
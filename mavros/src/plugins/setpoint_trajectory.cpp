@@ -14,8 +14,10 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <chrono>
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
+#include <mavros/trajectory_sampler.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <nav_msgs/Path.h>
@@ -33,27 +35,36 @@ using mavlink::common::MAV_FRAME;
  * @brief Setpoint TRAJECTORY plugin
  *
  * Receive trajectory setpoints and send setpoint_raw setpoints along the trajectory.
+ *
+ * Trajectory converted to FCU frame and resampled to ~rate once, on receipt,
+ * then periodic timer sends one sample per tick.
  */
 class SetpointTrajectoryPlugin : public plugin::PluginBase,
 	private plugin::SetPositionTargetLocalNEDMixin<SetpointTrajectoryPlugin> {
 public:
 	SetpointTrajectoryPlugin() : PluginBase(),
-		sp_nh("~setpoint_trajectory")
+		sp_nh(private_nh("setpoint_trajectory")),
+		next_sample(0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
+
+		double rate;
 
 		sp_nh.param<std::string>("frame_id", frame_id, "map");
+		sp_nh.param("rate", rate, 50.0);
+		sampler.set_rate(rate);
 
 		local_sub = sp_nh.subscribe("local", 10, &SetpointTrajectoryPlugin::local_cb, this);
 		desired_pub = sp_nh.advertise<nav_msgs::Path>("desired", 10);
 
 		trajectory_reset_srv = sp_nh.advertiseService("reset", &SetpointTrajectoryPlugin::reset_cb, this);
 		mav_frame_srv = sp_nh.advertiseService("mav_frame", &SetpointTrajectoryPlugin::set_mav_frame_cb, this);
-		
-		sp_timer = sp_nh.createTimer(ros::Duration(0.01), &SetpointTrajectoryPlugin::reference_cb, this, true);
+
+		make_timer(sp_timer, ros::Duration(1.0 / sampler.get_rate()), &SetpointTrajectoryPlugin::reference_cb, false, false);
 
 		// mav_frame
 		std::string mav_frame_str;
@@ -76,7 +87,7 @@ private:
 
 	ros::NodeHandle sp_nh;
 
-	ros::Timer sp_timer;
+	Timer sp_timer;
 
 	ros::Subscriber local_sub;
 	ros::Publisher desired_pub;
@@ -84,18 +95,85 @@ private:
 	ros::ServiceServer trajectory_reset_srv;
 	ros::ServiceServer mav_frame_srv;
 
-	trajectory_msgs::MultiDOFJointTrajectory::ConstPtr trajectory_target_msg;
-	std::vector<trajectory_msgs::MultiDOFJointTrajectoryPoint>::const_iterator setpoint_target;
-	std::vector<trajectory_msgs::MultiDOFJointTrajectoryPoint>::const_iterator next_setpoint_target;
+	using steady_clock = std::chrono::steady_clock;
+
+	TrajectorySampler sampler;
+	//! time of trajectory start + first tick
+	steady_clock::time_point origin;
+	//! next sample to send
+	size_t next_sample;
 
 	std::string frame_id;
 	MAV_FRAME mav_frame;
-	ftf::StaticTF transform;
 
-	void reset_timer(ros::Duration duration){
-		sp_timer.stop();
-		sp_timer.setPeriod(duration);
-		sp_timer.start();		
+	//! points in FCU frame
+	std::vector<TrajectorySampler::Point> convert_points(const trajectory_msgs::MultiDOFJointTrajectory &req, ftf::StaticTF transform)
+	{
+		using TS = TrajectorySampler;
+
+		std::vector<TS::Point> points;
+		points.reserve(req.points.size());
+
+		for (auto &p : req.points) {
+			TS::Point pt;
+			pt.time = p.time_from_start.toSec();
+
+			if (!p.transforms.empty()) {
+				pt.fields |= TS::POSITION;
+				pt.position = ftf::detail::transform_static_frame(ftf::to_eigen(p.transforms[0].translation), transform);
+				pt.yaw = ftf::quaternion_get_yaw(
+						ftf::detail::transform_orientation(ftf::to_eigen(p.transforms[0].rotation), transform));
+			}
+
+			if (!p.velocities.empty()) {
+				pt.fields |= TS::VELOCITY;
+				pt.velocity = ftf::detail::transform_static_frame(ftf::to_eigen(p.velocities[0].linear), transform);
+				pt.yaw_rate = p.velocities[0].angular.z;
+			}
+
+			if (!p.accelerations.empty()) {
+				pt.fields |= TS::ACCELERATION;
+				pt.acceleration = ftf::detail::transform_static_frame(ftf::to_eigen(p.accelerations[0].linear), transform);
+			}
+
+			points.push_back(pt);
+		}
+
+		return points;
+	}
+
+	void send_sample(const TrajectorySampler::Point &pt)
+	{
+		using mavlink::common::POSITION_TARGET_TYPEMASK;
+		using TS = TrajectorySampler;
+
+		uint16_t type_mask = 0;
+		if (!(pt.fields & TS::POSITION))
+			type_mask |= uint16_t(POSITION_TARGET_TYPEMASK::X_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::Y_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::Z_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::YAW_IGNORE);
+
+		if (!(pt.fields & TS::VELOCITY))
+			type_mask |= uint16_t(POSITION_TARGET_TYPEMASK::VX_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::VY_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::VZ_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::YAW_RATE_IGNORE);
+
+		if (!(pt.fields & TS::ACCELERATION))
+			type_mask |= uint16_t(POSITION_TARGET_TYPEMASK::AX_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::AY_IGNORE)
+				| uint16_t(POSITION_TARGET_TYPEMASK::AZ_IGNORE);
+
+		set_position_target_local_ned(
+					ros::Time::now().toNSec() / 1000000,
+					utils::enum_value(mav_frame),
+					type_mask,
+					pt.position,
+					pt.velocity,
+					pt.acceleration,
+					pt.yaw,
+					pt.yaw_rate);
 	}
 
 	void publish_path(const trajectory_msgs::MultiDOFJointTrajectory::ConstPtr &req){
@@ -123,91 +201,71 @@ private:
 	{
 		lock_guard lock(mutex);
 
+		ftf::StaticTF transform;
 		if(static_cast<MAV_FRAME>(mav_frame) == MAV_FRAME::BODY_NED || static_cast<MAV_FRAME>(mav_frame) == MAV_FRAME::BODY_OFFSET_NED){
 			transform = ftf::StaticTF::BASELINK_TO_AIRCRAFT;
 		} else {
 			transform = ftf::StaticTF::ENU_TO_NED;
 		}
 
-		trajectory_target_msg = req;
+		sp_timer.stop();
+		try {
+			if (!sampler.resample(convert_points(*req, transform))) {
+				ROS_WARN_NAMED("setpoint", "SPT: trajectory rejected: no points or longer than %zu samples",
+						TrajectorySampler::MAX_SAMPLES);
+				return;
+			}
+		}
+		catch (std::bad_alloc &ex) {
+			sampler.clear();
+			ROS_ERROR_NAMED("setpoint", "SPT: trajectory rejected: %s", ex.what());
+			return;
+		}
 
-		// Read first duration of the setpoint and set the timer
-		setpoint_target = req->points.cbegin();
-		reset_timer(setpoint_target->time_from_start);
+		// sample k sent at tick which is start_time() + k / rate after first one
+		const auto period = std::chrono::duration<double>(1.0 / sampler.get_rate());
+		origin = steady_clock::now() + std::chrono::duration_cast<steady_clock::duration>(period);
+		next_sample = 0;
+
+		sp_timer.setPeriod(period.count());
+		sp_timer.start();
 		publish_path(req);
+
+		ROS_DEBUG_NAMED("setpoint", "SPT: %zu points, %zu samples at %.1f Hz",
+				req->points.size(), sampler.samples().size(), sampler.get_rate());
 	}
 
 	void reference_cb(const ros::TimerEvent &event)
 	{
-		using mavlink::common::POSITION_TARGET_TYPEMASK;
 		lock_guard lock(mutex);
 
-		if(!trajectory_target_msg)
+		auto &samples = sampler.samples();
+		if (next_sample >= samples.size())
 			return;
 
-		Eigen::Vector3d position, velocity, af;
-		Eigen::Quaterniond attitude;
-		float yaw, yaw_rate;
-		uint16_t type_mask = 0;		
-		if(!setpoint_target->transforms.empty()){
-			position = ftf::detail::transform_static_frame(ftf::to_eigen(setpoint_target->transforms[0].translation), transform);
-			attitude = ftf::detail::transform_orientation(ftf::to_eigen(setpoint_target->transforms[0].rotation), transform);
-
-		} else {
-			type_mask = type_mask | uint16_t(POSITION_TARGET_TYPEMASK::X_IGNORE)
-							| uint16_t(POSITION_TARGET_TYPEMASK::Y_IGNORE) 
-							| uint16_t(POSITION_TARGET_TYPEMASK::Z_IGNORE)
-							| uint16_t(POSITION_TARGET_TYPEMASK::YAW_IGNORE);
-
-		}
-
-		if(!setpoint_target->velocities.empty()){
-			velocity = ftf::detail::transform_static_frame(ftf::to_eigen(setpoint_target->velocities[0].linear), transform);
-			yaw_rate = setpoint_target->velocities[0].angular.z;
-
-		} else {
-			type_mask = type_mask | uint16_t(POSITION_TARGET_TYPEMASK::VX_IGNORE)
-							| uint16_t(POSITION_TARGET_TYPEMASK::VY_IGNORE) 
-							| uint16_t(POSITION_TARGET_TYPEMASK::VZ_IGNORE)
-							| uint16_t(POSITION_TARGET_TYPEMASK::YAW_RATE_IGNORE);
-
-		}
-		
-		if(!setpoint_target->accelerations.empty()){
-			af = ftf::detail::transform_static_frame(ftf::to_eigen(setpoint_target->accelerations[0].linear), transform);
-
-		} else {
-			type_mask = type_mask | uint16_t(POSITION_TARGET_TYPEMASK::AX_IGNORE) 
-							| uint16_t(POSITION_TARGET_TYPEMASK::AY_IGNORE) 
-							| uint16_t(POSITION_TARGET_TYPEMASK::AZ_IGNORE);
+		// latest due sample: tick jitter does not accumulate, late tick skips
+		const double elapsed = std::chrono::duration<double>(steady_clock::now() - origin).count();
+		const double k = std::round((elapsed - sampler.start_time()) * sampler.get_rate());
+		if (k < next_sample)
+			return;
 
-		}
+		const size_t idx = std::min(size_t(k), samples.size() - 1);
+		send_sample(samples[idx]);
+		next_sample = idx + 1;
 
-		set_position_target_local_ned(
-					ros::Time::now().toNSec() / 1000000,
-					utils::enum_value(mav_frame),
-					type_mask,
-					position,
-					velocity,
-					af,
-					ftf::quaternion_get_yaw(attitude),
-					yaw_rate);
-	
-		next_setpoint_target = setpoint_target + 1;
-		if (next_setpoint_target != trajectory_target_msg->points.cend()) {
-			reset_timer(setpoint_target->time_from_start);
-			setpoint_target = next_setpoint_target;
-		} else {
-			trajectory_target_msg.reset();
+		if (next_sample >= samples.size()) {
+			sp_timer.stop();
+			sampler.clear();
 		}
-
-		return;
 	}
 
 	bool reset_cb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 	{
-		if(trajectory_target_msg){
-			trajectory_target_msg.reset();
+		lock_guard lock(mutex);
+
+		if(!sampler.empty()){
+			sp_timer.stop();
+			sampler.clear();
 			res.success = true;
 		} else {
 			res.success = false;
@@ -229,5 +287,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SetpointTrajectoryPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SetpointTrajectoryPlugin)
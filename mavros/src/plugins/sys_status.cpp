@@ -118,12 +118,13 @@ public:
 			stat.summary(0, "Normal");
 		}
 
-		stat.addf("Heartbeats since startup", "%d", count_);
-		stat.addf("Frequency (Hz)", "%f", freq);
-		stat.add("Vehicle type", utils::to_string(type));
-		stat.add("Autopilot type", utils::to_string(autopilot));
-		stat.add("Mode", mode);
-		stat.add("System status", utils::to_string(system_status));
+		auto &c = cache.begin(stat);
+		c.addf("Heartbeats since startup", "%d", count_);
+		c.addf("Frequency (Hz)", "%f", freq);
+		c.add("Vehicle type", {double(enum_value(type))}, [this]() { return utils::to_string(type); });
+		c.add("Autopilot type", {double(enum_value(autopilot))}, [this]() { return utils::to_string(autopilot); });
+		c.add("Mode", mode);
+		c.add("System status", {double(enum_value(system_status))}, [this]() { return utils::to_string(system_status); });
 	}
 
 private:
@@ -141,6 +142,7 @@ private:
 	MAV_TYPE type;
 	std::string mode;
 	MAV_STATE system_status;
+	DiagCache cache;
 };
 
 
@@ -170,9 +172,10 @@ public:
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Sensor present", "0x%08X", last_st.onboard_control_sensors_present);
-		stat.addf("Sensor enabled", "0x%08X", last_st.onboard_control_sensors_enabled);
-		stat.addf("Sensor health", "0x%08X", last_st.onboard_control_sensors_health);
+		auto &c = cache.begin(stat);
+		c.addf("Sensor present", "0x%08X", last_st.onboard_control_sensors_present);
+		c.addf("Sensor enabled", "0x%08X", last_st.onboard_control_sensors_enabled);
+		c.addf("Sensor health", "0x%08X", last_st.onboard_control_sensors_health);
 
 		using STS = mavlink::common::MAV_SYS_STATUS_SENSOR;
 
@@ -197,78 +200,79 @@ public:
 		//
 		//     cog.outl(f"""\
 		//     if (last_st.onboard_control_sensors_enabled & enum_value(STS::{sts}))
-		//     \tstat.add("{desc.strip()}", (last_st.onboard_control_sensors_health & enum_value(STS::{sts})) ? "Ok" : "Fail");""")
+		//     \tc.add("{desc.strip()}", (last_st.onboard_control_sensors_health & enum_value(STS::{sts})) ? "Ok" : "Fail");""")
 		// ]]]
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO))
-			stat.add("3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO)) ? "Ok" : "Fail");
+			c.add("3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL))
-			stat.add("3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL)) ? "Ok" : "Fail");
+			c.add("3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG))
-			stat.add("3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG)) ? "Ok" : "Fail");
+			c.add("3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ABSOLUTE_PRESSURE))
-			stat.add("absolute pressure", (last_st.onboard_control_sensors_health & enum_value(STS::ABSOLUTE_PRESSURE)) ? "Ok" : "Fail");
+			c.add("absolute pressure", (last_st.onboard_control_sensors_health & enum_value(STS::ABSOLUTE_PRESSURE)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::DIFFERENTIAL_PRESSURE))
-			stat.add("differential pressure", (last_st.onboard_control_sensors_health & enum_value(STS::DIFFERENTIAL_PRESSURE)) ? "Ok" : "Fail");
+			c.add("differential pressure", (last_st.onboard_control_sensors_health & enum_value(STS::DIFFERENTIAL_PRESSURE)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::GPS))
-			stat.add("GPS", (last_st.onboard_control_sensors_health & enum_value(STS::GPS)) ? "Ok" : "Fail");
+			c.add("GPS", (last_st.onboard_control_sensors_health & enum_value(STS::GPS)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::OPTICAL_FLOW))
-			stat.add("optical flow", (last_st.onboard_control_sensors_health & enum_value(STS::OPTICAL_FLOW)) ? "Ok" : "Fail");
+			c.add("optical flow", (last_st.onboard_control_sensors_health & enum_value(STS::OPTICAL_FLOW)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::VISION_POSITION))
-			stat.add("computer vision position", (last_st.onboard_control_sensors_health & enum_value(STS::VISION_POSITION)) ? "Ok" : "Fail");
+			c.add("computer vision position", (last_st.onboard_control_sensors_health & enum_value(STS::VISION_POSITION)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::LASER_POSITION))
-			stat.add("laser based position", (last_st.onboard_control_sensors_health & enum_value(STS::LASER_POSITION)) ? "Ok" : "Fail");
+			c.add("laser based position", (last_st.onboard_control_sensors_health & enum_value(STS::LASER_POSITION)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::EXTERNAL_GROUND_TRUTH))
-			stat.add("external ground truth (Vicon or Leica)", (last_st.onboard_control_sensors_health & enum_value(STS::EXTERNAL_GROUND_TRUTH)) ? "Ok" : "Fail");
+			c.add("external ground truth (Vicon or Leica)", (last_st.onboard_control_sensors_health & enum_value(STS::EXTERNAL_GROUND_TRUTH)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ANGULAR_RATE_CONTROL))
-			stat.add("3D angular rate control", (last_st.onboard_control_sensors_health & enum_value(STS::ANGULAR_RATE_CONTROL)) ? "Ok" : "Fail");
+			c.add("3D angular rate control", (last_st.onboard_control_sensors_health & enum_value(STS::ANGULAR_RATE_CONTROL)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::ATTITUDE_STABILIZATION))
-			stat.add("attitude stabilization", (last_st.onboard_control_sensors_health & enum_value(STS::ATTITUDE_STABILIZATION)) ? "Ok" : "Fail");
+			c.add("attitude stabilization", (last_st.onboard_control_sensors_health & enum_value(STS::ATTITUDE_STABILIZATION)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::YAW_POSITION))
-			stat.add("yaw position", (last_st.onboard_control_sensors_health & enum_value(STS::YAW_POSITION)) ? "Ok" : "Fail");
+			c.add("yaw position", (last_st.onboard_control_sensors_health & enum_value(STS::YAW_POSITION)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::Z_ALTITUDE_CONTROL))
-			stat.add("z/altitude control", (last_st.onboard_control_sensors_health & enum_value(STS::Z_ALTITUDE_CONTROL)) ? "Ok" : "Fail");
+			c.add("z/altitude control", (last_st.onboard_control_sensors_health & enum_value(STS::Z_ALTITUDE_CONTROL)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::XY_POSITION_CONTROL))
-			stat.add("x/y position control", (last_st.onboard_control_sensors_health & enum_value(STS::XY_POSITION_CONTROL)) ? "Ok" : "Fail");
+			c.add("x/y position control", (last_st.onboard_control_sensors_health & enum_value(STS::XY_POSITION_CONTROL)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::MOTOR_OUTPUTS))
-			stat.add("motor outputs / control", (last_st.onboard_control_sensors_health & enum_value(STS::MOTOR_OUTPUTS)) ? "Ok" : "Fail");
+			c.add("motor outputs / control", (last_st.onboard_control_sensors_health & enum_value(STS::MOTOR_OUTPUTS)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::RC_RECEIVER))
-			stat.add("rc receiver", (last_st.onboard_control_sensors_health & enum_value(STS::RC_RECEIVER)) ? "Ok" : "Fail");
+			c.add("rc receiver", (last_st.onboard_control_sensors_health & enum_value(STS::RC_RECEIVER)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_GYRO2))
-			stat.add("2nd 3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO2)) ? "Ok" : "Fail");
+			c.add("2nd 3D gyro", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_GYRO2)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_ACCEL2))
-			stat.add("2nd 3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL2)) ? "Ok" : "Fail");
+			c.add("2nd 3D accelerometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_ACCEL2)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SENSOR_3D_MAG2))
-			stat.add("2nd 3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG2)) ? "Ok" : "Fail");
+			c.add("2nd 3D magnetometer", (last_st.onboard_control_sensors_health & enum_value(STS::SENSOR_3D_MAG2)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::GEOFENCE))
-			stat.add("geofence", (last_st.onboard_control_sensors_health & enum_value(STS::GEOFENCE)) ? "Ok" : "Fail");
+			c.add("geofence", (last_st.onboard_control_sensors_health & enum_value(STS::GEOFENCE)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::AHRS))
-			stat.add("AHRS subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::AHRS)) ? "Ok" : "Fail");
+			c.add("AHRS subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::AHRS)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::TERRAIN))
-			stat.add("Terrain subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::TERRAIN)) ? "Ok" : "Fail");
+			c.add("Terrain subsystem health", (last_st.onboard_control_sensors_health & enum_value(STS::TERRAIN)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::REVERSE_MOTOR))
-			stat.add("Motors are reversed", (last_st.onboard_control_sensors_health & enum_value(STS::REVERSE_MOTOR)) ? "Ok" : "Fail");
+			c.add("Motors are reversed", (last_st.onboard_control_sensors_health & enum_value(STS::REVERSE_MOTOR)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::LOGGING))
-			stat.add("Logging", (last_st.onboard_control_sensors_health & enum_value(STS::LOGGING)) ? "Ok" : "Fail");
+			c.add("Logging", (last_st.onboard_control_sensors_health & enum_value(STS::LOGGING)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::BATTERY))
-			stat.add("Battery", (last_st.onboard_control_sensors_health & enum_value(STS::BATTERY)) ? "Ok" : "Fail");
+			c.add("Battery", (last_st.onboard_control_sensors_health & enum_value(STS::BATTERY)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::PROXIMITY))
-			stat.add("Proximity", (last_st.onboard_control_sensors_health & enum_value(STS::PROXIMITY)) ? "Ok" : "Fail");
+			c.add("Proximity", (last_st.onboard_control_sensors_health & enum_value(STS::PROXIMITY)) ? "Ok" : "Fail");
 		if (last_st.onboard_control_sensors_enabled & enum_value(STS::SATCOM))
-			stat.add("Satellite Communication", (last_st.onboard_control_sensors_health & enum_value(STS::SATCOM)) ? "Ok" : "Fail");
-		// [[[end]]] (checksum: 890cfdc6d3b776c38a59b39f80ec7351)
-
-		stat.addf("CPU Load (%)", "%.1f", last_st.load / 10.0);
-		stat.addf("Drop rate (%)", "%.1f", last_st.drop_rate_comm / 10.0);
-		stat.addf("Errors comm", "%d", last_st.errors_comm);
-		stat.addf("Errors count #1", "%d", last_st.errors_count1);
-		stat.addf("Errors count #2", "%d", last_st.errors_count2);
-		stat.addf("Errors count #3", "%d", last_st.errors_count3);
-		stat.addf("Errors count #4", "%d", last_st.errors_count4);
+			c.add("Satellite Communication", (last_st.onboard_control_sensors_health & enum_value(STS::SATCOM)) ? "Ok" : "Fail");
+		// [[[end]]] (checksum: 4a08883b3dda744e4dced1f6fec8c7a3)
+
+		c.addf("CPU Load (%)", "%.1f", last_st.load / 10.0);
+		c.addf("Drop rate (%)", "%.1f", last_st.drop_rate_comm / 10.0);
+		c.addf("Errors comm", "%d", last_st.errors_comm);
+		c.addf("Errors count #1", "%d", last_st.errors_count1);
+		c.addf("Errors count #2", "%d", last_st.errors_count2);
+		c.addf("Errors count #3", "%d", last_st.errors_count3);
+		c.addf("Errors count #4", "%d", last_st.errors_count4);
 	}
 
 private:
 	std::mutex mutex;
 	mavlink::common::msg::SYS_STATUS last_st;
+	DiagCache cache;
 };
 
 
@@ -309,9 +313,10 @@ public:
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Voltage", "%.2f", voltage);
-		stat.addf("Current", "%.1f", current);
-		stat.addf("Remaining", "%.1f", remaining * 100);
+		auto &c = cache.begin(stat);
+		c.addf("Voltage", "%.2f", voltage);
+		c.addf("Current", "%.1f", current);
+		c.addf("Remaining", "%.1f", remaining * 100);
 	}
 
 private:
@@ -320,6 +325,7 @@ private:
 	float current;
 	float remaining;
 	float min_voltage;
+	DiagCache cache;
 };
 
 
@@ -352,13 +358,15 @@ public:
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Free memory (B)", "%zd", freemem_);
-		stat.addf("Heap top", "0x%04X", brkval_);
+		auto &c = cache.begin(stat);
+		c.addf("Free memory (B)", "%zd", freemem_);
+		c.addf("Heap top", "0x%04X", brkval_);
 	}
 
 private:
 	std::atomic<ssize_t> freemem;
 	std::atomic<uint16_t> brkval;
+	DiagCache cache;
 };
 
 
@@ -396,8 +404,9 @@ public:
 		else
 			stat.summary(0, "Normal");
 
-		stat.addf("Core voltage", "%f", vcc);
-		stat.addf("I2C errors", "%zu", i2cerr);
+		auto &c = cache.begin(stat);
+		c.addf("Core voltage", "%f", vcc);
+		c.addf("I2C errors", "%zu", i2cerr);
 	}
 
 private:
@@ -405,6 +414,7 @@ private:
 	float vcc;
 	size_t i2cerr;
 	size_t i2cerr_last;
+	DiagCache cache;
 };
 
 
@@ -417,22 +427,25 @@ class SystemStatusPlugin : public plugin::PluginBase
 {
 public:
 	SystemStatusPlugin() : PluginBase(),
-		nh("~"),
+		nh(private_nh()),
 		hb_diag("Heartbeat", 10),
 		mem_diag("APM Memory"),
 		hwst_diag("APM Hardware"),
 		sys_diag("System"),
 		batt_diag("Battery"),
 		version_retries(RETRIES_COUNT),
+		stream_demand_resend(true),
 		disable_diag(false),
 		has_battery_status(false),
 		battery_voltage(0.0),
+		mode_cache_key(0),
 		conn_heartbeat_mav_type(MAV_TYPE::ONBOARD_CONTROLLER)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		ros::Duration conn_heartbeat;
 
@@ -466,20 +479,23 @@ public:
 
 
 		// one-shot timeout timer
-		timeout_timer = nh.createTimer(ros::Duration(conn_timeout_d),
-				&SystemStatusPlugin::timeout_cb, this, true);
-		//timeout_timer.start();
+		make_timer(timeout_timer, ros::Duration(conn_timeout_d),
+				&SystemStatusPlugin::timeout_cb, true);
 
 		if (!conn_heartbeat.isZero()) {
-			heartbeat_timer = nh.createTimer(conn_heartbeat,
-					&SystemStatusPlugin::heartbeat_cb, this);
-			//heartbeat_timer.start();
+			make_timer(heartbeat_timer, conn_heartbeat,
+					&SystemStatusPlugin::heartbeat_cb);
 		}
 
-		// version request timer
-		autopilot_version_timer = nh.createTimer(ros::Duration(1.0),
-				&SystemStatusPlugin::autopilot_version_cb, this);
-		autopilot_version_timer.stop();
+		// version request timer, started on connection
+		make_timer(autopilot_version_timer, ros::Duration(1.0),
+				&SystemStatusPlugin::autopilot_version_cb, false, false);
+
+		// stream rates from subscribers, see UAS::stream_demand
+		if (m_uas->stream_demand.is_enabled()) {
+			make_timer(stream_demand_timer, ros::Duration(m_uas->stream_demand.get_period()),
+					&SystemStatusPlugin::stream_demand_cb);
+		}
 
 		state_pub = nh.advertise<mavros_msgs::State>("state", 10, true);
 		extended_state_pub = nh.advertise<mavros_msgs::ExtendedState>("extended_state", 10);
@@ -502,8 +518,10 @@ public:
 			make_handler(&SystemStatusPlugin::handle_heartbeat),
 			make_handler(&SystemStatusPlugin::handle_sys_status),
 			make_handler(&SystemStatusPlugin::handle_statustext),
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 			make_handler(&SystemStatusPlugin::handle_meminfo),
 			make_handler(&SystemStatusPlugin::handle_hwstatus),
+#endif
 			make_handler(&SystemStatusPlugin::handle_autopilot_version),
 			make_handler(&SystemStatusPlugin::handle_extended_sys_state),
 			make_handler(&SystemStatusPlugin::handle_battery_status),
@@ -519,9 +537,10 @@ private:
 	HwStatus hwst_diag;
 	SystemStatusDiag sys_diag;
 	BatteryStatusDiag batt_diag;
-	ros::Timer timeout_timer;
-	ros::Timer heartbeat_timer;
-	ros::Timer autopilot_version_timer;
+	Timer timeout_timer;
+	Timer heartbeat_timer;
+	Timer autopilot_version_timer;
+	Timer stream_demand_timer;
 
 	ros::Publisher state_pub;
 	ros::Publisher extended_state_pub;
@@ -537,6 +556,7 @@ private:
 	MAV_TYPE conn_heartbeat_mav_type;
 	static constexpr int RETRIES_COUNT = 6;
 	int version_retries;
+	std::atomic<bool> stream_demand_resend;
 	bool disable_diag;
 	bool has_battery_status;
 	float battery_voltage;
@@ -544,8 +564,37 @@ private:
 	using M_VehicleInfo = std::unordered_map<uint16_t, mavros_msgs::VehicleInfo>;
 	M_VehicleInfo vehicles;
 
+	//! last HEARTBEAT mode string and its mode_cache_key(), mode rarely changes
+	uint64_t mode_cache_key;
+	std::string mode_cache;
+
 	/* -*- mid-level helpers -*- */
 
+	//! all str_mode_v10() depends on
+	inline uint64_t get_mode_key(uint8_t base_mode, uint32_t custom_mode) {
+		using mavlink::common::MAV_MODE_FLAG;
+
+		// other base mode bits not used by custom mode names
+		if (base_mode & enum_value(MAV_MODE_FLAG::CUSTOM_MODE_ENABLED))
+			base_mode = enum_value(MAV_MODE_FLAG::CUSTOM_MODE_ENABLED);
+
+		return uint64_t(enum_value(m_uas->get_autopilot())) << 48 |
+		       uint64_t(enum_value(m_uas->get_type())) << 40 |
+		       uint64_t(base_mode) << 32 |
+		       custom_mode;
+	}
+
+	//! mode string, formatted only on change
+	const std::string &str_mode_cached(uint8_t base_mode, uint32_t custom_mode) {
+		const auto key = get_mode_key(base_mode, custom_mode);
+		if (key != mode_cache_key || mode_cache.empty()) {
+			mode_cache_key = key;
+			mode_cache = m_uas->str_mode_v10(base_mode, custom_mode);
+		}
+
+		return mode_cache;
+	}
+
 	// Get vehicle key for the unordered map containing all vehicles
 	inline uint16_t get_vehicle_key(uint8_t sysid,uint8_t compid) {
 		return sysid << 8 | compid;
@@ -695,7 +744,7 @@ private:
 		// Store generic info of all heartbeats seen
 		auto it = find_or_create_vehicle_info(msg->sysid, msg->compid);
 
-		auto vehicle_mode = m_uas->str_mode_v10(hb.base_mode, hb.custom_mode);
+		const auto &vehicle_mode = str_mode_cached(hb.base_mode, hb.custom_mode);
 		auto stamp = ros::Time::now();
 
 		// Update vehicle data
@@ -801,6 +850,7 @@ private:
 		statustext_pub.publish(st_msg);
 	}
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 	void handle_meminfo(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::MEMINFO &mem)
 	{
 		mem_diag.set(mem.freemem, mem.brkval);
@@ -810,6 +860,7 @@ private:
 	{
 		hwst_diag.set(hwst.Vcc, hwst.I2Cerr);
 	}
+#endif
 
 	void handle_autopilot_version(const mavlink::mavlink_message_t *msg, mavlink::common::msg::AUTOPILOT_VERSION &apv)
 	{
@@ -963,6 +1014,27 @@ private:
 		m_uas->update_connection_status(false);
 	}
 
+	void stream_demand_cb(const ros::TimerEvent &event)
+	{
+		using mavlink::common::MAV_CMD;
+
+		if (!m_uas->is_connected())
+			return;
+
+		// FCU forgets intervals on reboot, so all rates resent on connection
+		for (auto &rq : m_uas->stream_demand.update(stream_demand_resend.exchange(false))) {
+			mavlink::common::msg::COMMAND_LONG cmd {};
+			m_uas->msg_set_target(cmd);
+
+			cmd.command = enum_value(MAV_CMD::SET_MESSAGE_INTERVAL);
+			cmd.param1 = rq.msgid;
+			cmd.param2 = rq.interval_us;
+
+			ROS_DEBUG_NAMED("sys", "StreamDemand: msgid %u at %f Hz", rq.msgid, rq.rate);
+			UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
+		}
+	}
+
 	void heartbeat_cb(const ros::TimerEvent &event)
 	{
 		using mavlink::common::MAV_MODE;
@@ -982,30 +1054,21 @@ private:
 	{
 		using mavlink::common::MAV_CMD;
 
-		bool ret = false;
-
 		// Request from all first 3 times, then fallback to unicast
 		bool do_broadcast = version_retries > RETRIES_COUNT / 2;
 
-		try {
-			auto client = nh.serviceClient<mavros_msgs::CommandLong>("cmd/command");
+		// sent directly: timer thread should not wait for command plugin service
+		mavlink::common::msg::COMMAND_LONG cmd {};
+		if (!do_broadcast)
+			m_uas->msg_set_target(cmd);
 
-			mavros_msgs::CommandLong cmd{};
+		cmd.command = enum_value(MAV_CMD::REQUEST_AUTOPILOT_CAPABILITIES);
+		cmd.confirmation = 0;
+		cmd.param1 = 1.0;
 
-			cmd.request.broadcast = do_broadcast;
-			cmd.request.command = enum_value(MAV_CMD::REQUEST_AUTOPILOT_CAPABILITIES);
-			cmd.request.confirmation = false;
-			cmd.request.param1 = 1.0;
-
-			ROS_DEBUG_NAMED("sys", "VER: Sending %s request.",
-					(do_broadcast) ? "broadcast" : "unicast");
-			ret = client.call(cmd);
-		}
-		catch (ros::InvalidNameException &ex) {
-			ROS_ERROR_NAMED("sys", "VER: %s", ex.what());
-		}
-
-		ROS_ERROR_COND_NAMED(!ret, "sys", "VER: command plugin service call failed!");
+		ROS_DEBUG_NAMED("sys", "VER: Sending %s request.",
+				(do_broadcast) ? "broadcast" : "unicast");
+		UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
 
 		if (version_retries > 0) {
 			version_retries--;
@@ -1025,6 +1088,7 @@ private:
 	void connection_cb(bool connected) override
 	{
 		has_battery_status = false;
+		stream_demand_resend = true;
 
 		// if connection changes, start delayed version request
 		version_retries = RETRIES_COUNT;
@@ -1033,6 +1097,7 @@ private:
 		else
 			autopilot_version_timer.stop();
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 		// add/remove APM diag tasks
 		if (connected && disable_diag && m_uas->is_ardupilotmega()) {
 			UAS_DIAG(m_uas).add(mem_diag);
@@ -1042,6 +1107,7 @@ private:
 			UAS_DIAG(m_uas).removeByName(mem_diag.getName());
 			UAS_DIAG(m_uas).removeByName(hwst_diag.getName());
 		}
+#endif
 
 		if (!connected) {
 			// publish connection change
@@ -1195,5 +1261,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SystemStatusPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SystemStatusPlugin)
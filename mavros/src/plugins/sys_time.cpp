@@ -137,10 +137,12 @@ private:
 class SystemTimePlugin : public plugin::PluginBase {
 public:
 	SystemTimePlugin() : PluginBase(),
-		nh("~"),
+		nh(private_nh()),
 		dt_diag("Time Sync", 10),
 		time_offset(0.0),
 		time_skew(0.0),
+		sample_interval(0.0),
+		last_remote_time(0),
 		sequence(0),
 		filter_alpha(0),
 		filter_beta(0),
@@ -153,6 +155,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		double conn_system_time_d;
 		double conn_timesync_d;
@@ -222,9 +225,8 @@ public:
 
 		// timer for sending system time messages
 		if (!conn_system_time.isZero()) {
-			sys_time_timer = nh.createTimer(conn_system_time,
-						&SystemTimePlugin::sys_time_cb, this);
-			sys_time_timer.start();
+			make_timer(sys_time_timer, conn_system_time,
+						&SystemTimePlugin::sys_time_cb);
 		}
 
 		// timer for sending timesync messages
@@ -232,9 +234,8 @@ public:
 			// enable timesync diag only if that feature enabled
 			UAS_DIAG(m_uas).add(dt_diag);
 
-			timesync_timer = nh.createTimer(conn_timesync,
-						&SystemTimePlugin::timesync_cb, this);
-			timesync_timer.start();
+			make_timer(timesync_timer, conn_timesync,
+						&SystemTimePlugin::timesync_cb);
 		}
 	}
 
@@ -251,8 +252,8 @@ private:
 	ros::Publisher time_ref_pub;
 	ros::Publisher timesync_status_pub;
 
-	ros::Timer sys_time_timer;
-	ros::Timer timesync_timer;
+	Timer sys_time_timer;
+	Timer timesync_timer;
 
 	TimeSyncStatus dt_diag;
 
@@ -260,7 +261,9 @@ private:
 
 	// Estimated statistics
 	double time_offset;
-	double time_skew;
+	double time_skew;		//!< offset change per sample
+	double sample_interval;		//!< smoothed remote time between samples [ns]
+	uint64_t last_remote_time;
 
 	// Filter parameters
 	uint32_t sequence;
@@ -307,7 +310,8 @@ private:
 
 	void handle_timesync(const mavlink::mavlink_message_t *msg, mavlink::common::msg::TIMESYNC &tsync)
 	{
-		uint64_t now_ns = ros::Time::now().toNSec();
+		// arrival time, dispatch latency is not part of RTT
+		uint64_t now_ns = m_uas->get_rx_stamp().toNSec();
 
 		if (tsync.tc1 == 0) {
 			send_timesync_msg(now_ns, tsync.ts1);
@@ -356,7 +360,7 @@ private:
 
 	void add_timesync_observation(int64_t offset_ns, uint64_t local_time_ns, uint64_t remote_time_ns)
 	{
-		uint64_t now_ns = ros::Time::now().toNSec();
+		uint64_t now_ns = m_uas->get_rx_stamp().toNSec();
 
 		// Calculate the round trip time (RTT) it took the timesync packet to bounce back to us from remote system
 		uint64_t rtt_ns = now_ns - local_time_ns;
@@ -395,10 +399,13 @@ private:
 				}
 
 				// Perform filter update
-				add_sample(offset_ns);
+				add_sample(offset_ns, remote_time_ns);
 
-				// Save time offset for other components to use
-				m_uas->set_time_offset(sync_converged() ? time_offset : 0);
+				// Save time offset and drift for other components to use
+				if (sync_converged())
+					m_uas->set_time_sync_model({uint64_t(time_offset), get_skew_rate(), remote_time_ns});
+				else
+					m_uas->set_time_offset(0);
 
 				// Increment sequence counter after filter update
 				sequence++;
@@ -437,7 +444,7 @@ private:
 		dt_diag.tick(rtt_ns, remote_time_ns, time_offset);
 	}
 
-	void add_sample(int64_t offset_ns)
+	void add_sample(int64_t offset_ns, uint64_t remote_time_ns)
 	{
 		/* Online exponential smoothing filter. The derivative of the estimate is also
 		 * estimated in order to produce an estimate without steady state lag:
@@ -454,7 +461,27 @@ private:
 
 			// Update the clock skew estimate
 			time_skew = filter_beta * (time_offset - time_offset_prev) + (1.0 - filter_beta) * time_skew;
+
+			// Skew is per sample, track sample spacing to convert it to rate
+			double interval = double(int64_t(remote_time_ns - last_remote_time));
+			if (interval > 0)
+				sample_interval = (sample_interval > 0) ?
+					filter_beta * interval + (1.0 - filter_beta) * sample_interval : interval;
 		}
+
+		last_remote_time = remote_time_ns;
+	}
+
+	//! Offset change per remote nanosecond, limited to sane oscillator drift
+	double get_skew_rate()
+	{
+		constexpr double MAX_SKEW = 1e-3;	// 1000 ppm
+
+		if (sample_interval <= 0)
+			return 0.0;
+
+		double skew = time_skew / sample_interval;
+		return std::min(MAX_SKEW, std::max(-MAX_SKEW, skew));
 	}
 
 	void reset_filter()
@@ -463,6 +490,8 @@ private:
 		sequence = 0;
 		time_offset = 0.0;
 		time_skew = 0.0;
+		sample_interval = 0.0;
+		last_remote_time = 0;
 		filter_alpha = filter_alpha_initial;
 		filter_beta = filter_beta_initial;
 		high_deviation_count = 0;
@@ -485,5 +514,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::SystemTimePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::SystemTimePlugin)
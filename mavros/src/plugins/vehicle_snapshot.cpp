@@ -0,0 +1,219 @@
+/**
+ * @brief VehicleSnapshot plugin
+ * @file vehicle_snapshot.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup plugin
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <angles/angles.h>
+#include <mavros/mavros_plugin.h>
+#include <eigen_conversions/eigen_msg.h>
+
+#include <mavros_msgs/VehicleSnapshot.h>
+
+namespace mavros {
+namespace std_plugins {
+/**
+ * @brief Aggregated low-rate telemetry plugin
+ *
+ * Keeps latest state, extended state, battery, VFR HUD, altitude, wind
+ * and home position, publishes them together in ~snapshot at ~snapshot/rate,
+ * so dashboards need one topic per vehicle.
+ *
+ * Handlers share decoded messages with plugins publishing separate topics,
+ * and only copy fields; nothing is published without subscribers.
+ */
+class VehicleSnapshotPlugin : public plugin::PluginBase {
+public:
+	VehicleSnapshotPlugin() : PluginBase(),
+		nh(private_nh())
+	{ }
+
+	void initialize(UAS &uas_)
+	{
+		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
+
+		double rate;
+
+		nh.param<std::string>("snapshot/frame_id", snapshot.header.frame_id, "map");
+		nh.param("snapshot/rate", rate, 1.0);
+
+		snapshot_pub.advertise<mavros_msgs::VehicleSnapshot>(nh, "snapshot", 10);
+
+		if (rate > 0.0)
+			make_timer(publish_timer, ros::Duration(1.0 / rate), &VehicleSnapshotPlugin::publish_cb);
+		else
+			ROS_WARN_NAMED("snapshot", "SNAP: snapshot/rate %f, not publishing", rate);
+
+		enable_connection_cb();
+	}
+
+	Subscriptions get_subscriptions()
+	{
+		return {
+			make_handler(&VehicleSnapshotPlugin::handle_heartbeat),
+			make_handler(&VehicleSnapshotPlugin::handle_extended_sys_state),
+			make_handler(&VehicleSnapshotPlugin::handle_sys_status),
+			make_handler(&VehicleSnapshotPlugin::handle_vfr_hud),
+			make_handler(&VehicleSnapshotPlugin::handle_altitude),
+			make_handler(&VehicleSnapshotPlugin::handle_wind_cov),
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
+			make_handler(&VehicleSnapshotPlugin::handle_apm_wind),
+#endif
+			make_handler(&VehicleSnapshotPlugin::handle_home_position),
+		};
+	}
+
+private:
+	using lock_guard = std::lock_guard<std::mutex>;
+
+	ros::NodeHandle nh;
+	plugin::LazyPublisher snapshot_pub;
+	Timer publish_timer;
+
+	//! handlers run in dispatch workers, publish_cb() in timer thread
+	std::mutex mutex;
+	mavros_msgs::VehicleSnapshot snapshot;
+
+	/* -*- message handlers -*- */
+
+	void handle_heartbeat(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HEARTBEAT &hb)
+	{
+		using mavlink::common::MAV_MODE_FLAG;
+
+		if (!m_uas->is_my_target(msg->sysid, msg->compid))
+			return;
+
+		auto mode = m_uas->str_mode_v10(hb.base_mode, hb.custom_mode);
+
+		lock_guard lock(mutex);
+		snapshot.state_stamp = ros::Time::now();
+		snapshot.connected = true;
+		snapshot.armed = !!(hb.base_mode & utils::enum_value(MAV_MODE_FLAG::SAFETY_ARMED));
+		snapshot.guided = !!(hb.base_mode & utils::enum_value(MAV_MODE_FLAG::GUIDED_ENABLED));
+		snapshot.mode.swap(mode);
+		snapshot.system_status = hb.system_status;
+	}
+
+	void handle_extended_sys_state(const mavlink::mavlink_message_t *msg, mavlink::common::msg::EXTENDED_SYS_STATE &state)
+	{
+		lock_guard lock(mutex);
+		snapshot.extended_state_stamp = ros::Time::now();
+		snapshot.vtol_state = state.vtol_state;
+		snapshot.landed_state = state.landed_state;
+	}
+
+	void handle_sys_status(const mavlink::mavlink_message_t *msg, mavlink::common::msg::SYS_STATUS &stat)
+	{
+		lock_guard lock(mutex);
+		snapshot.battery_stamp = ros::Time::now();
+		snapshot.voltage = stat.voltage_battery / 1000.0f;	// mV
+		// -1 sentinel kept as is, not scaled
+		snapshot.current = (stat.current_battery == -1) ? -1.0f : stat.current_battery / 100.0f;	// 10 mA
+		snapshot.remaining = (stat.battery_remaining == -1) ? -1.0f : stat.battery_remaining / 100.0f;
+	}
+
+	void handle_vfr_hud(const mavlink::mavlink_message_t *msg, mavlink::common::msg::VFR_HUD &vfr_hud)
+	{
+		lock_guard lock(mutex);
+		snapshot.vfr_hud_stamp = ros::Time::now();
+		snapshot.airspeed = vfr_hud.airspeed;
+		snapshot.groundspeed = vfr_hud.groundspeed;
+		snapshot.heading = vfr_hud.heading;
+		snapshot.throttle = vfr_hud.throttle / 100.0;	// comes in 0..100 range
+		snapshot.altitude = vfr_hud.alt;
+		snapshot.climb = vfr_hud.climb;
+	}
+
+	void handle_altitude(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ALTITUDE &altitude)
+	{
+		auto stamp = m_uas->synchronise_stamp(altitude.time_usec);
+
+		lock_guard lock(mutex);
+		snapshot.altitude_stamp = stamp;
+		snapshot.altitude_monotonic = altitude.altitude_monotonic;
+		snapshot.altitude_amsl = altitude.altitude_amsl;
+		snapshot.altitude_local = altitude.altitude_local;
+		snapshot.altitude_relative = altitude.altitude_relative;
+		snapshot.altitude_terrain = altitude.altitude_terrain;
+		snapshot.bottom_clearance = altitude.bottom_clearance;
+	}
+
+	void handle_wind_cov(const mavlink::mavlink_message_t *msg, mavlink::common::msg::WIND_COV &wind)
+	{
+		auto stamp = m_uas->synchronise_stamp(wind.time_usec);
+		auto wind_enu = ftf::transform_frame_ned_enu(Eigen::Vector3d(wind.wind_x, wind.wind_y, wind.wind_z));
+
+		lock_guard lock(mutex);
+		snapshot.wind_stamp = stamp;
+		tf::vectorEigenToMsg(wind_enu, snapshot.wind);
+	}
+
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
+	//! same conversion as wind_estimation plugin
+	void handle_apm_wind(const mavlink::mavlink_message_t *msg, mavlink::ardupilotmega::msg::WIND &wind)
+	{
+		const double speed = wind.speed;
+		const double course = -angles::from_degrees(wind.direction);	// direction "from" -> direction "to"
+
+		lock_guard lock(mutex);
+		snapshot.wind_stamp = ros::Time::now();
+		snapshot.wind.x = speed * std::sin(course);	// E
+		snapshot.wind.y = speed * std::cos(course);	// N
+		snapshot.wind.z = -wind.speed_z;		// D -> U
+	}
+#endif
+
+	void handle_home_position(const mavlink::mavlink_message_t *msg, mavlink::common::msg::HOME_POSITION &home_position)
+	{
+		geographic_msgs::GeoPoint geo;
+		geo.latitude = home_position.latitude / 1E7;		// deg
+		geo.longitude = home_position.longitude / 1E7;		// deg
+		geo.altitude = home_position.altitude / 1E3 + m_uas->geoid_to_ellipsoid_height(&geo);	// in meters
+
+		auto pos = ftf::transform_frame_ned_enu(Eigen::Vector3d(home_position.x, home_position.y, home_position.z));
+
+		lock_guard lock(mutex);
+		snapshot.home_stamp = ros::Time::now();
+		snapshot.home_geo = geo;
+		tf::pointEigenToMsg(pos, snapshot.home_position);
+	}
+
+	/* -*- callbacks -*- */
+
+	void publish_cb(const ros::TimerEvent &event)
+	{
+		if (!snapshot_pub.has_subscribers())
+			return;
+
+		auto msg = boost::make_shared<mavros_msgs::VehicleSnapshot>();
+		{
+			lock_guard lock(mutex);
+			*msg = snapshot;
+		}
+
+		msg->header.stamp = event.current_real;
+		snapshot_pub.publish(msg);
+	}
+
+	void connection_cb(bool connected) override
+	{
+		lock_guard lock(mutex);
+		snapshot.connected = connected;
+	}
+};
+}	// namespace std_plugins
+}	// namespace mavros
+
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::VehicleSnapshotPlugin)
@@ -27,7 +27,7 @@ namespace std_plugins {
 class VfrHudPlugin : public plugin::PluginBase {
 public:
 	VfrHudPlugin() : PluginBase(),
-		nh("~")
+		nh(private_nh())
 	{ }
 
 	/**
@@ -36,8 +36,9 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
-		vfr_pub = nh.advertise<mavros_msgs::VFR_HUD>("vfr_hud", 10);
+		vfr_pub.advertise<mavros_msgs::VFR_HUD>(nh, "vfr_hud", 10);
 	}
 
 	Subscriptions get_subscriptions()
@@ -50,10 +51,13 @@ public:
 private:
 	ros::NodeHandle nh;
 
-	ros::Publisher vfr_pub;
+	plugin::LazyPublisher vfr_pub;
 
 	void handle_vfr_hud(const mavlink::mavlink_message_t *msg, mavlink::common::msg::VFR_HUD &vfr_hud)
 	{
+		if (!vfr_pub.has_subscribers())
+			return;
+
 		auto vmsg = boost::make_shared<mavros_msgs::VFR_HUD>();
 		vmsg->header.stamp = ros::Time::now();
 		vmsg->airspeed = vfr_hud.airspeed;
@@ -69,5 +73,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::VfrHudPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::VfrHudPlugin)
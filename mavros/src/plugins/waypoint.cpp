@@ -15,8 +15,18 @@
  */
 
 #include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <condition_variable>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/crc.hpp>
 #include <mavros/mavros_plugin.h>
+#include <mavros/rtt_estimator.h>
 
 #include <mavros_msgs/WaypointList.h>
 #include <mavros_msgs/WaypointSetCurrent.h>
@@ -112,6 +122,31 @@ public:
 		return ret;
 	}
 
+	/**
+	 * @brief Compare items as FCU stores them
+	 *
+	 * Coordinates compared in wire precision (float), current flag ignored.
+	 */
+	bool same_as(const WaypointItem &o) const
+	{
+		// [[[cog:
+		// fields = [b for a, b in waypoint_item_msg if b not in ('current', 'x_lat', 'y_long', 'z_alt')]
+		// fields += [b for a, b in waypoint_coords]
+		// cog.outl("return %s;" % '\n\t&& '.join("%s == o.%s" % (f, f) for f in fields))
+		// ]]]
+		return frame == o.frame
+			&& command == o.command
+			&& autocontinue == o.autocontinue
+			&& param1 == o.param1
+			&& param2 == o.param2
+			&& param3 == o.param3
+			&& param4 == o.param4
+			&& x == o.x
+			&& y == o.y
+			&& z == o.z;
+		// [[[end]]] (checksum: bf2c68a78ed4a6a5349bd50de5331a8a)
+	}
+
 	std::string to_string()
 	{
 		//return to_yaml();
@@ -125,6 +160,192 @@ public:
 	}
 };
 
+/**
+ * @brief On-disk copy of FCU mission
+ *
+ * File: header, then items in MISSION_ITEM wire precision.
+ * Checksum covers items, it identifies mission content.
+ */
+class MissionCache {
+public:
+	//! Checksum of list as it will be stored
+	static uint32_t checksum(const std::vector<WaypointItem> &items)
+	{
+		auto records = encode(items);
+		boost::crc_32_type crc;
+		crc.process_bytes(records.data(), records.size() * sizeof(Record));
+		return crc.checksum();
+	}
+
+	/**
+	 * @brief Read mission file
+	 *
+	 * @return false if file missing or malformed
+	 */
+	static bool load(const std::string &path, uint32_t &crc, std::vector<WaypointItem> &items)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (::fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(Header)) {
+			::close(fd);
+			return false;
+		}
+
+		const size_t size = st.st_size;
+		void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED)
+			return false;
+
+		auto header = static_cast<const Header *>(map);
+		auto records = reinterpret_cast<const Record *>(header + 1);
+		bool valid = header->magic == MAGIC
+			     && header->version == VERSION
+			     && size == sizeof(Header) + header->count * sizeof(Record);
+
+		if (valid) {
+			boost::crc_32_type file_crc;
+			file_crc.process_bytes(records, header->count * sizeof(Record));
+			valid = file_crc.checksum() == header->crc;
+		}
+
+		if (valid) {
+			crc = header->crc;
+			items.clear();
+			items.reserve(header->count);
+
+			for (size_t i = 0; i < header->count; i++) {
+				auto &r = records[i];
+				WaypointItem wp{};
+
+				// [[[cog:
+				// cache_fields = [b for a, b in waypoint_item_msg if b not in ('x_lat', 'y_long', 'z_alt')]
+				// cache_fields += [b for a, b in waypoint_coords] + ['seq']
+				// for f in cache_fields:
+				//     cog.outl("wp.%s = r.%s;" % (f, f))
+				// for a, b in waypoint_coords:
+				//     cog.outl("wp.%s = r.%s;" % (a, b))
+				// ]]]
+				wp.frame = r.frame;
+				wp.command = r.command;
+				wp.current = r.current;
+				wp.autocontinue = r.autocontinue;
+				wp.param1 = r.param1;
+				wp.param2 = r.param2;
+				wp.param3 = r.param3;
+				wp.param4 = r.param4;
+				wp.x = r.x;
+				wp.y = r.y;
+				wp.z = r.z;
+				wp.seq = r.seq;
+				wp.x_lat = r.x;
+				wp.y_long = r.y;
+				wp.z_alt = r.z;
+				// [[[end]]] (checksum: adc37ee6cc323ab4814a3debe3f3bd1d)
+				wp.mission_type = enum_value(mavlink::common::MAV_MISSION_TYPE::MISSION);
+				items.push_back(wp);
+			}
+		}
+
+		::munmap(map, size);
+		return valid;
+	}
+
+	/**
+	 * @brief Write mission file
+	 *
+	 * Data written to temporary file which then renamed,
+	 * so reader never see partially written mission.
+	 */
+	static bool save(const std::string &path, const std::vector<WaypointItem> &items, uint32_t &crc)
+	{
+		auto records = encode(items);
+		boost::crc_32_type file_crc;
+		file_crc.process_bytes(records.data(), records.size() * sizeof(Record));
+		crc = file_crc.checksum();
+
+		Header header{MAGIC, VERSION, crc, uint32_t(records.size())};
+
+		const auto tmp_path = path + ".tmp";
+		int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+
+		const ssize_t data_size = records.size() * sizeof(Record);
+		bool ok = ::write(fd, &header, sizeof(header)) == ssize_t(sizeof(header));
+		ok = ok && ::write(fd, records.data(), data_size) == data_size;
+		ok = ::fsync(fd) == 0 && ok;
+		ok = ::close(fd) == 0 && ok;
+		ok = ok && ::rename(tmp_path.c_str(), path.c_str()) == 0;
+
+		if (!ok)
+			::unlink(tmp_path.c_str());
+
+		return ok;
+	}
+
+private:
+	static constexpr uint32_t MAGIC = 0x434d564d;	//!< "MVMC"
+	static constexpr uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t crc;
+		uint32_t count;
+	};
+
+	struct Record {
+		float param1;
+		float param2;
+		float param3;
+		float param4;
+		float x;
+		float y;
+		float z;
+		uint16_t seq;
+		uint16_t command;
+		uint8_t frame;
+		uint8_t current;
+		uint8_t autocontinue;
+		uint8_t reserved;
+	};
+
+	static std::vector<Record> encode(const std::vector<WaypointItem> &items)
+	{
+		std::vector<Record> records(items.size());
+
+		for (size_t i = 0; i < items.size(); i++) {
+			auto &wp = items[i];
+			auto &r = records[i];
+
+			r = Record{};
+			// [[[cog:
+			// for f in cache_fields:
+			//     cog.outl("r.%s = wp.%s;" % (f, f))
+			// ]]]
+			r.frame = wp.frame;
+			r.command = wp.command;
+			r.current = wp.current;
+			r.autocontinue = wp.autocontinue;
+			r.param1 = wp.param1;
+			r.param2 = wp.param2;
+			r.param3 = wp.param3;
+			r.param4 = wp.param4;
+			r.x = wp.x;
+			r.y = wp.y;
+			r.z = wp.z;
+			r.seq = wp.seq;
+			// [[[end]]] (checksum: 2cc0b3b56bbec47292a37bb156e5556e)
+		}
+
+		return records;
+	}
+};
+
 
 /**
  * @brief Mission manupulation plugin
@@ -132,7 +353,7 @@ public:
 class WaypointPlugin : public plugin::PluginBase {
 public:
 	WaypointPlugin() : PluginBase(),
-		wp_nh("~mission"),
+		wp_nh(private_nh("mission")),
 		wp_state(WP::IDLE),
 		wp_count(0),
 		wp_retries(RETRIES_COUNT),
@@ -143,6 +364,12 @@ public:
 		do_pull_after_gcs(false),
 		enable_partial_push(false),
 		reschedule_pull(false),
+		pipeline(false),
+		pipeline_window(8),
+		wp_rx_next(0),
+		cache_verify(true),
+		cache_valid(false),
+		cache_crc(0),
 		BOOTUP_TIME_DT(BOOTUP_TIME_MS / 1000.0),
 		LIST_TIMEOUT_DT(LIST_TIMEOUT_MS / 1000.0),
 		WP_TIMEOUT_DT(WP_TIMEOUT_MS / 1000.0),
@@ -152,22 +379,34 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(wp_nh);
 
 		wp_state = WP::IDLE;
 
 		wp_nh.param("pull_after_gcs", do_pull_after_gcs, true);
+		wp_nh.param("pipeline", pipeline, false);
+		wp_nh.param("pipeline_window", pipeline_window, 8);
+		pipeline_window = std::max(1, pipeline_window);
+
+		ros::NodeHandle cache_nh(private_nh("mission_cache"));
+		cache_nh.param<std::string>("dir", cache_dir, "");
+		cache_nh.param("verify", cache_verify, true);
+		if (!cache_dir.empty()) {
+			if (::mkdir(cache_dir.c_str(), 0755) < 0 && errno != EEXIST)
+				ROS_WARN_NAMED("wp", "WP: can't create cache dir %s: %s", cache_dir.c_str(), strerror(errno));
+			ROS_INFO_NAMED("wp", "WP: mission cache in %s", cache_dir.c_str());
+		}
 
 		wp_list_pub = wp_nh.advertise<mavros_msgs::WaypointList>("waypoints", 2, true);
 		wp_reached_pub = wp_nh.advertise<mavros_msgs::WaypointReached>("reached", 10, true);
 		pull_srv = wp_nh.advertiseService("pull", &WaypointPlugin::pull_cb, this);
 		push_srv = wp_nh.advertiseService("push", &WaypointPlugin::push_cb, this);
+		push_partial_srv = wp_nh.advertiseService("push_partial", &WaypointPlugin::push_partial_cb, this);
 		clear_srv = wp_nh.advertiseService("clear", &WaypointPlugin::clear_cb, this);
 		set_cur_srv = wp_nh.advertiseService("set_current", &WaypointPlugin::set_cur_cb, this);
 
-		wp_timer = wp_nh.createTimer(WP_TIMEOUT_DT, &WaypointPlugin::timeout_cb, this, true);
-		wp_timer.stop();
-		schedule_timer = wp_nh.createTimer(BOOTUP_TIME_DT, &WaypointPlugin::scheduled_pull_cb, this, true);
-		schedule_timer.stop();
+		make_timer(wp_timer, WP_TIMEOUT_DT, &WaypointPlugin::timeout_cb, true, false);
+		make_timer(schedule_timer, BOOTUP_TIME_DT, &WaypointPlugin::scheduled_pull_cb, true, false);
 		enable_connection_cb();
 	}
 
@@ -193,6 +432,7 @@ private:
 	ros::Publisher wp_reached_pub;
 	ros::ServiceServer pull_srv;
 	ros::ServiceServer push_srv;
+	ros::ServiceServer push_partial_srv;
 	ros::ServiceServer clear_srv;
 	ros::ServiceServer set_cur_srv;
 
@@ -224,18 +464,33 @@ private:
 	std::condition_variable list_receiving;
 	std::condition_variable list_sending;
 
-	ros::Timer wp_timer;
-	ros::Timer schedule_timer;
+	Timer wp_timer;
+	Timer schedule_timer;
 	bool do_pull_after_gcs;
 	bool enable_partial_push;
 
 	bool reschedule_pull;
 
+	bool pipeline;			//!< accelerated transfer: pull prefetch, RTT based timeout
+	int pipeline_window;		//!< pull requests in flight
+	RttEstimator wp_rtt;
+	ros::Time wp_tx_stamp;		//!< last request sent, zero if it was resent (Karn)
+	std::vector<bool> wp_received;	//!< pipelined pull: received items
+	std::unordered_map<size_t, ros::Time> wp_rx_inflight;	//!< pipelined pull: requested seq -> stamp
+	size_t wp_rx_next;		//!< pipelined pull: next seq to request
+
+	std::string cache_dir;		//!< mission cache location, empty - disabled
+	bool cache_verify;		//!< pull mission after serving cached one
+	bool cache_valid;		//!< cache_crc is checksum of cached FCU mission
+	uint32_t cache_crc;
+
 	static constexpr int BOOTUP_TIME_MS = 15000;	//! system startup delay before start pull
 	static constexpr int LIST_TIMEOUT_MS = 30000;	//! Timeout for pull/push operations
 	static constexpr int WP_TIMEOUT_MS = 1000;
 	static constexpr int RESCHEDULE_MS = 5000;
 	static constexpr int RETRIES_COUNT = 3;
+	static constexpr int RTO_MIN_MS = 100;		//! pipeline mode timeout lower bound
+	static constexpr size_t DIFF_MERGE_GAP = 2;	//! unchanged items resent to save one partial write handshake
 
 	const ros::Duration BOOTUP_TIME_DT;
 	const ros::Duration LIST_TIMEOUT_DT;
@@ -265,7 +520,39 @@ private:
 		// [[[end]]] (checksum: b8f95ce9c7c9dbd4eb493bf1227f273f)
 
 		/* receive item only in RX state */
-		if (wp_state == WP::RXWP) {
+		if (wp_state == WP::RXWP && pipeline) {
+			if (wpi.seq >= wp_count || wp_received[wpi.seq]) {
+				ROS_DEBUG_NAMED("wp", "WP: duplicate item %d, dropping", wpi.seq);
+				return;
+			}
+
+			ROS_INFO_STREAM_NAMED("wp", "WP: item " << wpi.to_string());
+
+			auto rq_it = wp_rx_inflight.find(wpi.seq);
+			if (rq_it != wp_rx_inflight.end()) {
+				if (!rq_it->second.isZero())
+					wp_rtt.update((ros::Time::now() - rq_it->second).toSec());
+				wp_rx_inflight.erase(rq_it);
+			}
+
+			waypoints[wpi.seq] = wpi;
+			wp_received[wpi.seq] = true;
+			while (wp_cur_id < wp_count && wp_received[wp_cur_id])
+				wp_cur_id++;
+
+			if (wp_cur_id < wp_count) {
+				restart_timeout_timer();
+				fill_rx_window();
+			}
+			else {
+				request_mission_done();
+				bool changed = save_cache();
+				lock.unlock();
+				if (changed)
+					publish_waypoints();
+			}
+		}
+		else if (wp_state == WP::RXWP) {
 			if (wpi.seq != wp_cur_id) {
 				ROS_WARN_NAMED("wp", "WP: Seq mismatch, dropping item (%d != %zu)",
 					wpi.seq, wp_cur_id);
@@ -273,6 +560,7 @@ private:
 			}
 
 			ROS_INFO_STREAM_NAMED("wp", "WP: item " << wpi.to_string());
+			rtt_sample();
 
 			waypoints.push_back(wpi);
 			if (++wp_cur_id < wp_count) {
@@ -281,8 +569,10 @@ private:
 			}
 			else {
 				request_mission_done();
+				bool changed = save_cache();
 				lock.unlock();
-				publish_waypoints();
+				if (changed)
+					publish_waypoints();
 			}
 		}
 		else {
@@ -311,6 +601,10 @@ private:
 				return;
 			}
 
+			// repeated request means our item lost, its time is not RTT
+			if (wp_state != WP::TXWP || mreq.seq != wp_cur_id)
+				rtt_sample();
+
 			restart_timeout_timer();
 			if (mreq.seq < wp_end_id) {
 				ROS_DEBUG_NAMED("wp", "WP: FCU requested waypoint %d", mreq.seq);
@@ -372,21 +666,34 @@ private:
 			/* FCU report of MISSION_REQUEST_LIST */
 			ROS_DEBUG_NAMED("wp", "WP: count %d", mcnt.count);
 
+			rtt_sample();
 			wp_count = mcnt.count;
 			wp_cur_id = 0;
 
 			waypoints.clear();
 			waypoints.reserve(wp_count);
 
-			if (wp_count > 0) {
+			if (wp_count > 0 && pipeline) {
+				wp_state = WP::RXWP;
+				waypoints.resize(wp_count);
+				wp_received.assign(wp_count, false);
+				wp_rx_inflight.clear();
+				wp_rx_next = 0;
+
+				restart_timeout_timer();
+				fill_rx_window();
+			}
+			else if (wp_count > 0) {
 				wp_state = WP::RXWP;
 				restart_timeout_timer();
 				mission_request(wp_cur_id);
 			}
 			else {
 				request_mission_done();
+				bool changed = save_cache();
 				lock.unlock();
-				publish_waypoints();
+				if (changed)
+					publish_waypoints();
 			}
 		}
 		else {
@@ -436,6 +743,7 @@ private:
 			go_idle();
 			waypoints = send_waypoints;
 			send_waypoints.clear();
+			save_cache();
 
 			lock.unlock();
 			list_sending.notify_all();
@@ -466,6 +774,7 @@ private:
 			}
 			else {
 				waypoints.clear();
+				save_cache();
 				lock.unlock();
 				publish_waypoints();
 				ROS_INFO_NAMED("wp", "WP: mission cleared");
@@ -490,12 +799,18 @@ private:
 			wp_retries--;
 			ROS_WARN_NAMED("wp", "WP: timeout, retries left %zu", wp_retries);
 
+			// reply to resent request can't be used as RTT sample
+			wp_tx_stamp = ros::Time();
+
 			switch (wp_state) {
 			case WP::RXLIST:
 				mission_request_list();
 				break;
 			case WP::RXWP:
-				mission_request(wp_cur_id);
+				if (pipeline)
+					resend_rx_window();
+				else
+					mission_request(wp_cur_id);
 				break;
 			case WP::TXLIST:
 				mission_count(wp_count);
@@ -521,6 +836,10 @@ private:
 		}
 		else {
 			ROS_ERROR_NAMED("wp", "WP: timed out.");
+			// pipelined pull: keep only received head of list
+			if (wp_state == WP::RXWP && pipeline)
+				waypoints.resize(wp_cur_id);
+
 			go_idle();
 			is_timedout = true;
 			/* prevent waiting cond var timeout */
@@ -535,7 +854,8 @@ private:
 	{
 		lock_guard lock(mutex);
 		if (connected) {
-			schedule_pull(BOOTUP_TIME_DT);
+			if (!load_cache() || cache_verify)
+				schedule_pull(BOOTUP_TIME_DT);
 
 			if (wp_nh.hasParam("enable_partial_push")) {
 				wp_nh.getParam("enable_partial_push", enable_partial_push);
@@ -567,6 +887,72 @@ private:
 		mission_request_list();
 	}
 
+	//! Cache file of current FCU, empty if cache disabled
+	std::string cache_path()
+	{
+		if (cache_dir.empty())
+			return "";
+
+		return utils::format("%s/mission_%u_%u.bin", cache_dir.c_str(),
+				m_uas->get_tgt_system(), m_uas->get_tgt_component());
+	}
+
+	/**
+	 * @brief Serve cached mission of connected FCU
+	 *
+	 * MISSION_COUNT of this MAVLink dialect carries no mission id,
+	 * so cached mission can only be confirmed by pull (@a cache_verify).
+	 *
+	 * @return false if there is no cached mission
+	 */
+	bool load_cache()
+	{
+		cache_valid = false;
+
+		auto path = cache_path();
+		std::vector<WaypointItem> items;
+		uint32_t crc;
+		if (path.empty() || !MissionCache::load(path, crc, items))
+			return false;
+
+		ROS_INFO_NAMED("wp", "WP: loaded %zu cached items", items.size());
+		waypoints = std::move(items);
+		cache_crc = crc;
+		cache_valid = true;
+
+		wp_cur_active = 0;
+		for (auto &it : waypoints) {
+			if (it.current)
+				wp_cur_active = it.seq;
+		}
+
+		publish_waypoints();
+		return true;
+	}
+
+	/**
+	 * @brief Store FCU mission to cache
+	 *
+	 * @return false if cache already had same mission
+	 */
+	bool save_cache()
+	{
+		auto path = cache_path();
+		if (path.empty())
+			return true;
+
+		if (cache_valid && MissionCache::checksum(waypoints) == cache_crc) {
+			ROS_DEBUG_NAMED("wp", "WP: mission same as cached");
+			return false;
+		}
+
+		cache_valid = MissionCache::save(path, waypoints, cache_crc);
+		if (!cache_valid)
+			ROS_WARN_NAMED("wp", "WP: can't write cache %s: %s", path.c_str(), strerror(errno));
+
+		return true;
+	}
+
 	//! @brief Send ACK back to FCU after pull
 	void request_mission_done(void)
 	{
@@ -588,6 +974,7 @@ private:
 	void restart_timeout_timer(void)
 	{
 		wp_retries = RETRIES_COUNT;
+		wp_tx_stamp = ros::Time::now();
 		restart_timeout_timer_int();
 	}
 
@@ -595,13 +982,60 @@ private:
 	{
 		is_timedout = false;
 		wp_timer.stop();
+		wp_timer.setPeriod(wp_timeout().toSec());
 		wp_timer.start();
 	}
 
+	/**
+	 * @brief Retry timeout
+	 *
+	 * In pipeline mode it follows RTT and doubles with each retry,
+	 * but never exceeds WP_TIMEOUT_DT, so retries end not later than in normal mode.
+	 */
+	ros::Duration wp_timeout()
+	{
+		if (!pipeline)
+			return WP_TIMEOUT_DT;
+
+		const double max_s = WP_TIMEOUT_DT.toSec();
+		const double rto = wp_rtt.timeout(RTO_MIN_MS / 1000.0, max_s) * (1 << (RETRIES_COUNT - wp_retries));
+		return ros::Duration(std::min(max_s, rto));
+	}
+
+	//! Reply to request sent by restart_timeout_timer() caller received
+	void rtt_sample()
+	{
+		if (!wp_tx_stamp.isZero())
+			wp_rtt.update((ros::Time::now() - wp_tx_stamp).toSec());
+	}
+
+	//! Pipelined pull: keep pipeline_window MISSION_REQUESTs in flight
+	void fill_rx_window()
+	{
+		const auto now = ros::Time::now();
+
+		while (wp_rx_inflight.size() < size_t(pipeline_window) && wp_rx_next < wp_count) {
+			const size_t seq = wp_rx_next++;
+			if (wp_received[seq])
+				continue;
+
+			wp_rx_inflight[seq] = now;
+			mission_request(seq);
+		}
+	}
+
+	void resend_rx_window()
+	{
+		for (auto &kv : wp_rx_inflight) {
+			kv.second = ros::Time();
+			mission_request(kv.first);
+		}
+	}
+
 	void schedule_pull(const ros::Duration &dt)
 	{
 		schedule_timer.stop();
-		schedule_timer.setPeriod(dt);
+		schedule_timer.setPeriod(dt.toSec());
 		schedule_timer.start();
 	}
 
@@ -609,13 +1043,20 @@ private:
 	void send_waypoint(size_t seq)
 	{
 		if (seq < send_waypoints.size()) {
-			auto wpi = send_waypoints.at(seq);
+			auto &wpi = send_waypoints[seq];
 			mission_item(wpi);
 
 			ROS_DEBUG_STREAM_NAMED("wp", "WP: send item " << wpi.to_string());
 		}
 	}
 
+	//! @brief set target of items once, so requested item sent as is
+	void prepare_send_waypoints()
+	{
+		for (auto &wp : send_waypoints)
+			m_uas->msg_set_target(wp);
+	}
+
 	/**
 	 * @brief wait until a waypoint pull is complete.
 	 * Pull happens asyncronously, this function blocks until it is done.
@@ -667,9 +1108,9 @@ private:
 
 	/* -*- low-level send functions -*- */
 
-	void mission_item(WaypointItem &wp)
+	//! target ids set by prepare_send_waypoints()
+	void mission_item(const WaypointItem &wp)
 	{
-		m_uas->msg_set_target(wp);
 		// WaypointItem may be sent as MISSION_ITEM
 		UAS_FCU(m_uas)->send_message_ignore_drop(wp);
 	}
@@ -774,6 +1215,72 @@ private:
 		return true;
 	}
 
+	/**
+	 * @brief upload send_waypoints as new mission
+	 * Lock held on entry and exit, released while waiting.
+	 */
+	bool send_full(unique_lock &lock)
+	{
+		wp_state = WP::TXLIST;
+		prepare_send_waypoints();
+
+		wp_count = send_waypoints.size();
+		wp_end_id = wp_count;
+		wp_cur_id = 0;
+		restart_timeout_timer();
+
+		lock.unlock();
+		mission_count(wp_count);
+		bool ret = wait_push_all();
+		lock.lock();
+
+		return ret;
+	}
+
+	/**
+	 * @brief upload items [start, end) of send_waypoints
+	 * Lock held on entry and exit, released while waiting.
+	 */
+	bool send_partial(unique_lock &lock, size_t start, size_t end)
+	{
+		wp_state = WP::TXPARTIAL;
+		prepare_send_waypoints();
+
+		wp_count = end - start;
+		wp_start_id = start;
+		wp_end_id = end;
+		wp_cur_id = start;
+		restart_timeout_timer();
+
+		lock.unlock();
+		mission_write_partial_list(wp_start_id, wp_end_id);
+		bool ret = wait_push_all();
+		lock.lock();
+
+		return ret;
+	}
+
+	/**
+	 * @brief find items of @a new_list which differ from FCU mission
+	 * @return ranges [start, end), close ones merged
+	 */
+	std::vector<std::pair<size_t, size_t>> diff_waypoints(const std::vector<WaypointItem> &new_list)
+	{
+		std::vector<std::pair<size_t, size_t>> ranges;
+
+		for (size_t i = 0; i < new_list.size(); i++) {
+			if (new_list[i].same_as(waypoints[i]))
+				continue;
+
+			if (!ranges.empty() && i - ranges.back().second <= DIFF_MERGE_GAP)
+				ranges.back().second = i + 1;
+			else
+				ranges.emplace_back(i, i + 1);
+		}
+
+		return ranges;
+	}
+
 	bool push_cb(mavros_msgs::WaypointPush::Request &req,
 		mavros_msgs::WaypointPush::Response &res)
 	{
@@ -800,7 +1307,6 @@ private:
 				return true;
 			}
 
-			wp_state = WP::TXPARTIAL;
 			send_waypoints = waypoints;
 
 			uint16_t seq = req.start_index;
@@ -809,23 +1315,11 @@ private:
 				seq++;
 			}
 
-			wp_count = req.waypoints.size();
-			wp_start_id = req.start_index;
-			wp_end_id = req.start_index + wp_count;
-			wp_cur_id = req.start_index;
-			restart_timeout_timer();
-
-			lock.unlock();
-			mission_write_partial_list(wp_start_id, wp_end_id);
-			res.success = wait_push_all();
-			lock.lock();
-
+			res.success = send_partial(lock, req.start_index, req.start_index + req.waypoints.size());
 			res.wp_transfered = wp_cur_id - wp_start_id + 1;
 		}
 		else {
 			// Full waypoint update
-			wp_state = WP::TXLIST;
-
 			send_waypoints.clear();
 			send_waypoints.reserve(req.waypoints.size());
 			uint16_t seq = 0;
@@ -833,20 +1327,71 @@ private:
 				send_waypoints.push_back(WaypointItem::from_msg(it, seq++));
 			}
 
-			wp_count = send_waypoints.size();
-			wp_end_id = wp_count;
-			wp_cur_id = 0;
-			restart_timeout_timer();
+			res.success = send_full(lock);
+			res.wp_transfered = wp_cur_id + 1;
+		}
 
-			lock.unlock();
-			mission_count(wp_count);
-			res.success = wait_push_all();
-			lock.lock();
+		go_idle();	// same as in pull_cb
+		return true;
+	}
+
+	/**
+	 * @brief push whole mission, but transfer only changed items
+	 *
+	 * New list compared to FCU mission, each changed range
+	 * sent by MISSION_WRITE_PARTIAL_LIST. Full upload used
+	 * if item count changed, partial push not enabled, or FCU rejected partial write.
+	 * start_index of request ignored.
+	 */
+	bool push_partial_cb(mavros_msgs::WaypointPush::Request &req,
+		mavros_msgs::WaypointPush::Response &res)
+	{
+		unique_lock lock(mutex);
+
+		if (wp_state != WP::IDLE)
+			return false;
+
+		std::vector<WaypointItem> new_list;
+		new_list.reserve(req.waypoints.size());
+		uint16_t seq = 0;
+		for (auto &it : req.waypoints) {
+			new_list.push_back(WaypointItem::from_msg(it, seq++));
+		}
 
+		if (!enable_partial_push || waypoints.empty() || waypoints.size() != new_list.size()) {
+			ROS_DEBUG_NAMED("wp", "WP: diff push not possible, full upload");
+			send_waypoints = std::move(new_list);
+			res.success = send_full(lock);
 			res.wp_transfered = wp_cur_id + 1;
+			go_idle();
+			return true;
 		}
 
-		go_idle();	// same as in pull_cb
+		auto ranges = diff_waypoints(new_list);
+		ROS_DEBUG_NAMED("wp", "WP: diff push, %zu changed ranges", ranges.size());
+
+		res.success = true;
+		res.wp_transfered = 0;
+		for (auto &r : ranges) {
+			// waypoints updated on each ACK, so it always mirrors FCU
+			send_waypoints = waypoints;
+			std::copy(new_list.begin() + r.first, new_list.begin() + r.second,
+				send_waypoints.begin() + r.first);
+
+			if (!send_partial(lock, r.first, r.second)) {
+				ROS_WARN_NAMED("wp", "WP: partial write %zu - %zu failed, fall back to full upload",
+					r.first, r.second);
+
+				send_waypoints = std::move(new_list);
+				res.success = send_full(lock);
+				res.wp_transfered = wp_cur_id + 1;
+				break;
+			}
+
+			res.wp_transfered += r.second - r.first;
+		}
+
+		go_idle();
 		return true;
 	}
 
@@ -894,5 +1439,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::WaypointPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::WaypointPlugin)
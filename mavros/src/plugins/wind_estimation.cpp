@@ -29,7 +29,7 @@ namespace std_plugins {
 class WindEstimationPlugin : public plugin::PluginBase {
 public:
 	WindEstimationPlugin() : PluginBase(),
-		nh("~")
+		nh(private_nh())
 	{ }
 
 	/**
@@ -38,6 +38,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		wind_pub = nh.advertise<geometry_msgs::TwistWithCovarianceStamped>("wind_estimation", 10);
 	}
@@ -45,7 +46,9 @@ public:
 	Subscriptions get_subscriptions()
 	{
 		return {
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 			       make_handler(&WindEstimationPlugin::handle_apm_wind),
+#endif
 			       make_handler(&WindEstimationPlugin::handle_px4_wind),
 		};
 	}
@@ -55,6 +58,7 @@ private:
 
 	ros::Publisher wind_pub;
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 	/**
 	 * Handle APM specific wind estimation message
 	 */
@@ -77,6 +81,7 @@ private:
 
 		wind_pub.publish(twist_cov);
 	}
+#endif
 
 	/**
 	 * Handle PX4 specific wind estimation message
@@ -101,5 +106,5 @@ private:
 }	// namespace std_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::std_plugins::WindEstimationPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::std_plugins::WindEstimationPlugin)
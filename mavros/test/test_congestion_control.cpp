@@ -0,0 +1,90 @@
+/**
+ * Test libmavros congestion control
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/congestion_control.h>
+
+using namespace mavros;
+
+TEST(CONGESTION_CONTROL, multiplicative_decrease)
+{
+	CongestionControl cc;
+
+	// free link: nothing to restore
+	EXPECT_FALSE(cc.update(100, 0, 0));
+	EXPECT_EQ(1.0, cc.scale());
+	EXPECT_EQ(CongestionControl::State::increase, cc.state());
+
+	EXPECT_TRUE(cc.update(10, 0, 0));
+	EXPECT_DOUBLE_EQ(0.5, cc.scale());
+	EXPECT_TRUE(cc.update(10, 0, 0));
+	EXPECT_DOUBLE_EQ(0.25, cc.scale());
+
+	// hold between thresholds
+	EXPECT_FALSE(cc.update(50, 0, 0));
+	EXPECT_EQ(CongestionControl::State::hold, cc.state());
+	EXPECT_DOUBLE_EQ(0.25, cc.scale());
+
+	// never below min scale
+	for (int i = 0; i < 10; i++)
+		cc.update(0, 0, 0);
+	EXPECT_DOUBLE_EQ(0.1, cc.scale());
+	EXPECT_EQ(4U, cc.decreases());
+}
+
+TEST(CONGESTION_CONTROL, additive_increase)
+{
+	CongestionControl cc;
+
+	cc.update(0, 0, 0);
+	ASSERT_DOUBLE_EQ(0.5, cc.scale());
+
+	for (int i = 1; i <= 5; i++) {
+		EXPECT_TRUE(cc.update(90, 0, 0));
+		EXPECT_NEAR(0.5 + 0.1 * i, cc.scale(), 1e-9);
+	}
+
+	EXPECT_FALSE(cc.update(90, 0, 0));
+	EXPECT_EQ(1.0, cc.scale());
+}
+
+TEST(CONGESTION_CONTROL, rxerrors_and_queue)
+{
+	CongestionControl cc;
+
+	// first report only sets error base
+	EXPECT_FALSE(cc.update(90, 1000, 0));
+
+	// few new errors: no increase, no decrease
+	cc.update(90, 1003, 0);
+	EXPECT_EQ(CongestionControl::State::hold, cc.state());
+
+	// error burst
+	EXPECT_TRUE(cc.update(90, 1020, 0));
+	EXPECT_DOUBLE_EQ(0.5, cc.scale());
+
+	// counter wraps
+	cc.update(90, 65534, 0);
+	EXPECT_EQ(CongestionControl::State::decrease, cc.state());
+	cc.update(90, 1, 0);
+	EXPECT_EQ(CongestionControl::State::hold, cc.state());
+
+	// our Tx queue backs up
+	cc.update(90, 1, 33);
+	EXPECT_EQ(CongestionControl::State::decrease, cc.state());
+	cc.update(90, 1, 20);
+	EXPECT_EQ(CongestionControl::State::hold, cc.state());
+	cc.update(90, 1, 4);
+	EXPECT_EQ(CongestionControl::State::increase, cc.state());
+
+	cc.reset();
+	EXPECT_EQ(1.0, cc.scale());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+/**
+ * Test diagnostic values cache
+ */
+
+#include <gtest/gtest.h>
+#include <mavros/diag_updater.h>
+
+using mavros::DiagCache;
+using diagnostic_updater::DiagnosticStatusWrapper;
+
+TEST(DIAG_CACHE, format_on_change)
+{
+	DiagCache cache;
+	int formatted = 0;
+
+	auto run = [&](int value) {
+		DiagnosticStatusWrapper stat;
+		cache.begin(stat).add("Value", {double(value)}, [&]() {
+					formatted++;
+					return std::to_string(value);
+				});
+		return stat;
+	};
+
+	auto s1 = run(1);
+	auto s2 = run(1);
+	auto s3 = run(2);
+
+	EXPECT_EQ(2, formatted);
+	ASSERT_EQ(1U, s2.values.size());
+	EXPECT_EQ("Value", s2.values[0].key);
+	EXPECT_EQ("1", s2.values[0].value);
+	EXPECT_EQ("2", s3.values[0].value);
+}
+
+TEST(DIAG_CACHE, addf)
+{
+	DiagCache cache;
+
+	for (unsigned i = 0; i < 2; i++) {
+		DiagnosticStatusWrapper stat;
+		auto &c = cache.begin(stat);
+		c.addf("Count:", "%u", 10U + i);
+		c.addf("Rate:", "%.1f / %.1f", 0.5, 1.5);
+
+		ASSERT_EQ(2U, stat.values.size());
+		EXPECT_EQ(std::to_string(10 + i), stat.values[0].value);
+		EXPECT_EQ("0.5 / 1.5", stat.values[1].value);
+	}
+
+	// not run by DiagUpdater, nothing collected
+	DiagnosticStatusWrapper stat;
+	EXPECT_EQ(nullptr, mavros::DiagUpdater::running_values(stat));
+	EXPECT_FALSE(mavros::DiagUpdater::running_quiet(stat));
+}
+
+TEST(DIAG_CACHE, optional_entry)
+{
+	DiagCache cache;
+
+	for (int i = 0; i < 3; i++) {
+		DiagnosticStatusWrapper stat;
+		auto &c = cache.begin(stat);
+		c.addf("First", "%d", 1);
+		if (i == 1)
+			c.addf("Optional", "%d", 2);
+		c.addf("Last", "%d", 3);
+
+		ASSERT_EQ(i == 1 ? 3U : 2U, stat.values.size());
+		EXPECT_EQ("Last", stat.values.back().key);
+		EXPECT_EQ("3", stat.values.back().value);
+	}
+}
+
+TEST(DIAG_CACHE, strings)
+{
+	DiagCache cache;
+	std::string mode = "MANUAL";
+
+	for (int i = 0; i < 2; i++) {
+		DiagnosticStatusWrapper stat;
+		auto &c = cache.begin(stat);
+		c.add("Mode", mode);
+		c.add("GPS", (i == 0) ? "Ok" : "Fail");
+
+		ASSERT_EQ(2U, stat.values.size());
+		EXPECT_EQ(mode, stat.values[0].value);
+		EXPECT_EQ((i == 0) ? "Ok" : "Fail", stat.values[1].value);
+		mode = "OFFBOARD";
+	}
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
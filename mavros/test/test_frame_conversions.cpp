@@ -2,6 +2,8 @@
  * Test libmavros frame conversion utilities
  */
 
+#include <chrono>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include <ros/ros.h>
@@ -133,6 +135,202 @@ TEST(FRAME_TF, quaternion_transforms__ned_to_ned_123)
 	EXPECT_QUATERNION(input_aircraft_ned_orient, output_aircraft_ned, epsilon);
 }
 
+/* -*- test compile time static transform kernels -*- */
+
+//! reference R * cov * R^T with full block diagonal rotation matrix
+template<size_t D>
+static boost::array<double, D * D> reference_rotate_covariance(const boost::array<double, D * D> &cov, const Eigen::Quaterniond &q)
+{
+	using Matrix = Eigen::Matrix<double, D, D, Eigen::RowMajor>;
+
+	Matrix R = Matrix::Zero();
+	for (size_t i = 0; i < D; i += 3)
+		R.template block<3, 3>(i, i) = q.normalized().toRotationMatrix();
+
+	boost::array<double, D * D> out;
+	Eigen::Map<Matrix>(out.data()) = R * Eigen::Map<const Matrix>(cov.data()) * R.transpose();
+	return out;
+}
+
+template<size_t N>
+static boost::array<double, N> make_covariance()
+{
+	boost::array<double, N> cov;
+	for (size_t i = 0; i < N; i++)
+		cov[i] = 1.0 + i;
+
+	return cov;
+}
+
+TEST(FRAME_TF, transform_static_frame__covariance3x3_ned_to_enu)
+{
+	auto input = make_covariance<9>();
+	ftf::Covariance3d expected = {{
+		 5.0,  4.0, -6.0,
+		 2.0,  1.0, -3.0,
+		-8.0, -7.0,  9.0
+	}};
+
+	auto out = ftf::transform_frame_ned_enu(input);
+
+	for (size_t idx = 0; idx < expected.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_EQ(expected[idx], out[idx]);
+	}
+}
+
+TEST(FRAME_TF, transform_static_frame__covariance6x6_ned_to_enu)
+{
+	auto input = make_covariance<36>();
+	auto expected = reference_rotate_covariance<6>(input, ftf::quaternion_from_rpy(M_PI, 0.0, M_PI_2));
+
+	auto out = ftf::detail::transform_static_frame(input, ftf::StaticTF::NED_TO_ENU);
+
+	for (size_t idx = 0; idx < expected.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_NEAR(expected[idx], out[idx], epsilon);
+	}
+}
+
+TEST(FRAME_TF, transform_static_frame__covariance9x9_aircraft_to_baselink)
+{
+	auto input = make_covariance<81>();
+	auto expected = reference_rotate_covariance<9>(input, ftf::quaternion_from_rpy(M_PI, 0.0, 0.0));
+
+	auto out = ftf::transform_frame_aircraft_baselink(input);
+
+	for (size_t idx = 0; idx < expected.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_NEAR(expected[idx], out[idx], epsilon);
+	}
+}
+
+TEST(FRAME_TF, transform_static_frame__batch_in_place)
+{
+	std::vector<Eigen::Vector3d> points;
+	for (int i = 0; i < 100; i++)
+		points.emplace_back(i, 2.0 * i, -3.0 * i);
+
+	auto expected = points;
+	for (auto &p : expected)
+		p = ftf::transform_frame_enu_ned(p);
+
+	ftf::transform_frame_enu_ned(points.data(), points.data(), points.size());
+
+	for (size_t idx = 0; idx < points.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_EQ(expected[idx], points[idx]);
+	}
+}
+
+TEST(FRAME_TF, rotate_covariance__9x9_block_diagonal)
+{
+	const auto q = ftf::quaternion_from_rpy(0.1, -0.4, 2.0);
+	auto cov = make_covariance<81>();
+	// off diagonal blocks often empty
+	for (size_t r = 0; r < 3; r++)
+		for (size_t c = 3; c < 9; c++)
+			cov[r * 9 + c] = cov[c * 9 + r] = 0.0;
+
+	auto expected = reference_rotate_covariance<9>(cov, q);
+
+	ftf::rotate_covariance(cov, q);
+
+	for (size_t idx = 0; idx < expected.size(); idx++) {
+		SCOPED_TRACE(idx);
+		EXPECT_NEAR(expected[idx], cov[idx], epsilon);
+	}
+}
+
+TEST(FRAME_TF, rotate_covariance__unknown)
+{
+	const auto q = ftf::quaternion_from_rpy(0.1, -0.4, 2.0);
+	ftf::Covariance6d unknown {};
+	unknown[0] = -1.0;
+	ftf::Covariance6d zero {};
+
+	auto unknown_out = ftf::detail::transform_frame(unknown, q);
+	auto unknown_static_out = ftf::transform_frame_ned_enu(unknown);
+	ftf::rotate_covariance(zero, q);
+
+	EXPECT_EQ(unknown, unknown_out);
+	EXPECT_EQ(unknown, unknown_static_out);
+	EXPECT_EQ(ftf::Covariance6d {}, zero);
+}
+
+/* -*- benchmarks, timings reported as test properties -*- */
+
+template<typename Fn>
+static double bench_ns(size_t iterations, Fn fn)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++)
+		fn(i);
+
+	std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - start;
+	return dt.count() / iterations;
+}
+
+TEST(FRAME_TF, benchmark__covariance6x6)
+{
+	constexpr size_t iterations = 100000;
+	const auto q = ftf::quaternion_from_rpy(M_PI, 0.0, M_PI_2);
+	auto cov = make_covariance<36>();
+	volatile double sink = 0.0;
+
+	double rotation_ns = bench_ns(iterations, [&](size_t i) {
+			cov[0] = i;
+			sink = ftf::detail::transform_frame(cov, q)[7];
+		});
+	double kernel_ns = bench_ns(iterations, [&](size_t i) {
+			cov[0] = i;
+			sink = ftf::transform_frame_ned_enu(cov)[7];
+		});
+
+	RecordProperty("rotation_ns", std::to_string(rotation_ns));
+	RecordProperty("kernel_ns", std::to_string(kernel_ns));
+}
+
+TEST(FRAME_TF, benchmark__rotate_covariance9x9)
+{
+	constexpr size_t iterations = 100000;
+	const auto q = ftf::quaternion_from_rpy(0.1, -0.4, 2.0);
+	auto cov = make_covariance<81>();
+	volatile double sink = 0.0;
+
+	double dense_ns = bench_ns(iterations, [&](size_t i) {
+			cov[0] = i;
+			sink = reference_rotate_covariance<9>(cov, q)[10];
+		});
+	double block_ns = bench_ns(iterations, [&](size_t i) {
+			cov[0] = i;
+			ftf::rotate_covariance(cov, q);
+			sink = cov[10];
+		});
+
+	RecordProperty("dense_ns", std::to_string(dense_ns));
+	RecordProperty("block_ns", std::to_string(block_ns));
+}
+
+TEST(FRAME_TF, benchmark__batch_points)
+{
+	constexpr size_t iterations = 1000;
+	const auto q = ftf::quaternion_from_rpy(M_PI, 0.0, M_PI_2);
+	std::vector<Eigen::Vector3d> points(1000, Eigen::Vector3d(1.0, 2.0, 3.0));
+	std::vector<Eigen::Vector3d> out(points.size());
+
+	double matmul_ns = bench_ns(iterations, [&](size_t) {
+			for (size_t i = 0; i < points.size(); i++)
+				out[i] = ftf::detail::transform_frame(points[i], q);
+		});
+	double kernel_ns = bench_ns(iterations, [&](size_t) {
+			ftf::transform_frame_ned_enu(points.data(), out.data(), points.size());
+		});
+
+	RecordProperty("matmul_ns", std::to_string(matmul_ns));
+	RecordProperty("kernel_ns", std::to_string(kernel_ns));
+}
+
 #if 0
 // not implemented
 TEST(FRAME_TF, transform_static_frame__quaterniond_123)
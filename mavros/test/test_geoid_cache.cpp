@@ -0,0 +1,86 @@
+/**
+ * Test libmavros geoid height cache
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/geoid_cache.h>
+
+using namespace mavros;
+
+//! smooth analytic stand-in for geoid model, counts evaluations
+struct FakeGeoid {
+	size_t calls = 0;
+
+	double operator()(double lat, double lon) {
+		calls++;
+		return 30.0 * std::sin(lat * M_PI / 90.0) + 10.0 * std::cos(lon * M_PI / 45.0);
+	}
+};
+
+TEST(GEOID_CACHE, no_model)
+{
+	GeoidCache cache;
+
+	EXPECT_FALSE(cache.is_valid());
+	EXPECT_EQ(0.0, cache.height(47.0, 8.0));
+	EXPECT_EQ(0U, cache.preload(47.0, 8.0, 1000.0));
+}
+
+TEST(GEOID_CACHE, lookup_memo)
+{
+	FakeGeoid geoid;
+	GeoidCache cache([&geoid](double lat, double lon) { return geoid(lat, lon); });
+
+	const double lat = 47.3977419, lon = 8.5455938;
+	FakeGeoid exact;
+
+	EXPECT_NEAR(exact(lat, lon), cache.height(lat, lon), 1e-3);
+	EXPECT_EQ(4U, geoid.calls);
+
+	// same cell, no model evaluations
+	EXPECT_NEAR(exact(lat + 1e-4, lon - 1e-4), cache.height(lat + 1e-4, lon - 1e-4), 1e-3);
+	EXPECT_EQ(4U, geoid.calls);
+
+	// other hemisphere does not evict first cell
+	EXPECT_NEAR(exact(-33.9, -151.2), cache.height(-33.9, -151.2), 1e-3);
+	EXPECT_EQ(8U, geoid.calls);
+	cache.height(lat, lon);
+	EXPECT_EQ(8U, geoid.calls);
+}
+
+TEST(GEOID_CACHE, preload_area)
+{
+	FakeGeoid geoid;
+	GeoidCache cache([&geoid](double lat, double lon) { return geoid(lat, lon); });
+
+	const double lat = 47.3977419, lon = 8.5455938;
+	auto cells = cache.preload(lat, lon, 2000.0);
+	EXPECT_LT(0U, cells);
+	EXPECT_GE(size_t(GeoidCache::TABLE_SIDE * GeoidCache::TABLE_SIDE), cells);
+
+	const size_t calls = geoid.calls;
+	FakeGeoid exact;
+
+	// ~1.5 km around, all precomputed
+	for (double d = -0.013; d <= 0.013; d += 0.001) {
+		EXPECT_NEAR(exact(lat + d, lon - d), cache.height(lat + d, lon - d), 1e-3);
+	}
+	EXPECT_EQ(calls, geoid.calls);
+}
+
+TEST(GEOID_CACHE, pole)
+{
+	FakeGeoid geoid;
+	GeoidCache cache([&geoid](double lat, double lon) { return geoid(lat, lon); });
+	FakeGeoid exact;
+
+	EXPECT_NEAR(exact(90.0, 10.0), cache.height(90.0, 10.0), 1e-3);
+	EXPECT_NEAR(exact(-90.0, 10.0), cache.height(-90.0, 10.0), 1e-3);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+/**
+ * Test libmavros latency trace
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <mavros/latency_trace.h>
+
+using namespace mavros;
+
+//! frames counted by collect() for @a msgid
+static uint64_t collected(uint32_t msgid)
+{
+	auto stats = LatencyTrace::instance().collect();
+	auto it = stats.find(msgid);
+	return (it != stats.end()) ? it->second.total.count : 0;
+}
+
+TEST(LATENCY_TRACE, histogram)
+{
+	LatencyTrace::Histogram h;
+
+	EXPECT_EQ(0.0, h.quantile(0.5));
+
+	for (int i = 0; i < 90; i++)
+		h.add(3000);		// 3 us: [2, 4) bin
+	for (int i = 0; i < 10; i++)
+		h.add(900000);		// 900 us: [512, 1024) bin
+
+	EXPECT_EQ(100U, h.count);
+	EXPECT_EQ(90U, h.bins[2]);
+	EXPECT_EQ(10U, h.bins[10]);
+	EXPECT_DOUBLE_EQ(4e-6, h.quantile(0.5));
+	EXPECT_DOUBLE_EQ(900e-6, h.quantile(0.99));	// bin bound clipped by max
+	EXPECT_EQ(900000U, h.max_ns);
+
+	h.add(0);
+	EXPECT_EQ(1U, h.bins[0]);
+}
+
+TEST(LATENCY_TRACE, stages)
+{
+	auto &trace = LatencyTrace::instance();
+	trace.set_enabled(true);
+	const uint64_t before = collected(105);
+
+	// rx stamp 10 ms in past, so total is at least that
+	trace.begin(105, LatencyTrace::now_ns() - 10000000);
+	trace.mark(LatencyTrace::ROUTE);
+	trace.mark(LatencyTrace::HANDLER);
+	trace.mark(LatencyTrace::PUBLISH);
+	trace.mark(LatencyTrace::PUBLISH);	// second publish ignored
+	trace.end();
+
+	auto stats = trace.collect();
+	ASSERT_EQ(1U, stats.count(105));
+
+	auto &ms = stats[105];
+	EXPECT_EQ(before + 1, ms.total.count);
+	EXPECT_LE(10000000U, ms.total.max_ns);
+	EXPECT_EQ(ms.total.count, ms.stage[LatencyTrace::ROUTE].count);
+	EXPECT_EQ(ms.total.count, ms.stage[LatencyTrace::PUBLISH].count);
+	EXPECT_EQ(ms.total.count, ms.stage[LatencyTrace::DONE].count);
+
+	// not marked stage does not get sample
+	trace.begin(106, 0);
+	trace.mark(LatencyTrace::ROUTE);
+	trace.end();
+
+	stats = trace.collect();
+	EXPECT_EQ(1U, stats[106].total.count);
+	EXPECT_EQ(0U, stats[106].stage[LatencyTrace::HANDLER].count);
+}
+
+TEST(LATENCY_TRACE, disabled)
+{
+	auto &trace = LatencyTrace::instance();
+	trace.set_enabled(false);
+	const uint64_t before = collected(30);
+
+	trace.begin(30, 0);
+	trace.mark(LatencyTrace::ROUTE);
+	trace.end();
+
+	EXPECT_EQ(before, collected(30));
+	trace.set_enabled(true);
+}
+
+TEST(LATENCY_TRACE, threads)
+{
+	auto &trace = LatencyTrace::instance();
+	trace.set_enabled(true);
+	const uint64_t before = collected(31), overruns = trace.overruns();
+	constexpr size_t nthreads = 4, nframes = 500;
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nthreads; t++) {
+		threads.emplace_back([&trace]() {
+				for (size_t i = 0; i < nframes; i++) {
+					trace.begin(31, 0);
+					trace.mark(LatencyTrace::ROUTE);
+					trace.end();
+				}
+			});
+	}
+
+	// reader runs concurrently with writers
+	for (int i = 0; i < 100; i++)
+		collected(31);
+
+	for (auto &th : threads)
+		th.join();
+
+	const uint64_t seen = collected(31);
+	EXPECT_EQ(before + nthreads * nframes, seen + trace.overruns() - overruns);
+}
+
+TEST(LATENCY_TRACE, dump)
+{
+	auto &trace = LatencyTrace::instance();
+	trace.set_enabled(true);
+
+	trace.begin(32, 0);
+	trace.mark(LatencyTrace::ROUTE);
+	trace.end();
+
+	const std::string path = "/tmp/mavros_test_trace.json";
+	EXPECT_LE(1U, trace.dump(path));
+
+	std::ifstream file(path);
+	std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	EXPECT_EQ(0U, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+	EXPECT_NE(std::string::npos, json.find("\"cat\":\"msgid 32\""));
+	EXPECT_NE(std::string::npos, json.find("\"name\":\"route\""));
+
+	EXPECT_THROW(trace.dump("/nonexistent/dir/trace.json"), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,108 @@
+/**
+ * Test libmavros local tangent plane conversion
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/frame_tf.h>
+#include <mavros/local_tangent_plane.h>
+
+using namespace mavros;
+
+static const Eigen::Vector3d ORIGIN(47.3977419, 8.5455938, 535.0);
+
+//! about 1 m in degrees of latitude
+static constexpr double M_DEG = 1.0 / 111320.0;
+
+TEST(LOCAL_TANGENT_PLANE, origin_rotation)
+{
+	LocalTangentPlane ltp;
+	ltp.set_origin(ORIGIN);
+
+	// same rotation as ftf uses
+	const Eigen::Vector3d v(1, 2, 3);
+	const Eigen::Vector3d expected = ftf::transform_frame_ecef_enu(v, ORIGIN);
+	const Eigen::Vector3d out = ltp.ecef_to_enu() * v;
+
+	EXPECT_NEAR(expected.x(), out.x(), 1e-9);
+	EXPECT_NEAR(expected.y(), out.y(), 1e-9);
+	EXPECT_NEAR(expected.z(), out.z(), 1e-9);
+
+	EXPECT_NEAR(0.0, ltp.to_enu(ORIGIN).norm(), 1e-6);
+}
+
+TEST(LOCAL_TANGENT_PLANE, exact_directions)
+{
+	LocalTangentPlane ltp;
+	ltp.set_origin(ORIGIN);
+
+	// north, east and up of origin
+	auto n = ltp.to_enu_exact(ORIGIN + Eigen::Vector3d(100 * M_DEG, 0, 0));
+	EXPECT_NEAR(0.0, n.x(), 1e-6);
+	EXPECT_NEAR(100.0, n.y(), 0.5);
+
+	auto e = ltp.to_enu_exact(ORIGIN + Eigen::Vector3d(0, 100 * M_DEG, 0));
+	EXPECT_NEAR(100.0 * std::cos(ORIGIN.x() * M_PI / 180.0), e.x(), 0.5);
+	EXPECT_NEAR(0.0, e.y(), 1e-3);
+
+	auto u = ltp.to_enu_exact(ORIGIN + Eigen::Vector3d(0, 0, 10));
+	EXPECT_NEAR(10.0, u.z(), 1e-6);
+	EXPECT_NEAR(0.0, u.head<2>().norm(), 1e-6);
+}
+
+TEST(LOCAL_TANGENT_PLANE, linear_matches_exact)
+{
+	LocalTangentPlane ltp;
+	ltp.set_origin(ORIGIN);
+
+	// vehicle flying 2 km north east and climbing, fix every ~1 m
+	for (int i = 0; i < 2000; i++) {
+		const Eigen::Vector3d lla = ORIGIN + Eigen::Vector3d(i * 0.7 * M_DEG, i * 1.0 * M_DEG, i * 0.05);
+		const Eigen::Vector3d exact = ltp.to_enu_exact(lla);
+		const Eigen::Vector3d fast = ltp.to_enu(lla);
+
+		ASSERT_NEAR(0.0, (exact - fast).norm(), 1e-3) << "at " << i;
+	}
+
+	EXPECT_LT(ltp.exact_count(), ltp.linear_count());
+	EXPECT_LE(2000U / LocalTangentPlane::DEFAULT_PERIOD, ltp.exact_count());
+}
+
+TEST(LOCAL_TANGENT_PLANE, reanchor_on_jump)
+{
+	LocalTangentPlane ltp(100.0, 1000);
+	ltp.set_origin(ORIGIN);
+
+	ltp.to_enu(ORIGIN);
+	ltp.to_enu(ORIGIN + Eigen::Vector3d(10 * M_DEG, 0, 0));
+	EXPECT_EQ(1U, ltp.exact_count());
+	EXPECT_EQ(1U, ltp.linear_count());
+
+	// far from anchor: exact
+	const Eigen::Vector3d far = ORIGIN + Eigen::Vector3d(0.1, 0.1, 0);
+	EXPECT_NEAR(0.0, (ltp.to_enu_exact(far) - ltp.to_enu(far)).norm(), 1e-9);
+	EXPECT_EQ(2U, ltp.exact_count());
+
+	// new origin drops anchor
+	ltp.set_origin(far);
+	EXPECT_NEAR(0.0, ltp.to_enu(far).norm(), 1e-6);
+	EXPECT_EQ(3U, ltp.exact_count());
+}
+
+TEST(LOCAL_TANGENT_PLANE, always_exact)
+{
+	LocalTangentPlane ltp(0.0);
+	ltp.set_origin(ORIGIN);
+
+	for (int i = 0; i < 10; i++)
+		ltp.to_enu(ORIGIN + Eigen::Vector3d(i * M_DEG, 0, 0));
+
+	EXPECT_EQ(10U, ltp.exact_count());
+	EXPECT_EQ(0U, ltp.linear_count());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,101 @@
+/**
+ * Test libmavros message pool
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <string>
+#include <mavros/message_pool.h>
+
+using namespace mavros;
+
+struct TestMsg {
+	std::string frame_id;
+	int value = 0;
+};
+
+TEST(MESSAGE_POOL, reuse)
+{
+	MessagePool<TestMsg> pool(2);
+
+	auto p1 = pool.acquire();
+	auto raw = p1.get();
+	p1->frame_id = "base_link";
+	p1->value = 10;
+
+	EXPECT_EQ(0U, pool.free_count());
+	p1.reset();
+	EXPECT_EQ(1U, pool.free_count());
+
+	// same object, content kept
+	auto p2 = pool.acquire();
+	EXPECT_EQ(raw, p2.get());
+	EXPECT_EQ("base_link", p2->frame_id);
+	EXPECT_EQ(10, p2->value);
+	EXPECT_EQ(0U, pool.free_count());
+}
+
+TEST(MESSAGE_POOL, shared_owners)
+{
+	MessagePool<TestMsg> pool(2);
+
+	auto p1 = pool.acquire();
+	boost::shared_ptr<const TestMsg> copy = p1;
+
+	p1.reset();
+	EXPECT_EQ(0U, pool.free_count());	// still owned by copy
+	copy.reset();
+	EXPECT_EQ(1U, pool.free_count());
+}
+
+TEST(MESSAGE_POOL, max_free)
+{
+	MessagePool<TestMsg> pool(2);
+
+	{
+		auto p1 = pool.acquire();
+		auto p2 = pool.acquire();
+		auto p3 = pool.acquire();
+	}
+
+	EXPECT_EQ(2U, pool.free_count());
+}
+
+TEST(MESSAGE_POOL, outlive_pool)
+{
+	MessagePool<TestMsg>::Ptr p;
+
+	{
+		MessagePool<TestMsg> pool(2);
+		p = pool.acquire();
+		p->value = 42;
+	}
+
+	EXPECT_EQ(42, p->value);
+	p.reset();	// should not crash or leak
+}
+
+TEST(MESSAGE_POOL, release_in_other_thread)
+{
+	MessagePool<TestMsg> pool(4);
+
+	for (int i = 0; i < 1000; i++) {
+		auto p = pool.acquire();
+		p->value = i;
+
+		std::thread th([p]() mutable {
+			p.reset();
+		});
+		p.reset();
+		th.join();
+	}
+
+	EXPECT_EQ(1U, pool.free_count());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,70 @@
+/**
+ * Test libmavros name interning table
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <mavros/name_interner.h>
+
+using namespace mavros;
+
+using Interner = NameInterner<10, 16>;
+
+static Interner::Name make_name(const char *s, char pad = '\0')
+{
+	Interner::Name n;
+	n.fill(pad);
+	for (size_t i = 0; i < n.size() && s[i]; i++)
+		n[i] = s[i];
+	return n;
+}
+
+TEST(NAME_INTERNER, intern)
+{
+	Interner names;
+
+	EXPECT_EQ(0, names.intern(make_name("roll_p")));
+	EXPECT_EQ(1, names.intern(make_name("pitch_p")));
+	EXPECT_EQ(0, names.intern(make_name("roll_p")));
+	EXPECT_EQ(2U, names.size());
+
+	EXPECT_EQ("roll_p", names.name(0));
+	EXPECT_EQ("pitch_p", names.name(1));
+}
+
+TEST(NAME_INTERNER, padding)
+{
+	Interner names;
+
+	// garbage after terminator is same name
+	auto a = make_name("alt", '\0');
+	auto b = make_name("alt", '\0');
+	b[5] = 'x';
+	EXPECT_EQ(names.intern(a), names.intern(b));
+
+	// full length, no terminator
+	auto full = make_name("0123456789");
+	int id = names.intern(full);
+	EXPECT_EQ("0123456789", names.name(id));
+}
+
+TEST(NAME_INTERNER, full)
+{
+	Interner names;
+	char buf[16];
+
+	for (size_t i = 0; i < Interner::MAX_NAMES; i++) {
+		snprintf(buf, sizeof(buf), "v%zu", i);
+		ASSERT_EQ(int(i), names.intern(make_name(buf)));
+	}
+
+	EXPECT_EQ(-1, names.intern(make_name("extra")));
+	EXPECT_EQ(3, names.intern(make_name("v3")));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,109 @@
+/**
+ * Test libmavros obstacle sectors
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <limits>
+#include <mavros/obstacle_sectors.h>
+
+using namespace mavros;
+
+static const float inf = std::numeric_limits<float>::infinity();
+static const float nan_ = std::numeric_limits<float>::quiet_NaN();
+
+TEST(OBSTACLE_SECTORS, min_pool_codes)
+{
+	const float ranges[] = {nan_, 5.0f, 0.05f, inf, -inf, 12.0f};
+
+	// unknown < in range < no obstacle priority
+	EXPECT_EQ(500U, ObstacleSectors::min_pool_cm(ranges, 6, 0.1f, 10.0f));
+	EXPECT_EQ(1001U, ObstacleSectors::min_pool_cm(ranges + 3, 1, 0.1f, 10.0f));
+	EXPECT_EQ(1001U, ObstacleSectors::min_pool_cm(ranges + 5, 1, 0.1f, 10.0f));
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), ObstacleSectors::min_pool_cm(ranges, 1, 0.1f, 10.0f));
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), ObstacleSectors::min_pool_cm(ranges + 2, 1, 0.1f, 10.0f));
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), ObstacleSectors::min_pool_cm(ranges + 4, 1, 0.1f, 10.0f));
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), ObstacleSectors::min_pool_cm(ranges, 0, 0.1f, 10.0f));
+}
+
+TEST(OBSTACLE_SECTORS, full_scan)
+{
+	// 1440 beams CCW from -180 deg, as ROS 360 deg lidar
+	const size_t n = 1440;
+	std::vector<float> ranges(n, 8.0f);
+	auto beam = [n](double flu_deg) { return size_t((flu_deg + 180.0) / 360.0 * n); };
+
+	ranges[beam(0.0)] = 1.0f;	// forward
+	ranges[beam(90.0)] = 2.0f;	// left: FRD 270 deg
+	ranges[beam(-30.0)] = 3.0f;	// right 30 deg: FRD 30 deg
+
+	ObstacleSectors sectors;
+	const double inc = 360.0 / n;
+	sectors.add_scan(ranges.data(), n, 180.0, -inc, 0.1f, 10.0f);
+
+	auto &d = sectors.get();
+	EXPECT_EQ(100U, d[0]);
+	EXPECT_EQ(200U, d[270 / 5]);
+	EXPECT_EQ(300U, d[30 / 5]);
+	EXPECT_EQ(800U, d[1]);
+	for (auto v : d)
+		EXPECT_LE(v, 800U);
+}
+
+TEST(OBSTACLE_SECTORS, partial_and_merge)
+{
+	// 90 deg front scan, 0.5 deg step, CW in FRD
+	std::vector<float> front(181, inf);
+	front[0] = 4.0f;	// FRD -45 deg
+	ObstacleSectors a;
+	a.add_scan(front.data(), front.size(), -45.0, 0.5, 0.1f, 10.0f);
+
+	EXPECT_EQ(400U, a.get()[(360 - 45) / 5]);
+	EXPECT_EQ(1001U, a.get()[0]);
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), a.get()[180 / 5]);	// not covered
+
+	// rear from other sensor
+	ObstacleSectors b;
+	b.add_point(180.0, 2.5f);
+	b.add_point(-178.0, 2.0f);	// same sector
+	EXPECT_EQ(200U, b.get()[180 / 5]);
+
+	a.merge(b);
+	EXPECT_EQ(200U, a.get()[180 / 5]);
+	EXPECT_EQ(400U, a.get()[(360 - 45) / 5]);
+}
+
+TEST(OBSTACLE_SECTORS, polar_voxels)
+{
+	PolarVoxelGrid grid;
+	grid.resize(0.1f, 10.0f);
+
+	// lone speckle in front of wall at 3 m, forward sector
+	grid.add_point(1.0, 1.02f);
+	for (size_t i = 0; i < 5; i++)
+		grid.add_point(-2.0 + i, 3.05f);
+	// sparse sector right
+	grid.add_point(90.0, 4.0f);
+
+	ObstacleSectors sectors;
+	grid.reduce(sectors, 3);
+	EXPECT_EQ(300U, sectors.get()[0]);
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), sectors.get()[90 / 5]);
+
+	sectors.clear();
+	grid.reduce(sectors, 1);
+	EXPECT_EQ(100U, sectors.get()[0]);
+	EXPECT_EQ(400U, sectors.get()[90 / 5]);
+
+	grid.clear();
+	sectors.clear();
+	grid.reduce(sectors, 1);
+	EXPECT_EQ(uint16_t(ObstacleSectors::UNKNOWN), sectors.get()[0]);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,105 @@
+/**
+ * Test plugin handler accounting
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <ros/callback_queue.h>
+#include <boost/make_shared.hpp>
+
+#include <mavros/plugin_stats.h>
+
+using namespace mavros::plugin;
+
+TEST(PLUGIN_STATS, scope)
+{
+	PluginStats stats;
+
+	{
+		PluginStats::Scope scope(stats.handlers);
+	}
+	{
+		PluginStats::Scope scope(stats.handlers);
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	EXPECT_EQ(2U, stats.handlers.calls.load());
+	EXPECT_EQ(0U, stats.callbacks.calls.load());
+	EXPECT_LE(stats.handlers.max_cycles.load(), stats.handlers.cycles.load());
+
+	// slept call is max, cycles converted back to time
+	const double max_s = stats.handlers.max_cycles.load() / PluginStats::cycles_per_second();
+	EXPECT_LT(0.001, max_s);
+	EXPECT_GT(1.0, max_s);
+}
+
+TEST(PLUGIN_STATS, max_cycles)
+{
+	PluginStats::Counters counters;
+
+	counters.add(10, 0);
+	counters.add(30, 1);
+	counters.add(20, 2);
+
+	EXPECT_EQ(3U, counters.calls.load());
+	EXPECT_EQ(60U, counters.cycles.load());
+	EXPECT_EQ(30U, counters.max_cycles.load());
+	EXPECT_EQ(3U, counters.allocs.load());
+}
+
+//! pointer escapes through it, so new/delete pair can't be elided
+static int *volatile alloc_sink;
+
+TEST(PLUGIN_STATS, allocs)
+{
+	PluginStats stats;
+
+	{
+		PluginStats::Scope scope(stats.handlers);
+		alloc_sink = new int(1);
+		delete alloc_sink;
+	}
+
+	if (PluginStats::alloc_stats_enabled())
+		EXPECT_EQ(1U, stats.handlers.allocs.load());
+	else
+		EXPECT_EQ(0U, stats.handlers.allocs.load());
+}
+
+class TestCallback : public ros::CallbackInterface {
+public:
+	explicit TestCallback(int &called_) : called(called_) { }
+
+	CallResult call() override {
+		called++;
+		return Success;
+	}
+
+private:
+	int &called;
+};
+
+TEST(PLUGIN_STATS, callback_queue)
+{
+	ros::CallbackQueue queue;
+	auto stats = std::make_shared<PluginStats>();
+	StatsCallbackQueue proxy(&queue, stats);
+	int called = 0, removed_called = 0;
+
+	proxy.addCallback(boost::make_shared<TestCallback>(called), 1);
+	proxy.addCallback(boost::make_shared<TestCallback>(removed_called), 2);
+	proxy.removeByID(2);
+
+	// callbacks still run by target queue
+	queue.callAvailable();
+	EXPECT_EQ(1, called);
+	EXPECT_EQ(0, removed_called);
+	EXPECT_EQ(1U, stats->callbacks.calls.load());
+	EXPECT_EQ(0U, stats->handlers.calls.load());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
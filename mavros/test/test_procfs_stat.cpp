@@ -0,0 +1,87 @@
+/**
+ * Test libmavros procfs status parsers
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/procfs_stat.h>
+
+using namespace mavros::procfs;
+
+TEST(PROCFS, parse_stat)
+{
+	const char buf[] =
+		"cpu  100 0 50 800 50 0 0 0 0 0\n"
+		"cpu0 60 0 20 400 20 0 0 0 0 0\n"
+		"cpu1 40 0 30 400 30 0 0 0 0 0\n"
+		"intr 743417 0 0 0\n"
+		"ctxt 1713599\n";
+
+	CpuTimes combined, cores[1];
+	EXPECT_EQ(1U, parse_stat(buf, combined, cores, 1));
+	EXPECT_EQ(150U, combined.busy);
+	EXPECT_EQ(1000U, combined.total);
+	EXPECT_EQ(80U, cores[0].busy);
+	EXPECT_EQ(500U, cores[0].total);
+
+	CpuTimes cores2[8];
+	EXPECT_EQ(2U, parse_stat(buf, combined, cores2, 8));
+	EXPECT_EQ(70U, cores2[1].busy);
+}
+
+TEST(PROCFS, parse_meminfo)
+{
+	const char buf[] =
+		"MemTotal:        6158152 kB\n"
+		"MemFree:         1000000 kB\n"
+		"MemAvailable:    5520288 kB\n";
+
+	uint64_t total, avail;
+	ASSERT_TRUE(parse_meminfo(buf, total, avail));
+	EXPECT_EQ(6158152U, total);
+	EXPECT_EQ(5520288U, avail);
+
+	EXPECT_FALSE(parse_meminfo("MemTotal: 1 kB\n", total, avail));
+}
+
+TEST(PROCFS, parse_net_dev)
+{
+	const char buf[] =
+		"Inter-|   Receive                                                |  Transmit\n"
+		" face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+		"    lo: 225639225   22214    0    0    0     0          0         0 225639225   22214    0    0    0     0       0          0\n"
+		"  eth0:    1000      10    0    0    0     0          0         0     2000      20    0    0    0     0       0          0\n"
+		"wlan0:     3000      10    0    0    0     0          0         0     4000      20    0    0    0     0       0          0\n";
+
+	NetCounters links[6];
+	ASSERT_EQ(2U, parse_net_dev(buf, links, 6));
+	EXPECT_STREQ("eth0", links[0].name);
+	EXPECT_EQ(1000U, links[0].rx_bytes);
+	EXPECT_EQ(2000U, links[0].tx_bytes);
+	EXPECT_STREQ("wlan0", links[1].name);
+	EXPECT_EQ(4000U, links[1].tx_bytes);
+}
+
+TEST(PROCFS, collector)
+{
+	StatusCollector collector;
+	StatusCollector::Status st;
+
+	collector.open();
+	collector.sample(1.0, st);
+	// first sample: no deltas
+	EXPECT_EQ(UINT8_MAX, st.cpu_cores[0]);
+
+	collector.sample(2.0, st);
+	EXPECT_GT(st.uptime_ms, 0U);
+	EXPECT_NE(UINT32_MAX, st.ram_total);
+	EXPECT_LE(st.ram_usage, st.ram_total);
+	EXPECT_LE(st.cpu_cores[0], 100);
+	EXPECT_LE(st.cpu_combined.back(), 100);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,62 @@
+/**
+ * Test libmavros protocol negotiation
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/protocol_negotiator.h>
+
+using mavros::ProtocolNegotiator;
+using State = ProtocolNegotiator::State;
+
+TEST(PROTOCOL_NEGOTIATOR, v2_heartbeat)
+{
+	ProtocolNegotiator pn;
+
+	EXPECT_EQ(State::probing, pn.state());
+	EXPECT_FALSE(pn.use_v1());
+
+	EXPECT_TRUE(pn.heartbeat(true));
+	EXPECT_EQ(State::v2, pn.state());
+
+	// v1 frames from v2 FCU do not downgrade
+	for (int i = 0; i < 10; i++)
+		EXPECT_FALSE(pn.heartbeat(false));
+	EXPECT_EQ(State::v2, pn.state());
+}
+
+TEST(PROTOCOL_NEGOTIATOR, v1_fallback)
+{
+	ProtocolNegotiator pn(3);
+
+	EXPECT_FALSE(pn.heartbeat(false));
+	EXPECT_FALSE(pn.heartbeat(false));
+	EXPECT_EQ(State::probing, pn.state());
+
+	EXPECT_TRUE(pn.heartbeat(false));
+	EXPECT_EQ(State::v1, pn.state());
+	EXPECT_TRUE(pn.use_v1());
+
+	EXPECT_FALSE(pn.heartbeat(false));
+
+	// FCU switched to v2 later (e.g. parameter changed and rebooted)
+	EXPECT_TRUE(pn.heartbeat(true));
+	EXPECT_EQ(State::v2, pn.state());
+	EXPECT_FALSE(pn.use_v1());
+}
+
+TEST(PROTOCOL_NEGOTIATOR, probe_answered)
+{
+	ProtocolNegotiator pn(3);
+
+	// PX4 auto mode: v1 until our v2 frames seen
+	EXPECT_FALSE(pn.heartbeat(false));
+	EXPECT_TRUE(pn.heartbeat(true));
+	EXPECT_EQ(State::v2, pn.state());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
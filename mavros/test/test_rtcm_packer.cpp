@@ -0,0 +1,108 @@
+/**
+ * Test libmavros RTCM3 packer
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <mavros/rtcm_packer.h>
+
+using namespace mavros;
+
+using Bytes = std::vector<uint8_t>;
+
+//! RTCM3 frame of @a type with @a payload_len bytes (CRC not checked)
+static Bytes make_frame(uint16_t type, size_t payload_len)
+{
+	Bytes f(3 + payload_len + 3, 0x55);
+	f[0] = 0xD3;
+	f[1] = (payload_len >> 8) & 0x03;
+	f[2] = payload_len & 0xff;
+	f[3] = type >> 4;
+	f[4] = (type & 0x0f) << 4;
+	return f;
+}
+
+struct PackerTest : public ::testing::Test {
+	std::vector<Bytes> sent;
+	RtcmPacker packer;
+
+	PackerTest() :
+		packer([this](const uint8_t *data, size_t len) { sent.emplace_back(data, data + len); })
+	{ }
+
+	void push(const Bytes &b, double now = 0.0, bool saturated = false) {
+		packer.push(b.data(), b.size(), now, saturated);
+	}
+};
+
+TEST_F(PackerTest, frame_parse)
+{
+	auto f = make_frame(1077, 100);
+	EXPECT_EQ(106U, RtcmPacker::frame_length(f.data(), f.size()));
+	EXPECT_EQ(0U, RtcmPacker::frame_length(f.data(), f.size() - 1));
+	EXPECT_EQ(1077U, RtcmPacker::frame_type(f.data()));
+
+	f[0] = 0;
+	EXPECT_EQ(0U, RtcmPacker::frame_length(f.data(), f.size()));
+}
+
+TEST_F(PackerTest, packs_whole_frames)
+{
+	// 3 x 56 bytes fit, 4th starts new packet
+	for (size_t i = 0; i < 4; i++)
+		push(make_frame(1074, 50));
+	ASSERT_EQ(1U, sent.size());
+	EXPECT_EQ(168U, sent[0].size());
+
+	push(make_frame(1230, 10));
+	packer.flush();
+	ASSERT_EQ(2U, sent.size());
+	EXPECT_EQ(56U + 16U, sent[1].size());
+	EXPECT_EQ(0xD3, sent[1][56]);
+
+	// long frame goes alone
+	push(make_frame(1077, 20));
+	push(make_frame(1087, 400));
+	ASSERT_EQ(4U, sent.size());
+	EXPECT_EQ(26U, sent[2].size());
+	EXPECT_EQ(406U, sent[3].size());
+	EXPECT_TRUE(packer.empty());
+}
+
+TEST_F(PackerTest, plain_bytes)
+{
+	Bytes chunk(400, 0x11);
+	push(chunk);
+	ASSERT_EQ(2U, sent.size());
+	EXPECT_EQ(180U, sent[0].size());
+	EXPECT_EQ(180U, sent[1].size());
+	packer.flush();
+	EXPECT_EQ(40U, sent[2].size());
+}
+
+TEST_F(PackerTest, redundant_skip)
+{
+	packer.set_redundant_period(5.0);
+
+	// not saturated: everything passes
+	push(make_frame(1005, 19), 0.0, false);
+	push(make_frame(1005, 19), 1.0, false);
+	EXPECT_EQ(0U, packer.skipped());
+
+	// saturated: repeat of 1005 within period dropped, observations never
+	push(make_frame(1005, 19), 2.0, true);
+	push(make_frame(1077, 19), 2.0, true);
+	push(make_frame(1005, 19), 6.5, true);
+	EXPECT_EQ(1U, packer.skipped());
+
+	packer.flush();
+	ASSERT_EQ(1U, sent.size());
+	EXPECT_EQ(4U * 25U, sent[0].size());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
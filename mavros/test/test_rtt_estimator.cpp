@@ -0,0 +1,59 @@
+/**
+ * Test libmavros RTT estimator
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/rtt_estimator.h>
+
+using namespace mavros;
+
+TEST(RTT_ESTIMATOR, no_samples)
+{
+	RttEstimator rtt;
+
+	EXPECT_TRUE(rtt.empty());
+	EXPECT_EQ(1.0, rtt.timeout(0.05, 1.0));
+}
+
+TEST(RTT_ESTIMATOR, first_sample)
+{
+	RttEstimator rtt;
+
+	rtt.update(0.1);
+	EXPECT_FALSE(rtt.empty());
+	EXPECT_DOUBLE_EQ(0.1, rtt.srtt());
+	// srtt + 4 * srtt / 2
+	EXPECT_DOUBLE_EQ(0.3, rtt.timeout(0.05, 1.0));
+}
+
+TEST(RTT_ESTIMATOR, converge)
+{
+	RttEstimator rtt;
+
+	rtt.update(0.5);
+	for (int i = 0; i < 100; i++)
+		rtt.update(0.02);
+
+	EXPECT_NEAR(0.02, rtt.srtt(), 1e-4);
+	// variance decays, lower bound holds
+	EXPECT_DOUBLE_EQ(0.05, rtt.timeout(0.05, 1.0));
+	EXPECT_EQ(101U, rtt.samples());
+
+	rtt.reset();
+	EXPECT_TRUE(rtt.empty());
+}
+
+TEST(RTT_ESTIMATOR, upper_bound)
+{
+	RttEstimator rtt;
+
+	rtt.update(3.0);
+	EXPECT_DOUBLE_EQ(1.0, rtt.timeout(0.05, 1.0));
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,87 @@
+/**
+ * Test libmavros sequence lock
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+#include <mavros/seqlock.h>
+
+using namespace mavros;
+
+//! Bigger than one word, all fields equal in consistent copy
+struct State {
+	uint64_t a;
+	double b;
+	uint32_t c[5];
+};
+
+static State make_state(uint32_t v)
+{
+	return State {v, double(v), {v, v, v, v, v}};
+}
+
+static bool is_consistent(const State &st)
+{
+	for (auto c : st.c)
+		if (c != st.a)
+			return false;
+
+	return st.b == double(st.a);
+}
+
+TEST(SEQLOCK, store_load)
+{
+	SeqLock<State> sl(make_state(1));
+
+	EXPECT_EQ(1U, sl.load().a);
+	EXPECT_EQ(1U, sl.version());
+
+	sl.store(make_state(42));
+	auto st = sl.load();
+	EXPECT_TRUE(is_consistent(st));
+	EXPECT_EQ(42U, st.a);
+	EXPECT_EQ(2U, sl.version());
+}
+
+TEST(SEQLOCK, concurrent_readers)
+{
+	const uint32_t N = 200000;
+	SeqLock<State> sl(make_state(0));
+	std::atomic<bool> done{false};
+	std::atomic<int> torn{0};
+	std::atomic<int> backwards{0};
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 3; r++) {
+		readers.emplace_back([&]() {
+				uint64_t last = 0;
+				while (!done.load()) {
+					auto st = sl.load();
+					if (!is_consistent(st))
+						torn++;
+					if (st.a < last)
+						backwards++;
+					last = st.a;
+				}
+			});
+	}
+
+	for (uint32_t i = 1; i <= N; i++)
+		sl.store(make_state(i));
+
+	done = true;
+	for (auto &t : readers)
+		t.join();
+
+	EXPECT_EQ(0, torn);
+	EXPECT_EQ(0, backwards);
+	EXPECT_EQ(N, sl.load().a);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,88 @@
+/**
+ * Test libmavros sliding window variance
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+#include <mavros/sliding_variance.h>
+
+using namespace mavros;
+
+//! reference: two pass over last n samples
+static void exact(const std::vector<double> &v, size_t n, double &mean, double &var)
+{
+	const size_t k = std::min(n, v.size());
+	double sum = 0.0, sum_sq = 0.0;
+
+	for (size_t i = v.size() - k; i < v.size(); i++)
+		sum += v[i];
+	mean = sum / k;
+	for (size_t i = v.size() - k; i < v.size(); i++)
+		sum_sq += (v[i] - mean) * (v[i] - mean);
+	var = sum_sq / k;
+}
+
+TEST(SLIDING_VARIANCE, matches_two_pass)
+{
+	SlidingVariance<50> sv;
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(12.0, 0.05);
+	std::vector<double> all;
+
+	EXPECT_EQ(0.0, sv.variance());
+
+	// past several resyncs
+	for (size_t i = 0; i < 50 * 40; i++) {
+		const double x = noise(rng);
+		ASSERT_TRUE(sv.add(x));
+		all.push_back(x);
+
+		double mean, var;
+		exact(all, 50, mean, var);
+		EXPECT_NEAR(mean, sv.mean(), 1e-9);
+		EXPECT_NEAR(var, sv.variance(), 1e-9);
+	}
+
+	EXPECT_EQ(50U, sv.size());
+	EXPECT_FALSE(sv.add(NAN));
+	EXPECT_EQ(0U, sv.rejected());
+}
+
+TEST(SLIDING_VARIANCE, median_gate)
+{
+	SlidingVariance<20> plain, gated;
+	gated.set_median_gate(5, 0.5);
+
+	std::vector<double> clean;
+	for (size_t i = 0; i < 100; i++) {
+		// spike every 10th sample
+		const double x = (i % 10 == 9) ? 30.0 : 2.0 + 0.01 * (i % 3);
+		plain.add(x);
+		if (gated.add(x))
+			clean.push_back(x);
+	}
+
+	// first spike comes after gate filled, so all spikes rejected
+	EXPECT_EQ(10U, gated.rejected());
+	EXPECT_LT(gated.variance(), 1e-3);
+	EXPECT_GT(plain.variance(), 10.0);
+
+	double mean, var;
+	exact(clean, 20, mean, var);
+	EXPECT_NEAR(var, gated.variance(), 1e-9);
+
+	// real step: rejected until median moves, two samples here (last spike is in window)
+	const size_t rejected = gated.rejected();
+	for (size_t i = 0; i < 10; i++)
+		gated.add(5.0);
+	EXPECT_EQ(rejected + 2, gated.rejected());
+	EXPECT_GT(gated.mean(), 2.0);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
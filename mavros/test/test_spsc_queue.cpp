@@ -0,0 +1,89 @@
+/**
+ * Test libmavros SPSC queue
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <mavros/spsc_queue.h>
+
+using namespace mavros;
+
+TEST(SPSC_QUEUE, capacity_round_up)
+{
+	SPSCQueue<int> q1(1), q2(5), q3(1024);
+
+	EXPECT_EQ(1U, q1.capacity());
+	EXPECT_EQ(8U, q2.capacity());
+	EXPECT_EQ(1024U, q3.capacity());
+}
+
+TEST(SPSC_QUEUE, push_pop_full)
+{
+	SPSCQueue<int> q(4);
+
+	EXPECT_TRUE(q.empty());
+	EXPECT_EQ(nullptr, q.front());
+
+	for (int i = 0; i < 4; i++)
+		EXPECT_TRUE(q.push(i));
+
+	EXPECT_FALSE(q.push(4));
+	EXPECT_EQ(nullptr, q.alloc());
+	EXPECT_EQ(4U, q.size());
+	EXPECT_EQ(4U, q.high_water_mark());
+
+	// wrap around
+	for (int i = 0; i < 10; i++) {
+		auto p = q.front();
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ(i, *p);
+		q.pop();
+
+		EXPECT_TRUE(q.push(i + 4));
+	}
+
+	EXPECT_EQ(4U, q.size());
+	EXPECT_EQ(4U, q.high_water_mark());
+}
+
+TEST(SPSC_QUEUE, threaded_order)
+{
+	const int count = 200000;
+	SPSCQueue<int> q(64);
+
+	std::thread producer([&q, count]() {
+		for (int i = 0; i < count; ) {
+			if (q.push(i))
+				i++;
+			else
+				std::this_thread::yield();
+		}
+	});
+
+	int expected = 0, mismatch = 0;
+	while (expected < count) {
+		auto p = q.front();
+		if (p == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (*p != expected)
+			mismatch++;
+
+		q.pop();
+		expected++;
+	}
+
+	producer.join();
+	EXPECT_EQ(0, mismatch);
+	EXPECT_TRUE(q.empty());
+	EXPECT_LE(q.high_water_mark(), q.capacity());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+/**
+ * Test libmavros state history ring
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <mavros/state_history.h>
+
+using namespace mavros;
+
+TEST(STATE_HISTORY, lookup_interpolate)
+{
+	StateHistory<double> h(8);
+	double before, after, ratio;
+
+	EXPECT_FALSE(h.lookup(100, before, after, ratio));
+
+	for (int i = 1; i <= 4; i++)
+		EXPECT_TRUE(h.push(i * 100, i * 10.0));
+	EXPECT_EQ(4U, h.size());
+
+	// between samples
+	ASSERT_TRUE(h.lookup(250, before, after, ratio));
+	EXPECT_EQ(20.0, before);
+	EXPECT_EQ(30.0, after);
+	EXPECT_DOUBLE_EQ(0.5, ratio);
+
+	// exact match
+	ASSERT_TRUE(h.lookup(100, before, after, ratio));
+	EXPECT_EQ(10.0, before);
+	EXPECT_DOUBLE_EQ(0.0, ratio);
+
+	// newer than newest - latest sample
+	ASSERT_TRUE(h.lookup(1000, before, after, ratio));
+	EXPECT_EQ(40.0, before);
+	EXPECT_EQ(40.0, after);
+
+	// older than oldest
+	EXPECT_FALSE(h.lookup(50, before, after, ratio));
+
+	// out of order sample ignored
+	EXPECT_FALSE(h.push(350, 35.0));
+	EXPECT_EQ(4U, h.size());
+}
+
+TEST(STATE_HISTORY, wrap_around)
+{
+	StateHistory<double> h(8);
+	double before, after, ratio;
+
+	for (int i = 0; i < 20; i++)
+		h.push(i * 10, i);
+
+	EXPECT_EQ(8U, h.size());
+	EXPECT_FALSE(h.lookup(115, before, after, ratio));
+
+	ASSERT_TRUE(h.lookup(125, before, after, ratio));
+	EXPECT_EQ(12.0, before);
+	EXPECT_EQ(13.0, after);
+	EXPECT_DOUBLE_EQ(0.5, ratio);
+}
+
+TEST(STATE_HISTORY, concurrent_lookup)
+{
+	const uint64_t N = 100000;
+	StateHistory<double> h(64);
+	std::atomic<bool> done{false};
+	int bad = 0;
+
+	h.push(0, 0.0);
+
+	std::thread reader([&]() {
+			double before, after, ratio;
+			while (!done.load()) {
+				// newest sample, then one within history window
+				if (!h.lookup(UINT64_MAX, before, after, ratio) || before < 32)
+					continue;
+
+				const uint64_t stamp = uint64_t(before) - 16;
+				if (!h.lookup(stamp, before, after, ratio))
+					continue;
+
+				// value matches stamp
+				if (before != double(stamp) || after != double(stamp + 1) || ratio != 0.0)
+					bad++;
+			}
+		});
+
+	for (uint64_t i = 1; i < N; i++)
+		h.push(i, double(i));
+
+	done = true;
+	reader.join();
+	EXPECT_EQ(0, bad);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+/**
+ * Test libmavros stream demand
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/stream_demand.h>
+
+using namespace mavros;
+
+//! find request of msgid, nullptr if none
+static const StreamDemand::Request *find(const std::vector<StreamDemand::Request> &v, uint32_t msgid)
+{
+	for (auto &rq : v)
+		if (rq.msgid == msgid)
+			return &rq;
+	return nullptr;
+}
+
+TEST(STREAM_DEMAND, interval)
+{
+	EXPECT_EQ(-1.0f, StreamDemand::interval_us(-1.0));
+	EXPECT_EQ(0.0f, StreamDemand::interval_us(0.0));
+	EXPECT_FLOAT_EQ(20000.0f, StreamDemand::interval_us(50.0));
+}
+
+TEST(STREAM_DEMAND, unseen_not_managed)
+{
+	StreamDemand demand;
+	uint32_t subs = 1;
+
+	auto stream = demand.declare(105, "imu/data_raw", [&subs]() { return subs; }, 50.0);
+	EXPECT_TRUE(demand.update().empty());
+	EXPECT_TRUE(demand.update(true).empty());
+
+	stream->seen();
+	auto changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(105U, changes[0].msgid);
+	EXPECT_EQ(50.0, changes[0].rate);
+}
+
+TEST(STREAM_DEMAND, follows_subscribers)
+{
+	StreamDemand demand;
+	uint32_t raw_subs = 0, mag_subs = 0;
+
+	demand.configure(true, 1.0, StreamDemand::RATE_DISABLED, nullptr);
+	auto stream = demand.declare(105, "imu/data_raw", [&]() { return raw_subs; }, 50.0);
+	EXPECT_EQ(stream, demand.declare(105, "imu/mag", [&]() { return mag_subs; }, 10.0));
+	stream->seen();
+
+	// nobody listens: idle
+	auto changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(double(StreamDemand::RATE_DISABLED), changes[0].rate);
+	EXPECT_EQ(-1.0f, changes[0].interval_us);
+
+	// no change, nothing to send
+	EXPECT_TRUE(demand.update().empty());
+
+	mag_subs = 1;
+	changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(10.0, changes[0].rate);
+
+	// highest rate of subscribed topics
+	raw_subs = 2;
+	changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(50.0, changes[0].rate);
+
+	raw_subs = 0;
+	mag_subs = 0;
+	changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(double(StreamDemand::RATE_DISABLED), changes[0].rate);
+
+	// reconnect resends
+	changes = demand.update(true);
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(double(StreamDemand::RATE_DISABLED), changes[0].rate);
+}
+
+TEST(STREAM_DEMAND, default_rate_and_overrides)
+{
+	StreamDemand demand;
+	uint32_t subs = 1;
+
+	demand.configure(true, 1.0, StreamDemand::RATE_DEFAULT, [](const std::string &key, double def) {
+				return (key == "local_position/odom") ? 30.0 : def;
+			});
+
+	auto lp = demand.declare(32, "local_position/pose", [&]() { return subs; }, StreamDemand::RATE_DEFAULT);
+	demand.declare(32, "local_position/odom", [&]() { return subs; }, StreamDemand::RATE_DEFAULT);
+	auto gp = demand.declare(33, "global_position/global", [&]() { return subs; }, StreamDemand::RATE_DEFAULT);
+	lp->seen();
+	gp->seen();
+
+	auto changes = demand.update();
+	ASSERT_EQ(2U, changes.size());
+
+	// configured rate beats FCU default
+	ASSERT_NE(nullptr, find(changes, 32));
+	EXPECT_EQ(30.0, find(changes, 32)->rate);
+	ASSERT_NE(nullptr, find(changes, 33));
+	EXPECT_EQ(double(StreamDemand::RATE_DEFAULT), find(changes, 33)->rate);
+
+	subs = 0;
+	changes = demand.update();
+	ASSERT_EQ(1U, changes.size());
+	EXPECT_EQ(32U, changes[0].msgid);
+	EXPECT_EQ(double(StreamDemand::RATE_DEFAULT), changes[0].rate);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
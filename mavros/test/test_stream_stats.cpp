@@ -0,0 +1,121 @@
+/**
+ * Test libmavros per msgid stream statistics
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <mavros/stream_stats.h>
+
+using namespace mavros;
+
+static constexpr uint64_t MS = 1000000;
+
+TEST(STREAM_STATS, empty)
+{
+	StreamStats stats;
+
+	EXPECT_TRUE(stats.get_stats(0).empty());
+	EXPECT_EQ(0U, stats.overflow());
+}
+
+TEST(STREAM_STATS, rate_jitter)
+{
+	StreamStats stats;
+
+	// 50 Hz with alternating +-1 ms jitter, 1 Hz heartbeat
+	uint64_t t = 1000 * MS;
+	for (int i = 0; i < 100; i++) {
+		stats.tick(105, t + ((i % 2) ? MS : 0));
+		if (i % 50 == 0)
+			stats.tick(0, t);
+		t += 20 * MS;
+	}
+
+	auto st = stats.get_stats(t);
+	ASSERT_EQ(2U, st.size());
+
+	EXPECT_EQ(0U, st[0].msgid);
+	EXPECT_EQ(2U, st[0].count);
+	EXPECT_NEAR(1.0, st[0].rate, 1e-6);
+
+	EXPECT_EQ(105U, st[1].msgid);
+	EXPECT_EQ(100U, st[1].count);
+	EXPECT_EQ(0U, st[1].lost);
+	EXPECT_NEAR(50.0, st[1].rate, 1.0);
+	EXPECT_NEAR(0.001, st[1].jitter, 1e-4);
+	EXPECT_NEAR(0.019, st[1].age, 1e-6);
+}
+
+TEST(STREAM_STATS, loss)
+{
+	StreamStats stats;
+
+	uint64_t t = 0;
+	for (int i = 0; i < 100; i++) {
+		// drop every 10th message
+		if (i % 10 != 5)
+			stats.tick(30, t);
+		t += 10 * MS;
+	}
+
+	auto st = stats.get_stats(t);
+	ASSERT_EQ(1U, st.size());
+	EXPECT_EQ(90U, st[0].count);
+	EXPECT_EQ(9U, st[0].lost);		// first one seen before loss detection starts
+}
+
+TEST(STREAM_STATS, stopped)
+{
+	StreamStats stats;
+
+	for (uint64_t t = 0; t < 1000 * MS; t += 10 * MS)
+		stats.tick(31, t);
+
+	auto st = stats.get_stats(10000 * MS);
+	ASSERT_EQ(1U, st.size());
+	EXPECT_NEAR(9.01, st[0].age, 1e-6);
+	EXPECT_GT(5.0, st[0].rate);
+}
+
+TEST(STREAM_STATS, overflow)
+{
+	StreamStats stats;
+
+	for (uint32_t id = 0; id < StreamStats::TABLE_SIZE + 10; id++)
+		stats.tick(id * 1000 + 7, MS);
+
+	EXPECT_EQ(size_t(StreamStats::TABLE_SIZE), stats.get_stats(MS).size());
+	EXPECT_EQ(10U, stats.overflow());
+}
+
+TEST(STREAM_STATS, concurrent_msgids)
+{
+	StreamStats stats;
+	std::vector<std::thread> threads;
+
+	for (uint32_t th = 0; th < 4; th++) {
+		threads.emplace_back([&stats, th]() {
+				for (uint64_t i = 1; i <= 10000; i++) {
+					for (uint32_t id = th; id < 64; id += 4)
+						stats.tick(id, i * MS);
+				}
+			});
+	}
+
+	for (auto &th : threads)
+		th.join();
+
+	auto st = stats.get_stats(10000 * MS);
+	ASSERT_EQ(64U, st.size());
+	for (auto &s : st) {
+		EXPECT_EQ(10000U, s.count);
+		EXPECT_NEAR(1000.0, s.rate, 1e-3);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,161 @@
+/**
+ * Test libmavros timer wheel
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+
+#include <mavros/timer_wheel.h>
+
+using namespace mavros;
+using namespace std::chrono;
+
+using Clock = TimerWheel::Clock;
+
+TEST(TIMER_WHEEL, oneshot)
+{
+	TimerWheel wheel;
+	TimerWheel::Timer timer;
+	int fired = 0;
+
+	auto before = Clock::now();
+	timer.setup(wheel, [&]() { fired++; }, 0.05, true);
+	auto after = Clock::now();
+
+	EXPECT_TRUE(timer.isValid());
+	EXPECT_TRUE(timer.hasStarted());
+
+	wheel.advance(before + milliseconds(48));
+	EXPECT_EQ(0, fired);
+
+	wheel.advance(after + milliseconds(52));
+	EXPECT_EQ(1, fired);
+	EXPECT_FALSE(timer.hasStarted());
+
+	wheel.advance(after + milliseconds(500));
+	EXPECT_EQ(1, fired);
+
+	// restart: armed from wheel time, already ahead of clock
+	timer.start();
+	wheel.advance(after + milliseconds(520));
+	EXPECT_EQ(1, fired);
+	wheel.advance(after + milliseconds(560));
+	EXPECT_EQ(2, fired);
+}
+
+TEST(TIMER_WHEEL, periodic_keeps_phase)
+{
+	TimerWheel wheel;
+	TimerWheel::Timer timer;
+	int fired = 0;
+
+	auto base = Clock::now();
+	timer.setup(wheel, [&]() { fired++; }, 0.01);
+
+	// late and uneven advances do not shift expiries
+	wheel.advance(base + milliseconds(35));
+	EXPECT_EQ(3, fired);
+	wheel.advance(base + milliseconds(37));
+	EXPECT_EQ(3, fired);
+	wheel.advance(base + milliseconds(1005));
+	EXPECT_EQ(100, fired);
+	EXPECT_TRUE(timer.hasStarted());
+}
+
+TEST(TIMER_WHEEL, levels)
+{
+	TimerWheel wheel;
+	const double delays[] = { 0.003, 0.1, 2.0, 30.0, 600.0, 20000.0 };
+
+	std::vector<std::unique_ptr<TimerWheel::Timer> > timers;
+	std::vector<int> fired(6, 0);
+
+	auto before = Clock::now();
+	for (size_t i = 0; i < 6; i++) {
+		timers.emplace_back(new TimerWheel::Timer());
+		timers.back()->setup(wheel, [&fired, i]() { fired[i]++; }, delays[i], true);
+	}
+	auto after = Clock::now();
+	EXPECT_EQ(6U, wheel.armed_count());
+
+	for (size_t i = 0; i < 6; i++) {
+		const auto delay = duration_cast<Clock::duration>(duration<double>(delays[i]));
+
+		wheel.advance(before + delay - milliseconds(2));
+		EXPECT_EQ(0, fired[i]) << "early, delay " << delays[i];
+
+		wheel.advance(after + delay + milliseconds(2));
+		EXPECT_EQ(1, fired[i]) << "missed, delay " << delays[i];
+	}
+
+	EXPECT_EQ(0U, wheel.armed_count());
+}
+
+TEST(TIMER_WHEEL, stop_and_period)
+{
+	TimerWheel wheel;
+	TimerWheel::Timer a, b;
+	int fired_a = 0, fired_b = 0;
+
+	auto base = Clock::now();
+	a.setup(wheel, [&]() { fired_a++; }, 0.02);
+	b.setup(wheel, [&]() { fired_b++; a.stop(); }, 0.03, true);
+
+	wheel.advance(base + milliseconds(100));
+	EXPECT_EQ(1, fired_a);		// at 20, stopped by b at 30
+	EXPECT_EQ(1, fired_b);
+	EXPECT_FALSE(a.hasStarted());
+
+	// not started timer keeps new period
+	b.setPeriod(0.5);
+	EXPECT_FALSE(b.hasStarted());
+	b.start();
+	wheel.advance(base + milliseconds(500));
+	EXPECT_EQ(1, fired_b);
+	wheel.advance(base + milliseconds(700));
+	EXPECT_EQ(2, fired_b);
+}
+
+TEST(TIMER_WHEEL, thread)
+{
+	TimerWheel wheel;
+	TimerWheel::Timer timer;
+	std::atomic<int> fired { 0 };
+
+	wheel.start();
+	timer.setup(wheel, [&]() { fired++; }, 0.01);
+
+	auto deadline = Clock::now() + seconds(2);
+	while (fired < 5 && Clock::now() < deadline)
+		std::this_thread::sleep_for(milliseconds(5));
+
+	EXPECT_LE(5, fired);
+
+	// stopped timer does not fire, destructor waits for callback
+	timer.stop();
+	int n = fired;
+	std::this_thread::sleep_for(milliseconds(50));
+	EXPECT_GE(n + 1, fired);
+	wheel.stop();
+}
+
+TEST(TIMER_WHEEL, wheel_destroyed_first)
+{
+	TimerWheel::Timer timer;
+	{
+		TimerWheel wheel;
+		timer.setup(wheel, []() {}, 1.0);
+		EXPECT_TRUE(timer.isValid());
+	}
+
+	EXPECT_FALSE(timer.isValid());
+	EXPECT_FALSE(timer.hasStarted());
+	timer.start();
+	timer.stop();
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
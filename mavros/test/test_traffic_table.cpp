@@ -0,0 +1,98 @@
+/**
+ * Test libmavros traffic table
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <mavros/traffic_table.h>
+
+using namespace mavros;
+
+TEST(TRAFFIC_TABLE, update_find)
+{
+	TrafficTable<int, 64> table;
+	bool inserted;
+
+	auto e = table.update(0xABCDEF, 1.0, inserted);
+	ASSERT_NE(nullptr, e);
+	EXPECT_TRUE(inserted);
+	EXPECT_EQ(0, e->value);
+	e->value = 7;
+
+	e = table.update(0xABCDEF, 2.0, inserted);
+	EXPECT_FALSE(inserted);
+	EXPECT_EQ(7, e->value);
+	EXPECT_EQ(2.0, e->stamp);
+
+	EXPECT_EQ(nullptr, table.find(0x123456));
+	EXPECT_EQ(1U, table.size());
+}
+
+TEST(TRAFFIC_TABLE, full)
+{
+	TrafficTable<int, 16> table;
+	bool inserted;
+
+	for (uint32_t k = 0; k < 12; k++)
+		ASSERT_NE(nullptr, table.update(k, 0.0, inserted));
+
+	EXPECT_EQ(nullptr, table.update(100, 0.0, inserted));
+	EXPECT_EQ(1U, table.overflow());
+	// existing still updated
+	EXPECT_NE(nullptr, table.update(5, 1.0, inserted));
+}
+
+TEST(TRAFFIC_TABLE, expire_matches_map)
+{
+	// random churn against std::map, exercises backward shift over clusters
+	TrafficTable<uint32_t, 256> table;
+	std::map<uint32_t, double> ref;
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<uint32_t> key(0, 400);
+	bool inserted;
+
+	for (int step = 0; step < 2000; step++) {
+		const double now = step * 0.1;
+		const uint32_t k = key(rng);
+
+		if (ref.size() < table.MAX_ENTRIES || ref.count(k)) {
+			auto e = table.update(k, now, inserted);
+			ASSERT_NE(nullptr, e);
+			EXPECT_EQ(!ref.count(k), inserted);
+			e->value = k;
+			ref[k] = now;
+		}
+
+		if (step % 50 == 49) {
+			// two passes: entry wrapped over table start may wait for next one
+			table.expire(now, 10.0);
+			table.expire(now, 10.0);
+			for (auto it = ref.begin(); it != ref.end(); ) {
+				if (now - it->second > 10.0)
+					it = ref.erase(it);
+				else
+					++it;
+			}
+
+			ASSERT_EQ(ref.size(), table.size());
+			for (auto &kv : ref) {
+				auto e = table.find(kv.first);
+				ASSERT_NE(nullptr, e);
+				EXPECT_EQ(kv.first, e->value);
+				EXPECT_EQ(kv.second, e->stamp);
+			}
+
+			size_t n = 0;
+			table.for_each([&n](const TrafficTable<uint32_t, 256>::Entry &) { n++; });
+			EXPECT_EQ(ref.size(), n);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
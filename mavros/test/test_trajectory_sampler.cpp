@@ -0,0 +1,145 @@
+/**
+ * Test trajectory resampling
+ */
+
+#include <gtest/gtest.h>
+#include <mavros/trajectory_sampler.h>
+
+using mavros::TrajectorySampler;
+using Point = TrajectorySampler::Point;
+
+static Point make_point(double t, double x, double yaw = 0.0)
+{
+	Point p;
+	p.time = t;
+	p.fields = TrajectorySampler::POSITION | TrajectorySampler::VELOCITY;
+	p.position = Eigen::Vector3d(x, 2 * x, 0);
+	p.velocity = Eigen::Vector3d(1, 0, 0);
+	p.yaw = yaw;
+	return p;
+}
+
+TEST(TRAJECTORY_SAMPLER, interpolate)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(10.0);
+
+	ASSERT_TRUE(sampler.resample({ make_point(1.0, 0.0), make_point(2.0, 1.0), make_point(3.0, 3.0) }));
+	EXPECT_DOUBLE_EQ(10.0, sampler.get_rate());
+	EXPECT_DOUBLE_EQ(1.0, sampler.start_time());
+
+	auto &s = sampler.samples();
+	ASSERT_EQ(21U, s.size());
+	EXPECT_NEAR(0.5, s[5].position.x(), 1e-9);
+	EXPECT_NEAR(1.0, s[5].position.y(), 1e-9);
+	EXPECT_NEAR(1.0, s[10].position.x(), 1e-9);
+	EXPECT_NEAR(2.0, s[15].position.x(), 1e-9);
+	EXPECT_NEAR(3.0, s.back().position.x(), 1e-9);
+	EXPECT_DOUBLE_EQ(3.0, s.back().time);
+}
+
+TEST(TRAJECTORY_SAMPLER, last_point_off_grid)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(10.0);
+
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0), make_point(0.25, 1.0) }));
+	EXPECT_DOUBLE_EQ(10.0, sampler.get_rate());
+
+	auto &s = sampler.samples();
+	ASSERT_EQ(4U, s.size());
+	EXPECT_NEAR(0.8, s[2].position.x(), 1e-9);
+	EXPECT_NEAR(1.0, s[3].position.x(), 1e-9);
+	EXPECT_DOUBLE_EQ(0.25, s[3].time);
+}
+
+TEST(TRAJECTORY_SAMPLER, dense_points_raise_rate)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(20.0);
+
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0), make_point(0.01, 1.0), make_point(0.02, 2.0) }));
+	EXPECT_DOUBLE_EQ(100.0, sampler.get_rate());
+	EXPECT_EQ(3U, sampler.samples().size());
+
+	// capped
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0), make_point(0.001, 1.0) }));
+	EXPECT_DOUBLE_EQ(TrajectorySampler::MAX_RATE, sampler.get_rate());
+
+	sampler.set_rate(1000.0);
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0), make_point(1.0, 1.0) }));
+	EXPECT_DOUBLE_EQ(TrajectorySampler::MAX_RATE, sampler.get_rate());
+}
+
+TEST(TRAJECTORY_SAMPLER, long_trajectory)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(10.0);
+
+	// dense start wants MAX_RATE, lowered to fit buffer
+	const double duration = 1000.0;
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0), make_point(0.001, 1.0), make_point(duration, 2.0) }));
+	EXPECT_LT(sampler.get_rate(), double(TrajectorySampler::MAX_RATE));
+	EXPECT_GE(sampler.get_rate(), 10.0);
+	EXPECT_LE(sampler.samples().size(), size_t(TrajectorySampler::MAX_SAMPLES));
+	EXPECT_DOUBLE_EQ(duration, sampler.samples().back().time);
+
+	// does not fit even at configured rate
+	EXPECT_FALSE(sampler.resample({ make_point(0.0, 0.0), make_point(1e4, 1.0) }));
+	EXPECT_TRUE(sampler.empty());
+	EXPECT_FALSE(sampler.resample({ make_point(0.0, 0.0), make_point(1e300, 1.0) }));
+}
+
+TEST(TRAJECTORY_SAMPLER, yaw_shortest_arc)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(2.0);
+
+	ASSERT_TRUE(sampler.resample({ make_point(0.0, 0.0, 3.0), make_point(1.0, 0.0, -3.0) }));
+
+	auto &s = sampler.samples();
+	ASSERT_EQ(3U, s.size());
+	EXPECT_NEAR(M_PI, std::abs(s[1].yaw), 1e-9);
+}
+
+TEST(TRAJECTORY_SAMPLER, missing_fields_held)
+{
+	TrajectorySampler sampler;
+	sampler.set_rate(2.0);
+
+	auto a = make_point(0.0, 0.0);
+	auto b = make_point(1.0, 10.0);
+	b.fields = TrajectorySampler::VELOCITY;
+	b.velocity = Eigen::Vector3d(3, 0, 0);
+
+	ASSERT_TRUE(sampler.resample({ a, b }));
+
+	auto &s = sampler.samples();
+	ASSERT_EQ(3U, s.size());
+	EXPECT_EQ(a.fields, s[1].fields);
+	EXPECT_NEAR(0.0, s[1].position.x(), 1e-9);	// held
+	EXPECT_NEAR(2.0, s[1].velocity.x(), 1e-9);	// interpolated
+	EXPECT_EQ(b.fields, s[2].fields);
+}
+
+TEST(TRAJECTORY_SAMPLER, degenerate)
+{
+	TrajectorySampler sampler;
+
+	EXPECT_FALSE(sampler.resample({}));
+	EXPECT_TRUE(sampler.empty());
+
+	// single point, point back in time dropped
+	ASSERT_TRUE(sampler.resample({ make_point(0.5, 1.0), make_point(0.2, 5.0) }));
+	ASSERT_EQ(1U, sampler.samples().size());
+	EXPECT_NEAR(1.0, sampler.samples()[0].position.x(), 1e-9);
+
+	sampler.clear();
+	EXPECT_TRUE(sampler.empty());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+/**
+ * Test libmavros camera trigger history
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/trigger_history.h>
+
+using namespace mavros;
+
+TEST(TRIGGER_HISTORY, find)
+{
+	TriggerHistory<8> hist;
+	uint64_t stamp;
+
+	EXPECT_TRUE(hist.empty());
+	EXPECT_FALSE(hist.find(0, stamp));
+
+	for (uint32_t seq = 10; seq < 15; seq++)
+		hist.add(seq, seq * 1000);
+
+	ASSERT_TRUE(hist.find(12, stamp));
+	EXPECT_EQ(12000U, stamp);
+	EXPECT_FALSE(hist.find(15, stamp));
+	EXPECT_FALSE(hist.find(9, stamp));
+	EXPECT_EQ(14U, hist.newest());
+
+	EXPECT_TRUE(hist.passed(13));
+	EXPECT_FALSE(hist.passed(14));
+	EXPECT_FALSE(hist.passed(20));
+}
+
+TEST(TRIGGER_HISTORY, overwrite)
+{
+	TriggerHistory<8> hist;
+	uint64_t stamp;
+
+	for (uint32_t seq = 0; seq < 20; seq++)
+		hist.add(seq, seq);
+
+	// only last 8 kept
+	EXPECT_FALSE(hist.find(11, stamp));
+	ASSERT_TRUE(hist.find(12, stamp));
+	EXPECT_EQ(12U, stamp);
+	ASSERT_TRUE(hist.find(19, stamp));
+}
+
+TEST(TRIGGER_HISTORY, reset)
+{
+	TriggerHistory<8> hist;
+	uint64_t stamp;
+
+	for (uint32_t seq = 100; seq < 105; seq++)
+		hist.add(seq, seq);
+
+	// trigger restarted
+	hist.add(0, 5);
+	EXPECT_FALSE(hist.find(104, stamp));
+	ASSERT_TRUE(hist.find(0, stamp));
+	EXPECT_EQ(5U, stamp);
+	EXPECT_FALSE(hist.passed(3));
+}
+
+TEST(TRIGGER_HISTORY, duplicate)
+{
+	TriggerHistory<8> hist;
+	uint64_t stamp;
+
+	hist.add(10, 100);
+	hist.add(11, 110);
+
+	// resent trigger, history kept
+	hist.add(11, 999);
+	ASSERT_TRUE(hist.find(10, stamp));
+	EXPECT_EQ(100U, stamp);
+	ASSERT_TRUE(hist.find(11, stamp));
+	EXPECT_EQ(110U, stamp);
+	EXPECT_EQ(11U, hist.newest());
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,80 @@
+/**
+ * Test libmavros uplink governor
+ */
+
+#include <gtest/gtest.h>
+
+#include <mavros/uplink_governor.h>
+
+using namespace mavros;
+
+TEST(UPLINK_GOVERNOR, decimation)
+{
+	UplinkGovernor gov;
+	size_t sent = 0;
+
+	// no limit
+	for (uint64_t t = 1; t <= 10; t++)
+		EXPECT_TRUE(gov.pass(t * 5000000));
+
+	// 200 Hz with jitter to 30 Hz
+	gov.set_rate(30.0);
+	for (uint64_t i = 0; i < 2000; i++) {
+		const uint64_t jitter = (i % 3) * 400000;
+		if (gov.pass(1000000000ULL + i * 5000000 + jitter))
+			sent++;
+	}
+
+	// 10 s of data
+	EXPECT_GE(sent, 280U);
+	EXPECT_LE(sent, 340U);
+	EXPECT_EQ(2000U - sent, gov.dropped());
+
+	// stamp going back passes
+	EXPECT_TRUE(gov.pass(1000));
+}
+
+TEST(UPLINK_GOVERNOR, covariance_cache)
+{
+	CovarianceCache<2, 3> cache;
+	size_t conversions = 0;
+	auto urt = [&conversions](const CovarianceCache<2, 3>::Input &in, CovarianceCache<2, 3>::Output &out) {
+		conversions++;
+		out = {{ float(in[0]), float(in[1]), float(in[3]) }};
+	};
+
+	CovarianceCache<2, 3>::Input cov {{ 1.0, 0.5, 0.5, 2.0 }};
+	EXPECT_EQ(2.0f, cache.get(cov, urt)[2]);
+	cache.get(cov, urt);
+	EXPECT_EQ(1U, conversions);
+	EXPECT_EQ(1U, cache.hits());
+
+	// exact by default
+	cov[3] = 2.01;
+	EXPECT_EQ(2.01f, cache.get(cov, urt)[2]);
+	EXPECT_EQ(2U, conversions);
+
+	cache.set_tolerance(0.05);
+	cov[3] = 2.05;
+	EXPECT_EQ(2.01f, cache.get(cov, urt)[2]);
+	EXPECT_EQ(2U, conversions);
+	cov[3] = 3.0;
+	EXPECT_EQ(3.0f, cache.get(cov, urt)[2]);
+	EXPECT_EQ(3U, conversions);
+
+	// unknown stays unknown
+	cov[0] = NAN;
+	cache.get(cov, urt);
+	cache.get(cov, urt);
+	EXPECT_EQ(4U, conversions);
+
+	cache.invalidate();
+	cache.get(cov, urt);
+	EXPECT_EQ(5U, conversions);
+}
+
+int main(int argc, char **argv)
+{
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,27 @@
+/**
+ * @brief MAVROS Node with statically linked extras plugins
+ * @file mavros_extras_node.cpp
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * Built only with MAVROS_STATIC_PLUGINS option,
+ * otherwise mavros_node loads extras plugins by pluginlib.
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#include <mavros/mavros.h>
+
+int main(int argc, char *argv[])
+{
+	ros::init(argc, argv, "mavros");
+
+	mavros::MavRos mavros;
+	mavros.spin();
+
+	return 0;
+}
@@ -14,9 +14,12 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
+#include <mavros/traffic_table.h>
 
 #include <mavros_msgs/ADSBVehicle.h>
+#include <mavros_msgs/ADSBVehicleArray.h>
 
 namespace mavros {
 namespace extra_plugins {
@@ -27,19 +30,35 @@ using mavlink::common::ADSB_ALTITUDE_TYPE;
  * @brief ADS-B Vehicle plugin
  *
  * Publish/subscribe Automatic dependent surveillance-broadcast data to/from a vehicle.
+ *
+ * Received vehicles kept in traffic table by ICAO address. ~adsb/vehicle gets
+ * only reports which differ from last one of that vehicle (unless change_only is off),
+ * ~adsb/vehicles snapshot of whole table published at ~adsb/snapshot_rate.
  */
 class ADSBPlugin : public plugin::PluginBase {
 public:
 	ADSBPlugin() : PluginBase(),
-		adsb_nh("~adsb")
+		adsb_nh(private_nh("adsb"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(adsb_nh);
+
+		double snapshot_rate;
+		adsb_nh.param("change_only", change_only, true);
+		adsb_nh.param("snapshot_rate", snapshot_rate, 1.0);
+		adsb_nh.param("timeout", timeout, 10.0);
 
 		adsb_pub = adsb_nh.advertise<mavros_msgs::ADSBVehicle>("vehicle", 10);
+		adsb_array_pub = adsb_nh.advertise<mavros_msgs::ADSBVehicleArray>("vehicles", 1);
 		adsb_sub = adsb_nh.subscribe("send", 10, &ADSBPlugin::adsb_cb, this);
+
+		// timer also expires table, so it runs without snapshots
+		publish_snapshot = snapshot_rate > 0.0;
+		make_timer(snapshot_timer, ros::Duration(publish_snapshot ? 1.0 / snapshot_rate : 1.0),
+				&ADSBPlugin::snapshot_cb);
 	}
 
 	Subscriptions get_subscriptions()
@@ -53,13 +72,34 @@ private:
 	ros::NodeHandle adsb_nh;
 
 	ros::Publisher adsb_pub;
+	ros::Publisher adsb_array_pub;
 	ros::Subscriber adsb_sub;
-
-	void handle_adsb(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ADSB_VEHICLE &adsb)
+	Timer snapshot_timer;
+
+	//! Last report of vehicle
+	struct Vehicle {
+		mavlink::common::msg::ADSB_VEHICLE adsb;
+		ros::Time stamp;
+	};
+
+	std::mutex mutex;
+	TrafficTable<Vehicle> traffic;
+	bool change_only;
+	bool publish_snapshot;
+	double timeout;
+
+	//! Same report, except time since last communication
+	static bool same_report(const mavlink::common::msg::ADSB_VEHICLE &a, const mavlink::common::msg::ADSB_VEHICLE &b)
 	{
-		auto adsb_msg = boost::make_shared<mavros_msgs::ADSBVehicle>();
+		return a.lat == b.lat && a.lon == b.lon && a.altitude == b.altitude &&
+		       a.heading == b.heading && a.hor_velocity == b.hor_velocity && a.ver_velocity == b.ver_velocity &&
+		       a.callsign == b.callsign && a.altitude_type == b.altitude_type && a.emitter_type == b.emitter_type &&
+		       a.flags == b.flags && a.squawk == b.squawk;
+	}
 
-		adsb_msg->header.stamp = ros::Time::now();	//TODO: request add time_boot_ms to msg definition
+	static void fill_msg(mavros_msgs::ADSBVehicle *adsb_msg, const mavlink::common::msg::ADSB_VEHICLE &adsb, const ros::Time &stamp)
+	{
+		adsb_msg->header.stamp = stamp;	//TODO: request add time_boot_ms to msg definition
 		// [[[cog:
 		// def ent(ros, mav=None, scale=None, to_ros=None, to_mav=None):
 		//     return (ros, mav or ros, scale, to_ros, to_mav)
@@ -103,6 +143,31 @@ private:
 		adsb_msg->flags = adsb.flags;
 		adsb_msg->squawk = adsb.squawk;
 		// [[[end]]] (checksum: b9c515e7a6fe688b91f4e72e655b9154)
+	}
+
+	void handle_adsb(const mavlink::mavlink_message_t *msg, mavlink::common::msg::ADSB_VEHICLE &adsb)
+	{
+		const ros::Time now = ros::Time::now();
+		bool changed = true;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bool inserted;
+			auto entry = traffic.update(adsb.ICAO_address, now.toSec(), inserted);
+			if (entry) {
+				changed = inserted || !same_report(entry->value.adsb, adsb);
+				entry->value.adsb = adsb;
+				entry->value.stamp = now;
+			}
+			else
+				ROS_WARN_THROTTLE_NAMED(10, "adsb", "ADSB: traffic table full, %zu vehicles", traffic.size());
+		}
+
+		if (change_only && !changed)
+			return;
+
+		auto adsb_msg = boost::make_shared<mavros_msgs::ADSBVehicle>();
+		fill_msg(adsb_msg.get(), adsb, now);
 
 		ROS_DEBUG_STREAM_NAMED("adsb", "ADSB: recv type: " << utils::to_string_enum<ADSB_ALTITUDE_TYPE>(adsb.altitude_type)
 				<< " emitter: " << utils::to_string_enum<ADSB_EMITTER_TYPE>(adsb.emitter_type)
@@ -111,6 +176,31 @@ private:
 		adsb_pub.publish(adsb_msg);
 	}
 
+	//! Expire traffic table, publish snapshot of it
+	void snapshot_cb(const ros::TimerEvent &event)
+	{
+		auto array_msg = boost::make_shared<mavros_msgs::ADSBVehicleArray>();
+		array_msg->header.stamp = ros::Time::now();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const size_t expired = traffic.expire(array_msg->header.stamp.toSec(), timeout);
+			if (expired > 0)
+				ROS_DEBUG_NAMED("adsb", "ADSB: %zu vehicles expired", expired);
+
+			if (!publish_snapshot)
+				return;
+
+			array_msg->vehicles.resize(traffic.size());
+			auto it = array_msg->vehicles.begin();
+			traffic.for_each([&it](const TrafficTable<Vehicle>::Entry &e) {
+					fill_msg(&*it++, e.value.adsb, e.value.stamp);
+				});
+		}
+
+		adsb_array_pub.publish(array_msg);
+	}
+
 	void adsb_cb(const mavros_msgs::ADSBVehicle::ConstPtr &req)
 	{
 		mavlink::common::msg::ADSB_VEHICLE adsb{};
@@ -149,5 +239,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::ADSBPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::ADSBPlugin)
@@ -14,30 +14,103 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
+#include <deque>
+#include <cstring>
 #include <mavros/mavros_plugin.h>
+#include <mavros/trigger_history.h>
+#include <topic_tools/shape_shifter.h>
 
 #include <mavros_msgs/CamIMUStamp.h>
 
 namespace mavros {
-namespace extra_plugins{
+namespace extra_plugins {
+/**
+ * @brief Already serialized message, published as is
+ *
+ * Unlike ShapeShifter it gives write access to its buffer, so restamped
+ * frame is sent without copying it into another message.
+ */
+struct SerializedFrame {
+	std::vector<uint8_t> data;
+	const std::string *md5sum;
+	const std::string *datatype;
+	const std::string *definition;
+};
+}	// namespace extra_plugins
+}	// namespace mavros
+
+namespace ros {
+namespace message_traits {
+template<> struct IsMessage<mavros::extra_plugins::SerializedFrame> : TrueType {};
+
+template<> struct MD5Sum<mavros::extra_plugins::SerializedFrame> {
+	static const char *value(const mavros::extra_plugins::SerializedFrame &m) { return m.md5sum->c_str(); }
+	static const char *value() { return "*"; }
+};
+
+template<> struct DataType<mavros::extra_plugins::SerializedFrame> {
+	static const char *value(const mavros::extra_plugins::SerializedFrame &m) { return m.datatype->c_str(); }
+	static const char *value() { return "*"; }
+};
+
+template<> struct Definition<mavros::extra_plugins::SerializedFrame> {
+	static const char *value(const mavros::extra_plugins::SerializedFrame &m) { return m.definition->c_str(); }
+};
+}	// namespace message_traits
+
+namespace serialization {
+template<> struct Serializer<mavros::extra_plugins::SerializedFrame> {
+	template<typename Stream>
+	inline static void write(Stream &stream, const mavros::extra_plugins::SerializedFrame &m) {
+		std::memcpy(stream.advance(m.data.size()), m.data.data(), m.data.size());
+	}
+
+	inline static uint32_t serializedLength(const mavros::extra_plugins::SerializedFrame &m) {
+		return m.data.size();
+	}
+};
+}	// namespace serialization
+}	// namespace ros
+
+namespace mavros {
+namespace extra_plugins {
 /**
  * @brief Camera IMU synchronisation plugin
  *
  * This plugin publishes a timestamp for when a external camera system was
  * triggered by the FCU. Sequence ID from the message and the image sequence from
  * camera can be corellated to get the exact shutter trigger time.
+ *
+ * In restamp mode plugin does that correlation itself: any message starting with
+ * std_msgs/Header (sensor_msgs/Image, CompressedImage, ...) received on ~cam_imu_sync/image
+ * is republished on ~cam_imu_sync/image_restamped with stamp of its trigger.
+ * Message handled serialized, only header stamp is patched, pixel data never deserialized.
  */
 class CamIMUSyncPlugin : public plugin::PluginBase {
 public:
 	CamIMUSyncPlugin() : PluginBase(),
-		cam_imu_sync_nh("~cam_imu_sync")
+		cam_imu_sync_nh(private_nh("cam_imu_sync")),
+		restamp(false),
+		seq_offset(0),
+		queue_size(5)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(cam_imu_sync_nh);
+
+		cam_imu_sync_nh.param("restamp/enable", restamp, false);
+		cam_imu_sync_nh.param("restamp/seq_offset", seq_offset, 0);
+		cam_imu_sync_nh.param("restamp/queue_size", queue_size, 5);
+		queue_size = std::max(1, queue_size);
 
 		cam_imu_pub = cam_imu_sync_nh.advertise<mavros_msgs::CamIMUStamp>("cam_imu_stamp", 10);
+
+		if (restamp)
+			image_sub = cam_imu_sync_nh.subscribe("image", 10, &CamIMUSyncPlugin::image_cb, this,
+					ros::TransportHints().tcpNoDelay());
 	}
 
 	Subscriptions get_subscriptions()
@@ -51,6 +124,28 @@ private:
 	ros::NodeHandle cam_imu_sync_nh;
 
 	ros::Publisher cam_imu_pub;
+	ros::Publisher image_pub;
+	ros::Subscriber image_sub;
+
+	bool restamp;
+	int seq_offset;		//!< trigger seq = image seq + offset
+	int queue_size;		//!< images waiting for its trigger
+
+	//! Serialized message waiting for trigger
+	struct Frame {
+		uint32_t seq;
+		boost::shared_ptr<SerializedFrame> msg;
+	};
+
+	//! Serialized std_msgs/Header: uint32 seq, uint32 sec, uint32 nsec, ...
+	static constexpr size_t HEADER_SEQ_OFFSET = 0;
+	static constexpr size_t HEADER_STAMP_OFFSET = 4;
+	static constexpr size_t HEADER_MIN_LEN = 12;
+
+	std::mutex mutex;
+	TriggerHistory<> triggers;
+	std::deque<Frame> pending;
+	std::string md5sum, datatype, definition;
 
 	void handle_cam_trig(const mavlink::mavlink_message_t *msg, mavlink::common::msg::CAMERA_TRIGGER &ctrig)
 	{
@@ -59,11 +154,88 @@ private:
 		sync_msg->frame_stamp = m_uas->synchronise_stamp(ctrig.time_usec);
 		sync_msg->frame_seq_id = ctrig.seq;
 
+		if (restamp) {
+			std::lock_guard<std::mutex> lock(mutex);
+			triggers.add(ctrig.seq, sync_msg->frame_stamp.toNSec());
+			publish_pending();
+		}
+
 		cam_imu_pub.publish(sync_msg);
 	}
+
+	void image_cb(const topic_tools::ShapeShifter::ConstPtr &img)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!image_pub) {
+			md5sum = img->getMD5Sum();
+			datatype = img->getDataType();
+			definition = img->getMessageDefinition();
+			image_pub = img->advertise(cam_imu_sync_nh, "image_restamped", 10);
+		}
+
+		if (img->size() < HEADER_MIN_LEN) {
+			ROS_WARN_THROTTLE_NAMED(10, "cam_imu_sync", "CAM: %s has no header, can not restamp", datatype.c_str());
+			return;
+		}
+
+		// the only copy of image data, published buffer
+		Frame frame;
+		frame.msg = boost::make_shared<SerializedFrame>();
+		frame.msg->data.resize(img->size());
+		frame.msg->md5sum = &md5sum;
+		frame.msg->datatype = &datatype;
+		frame.msg->definition = &definition;
+		ros::serialization::OStream os(frame.msg->data.data(), frame.msg->data.size());
+		img->write(os);
+
+		std::memcpy(&frame.seq, &frame.msg->data[HEADER_SEQ_OFFSET], sizeof(frame.seq));
+		pending.push_back(std::move(frame));
+		if (pending.size() > size_t(queue_size)) {
+			ROS_WARN_THROTTLE_NAMED(10, "cam_imu_sync", "CAM: no trigger for frame %u, dropped", pending.front().seq);
+			pending.pop_front();
+		}
+
+		publish_pending();
+	}
+
+	//! Publish queued frames which have trigger, drop ones whose trigger is lost
+	void publish_pending()
+	{
+		while (!pending.empty()) {
+			auto &frame = pending.front();
+			const uint32_t trig_seq = frame.seq + seq_offset;
+
+			uint64_t stamp_ns;
+			if (triggers.find(trig_seq, stamp_ns)) {
+				publish_frame(frame, stamp_ns);
+			}
+			else if (triggers.passed(trig_seq)) {
+				ROS_WARN_THROTTLE_NAMED(10, "cam_imu_sync", "CAM: trigger %u lost, frame dropped", trig_seq);
+			}
+			else {
+				break;	// trigger not yet received
+			}
+
+			pending.pop_front();
+		}
+	}
+
+	void publish_frame(Frame &frame, uint64_t stamp_ns)
+	{
+		ros::Time stamp;
+		stamp.fromNSec(stamp_ns);
+
+		auto &data = frame.msg->data;
+		std::memcpy(&data[HEADER_STAMP_OFFSET], &stamp.sec, sizeof(stamp.sec));
+		std::memcpy(&data[HEADER_STAMP_OFFSET + sizeof(stamp.sec)], &stamp.nsec, sizeof(stamp.nsec));
+
+		// by pointer: serialized once, only if there is remote subscriber
+		image_pub.publish(frame.msg);
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::CamIMUSyncPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::CamIMUSyncPlugin)
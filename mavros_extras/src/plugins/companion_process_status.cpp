@@ -36,12 +36,13 @@ using utils::enum_value;
 class CompanionProcessStatusPlugin : public plugin::PluginBase {
 public:
 	CompanionProcessStatusPlugin() : PluginBase(),
-	status_nh("~companion_process")
+	status_nh(private_nh("companion_process"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(status_nh);
 
 		status_sub = status_nh.subscribe("status", 10, &CompanionProcessStatusPlugin::status_cb, this);
 	}
@@ -80,5 +81,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::CompanionProcessStatusPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::CompanionProcessStatusPlugin)
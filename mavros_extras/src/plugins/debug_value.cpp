@@ -14,31 +14,56 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
+#include <cctype>
 #include <mavros/mavros_plugin.h>
+#include <mavros/name_interner.h>
 
+#include <std_msgs/Float32.h>
+#include <std_msgs/Int32.h>
 #include <mavros_msgs/DebugValue.h>
+#include <mavros_msgs/DebugValueArray.h>
 
 namespace mavros {
 namespace extra_plugins {
-//! @brief Plugin for Debug msgs from MAVLink API
+/**
+ * @brief Plugin for Debug msgs from MAVLink API
+ *
+ * NAMED_VALUE_FLOAT/INT names are interned to small ids on first appearance.
+ * Optionally each name gets own ~debug_value/named/<name> topic (std_msgs/Float32 or Int32),
+ * and/or last values of all names packed to ~debug_value/named_values at named_value/array_rate.
+ */
 class DebugValuePlugin : public plugin::PluginBase {
 public:
 	DebugValuePlugin() : PluginBase(),
-		debug_nh("~debug_value")
+		debug_nh(private_nh("debug_value")),
+		per_name_topics(false),
+		publish_array(false)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(debug_nh);
 
 		// subscribers
 		debug_sub = debug_nh.subscribe("send", 10, &DebugValuePlugin::debug_cb, this);
 
 		// publishers
-		debug_pub = debug_nh.advertise<mavros_msgs::DebugValue>("debug", 10);
-		debug_vector_pub = debug_nh.advertise<mavros_msgs::DebugValue>("debug_vector", 10);
-		named_value_float_pub = debug_nh.advertise<mavros_msgs::DebugValue>("named_value_float", 10);
-		named_value_int_pub = debug_nh.advertise<mavros_msgs::DebugValue>("named_value_int", 10);
+		debug_pub.advertise<mavros_msgs::DebugValue>(debug_nh, "debug", 10);
+		debug_vector_pub.advertise<mavros_msgs::DebugValue>(debug_nh, "debug_vector", 10);
+		named_value_float_pub.advertise<mavros_msgs::DebugValue>(debug_nh, "named_value_float", 10);
+		named_value_int_pub.advertise<mavros_msgs::DebugValue>(debug_nh, "named_value_int", 10);
+
+		double array_rate;
+		debug_nh.param("named_value/per_name_topics", per_name_topics, false);
+		debug_nh.param("named_value/array_rate", array_rate, 0.0);
+
+		publish_array = array_rate > 0.0;
+		if (publish_array) {
+			named_values_pub = debug_nh.advertise<mavros_msgs::DebugValueArray>("named_values", 10);
+			make_timer(array_timer, ros::Duration(1.0 / array_rate), &DebugValuePlugin::array_cb);
+		}
 	}
 
 	Subscriptions get_subscriptions() {
@@ -55,10 +80,83 @@ private:
 
 	ros::Subscriber debug_sub;
 
-	ros::Publisher debug_pub;
-	ros::Publisher debug_vector_pub;
-	ros::Publisher named_value_float_pub;
-	ros::Publisher named_value_int_pub;
+	plugin::LazyPublisher debug_pub;
+	plugin::LazyPublisher debug_vector_pub;
+	plugin::LazyPublisher named_value_float_pub;
+	plugin::LazyPublisher named_value_int_pub;
+	ros::Publisher named_values_pub;
+	Timer array_timer;
+
+	//! Last value of interned name
+	struct NamedValue {
+		uint8_t type;		//!< DebugValue::TYPE_NAMED_VALUE_*
+		ros::Time stamp;
+		float value_float;
+		int32_t value_int;
+		ros::Publisher pub;	//!< per-name topic
+	};
+
+	using NameTable = NameInterner<10>;
+
+	bool per_name_topics;
+	bool publish_array;
+	std::mutex mutex;
+	NameTable names;
+	std::vector<NamedValue> named_values;	//!< indexed by name id
+
+	/**
+	 * @brief Record of @a name, created on its first message
+	 * @note mutex should be held
+	 * @return nullptr if table is full or name changed value type
+	 */
+	NamedValue *named_value(const NameTable::Name &name, uint8_t type, const ros::Time &stamp)
+	{
+		using DV = mavros_msgs::DebugValue;
+
+		const int id = names.intern(name);
+		if (id < 0) {
+			ROS_WARN_THROTTLE_NAMED(10, "debug_value", "DV: name table full (%zu names)", names.size());
+			return nullptr;
+		}
+
+		if (size_t(id) == named_values.size()) {
+			named_values.emplace_back();
+			auto &nv = named_values.back();
+			nv.type = type;
+			nv.value_float = 0.0f;
+			nv.value_int = 0;
+
+			if (per_name_topics) {
+				const auto topic = "named/" + topic_name(names.name(id));
+				if (type == DV::TYPE_NAMED_VALUE_INT)
+					nv.pub = debug_nh.advertise<std_msgs::Int32>(topic, 10);
+				else
+					nv.pub = debug_nh.advertise<std_msgs::Float32>(topic, 10);
+			}
+		}
+
+		auto &nv = named_values[id];
+		if (nv.type != type) {
+			ROS_WARN_THROTTLE_NAMED(10, "debug_value", "DV: %s changed value type, ignored", names.name(id).c_str());
+			return nullptr;
+		}
+
+		nv.stamp = stamp;
+		return &nv;
+	}
+
+	//! Valid ROS name from value name
+	static std::string topic_name(const std::string &name)
+	{
+		std::string topic = name.empty() ? "UNK" : name;
+		for (auto &c : topic) {
+			if (!std::isalnum(uint8_t(c)) && c != '_')
+				c = '_';
+		}
+		if (!std::isalpha(uint8_t(topic[0])))
+			topic.insert(0, "v");
+		return topic;
+	}
 
 	/* -*- helpers -*- */
 
@@ -113,6 +211,10 @@ private:
 	 */
 	void handle_debug(const mavlink::mavlink_message_t *msg, mavlink::common::msg::DEBUG &debug)
 	{
+		// note: debug log also skipped when topic not subscribed
+		if (!debug_pub.has_subscribers())
+			return;
+
 		// [[[cog:
 		// p = "dv_msg"
 		// val = "debug"
@@ -153,6 +255,10 @@ private:
 	 */
 	void handle_debug_vector(const mavlink::mavlink_message_t *msg, mavlink::common::msg::DEBUG_VECT &debug)
 	{
+		// note: debug log also skipped when topic not subscribed
+		if (!debug_vector_pub.has_subscribers())
+			return;
+
 		// [[[cog:
 		// common_filler("TYPE_DEBUG_VECT", "time_usec", -1, "name")
 		//
@@ -189,6 +295,25 @@ private:
 	 */
 	void handle_named_value_float(const mavlink::mavlink_message_t *msg, mavlink::common::msg::NAMED_VALUE_FLOAT &value)
 	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto nv = (per_name_topics || publish_array) ?
+					named_value(value.name, mavros_msgs::DebugValue::TYPE_NAMED_VALUE_FLOAT,
+						m_uas->synchronise_stamp(value.time_boot_ms)) : nullptr;
+			if (nv) {
+				nv->value_float = value.value;
+				if (per_name_topics) {
+					auto f_msg = boost::make_shared<std_msgs::Float32>();
+					f_msg->data = value.value;
+					nv->pub.publish(f_msg);
+				}
+			}
+		}
+
+		// note: debug log also skipped when topic not subscribed
+		if (!named_value_float_pub.has_subscribers())
+			return;
+
 		// [[[cog:
 		// val="value"
 		// common_filler("TYPE_NAMED_VALUE_FLOAT", "time_boot_ms", -1, "name")
@@ -214,6 +339,25 @@ private:
 	 */
 	void handle_named_value_int(const mavlink::mavlink_message_t *msg, mavlink::common::msg::NAMED_VALUE_INT &value)
 	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto nv = (per_name_topics || publish_array) ?
+					named_value(value.name, mavros_msgs::DebugValue::TYPE_NAMED_VALUE_INT,
+						m_uas->synchronise_stamp(value.time_boot_ms)) : nullptr;
+			if (nv) {
+				nv->value_int = value.value;
+				if (per_name_topics) {
+					auto i_msg = boost::make_shared<std_msgs::Int32>();
+					i_msg->data = value.value;
+					nv->pub.publish(i_msg);
+				}
+			}
+		}
+
+		// note: debug log also skipped when topic not subscribed
+		if (!named_value_int_pub.has_subscribers())
+			return;
+
 		// [[[cog:
 		// common_filler("TYPE_NAMED_VALUE_INT", "time_boot_ms", -1, "name")
 		// cog.outl("""{p}->value_int = {val}.value;""".format(**locals()))
@@ -232,6 +376,32 @@ private:
 
 	/* -*- callbacks -*- */
 
+	//! Publish last value of each name
+	void array_cb(const ros::TimerEvent &event)
+	{
+		auto array_msg = boost::make_shared<mavros_msgs::DebugValueArray>();
+		array_msg->header.stamp = ros::Time::now();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (named_values.empty())
+			return;
+
+		array_msg->values.resize(named_values.size());
+		for (size_t id = 0; id < named_values.size(); id++) {
+			auto &nv = named_values[id];
+			auto &dv = array_msg->values[id];
+
+			dv.header.stamp = nv.stamp;
+			dv.type = nv.type;
+			dv.index = -1;
+			dv.name = names.name(id);
+			dv.value_float = nv.value_float;
+			dv.value_int = nv.value_int;
+		}
+
+		named_values_pub.publish(array_msg);
+	}
+
 	/**
 	 * @brief Debug callbacks
 	 * @param req	pointer to mavros_msgs/Debug.msg being published
@@ -298,5 +468,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::DebugValuePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::DebugValuePlugin)
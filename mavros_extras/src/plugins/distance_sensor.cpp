@@ -16,6 +16,7 @@
 #include <unordered_map>
 #include <mavros/utils.h>
 #include <mavros/mavros_plugin.h>
+#include <mavros/sliding_variance.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <sensor_msgs/Range.h>
@@ -41,8 +42,7 @@ public:
 		field_of_view(0),
 		orientation(-1),
 		covariance(0),
-		owner(nullptr),
-		data_index(0)
+		owner(nullptr)
 	{ }
 
 	// params
@@ -66,41 +66,17 @@ public:
 	static Ptr create_item(DistanceSensorPlugin *owner, std::string topic_name);
 
 private:
-	std::vector<float> data;	//!< array allocation for measurements
-	size_t data_index;		//!< array index
-
 	static constexpr size_t ACC_SIZE = 50;
 
+	//! variance of last ACC_SIZE measurements, spikes filtered if median gate set
+	SlidingVariance<ACC_SIZE> range_stats;
+
 	/**
 	 * Calculate measurements variance to send to the FCU.
 	 */
 	float calculate_variance(float range) {
-		if (data.size() < ACC_SIZE) {
-			// limits the size of the array to 50 elements
-			data.reserve(ACC_SIZE);
-			data.push_back(range);
-		}
-		else {
-			data[data_index] = range;	// it starts rewriting the values from 1st element
-			if (++data_index > ACC_SIZE - 1)
-				data_index = 0;		// restarts the index when achieves the last element
-		}
-
-		float average, variance, sum = 0, sum_ = 0;
-
-		/*  Compute the sum of all elements */
-		for (auto d : data)
-			sum += d;
-
-		average = sum / data.size();
-
-		/*  Compute the variance */
-		for (auto d : data)
-			sum_ += (d - average) * (d - average);
-
-		variance = sum_ / data.size();
-
-		return variance;
+		range_stats.add(range);
+		return range_stats.variance();
 	}
 };
 
@@ -113,12 +89,13 @@ private:
 class DistanceSensorPlugin : public plugin::PluginBase {
 public:
 	DistanceSensorPlugin() : PluginBase(),
-		dist_nh("~distance_sensor")
+		dist_nh(private_nh("distance_sensor"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(dist_nh);
 
 		dist_nh.param<std::string>("base_frame_id", base_frame_id, "base_link");
 
@@ -266,7 +243,7 @@ private:
 			tf::vectorEigenToMsg(sensor->position, transform.transform.translation);
 
 			/* transform broadcast */
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf_aggregator.send(transform);
 		}
 
 		sensor->pub.publish(range);
@@ -281,10 +258,13 @@ void DistanceSensorItem::range_cb(const sensor_msgs::Range::ConstPtr &msg)
 	uint8_t covariance_ = 0;
 
 	if (covariance > 0) covariance_ = covariance;
-	else covariance_ = uint8_t(calculate_variance(msg->range) * 1E2);	// in cm
+	else {
+		const float variance = calculate_variance(msg->range);
+		covariance_ = uint8_t(std::min(variance * 1E2, 255.0));	// in cm
 
-	/** @todo Propose changing covarince from uint8_t to float */
-	ROS_DEBUG_NAMED("distance_sensor", "DS: %d: sensor variance: %f", sensor_id, calculate_variance(msg->range) * 1E2);
+		/** @todo Propose changing covarince from uint8_t to float */
+		ROS_DEBUG_NAMED("distance_sensor", "DS: %d: sensor variance: %f", sensor_id, variance * 1E2);
+	}
 
 	// current mapping, may change later
 	if (msg->radiation_type == sensor_msgs::Range::INFRARED)
@@ -377,6 +357,14 @@ DistanceSensorItem::Ptr DistanceSensorItem::create_item(DistanceSensorPlugin *ow
 
 		// optional
 		pnh.param("covariance", p->covariance, 0);
+
+		// optional spike rejection of measured variance: median window and max deviation [m]
+		int median_window;
+		double outlier_threshold;
+		pnh.param("median_window", median_window, 0);
+		pnh.param("outlier_threshold", outlier_threshold, 0.5);
+		if (median_window > 0)
+			p->range_stats.set_median_gate(median_window, outlier_threshold);
 	}
 
 	// create topic handles
@@ -390,5 +378,5 @@ DistanceSensorItem::Ptr DistanceSensorItem::create_item(DistanceSensorPlugin *ow
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::DistanceSensorPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::DistanceSensorPlugin)
@@ -43,7 +43,7 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	FakeGPSPlugin() : PluginBase(),
-		fp_nh("~fake_gps"),
+		fp_nh(private_nh("fake_gps")),
 		gps_rate(5.0),
 		use_mocap(true),
 		map_origin(0.0, 0.0, 0.0),
@@ -59,9 +59,16 @@ public:
 		earth(GeographicLib::Constants::WGS84_a(), GeographicLib::Constants::WGS84_f())
 	{ }
 
+	~FakeGPSPlugin()
+	{
+		// callback uses members, they go before mixin
+		tf2_stop();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(fp_nh);
 
 		double _gps_rate;
 		double origin_lat, origin_lon, origin_alt;
@@ -219,7 +226,7 @@ private:
 		fix.lat = geodetic.x() * 1e7;		// [degrees * 1e7]
 		fix.lon = geodetic.y() * 1e7;		// [degrees * 1e7]
 		fix.alt = (geodetic.z() + GeographicLib::Geoid::ELLIPSOIDTOGEOID *
-			  (*m_uas->egm96_5)(geodetic.x(), geodetic.y())) * 1e3;	// [meters * 1e3]
+			  m_uas->geoid_cache.height(geodetic.x(), geodetic.y())) * 1e3;	// [meters * 1e3]
 		fix.vel = vel.block<2, 1>(0, 0).norm();	// [cm/s]
 		fix.vn = vel.x();			// [cm/s]
 		fix.ve = vel.y();			// [cm/s]
@@ -274,5 +281,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::FakeGPSPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::FakeGPSPlugin)
@@ -15,8 +15,10 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/rtcm_packer.h>
 #include <mavros_msgs/RTCM.h>
 #include <algorithm>
+#include <mutex>
 
 namespace mavros {
 namespace extra_plugins {
@@ -24,16 +26,36 @@ namespace extra_plugins {
  * @brief GPS RTK plugin
  *
  * Publish the RTCM messages from ROS to the FCU
+ *
+ * Small RTCM3 frames packed to full GPS_RTCM_DATA messages (see RtcmPacker),
+ * optionally across ROS messages for ~gps_rtk/pack_timeout.
+ * When FCU Tx queue holds ~gps_rtk/saturation_depth buffers,
+ * repeated station description frames are skipped.
  */
 class GpsRtkPlugin : public plugin::PluginBase {
 public:
 	GpsRtkPlugin() : PluginBase(),
-		gps_rtk_nh("~gps_rtk")
+		gps_rtk_nh(private_nh("gps_rtk")),
+		packer(std::bind(&GpsRtkPlugin::send_packet, this, std::placeholders::_1, std::placeholders::_2)),
+		saturation_depth(20),
+		seq(0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(gps_rtk_nh);
+
+		double pack_timeout_s, redundant_period;
+		gps_rtk_nh.param("pack_timeout", pack_timeout_s, 0.0);
+		gps_rtk_nh.param("saturation_depth", saturation_depth, 20);
+		gps_rtk_nh.param("redundant_period", redundant_period, 5.0);
+		packer.set_redundant_period(redundant_period);
+		pack_timeout = ros::Duration(pack_timeout_s);
+
+		if (!pack_timeout.isZero())
+			make_timer(flush_timer, pack_timeout, &GpsRtkPlugin::flush_cb, true, false);
+
 		gps_rtk_sub = gps_rtk_nh.subscribe("send_rtcm", 10, &GpsRtkPlugin::rtcm_cb, this);
 	}
 
@@ -45,53 +67,101 @@ public:
 private:
 	ros::NodeHandle gps_rtk_nh;
 	ros::Subscriber gps_rtk_sub;
+	Timer flush_timer;
+
+	std::mutex mutex;
+	RtcmPacker packer;
+	ros::Duration pack_timeout;
+	int saturation_depth;
+	uint8_t seq;
+
+	//! Tx queue of FCU link is backed up
+	bool link_saturated()
+	{
+		auto txstat = UAS_FCU(m_uas)->get_tx_stat();
+		size_t depth = 0;
+		for (auto d : txstat.depth)
+			depth += d;
+
+		return saturation_depth > 0 && depth >= size_t(saturation_depth);
+	}
 
-	/* -*- callbacks -*- */
 	/**
-	 * @brief Handle mavros_msgs::RTCM message
-	 * It converts the message to the MAVLink GPS_RTCM_DATA message for GPS injection.
+	 * @brief Send packet as GPS_RTCM_DATA, fragmented if longer than one message
 	 * Message specification: https://mavlink.io/en/messages/common.html#GPS_RTCM_DATA
-	 * @param msg		Received ROS msg
 	 */
-	void rtcm_cb(const mavros_msgs::RTCM::ConstPtr &msg)
+	void send_packet(const uint8_t *data, size_t len)
 	{
 		mavlink::common::msg::GPS_RTCM_DATA rtcm_data;
 		const size_t max_frag_len = rtcm_data.data.size();
 
-		uint8_t seq_u5 = uint8_t(msg->header.seq & 0x1F) << 3;
+		static_assert(RtcmPacker::FRAG_LEN == sizeof(rtcm_data.data), "packer fragment size");
 
-		if (msg->data.size() > 4 * max_frag_len) {
-			ROS_FATAL("gps_rtk: RTCM message received is bigger than the maximal possible size.");
+		if (len > 4 * max_frag_len) {
+			ROS_ERROR_NAMED("gps_rtk", "gps_rtk: RTCM frame of %zu bytes is bigger than the maximal possible size.", len);
 			return;
 		}
 
-		auto data_it = msg->data.begin();
-		auto end_it = msg->data.end();
+		const uint8_t seq_u5 = uint8_t(seq++ & 0x1F) << 3;
 
-		if (msg->data.size() <= max_frag_len) {
-			rtcm_data.len = msg->data.size();
+		if (len <= max_frag_len) {
+			rtcm_data.len = len;
 			rtcm_data.flags = seq_u5;
-			std::copy(data_it, end_it, rtcm_data.data.begin());
-			std::fill(rtcm_data.data.begin() + rtcm_data.len, rtcm_data.data.end(), 0);
-			UAS_FCU(m_uas)->send_message(rtcm_data);
-		} else {
-			for (uint8_t fragment_id = 0; fragment_id < 4 && data_it < end_it; fragment_id++) {
-				uint8_t len = std::min((size_t) std::distance(data_it, end_it), max_frag_len);
-				rtcm_data.flags = 1;				// LSB set indicates message is fragmented
-				rtcm_data.flags |= fragment_id << 1;		// Next 2 bits are fragment id
-				rtcm_data.flags |= seq_u5;		// Next 5 bits are sequence id
-				rtcm_data.len = len;
-
-				std::copy(data_it, data_it + len, rtcm_data.data.begin());
-				std::fill(rtcm_data.data.begin() + len, rtcm_data.data.end(), 0);
-				UAS_FCU(m_uas)->send_message(rtcm_data);
-				std::advance(data_it, len);
-			}
+			std::copy(data, data + len, rtcm_data.data.begin());
+			std::fill(rtcm_data.data.begin() + len, rtcm_data.data.end(), 0);
+			UAS_FCU(m_uas)->send_message_ignore_drop(rtcm_data);
+			return;
+		}
+
+		const uint8_t *end = data + len;
+		for (uint8_t fragment_id = 0; fragment_id < 4 && data < end; fragment_id++) {
+			uint8_t frag_len = std::min(size_t(end - data), max_frag_len);
+			rtcm_data.flags = 1;				// LSB set indicates message is fragmented
+			rtcm_data.flags |= fragment_id << 1;		// Next 2 bits are fragment id
+			rtcm_data.flags |= seq_u5;		// Next 5 bits are sequence id
+			rtcm_data.len = frag_len;
+
+			std::copy(data, data + frag_len, rtcm_data.data.begin());
+			std::fill(rtcm_data.data.begin() + frag_len, rtcm_data.data.end(), 0);
+			UAS_FCU(m_uas)->send_message_ignore_drop(rtcm_data);
+			data += frag_len;
 		}
 	}
+
+	/* -*- callbacks -*- */
+	/**
+	 * @brief Handle mavros_msgs::RTCM message
+	 * It converts the message to the MAVLink GPS_RTCM_DATA message for GPS injection.
+	 * Message specification: https://mavlink.io/en/messages/common.html#GPS_RTCM_DATA
+	 * @param msg		Received ROS msg
+	 */
+	void rtcm_cb(const mavros_msgs::RTCM::ConstPtr &msg)
+	{
+		const bool saturated = link_saturated();
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const size_t skipped = packer.skipped();
+		packer.push(msg->data.data(), msg->data.size(), ros::Time::now().toSec(), saturated);
+		if (packer.skipped() != skipped)
+			ROS_DEBUG_THROTTLE_NAMED(5, "gps_rtk", "gps_rtk: link saturated, %zu redundant frames skipped", packer.skipped());
+
+		if (pack_timeout.isZero())
+			packer.flush();
+		else if (!packer.empty()) {
+			// start() does nothing on running timer, so timeout counts from oldest pending byte
+			flush_timer.start();
+		}
+	}
+
+	void flush_cb(const ros::TimerEvent &event)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// fired one-shot is stopped, next start() arms it again
+		packer.flush();
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::GpsRtkPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::GpsRtkPlugin)
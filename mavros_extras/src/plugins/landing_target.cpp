@@ -17,12 +17,13 @@
 #include <mavros/utils.h>
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
-#include <pluginlib/class_list_macros.h>
+#include <mavros/plugin_registry.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/Vector3Stamped.h>
 #include <mavros_msgs/LandingTarget.h>
+#include <mavros_msgs/LandingTargetDetection.h>
 
 namespace mavros {
 namespace extra_plugins {
@@ -34,12 +35,16 @@ using mavlink::common::LANDING_TARGET_TYPE;
  *
  * This plugin is intended to publish the location of a landing area captured from a downward facing camera
  * to the FCU and/or receive landing target tracking data coming from the FCU.
+ *
+ * ~landing_target/detection takes detector output (pixels or angles) directly:
+ * it is projected with precomputed camera intrinsics and vehicle attitude at image stamp
+ * (UAS state history), without TF lookups.
  */
 class LandingTargetPlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<LandingTargetPlugin> {
 public:
 	LandingTargetPlugin() :
-		nh("~landing_target"),
+		nh(private_nh("landing_target")),
 		tf_rate(10.0),
 		send_tf(true),
 		listen_tf(false),
@@ -55,9 +60,16 @@ public:
 		land_target_type("VISION_FIDUCIAL")
 	{ }
 
+	~LandingTargetPlugin()
+	{
+		// callback uses members, they go before mixin
+		tf2_stop();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
 
 		// general params
 		nh.param<std::string>("frame_id", frame_id, "landing_target_1");
@@ -81,6 +93,7 @@ public:
 		nh.param("camera/fov_y", fov_y, 2.0071286398);
 		// camera focal length
 		nh.param("camera/focal_length", focal_length, 2.8);	//ex: OpenMV Cam M7: 2.8 [mm]
+		setup_camera_model();
 
 		// tf subsection
 		nh.param("tf/send", send_tf, true);
@@ -103,6 +116,12 @@ public:
 		else {			// Subscribe to PoseStamped msg
 			pose_sub = nh.subscribe("pose", 10, &LandingTargetPlugin::pose_cb, this);
 		}
+
+		bool detection;
+		nh.param("detection/enable", detection, false);
+		if (detection)
+			detection_sub = nh.subscribe("detection", 10, &LandingTargetPlugin::detection_cb, this,
+					ros::TransportHints().tcpNoDelay());
 	}
 
 	Subscriptions get_subscriptions()
@@ -131,6 +150,7 @@ private:
 	ros::Publisher lt_marker_pub;
 	ros::Subscriber land_target_sub;
 	ros::Subscriber pose_sub;
+	ros::Subscriber detection_sub;
 
 	double target_size_x, target_size_y;
 	double fov_x, fov_y;
@@ -143,6 +163,46 @@ private:
 	LANDING_TARGET_TYPE type;
 	std::string land_target_type;
 
+	//! Pinhole model of detection input, inverse focal lengths [1/px]
+	struct CameraModel {
+		double inv_fx, inv_fy;
+		double cx, cy;
+		Eigen::Matrix3d body_optical;	//!< optical frame (x right, y down, z forward) -> aircraft FRD
+	} camera;
+
+	/**
+	 * @brief Precompute detection projection
+	 *
+	 * Intrinsics come from camera/fx, fy, cx, cy [pixels] (calibration),
+	 * zero ones are derived from FOV and image size.
+	 * Camera looks down, image top to vehicle front, rotated camera/yaw [rad] about body Z.
+	 */
+	void setup_camera_model()
+	{
+		double fx, fy, cx, cy, yaw;
+		nh.param("camera/fx", fx, 0.0);
+		nh.param("camera/fy", fy, 0.0);
+		nh.param("camera/cx", cx, 0.0);
+		nh.param("camera/cy", cy, 0.0);
+		nh.param("camera/yaw", yaw, 0.0);
+
+		if (fx <= 0.0)
+			fx = image_width / 2.0 / std::tan(fov_x / 2.0);
+		if (fy <= 0.0)
+			fy = image_height / 2.0 / std::tan(fov_y / 2.0);
+
+		camera.inv_fx = 1.0 / fx;
+		camera.inv_fy = 1.0 / fy;
+		camera.cx = (cx > 0.0) ? cx : image_width / 2.0;
+		camera.cy = (cy > 0.0) ? cy : image_height / 2.0;
+
+		Eigen::Matrix3d down;
+		down << 0.0, -1.0, 0.0,
+			1.0, 0.0, 0.0,
+			0.0, 0.0, 1.0;
+		camera.body_optical = Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix() * down;
+	}
+
 	/* -*- low-level send -*- */
 	void landing_target(uint64_t time_usec,
 				uint8_t target_num,
@@ -335,7 +395,7 @@ private:
 			transform.transform.rotation = pose->pose.orientation;
 			tf::vectorEigenToMsg(position, transform.transform.translation);
 
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf_aggregator.send(transform);
 		}
 
 		auto tg_size_msg = boost::make_shared<geometry_msgs::Vector3Stamped>();
@@ -367,6 +427,66 @@ private:
 		send_landing_target(req->header.stamp, tr);
 	}
 
+	/**
+	 * @brief callback for detector output, sent as LANDING_TARGET without TF
+	 *
+	 * Angles and size always sent. With known distance and attitude at image stamp
+	 * position is projected to LOCAL_NED (LOCAL_OFFSET_NED if local position is unknown).
+	 */
+	void detection_cb(const mavros_msgs::LandingTargetDetection::ConstPtr &req) {
+		// tangents of line of sight in optical frame
+		double tx, ty;
+		Eigen::Vector2f size_rad;
+		if (req->is_angle) {
+			tx = std::tan(req->x);
+			ty = std::tan(req->y);
+			size_rad = {req->size[0], req->size[1]};
+		}
+		else {
+			tx = (req->x - camera.cx) * camera.inv_fx;
+			ty = (req->y - camera.cy) * camera.inv_fy;
+			size_rad = {2.0 * std::atan(req->size[0] * camera.inv_fx / 2.0),
+				    2.0 * std::atan(req->size[1] * camera.inv_fy / 2.0)};
+		}
+
+		const Eigen::Vector2f angle(std::atan(tx), std::atan(ty));
+
+		Eigen::Vector3d pos = Eigen::Vector3d::Zero();
+		uint8_t lt_frame = utils::enum_value(frame);
+		uint8_t position_valid = 0;
+
+		geometry_msgs::Quaternion orientation;
+		geometry_msgs::Vector3 angular_velocity;
+		if (req->distance > 0.0 && m_uas->get_attitude_at(req->header.stamp, orientation, angular_velocity)) {
+			Eigen::Quaterniond q;
+			tf::quaternionMsgToEigen(orientation, q);
+			auto q_ned = ftf::transform_orientation_enu_ned(ftf::transform_orientation_baselink_aircraft(q));
+
+			pos = q_ned * (camera.body_optical * Eigen::Vector3d(tx, ty, 1.0).normalized() * req->distance);
+
+			Eigen::Vector3d local_enu;
+			if (m_uas->get_local_position_at(req->header.stamp, local_enu)) {
+				pos += ftf::transform_frame_enu_ned(local_enu);
+				lt_frame = utils::enum_value(MAV_FRAME::LOCAL_NED);
+			}
+			else
+				lt_frame = utils::enum_value(MAV_FRAME::LOCAL_OFFSET_NED);
+
+			position_valid = 1;
+		}
+
+		landing_target(req->header.stamp.toNSec() / 1000,
+					req->target_num,
+					lt_frame,
+					angle,
+					req->distance,
+					size_rad,
+					pos,
+					Eigen::Quaterniond::Identity(),
+					utils::enum_value(type),
+					position_valid);
+	}
+
 	/**
 	 * @brief callback for raw LandingTarget msgs topic - useful if one has the
 	 * data processed in another node
@@ -395,4 +515,4 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::LandingTargetPlugin, mavros::plugin::PluginBase)
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::LandingTargetPlugin)
@@ -1,5 +1,14 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
 #include <mavros/mavros_plugin.h>
 #include <mavros_msgs/LogData.h>
+#include <mavros_msgs/LogDownload.h>
+#include <mavros_msgs/LogDownloadProgress.h>
 #include <mavros_msgs/LogEntry.h>
 #include <mavros_msgs/LogRequestData.h>
 #include <mavros_msgs/LogRequestEnd.h>
@@ -10,14 +19,16 @@ namespace extra_plugins {
 class LogTransferPlugin : public plugin::PluginBase {
 public:
 	LogTransferPlugin() :
-		nh("~log_transfer") {}
+		nh(private_nh("log_transfer")) {}
 
 	void initialize(UAS& uas) override
 	{
 		PluginBase::initialize(uas);
+		setup_node_handle(nh);
 
 		log_entry_pub = nh.advertise<mavros_msgs::LogEntry>("raw/log_entry", 1000);
 		log_data_pub = nh.advertise<mavros_msgs::LogData>("raw/log_data", 1000);
+		download_progress_pub = nh.advertise<mavros_msgs::LogDownloadProgress>("download_progress", 10);
 
 		log_request_list_srv = nh.advertiseService("raw/log_request_list",
 					&LogTransferPlugin::log_request_list_cb, this);
@@ -25,6 +36,8 @@ public:
 					&LogTransferPlugin::log_request_data_cb, this);
 		log_request_end_srv = nh.advertiseService("raw/log_request_end",
 					&LogTransferPlugin::log_request_end_cb, this);
+		download_srv = nh.advertiseService("download",
+					&LogTransferPlugin::download_cb, this);
 	}
 
 	Subscriptions get_subscriptions() override
@@ -36,12 +49,49 @@ public:
 	}
 
 private:
+	using unique_lock = std::unique_lock<std::mutex>;
+	using steady_clock = std::chrono::steady_clock;
+
 	ros::NodeHandle nh;
-	ros::Publisher log_entry_pub, log_data_pub;
-	ros::ServiceServer log_request_list_srv, log_request_data_srv, log_request_end_srv;
+	ros::Publisher log_entry_pub, log_data_pub, download_progress_pub;
+	ros::ServiceServer log_request_list_srv, log_request_data_srv, log_request_end_srv, download_srv;
+
+	//! LOG_DATA payload size
+	static constexpr size_t CHUNK_SIZE = 90;
+	//! no data that long - re-request missing chunks
+	static constexpr int STALL_TIMEOUT_MS = 300;
+	//! no data that long - give up
+	static constexpr int DATA_TIMEOUT_MS = 10000;
+	static constexpr int LIST_TIMEOUT_MS = 1000;
+	static constexpr int PROGRESS_MS = 1000;
+
+	//! State of download service
+	struct Download {
+		bool active = false;
+		bool success = false;
+		uint16_t id = 0;
+		int fd = -1;
+		uint32_t size = 0;		//!< trimmed by short chunk at EOF
+		uint32_t received_bytes = 0;
+		std::vector<bool> received;	//!< per chunk
+		size_t missing = 0;		//!< chunks not yet received
+		size_t req_end = 0;		//!< chunk after end of current LOG_REQUEST_DATA
+		size_t progress = 0;		//!< LOG_DATA handled, for stall detection
+	};
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::unordered_map<uint16_t, uint32_t> log_sizes;	//!< from LOG_ENTRY
+	Download dl;
 
 	void handle_log_entry(const mavlink::mavlink_message_t*, mavlink::common::msg::LOG_ENTRY& le)
 	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			log_sizes[le.id] = le.size;
+			cond.notify_all();
+		}
+
 		auto msg = boost::make_shared<mavros_msgs::LogEntry>();
 		msg->header.stamp = ros::Time::now();
 		msg->id = le.id;
@@ -54,6 +104,14 @@ private:
 
 	void handle_log_data(const mavlink::mavlink_message_t*, mavlink::common::msg::LOG_DATA& ld)
 	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (dl.active && ld.id == dl.id) {
+				store_log_data(ld);
+				return;
+			}
+		}
+
 		auto msg = boost::make_shared<mavros_msgs::LogData>();
 		msg->header.stamp = ros::Time::now();
 		msg->id = ld.id;
@@ -115,9 +173,214 @@ private:
 		}
 		return true;
 	}
+
+	/* -*- download engine -*- */
+
+	//! Forget chunks past new end of log
+	void trim_download(uint32_t size)
+	{
+		const size_t chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		for (size_t i = chunks; i < dl.received.size(); i++) {
+			if (!dl.received[i])
+				dl.missing--;
+		}
+
+		dl.received.resize(chunks);
+		dl.size = size;
+	}
+
+	void store_log_data(mavlink::common::msg::LOG_DATA& ld)
+	{
+		dl.progress++;
+
+		const size_t count = std::min<size_t>(ld.count, ld.data.size());
+		if (ld.ofs % CHUNK_SIZE != 0) {
+			ROS_DEBUG_NAMED("log_transfer", "LOG: unaligned chunk ofs %u, dropping", ld.ofs);
+			return;
+		}
+
+		// short chunk is last one
+		if (count < CHUNK_SIZE && ld.ofs + count < dl.size)
+			trim_download(ld.ofs + count);
+
+		const size_t chunk = ld.ofs / CHUNK_SIZE;
+		if (chunk < dl.received.size() && !dl.received[chunk]) {
+			if (::pwrite(dl.fd, ld.data.data(), count, ld.ofs) != ssize_t(count)) {
+				ROS_ERROR_NAMED("log_transfer", "LOG: write failed: %s", strerror(errno));
+				finish_download(false);
+				return;
+			}
+
+			dl.received[chunk] = true;
+			dl.missing--;
+			dl.received_bytes += count;
+		}
+
+		if (dl.missing == 0)
+			finish_download(true);
+		else if (chunk + 1 >= dl.req_end)
+			request_missing();
+	}
+
+	//! Request first range of missing chunks
+	void request_missing()
+	{
+		auto first = std::find(dl.received.begin(), dl.received.end(), false);
+		auto last = std::find(first, dl.received.end(), true);
+
+		const size_t start = std::distance(dl.received.begin(), first);
+		dl.req_end = std::distance(dl.received.begin(), last);
+
+		const uint32_t ofs = start * CHUNK_SIZE;
+		const uint32_t count = std::min<size_t>(dl.req_end * CHUNK_SIZE, dl.size) - ofs;
+		ROS_DEBUG_NAMED("log_transfer", "LOG: request %u ofs %u count %u", dl.id, ofs, count);
+
+		mavlink::common::msg::LOG_REQUEST_DATA msg;
+		m_uas->msg_set_target(msg);
+		msg.id = dl.id;
+		msg.ofs = ofs;
+		msg.count = count;
+		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+	}
+
+	void finish_download(bool success)
+	{
+		mavlink::common::msg::LOG_REQUEST_END msg;
+		m_uas->msg_set_target(msg);
+		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+
+		dl.active = false;
+		dl.success = success;
+		cond.notify_all();
+	}
+
+	void publish_progress(float rate)
+	{
+		auto msg = boost::make_shared<mavros_msgs::LogDownloadProgress>();
+		msg->header.stamp = ros::Time::now();
+		msg->id = dl.id;
+		msg->size = dl.size;
+		msg->received = dl.received_bytes;
+		msg->rate = rate;
+		download_progress_pub.publish(msg);
+	}
+
+	//! Size of log from LOG_ENTRY, requested if not seen yet
+	bool get_log_size(unique_lock &lock, uint16_t id, uint32_t &size)
+	{
+		if (!log_sizes.count(id)) {
+			mavlink::common::msg::LOG_REQUEST_LIST msg;
+			m_uas->msg_set_target(msg);
+			msg.start = id;
+			msg.end = id;
+			UAS_FCU(m_uas)->send_message_ignore_drop(msg);
+
+			cond.wait_for(lock, std::chrono::milliseconds(LIST_TIMEOUT_MS),
+					[&] { return log_sizes.count(id) > 0; });
+		}
+
+		auto it = log_sizes.find(id);
+		if (it == log_sizes.end())
+			return false;
+
+		size = it->second;
+		return true;
+	}
+
+	//! Wait end of download, re-request data on stall
+	void wait_download(unique_lock &lock)
+	{
+		const auto start = steady_clock::now();
+		auto last_data = start;
+		auto last_report = start;
+		size_t last_progress = dl.progress;
+		uint32_t report_bytes = 0;
+
+		while (dl.active) {
+			cond.wait_for(lock, std::chrono::milliseconds(STALL_TIMEOUT_MS));
+			const auto now = steady_clock::now();
+
+			if (dl.progress != last_progress) {
+				last_progress = dl.progress;
+				last_data = now;
+			}
+			else if (now - last_data > std::chrono::milliseconds(DATA_TIMEOUT_MS)) {
+				ROS_ERROR_NAMED("log_transfer", "LOG: download %u timed out", dl.id);
+				finish_download(false);
+				break;
+			}
+			else if (dl.active) {
+				ROS_DEBUG_NAMED("log_transfer", "LOG: stalled, %zu chunks missing", dl.missing);
+				request_missing();
+			}
+
+			const std::chrono::duration<float> dt = now - last_report;
+			if (dt > std::chrono::milliseconds(PROGRESS_MS)) {
+				publish_progress((dl.received_bytes - report_bytes) / dt.count());
+				report_bytes = dl.received_bytes;
+				last_report = now;
+			}
+		}
+	}
+
+	bool download_cb(mavros_msgs::LogDownload::Request &req,
+				mavros_msgs::LogDownload::Response &res)
+	{
+		unique_lock lock(mutex);
+		if (dl.active) {
+			ROS_ERROR_NAMED("log_transfer", "LOG: download in progress");
+			return false;
+		}
+
+		res.success = false;
+		uint32_t size;
+		if (!get_log_size(lock, req.id, size)) {
+			ROS_ERROR_NAMED("log_transfer", "LOG: log %u not found", req.id);
+			return true;
+		}
+
+		int fd = ::open(req.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			ROS_ERROR_NAMED("log_transfer", "LOG: can't open %s: %s", req.path.c_str(), strerror(errno));
+			return true;
+		}
+
+		ROS_INFO_NAMED("log_transfer", "LOG: download %u (%u bytes) to %s", req.id, size, req.path.c_str());
+
+		dl = Download{};
+		dl.active = true;
+		dl.id = req.id;
+		dl.fd = fd;
+		dl.size = size;
+		dl.received.assign((size + CHUNK_SIZE - 1) / CHUNK_SIZE, false);
+		dl.missing = dl.received.size();
+
+		const auto start = steady_clock::now();
+		if (dl.missing == 0)
+			finish_download(true);
+		else {
+			request_missing();
+			wait_download(lock);
+		}
+
+		const std::chrono::duration<float> dt = steady_clock::now() - start;
+		publish_progress(dl.received_bytes / std::max(dt.count(), 1e-3f));
+
+		bool ok = dl.success;
+		ok = ::ftruncate(fd, dl.size) == 0 && ok;
+		ok = ::close(fd) == 0 && ok;
+		dl.fd = -1;
+
+		res.success = ok;
+		res.size = dl.received_bytes;
+		res.rate = dl.received_bytes / std::max(dt.count(), 1e-3f);
+		ROS_INFO_NAMED("log_transfer", "LOG: download %u %s, %u bytes, %.0f B/s", req.id,
+				ok ? "done" : "failed", res.size, res.rate);
+		return true;
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::LogTransferPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::LogTransferPlugin)
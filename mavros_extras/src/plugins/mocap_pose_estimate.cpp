@@ -16,6 +16,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/uplink_governor.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <geometry_msgs/PoseStamped.h>
@@ -33,12 +34,13 @@ class MocapPoseEstimatePlugin : public plugin::PluginBase
 {
 public:
 	MocapPoseEstimatePlugin() : PluginBase(),
-		mp_nh("~mocap")
+		mp_nh(private_nh("mocap"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(mp_nh);
 
 		bool use_tf;
 		bool use_pose;
@@ -49,6 +51,10 @@ public:
 		/** @note For Optitrack ROS package, subscribe to PoseStamped topic */
 		mp_nh.param("use_pose", use_pose, true);
 
+		double uplink_rate;
+		mp_nh.param("uplink/rate", uplink_rate, 0.0);
+		governor.set_rate(uplink_rate);
+
 		if (use_tf && !use_pose) {
 			mocap_tf_sub = mp_nh.subscribe("tf", 1, &MocapPoseEstimatePlugin::mocap_tf_cb, this);
 		}
@@ -71,6 +77,8 @@ private:
 	ros::Subscriber mocap_pose_sub;
 	ros::Subscriber mocap_tf_sub;
 
+	UplinkGovernor governor;	//!< uplink/rate limit
+
 	/* -*- low-level send -*- */
 	void mocap_pose_send
 		(uint64_t usec,
@@ -91,6 +99,9 @@ private:
 	/* -*- mid-level helpers -*- */
 	void mocap_pose_cb(const geometry_msgs::PoseStamped::ConstPtr &pose)
 	{
+		if (!governor.pass(pose->header.stamp.toNSec()))
+			return;
+
 		Eigen::Quaterniond q_enu;
 
 		tf::quaternionMsgToEigen(pose->pose.orientation, q_enu);
@@ -111,6 +122,9 @@ private:
 	/* -*- callbacks -*- */
 	void mocap_tf_cb(const geometry_msgs::TransformStamped::ConstPtr &trans)
 	{
+		if (!governor.pass(trans->header.stamp.toNSec()))
+			return;
+
 		Eigen::Quaterniond q_enu;
 
 		tf::quaternionMsgToEigen(trans->transform.rotation, q_enu);
@@ -131,5 +145,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::MocapPoseEstimatePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::MocapPoseEstimatePlugin)
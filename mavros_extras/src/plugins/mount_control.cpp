@@ -14,6 +14,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
 
 #include <mavros_msgs/CommandLong.h>
@@ -34,22 +35,46 @@ using utils::enum_value;
  *
  * Publishes Mission commands to control the camera or antenna mount.
  * @see command_cb()
+ *
+ * In stream mode (~mount_control/stream/enable) angles and points go as MOUNT_CONTROL
+ * messages, which are not acknowledged, at most at stream/rate with only newest
+ * command kept. DO_MOUNT_CONTROL command is sent only when mount mode changes.
  */
 class MountControlPlugin : public plugin::PluginBase {
 public:
 	MountControlPlugin() : PluginBase(),
-	nh("~"),
-	mount_nh("~mount_control")
+	nh(private_nh()),
+	mount_nh(private_nh("mount_control"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(nh);
+		setup_node_handle(mount_nh);
+
+		double stream_rate;
+		mount_nh.param("stream/enable", stream, false);
+		mount_nh.param("stream/rate", stream_rate, 50.0);
 
-		command_sub = mount_nh.subscribe("command", 10, &MountControlPlugin::command_cb, this);
+		command_sub = mount_nh.subscribe("command", 10, &MountControlPlugin::command_cb, this,
+				ros::TransportHints().tcpNoDelay());
 		mount_orientation_pub = mount_nh.advertise<geometry_msgs::Quaternion>("orientation", 10);
 		configure_srv = mount_nh.advertiseService("configure", &MountControlPlugin::mount_configure_cb, this);
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
+		if (stream && stream_rate > 0.0)
+			make_timer(stream_timer, ros::Duration(1.0 / stream_rate),
+					&MountControlPlugin::stream_cb);
+		else
+			stream = false;
+#else
+		if (stream)
+			ROS_WARN_NAMED("mount", "Mount: MOUNT_CONTROL needs ardupilotmega dialect, not built. Stream disabled.");
+		stream = false;
+#endif
+
+		enable_connection_cb();
 	}
 
 	Subscriptions get_subscriptions()
@@ -65,6 +90,20 @@ private:
 	ros::Subscriber command_sub;
 	ros::Publisher mount_orientation_pub;
  	ros::ServiceServer configure_srv;
+	Timer stream_timer;
+
+	std::mutex mutex;
+	bool stream;
+	bool pending_valid = false;
+	int sent_mode = -1;	//!< mode of last DO_MOUNT_CONTROL, -1 - none since connect
+	mavros_msgs::MountControl pending;	//!< newest command not streamed yet
+
+	void connection_cb(bool connected) override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sent_mode = -1;
+		pending_valid = false;
+	}
 
 	/**
 	 * @brief Publish the mount orientation
@@ -88,19 +127,71 @@ private:
 	 * @param req	received MountControl msg
 	 */
 	void command_cb(const mavros_msgs::MountControl::ConstPtr &req)
+	{
+		if (stream) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (req->mode == sent_mode) {
+				// latest wins, sent by stream_cb()
+				pending = *req;
+				pending_valid = true;
+				return;
+			}
+
+			// mode change carries its angles, older pending ones are stale
+			sent_mode = req->mode;
+			pending_valid = false;
+		}
+
+		send_command(*req);
+	}
+
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
+	//! Send newest pending command as MOUNT_CONTROL
+	void stream_cb(const ros::TimerEvent &event)
+	{
+		mavlink::ardupilotmega::msg::MOUNT_CONTROL mc {};
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!pending_valid)
+				return;
+
+			pending_valid = false;
+			const bool gps_point = pending.mode == mavros_msgs::MountControl::MAV_MOUNT_MODE_GPS_POINT;
+			if (gps_point) {
+				mc.input_a = pending.latitude;	// degrees * 1E7
+				mc.input_b = pending.longitude;
+				mc.input_c = pending.altitude * 1e2;	// cm
+			}
+			else {
+				mc.input_a = pending.pitch * 1e2;	// centidegrees
+				mc.input_b = pending.roll * 1e2;
+				mc.input_c = pending.yaw * 1e2;
+			}
+		}
+
+		mc.target_system = m_uas->get_tgt_system();
+		mc.target_component = m_uas->get_tgt_component();
+		mc.save_position = 0;
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(mc);
+	}
+#endif
+
+	void send_command(const mavros_msgs::MountControl &req)
 	{
 		mavlink::common::msg::COMMAND_LONG cmd {};
 
 		cmd.target_system = m_uas->get_tgt_system();
 		cmd.target_component = m_uas->get_tgt_component();
 		cmd.command = enum_value(MAV_CMD::DO_MOUNT_CONTROL);
-		cmd.param1 = req->pitch;
-		cmd.param2 = req->roll;
-		cmd.param3 = req->yaw;
-		cmd.param4 = req->altitude; // 
-		cmd.param5 = req->latitude; // lattitude in degrees * 1E7
-		cmd.param6 = req->longitude; // longitude in degrees * 1E7
-		cmd.param7 = req->mode; // MAV_MOUNT_MODE
+		cmd.param1 = req.pitch;
+		cmd.param2 = req.roll;
+		cmd.param3 = req.yaw;
+		cmd.param4 = req.altitude; // 
+		cmd.param5 = req.latitude; // lattitude in degrees * 1E7
+		cmd.param6 = req.longitude; // longitude in degrees * 1E7
+		cmd.param7 = req.mode; // MAV_MOUNT_MODE
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(cmd);
 	}
@@ -141,5 +232,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::MountControlPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::MountControlPlugin)
@@ -16,8 +16,12 @@
 
 #include <mavros/mavros_plugin.h>
 #include <mavros/utils.h>
+#include <mavros/obstacle_sectors.h>
 
+#include <eigen_conversions/eigen_msg.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
 
 namespace mavros {
 namespace extra_plugins {
@@ -31,23 +35,83 @@ using mavlink::common::MAV_DISTANCE_SENSOR;
  *
  * Publishes obstacle distance array to the FCU, in order to assist in an obstacle
  * avoidance flight.
+ *
+ * With ~obstacle/merge/topics set several scans (e.g. front and rear lidars)
+ * are merged to one 360 deg array of 5 deg sectors in MAV_FRAME_BODY_FRD,
+ * sent at ~obstacle/merge/rate.
+ *
+ * Depth camera clouds on ~obstacle/cloud are binned directly to these sectors
+ * within a height band, to move it off the main queue put plugin to own spinner queue.
  * @see obstacle_cb()
+ * @see merge_timer_cb()
+ * @see cloud_cb()
  */
 class ObstacleDistancePlugin : public plugin::PluginBase {
 public:
 	ObstacleDistancePlugin() : PluginBase(),
-		obstacle_nh("~obstacle")
+		obstacle_nh(private_nh("obstacle"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(obstacle_nh);
 
 		std::string mav_frame;
 		obstacle_nh.param<std::string>("mav_frame", mav_frame, "GLOBAL");
 		frame = utils::mav_frame_from_str(mav_frame);
 
 		obstacle_sub = obstacle_nh.subscribe("send", 10, &ObstacleDistancePlugin::obstacle_cb, this);
+
+		// point cloud input
+		double voxel_size;
+		obstacle_nh.param<std::string>("cloud/base_frame_id", cloud_base_frame_id, "base_link");
+		obstacle_nh.param("cloud/min_height", cloud_min_height, -0.3);
+		obstacle_nh.param("cloud/max_height", cloud_max_height, 1.0);
+		obstacle_nh.param("cloud/range_min", cloud_range_min, 0.2);
+		obstacle_nh.param("cloud/range_max", cloud_range_max, 10.0);
+		obstacle_nh.param("cloud/voxel_size", voxel_size, 0.1);
+		obstacle_nh.param("cloud/min_points", cloud_min_points, 3);
+
+		// without grid nearest point of sector used
+		if (voxel_size > 0.0 && cloud_min_points > 1)
+			cloud_grid.resize(voxel_size, cloud_range_max);
+		else
+			cloud_min_points = 1;
+
+		// only latest cloud matters
+		cloud_sub = obstacle_nh.subscribe("cloud", 1, &ObstacleDistancePlugin::cloud_cb, this,
+				ros::TransportHints().tcpNoDelay());
+
+		// merge mode
+		std::vector<std::string> merge_topics;
+		std::vector<double> merge_offsets;
+		double merge_rate;
+		obstacle_nh.getParam("merge/topics", merge_topics);
+		obstacle_nh.getParam("merge/angle_offsets", merge_offsets);
+		obstacle_nh.param("merge/rate", merge_rate, 10.0);
+		obstacle_nh.param("merge/timeout", merge_timeout, 0.5);
+
+		if (merge_topics.empty())
+			return;
+
+		if (merge_offsets.size() != merge_topics.size()) {
+			ROS_ERROR_NAMED("obstacle_distance", "OBSDIST: merge/angle_offsets should have one value per topic, merge disabled");
+			return;
+		}
+
+		merge_sources.resize(merge_topics.size());
+		for (size_t i = 0; i < merge_topics.size(); i++) {
+			auto &src = merge_sources[i];
+			src.offset_deg = merge_offsets[i];
+			src.sub = obstacle_nh.subscribe<sensor_msgs::LaserScan>(merge_topics[i], 10,
+					boost::bind(&ObstacleDistancePlugin::merge_scan_cb, this, _1, i));
+
+			ROS_INFO_NAMED("obstacle_distance", "OBSDIST: merge %s at %.1f deg", merge_topics[i].c_str(), src.offset_deg);
+		}
+
+		make_timer(merge_timer, ros::Duration(1.0 / merge_rate),
+				&ObstacleDistancePlugin::merge_timer_cb);
 	}
 
 	Subscriptions get_subscriptions()
@@ -58,9 +122,33 @@ public:
 private:
 	ros::NodeHandle obstacle_nh;
 	ros::Subscriber obstacle_sub;
+	ros::Subscriber cloud_sub;
+
+	std::string cloud_base_frame_id;
+	double cloud_min_height;	//!< [m] FLU, in base frame
+	double cloud_max_height;	//!< [m]
+	double cloud_range_min;		//!< [m] horizontal
+	double cloud_range_max;		//!< [m]
+	int cloud_min_points;
+	PolarVoxelGrid cloud_grid;	//!< cloud_cb() only
 
 	mavlink::common::MAV_FRAME frame;
 
+	//! Scan to be merged
+	struct MergeSource {
+		ros::Subscriber sub;
+		double offset_deg;		//!< sensor forward in FRD, clockwise [deg]
+		ObstacleSectors sectors;
+		ros::Time stamp;
+		float range_min;		//!< [m]
+		float range_max;		//!< [m]
+	};
+
+	std::mutex merge_mutex;
+	std::vector<MergeSource> merge_sources;
+	Timer merge_timer;
+	double merge_timeout;
+
 	/**
 	 * @brief Send obstacle distance array to the FCU.
 	 *
@@ -71,35 +159,25 @@ private:
 	{
 		mavlink::common::msg::OBSTACLE_DISTANCE obstacle {};
 
-		if (req->ranges.size() <= obstacle.distances.size()) {
+		const size_t n = req->ranges.size();
+		const float *ranges = req->ranges.data();
+
+		if (n <= obstacle.distances.size()) {
 			// all distances from sensor will fit in obstacle distance message
-			for (int i = 0; i < req->ranges.size(); i++) {
-				float distance_cm = req->ranges[i] * 1e2;
-				if (std::isnan(distance_cm) || distance_cm >= UINT16_MAX || distance_cm < 0) {
-					obstacle.distances[i] = UINT16_MAX;
-				} else {
-					obstacle.distances[i] = static_cast<uint16_t>(distance_cm);
-				}
-			}
-			std::fill(obstacle.distances.begin() + req->ranges.size(), obstacle.distances.end(), UINT16_MAX);	//!< fill the rest of the array values as "Unknown"
+			for (size_t i = 0; i < n; i++)
+				obstacle.distances[i] = ObstacleSectors::min_pool_cm(ranges + i, 1, req->range_min, req->range_max);
+			std::fill(obstacle.distances.begin() + n, obstacle.distances.end(), UINT16_MAX);	//!< fill the rest of the array values as "Unknown"
 
 			const float increment_deg = req->angle_increment * RAD_TO_DEG;
 			obstacle.increment = static_cast<uint8_t>(increment_deg + 0.5f);  //!< Round to nearest integer.
 			obstacle.increment_f = increment_deg;
 		} else {
 			// all distances from sensor will not fit so we combine adjacent distances always taking the shortest distance
-			size_t scale_factor = ceil(double(req->ranges.size()) / obstacle.distances.size());
+			size_t scale_factor = ceil(double(n) / obstacle.distances.size());
 			for (size_t i = 0; i < obstacle.distances.size(); i++) {
-				obstacle.distances[i] = UINT16_MAX;
-				for (size_t j = 0; j < scale_factor; j++) {
-					size_t req_index = i * scale_factor + j;
-					if (req_index < req->ranges.size()) {
-						float distance_cm = req->ranges[req_index] * 1e2;
-						if (!std::isnan(distance_cm) && distance_cm < UINT16_MAX && distance_cm > 0) {
-							obstacle.distances[i] = std::min(obstacle.distances[i], static_cast<uint16_t>(distance_cm));
-						}
-					}
-				}
+				const size_t first = std::min(i * scale_factor, n);
+				const size_t count = std::min(scale_factor, n - first);
+				obstacle.distances[i] = ObstacleSectors::min_pool_cm(ranges + first, count, req->range_min, req->range_max);
 			}
 			obstacle.increment = ceil(req->angle_increment * RAD_TO_DEG * scale_factor);	//!< [degrees]
 		}
@@ -115,9 +193,145 @@ private:
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
 	}
+
+	//! Reduce scan of merge source @a idx to its sectors
+	void merge_scan_cb(const sensor_msgs::LaserScan::ConstPtr &req, size_t idx)
+	{
+		// ROS scan is CCW in sensor frame, sectors are CW from vehicle forward
+		ObstacleSectors sectors;
+		sectors.add_scan(req->ranges.data(), req->ranges.size(),
+				merge_sources[idx].offset_deg - req->angle_min * RAD_TO_DEG,
+				-req->angle_increment * RAD_TO_DEG,
+				req->range_min, req->range_max);
+
+		std::lock_guard<std::mutex> lock(merge_mutex);
+		auto &src = merge_sources[idx];
+		src.sectors = sectors;
+		src.stamp = req->header.stamp;
+		src.range_min = req->range_min;
+		src.range_max = req->range_max;
+	}
+
+	/**
+	 * @brief Send merged obstacle distance array to the FCU.
+	 *
+	 * Sources without scan during merge/timeout left out, their sectors become unknown.
+	 */
+	void merge_timer_cb(const ros::TimerEvent &event)
+	{
+		mavlink::common::msg::OBSTACLE_DISTANCE obstacle {};
+		ObstacleSectors merged;
+		ros::Time stamp;
+		float range_min = std::numeric_limits<float>::infinity();
+		float range_max = 0.0f;
+		size_t fresh = 0;
+
+		static_assert(ObstacleSectors::SECTORS == sizeof(obstacle.distances) / sizeof(obstacle.distances[0]),
+				"sectors should fill OBSTACLE_DISTANCE");
+
+		{
+			std::lock_guard<std::mutex> lock(merge_mutex);
+			const ros::Time now = ros::Time::now();
+			for (auto &src : merge_sources) {
+				if (src.stamp.isZero() || (now - src.stamp).toSec() > merge_timeout)
+					continue;
+
+				merged.merge(src.sectors);
+				stamp = std::max(stamp, src.stamp);
+				range_min = std::min(range_min, src.range_min);
+				range_max = std::max(range_max, src.range_max);
+				fresh++;
+			}
+		}
+
+		if (fresh == 0) {
+			ROS_WARN_THROTTLE_NAMED(10, "obstacle_distance", "OBSDIST: no fresh scans to merge");
+			return;
+		}
+
+		std::copy(merged.get().begin(), merged.get().end(), obstacle.distances.begin());
+		obstacle.time_usec = stamp.toNSec() / 1000;						//!< [microsecs]
+		obstacle.sensor_type = utils::enum_value(MAV_DISTANCE_SENSOR::LASER);
+		obstacle.increment = static_cast<uint8_t>(ObstacleSectors::increment_deg());	//!< [degrees]
+		obstacle.increment_f = ObstacleSectors::increment_deg();
+		obstacle.angle_offset = 0.0f;
+		obstacle.min_distance = range_min * 1e2;						//!< [centimeters]
+		obstacle.max_distance = range_max * 1e2;						//!< [centimeters]
+		obstacle.frame = utils::enum_value(mavlink::common::MAV_FRAME::BODY_FRD);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
+	}
+
+	/**
+	 * @brief Bin point cloud to obstacle sectors and send it to the FCU.
+	 *
+	 * Points iterated in message buffer, transformed to base frame,
+	 * these outside of height band or range skipped.
+	 */
+	void cloud_cb(const sensor_msgs::PointCloud2::ConstPtr &cloud)
+	{
+		Eigen::Affine3d tr;
+		try {
+			// sensor mount is static
+			auto transform = m_uas->tf2_buffer.lookupTransform(
+					cloud_base_frame_id, cloud->header.frame_id, ros::Time(0));
+			tf::transformMsgToEigen(transform.transform, tr);
+		}
+		catch (tf2::TransformException &ex) {
+			ROS_ERROR_THROTTLE_NAMED(10, "obstacle_distance", "OBSDIST: cloud: %s", ex.what());
+			return;
+		}
+
+		const Eigen::Affine3f tr_f = tr.cast<float>();
+		const float min_h = cloud_min_height, max_h = cloud_max_height;
+		const float min_r_sq = cloud_range_min * cloud_range_min;
+		const float max_r_sq = cloud_range_max * cloud_range_max;
+		const bool use_grid = cloud_min_points > 1;
+
+		ObstacleSectors sectors;
+		cloud_grid.clear();
+
+		sensor_msgs::PointCloud2ConstIterator<float> it_x(*cloud, "x");
+		sensor_msgs::PointCloud2ConstIterator<float> it_y(*cloud, "y");
+		sensor_msgs::PointCloud2ConstIterator<float> it_z(*cloud, "z");
+		for (; it_x != it_x.end(); ++it_x, ++it_y, ++it_z) {
+			// NaN fails all comparisons below
+			const Eigen::Vector3f p = tr_f * Eigen::Vector3f(*it_x, *it_y, *it_z);
+			if (!(p.z() >= min_h && p.z() <= max_h))
+				continue;
+
+			const float r_sq = p.x() * p.x() + p.y() * p.y();
+			if (!(r_sq >= min_r_sq && r_sq <= max_r_sq))
+				continue;
+
+			// FLU to FRD yaw, clockwise
+			const double angle = -std::atan2(p.y(), p.x()) * RAD_TO_DEG;
+			const float range = std::sqrt(r_sq);
+			if (use_grid)
+				cloud_grid.add_point(angle, range);
+			else
+				sectors.add_point(angle, range);
+		}
+
+		if (use_grid)
+			cloud_grid.reduce(sectors, cloud_min_points);
+
+		mavlink::common::msg::OBSTACLE_DISTANCE obstacle {};
+		std::copy(sectors.get().begin(), sectors.get().end(), obstacle.distances.begin());
+		obstacle.time_usec = cloud->header.stamp.toNSec() / 1000;		//!< [microsecs]
+		obstacle.sensor_type = utils::enum_value(MAV_DISTANCE_SENSOR::LASER);	//!< depth sensor
+		obstacle.increment = static_cast<uint8_t>(ObstacleSectors::increment_deg());	//!< [degrees]
+		obstacle.increment_f = ObstacleSectors::increment_deg();
+		obstacle.angle_offset = 0.0f;
+		obstacle.min_distance = cloud_range_min * 1e2;					//!< [centimeters]
+		obstacle.max_distance = cloud_range_max * 1e2;					//!< [centimeters]
+		obstacle.frame = utils::enum_value(mavlink::common::MAV_FRAME::BODY_FRD);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(obstacle);
+	}
 };
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::ObstacleDistancePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::ObstacleDistancePlugin)
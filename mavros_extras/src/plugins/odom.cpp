@@ -17,6 +17,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/uplink_governor.h>
 #include <tf2_eigen/tf2_eigen.h>
 #include <boost/algorithm/string.hpp>
 
@@ -26,7 +27,6 @@
 namespace mavros {
 namespace extra_plugins {
 using mavlink::common::MAV_FRAME;
-using Matrix6d = Eigen::Matrix<double, 6, 6, Eigen::RowMajor>;
 
 /**
  * @brief Odometry plugin
@@ -45,19 +45,30 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW		// XXX(vooon): added to try to fix #1223. Not sure that it is needed because class do not have Eigen:: fields.
 
 	OdometryPlugin() : PluginBase(),
-		odom_nh("~odometry"),
+		odom_nh(private_nh("odometry")),
 		fcu_odom_parent_id_des("map"),
-		fcu_odom_child_id_des("base_link")
+		fcu_odom_child_id_des("base_link"),
+		last_parent_rot(Eigen::Matrix3d::Zero()),
+		last_child_rot(Eigen::Matrix3d::Zero())
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(odom_nh);
 
 		// frame params:
 		odom_nh.param<std::string>("fcu/odom_parent_id_des", fcu_odom_parent_id_des, "map");
 		odom_nh.param<std::string>("fcu/odom_child_id_des", fcu_odom_child_id_des, "base_link");
 
+		// uplink params
+		double uplink_rate, cov_tolerance;
+		odom_nh.param("uplink/rate", uplink_rate, 0.0);
+		odom_nh.param("uplink/cov_tolerance", cov_tolerance, 0.0);
+		governor.set_rate(uplink_rate);
+		pose_cov_cache.set_tolerance(cov_tolerance);
+		vel_cov_cache.set_tolerance(cov_tolerance);
+
 		// publishers
 		odom_pub = odom_nh.advertise<nav_msgs::Odometry>("in", 10);
 
@@ -80,6 +91,12 @@ private:
 	std::string fcu_odom_parent_id_des;			//!< desired orientation of the fcu odometry message's parent frame
 	std::string fcu_odom_child_id_des;			//!< desired orientation of the fcu odometry message's child frame
 
+	UplinkGovernor governor;				//!< uplink/rate limit
+	CovarianceCache<6, 21> pose_cov_cache;			//!< input -> rotated URT
+	CovarianceCache<6, 21> vel_cov_cache;
+	Eigen::Matrix3d last_parent_rot;			//!< rotations caches are valid for
+	Eigen::Matrix3d last_child_rot;
+
 	/**
 	 * @brief Lookup static transform with error handling
 	 * @param[in] &target The parent frame of the transformation you want to get
@@ -124,23 +141,20 @@ private:
 		lookup_static_transform(fcu_odom_parent_id_des, "map_ned", tf_parent2parent_des);
 		lookup_static_transform( fcu_odom_child_id_des, "base_link_frd", tf_child2child_des);
 
-		//! Build 6x6 pose covariance matrix to be transformed and sent
-		Matrix6d cov_pose = Matrix6d::Zero();
-		ftf::mavlink_urt_to_covariance_matrix(odom_msg.pose_covariance, cov_pose);
-
-		//! Build 6x6 velocity covariance matrix to be transformed and sent
-		Matrix6d cov_vel = Matrix6d::Zero();
-		ftf::mavlink_urt_to_covariance_matrix(odom_msg.velocity_covariance, cov_vel);
-
 		Eigen::Vector3d position {};		//!< Position vector. WRT frame_id
 		Eigen::Quaterniond orientation {};	//!< Attitude quaternion. WRT frame_id
 		Eigen::Vector3d lin_vel {};		//!< Linear velocity vector. WRT child_frame_id
 		Eigen::Vector3d ang_vel {};		//!< Angular velocity vector. WRT child_frame_id
-		Matrix6d r_pose = Matrix6d::Zero();	//!< Zero initialized pose 6-D Covariance matrix. WRT frame_id
-		Matrix6d r_vel = Matrix6d::Zero();	//!< Zero initialized velocity 6-D Covariance matrix. WRT child_frame_id
 
 		auto odom = boost::make_shared<nav_msgs::Odometry>();
 
+		//! Build 6x6 pose and velocity covariance matrices right in the message, to be transformed in place
+		ftf::EigenMapCovariance6d cov_pose(odom->pose.covariance.data());
+		ftf::mavlink_urt_to_covariance_matrix(odom_msg.pose_covariance, cov_pose);
+
+		ftf::EigenMapCovariance6d cov_vel(odom->twist.covariance.data());
+		ftf::mavlink_urt_to_covariance_matrix(odom_msg.velocity_covariance, cov_vel);
+
 		odom->header = m_uas->synchronized_header(fcu_odom_parent_id_des, odom_msg.time_usec);
 		odom->child_frame_id = fcu_odom_child_id_des;
 
@@ -170,15 +184,11 @@ private:
 		/**
 		 * Covariances parsing
 		 */
-		//! Transform pose covariance matrix
-		r_vel.block<3, 3>(0, 0) = r_vel.block<3, 3>(3, 3) = tf_child2child_des.linear();
-		cov_pose = r_pose * cov_pose * r_pose.transpose();
-		Eigen::Map<Matrix6d>(odom->pose.covariance.data(), cov_pose.rows(), cov_pose.cols()) = cov_pose;
+		//! Transform pose covariance matrix, WRT frame_id
+		ftf::rotate_covariance(odom->pose.covariance, tf_parent2parent_des.linear());
 
-		//! Transform twist covariance matrix
-		r_pose.block<3, 3>(0, 0) = r_pose.block<3, 3>(3, 3) = tf_parent2parent_des.linear();
-		cov_vel = r_vel * cov_vel * r_vel.transpose();
-		Eigen::Map<Matrix6d>(odom->twist.covariance.data(), cov_vel.rows(), cov_vel.cols()) = cov_vel;
+		//! Transform twist covariance matrix, WRT child_frame_id
+		ftf::rotate_covariance(odom->twist.covariance, tf_child2child_des.linear());
 
 		//! Publish the data
 		odom_pub.publish(odom);
@@ -196,6 +206,9 @@ private:
 	 */
 	void odom_cb(const nav_msgs::Odometry::ConstPtr &odom)
 	{
+		if (!governor.pass(odom->header.stamp.toNSec()))
+			return;
+
 		/**
 		 * Required affine rotations to apply transforms
 		 */
@@ -205,13 +218,14 @@ private:
 		lookup_static_transform("odom_ned", odom->header.frame_id, tf_parent2parent_des);
 		lookup_static_transform("base_link_frd", odom->child_frame_id, tf_child2child_des);
 
-		//! Build 6x6 pose covariance matrix to be transformed and sent
-		ftf::Covariance6d cov_pose = odom->pose.covariance;
-		ftf::EigenMapCovariance6d cov_pose_map(cov_pose.data());
-
-		//! Build 6x6 velocity covariance matrix to be transformed and sent
-		ftf::Covariance6d cov_vel = odom->twist.covariance;
-		ftf::EigenMapCovariance6d cov_vel_map(cov_vel.data());
+		//! Cached covariances were rotated by previous transforms
+		if (!tf_parent2parent_des.linear().isApprox(last_parent_rot) ||
+				!tf_child2child_des.linear().isApprox(last_child_rot)) {
+			last_parent_rot = tf_parent2parent_des.linear();
+			last_child_rot = tf_child2child_des.linear();
+			pose_cov_cache.invalidate();
+			vel_cov_cache.invalidate();
+		}
 
 		/** Apply transforms:
 		 * According to nav_msgs/Odometry.
@@ -220,8 +234,6 @@ private:
 		Eigen::Quaterniond orientation {};	//!< Attitude quaternion. WRT frame_id
 		Eigen::Vector3d lin_vel {};		//!< Linear velocity vector. WRT child_frame_id
 		Eigen::Vector3d ang_vel {};		//!< Angular velocity vector. WRT child_frame_id
-		Matrix6d r_pose = Matrix6d::Zero();	//!< Zero initialized pose 6-D Covariance matrix. WRT frame_id
-		Matrix6d r_vel = Matrix6d::Zero();	//!< Zero initialized velocity 6-D Covariance matrix. WRT child_frame_id
 
 		mavlink::common::msg::ODOMETRY msg {};
 		msg.frame_id = utils::enum_value(MAV_FRAME::LOCAL_FRD);
@@ -245,14 +257,16 @@ private:
 		lin_vel = Eigen::Vector3d(tf_child2child_des.linear() * ftf::to_eigen(odom->twist.twist.linear));
 		ang_vel = Eigen::Vector3d(tf_child2child_des.linear() * ftf::to_eigen(odom->twist.twist.angular));
 
-		/** Apply covariance transforms */
-		r_pose.block<3, 3>(0, 0) = r_pose.block<3, 3>(3, 3) = tf_parent2parent_des.linear();
-		r_vel.block<3, 3>(0, 0) = r_vel.block<3, 3>(3, 3) = tf_child2child_des.linear();
-		cov_pose_map = r_pose * cov_pose_map * r_pose.transpose();
-		cov_vel_map  = r_vel  * cov_vel_map  * r_vel.transpose();
+		/** Apply covariance transforms, only when covariance or transforms changed */
+		auto convert_cov = [](const ftf::Covariance6d &cov_in, const Eigen::Matrix3d &rot, const char *name,
+				std::array<float, 21> &urt) {
+			ftf::Covariance6d cov = cov_in;
+			ftf::EigenMapConstCovariance6d cov_map(cov.data());
 
-		ROS_DEBUG_STREAM_NAMED("odom", "ODOM: output: pose covariance matrix:" << std::endl << cov_pose_map);
-		ROS_DEBUG_STREAM_NAMED("odom", "ODOM: output: velocity covariance matrix:" << std::endl << cov_vel_map);
+			ftf::rotate_covariance(cov, rot);
+			ROS_DEBUG_STREAM_NAMED("odom", "ODOM: output: " << name << " covariance matrix:" << std::endl << cov_map);
+			ftf::covariance_urt_to_mavlink(cov_map, urt);
+		};
 
 		/* -*- ODOMETRY msg parser -*- */
 		msg.time_usec = odom->header.stamp.toNSec() / 1e3;
@@ -276,8 +290,14 @@ private:
 		// [[[end]]] (checksum: ead24a1a6a14496c9de6c1951ccfbbd7)
 
 		ftf::quaternion_to_mavlink(orientation, msg.q);
-		ftf::covariance_urt_to_mavlink(cov_pose_map, msg.pose_covariance);
-		ftf::covariance_urt_to_mavlink(cov_vel_map, msg.velocity_covariance);
+		msg.pose_covariance = pose_cov_cache.get(odom->pose.covariance,
+				[&](const ftf::Covariance6d &cov, std::array<float, 21> &urt) {
+					convert_cov(cov, last_parent_rot, "pose", urt);
+				});
+		msg.velocity_covariance = vel_cov_cache.get(odom->twist.covariance,
+				[&](const ftf::Covariance6d &cov, std::array<float, 21> &urt) {
+					convert_cov(cov, last_child_rot, "velocity", urt);
+				});
 
 		// send ODOMETRY msg
 		UAS_FCU(m_uas)->send_message_ignore_drop(msg);
@@ -286,5 +306,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::OdometryPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::OdometryPlugin)
@@ -15,6 +15,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/procfs_stat.h>
 
 #include <mavros_msgs/OnboardComputerStatus.h>
 
@@ -25,18 +26,40 @@ namespace extra_plugins {
  *
  * Publishes the status of the onboard computer
  * @see status_cb()
+ *
+ * With collect/enable plugin fills ONBOARD_COMPUTER_STATUS itself at collect/rate
+ * from /proc and thermal zones (files kept open, re-read by pread()).
+ * cpu_combined holds usage of last 10 collect periods.
  */
 class OnboardComputerStatusPlugin : public plugin::PluginBase {
 public:
 	OnboardComputerStatusPlugin() : PluginBase(),
-		status_nh("~onboard_computer")
+		status_nh(private_nh("onboard_computer"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(status_nh);
 
 		status_sub = status_nh.subscribe("status", 10, &OnboardComputerStatusPlugin::status_cb, this);
+
+		bool collect;
+		double collect_rate;
+		std::string storage_path;
+		status_nh.param("collect/enable", collect, false);
+		status_nh.param("collect/rate", collect_rate, 1.0);
+		status_nh.param("collect/component", collect_component, 191);	// MAV_COMP_ID_ONBOARD_COMPUTER
+		status_nh.param("collect/type", collect_type, 0);
+		status_nh.param<std::string>("collect/storage_path", storage_path, "/");
+
+		if (collect && collect_rate > 0.0) {
+			collector.open(storage_path);
+			ROS_INFO_NAMED("onboard_computer", "OCS: collecting status at %.1f Hz, %zu thermal zones",
+					collect_rate, collector.thermal_zones());
+			make_timer(collect_timer, ros::Duration(1.0 / collect_rate),
+					&OnboardComputerStatusPlugin::collect_cb);
+		}
 	}
 
 	Subscriptions get_subscriptions()
@@ -47,6 +70,45 @@ public:
 private:
 	ros::NodeHandle status_nh;
 	ros::Subscriber status_sub;
+	Timer collect_timer;
+
+	procfs::StatusCollector collector;
+	int collect_component;
+	int collect_type;
+
+	//! Sample procfs and send status, no ROS topic in between
+	void collect_cb(const ros::TimerEvent &event)
+	{
+		using SC = procfs::StatusCollector;
+		SC::Status st;
+		collector.sample(event.current_real.toSec(), st);
+
+		mavlink::common::msg::ONBOARD_COMPUTER_STATUS status {};
+		status.time_usec = event.current_real.toNSec() / 1000;
+		status.uptime = st.uptime_ms;
+		status.type = collect_type;
+		std::copy(st.cpu_cores.cbegin(), st.cpu_cores.cend(), status.cpu_cores.begin());
+		std::copy(st.cpu_combined.cbegin(), st.cpu_combined.cend(), status.cpu_combined.begin());
+		status.gpu_cores.fill(UINT8_MAX);
+		status.gpu_combined.fill(UINT8_MAX);
+		status.temperature_board = st.temperature_board;
+		std::copy(st.temperature_core.cbegin(), st.temperature_core.cend(), status.temperature_core.begin());
+		status.fan_speed.fill(INT16_MAX);
+		status.ram_usage = st.ram_usage;
+		status.ram_total = st.ram_total;
+		status.storage_type.fill(UINT32_MAX);
+		status.storage_usage.fill(UINT32_MAX);
+		status.storage_total.fill(UINT32_MAX);
+		status.storage_usage[0] = st.storage_usage;
+		status.storage_total[0] = st.storage_total;
+		status.link_type.fill(UINT32_MAX);
+		std::copy(st.link_tx_rate.cbegin(), st.link_tx_rate.cend(), status.link_tx_rate.begin());
+		std::copy(st.link_rx_rate.cbegin(), st.link_rx_rate.cend(), status.link_rx_rate.begin());
+		status.link_tx_max.fill(UINT32_MAX);
+		status.link_rx_max.fill(UINT32_MAX);
+
+		UAS_FCU(m_uas)->send_message_ignore_drop(status, collect_component);
+	}
 
 	/**
 	 * @brief Send onboard computer status to FCU and groundstation
@@ -111,5 +173,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::OnboardComputerStatusPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::OnboardComputerStatusPlugin)
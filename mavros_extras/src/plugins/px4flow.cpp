@@ -17,10 +17,12 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/uplink_governor.h>
 
 #include <mavros_msgs/OpticalFlowRad.h>
 #include <sensor_msgs/Temperature.h>
 #include <sensor_msgs/Range.h>
+#include <geometry_msgs/TwistStamped.h>
 
 namespace mavros {
 namespace extra_plugins{
@@ -28,11 +30,16 @@ namespace extra_plugins{
  * @brief PX4 Optical Flow plugin
  *
  * This plugin can publish data from PX4Flow camera to ROS
+ *
+ * Messages are plugin members reused for every frame. With ~px4flow/combined
+ * only raw/optical_flow_rad (it carries distance and temperature) is published.
+ * With velocity/enable gyro-compensated flow is scaled by tilt-compensated
+ * distance to velocity, ~px4flow/velocity [baselink].
  */
 class PX4FlowPlugin : public plugin::PluginBase {
 public:
 	PX4FlowPlugin() : PluginBase(),
-		flow_nh("~px4flow"),
+		flow_nh(private_nh("px4flow")),
 		ranger_fov(0.0),
 		ranger_min_range(0.3),
 		ranger_max_range(5.0)
@@ -41,6 +48,7 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(flow_nh);
 
 		flow_nh.param<std::string>("frame_id", frame_id, "px4flow");
 
@@ -55,9 +63,25 @@ public:
 		flow_nh.param("ranger_min_range", ranger_min_range, 0.3);
 		flow_nh.param("ranger_max_range", ranger_max_range, 5.0);
 
+		double temperature_rate;
+		flow_nh.param("combined", combined, false);
+		flow_nh.param("temperature_rate", temperature_rate, 1.0);
+		flow_nh.param("velocity/enable", publish_velocity, false);
+		flow_nh.param("velocity/min_quality", min_quality, 1);
+		temp_governor.set_rate(temperature_rate);
+
 		flow_rad_pub = flow_nh.advertise<mavros_msgs::OpticalFlowRad>("raw/optical_flow_rad", 10);
-		range_pub = flow_nh.advertise<sensor_msgs::Range>("ground_distance", 10);
-		temp_pub = flow_nh.advertise<sensor_msgs::Temperature>("temperature", 10);
+		if (!combined) {
+			range_pub = flow_nh.advertise<sensor_msgs::Range>("ground_distance", 10);
+			temp_pub = flow_nh.advertise<sensor_msgs::Temperature>("temperature", 10);
+		}
+		if (publish_velocity)
+			velocity_pub = flow_nh.advertise<geometry_msgs::TwistStamped>("velocity", 10);
+
+		range_msg.radiation_type = sensor_msgs::Range::ULTRASOUND;
+		range_msg.field_of_view = ranger_fov;
+		range_msg.min_range = ranger_min_range;
+		range_msg.max_range = ranger_max_range;
 
 		flow_rad_sub = flow_nh.subscribe("raw/send", 1, &PX4FlowPlugin::send_cb, this);
 	}
@@ -81,8 +105,58 @@ private:
 	ros::Publisher flow_rad_pub;
 	ros::Publisher range_pub;
 	ros::Publisher temp_pub;
+	ros::Publisher velocity_pub;
 	ros::Subscriber flow_rad_sub;
 
+	bool combined;
+	bool publish_velocity;
+	int min_quality;
+	UplinkGovernor temp_governor;	//!< temperature decimation, it changes slowly
+
+	// reused messages, published by reference
+	mavros_msgs::OpticalFlowRad flow_rad_msg;
+	sensor_msgs::Temperature temp_msg;
+	sensor_msgs::Range range_msg;
+	geometry_msgs::TwistStamped velocity_msg;
+
+	/**
+	 * @brief Velocity over ground from integrated flow
+	 *
+	 * Gyro part subtracted from flow, remaining angle over integration time
+	 * times height gives velocity. Sonar distance is along sensor Z, so it is
+	 * scaled by body tilt at middle of integration interval (UAS attitude history).
+	 */
+	void publish_flow_velocity(const std_msgs::Header &header, const mavlink::common::msg::OPTICAL_FLOW_RAD &flow_rad)
+	{
+		if (flow_rad.integration_time_us == 0 || flow_rad.quality < min_quality ||
+				flow_rad.distance < ranger_min_range || flow_rad.distance > ranger_max_range)
+			return;
+
+		const double dt = flow_rad.integration_time_us / 1e6;
+		double height = flow_rad.distance;
+
+		geometry_msgs::Quaternion orientation;
+		geometry_msgs::Vector3 angular_velocity;
+		if (m_uas->get_attitude_at(header.stamp - ros::Duration(dt / 2.0), orientation, angular_velocity)) {
+			Eigen::Quaterniond q;
+			tf::quaternionMsgToEigen(orientation, q);
+			// cosine of tilt: body Z component on world Z
+			height *= std::max(0.0, q.toRotationMatrix()(2, 2));
+		}
+
+		// RH rotation about X and linear motion along -Y both give positive flow_x (aircraft frame)
+		const double scale = height / dt;
+		auto velocity = ftf::transform_frame_aircraft_baselink(
+				Eigen::Vector3d(
+					(flow_rad.integrated_y - flow_rad.integrated_ygyro) * scale,
+					-(flow_rad.integrated_x - flow_rad.integrated_xgyro) * scale,
+					0.0));
+
+		velocity_msg.header = header;
+		tf::vectorEigenToMsg(velocity, velocity_msg.twist.linear);
+		velocity_pub.publish(velocity_msg);
+	}
+
 	void handle_optical_flow_rad(const mavlink::mavlink_message_t *msg, mavlink::common::msg::OPTICAL_FLOW_RAD &flow_rad)
 	{
 		auto header = m_uas->synchronized_header(frame_id, flow_rad.time_usec);
@@ -104,32 +178,36 @@ private:
 					flow_rad.integrated_ygyro,
 					flow_rad.integrated_zgyro));
 
-		auto flow_rad_msg = boost::make_shared<mavros_msgs::OpticalFlowRad>();
+		flow_rad_msg.header = header;
+		flow_rad_msg.integration_time_us = flow_rad.integration_time_us;
 
-		flow_rad_msg->header = header;
-		flow_rad_msg->integration_time_us = flow_rad.integration_time_us;
-
-		flow_rad_msg->integrated_x = int_xy.x();
-		flow_rad_msg->integrated_y = int_xy.y();
+		flow_rad_msg.integrated_x = int_xy.x();
+		flow_rad_msg.integrated_y = int_xy.y();
 
-		flow_rad_msg->integrated_xgyro = int_gyro.x();
-		flow_rad_msg->integrated_ygyro = int_gyro.y();
-		flow_rad_msg->integrated_zgyro = int_gyro.z();
+		flow_rad_msg.integrated_xgyro = int_gyro.x();
+		flow_rad_msg.integrated_ygyro = int_gyro.y();
+		flow_rad_msg.integrated_zgyro = int_gyro.z();
 
-		flow_rad_msg->temperature = flow_rad.temperature / 100.0f;	// in degrees celsius
-		flow_rad_msg->time_delta_distance_us = flow_rad.time_delta_distance_us;
-		flow_rad_msg->distance = flow_rad.distance;
-		flow_rad_msg->quality = flow_rad.quality;
+		flow_rad_msg.temperature = flow_rad.temperature / 100.0f;	// in degrees celsius
+		flow_rad_msg.time_delta_distance_us = flow_rad.time_delta_distance_us;
+		flow_rad_msg.distance = flow_rad.distance;
+		flow_rad_msg.quality = flow_rad.quality;
 
 		flow_rad_pub.publish(flow_rad_msg);
 
-		// Temperature
-		auto temp_msg = boost::make_shared<sensor_msgs::Temperature>();
+		if (publish_velocity)
+			publish_flow_velocity(header, flow_rad);
 
-		temp_msg->header = header;
-		temp_msg->temperature = flow_rad_msg->temperature;
+		if (combined)
+			return;
 
-		temp_pub.publish(temp_msg);
+		// Temperature
+		if (temp_governor.pass(header.stamp.toNSec())) {
+			temp_msg.header = header;
+			temp_msg.temperature = flow_rad_msg.temperature;
+
+			temp_pub.publish(temp_msg);
+		}
 
 		// Rangefinder
 		/**
@@ -140,22 +218,15 @@ private:
 		 * @todo: suggest modification on MAVLink OPTICAL_FLOW_RAD msg
 		 * which removes sonar data fields from it
 		 */
-		auto range_msg = boost::make_shared<sensor_msgs::Range>();
-
-		range_msg->header = header;
-
-		range_msg->radiation_type = sensor_msgs::Range::ULTRASOUND;
-		range_msg->field_of_view = ranger_fov;
-		range_msg->min_range = ranger_min_range;
-		range_msg->max_range = ranger_max_range;
-		range_msg->range = flow_rad.distance;
+		range_msg.header = header;
+		range_msg.range = flow_rad.distance;
 
 		range_pub.publish(range_msg);
 	}
 
 	void send_cb(const mavros_msgs::OpticalFlowRad::ConstPtr msg)
 	{
-		mavlink::common::msg::OPTICAL_FLOW_RAD flow_rad_msg;
+		mavlink::common::msg::OPTICAL_FLOW_RAD flow_rad_msg {};
 
 		auto int_xy = ftf::transform_frame_baselink_aircraft(
 			Eigen::Vector3d(
@@ -187,5 +258,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::PX4FlowPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::PX4FlowPlugin)
@@ -28,12 +28,13 @@ namespace extra_plugins {
 class RangefinderPlugin : public plugin::PluginBase {
 public:
 	RangefinderPlugin() : PluginBase(),
-		rangefinder_nh("~rangefinder")
+		rangefinder_nh(private_nh("rangefinder"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(rangefinder_nh);
 
 		rangefinder_pub = rangefinder_nh.advertise<sensor_msgs::Range>("rangefinder", 10);
 	}
@@ -66,5 +67,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::RangefinderPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::RangefinderPlugin)
@@ -14,6 +14,7 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.mdA
  */
 
+#include <mutex>
 #include <mavros/mavros_plugin.h>
 #include <mavros_msgs/Trajectory.h>
 #include <mavros_msgs/PositionTarget.h>
@@ -35,21 +36,39 @@ using RosPoints = mavros_msgs::PositionTarget;
  * @brief Trajectory plugin to receive planned path from the FCU and
  * send back to the FCU a corrected path (collision free, smoothed)
  *
+ * With ~trajectory/stream/enable long nav_msgs::Path is kept and
+ * 5 point window slides along it as vehicle local position passes points,
+ * window is sent at ~trajectory/stream/rate.
+ *
  * @see trajectory_cb()
+ * @see path_cb()
  */
 class TrajectoryPlugin : public plugin::PluginBase {
 public:
 	TrajectoryPlugin() : PluginBase(),
-		trajectory_nh("~trajectory")
+		trajectory_nh(private_nh("trajectory")),
+		stream_enable(false),
+		acceptance_radius(0.5),
+		path_index(0)
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(trajectory_nh);
 
 		trajectory_generated_sub = trajectory_nh.subscribe("generated", 10, &TrajectoryPlugin::trajectory_cb, this);
 		path_sub = trajectory_nh.subscribe("path", 10, &TrajectoryPlugin::path_cb, this);
 		trajectory_desired_pub = trajectory_nh.advertise<mavros_msgs::Trajectory>("desired", 10);
+
+		double stream_rate;
+		trajectory_nh.param("stream/enable", stream_enable, false);
+		trajectory_nh.param("stream/rate", stream_rate, 10.0);
+		trajectory_nh.param("stream/acceptance_radius", acceptance_radius, 0.5);
+
+		if (stream_enable)
+			make_timer(stream_timer, ros::Duration(1.0 / stream_rate),
+					&TrajectoryPlugin::stream_cb);
 	}
 
 	Subscriptions get_subscriptions()
@@ -66,6 +85,16 @@ private:
 	ros::Subscriber path_sub;
 
 	ros::Publisher trajectory_desired_pub;
+	Timer stream_timer;
+
+	bool stream_enable;
+	double acceptance_radius;	//!< [m] point passed when closer
+
+	//! Path in NED, capacity kept between messages
+	std::mutex path_mutex;
+	std::vector<Eigen::Vector3d> path_ned;
+	std::vector<float> path_yaw;
+	size_t path_index;		//!< first point of streamed window
 
 	// [[[cog:
 	// def outl_fill_points_ned_vector(x, y, z, vec_name, vec_type, point_xyz):
@@ -124,13 +153,13 @@ private:
 		yv[i] = yaw_speed;
 	}
 
-	void fill_points_yaw_q(MavPoints &y, const geometry_msgs::Quaternion &orientation, const size_t i) {
+	float yaw_from_q(const geometry_msgs::Quaternion &orientation) {
 		auto q_wp = ftf::transform_orientation_enu_ned(
 					ftf::transform_orientation_baselink_aircraft(
 						ftf::to_eigen(orientation)));
 		auto yaw_wp = ftf::quaternion_get_yaw(q_wp);
 
-		y[i] = wrap_pi(-yaw_wp + (M_PI / 2.0f));
+		return wrap_pi(-yaw_wp + (M_PI / 2.0f));
 	}
 
 	void fill_points_delta(MavPoints &y, const double time_horizon, const size_t i) {
@@ -289,45 +318,114 @@ private:
 	}
 
 
+	/**
+	 * @brief Convert first @a count poses of path to NED buffers
+	 *
+	 * Positions copied and transformed in one batch pass, buffers only
+	 * grow, so steady stream of same size paths does not allocate.
+	 */
+	void convert_path(const nav_msgs::Path &path, size_t count)
+	{
+		path_ned.resize(count);
+		path_yaw.resize(count);
+
+		for (size_t i = 0; i < count; i++) {
+			auto &p = path.poses[i].pose.position;
+			path_ned[i] = Eigen::Vector3d(p.x, p.y, p.z);
+		}
+
+		ftf::transform_frame_enu_ned(path_ned.data(), path_ned.data(), count);
+
+		for (size_t i = 0; i < count; i++)
+			path_yaw[i] = yaw_from_q(path.poses[i].pose.orientation);
+	}
+
+	//! Fill TRAJECTORY from converted path, points from @a first
+	void fill_window(mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS &t, size_t first)
+	{
+		t.valid_points = 0;
+
+		for (size_t i = 0; i < NUM_POINTS; i++) {
+			t.command[i] = UINT16_MAX;
+			if (first + i >= path_ned.size()) {
+				fill_points_all_unused(t, i);
+				continue;
+			}
+
+			auto &p = path_ned[first + i];
+			t.pos_x[i] = p.x();
+			t.pos_y[i] = p.y();
+			t.pos_z[i] = p.z();
+			t.pos_yaw[i] = path_yaw[first + i];
+			fill_points_unused_path(t, i);
+			t.valid_points++;
+		}
+	}
+
 	/**
 	 * @brief Send corrected path to the FCU.
 	 *
 	 * Message specification: https://mavlink.io/en/messages/common.html#TRAJECTORY
+	 * In stream mode only stores path, it is sent by stream_cb().
 	 * @param req	received nav_msgs Path msg
 	 */
 	void path_cb(const nav_msgs::Path::ConstPtr &req)
 	{
+		std::lock_guard<std::mutex> lock(path_mutex);
+
+		if (stream_enable) {
+			convert_path(*req, req->poses.size());
+			path_index = 0;
+			return;
+		}
+
 		mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS trajectory {};
 
 		trajectory.time_usec = req->header.stamp.toNSec() / 1000;	//!< [milisecs]
-		trajectory.valid_points = std::min(NUM_POINTS, req->poses.size());
+		convert_path(*req, std::min(NUM_POINTS, req->poses.size()));
+		fill_window(trajectory, 0);
 
-		auto fill_point = [&](mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS & t, const size_t i) {
-			t.command[i] = UINT16_MAX;
-			if (req->poses.size() < i + 1) {
-				fill_points_all_unused(t, i);
-			}
-			else {
-				auto &pose = req->poses[i].pose;
+		UAS_FCU(m_uas)->send_message_ignore_drop(trajectory);
+	}
 
-				fill_points_position(t.pos_x, t.pos_y, t.pos_z, pose.position, i);
-				fill_points_yaw_q(t.pos_yaw, pose.orientation, i);
-				fill_points_unused_path(t, i);
+	/**
+	 * @brief Slide window along stored path and send it
+	 *
+	 * Point is passed when vehicle is within acceptance radius or
+	 * next point is closer, so window never moves back.
+	 */
+	void stream_cb(const ros::TimerEvent &event)
+	{
+		const ros::Time now = ros::Time::now();
+		Eigen::Vector3d position_enu;
+
+		if (!m_uas->get_local_position_at(now, position_enu)) {
+			ROS_WARN_THROTTLE_NAMED(10, "trajectory", "TRJ: no local position, path not streamed");
+			return;
+		}
+
+		const Eigen::Vector3d position = ftf::transform_frame_enu_ned(position_enu);
+		mavlink::common::msg::TRAJECTORY_REPRESENTATION_WAYPOINTS trajectory {};
+
+		{
+			std::lock_guard<std::mutex> lock(path_mutex);
+			if (path_ned.empty())
+				return;
+
+			while (path_index + 1 < path_ned.size()) {
+				const double d = (path_ned[path_index] - position).norm();
+				const double d_next = (path_ned[path_index + 1] - position).norm();
+
+				if (d > acceptance_radius && d_next > d)
+					break;
+
+				path_index++;
 			}
-		};
 
-		// [[[cog:
-		// for i in range(5):
-		//      cog.outl(
-		//          'fill_point(trajectory, {i0});'.format(i0=i, i1=i+1))
-		// ]]]
-		fill_point(trajectory, 0);
-		fill_point(trajectory, 1);
-		fill_point(trajectory, 2);
-		fill_point(trajectory, 3);
-		fill_point(trajectory, 4);
-		// [[[end]]] (checksum: 267a911c65a3768f04a8230fcb235bca)
+			fill_window(trajectory, path_index);
+		}
 
+		trajectory.time_usec = now.toNSec() / 1000;	//!< [milisecs]
 		UAS_FCU(m_uas)->send_message_ignore_drop(trajectory);
 	}
 
@@ -385,5 +483,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::TrajectoryPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::TrajectoryPlugin)
@@ -29,12 +29,13 @@ namespace extra_plugins {
 class VibrationPlugin : public plugin::PluginBase {
 public:
 	VibrationPlugin() : PluginBase(),
-		vibe_nh("~vibration")
+		vibe_nh(private_nh("vibration"))
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(vibe_nh);
 
 		vibe_nh.param<std::string>("frame_id", frame_id, "base_link");
 
@@ -74,5 +75,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::VibrationPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::VibrationPlugin)
@@ -17,6 +17,7 @@
 
 #include <mavros/mavros_plugin.h>
 #include <mavros/setpoint_mixin.h>
+#include <mavros/uplink_governor.h>
 #include <eigen_conversions/eigen_msg.h>
 
 #include <geometry_msgs/PoseStamped.h>
@@ -30,18 +31,27 @@ namespace extra_plugins{
  * Send pose estimation from various vision estimators
  * to FCU position and attitude estimators.
  *
+ * ~vision_pose/uplink/rate limits sent rate to one FCU estimator fuses,
+ * converted covariance reused while it stays within ~vision_pose/uplink/cov_tolerance.
  */
 class VisionPoseEstimatePlugin : public plugin::PluginBase,
 	private plugin::TF2ListenerMixin<VisionPoseEstimatePlugin> {
 public:
 	VisionPoseEstimatePlugin() : PluginBase(),
-		sp_nh("~vision_pose"),
+		sp_nh(private_nh("vision_pose")),
 		tf_rate(10.0)
 	{ }
 
+	~VisionPoseEstimatePlugin()
+	{
+		// callback uses members, they go before mixin
+		tf2_stop();
+	}
+
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
 
 		bool tf_listen;
 
@@ -51,6 +61,13 @@ public:
 		sp_nh.param<std::string>("tf/child_frame_id", tf_child_frame_id, "vision_estimate");
 		sp_nh.param("tf/rate_limit", tf_rate, 10.0);
 
+		// uplink params
+		double uplink_rate, cov_tolerance;
+		sp_nh.param("uplink/rate", uplink_rate, 0.0);
+		sp_nh.param("uplink/cov_tolerance", cov_tolerance, 0.0);
+		governor.set_rate(uplink_rate);
+		cov_cache.set_tolerance(cov_tolerance);
+
 		if (tf_listen) {
 			ROS_INFO_STREAM_NAMED("vision_pose", "Listen to vision transform " << tf_frame_id
 						<< " -> " << tf_child_frame_id);
@@ -79,6 +96,9 @@ private:
 	double tf_rate;
 	ros::Time last_transform_stamp;
 
+	UplinkGovernor governor;
+	CovarianceCache<6, 21> cov_cache;	//!< ENU 6x6 -> NED URT
+
 	/* -*- low-level send -*- */
 	/**
 	 * @brief Send vision estimate transform to FCU position controller
@@ -95,17 +115,14 @@ private:
 		}
 		last_transform_stamp = stamp;
 
+		if (!governor.pass(stamp.toNSec()))
+			return;
+
 		auto position = ftf::transform_frame_enu_ned(Eigen::Vector3d(tr.translation()));
 		auto rpy = ftf::quaternion_to_rpy(
 				ftf::transform_orientation_enu_ned(
 				ftf::transform_orientation_baselink_aircraft(Eigen::Quaterniond(tr.rotation()))));
 
-		auto cov_ned = ftf::transform_frame_enu_ned(cov);
-		ftf::EigenMapConstCovariance6d cov_map(cov_ned.data());
-
-		auto urt_view = Eigen::Matrix<double, 6, 6>(cov_map.triangularView<Eigen::Upper>());
-		ROS_DEBUG_STREAM_NAMED("vision_pose", "Vision: Covariance URT: " << std::endl << urt_view);
-
 		mavlink::common::msg::VISION_POSITION_ESTIMATE vp{};
 
 		vp.usec = stamp.toNSec() / 1000;
@@ -123,9 +140,17 @@ private:
 		vp.yaw = rpy.z();
 		// [[[end]]] (checksum: 2048daf411780847e77f08fe5a0b9dd3)
 
-		// just the URT of the 6x6 Pose Covariance Matrix, given
-		// that the matrix is symmetric
-		ftf::covariance_urt_to_mavlink(cov_map, vp.covariance);
+		vp.covariance = cov_cache.get(cov, [](const ftf::Covariance6d &cov_enu, std::array<float, 21> &urt) {
+				auto cov_ned = ftf::transform_frame_enu_ned(cov_enu);
+				ftf::EigenMapConstCovariance6d cov_map(cov_ned.data());
+
+				auto urt_view = Eigen::Matrix<double, 6, 6>(cov_map.triangularView<Eigen::Upper>());
+				ROS_DEBUG_STREAM_NAMED("vision_pose", "Vision: Covariance URT: " << std::endl << urt_view);
+
+				// just the URT of the 6x6 Pose Covariance Matrix, given
+				// that the matrix is symmetric
+				ftf::covariance_urt_to_mavlink(cov_map, urt);
+			});
 
 		UAS_FCU(m_uas)->send_message_ignore_drop(vp);
 	}
@@ -163,5 +188,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::VisionPoseEstimatePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::VisionPoseEstimatePlugin)
@@ -16,6 +16,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/uplink_governor.h>
 
 #include <geometry_msgs/TwistStamped.h>
 #include <geometry_msgs/TwistWithCovarianceStamped.h>
@@ -33,7 +34,7 @@ namespace extra_plugins {
 class VisionSpeedEstimatePlugin : public plugin::PluginBase {
 public:
 	VisionSpeedEstimatePlugin() : PluginBase(),
-		sp_nh("~vision_speed"),
+		sp_nh(private_nh("vision_speed")),
 		listen_twist(true),
 		twist_cov(true)
 	{ }
@@ -41,10 +42,15 @@ public:
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(sp_nh);
 
 		sp_nh.param("listen_twist", listen_twist, true);
 		sp_nh.param("twist_cov", twist_cov, true);
 
+		double uplink_rate;
+		sp_nh.param("uplink/rate", uplink_rate, 0.0);
+		governor.set_rate(uplink_rate);
+
 		if (listen_twist) {
 			if (twist_cov)
 				vision_twist_cov_sub = sp_nh.subscribe("speed_twist_cov", 10, &VisionSpeedEstimatePlugin::twist_cov_cb, this);
@@ -65,6 +71,7 @@ private:
 
 	bool listen_twist;			//!< If True, listen to Twist data topics
 	bool twist_cov;				//!< If True, listen to TwistWithCovariance data topic
+	UplinkGovernor governor;		//!< uplink/rate limit
 
 	ros::Subscriber vision_twist_sub;	//!< Subscriber to geometry_msgs/TwistStamped msgs
 	ros::Subscriber vision_twist_cov_sub;	//!< Subscriber to geometry_msgs/TwistWithCovarianceStamped msgs
@@ -109,6 +116,9 @@ private:
 	 */
 	void convert_vision_speed(const ros::Time &stamp, const Eigen::Vector3d &vel_enu, const ftf::Covariance3d &cov_enu)
 	{
+		if (!governor.pass(stamp.toNSec()))
+			return;
+
 		// Send transformed data from local ENU to NED frame
 		send_vision_speed_estimate(stamp.toNSec() / 1000,
 					ftf::transform_frame_enu_ned(vel_enu),
@@ -158,5 +168,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::VisionSpeedEstimatePlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::VisionSpeedEstimatePlugin)
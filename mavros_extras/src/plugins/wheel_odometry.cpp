@@ -15,6 +15,7 @@
  */
 
 #include <mavros/mavros_plugin.h>
+#include <mavros/uplink_governor.h>
 #include <mavros_msgs/WheelOdomStamped.h>
 
 #include <geometry_msgs/TwistWithCovarianceStamped.h>
@@ -31,13 +32,15 @@ namespace extra_plugins {
  * This plugin allows computing and publishing wheel odometry coming from FCU wheel encoders.
  * Can use either wheel's RPM or WHEEL_DISTANCE messages (the latter gives better accuracy).
  *
+ * Any count of parallel wheels is supported: kinematics matrix built once from wheel params,
+ * so each update is one small matrix-vector product.
  */
 class WheelOdometryPlugin : public plugin::PluginBase {
 public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 	WheelOdometryPlugin() : PluginBase(),
-		wo_nh("~wheel_odometry"),
+		wo_nh(private_nh("wheel_odometry")),
 		count(0),
 		odom_mode(OM::NONE),
 		raw_send(false),
@@ -47,12 +50,14 @@ public:
 		rpose(Eigen::Vector3d::Zero()),
 		rtwist(Eigen::Vector3d::Zero()),
 		rpose_cov(Eigen::Matrix3d::Zero()),
-		rtwist_cov(Eigen::Vector3d::Zero())
+		rtwist_cov(Eigen::Vector3d::Zero()),
+		kin_gram(Eigen::Matrix3d::Zero())
 	{ }
 
 	void initialize(UAS &uas_)
 	{
 		PluginBase::initialize(uas_);
+		setup_node_handle(wo_nh);
 
 		// General params
 		wo_nh.param("send_raw", raw_send, false);
@@ -62,6 +67,12 @@ public:
 
 		bool use_rpm;
 		wo_nh.param("use_rpm", use_rpm, false);
+#ifndef MAVCONN_DIALECT_ARDUPILOTMEGA
+		if (use_rpm) {
+			ROS_WARN_NAMED("wo", "WO: RPM needs ardupilotmega dialect, not built. Using WHEEL_DISTANCE.");
+			use_rpm = false;
+		}
+#endif
 		if (use_rpm)
 			odom_mode = OM::RPM;
 		else
@@ -73,6 +84,10 @@ public:
 		wo_nh.param<std::string>("child_frame_id", child_frame_id, "base_link");
 		wo_nh.param("vel_error", vel_cov, 0.1);
 		vel_cov = vel_cov*vel_cov; // std -> cov
+		// Odometry integrated on every measurement, published at most that rate (0 - every measurement)
+		double publish_rate;
+		wo_nh.param("publish_rate", publish_rate, 0.0);
+		publish_governor.set_rate(publish_rate);
 		// TF subsection
 		wo_nh.param("tf/send", tf_send, false);
 		wo_nh.param<std::string>("tf/frame_id", tf_frame_id, "odom");
@@ -104,23 +119,6 @@ public:
 
 			// Check for all wheels specified
 			if (wheel_offset.size() >= count) {
-				// Duplicate 1st wheel if only one is available.
-				// This generalizes odometry computations for 1- and 2-wheels configurations.
-				if (wheel_radius.size() == 1) {
-					wheel_offset.resize(2);
-					wheel_radius.resize(2);
-					wheel_offset[1].x() = wheel_offset[0].x();
-					wheel_offset[1].y() = wheel_offset[0].y() + 1.0; // make separation non-zero to avoid div-by-zero
-					wheel_radius[1] = wheel_radius[0];
-				}
-
-				// Check for non-zero wheel separation (first two wheels)
-				double separation = std::abs(wheel_offset[1].y() - wheel_offset[0].y());
-				if (separation < 1.e-5) {
-					odom_mode = OM::NONE;
-					ROS_WARN_NAMED("wo", "WO: Separation between the first two wheels is too small (%f).", separation);
-				}
-
 				// Check for reasonable radiuses
 				for (int i = 0; i < wheel_radius.size(); i++) {
 					if (wheel_radius[i] <= 1.e-5) {
@@ -128,6 +126,9 @@ public:
 						ROS_WARN_NAMED("wo", "WO: Wheel #%i has incorrect radius (%f).", i, wheel_radius[i]);
 					}
 				}
+
+				if (odom_mode != OM::NONE && !setup_kinematics(count))
+					odom_mode = OM::NONE;
 			}
 			else {
 				odom_mode = OM::NONE;
@@ -157,7 +158,9 @@ public:
 	Subscriptions get_subscriptions()
 	{
 		return {
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 			make_handler(&WheelOdometryPlugin::handle_rpm),
+#endif
 			make_handler(&WheelOdometryPlugin::handle_wheel_distance)
 		};
 	}
@@ -193,7 +196,15 @@ private:
 
 	int count_meas;				//!< number of wheels in measurements
 	ros::Time time_prev;			//!< timestamp of previous measurement
-	std::vector<double> measurement_prev;	//!< previous measurement
+	Eigen::VectorXd measurement_prev;	//!< previous measurement
+	Eigen::VectorXd delta;			//!< per-wheel distance (or mean RPM) scratch, sized once
+
+	UplinkGovernor publish_governor;	//!< publish decimation, independent of encoder rate
+
+	/// @brief Kinematics (built once from wheel params)
+	Eigen::Matrix<double, 3, Eigen::Dynamic> kin_dist;	//!< wheel distances -> local pose increment v
+	Eigen::Matrix<double, 3, Eigen::Dynamic> kin_rpm;	//!< mean wheel RPM-s -> local twist (v per second)
+	Eigen::Matrix3d kin_gram;				//!< kin_dist * kin_dist^T, for error propagation
 
 	bool yaw_initialized;			//!< initial yaw initialized (from IMU)
 
@@ -295,14 +306,73 @@ private:
 			// rotation
 			transform.transform.rotation = quat;
 			// publish
-			m_uas->tf2_broadcaster.sendTransform(transform);
+			m_uas->tf_aggregator.send(transform);
+		}
+	}
+
+	/**
+	 * @brief Build kinematics matrices of first @a nwheels wheels.
+	 * Wheels are assumed to be parallel to the robot's x-direction (forward), without slip.
+	 * Wheel i travels d_i = L + y_i * theta, where L is distance traveled by the origin projection (Op)
+	 * onto the wheels axis and theta is rotation angle (NED y-offsets, ROS yaw).
+	 * Least-squares pseudo-inverse (A^T A)^-1 A^T of that system solves (L, theta)
+	 * for any count of wheels, for two wheels it is the exact solution.
+	 * Lateral motion of the origin a*theta uses mean wheel x-offset (a = -x).
+	 * @param nwheels	number of wheels used in measurements
+	 * @return false if configuration has no lateral wheel separation
+	 */
+	bool setup_kinematics(int nwheels)
+	{
+		Eigen::Matrix<double, 2, Eigen::Dynamic> P(2, nwheels);
+		double a = 0.0;
+		for (int i = 0; i < nwheels; i++)
+			a -= wheel_offset[i].x() / nwheels;
+
+		// Single wheel: straight motion only
+		if (nwheels == 1) {
+			P << 1.0, 0.0;
 		}
+		else {
+			Eigen::Matrix<double, Eigen::Dynamic, 2> A(nwheels, 2);
+			A.col(0).setOnes();
+			for (int i = 0; i < nwheels; i++)
+				A(i, 1) = wheel_offset[i].y();
+
+			// Check for non-zero wheel separation (std of wheel y-offsets)
+			Eigen::Matrix2d AtA = A.transpose() * A;
+			double separation = std::sqrt(std::max(0.0, AtA.determinant())) / nwheels;
+			if (separation < 1.e-5) {
+				ROS_WARN_NAMED("wo", "WO: Lateral separation of the wheels is too small (%f).", separation);
+				return false;
+			}
+
+			P = AtA.inverse() * A.transpose();
+		}
+
+		kin_dist.resize(3, nwheels);
+		kin_dist.row(0) = P.row(0);
+		kin_dist.row(1) = a * P.row(1);
+		kin_dist.row(2) = P.row(1);
+
+		// RPM -> speed (m/s) folded in
+		Eigen::VectorXd rpm_2_speed(nwheels);
+		for (int i = 0; i < nwheels; i++)
+			rpm_2_speed(i) = wheel_radius[i] * 2.0 * M_PI / 60.0;
+		kin_rpm = kin_dist * rpm_2_speed.asDiagonal();
+
+		kin_gram = kin_dist * kin_dist.transpose();
+
+		// Twist errors (constant in time)
+		rtwist_cov = vel_cov * kin_gram.diagonal();
+		rtwist_cov(1) += 0.001; // add extra error, otherwise vy_cov = 0 if a=0
+
+		delta.resize(nwheels);
+		return true;
 	}
 
 	/**
-	 * @brief Update odometry for differential drive robot.
+	 * @brief Update odometry.
 	 * Odometry is computed for robot's origin (IMU).
-	 * The wheels are assumed to be parallel to the robot's x-direction (forward) and with the same x-offset.
 	 * No slip is assumed (Instantaneous Center of Curvature (ICC) along the axis connecting the wheels).
 	 * All computations are performed for ROS frame conventions.
 	 * The approach is the extended and more accurate version of standard one described in the book
@@ -311,26 +381,16 @@ private:
 	 * http://correll.cs.colorado.edu/?p=1307
 	 * The extension is that exact pose update is used instead of approximate,
 	 * and that the robot's origin can be specified anywhere instead of the middle-point between the wheels.
-	 * @param distance	distance traveled by each wheel since last odometry update
+	 * @param v		instantaneous pose update in local (robot) coordinate system (L, a*theta, theta)
 	 * @param dt		time elapse since last odometry update (s)
 	 */
-	void update_odometry_diffdrive(std::vector<double> distance, double dt)
+	void update_odometry(const Eigen::Vector3d &v, double dt)
 	{
-		double y0 = wheel_offset[0](1);
-		double y1 = wheel_offset[1](1);
-		double a = -wheel_offset[0](0);
-		double dy_inv = 1.0 / (y1 - y0);
-		double dt_inv = 1.0 / dt;
-
 		// Rotation angle
-		double theta = (distance[1] - distance[0]) * dy_inv;
-		// Distance traveled by the projection of origin onto the axis connecting the wheels (Op)
-		double L = (y1 * distance[0] - y0 * distance[1]) * dy_inv;
+		double theta = v(2);
 
-		// Instantenous pose update in local (robot) coordinate system (vel*dt)
-		Eigen::Vector3d v(L, a*theta, theta);
 		// Instantenous local twist
-		rtwist = v * dt_inv;
+		rtwist = v / dt;
 
 		// Compute local pose update (approximate).
 		// In the book a=0 and |y0|=|y1|, additionally.
@@ -375,13 +435,6 @@ private:
 		rpose += R * dpose;
 		rpose(2) = fmod(rpose(2), 2.0*M_PI); // Clamp to (-2*PI, 2*PI)
 
-		// Twist errors (constant in time)
-		if (rtwist_cov(0) == 0.0) {
-			rtwist_cov(0) = vel_cov * (y0*y0 + y1*y1) * dy_inv*dy_inv; // vx_cov
-			rtwist_cov(1) = vel_cov * a*a * 2.0 * dy_inv*dy_inv + 0.001; // vy_cov (add extra error, otherwise vy_cov= 0 if a=0)
-			rtwist_cov(2) = vel_cov * 2.0 * dy_inv*dy_inv; // vyaw_cov
-		}
-
 		// Pose errors (accumulated in time).
 		// Exact formulations respecting kinematic equations.
 		// dR/dYaw
@@ -394,18 +447,6 @@ private:
 		// Jacobian by previous pose
 		Eigen::Matrix3d J_pose = Eigen::Matrix3d::Identity() + R_yaw * dpose * yaw_pose.transpose();
 
-		// dL,dTheta / dL0,dL1
-		double L_L0 = y1 * dy_inv;
-		double L_L1 = -y0 * dy_inv;
-		double theta_L0 = -dy_inv;
-		double theta_L1 = dy_inv;
-		// dv/dMeasurement
-		Eigen::Matrix<double, 3, 2> v_meas;
-		v_meas <<       L_L0,       L_L1,
-				  a*theta_L0, a*theta_L1,
-					theta_L0,   theta_L1;
-		// dTheta/dMeasurement
-		Eigen::Vector2d theta_meas(theta_L0, theta_L1);
 		// dM/dTheta
 		double px; // dP/dTheta
 		double qx; // dQ/dTheta
@@ -423,37 +464,17 @@ private:
 		M_theta << px, -qx,  0,
 				   qx,  px,  0,
 					0,   0,  0;
-		// Jacobian by measurement
-		Eigen::Matrix<double, 3, 2> J_meas = R * (M * v_meas + M_theta * v * theta_meas.transpose());
 
-		// Measurement cov
-		double L0_cov = vel_cov * dt*dt;
-		double L1_cov = vel_cov * dt*dt;
-		Eigen::Matrix2d meas_cov;
-		meas_cov << L0_cov,     0,
-						 0, L1_cov;
+		// Jacobian by measurement J = R * (M * K + B * K.row(2)), B = M_theta * v, K = kin_dist.
+		// Measurement errors are same and independent for each wheel (vel_cov * dt^2 * I),
+		// so J * meas_cov * J^T reduces to 3x3 products with G = K * K^T whatever wheels count is.
+		Eigen::Vector3d B = M_theta * v;
+		Eigen::Vector3d g = kin_gram.col(2);
+		Eigen::Matrix3d Mg = M * g * B.transpose();
+		Eigen::Matrix3d JJt = M * kin_gram * M.transpose() + Mg + Mg.transpose() + kin_gram(2, 2) * B * B.transpose();
 
 		// Update pose cov
-		rpose_cov = J_pose * rpose_cov * J_pose.transpose() + J_meas * meas_cov * J_meas.transpose();
-	}
-
-	/**
-	 * @brief Update odometry (currently, only 2-wheels differential configuration implemented).
-	 * Odometry is computed for robot's origin (IMU).
-	 * @param distance	distance traveled by each wheel since last odometry update
-	 * @param dt		time elapse since last odometry update (s)
-	 */
-	void update_odometry(std::vector<double> distance, double dt)
-	{
-		// Currently, only 2-wheels configuration implemented
-		int nwheels = std::min(2, (int)distance.size());
-		switch (nwheels)
-		{
-		// Differential drive robot.
-		case 2:
-			update_odometry_diffdrive(distance, dt);
-			break;
-		}
+		rpose_cov = J_pose * rpose_cov * J_pose.transpose() + (vel_cov * dt*dt) * R * JJt * R.transpose();
 	}
 
 	/**
@@ -463,13 +484,19 @@ private:
 	 * @param time		measurement's internal time stamp (for accurate dt computations)
 	 * @param time_pub	measurement's time stamp for publish
 	 */
-	void process_measurement(std::vector<double> measurement, bool rpm, ros::Time time, ros::Time time_pub)
+	void process_measurement(const Eigen::Ref<const Eigen::VectorXd> &measurement, bool rpm, ros::Time time, ros::Time time_pub)
 	{
 		// Initial measurement
 		if (time_prev == ros::Time(0)) {
 			count_meas = measurement.size();
-			measurement_prev.resize(count_meas);
-			count = std::min(count, count_meas); // don't try to use more wheels than we have
+			// don't try to use more wheels than we have
+			if (count > count_meas) {
+				count = count_meas;
+				if (!setup_kinematics(count)) {
+					odom_mode = OM::NONE;
+					return;
+				}
+			}
 		}
 		// Same time stamp (messages are generated by FCU more often than the wheel state updated)
 		else if (time == time_prev) {
@@ -484,42 +511,36 @@ private:
 		else {
 			double dt = (time - time_prev).toSec(); // Time since previous measurement (s)
 
-			// Distance traveled by each wheel since last measurement.
-			// Reserve for at least 2 wheels.
-			std::vector<double> distance(std::max(2, count));
-			// Compute using RPM-s
+			// Local pose update: single product of kinematics matrix and per-wheel vector
+			Eigen::Vector3d v;
 			if (rpm) {
-				for (int i = 0; i < count; i++) {
-					double RPM_2_SPEED = wheel_radius[i] * 2.0 * M_PI / 60.0; // RPM -> speed (m/s)
-					double rpm = 0.5 * (measurement[i] + measurement_prev[i]); // Mean RPM during last dt seconds
-					distance[i] = rpm * RPM_2_SPEED * dt;
-				}
+				// Mean RPM during last dt seconds
+				delta.noalias() = 0.5 * (measurement.head(count) + measurement_prev.head(count));
+				v.noalias() = kin_rpm * delta;
+				v *= dt;
 			}
-			// Compute using cumulative distances
 			else {
-				for (int i = 0; i < count; i++)
-					distance[i] = measurement[i] - measurement_prev[i];
+				// Distance traveled by each wheel since last measurement
+				delta.noalias() = measurement.head(count) - measurement_prev.head(count);
+				v.noalias() = kin_dist * delta;
 			}
 
-			// Make distance of the 2nd wheel equal to that of the 1st one if requested or only one is available.
-			// This generalizes odometry computations for 1- and 2-wheels configurations.
-			if (count == 1)
-				distance[1] = distance[0];
-
 			// Update odometry
-			update_odometry(distance, dt);
+			update_odometry(v, dt);
 
 			// Publish odometry
-			publish_odometry(time_pub);
+			if (publish_governor.pass(time_pub.toNSec()))
+				publish_odometry(time_pub);
 		}
 
 		// Time step
 		time_prev = time;
-		std::copy_n(measurement.begin(), measurement.size(), measurement_prev.begin());
+		measurement_prev = measurement;
 	}
 
 	/* -*- message handlers -*- */
 
+#ifdef MAVCONN_DIALECT_ARDUPILOTMEGA
 	/**
 	 * @brief Handle Ardupilot RPM MAVlink message.
 	 * Message specification: http://mavlink.io/en/messages/ardupilotmega.html#RPM
@@ -545,10 +566,11 @@ private:
 
 		// Process measurement
 		if (odom_mode == OM::RPM) {
-			std::vector<double> measurement{rpm.rpm1, rpm.rpm2};
+			Eigen::Vector2d measurement(rpm.rpm1, rpm.rpm2);
 			process_measurement(measurement, true, timestamp, timestamp);
 		}
 	}
+#endif
 
 	/**
 	 * @brief Handle WHEEL_DISTANCE MAVlink message.
@@ -580,8 +602,7 @@ private:
 
 		// Process measurement
 		if (odom_mode == OM::DIST) {
-			std::vector<double> measurement(wheel_dist.count);
-			std::copy_n(wheel_dist.distance.begin(), wheel_dist.count, measurement.begin());
+			Eigen::Map<const Eigen::VectorXd> measurement(wheel_dist.distance.data(), wheel_dist.count);
 			process_measurement(measurement, false, timestamp_int, timestamp);
 		}
 	}
@@ -589,5 +610,5 @@ private:
 }	// namespace extra_plugins
 }	// namespace mavros
 
-#include <pluginlib/class_list_macros.h>
-PLUGINLIB_EXPORT_CLASS(mavros::extra_plugins::WheelOdometryPlugin, mavros::plugin::PluginBase)
+#include <mavros/plugin_registry.h>
+MAVROS_PLUGIN_EXPORT(mavros::extra_plugins::WheelOdometryPlugin)
@@ -11,6 +11,8 @@
  * https://github.com/mavlink/mavros/tree/master/LICENSE.md
  */
 
+#include <vector>
+
 #include <ros/ros.h>
 #include <ros/console.h>
 
@@ -42,7 +44,9 @@ public:
 		rc_trim(1500),
 		rc_dz(0),
 		rc_rev(false)
-	{ };
+	{
+		setup_mapping();
+	};
 
 	ServoDescription(std::string joint_name_, double lower_, double upper_,
 			int channel_,
@@ -57,48 +61,69 @@ public:
 		rc_trim(trim_),
 		rc_dz(dz_),
 		rc_rev(rev_)
-	{ };
+	{
+		setup_mapping();
+	};
 
-	/**
-	 * Normalization code taken from PX4 Firmware
-	 * src/modules/sensors/sensors.cpp Sensors::rc_poll() line 1966
-	 */
-	inline float normalize(uint16_t pwm) {
+	//! Joint position for @a pwm: one clamp, one compare, one multiply-add
+	inline float calculate_position(uint16_t pwm) const {
 		// 1) fix bounds
 		pwm = std::max(pwm, rc_min);
 		pwm = std::min(pwm, rc_max);
 
-		// 2) scale around mid point
-		float chan;
-		if (pwm > (rc_trim + rc_dz)) {
-			chan = (pwm - rc_trim - rc_dz) / (float)(rc_max - rc_trim - rc_dz);
-		}
-		else if (pwm < (rc_trim - rc_dz)) {
-			chan = (pwm - rc_trim + rc_dz) / (float)(rc_trim - rc_min - rc_dz);
-		}
-		else {
-			chan = 0.0;
-		}
-
-		if (rc_rev)
-			chan *= -1;
-
-		if (!std::isfinite(chan)) {
-			ROS_DEBUG("SSP: not finite result in RC%zu channel normalization!", rc_channel);
-			chan = 0.0;
-		}
-
-		return chan;
+		// 2) linear piece of that side of dead zone
+		if (pwm > hi_start)
+			return hi_offset + hi_slope * pwm;
+		else if (pwm < lo_start)
+			return lo_offset + lo_slope * pwm;
+		else
+			return position_mid;
 	}
 
-	float calculate_position(uint16_t pwm) {
-		float channel = normalize(pwm);
+private:
+	//! Piecewise linear PWM -> position table
+	int hi_start;		//!< pwm above: upper side of dead zone
+	int lo_start;		//!< pwm below: lower side of dead zone
+	float hi_slope, hi_offset;
+	float lo_slope, lo_offset;
+	float position_mid;	//!< position inside dead zone
 
-		// not sure should i differently map -1..0 and 0..1
-		// for now there arduino map() (explicit)
-		float position = (channel + 1.0) * (joint_upper - joint_lower) / (1.0 + 1.0) + joint_lower;
+	/**
+	 * Normalization code taken from PX4 Firmware
+	 * src/modules/sensors/sensors.cpp Sensors::rc_poll() line 1966
+	 *
+	 * chan = (pwm - trim - dz) / (max - trim - dz)	for pwm > trim + dz
+	 * chan = (pwm - trim + dz) / (trim - min - dz)	for pwm < trim - dz
+	 * chan = 0					otherwise, reversed if rc_rev,
+	 *
+	 * then mapped to joint limits like arduino map() (explicit)
+	 * (not sure should i differently map -1..0 and 0..1):
+	 * position = (chan + 1) * (upper - lower) / 2 + lower
+	 *
+	 * Both steps are linear, so each side folds to position = offset + slope * pwm.
+	 */
+	void setup_mapping() {
+		const float half_range = (joint_upper - joint_lower) / 2.0f;
+		const float sign = rc_rev ? -1.0f : 1.0f;
+
+		hi_start = rc_trim + rc_dz;
+		lo_start = rc_trim - rc_dz;
+		position_mid = half_range + joint_lower;
+
+		auto fold = [&](int zero_pwm, int span, float &slope, float &offset) {
+			if (span <= 0) {
+				ROS_DEBUG("SSP: not finite result in RC%zu channel normalization!", rc_channel);
+				slope = 0.0f;
+				offset = position_mid;
+				return;
+			}
+
+			slope = sign * half_range / span;
+			offset = position_mid - slope * zero_pwm;
+		};
 
-		return position;
+		fold(hi_start, rc_max - hi_start, hi_slope, hi_offset);
+		fold(lo_start, rc_trim - rc_min - rc_dz, lo_slope, lo_offset);
 	}
 };
 
@@ -114,11 +139,19 @@ public:
 
 		ROS_ASSERT(param_dict.getType() == XmlRpc::XmlRpcValue::TypeStruct);
 
+		// 0 - publish on each rc_out message
+		double publish_rate;
+		priv_nh.param("publish_rate", publish_rate, 0.0);
+
 		urdf::Model model;
 		model.initParam("robot_description");
 		ROS_INFO("SSP: URDF robot: %s", model.getName().c_str());
 
 		for (auto &pair : param_dict) {
+			// joints are structs, skip node options
+			if (pair.second.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+				continue;
+
 			ROS_DEBUG("SSP: Loading joint: %s", pair.first.c_str());
 
 			// inefficient, but easier to program
@@ -158,8 +191,21 @@ public:
 			ROS_INFO("SSP: joint '%s' (RC%d) loaded", pair.first.c_str(), rc_channel);
 		}
 
-		rc_out_sub = nh.subscribe("rc_out", 10, &ServoStatePublisher::rc_out_cb, this);
+		// joint names fixed, positions start at trim
+		states.name.reserve(servos.size());
+		states.position.reserve(servos.size());
+		for (auto &desc : servos) {
+			states.name.emplace_back(desc.joint_name);
+			states.position.emplace_back(desc.calculate_position(desc.rc_trim));
+		}
+
+		rc_out_sub = nh.subscribe("rc_out", 10, &ServoStatePublisher::rc_out_cb, this,
+				ros::TransportHints().tcpNoDelay());
 		joint_states_pub = nh.advertise<sensor_msgs::JointState>("joint_states", 10);
+
+		publish_on_rc_out = publish_rate <= 0.0;
+		if (!publish_on_rc_out)
+			publish_timer = nh.createTimer(ros::Duration(1.0 / publish_rate), &ServoStatePublisher::publish_cb, this);
 	}
 
 	void spin() {
@@ -176,28 +222,42 @@ private:
 	ros::NodeHandle nh;
 	ros::Subscriber rc_out_sub;
 	ros::Publisher joint_states_pub;
+	ros::Timer publish_timer;
 
-	std::list<ServoDescription> servos;
+	std::vector<ServoDescription> servos;
+	sensor_msgs::JointState states;	//!< preallocated, same order as servos
+	bool publish_on_rc_out;
+	bool have_rc_out = false;
 
 	void rc_out_cb(const mavros_msgs::RCOut::ConstPtr &msg) {
 		if (msg->channels.empty())
 			return;		// nothing to do
 
-		auto states = boost::make_shared<sensor_msgs::JointState>();
-		states->header.stamp = msg->header.stamp;
+		states.header.stamp = msg->header.stamp;
 
-		for (auto &desc : servos) {
+		for (size_t i = 0; i < servos.size(); i++) {
+			auto &desc = servos[i];
 			if (!(desc.rc_channel != 0 && desc.rc_channel <= msg->channels.size()))
 				continue;	// prevent crash on servos not in that message
 
 			uint16_t pwm = msg->channels[desc.rc_channel - 1];
 			if (pwm == 0 || pwm == UINT16_MAX)
-				continue;	// exclude unset channels
+				continue;	// exclude unset channels, last position kept
 
-			states->name.emplace_back(desc.joint_name);
-			states->position.emplace_back(desc.calculate_position(pwm));
+			states.position[i] = desc.calculate_position(pwm);
 		}
 
+		have_rc_out = true;
+		if (publish_on_rc_out)
+			joint_states_pub.publish(states);
+	}
+
+	void publish_cb(const ros::TimerEvent &event) {
+		if (!have_rc_out)
+			return;
+
+		// latest positions, stamped now: publisher rate differs from rc_out
+		states.header.stamp = event.current_real;
 		joint_states_pub.publish(states);
 	}
 };
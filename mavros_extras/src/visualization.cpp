@@ -12,6 +12,7 @@
  */
 
 #include <vector>
+#include <algorithm>
 
 #include <tf/tf.h>
 
@@ -28,6 +29,8 @@ static std::string fixed_frame_id;
 static std::string child_frame_id;
 static double marker_scale;
 static int max_track_size = 100;
+static int track_segment_size = 50;
+static double track_min_distance = 0.1;
 
 // source subscribers
 ros::Subscriber local_position_sub;
@@ -47,36 +50,65 @@ boost::shared_ptr<visualization_msgs::MarkerArray> vehicle_marker;
 
 /**
  * @brief publish vehicle track
+ *
+ * Track history is a ring of CUBE_LIST segments of track_segment_size points,
+ * ring slot is the marker id. Only the segment being filled is kept and published,
+ * when it is full next slot starts and its ADD replaces oldest segment in RViz.
+ * So message size and RViz load are bounded by track_segment_size and max_track_size.
+ * New point added only after vehicle moved track_min_distance since last one.
  */
 static void publish_track_marker(const geometry_msgs::PoseStamped::ConstPtr &pose)
 {
-	static boost::shared_ptr<visualization_msgs::Marker> track_marker;
+	static boost::shared_ptr<visualization_msgs::MarkerArray> track_marker;
+	static int segment_idx = 0;
+
+	const int num_segments = std::max(1, (max_track_size + track_segment_size - 1) / track_segment_size);
 
 	if ( !track_marker )
 	{
-		track_marker = boost::make_shared<visualization_msgs::Marker>();
-		track_marker->type = visualization_msgs::Marker::CUBE_LIST;
-		track_marker->ns = "fcu";
-		track_marker->action = visualization_msgs::Marker::ADD;
-		track_marker->scale.x = marker_scale * 0.015;
-		track_marker->scale.y = marker_scale * 0.015;
-		track_marker->scale.z = marker_scale * 0.015;
-		track_marker->color.a = 1.0;
-		track_marker->color.r = 0.0;
-		track_marker->color.g = 0.0;
-		track_marker->color.b = 0.5;
-		track_marker->points.reserve(max_track_size);
+		track_marker = boost::make_shared<visualization_msgs::MarkerArray>();
+		track_marker->markers.resize(1);
+
+		auto &segment = track_marker->markers[0];
+		segment.type = visualization_msgs::Marker::CUBE_LIST;
+		segment.ns = "fcu";
+		segment.id = segment_idx;
+		segment.action = visualization_msgs::Marker::ADD;
+		segment.scale.x = marker_scale * 0.015;
+		segment.scale.y = marker_scale * 0.015;
+		segment.scale.z = marker_scale * 0.015;
+		segment.color.a = 1.0;
+		segment.color.r = 0.0;
+		segment.color.g = 0.0;
+		segment.color.b = 0.5;
+		segment.points.reserve(track_segment_size);
 	}
 
-	static int marker_idx = 0;
+	auto &segment = track_marker->markers[0];
+	const auto &p = pose->pose.position;
 
-	if ( track_marker->points.size() < max_track_size )
-		track_marker->points.push_back(pose->pose.position);
-	else track_marker->points[marker_idx] = pose->pose.position;
+	// decimation by distance travelled
+	if ( !segment.points.empty() )
+	{
+		const auto &last = segment.points.back();
+		const double dx = p.x - last.x, dy = p.y - last.y, dz = p.z - last.z;
+		if ( dx * dx + dy * dy + dz * dz < track_min_distance * track_min_distance )
+			return;
+	}
+
+	// segment full: continue in next ring slot, from last point so track has no gap
+	if ( segment.points.size() >= size_t(track_segment_size) )
+	{
+		const auto last = segment.points.back();
+		segment_idx = (segment_idx + 1) % num_segments;
+		segment.id = segment_idx;
+		segment.points.clear();
+		segment.points.push_back(last);
+	}
 
-	marker_idx = ++marker_idx % max_track_size;
+	segment.points.push_back(p);
 
-	track_marker->header = pose->header;
+	segment.header = pose->header;
 	track_marker_pub.publish(track_marker);
 }
 
@@ -284,10 +316,13 @@ int main(int argc, char *argv[])
 	priv_nh.param("body_width", body_width, 0.15 );
 	priv_nh.param("body_height", body_height, 0.10 );
 	priv_nh.param("max_track_size", max_track_size, 1000 );
+	priv_nh.param("track_segment_size", track_segment_size, 50 );
+	priv_nh.param("track_min_distance", track_min_distance, 0.1 );
+	track_segment_size = std::max(2, track_segment_size);
 
 	create_vehicle_markers( num_rotors, arm_len, body_width, body_height );
 
-	track_marker_pub = nh.advertise<visualization_msgs::Marker>("track_markers", 10);
+	track_marker_pub = nh.advertise<visualization_msgs::MarkerArray>("track_markers", 10);
 	vehicle_marker_pub = nh.advertise<visualization_msgs::MarkerArray>("vehicle_marker", 10);
 	wp_marker_pub = nh.advertise<visualization_msgs::Marker>("wp_markers", 10);
 	lt_marker_pub = nh.advertise<visualization_msgs::Marker>("landing_target", 10);
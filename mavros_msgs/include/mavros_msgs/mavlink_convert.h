@@ -15,6 +15,7 @@
 
 #include <algorithm>
 #include <mavros_msgs/Mavlink.h>
+#include <mavros_msgs/MavlinkRaw.h>
 #include <mavconn/mavlink_dialect.h>
 
 namespace mavros_msgs {
@@ -116,5 +117,68 @@ inline bool convert(const mavlink_message_t &mmsg, mavros_msgs::Mavlink &rmsg, u
 	return true;
 }
 
+/**
+ * @brief Convert mavlink_message_t to mavros/MavlinkRaw (on wire frame)
+ *
+ * Frame bytes are same as sent by originator: header, @a len payload bytes,
+ * received CRC and signature are copied as is.
+ * mavlink_msg_to_send_buffer() is not used, it trims payload again
+ * while keeping old CRC, which breaks frames with trailing zeroes.
+ *
+ * @param[in]  mmsg	mavlink_message_t struct
+ * @param[out] rmsg	mavros_msgs/MavlinkRaw message
+ * @param[in]  framing_status  framing parse result (OK, BAD_CRC or BAD_SIGNATURE)
+ * @return true, this convertion can't fail
+ */
+inline bool convert(const mavlink_message_t &mmsg, mavros_msgs::MavlinkRaw &rmsg, uint8_t framing_status = mavros_msgs::Mavlink::FRAMING_OK)
+{
+	rmsg.framing_status = framing_status;
+
+	const bool v2 = mmsg.magic == MAVLINK_STX;
+	const bool is_signed = v2 && (mmsg.incompat_flags & MAVLINK_IFLAG_SIGNED);
+
+	// resize() keeps capacity, so reused message is not reallocated
+	rmsg.data.resize(MAVLINK_MAX_PACKET_LEN);
+	auto p = rmsg.data.begin();
+
+	*p++ = mmsg.magic;
+	*p++ = mmsg.len;
+	if (v2) {
+		*p++ = mmsg.incompat_flags;
+		*p++ = mmsg.compat_flags;
+	}
+	*p++ = mmsg.seq;
+	*p++ = mmsg.sysid;
+	*p++ = mmsg.compid;
+	*p++ = mmsg.msgid & 0xff;
+	if (v2) {
+		*p++ = (mmsg.msgid >> 8) & 0xff;
+		*p++ = (mmsg.msgid >> 16) & 0xff;
+	}
+
+	auto payload = reinterpret_cast<const uint8_t *>(mmsg.payload64);
+	p = std::copy(payload, payload + mmsg.len, p);
+	*p++ = mmsg.ck[0];
+	*p++ = mmsg.ck[1];
+
+	if (is_signed)
+		p = std::copy(mmsg.signature, mmsg.signature + MAVLINK_SIGNATURE_BLOCK_LEN, p);
+
+	rmsg.data.resize(p - rmsg.data.begin());
+
+	return true;
+}
+
+/**
+ * @brief Check that mavros/MavlinkRaw may be passed to MAVConnInterface::send_bytes()
+ *
+ * Only size and STX byte checked, frame content sent as is.
+ */
+inline bool is_valid(const mavros_msgs::MavlinkRaw &rmsg)
+{
+	return !rmsg.data.empty() && rmsg.data.size() <= MAVLINK_MAX_PACKET_LEN &&
+	       (rmsg.data[0] == mavros_msgs::Mavlink::MAVLINK_V10 || rmsg.data[0] == mavros_msgs::Mavlink::MAVLINK_V20);
+}
+
 }	// namespace mavlink
 }	// namespace mavros_msgs
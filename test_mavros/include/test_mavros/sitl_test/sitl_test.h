@@ -20,6 +20,7 @@
 #include <ros/ros.h>
 #include <test_mavros/sitl_test/test_setup.h>
 #include <test_mavros/tests/offboard_control.h>
+#include <test_mavros/tests/perf_benchmark.h>
 
 namespace sitltest {
 /**
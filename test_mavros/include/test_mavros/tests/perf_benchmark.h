@@ -0,0 +1,267 @@
+/**
+ * @brief Performance benchmark test
+ * @file perf_benchmark.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup sitl_test
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <mutex>
+#include <fstream>
+#include <unordered_map>
+#include <ros/ros.h>
+#include <test_mavros/utils/perf_stats.h>
+#include <test_mavros/sitl_test/test_setup.h>
+
+#include <sensor_msgs/Imu.h>
+#include <mavros_msgs/SetMode.h>
+#include <mavros_msgs/CommandBool.h>
+#include <mavros_msgs/PositionTarget.h>
+
+namespace testsetup {
+/**
+ * @brief Latency and resource usage benchmark
+ *
+ * Streams hover setpoints to ~setpoint_raw/local while SITL vehicle is
+ * in OFFBOARD, measuring:
+ * - setpoint publish -> FCU receipt: each setpoint carries tag in sub-millimeter
+ *   x offset, latency is taken when tag first comes back in POSITION_TARGET_LOCAL_NED
+ *   echo (~setpoint_raw/target_local), so it includes up to one echo stream period;
+ * - IMU frame -> imu/data: receive time minus synchronised frame stamp;
+ * - mavros_node CPU usage and RSS, sampled every second.
+ *
+ * Percentiles are logged at the end and optionally written to ~report_file (YAML),
+ * to be compared between releases.
+ */
+class PerfBenchmark {
+public:
+	PerfBenchmark() :
+		nh_sp(test.nh),
+		sp_raw_pub(nh_sp.advertise<mavros_msgs::PositionTarget>("/mavros/setpoint_raw/local", 10)),
+		target_local_sub(nh_sp.subscribe("/mavros/setpoint_raw/target_local", 100, &PerfBenchmark::target_local_cb, this,
+					ros::TransportHints().tcpNoDelay())),
+		imu_sub(nh_sp.subscribe("/mavros/imu/data", 100, &PerfBenchmark::imu_cb, this,
+					ros::TransportHints().tcpNoDelay())),
+		arming_client(nh_sp.serviceClient<mavros_msgs::CommandBool>("/mavros/cmd/arming")),
+		set_mode_client(nh_sp.serviceClient<mavros_msgs::SetMode>("/mavros/set_mode")),
+		seq(0)
+	{ };
+
+	void init() {
+		test.setup(nh_sp);
+		nh_sp.param("setpoint_rate", setpoint_rate, 50.0);
+		nh_sp.param("duration", duration, 60.0);
+		nh_sp.param("warmup", warmup, 5.0);
+		nh_sp.param("altitude", altitude, 2.0);
+		nh_sp.param("arm", arm, true);
+		nh_sp.param("mavros_pid", mavros_pid, 0);
+		nh_sp.param<std::string>("mavros_process", mavros_process, "mavros_node");
+		nh_sp.param<std::string>("report_file", report_file, "");
+	}
+
+	/* -*- main routine -*- */
+
+	void spin(int argc, char *argv[]) {
+		init();
+
+		// echo and IMU callbacks should not wait for the setpoint loop
+		ros::AsyncSpinner spinner(2);
+		spinner.start();
+
+		if (mavros_pid > 0 ? !monitor.attach(mavros_pid) : !monitor.find(mavros_process))
+			ROS_WARN_NAMED("sitl_test", "Perf benchmark: %s process not found, CPU and RSS not measured",
+					mavros_process.c_str());
+
+		ROS_INFO("SITL Test: Performance benchmark running!");
+
+		ros::Rate loop_rate(setpoint_rate);
+		ros::WallTime start = ros::WallTime::now();
+		ros::WallTime last_resource = start;
+		bool offboard_requested = !arm;
+		bool measuring = false;
+
+		while (ros::ok()) {
+			auto now = ros::WallTime::now();
+			const double elapsed = (now - start).toSec();
+
+			// PX4 needs setpoints streamed before switching to OFFBOARD
+			if (!offboard_requested && elapsed > 2.0) {
+				offboard_requested = true;
+				request_offboard();
+			}
+
+			if (!measuring && elapsed > warmup) {
+				ROS_INFO("Measuring for %.1f s...", duration);
+				std::lock_guard<std::mutex> lock(mutex);
+				measuring = active = true;
+			}
+
+			if (measuring && elapsed > warmup + duration)
+				break;
+
+			send_setpoint();
+
+			if (measuring && (now - last_resource).toSec() >= 1.0) {
+				last_resource = now;
+				sample_resources(now.toSec());
+			}
+
+			loop_rate.sleep();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			active = false;
+		}
+
+		report();
+		ros::shutdown();
+	}
+
+private:
+	TestSetup test;
+
+	double setpoint_rate;
+	double duration;
+	double warmup;
+	double altitude;
+	bool arm;
+	int mavros_pid;
+	std::string mavros_process;
+	std::string report_file;
+
+	ros::NodeHandle nh_sp;
+	ros::Publisher sp_raw_pub;
+	ros::Subscriber target_local_sub;
+	ros::Subscriber imu_sub;
+	ros::ServiceClient arming_client;
+	ros::ServiceClient set_mode_client;
+
+	//! tag step [m] and count, tags repeat after TAG_COUNT setpoints
+	static constexpr double TAG_STEP = 1e-4;
+	static constexpr uint32_t TAG_COUNT = 1000;
+
+	std::mutex mutex;
+	bool active = false;
+	uint32_t seq;
+	std::unordered_map<uint32_t, ros::WallTime> pending;	//!< tag -> publish time
+
+	perfstats::SampleStats setpoint_latency;	// ms
+	perfstats::SampleStats imu_latency;		// ms
+	perfstats::SampleStats cpu_usage;		// %
+	perfstats::SampleStats rss;			// MiB
+	perfstats::ProcessMonitor monitor;
+
+	/* -*- helper functions -*- */
+
+	void request_offboard() {
+		mavros_msgs::SetMode mode;
+		mode.request.custom_mode = "OFFBOARD";
+		if (!set_mode_client.call(mode) || !mode.response.mode_sent)
+			ROS_WARN_NAMED("sitl_test", "Perf benchmark: OFFBOARD request failed");
+
+		mavros_msgs::CommandBool arming;
+		arming.request.value = true;
+		if (!arming_client.call(arming) || !arming.response.success)
+			ROS_WARN_NAMED("sitl_test", "Perf benchmark: arming failed");
+	}
+
+	void send_setpoint() {
+		using PT = mavros_msgs::PositionTarget;
+
+		PT sp;
+		sp.header.stamp = ros::Time::now();
+		sp.coordinate_frame = PT::FRAME_LOCAL_NED;
+		sp.type_mask = PT::IGNORE_VX | PT::IGNORE_VY | PT::IGNORE_VZ |
+				PT::IGNORE_AFX | PT::IGNORE_AFY | PT::IGNORE_AFZ |
+				PT::IGNORE_YAW_RATE;
+
+		uint32_t tag;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tag = seq++ % TAG_COUNT;
+			if (active)
+				pending[tag] = ros::WallTime::now();
+		}
+
+		sp.position.x = tag * TAG_STEP;
+		sp.position.z = altitude;
+		sp_raw_pub.publish(sp);
+	}
+
+	void sample_resources(double now) {
+		double cpu, rss_mib;
+		if (monitor.get_pid() <= 0 || !monitor.sample(now, cpu, rss_mib))
+			return;
+
+		cpu_usage.add(cpu);
+		rss.add(rss_mib);
+	}
+
+	void report() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		ROS_INFO("Perf benchmark: setpoint -> FCU echo latency: %s", setpoint_latency.summary("ms").c_str());
+		ROS_INFO("Perf benchmark: IMU frame -> imu/data latency: %s", imu_latency.summary("ms").c_str());
+		ROS_INFO("Perf benchmark: %s (pid %d) CPU: %s", mavros_process.c_str(), monitor.get_pid(), cpu_usage.summary("%").c_str());
+		ROS_INFO("Perf benchmark: %s (pid %d) RSS: %s", mavros_process.c_str(), monitor.get_pid(), rss.summary("MiB").c_str());
+
+		if (report_file.empty())
+			return;
+
+		std::ofstream f(report_file);
+		if (!f) {
+			ROS_ERROR_NAMED("sitl_test", "Perf benchmark: can not write report to %s", report_file.c_str());
+			return;
+		}
+
+		f << "setpoint_rate: " << setpoint_rate << "\n"
+		  << "duration: " << duration << "\n"
+		  << "setpoint_latency_ms:\n" << setpoint_latency.yaml("  ")
+		  << "imu_latency_ms:\n" << imu_latency.yaml("  ")
+		  << "cpu_percent:\n" << cpu_usage.yaml("  ")
+		  << "rss_mib:\n" << rss.yaml("  ");
+
+		ROS_INFO("Perf benchmark: report written to %s", report_file.c_str());
+	}
+
+	/* -*- callbacks -*- */
+
+	void target_local_cb(const mavros_msgs::PositionTarget::ConstPtr &target) {
+		auto now = ros::WallTime::now();
+		const long tag = std::lround(target->position.x / TAG_STEP);
+		if (tag < 0 || tag >= long(TAG_COUNT))
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!active)
+			return;
+
+		// only first echo of tag is receipt, later ones are FCU holding it
+		auto it = pending.find(tag);
+		if (it == pending.end())
+			return;
+
+		setpoint_latency.add((now - it->second).toSec() * 1e3);
+		pending.erase(it);
+	}
+
+	void imu_cb(const sensor_msgs::Imu::ConstPtr &imu) {
+		auto now = ros::Time::now();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (active)
+			imu_latency.add((now - imu->header.stamp).toSec() * 1e3);
+	}
+};
+};	// namespace testsetup
@@ -0,0 +1,209 @@
+/**
+ * @brief Performance statistics helpers
+ * @file perf_stats.h
+ * @author Vladimir Ermakov <vooon341@gmail.com>
+ *
+ * @addtogroup sitl_test
+ * @{
+ */
+/*
+ * Copyright 2017 Vladimir Ermakov.
+ *
+ * This file is part of the mavros package and subject to the license terms
+ * in the top-level LICENSE file of the mavros repository.
+ * https://github.com/mavlink/mavros/tree/master/LICENSE.md
+ */
+
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <numeric>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+
+namespace perfstats {
+/**
+ * @brief Collected samples with percentile summary
+ */
+class SampleStats {
+public:
+	void add(double value) {
+		if (std::isfinite(value))
+			samples.push_back(value);
+	}
+
+	size_t count() const {
+		return samples.size();
+	}
+
+	double mean() const {
+		if (samples.empty())
+			return NAN;
+
+		return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	}
+
+	//! Nearest-rank percentile, @a p in [0, 100]
+	double percentile(double p) const {
+		if (samples.empty())
+			return NAN;
+
+		std::vector<double> sorted(samples);
+		std::sort(sorted.begin(), sorted.end());
+
+		const double rank = std::ceil(std::min(100.0, std::max(0.0, p)) / 100.0 * sorted.size());
+		const size_t idx = (rank > 0.0) ? size_t(rank) - 1 : 0;
+		return sorted[idx];
+	}
+
+	double max() const {
+		if (samples.empty())
+			return NAN;
+
+		return *std::max_element(samples.begin(), samples.end());
+	}
+
+	//! One line summary: count, mean, p50, p90, p99, max
+	std::string summary(const char *unit) const {
+		char buf[256];
+		snprintf(buf, sizeof(buf), "n %zu mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f %s",
+				count(), mean(), percentile(50), percentile(90), percentile(99), max(), unit);
+		return buf;
+	}
+
+	//! YAML mapping with same values, indented by @a indent
+	std::string yaml(const std::string &indent) const {
+		std::ostringstream ss;
+		ss << indent << "count: " << count() << "\n"
+		   << indent << "mean: " << mean() << "\n"
+		   << indent << "p50: " << percentile(50) << "\n"
+		   << indent << "p90: " << percentile(90) << "\n"
+		   << indent << "p99: " << percentile(99) << "\n"
+		   << indent << "max: " << max() << "\n";
+		return ss.str();
+	}
+
+private:
+	std::vector<double> samples;
+};
+
+/**
+ * @brief CPU usage and RSS of other process, from /proc
+ */
+class ProcessMonitor {
+public:
+	ProcessMonitor() :
+		pid(0),
+		last_ticks(0),
+		last_time(0.0)
+	{ }
+
+	/**
+	 * @brief Find process by name (/proc/<pid>/comm)
+	 * @return false if not found
+	 */
+	bool find(const std::string &comm) {
+		DIR *dir = opendir("/proc");
+		if (!dir)
+			return false;
+
+		pid = 0;
+		while (struct dirent *ent = readdir(dir)) {
+			const int p = atoi(ent->d_name);
+			if (p <= 0)
+				continue;
+
+			std::ifstream f("/proc/" + std::to_string(p) + "/comm");
+			std::string name;
+			if (std::getline(f, name) && name == comm) {
+				pid = p;
+				break;
+			}
+		}
+
+		closedir(dir);
+		return attach(pid);
+	}
+
+	//! Monitor given pid
+	bool attach(int pid_) {
+		pid = pid_;
+		last_time = 0.0;
+		return pid > 0 && read_ticks(last_ticks);
+	}
+
+	int get_pid() const {
+		return pid;
+	}
+
+	/**
+	 * @brief Take sample
+	 *
+	 * CPU usage is time spent by all threads since previous call, % of one core.
+	 *
+	 * @param now         monotonic time [s]
+	 * @param[out] cpu    CPU usage [%], NAN on first call
+	 * @param[out] rss    resident set size [MiB]
+	 * @return false if process is gone
+	 */
+	bool sample(double now, double &cpu, double &rss) {
+		unsigned long long ticks;
+		long pages_total, pages_rss;
+
+		if (pid <= 0 || !read_ticks(ticks))
+			return false;
+
+		std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+		if (!(statm >> pages_total >> pages_rss))
+			return false;
+
+		rss = double(pages_rss) * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+
+		cpu = NAN;
+		if (last_time > 0.0 && now > last_time)
+			cpu = 100.0 * double(ticks - last_ticks) / sysconf(_SC_CLK_TCK) / (now - last_time);
+
+		last_ticks = ticks;
+		last_time = now;
+		return true;
+	}
+
+private:
+	int pid;
+	unsigned long long last_ticks;
+	double last_time;
+
+	//! utime + stime from /proc/<pid>/stat
+	bool read_ticks(unsigned long long &ticks) {
+		std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+		std::string line;
+		if (!std::getline(f, line))
+			return false;
+
+		// comm may contain spaces, fields counted after ')'
+		auto pos = line.rfind(')');
+		if (pos == std::string::npos)
+			return false;
+
+		std::istringstream ss(line.substr(pos + 2));
+		std::string field;
+		unsigned long long utime, stime;
+
+		// state is field 3, utime 14, stime 15
+		for (int i = 3; i < 14; i++)
+			ss >> field;
+
+		if (!(ss >> utime >> stime))
+			return false;
+
+		ticks = utime + stime;
+		return true;
+	}
+};
+};	// namespace perfstats
@@ -28,6 +28,12 @@ void SitlTest::spin(int argc, char *argv[])
 		testsetup::OffboardControl offboard_control;
 		offboard_control.spin(argc, argv);
 	}
+	else if (strcmp(argv[1],"perf_benchmark") == 0)
+	{
+		ros::init(argc, argv, "perf_benchmark");
+		testsetup::PerfBenchmark perf_benchmark;
+		perf_benchmark.spin(argc, argv);
+	}
 
 	/** @todo add more testing structures */
 }